@@ -0,0 +1,115 @@
+// Times typing 50 characters into a field that rebuilds the whole screen, as
+// the history search does, while an answer is displayed: once with the answer
+// in a MarkdownBody, which parses it on every build, and once in an
+// AnswerView holding the document parsed by the runner's
+// markdown_document_benchmark:
+//
+//   cmake --build build/linux/x64/release --target markdown_document_benchmark
+//   build/linux/x64/release/runner/markdown_document_benchmark --dump build/markdown_documents
+//   flutter test benchmark/answer_view_benchmark.dart
+//
+// Set MARKDOWN_DOCUMENT_DIR to read answers from somewhere else.
+import 'dart:io';
+
+import 'package:flutter/material.dart';
+import 'package:flutter_markdown_plus/flutter_markdown_plus.dart';
+import 'package:flutter_test/flutter_test.dart';
+
+import 'package:currency_converter/models/markdown_document.dart';
+import 'package:currency_converter/services/gemini_service.dart';
+import 'package:currency_converter/widgets/answer_view.dart';
+
+const int _keystrokes = 50;
+
+// A search field above an answer; every keystroke rebuilds both.
+class _Screen extends StatefulWidget {
+  final WidgetBuilder answer;
+
+  const _Screen({required this.answer});
+
+  @override
+  State<_Screen> createState() => _ScreenState();
+}
+
+class _ScreenState extends State<_Screen> {
+  final TextEditingController _controller = TextEditingController();
+
+  @override
+  void initState() {
+    super.initState();
+    _controller.addListener(() => setState(() {}));
+  }
+
+  @override
+  void dispose() {
+    _controller.dispose();
+    super.dispose();
+  }
+
+  @override
+  Widget build(BuildContext context) {
+    return MaterialApp(
+      home: Scaffold(
+        body: Column(
+          children: [
+            TextField(controller: _controller),
+            Expanded(child: ListView(children: [Builder(builder: widget.answer)])),
+          ],
+        ),
+      ),
+    );
+  }
+}
+
+// Returns the median time of one keystroke, in microseconds.
+Future<int> _type(WidgetTester tester, WidgetBuilder answer) async {
+  await tester.pumpWidget(_Screen(answer: answer));
+  await tester.pump();
+  final samples = <int>[];
+  var typed = '';
+  for (var i = 0; i < _keystrokes; i++) {
+    typed += String.fromCharCode(0x61 + i % 26);
+    final watch = Stopwatch()..start();
+    await tester.enterText(find.byType(TextField), typed);
+    await tester.pump();
+    samples.add(watch.elapsedMicroseconds);
+  }
+  samples.sort();
+  return samples[samples.length ~/ 2];
+}
+
+void main() {
+  testWidgets('Answer rebuild cost while typing', (tester) async {
+    final dir = Directory(Platform.environment['MARKDOWN_DOCUMENT_DIR'] ?? 'build/markdown_documents');
+    if (!dir.existsSync()) {
+      markTestSkipped('No documents in ${dir.path}; run markdown_document_benchmark --dump first.');
+      return;
+    }
+
+    final files = dir.listSync().whereType<File>().where((f) => f.path.endsWith('.md')).toList()
+      ..sort((a, b) => a.lengthSync().compareTo(b.lengthSync()));
+
+    for (final file in files) {
+      final markdown = file.readAsStringSync();
+      final packed = File(file.path.replaceFirst(RegExp(r'\.md$'), '.bin')).readAsBytesSync();
+      final document = MarkdownDocument.fromPacked(packed);
+      final response = GeminiResponse(answer: markdown, sources: const []);
+
+      final markdownBody = await _type(
+        tester,
+        (context) => MarkdownBody(
+          data: markdown,
+          selectable: true,
+          styleSheet: MarkdownStyleSheet(p: AnswerView.paragraphStyle),
+        ),
+      );
+      final answerView = await _type(tester, (context) => AnswerView(response: response, document: document));
+
+      final name = file.uri.pathSegments.last;
+      // ignore: avoid_print
+      print('${name.padRight(24)} ${markdown.length.toString().padLeft(8)} bytes '
+          'MarkdownBody ${(markdownBody / 1000).toStringAsFixed(2).padLeft(8)} ms/key '
+          'AnswerView ${(answerView / 1000).toStringAsFixed(2).padLeft(8)} ms/key');
+    }
+  });
+}
@@ -0,0 +1,47 @@
+// Times the Dart response path (jsonDecode + _applyChunk) on the payloads
+// measured by the runner's native gemini_parser_benchmark:
+//
+//   cmake --build build/linux/x64/release --target gemini_parser_benchmark
+//   build/linux/x64/release/runner/gemini_parser_benchmark --dump build/gemini_payloads
+//   flutter test benchmark/gemini_parser_benchmark.dart
+//
+// Set GEMINI_PAYLOAD_DIR to read recorded payloads from somewhere else.
+import 'dart:io';
+
+import 'package:flutter_test/flutter_test.dart';
+
+import 'package:currency_converter/services/gemini_service.dart';
+
+void main() {
+  test('Dart Gemini response parsing', () {
+    final dir = Directory(Platform.environment['GEMINI_PAYLOAD_DIR'] ?? 'build/gemini_payloads');
+    if (!dir.existsSync()) {
+      markTestSkipped('No payloads in ${dir.path}; run gemini_parser_benchmark --dump first.');
+      return;
+    }
+
+    final service = GeminiService();
+    final files = dir.listSync().whereType<File>().where((f) => f.path.endsWith('.json')).toList()
+      ..sort((a, b) => a.lengthSync().compareTo(b.lengthSync()));
+
+    for (final file in files) {
+      final body = file.readAsStringSync();
+      final samples = <int>[];
+      final budget = Stopwatch()..start();
+      var sources = 0;
+      while (samples.length < 5 || budget.elapsedMilliseconds < 300) {
+        final watch = Stopwatch()..start();
+        sources = service.parseResponseBody(body).sources.length;
+        samples.add(watch.elapsedMicroseconds);
+      }
+      samples.sort();
+      final micros = samples[samples.length ~/ 2];
+      final name = file.uri.pathSegments.last;
+      // ignore: avoid_print
+      print('${name.padRight(28)} ${body.length.toString().padLeft(10)} bytes '
+          '${micros.toString().padLeft(10)} us '
+          '${(body.length / micros).toStringAsFixed(1).padLeft(8)} MB/s '
+          '${sources.toString().padLeft(4)} sources');
+    }
+  });
+}
@@ -0,0 +1,46 @@
+// Times the Dart report path (_convertToHtml + htmltopdfwidgets + pdf) on the
+// answers measured by the runner's native pdf_report_benchmark:
+//
+//   cmake --build build/linux/x64/release --target pdf_report_benchmark
+//   build/linux/x64/release/runner/pdf_report_benchmark --dump build/pdf_reports
+//   flutter test benchmark/pdf_report_benchmark.dart
+//
+// Set PDF_REPORT_DIR to read answers from somewhere else.
+import 'dart:io';
+
+import 'package:flutter_test/flutter_test.dart';
+
+import 'package:currency_converter/utils/pdf_utils.dart';
+
+void main() {
+  test('Dart PDF report generation', () async {
+    final dir = Directory(Platform.environment['PDF_REPORT_DIR'] ?? 'build/pdf_reports');
+    if (!dir.existsSync()) {
+      markTestSkipped('No answers in ${dir.path}; run pdf_report_benchmark --dump first.');
+      return;
+    }
+
+    final files = dir.listSync().whereType<File>().where((f) => f.path.endsWith('.md')).toList()
+      ..sort((a, b) => a.lengthSync().compareTo(b.lengthSync()));
+
+    for (final file in files) {
+      final markdown = file.readAsStringSync();
+      final samples = <double>[];
+      final budget = Stopwatch()..start();
+      var bytes = 0;
+      while (samples.length < 5 || budget.elapsedMilliseconds < 1000) {
+        final watch = Stopwatch()..start();
+        bytes = (await PdfUtils.buildDartReport(markdown, '2024-05-01')).length;
+        samples.add(watch.elapsedMicroseconds / 1000);
+      }
+      final first = samples.first;
+      samples.sort();
+      final name = file.uri.pathSegments.last;
+      // ignore: avoid_print
+      print('${name.padRight(28)} ${markdown.length.toString().padLeft(8)} bytes '
+          '${bytes.toString().padLeft(8)} pdf bytes '
+          '${samples[samples.length ~/ 2].toStringAsFixed(2).padLeft(8)} ms '
+          '(first ${first.toStringAsFixed(2)} ms)');
+    }
+  });
+}
@@ -1,27 +1,81 @@
+import 'dart:async';
 import 'package:flutter/material.dart';
 import 'package:firebase_auth/firebase_auth.dart';
+import 'package:firebase_core/firebase_core.dart';
 import '../screens/home_screen.dart';
 import '../screens/login_screen.dart';
+import '../services/session_snapshot_service.dart';
 
-class AuthGate extends StatelessWidget {
-  const AuthGate({super.key});
+class AuthGate extends StatefulWidget {
+  final Future<FirebaseApp> firebaseReady;
+  // The last session, shown until Firebase knows who is signed in.
+  final SessionSnapshot? snapshot;
+
+  const AuthGate({super.key, required this.firebaseReady, this.snapshot});
 
   @override
-  Widget build(BuildContext context) {
-    return StreamBuilder<User?>(
-      stream: FirebaseAuth.instance.authStateChanges(),
-      builder: (context, snapshot) {
-        if (snapshot.connectionState == ConnectionState.waiting) {
-          return const Scaffold(
-            backgroundColor: Color(0xFF1C1C1C),
-            body: Center(child: CircularProgressIndicator(color: Color.fromARGB(255, 212, 160, 24))),
-          );
-        }
-        if (snapshot.hasData) {
-          return const GroundingSearchScreen();
+  State<AuthGate> createState() => _AuthGateState();
+}
+
+class _AuthGateState extends State<AuthGate> {
+  StreamSubscription<User?>? _authSubscription;
+  SessionSnapshot? _snapshot;
+  bool _authKnown = false;
+  User? _user;
+  Object? _firebaseError;
+
+  @override
+  void initState() {
+    super.initState();
+    _snapshot = widget.snapshot;
+    widget.firebaseReady.then((_) {
+      if (!mounted) return;
+      _authSubscription = FirebaseAuth.instance.authStateChanges().listen((user) {
+        // Nobody is signed in, or someone else is: the snapshot on disk, if
+        // any, is not theirs. One may have been saved during this run.
+        if (user == null || (_snapshot != null && user.uid != _snapshot!.uid)) {
+          _snapshot = null;
+          SessionSnapshotService.clear();
         }
-        return const LoginScreen();
-      },
-    );
+        setState(() {
+          _authKnown = true;
+          _user = user;
+        });
+      });
+    }, onError: (Object e) {
+      debugPrint("Firebase initialization failed: $e");
+      if (mounted) setState(() => _firebaseError = e);
+    });
+  }
+
+  @override
+  void dispose() {
+    _authSubscription?.cancel();
+    super.dispose();
+  }
+
+  @override
+  Widget build(BuildContext context) {
+    final snapshot = _snapshot;
+    if (!_authKnown) {
+      // Paint the last session while Firebase and auth catch up; the screen
+      // goes online in place once the same user is confirmed.
+      if (snapshot != null && _firebaseError == null) {
+        return GroundingSearchScreen(key: ValueKey(snapshot.uid), snapshot: snapshot, online: false);
+      }
+      return Scaffold(
+        backgroundColor: const Color(0xFF1C1C1C),
+        body: Center(
+          child: _firebaseError != null
+              ? const Text("Could not connect. Please restart EchoLens.", style: TextStyle(color: Colors.white54))
+              : const CircularProgressIndicator(color: Color.fromARGB(255, 212, 160, 24)),
+        ),
+      );
+    }
+    final user = _user;
+    if (user != null) {
+      return GroundingSearchScreen(key: ValueKey(user.uid), snapshot: snapshot, online: true);
+    }
+    return const LoginScreen();
   }
-}
\ No newline at end of file
+}
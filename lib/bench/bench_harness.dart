@@ -0,0 +1,560 @@
+import 'dart:async';
+import 'dart:convert';
+import 'dart:io';
+import 'dart:math';
+
+import 'package:flutter/material.dart';
+import 'package:flutter/scheduler.dart';
+import 'package:flutter/services.dart';
+import 'package:flutter_dotenv/flutter_dotenv.dart';
+import 'package:history_arena/history_arena.dart';
+
+import '../models/history_entry.dart';
+import '../services/gemini_service.dart';
+import '../services/history_index_service.dart';
+import '../services/history_repository.dart';
+import '../utils/pdf_utils.dart';
+import '../widgets/answer_view.dart';
+import '../widgets/tiled_report_preview.dart';
+
+/// Scripted scenarios for the runner's benchmark harness.
+///
+/// The currency_converter_bench target, built and installed next to the app
+/// with `cmake --build <dir> --target currency_converter_bench` and
+/// `cmake --install <dir>`, forwards its arguments to main(), which hands
+/// them to [fromArguments]. With `--bench=<scenario>` the scenario runs
+/// instead of the app, and its latencies, throughput and the process's RSS
+/// are written as one JSON line to stdout, or appended to
+/// `--bench-output=<file>`, before the process exits; 1 if it failed.
+///
+/// * `search`: [GeminiService.streamGroundedSearch] `--bench-runs` times
+///   (20) and shows each answer. Start `tool/gemini_stand_in.py --replay DIR`
+///   with the latency and chunking to measure and pass its model URL as
+///   `--bench-gemini-url`.
+/// * `batch`: queues `--bench-queries` (50) searches at once with
+///   [GeminiService.queueGroundedSearch], `--bench-parallelism` (4) at a
+///   time, against the stand-in at `--bench-gemini-url`. Reports the wall
+///   clock of the batch next to the sum and the slowest of its searches, and
+///   how long the runner's rate limiter held them back.
+/// * `history_filter`: indexes `--bench-records` (10000) synthetic records
+///   and types filters into the history search `--bench-runs` times (3),
+///   showing the matches highlighted as the drawer does. Also times the lookup of
+///   earlier searches made before each search, and grouping duplicates.
+/// * `pdf_export`: exports `--bench-reports` (50) reports as separate files
+///   and as one PDF, `--bench-runs` times (3) each.
+/// * `pdf_preview`: opens a synthetic report of at least `--bench-pages`
+///   (15) pages in the tiled preview and scrolls it from top to bottom,
+///   `--bench-speed` (40) logical pixels a frame, at 50%, 100% and 200%
+///   zoom. Reports the build and raster times of
+///   the frames, the share that missed 60 fps, and the runner's tile cache.
+/// * `history_memory`: holds `--bench-records` (50000) synthetic records as
+///   `--bench-representation`: `arena` (default), the [HistoryArena] the
+///   history now reads from, or `objects`, the [HistoryEntry] objects it kept
+///   before. Reports the RSS they add per record, and the time slices of an
+///   allocation loop run for `--bench-churn-ms` (3000) while they are live:
+///   the slow slices are garbage collections, which trace the live heap. Run
+///   it once per representation, each in a fresh process.
+/// * `cold_start`: starts the app as usual and reports at its first frame.
+///   Launch it repeatedly with ECHOLENS_STARTUP_TRACE_LAUNCHED_AT set to the
+///   spawn time to include exec.
+///
+/// The window is shown as usual; run it under `xvfb-run -a` or a headless
+/// compositor to keep it off screen.
+class BenchHarness {
+  static const MethodChannel _channel = MethodChannel('echolens/bench');
+
+  static const String _scenarioArgument = '--bench=';
+  static const String _optionPrefix = '--bench-';
+
+  static const List<String> _filters = ['stanford', 'distributed systems', 'roe', 'quantum', 'stanfrd'];
+
+  final String scenario;
+  final Map<String, String> _options;
+
+  BenchHarness._(this.scenario, this._options);
+
+  /// The harness selected by main's [args], or null without `--bench=` or
+  /// outside the bench target.
+  static Future<BenchHarness?> fromArguments(List<String> args) async {
+    String? scenario;
+    final options = <String, String>{};
+    for (final arg in args) {
+      if (arg.startsWith(_scenarioArgument)) {
+        scenario = arg.substring(_scenarioArgument.length);
+      } else if (arg.startsWith(_optionPrefix) && arg.contains('=')) {
+        final separator = arg.indexOf('=');
+        options[arg.substring(_optionPrefix.length, separator)] = arg.substring(separator + 1);
+      }
+    }
+    if (scenario == null || scenario.isEmpty || kIsWeb || !Platform.isLinux) return null;
+
+    try {
+      await _channel.invokeMethod<void>('processStats');
+    } on MissingPluginException {
+      debugPrint("--bench needs the currency_converter_bench binary; starting the app.");
+      return null;
+    }
+    return BenchHarness._(scenario, options);
+  }
+
+  bool get isColdStart => scenario == 'cold_start';
+
+  int _intOption(String name, int fallback) => int.tryParse(_options[name] ?? '') ?? fallback;
+
+  /// Runs the scenario in place of the app, reports it and exits.
+  Future<void> run() async {
+    final view = ValueNotifier<Widget>(const SizedBox.shrink());
+    runApp(MaterialApp(
+      debugShowCheckedModeBanner: false,
+      theme: ThemeData(brightness: Brightness.dark, useMaterial3: true),
+      home: Scaffold(
+        body: ValueListenableBuilder<Widget>(valueListenable: view, builder: (context, child, _) => child),
+      ),
+    ));
+    await _settle();
+
+    try {
+      final results = switch (scenario) {
+        'search' => await _search(view),
+        'batch' => await _batch(),
+        'history_filter' => await _historyFilter(view),
+        'pdf_export' => await _pdfExport(),
+        'pdf_preview' => await _pdfPreview(view),
+        'history_memory' => await _historyMemory(),
+        _ => throw ArgumentError('Unknown scenario "$scenario"'),
+      };
+      await _report(results);
+    } catch (e) {
+      await _report({'error': e.toString()}, failed: true);
+    }
+  }
+
+  /// Reports the cold start of the app; call at its first frame.
+  Future<void> reportColdStart(DateTime mainStart) {
+    return _report({'mainToFirstFrameMs': DateTime.now().difference(mainStart).inMicroseconds / 1000});
+  }
+
+  Future<Map<String, Object>> _search(ValueNotifier<Widget> view) async {
+    if (!dotenv.isInitialized) {
+      throw StateError('The search scenario needs a .env with GEMINI_API_KEY');
+    }
+    final url = _options['gemini-url'];
+    if (url != null) dotenv.env['GEMINI_BASE_URL'] = url;
+
+    final service = GeminiService();
+    final runs = _intOption('runs', 20);
+    final firstChunk = <Duration>[];
+    final complete = <Duration>[];
+    final shown = <Duration>[];
+    var characters = 0;
+    final total = Stopwatch()..start();
+    for (var i = 0; i < runs; i++) {
+      final watch = Stopwatch()..start();
+      GeminiResponse? response;
+      await for (final update in service.streamGroundedSearch('Benchmark researcher $i')) {
+        if (response == null) firstChunk.add(watch.elapsed);
+        response = update;
+      }
+      if (response == null) throw StateError('Search $i returned nothing');
+      complete.add(watch.elapsed);
+      characters += response.answer.length;
+
+      view.value = SingleChildScrollView(child: AnswerView(key: ValueKey(i), response: response));
+      await _settle();
+      shown.add(watch.elapsed);
+    }
+    final seconds = total.elapsedMicroseconds / 1e6;
+
+    return {
+      'runs': runs,
+      'firstChunkMs': _summary(firstChunk),
+      'completeMs': _summary(complete),
+      'shownMs': _summary(shown),
+      'searchesPerSecond': runs / seconds,
+      'charactersPerSecond': characters / seconds,
+    };
+  }
+
+  Future<Map<String, Object>> _batch() async {
+    if (!dotenv.isInitialized) {
+      throw StateError('The batch scenario needs a .env with GEMINI_API_KEY');
+    }
+    final url = _options['gemini-url'];
+    if (url != null) dotenv.env['GEMINI_BASE_URL'] = url;
+
+    final service = GeminiService();
+    final queries = _intOption('queries', 50);
+    final parallelism = _intOption('parallelism', GeminiService.defaultParallelism);
+    final before = await GeminiService.schedulerStats();
+
+    final searches = <Duration>[];
+    final total = Stopwatch()..start();
+    await Future.wait([
+      for (var i = 0; i < queries; i++)
+        () async {
+          Stopwatch? watch;
+          await for (final _ in service.queueGroundedSearch(
+            'Batch researcher $i',
+            parallelism: parallelism,
+            onStarted: () => watch = Stopwatch()..start(),
+          )) {}
+          searches.add((watch ?? total).elapsed);
+        }(),
+    ]);
+    total.stop();
+    final after = await GeminiService.schedulerStats();
+
+    final sorted = [...searches]..sort();
+    return {
+      'queries': queries,
+      'parallelism': parallelism,
+      'wallMs': total.elapsedMicroseconds / 1000,
+      'sumOfSearchesMs': searches.fold<int>(0, (sum, d) => sum + d.inMicroseconds) / 1000,
+      'slowestSearchMs': sorted.isEmpty ? 0 : sorted.last.inMicroseconds / 1000,
+      'searchMs': _summary(searches),
+      'peakRunning': after['queuePeakRunning'] ?? 0,
+      'throttleWaitMs': (after['throttleWaitMs'] ?? 0) - (before['throttleWaitMs'] ?? 0),
+      'retries': (after['retries'] ?? 0) - (before['retries'] ?? 0),
+    };
+  }
+
+  Future<Map<String, Object>> _historyFilter(ValueNotifier<Widget> view) async {
+    final index = HistoryIndexService();
+    final count = _intOption('records', 10000);
+    final random = Random(1);
+    final now = DateTime.now();
+    final entries = [
+      for (var i = 0; i < count; i++) _syntheticEntry(random, i, now.subtract(Duration(minutes: i))),
+    ];
+    final byId = {for (final entry in entries) entry.id: entry};
+
+    final indexing = Stopwatch()..start();
+    await index.applyDelta(HistoryDelta(upserts: entries, reset: true));
+    indexing.stop();
+
+    final searches = <Duration>[];
+    final keystrokes = <Duration>[];
+    final similar = <Duration>[];
+    final duplicates = Stopwatch();
+    var groups = 0;
+    try {
+      for (var pass = 0; pass < _intOption('runs', 3); pass++) {
+        for (final filter in _filters) {
+          for (var length = 1; length <= filter.length; length++) {
+            final watch = Stopwatch()..start();
+            final found = await index.filter(filter.substring(0, length));
+            searches.add(watch.elapsed);
+            final matches = [for (final match in found) if (byId[match.id] != null) match];
+            view.value = ListView.builder(
+              itemCount: matches.length,
+              itemBuilder: (context, i) => ListTile(
+                title: Text.rich(_highlighted(byId[matches[i].id]!.query, matches[i].ranges), maxLines: 1, overflow: TextOverflow.ellipsis),
+                subtitle: Text(byId[matches[i].id]!.timestamp.toString().split('.')[0]),
+              ),
+            );
+            await _settle();
+            keystrokes.add(watch.elapsed);
+          }
+        }
+        for (final name in _names) {
+          final watch = Stopwatch()..start();
+          await index.similar('Dr. $name, ${_universities[pass % _universities.length]}');
+          similar.add(watch.elapsed);
+        }
+      }
+      duplicates.start();
+      groups = (await index.duplicates()).length;
+      duplicates.stop();
+    } finally {
+      await index.clear();
+    }
+
+    return {
+      'records': count,
+      'indexMs': indexing.elapsedMicroseconds / 1000,
+      'recordsIndexedPerSecond': count / (indexing.elapsedMicroseconds / 1e6),
+      'keystrokes': keystrokes.length,
+      'searchMs': _summary(searches),
+      'keystrokeMs': _summary(keystrokes),
+      'similarMs': _summary(similar),
+      'duplicatesMs': duplicates.elapsedMicroseconds / 1000,
+      'duplicateGroups': groups,
+    };
+  }
+
+  // The drawer's highlighting of the matched parts of a query.
+  static TextSpan _highlighted(String text, List<int> ranges) {
+    final spans = <TextSpan>[];
+    var start = 0;
+    for (var i = 0; i + 1 < ranges.length; i += 2) {
+      if (ranges[i] > start) spans.add(TextSpan(text: text.substring(start, ranges[i])));
+      spans.add(TextSpan(text: text.substring(ranges[i], ranges[i + 1]), style: const TextStyle(fontWeight: FontWeight.bold)));
+      start = ranges[i + 1];
+    }
+    if (start < text.length) spans.add(TextSpan(text: text.substring(start)));
+    return TextSpan(children: spans);
+  }
+
+  Future<Map<String, Object>> _pdfExport() async {
+    final reports = _intOption('reports', 50);
+    final runs = _intOption('runs', 3);
+    final random = Random(2);
+    final entries = [
+      for (var i = 0; i < reports; i++) PdfBatchEntry(query: 'Researcher $i', answer: _syntheticAnswer(random)),
+    ];
+
+    final results = <String, Object>{'reports': reports, 'runs': runs};
+    final directory = await Directory.systemTemp.createTemp('echolens_bench');
+    try {
+      for (final merged in [false, true]) {
+        final samples = <Duration>[];
+        for (var run = 0; run < runs; run++) {
+          final path = merged ? '${directory.path}/merged_$run.pdf' : '${directory.path}/separate_$run';
+          final watch = Stopwatch()..start();
+          await PdfUtils.exportBatch(entries, merged: merged, path: path).drain<void>();
+          samples.add(watch.elapsed);
+        }
+        final name = merged ? 'merged' : 'separate';
+        final summary = _summary(samples);
+        results['${name}Ms'] = summary;
+        results['${name}ReportsPerSecond'] = reports / (summary['p50']! / 1000);
+      }
+    } finally {
+      await directory.delete(recursive: true);
+    }
+    return results;
+  }
+
+  Future<Map<String, Object>> _pdfPreview(ValueNotifier<Widget> view) async {
+    final pages = _intOption('pages', 15);
+    final speed = _intOption('speed', 40);
+    final random = Random(4);
+    // Roughly two answers fill a page.
+    final markdown = [for (var i = 0; i < pages * 2; i++) _syntheticAnswer(random)].join('\n');
+
+    final builds = <Duration>[];
+    final rasters = <Duration>[];
+    var frames = 0;
+    var slow = 0;
+    void timings(List<FrameTiming> timings) {
+      for (final timing in timings) {
+        builds.add(timing.buildDuration);
+        rasters.add(timing.rasterDuration);
+        frames++;
+        if (timing.totalSpan.inMicroseconds > 16667) slow++;
+      }
+    }
+
+    final results = <String, Object>{'pages': pages, 'speed': speed};
+    final controllers = <ScrollController>[];
+    for (final zoom in const [0.5, 1.0, 2.0]) {
+      final controller = ScrollController();
+      controllers.add(controller);
+      final opened = Completer<int>();
+      view.value = TiledReportPreview(
+        key: ValueKey(zoom),
+        title: 'EchoLens Profile Report',
+        date: '2024-05-01',
+        markdown: markdown,
+        footer: 'Generated by EchoLens AI',
+        zoom: zoom,
+        controller: controller,
+        onOpened: opened.complete,
+      );
+      final id = await opened.future;
+      await _settle();
+
+      builds.clear();
+      rasters.clear();
+      frames = 0;
+      slow = 0;
+      SchedulerBinding.instance.addTimingsCallback(timings);
+      final watch = Stopwatch()..start();
+      while (controller.offset < controller.position.maxScrollExtent) {
+        controller.jumpTo(min(controller.offset + speed, controller.position.maxScrollExtent));
+        await WidgetsBinding.instance.endOfFrame;
+      }
+      await _settle();
+      watch.stop();
+      // Timings arrive in batches; give the last one time to come in.
+      await Future<void>.delayed(const Duration(milliseconds: 200));
+      SchedulerBinding.instance.removeTimingsCallback(timings);
+
+      results['zoom${(zoom * 100).round()}'] = {
+        'scrollMs': watch.elapsedMicroseconds / 1000,
+        'frames': frames,
+        'framesOver16Ms': frames == 0 ? 0 : slow / frames,
+        'buildMs': _summary(builds),
+        'rasterMs': _summary(rasters),
+        'tiles': await TiledReportPreview.stats(id),
+      };
+    }
+    view.value = const SizedBox.shrink();
+    await _settle();
+    for (final controller in controllers) {
+      controller.dispose();
+    }
+    return results;
+  }
+
+  Future<Map<String, Object>> _historyMemory() async {
+    final count = _intOption('records', 50000);
+    final representation = _options['representation'] ?? 'arena';
+    final random = Random(3);
+    final now = DateTime.now();
+    HistoryEntry entry(int i) {
+      final entry = _syntheticEntry(random, i, now.subtract(Duration(minutes: i)));
+      return HistoryEntry(
+        id: entry.id,
+        query: entry.query,
+        response: GeminiResponse(answer: entry.response.answer, sources: _syntheticSources(random)),
+        timestamp: entry.timestamp,
+      );
+    }
+
+    await _settle();
+    final before = ProcessInfo.currentRss;
+    final results = <String, Object>{'records': count, 'representation': representation};
+    final Object live;
+    switch (representation) {
+      case 'arena':
+        // Packed a page at a time, so that the garbage of packing stays small.
+        final arena = HistoryArena();
+        for (var start = 0; start < count; start += 1000) {
+          final packer = HistoryArenaPacker();
+          for (var i = start; i < min(start + 1000, count); i++) {
+            final e = entry(i);
+            packer.add(
+              id: e.id,
+              timestampMs: e.timestamp!.millisecondsSinceEpoch,
+              query: e.query,
+              answer: e.response.answer,
+              sources: [for (final s in e.response.sources) (s.title, s.url)],
+            );
+          }
+          arena.load(packer.takeBytes());
+        }
+        results['arena'] = arena.stats.toMap();
+        live = arena;
+      case 'objects':
+        live = [for (var i = 0; i < count; i++) entry(i)];
+      default:
+        throw ArgumentError('Unknown representation "$representation"');
+    }
+
+    final slices = _churn(Duration(milliseconds: _intOption('churn-ms', 3000)));
+    final added = ProcessInfo.currentRss - before;
+    return {
+      ...results,
+      'live': live is HistoryArena ? live.length : (live as List).length,
+      'rssAddedKb': added ~/ 1024,
+      'bytesPerRecord': added / count,
+      'sliceMs': _summary(slices),
+      'slicesOver4Ms': slices.where((d) => d.inMicroseconds > 4000).length,
+    };
+  }
+
+  // Allocates short- and medium-lived garbage for [duration], timing each
+  // slice of the work. Slices that include a collection take longer.
+  static List<Duration> _churn(Duration duration) {
+    final ring = List<Object?>.filled(4096, null);
+    final slices = <Duration>[];
+    final total = Stopwatch()..start();
+    final slice = Stopwatch();
+    var n = 0;
+    while (total.elapsed < duration) {
+      slice
+        ..reset()
+        ..start();
+      for (var j = 0; j < 256; j++, n++) {
+        ring[n % ring.length] = List<String>.generate(8, (k) => 'garbage $n $k');
+      }
+      slices.add(slice.elapsed);
+    }
+    return slices;
+  }
+
+  Future<void> _report(Map<String, Object> results, {bool failed = false}) async {
+    final stats = await _channel.invokeMapMethod<String, int>('processStats') ?? const {};
+    final firstFrameUs = stats['firstFrameUs'] ?? -1;
+    final result = jsonEncode({
+      'scenario': scenario,
+      ...results,
+      'elapsedMs': (stats['elapsedUs'] ?? 0) / 1000,
+      if (firstFrameUs >= 0) 'firstFrameMs': firstFrameUs / 1000,
+      'rssKb': stats['rssKb'],
+      'peakRssKb': stats['peakRssKb'],
+    });
+    await _channel.invokeMethod<void>('report', {'result': result, 'failed': failed});
+  }
+
+  // Waits until the frames caused by the last change have been drawn.
+  static Future<void> _settle() async {
+    do {
+      await WidgetsBinding.instance.endOfFrame;
+    } while (SchedulerBinding.instance.hasScheduledFrame);
+  }
+
+  static Map<String, double> _summary(List<Duration> samples) {
+    if (samples.isEmpty) return const {};
+    final micros = samples.map((d) => d.inMicroseconds).toList()..sort();
+    double at(double quantile) => micros[((micros.length - 1) * quantile).round()] / 1000;
+    return {
+      'p50': at(0.5),
+      'p95': at(0.95),
+      'max': micros.last / 1000,
+      'mean': micros.reduce((a, b) => a + b) / micros.length / 1000,
+    };
+  }
+
+  static const List<String> _names = ['Jane Roe', 'John Doe', 'Ada Park', 'Luis Ortega', 'Mei Chen', 'Sam Okafor'];
+  static const List<String> _universities = [
+    'Stanford University', 'MIT', 'ETH Zurich', 'University of Toronto', 'IIT Bombay', 'University of Oxford',
+  ];
+  static const List<String> _fields = [
+    'distributed systems', 'quantum computing', 'computational biology', 'machine learning', 'databases',
+    'computer vision', 'programming languages', 'robotics',
+  ];
+
+  static HistoryEntry _syntheticEntry(Random random, int i, DateTime timestamp) {
+    final name = _names[random.nextInt(_names.length)];
+    final university = _universities[random.nextInt(_universities.length)];
+    return HistoryEntry(
+      id: 'bench-$i',
+      query: '$name, $university #$i',
+      response: GeminiResponse(
+        answer: _syntheticAnswer(random, name: name, university: university),
+        sources: [SearchResult(title: university.toLowerCase().replaceAll(' ', ''), url: 'https://example.com/$i')],
+      ),
+      timestamp: timestamp,
+    );
+  }
+
+  // One to six sources from a few hundred pages, as answers cite the same
+  // sites over and over.
+  static List<SearchResult> _syntheticSources(Random random) {
+    return [
+      for (var i = random.nextInt(6); i >= 0; i--)
+        () {
+          final page = random.nextInt(300);
+          final university = _universities[page % _universities.length];
+          return SearchResult(
+            title: university.toLowerCase().replaceAll(' ', ''),
+            url: 'https://vertexaisearch.cloud.google.com/grounding-api-redirect/page$page',
+          );
+        }(),
+    ];
+  }
+
+  static String _syntheticAnswer(Random random, {String? name, String? university}) {
+    name ??= _names[random.nextInt(_names.length)];
+    university ??= _universities[random.nextInt(_universities.length)];
+    final field = _fields[random.nextInt(_fields.length)];
+    final other = _fields[random.nextInt(_fields.length)];
+    return '**Full Name**: $name\n\n'
+        '**Current Designation/Job Title**: Associate Professor\n\n'
+        '**University or Affiliation**: $university\n\n'
+        '**Research Interests or Key Achievements**:\n- $field\n- $other\n\n'
+        '**Summary**: $name works on $field and $other at $university.\n';
+  }
+}
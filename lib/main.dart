@@ -1,32 +1,99 @@
 import 'dart:async';
+import 'package:flutter/foundation.dart';
 import 'package:flutter/material.dart';
 import 'package:flutter_dotenv/flutter_dotenv.dart';
 import 'package:firebase_core/firebase_core.dart';
+import 'package:cloud_firestore/cloud_firestore.dart';
 import 'package:google_fonts/google_fonts.dart';
 
 // Your Auth Gate
 import 'auth/auth_gate.dart';
+import 'bench/bench_harness.dart';
 import 'firebase_options.dart';
+import 'services/frame_stats.dart';
+import 'services/session_snapshot_service.dart';
+import 'services/startup_trace.dart';
 
-Future<void> main() async {
+Future<void> main(List<String> args) async {
+  final mainStart = DateTime.now();
   WidgetsFlutterBinding.ensureInitialized();
+  StartupTrace.record('WidgetsFlutterBinding.ensureInitialized', mainStart, DateTime.now());
+  FrameStats.start();
+  // Fonts the runner has registered need never be fetched.
+  _hasBundledFonts = args.contains('--bundled-fonts');
+  if (_hasBundledFonts) GoogleFonts.config.allowRuntimeFetching = false;
   
   try {
-    await dotenv.load(fileName: ".env");
+    await StartupTrace.span('dotenv.load', () => dotenv.load(fileName: ".env"));
   } catch (e) {
     debugPrint("Warning: .env file not found or invalid.");
   }
 
+  // `--bench=<scenario>` from the runner's bench target runs a scripted
+  // scenario instead of the app; cold start measures the app itself.
+  final bench = await BenchHarness.fromArguments(args);
+  if (bench != null && !bench.isColdStart) {
+    await bench.run();
+    return;
+  }
+
+  // The last session, mapped by the runner during startup, lets the first
+  // frame show real content instead of waiting for Firebase below.
+  final snapshot = await StartupTrace.span('SessionSnapshotService.load', SessionSnapshotService.load);
+
   // --- FIREBASE INITIALIZATION ---
-  await Firebase.initializeApp(
+  // Not awaited: AuthGate waits for it, painting the snapshot meanwhile.
+  final firebaseReady = StartupTrace.span('Firebase.initializeApp', () => Firebase.initializeApp(
     options: DefaultFirebaseOptions.currentPlatform,
-  );
+  )).then((app) {
+    _useFirestoreEmulator();
+    return app;
+  });
+  unawaited(firebaseReady.then((_) => StartupTrace.flush(), onError: (_) {}));
+
+  // Sent before runApp so the spans reach the runner ahead of the first frame.
+  final runAppStart = DateTime.now();
+  StartupTrace.record('main', mainStart, runAppStart);
+  unawaited(StartupTrace.flush());
 
-  runApp(const MyApp());
+  runApp(MyApp(firebaseReady: firebaseReady, snapshot: snapshot));
+  WidgetsBinding.instance.addPostFrameCallback((_) {
+    StartupTrace.record('runApp to first frame', runAppStart, DateTime.now());
+    StartupTrace.flush();
+    if (bench != null) unawaited(bench.reportColdStart(mainStart));
+    // Text stops reflowing once its font is in: at once with the bundled
+    // fonts, after google_fonts has fetched them otherwise.
+    final fontsReady = _hasBundledFonts ? Future<void>.value() : GoogleFonts.pendingFonts();
+    unawaited(fontsReady.then((_) => WidgetsBinding.instance.endOfFrame).then((_) {
+      StartupTrace.record('runApp to stable text', runAppStart, DateTime.now());
+      StartupTrace.flush();
+    }, onError: (_) {}));
+  });
+}
+
+// Whether the Linux runner registered Montserrat with fontconfig at startup,
+// so the engine finds it by name like a system font. It passes
+// `--bundled-fonts` only when the fonts were installed into its bundle;
+// everywhere else google_fonts fetches them.
+bool _hasBundledFonts = false;
+
+// Points Firestore at a local emulator when FIRESTORE_EMULATOR_HOST is set,
+// e.g. to exercise the history sync against `firebase emulators:start`.
+void _useFirestoreEmulator() {
+  if (!dotenv.isInitialized) return;
+  final host = dotenv.env['FIRESTORE_EMULATOR_HOST'] ?? '';
+  final separator = host.lastIndexOf(':');
+  if (separator <= 0) return;
+  final port = int.tryParse(host.substring(separator + 1));
+  if (port == null) return;
+  FirebaseFirestore.instance.useFirestoreEmulator(host.substring(0, separator), port);
 }
 
 class MyApp extends StatelessWidget {
-  const MyApp({super.key});
+  final Future<FirebaseApp> firebaseReady;
+  final SessionSnapshot? snapshot;
+
+  const MyApp({super.key, required this.firebaseReady, this.snapshot});
 
   @override
   Widget build(BuildContext context) {
@@ -34,14 +101,16 @@ class MyApp extends StatelessWidget {
       title: 'EchoLens',
       debugShowCheckedModeBanner: false,
       theme: ThemeData(
-        textTheme: GoogleFonts.montserratTextTheme(Theme.of(context).textTheme),
+        textTheme: _hasBundledFonts
+            ? Theme.of(context).textTheme.apply(fontFamily: 'Montserrat')
+            : GoogleFonts.montserratTextTheme(Theme.of(context).textTheme),
         colorScheme: ColorScheme.fromSeed(
           seedColor: const Color.fromARGB(255, 212, 160, 24),
           brightness: Brightness.dark,
         ),
         useMaterial3: true,
       ),
-      home: const AuthGate(),
+      home: AuthGate(firebaseReady: firebaseReady, snapshot: snapshot),
     );
   }
 }
\ No newline at end of file
@@ -0,0 +1,68 @@
+import 'package:cloud_firestore/cloud_firestore.dart';
+import 'package:history_arena/history_arena.dart';
+
+import '../services/gemini_service.dart';
+
+/// One past research, as stored in the user's history collection.
+///
+/// On Linux the history is read from a [HistoryArena]: an entry is then a
+/// handle on a native record, and its id, query, answer and sources are
+/// decoded from the arena the first time they are read rather than when the
+/// entry is made. The id and the response are kept once decoded.
+class HistoryEntry {
+  final DateTime? timestamp;
+
+  String? _id;
+  final String? _query;
+  GeminiResponse? _response;
+  final HistoryArenaRecord? _record;
+
+  HistoryEntry({
+    required String id,
+    required String query,
+    required GeminiResponse response,
+    this.timestamp,
+  })  : _id = id,
+        _query = query,
+        _response = response,
+        _record = null;
+
+  HistoryEntry.fromArena(HistoryArenaRecord record)
+      : timestamp = DateTime.fromMillisecondsSinceEpoch(record.timestampMs),
+        _query = null,
+        _record = record;
+
+  /// Whether the entry reads from a [HistoryArena].
+  bool get isArenaBacked => _record != null;
+
+  String get id => _id ??= _record!.id;
+
+  String get query => _query ?? _record!.query;
+
+  /// The answer and its sources, decoded from the arena on first read.
+  GeminiResponse get response => _response ??= _decodeResponse(_record!);
+
+  static GeminiResponse _decodeResponse(HistoryArenaRecord record) {
+    return GeminiResponse(
+      answer: record.answer,
+      sources: [
+        for (var i = 0; i < record.sourceCount; i++)
+          SearchResult(title: record.sourceTitle(i), url: record.sourceUrl(i)),
+      ],
+    );
+  }
+
+  factory HistoryEntry.fromDocument(DocumentSnapshot doc) {
+    final data = doc.data() as Map<String, dynamic>;
+    final List<dynamic> sourceMaps = data['sources'] ?? [];
+    return HistoryEntry(
+      id: doc.id,
+      query: data['query'] ?? 'Unknown',
+      response: GeminiResponse(
+        answer: data['answer'] ?? '',
+        sources: sourceMaps.map((s) => SearchResult(title: s['title'] ?? '', url: s['url'] ?? '')).toList(),
+      ),
+      timestamp: (data['timestamp'] as Timestamp?)?.toDate(),
+    );
+  }
+}
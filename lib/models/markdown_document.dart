@@ -0,0 +1,74 @@
+import 'dart:convert';
+import 'dart:typed_data';
+
+enum MarkdownBlockKind { paragraph, heading, bullet, ordered, quote, code, rule }
+
+/// Bits of [MarkdownDocument.spanStyle].
+class MarkdownSpanStyle {
+  static const int bold = 1;
+  static const int italic = 2;
+  static const int code = 4;
+  static const int link = 8;
+}
+
+/// An answer parsed by the runner's markdown_document_parse(), kept as the
+/// flat arrays it was packed in: blocks in reading order, the spans of every
+/// block back to back, and the whole text in one string that span and link
+/// ranges index by UTF-16 code unit. Nothing is allocated per node.
+class MarkdownDocument {
+  static const int _headerSize = 16;
+  static const int _blockSize = 16;
+  static const int _spanSize = 16;
+  static const int _linkSize = 8;
+
+  final ByteData _data;
+  final int blockCount;
+  final int spanCount;
+  final int linkCount;
+  final String text;
+
+  MarkdownDocument._(this._data, this.blockCount, this.spanCount, this.linkCount, this.text);
+
+  factory MarkdownDocument.fromPacked(Uint8List packed) {
+    final data = ByteData.sublistView(packed);
+    final blockCount = data.getUint32(0, Endian.little);
+    final spanCount = data.getUint32(4, Endian.little);
+    final linkCount = data.getUint32(8, Endian.little);
+    final textLength = data.getUint32(12, Endian.little);
+    final textOffset = _headerSize + blockCount * _blockSize + spanCount * _spanSize + linkCount * _linkSize;
+    final text = utf8.decode(Uint8List.sublistView(packed, textOffset, textOffset + textLength));
+    return MarkdownDocument._(data, blockCount, spanCount, linkCount, text);
+  }
+
+  int get _spansStart => _headerSize + blockCount * _blockSize;
+  int get _linksStart => _spansStart + spanCount * _spanSize;
+
+  MarkdownBlockKind blockKind(int block) => MarkdownBlockKind.values[_data.getUint8(_headerSize + block * _blockSize)];
+
+  /// The heading level from 1, or the list nesting depth from 0.
+  int blockLevel(int block) => _data.getUint8(_headerSize + block * _blockSize + 1);
+
+  int blockNumber(int block) => _data.getUint32(_headerSize + block * _blockSize + 4, Endian.little);
+
+  int blockFirstSpan(int block) => _data.getUint32(_headerSize + block * _blockSize + 8, Endian.little);
+
+  int blockSpanCount(int block) => _data.getUint32(_headerSize + block * _blockSize + 12, Endian.little);
+
+  String spanText(int span) {
+    final offset = _data.getUint32(_spansStart + span * _spanSize, Endian.little);
+    final length = _data.getUint32(_spansStart + span * _spanSize + 4, Endian.little);
+    return text.substring(offset, offset + length);
+  }
+
+  /// A combination of [MarkdownSpanStyle] bits.
+  int spanStyle(int span) => _data.getUint32(_spansStart + span * _spanSize + 8, Endian.little);
+
+  /// The link the span is the text of, or -1.
+  int spanLink(int span) => _data.getInt32(_spansStart + span * _spanSize + 12, Endian.little);
+
+  String linkTarget(int link) {
+    final offset = _data.getUint32(_linksStart + link * _linkSize, Endian.little);
+    final length = _data.getUint32(_linksStart + link * _linkSize + 4, Endian.little);
+    return text.substring(offset, offset + length);
+  }
+}
@@ -1,68 +1,246 @@
 import 'dart:async';
 import 'dart:io';
 import 'package:flutter/material.dart';
+import 'package:flutter/scheduler.dart';
 import 'package:url_launcher/url_launcher.dart';
-import 'package:flutter_markdown_plus/flutter_markdown_plus.dart';
 import 'package:firebase_auth/firebase_auth.dart';
 import 'package:cloud_firestore/cloud_firestore.dart';
-import 'package:pdf/pdf.dart';
-import 'package:pdf/widgets.dart' as pw;
-import 'package:printing/printing.dart';
-import 'package:htmltopdfwidgets/htmltopdfwidgets.dart' as hp;
 import 'package:flutter_dotenv/flutter_dotenv.dart';
 
+import '../models/history_entry.dart';
+import '../services/frame_stats.dart';
 import '../services/gemini_service.dart';
+import '../services/history_index_service.dart';
+import '../services/history_repository.dart';
+import '../services/launch_service.dart';
+import '../services/research_batch.dart';
+import '../services/response_cache_service.dart';
+import '../services/session_snapshot_service.dart';
+import '../services/source_resolver_service.dart';
+import '../utils/pdf_utils.dart';
+import '../widgets/answer_view.dart';
+import '../widgets/batch_research_sheet.dart';
 
 class GroundingSearchScreen extends StatefulWidget {
-  const GroundingSearchScreen({super.key});
+  // The last session, painted until Firestore catches up.
+  final SessionSnapshot? snapshot;
+  // False while Firebase is still starting and only [snapshot] can be shown.
+  final bool online;
+
+  const GroundingSearchScreen({super.key, this.snapshot, this.online = true});
 
   @override
   State<GroundingSearchScreen> createState() => _GroundingSearchScreenState();
 }
 
-class _GroundingSearchScreenState extends State<GroundingSearchScreen> {
+class _GroundingSearchScreenState extends State<GroundingSearchScreen> with WidgetsBindingObserver implements SearchQuota {
   final TextEditingController _controller = TextEditingController();
+  // Focusing the search field warms a connection to Gemini.
+  final FocusNode _searchFocus = FocusNode();
   // New controller for history search
   final TextEditingController _historySearchController = TextEditingController();
   final GeminiService _geminiService = GeminiService();
+  final ResponseCacheService _responseCache = ResponseCacheService();
+  final HistoryIndexService _historyIndex = HistoryIndexService();
   
   bool _isLoading = false;
+  // Set before the first await of a search so that the button and the text
+  // field cannot start a second one while the cache is being checked.
+  bool _searchInFlight = false;
+  // A query from the command line that arrived before Firebase was up.
+  bool _launchSearchPending = false;
   GeminiResponse? _response;
+  // The newest partial answer of a streaming search, waiting for the next
+  // frame: chunks that arrive within one frame cost one rebuild.
+  GeminiResponse? _pendingPartial;
   String? _errorMessage;
   String _displayName = "User";
+  String? _email;
   String _historyFilter = ""; // State variable for search text
 
+  // --- HISTORY VARIABLES ---
+  HistoryRepository? _historyRepository;
+  StreamSubscription<HistoryDelta>? _historySubscription;
+  List<HistoryEntry> _history = [];
+  bool _historyLoading = true;
+  bool _historyFailed = false;
+  // Whether the native index has seen the repository's history yet.
+  bool _historyIndexed = false;
+  // Ids matching _historyFilter, best first; null while the filter is empty.
+  List<String>? _historyMatches;
+  // The parts of each matching query to highlight, as UTF-16 start/end pairs.
+  Map<String, List<int>> _historyHighlights = const {};
+  int _historySearchGeneration = 0;
+  // Records that repeat one another: the ids of the older ones by the
+  // newest of their group, and the reverse. The drawer collapses a group into
+  // its newest record unless that record's id is in _expandedDuplicates.
+  Map<String, List<String>> _olderVersions = const {};
+  Map<String, String> _duplicateOf = const {};
+  final Set<String> _expandedDuplicates = {};
+  // Bumped whenever _expandedDuplicates changes.
+  int _expandedDuplicatesVersion = 0;
+  // The last list _visibleHistory() made, and what it made it from. The
+  // drawer is rebuilt far more often than any of those change.
+  List<HistoryEntry>? _visibleHistoryCache;
+  Object? _visibleHistoryInputs;
+
   // --- LIMIT VARIABLES ---
   static const int _dailyLimit = 3;
   static final String _adminEmail = dotenv.env['ADMIN_EMAIL'] ?? ''; // REPLACE WITH YOUR EMAIL
   int _searchesUsedToday = 0;
+  // Held by queued batch searches until they answer or fail.
+  int _searchesReserved = 0;
   bool _isExempt = false;
 
+  // The last batch started, kept while its sheet is closed.
+  ResearchBatch? _batch;
+
+  Timer? _snapshotTimer;
+
+  // Prompt sent for every search. It is also part of the response cache key,
+  // so editing it invalidates previously cached answers.
+  static const String _profilePromptTemplate = """
+        Conduct a web search for the professional profile of: {query}
+        Extract the following details and present them in a clean, readable format:
+        - Full Name
+        - Current Designation/Job Title
+        - Department
+        - University or Affiliation
+        - Contact Emails (list all found)
+        - Research Interests or Key Achievements
+        - Education History
+        - Location
+
+        RULES:
+        1. Each field's heading MUST be bold using double asterisks and followed by a colon, e.g., "**Full Name**: John Doe". 
+        2. After each field, have a new line for better formatting.
+        3. DO NOT include introductory lines like "Here is the professional profile..." or "Based on my research".
+        4. Provide ONLY the required details and nothing else.
+        5. Finally, provide a short professional summary with the specific heading "**Summary**".
+      """;
+
   @override
   void initState() {
     super.initState();
-    _fetchUserData();
+    WidgetsBinding.instance.addObserver(this);
+    FrameStats.enter('search');
+    _searchFocus.addListener(() {
+      if (_searchFocus.hasFocus) _geminiService.preconnect();
+    });
+    final snapshot = widget.snapshot;
+    if (snapshot != null) {
+      _displayName = snapshot.displayName;
+      _email = snapshot.email;
+      _isExempt = snapshot.exempt;
+      _searchesUsedToday = snapshot.searchesUsedOn(DateTime.now());
+      _response = snapshot.result;
+      if (snapshot.result != null) SourceResolverService.resolve(snapshot.result!.sources);
+      _controller.text = snapshot.query ?? '';
+      _history = snapshot.history;
+      _historyLoading = false;
+    }
+    if (widget.online) _goOnline();
     // Listen to changes in the history search bar
     _historySearchController.addListener(() {
+      final filter = _historySearchController.text.toLowerCase();
+      if (filter == _historyFilter) return;
       setState(() {
-        _historyFilter = _historySearchController.text.toLowerCase();
+        _historyFilter = filter;
       });
+      _searchHistory();
     });
+    LaunchService.listen(_searchFromLaunch);
+  }
+
+  @override
+  void didUpdateWidget(GroundingSearchScreen oldWidget) {
+    super.didUpdateWidget(oldWidget);
+    if (widget.online && !oldWidget.online) {
+      _goOnline();
+      if (_launchSearchPending) {
+        _launchSearchPending = false;
+        _performSearch();
+      }
+    }
+  }
+
+  // Searches for a name given on the command line, by this launch or by a
+  // later one that handed it over.
+  void _searchFromLaunch(String query) {
+    if (!mounted) return;
+    _controller.text = query;
+    if (widget.online) {
+      _performSearch();
+    } else {
+      _launchSearchPending = true;
+    }
+  }
+
+  @override
+  void didChangeAppLifecycleState(AppLifecycleState state) {
+    // Idle connections may have been dropped while the app was in the
+    // background; have one ready for the next search.
+    if (state == AppLifecycleState.resumed) _geminiService.preconnect();
   }
 
   @override
   void dispose() {
+    WidgetsBinding.instance.removeObserver(this);
+    FrameStats.leave('search');
+    LaunchService.cancel();
+    _searchFocus.dispose();
+    _snapshotTimer?.cancel();
+    _historySubscription?.cancel();
+    _historyRepository?.dispose();
+    _batch?.dispose();
     _controller.dispose();
     _historySearchController.dispose();
     super.dispose();
   }
 
+  // Starts reading the live profile and history once Firebase is up.
+  void _goOnline() {
+    _fetchUserData();
+    _subscribeToHistory();
+  }
+
+  // Drops the saved session before the user leaves, so that the next launch
+  // does not paint their data, and stops a pending save from writing it back.
+  Future<void> _forgetSession() async {
+    _snapshotTimer?.cancel();
+    _snapshotTimer = null;
+    await SessionSnapshotService.clear();
+  }
+
+  // Stores what the screen shows for the next launch to paint straight away.
+  // Debounced so that a burst of updates costs one write.
+  void _scheduleSnapshotSave() {
+    if (!widget.online || !SessionSnapshotService.isAvailable) return;
+    _snapshotTimer?.cancel();
+    _snapshotTimer = Timer(const Duration(seconds: 1), () {
+      final user = FirebaseAuth.instance.currentUser;
+      if (user == null || !mounted || _isLoading) return;
+      SessionSnapshotService.save(SessionSnapshot(
+        uid: user.uid,
+        email: user.email ?? '',
+        displayName: _displayName,
+        savedAt: DateTime.now(),
+        searchesUsedToday: _searchesUsedToday,
+        exempt: _isExempt,
+        query: _response == null ? null : _controller.text,
+        result: _response,
+        history: _history.take(SessionSnapshotService.historyPageSize).toList(),
+      ));
+    });
+  }
+
 Future<void> _fetchUserData() async {
     final user = FirebaseAuth.instance.currentUser;
     if (user != null) {
       // Check exemption immediately
       setState(() {
         _isExempt = user.email == _adminEmail;
+        _email = user.email;
       });
 
       try {
@@ -73,29 +251,44 @@ Future<void> _fetchUserData() async {
         
         if (doc.exists && doc.data() != null) {
           final data = doc.data()!;
-          setState(() {
-            _displayName = data['username'] ?? user.email?.split('@')[0] ?? "User";
-            
-            // Check and load search limit data
-            final lastSearchTimestamp = data['lastSearchDate'] as Timestamp?;
-            if (lastSearchTimestamp != null) {
-              final lastSearchDate = lastSearchTimestamp.toDate();
-              final now = DateTime.now();
-              // Reset if it's a new day
-              if (lastSearchDate.year != now.year || 
-                  lastSearchDate.month != now.month || 
-                  lastSearchDate.day != now.day) {
-                _searchesUsedToday = 0;
-                // Update Firestore reset immediately to keep it clean
+          final now = DateTime.now();
+
+          // Check and load search limit data
+          int? searches;
+          final lastSearchTimestamp = data['lastSearchDate'] as Timestamp?;
+          if (lastSearchTimestamp != null) {
+            final lastSearchDate = lastSearchTimestamp.toDate();
+            // Reset if it's a new day
+            if (lastSearchDate.year != now.year ||
+                lastSearchDate.month != now.month ||
+                lastSearchDate.day != now.day) {
+              searches = 0;
+              // Update Firestore reset immediately to keep it clean. The
+              // replica's journal may already hold today's count, which
+              // this write could land after.
+              if (!HistoryRepository.isAvailable) {
                 FirebaseFirestore.instance.collection('users').doc(user.uid).update({
                   'searchesUsedToday': 0,
                   'lastSearchDate': FieldValue.serverTimestamp(),
                 });
-              } else {
-                _searchesUsedToday = data['searchesUsedToday'] ?? 0;
               }
+            } else {
+              searches = data['searchesUsedToday'] ?? 0;
             }
+          }
+          // Searches journaled but not uploaded yet still count.
+          final repository = _historyRepository;
+          if (repository != null) searches = await repository.searchesOn(now, searches ?? 0);
+          if (!mounted) return;
+
+          final known = searches;
+          setState(() {
+            _displayName = data['username'] ?? user.email?.split('@')[0] ?? "User";
+            // A search finished while the document was read is counted
+            // already.
+            if (known != null && known > _searchesUsedToday) _searchesUsedToday = known;
           });
+          _scheduleSnapshotSave();
         }
       } catch (e) {
         debugPrint("Error fetching user data: $e");
@@ -103,27 +296,9 @@ Future<void> _fetchUserData() async {
     }
   }
 
-  Future<void> _updateUsageCount() async {
-    final user = FirebaseAuth.instance.currentUser;
-    if (user == null || _isExempt) return;
-
-    final newCount = _searchesUsedToday + 1;
-    
-    // Optimistic UI update
-    setState(() => _searchesUsedToday = newCount);
-
-    try {
-      await FirebaseFirestore.instance.collection('users').doc(user.uid).update({
-        'searchesUsedToday': newCount,
-        'lastSearchDate': FieldValue.serverTimestamp(),
-      });
-    } catch (e) {
-      debugPrint("Failed to update usage count: $e");
-    }
-  }
-
   /// Logic to delete the account and its associated Firestore data
   Future<void> _handleDeleteAccount() async {
+    if (!widget.online) return;
     final user = FirebaseAuth.instance.currentUser;
     if (user == null) return;
 
@@ -169,6 +344,8 @@ Future<void> _fetchUserData() async {
         // 2. Delete User Document
         batch.delete(FirebaseFirestore.instance.collection('users').doc(uid));
         await batch.commit();
+        await _historyRepository?.forget();
+        await _forgetSession();
 
         // 3. Delete Authentication Account
         // Note: If the user hasn't logged in recently, this might throw a 
@@ -197,11 +374,15 @@ Future<void> _fetchUserData() async {
     if (!mounted) return;
     setState(() {
       _isLoading = false; 
+      _response = null; // Drop any partially streamed answer
       final errorString = e.toString();
       if (e is SocketException) {
         _errorMessage = "No internet connection. Please check your network.";
       } else if (e is TimeoutException) {
         _errorMessage = "Request timed out. Gemini is taking too long.";
+      } else if (e is GeminiApiException && e.status == 429 && e.retryAfter != null) {
+        final seconds = e.retryAfter!.inSeconds < 1 ? 1 : e.retryAfter!.inSeconds;
+        _errorMessage = "API limit reached. Please try again in $seconds s.";
       } else if (errorString.contains('429')) {
         _errorMessage = "API limit reached. Please wait a moment.";
       } else if (errorString.contains('401') || errorString.contains('403')) {
@@ -212,50 +393,131 @@ Future<void> _fetchUserData() async {
     });
   }
 
-  Future<void> _saveToHistory(String query, GeminiResponse response) async {
+  // Hands a search to the repository without waiting for it to be stored.
+  // [searchesToday] is the quota count including this search, if it counts.
+  // An uncounted answer the history already holds, such as a cache hit, is
+  // not recorded twice.
+  void _saveToHistory(String query, GeminiResponse response, {int? searchesToday}) {
+    final repository = _historyRepository;
+    if (repository == null) return;
+    if (searchesToday == null && _isInHistory(query, response)) return;
+
+    repository.addSearch(query, response, searchesToday: searchesToday).catchError((Object e) {
+      debugPrint("Failed to save history: $e");
+    });
+  }
+
+  bool _isInHistory(String query, GeminiResponse response) {
+    return _historyRepository?.contains(query, response.answer) ?? false;
+  }
+
+  // Reads an entry by id from the repository, without reading the others.
+  HistoryEntry? _historyEntry(String id) => _historyRepository?.find(id);
+
+  // Reads the history from the local replica, which syncs with Firestore in
+  // the background, and mirrors every change into the native index so the
+  // drawer can search every record instead of the latest few.
+  void _subscribeToHistory() {
     final user = FirebaseAuth.instance.currentUser;
-    if (user == null) return;
+    if (user == null) {
+      _historyLoading = false;
+      return;
+    }
 
-    try {
-      // Map sources to a list of maps for Firestore
-      final sourcesData = response.sources.map((s) => {
-        'title': s.title,
-        'url': s.url
-      }).toList();
-
-      await FirebaseFirestore.instance
-          .collection('users')
-          .doc(user.uid)
-          .collection('history')
-          .add({
-        'query': query,
-        'answer': response.answer,
-        'sources': sourcesData,
-        'timestamp': FieldValue.serverTimestamp(),
+    final repository = HistoryRepository(user.uid);
+    _historyRepository = repository;
+    _historySubscription = repository.changes.listen((delta) async {
+      await _historyIndex.applyDelta(delta);
+      if (!mounted) return;
+      setState(() {
+        _history = repository.entries;
+        _historyLoading = false;
+        _historyFailed = false;
+        _historyIndexed = true;
       });
+      if (_historyFilter.isNotEmpty) _searchHistory();
+      _findDuplicates();
+      _scheduleSnapshotSave();
+    }, onError: (Object e) {
+      // The replica still holds everything; only a screen without one fails.
+      if (mounted && _history.isEmpty) setState(() => _historyFailed = true);
+    });
+    repository.start();
+  }
+
+  Future<void> _searchHistory() async {
+    final filter = _historyFilter;
+    final generation = ++_historySearchGeneration;
+
+    List<String>? matches;
+    final highlights = <String, List<int>>{};
+    if (filter.isEmpty) {
+      matches = null;
+    } else if (_historyIndex.isAvailable && _historyIndexed) {
+      try {
+        final found = await _historyIndex.filter(filter);
+        matches = [for (final match in found) match.id];
+        for (final match in found) {
+          if (match.ranges.isNotEmpty) highlights[match.id] = match.ranges;
+        }
+      } catch (e) {
+        debugPrint("History search failed: $e");
+        matches = const [];
+      }
+    } else {
+      matches = _history.where((entry) {
+        return entry.query.toLowerCase().contains(filter) ||
+            entry.response.answer.toLowerCase().contains(filter) ||
+            entry.response.sources.any((s) => s.title.toLowerCase().contains(filter));
+      }).map((entry) => entry.id).toList();
+      for (final entry in _history) {
+        final ranges = _substringRanges(entry.query, filter);
+        if (ranges.isNotEmpty) highlights[entry.id] = ranges;
+      }
+    }
+
+    // A newer keystroke has already started its own search.
+    if (!mounted || generation != _historySearchGeneration) return;
+    setState(() {
+      _historyMatches = matches;
+      _historyHighlights = highlights;
+    });
+  }
+
+  Future<void> _findDuplicates() async {
+    if (!_historyIndex.isAvailable) return;
+    final List<List<String>> groups;
+    try {
+      groups = await _historyIndex.duplicates();
     } catch (e) {
-      debugPrint("Failed to save history: $e");
+      debugPrint("Duplicate detection failed: $e");
+      return;
     }
+    if (!mounted) return;
+    setState(() {
+      _olderVersions = {for (final group in groups) group.first: group.sublist(1)};
+      _duplicateOf = {
+        for (final group in groups)
+          for (final id in group.skip(1)) id: group.first,
+      };
+    });
   }
 
   Future<void> _deleteHistoryItem(String docId) async {
-    final user = FirebaseAuth.instance.currentUser;
-    if (user == null) return;
+    if (!widget.online) return;
+    final repository = _historyRepository;
+    if (repository == null) return;
     try {
-      await FirebaseFirestore.instance
-          .collection('users')
-          .doc(user.uid)
-          .collection('history')
-          .doc(docId)
-          .delete();
+      await repository.delete(docId);
     } catch (e) {
       debugPrint("Failed to delete item: $e");
     }
   }
 
   Future<void> _clearAllHistory() async {
-    final user = FirebaseAuth.instance.currentUser;
-    if (user == null) return;
+    if (!widget.online) return;
+    final repository = _historyRepository;
+    if (repository == null) return;
     
     final confirm = await showDialog<bool>(
       context: context,
@@ -279,45 +541,349 @@ Future<void> _fetchUserData() async {
 
     if (confirm == true) {
       try {
-        final collection = FirebaseFirestore.instance
-            .collection('users')
-            .doc(user.uid)
-            .collection('history');
-        final snapshots = await collection.get();
-        for (var doc in snapshots.docs) {
-          await doc.reference.delete();
-        }
+        await repository.clearAll();
       } catch (e) {
         debugPrint("Failed to clear history: $e");
       }
     }
   }
 
-  void _loadFromHistory(Map<String, dynamic> data) {
+  // The history records the drawer shows for the current filter. Matches come
+  // back from the index as ids, best first. Without a filter, duplicates are
+  // collapsed into the newest record of their group.
+  List<HistoryEntry> _visibleHistory() {
+    final matches = _historyMatches;
+    if (matches == null && _duplicateOf.isEmpty) return _history;
+    final inputs = (_history, matches, _duplicateOf, _expandedDuplicatesVersion);
+    final cached = _visibleHistoryCache;
+    if (cached != null && inputs == _visibleHistoryInputs) return cached;
+
+    final List<HistoryEntry> visible;
+    if (matches == null) {
+      visible = [
+        for (final entry in _history)
+          if (!_duplicateOf.containsKey(entry.id)) ...[
+            entry,
+            if (_expandedDuplicates.contains(entry.id))
+              for (final id in _olderVersions[entry.id] ?? const <String>[])
+                if (_historyEntry(id) case final older?) older,
+          ],
+      ];
+    } else {
+      visible = [
+        for (final id in matches)
+          if (_historyEntry(id) case final entry?) entry,
+      ];
+    }
+    _visibleHistoryCache = visible;
+    _visibleHistoryInputs = inputs;
+    return visible;
+  }
+
+  // Exports every record the drawer currently shows as PDF reports, rendered
+  // in parallel by the Linux runner.
+  Future<void> _exportHistory() async {
+    final entries = [
+      for (final entry in _visibleHistory())
+        PdfBatchEntry(query: entry.query, answer: entry.response.answer),
+    ];
+    if (entries.isEmpty) return;
+
+    final merged = await showDialog<bool>(
+      context: context,
+      builder: (context) => AlertDialog(
+        title: Text("Export ${entries.length} Reports", style: const TextStyle(color: Colors.white)),
+        content: const Text("Save each report as its own PDF, or all of them in one PDF with a table of contents?",
+          style: TextStyle(color: Colors.white),
+        ),
+        actions: [
+          TextButton(onPressed: () => Navigator.pop(context), child: const Text("Cancel")),
+          TextButton(onPressed: () => Navigator.pop(context, false), child: const Text("Separate Files")),
+          TextButton(onPressed: () => Navigator.pop(context, true), child: const Text("One PDF")),
+        ],
+      ),
+    );
+    if (merged == null || !mounted) return;
+
+    final progress = ValueNotifier<PdfBatchProgress>(PdfBatchProgress(done: 0, total: entries.length));
+    final dialogContext = Completer<BuildContext>();
+    late final StreamSubscription<PdfBatchProgress> subscription;
+    final done = Completer<String?>();
+
+    subscription = PdfUtils.exportBatch(entries, merged: merged).listen(
+      (update) => progress.value = update,
+      onError: (Object e) {
+        if (!done.isCompleted) done.complete("PDF Error: $e");
+      },
+      onDone: () {
+        if (done.isCompleted) return;
+        final paths = progress.value.paths;
+        if (paths == null) {
+          done.complete(null);
+        } else if (merged) {
+          done.complete("Saved to ${paths.first}");
+        } else {
+          done.complete("Saved ${paths.length} reports to ${File(paths.first).parent.path}");
+        }
+      },
+    );
+
+    showDialog<void>(
+      context: context,
+      barrierDismissible: false,
+      builder: (context) {
+        if (!dialogContext.isCompleted) dialogContext.complete(context);
+        return AlertDialog(
+          title: const Text("Exporting Reports", style: TextStyle(color: Colors.white)),
+          content: ValueListenableBuilder<PdfBatchProgress>(
+            valueListenable: progress,
+            builder: (context, value, _) => Column(
+              mainAxisSize: MainAxisSize.min,
+              children: [
+                LinearProgressIndicator(value: value.total == 0 ? null : value.done / value.total),
+                const SizedBox(height: 12),
+                Text("${value.done} of ${value.total}", style: const TextStyle(color: Colors.white54)),
+              ],
+            ),
+          ),
+          actions: [
+            TextButton(
+              onPressed: () async {
+                await subscription.cancel();
+                if (!done.isCompleted) done.complete("Export cancelled");
+              },
+              child: const Text("Cancel"),
+            ),
+          ],
+        );
+      },
+    );
+
+    final message = await FrameStats.during('pdf_export', () => done.future);
+    if (dialogContext.isCompleted) {
+      final dialog = await dialogContext.future;
+      if (dialog.mounted) Navigator.of(dialog).pop();
+    }
+    progress.dispose();
+    if (message != null && mounted) {
+      ScaffoldMessenger.of(context).showSnackBar(SnackBar(content: Text(message)));
+    }
+  }
+
+  void _loadFromHistory(HistoryEntry entry) {
+    _showHistoryEntry(entry);
+    Navigator.of(context).pop(); // Close drawer
+  }
+
+  void _showHistoryEntry(HistoryEntry entry) {
     setState(() {
-      _controller.text = data['query'] ?? '';
+      _controller.text = entry.query;
       _errorMessage = null;
-      
-      // Reconstruct GeminiResponse from saved data
-      final List<dynamic> sourceMaps = data['sources'] ?? [];
-      final List<SearchResult> reconstructedSources = sourceMaps.map((s) => 
-        SearchResult(title: s['title'] ?? '', url: s['url'] ?? '')
-      ).toList();
-
-      _response = GeminiResponse(
-        answer: data['answer'] ?? '',
-        sources: reconstructedSources,
+      _response = entry.response;
+    });
+    SourceResolverService.resolve(entry.response.sources);
+    _scheduleSnapshotSave();
+  }
+
+  static String _ago(DateTime? timestamp) {
+    if (timestamp == null) return "just now";
+    final days = DateTime.now().difference(timestamp).inDays;
+    if (days == 0) return "today";
+    if (days == 1) return "yesterday";
+    return "$days days ago";
+  }
+
+  // Offers the answers of earlier searches for the same person before
+  // [query] spends one. Returns false if the user opened one of them or
+  // backed out instead of searching again.
+  Future<bool> _confirmNewSearch(String query) async {
+    if (!_historyIndex.isAvailable || !_historyIndexed) return true;
+    final List<SimilarRecord> similar;
+    try {
+      similar = await _historyIndex.similar(query);
+    } catch (e) {
+      debugPrint("Similar search lookup failed: $e");
+      return true;
+    }
+    final earlier = [
+      for (final match in similar)
+        if (_historyEntry(match.id) case final entry?) entry,
+    ];
+    if (earlier.isEmpty || !mounted) return true;
+
+    const brandColor = Color.fromARGB(255, 212, 160, 24);
+    final choice = await showDialog<Object>(
+      context: context,
+      builder: (context) => AlertDialog(
+        backgroundColor: const Color(0xFF2C2C2C),
+        title: const Text("Researched Before", style: TextStyle(color: Colors.white)),
+        content: Column(
+          mainAxisSize: MainAxisSize.min,
+          crossAxisAlignment: CrossAxisAlignment.start,
+          children: [
+            Text(
+              "You researched this ${_ago(earlier.first.timestamp)}. Open an earlier answer instead of using a search?",
+              style: const TextStyle(color: Colors.white70),
+            ),
+            const SizedBox(height: 8),
+            for (final entry in earlier)
+              ListTile(
+                contentPadding: EdgeInsets.zero,
+                leading: const Icon(Icons.history, color: brandColor, size: 20),
+                title: Text(entry.query, style: const TextStyle(color: Colors.white, fontSize: 13)),
+                subtitle: Text(_ago(entry.timestamp), style: const TextStyle(color: Colors.white38, fontSize: 11)),
+                onTap: () => Navigator.pop(context, entry),
+              ),
+          ],
+        ),
+        actions: [
+          TextButton(
+            onPressed: () => Navigator.pop(context),
+            child: const Text("Cancel", style: TextStyle(color: Colors.white54)),
+          ),
+          TextButton(
+            onPressed: () => Navigator.pop(context, true),
+            child: const Text("Search Anyway", style: TextStyle(color: brandColor)),
+          ),
+        ],
+      ),
+    );
+    if (choice is HistoryEntry && mounted) _showHistoryEntry(choice);
+    return choice == true;
+  }
+
+  // --- BATCH RESEARCH ---
+  @override
+  bool reserve() {
+    if (_isExempt) return true;
+    if (_searchesUsedToday + _searchesReserved >= _dailyLimit) return false;
+    _updateQuota(() => _searchesReserved++);
+    return true;
+  }
+
+  @override
+  void release() {
+    if (!_isExempt) _updateQuota(() => _searchesReserved--);
+  }
+
+  @override
+  int? commit() {
+    if (_isExempt) return null;
+    _updateQuota(() {
+      _searchesReserved--;
+      _searchesUsedToday++;
+    });
+    _scheduleSnapshotSave();
+    return _searchesUsedToday;
+  }
+
+  void _updateQuota(VoidCallback change) => mounted ? setState(change) : change();
+
+  Future<void> _startBatch() async {
+    // Searches count against the quota in Firestore, which is not up yet.
+    if (!widget.online) {
+      ScaffoldMessenger.of(context).showSnackBar(
+        const SnackBar(content: Text("Still connecting, please try again in a moment.")),
       );
+      return;
+    }
+    if (_batch?.isRunning ?? false) return;
+
+    final queries = await showBatchInputDialog(
+      context,
+      remaining: _isExempt ? null : _dailyLimit - _searchesUsedToday - _searchesReserved,
+    );
+    if (queries == null || queries.isEmpty || !mounted) return;
+
+    _batch?.dispose();
+    final batch = ResearchBatch(
+      queries: queries,
+      gemini: _geminiService,
+      cache: _responseCache,
+      quota: this,
+      template: _profilePromptTemplate,
+      // Each answer joins the history as soon as it arrives.
+      onAnswer: (query, response, searchesToday) => _saveToHistory(query, response, searchesToday: searchesToday),
+    );
+    setState(() => _batch = batch);
+    batch.start();
+    _showBatch();
+  }
+
+  void _showBatch() {
+    final batch = _batch;
+    if (batch == null) return;
+    showModalBottomSheet<void>(
+      context: context,
+      isScrollControlled: true,
+      backgroundColor: const Color(0xFF2C2C2C),
+      builder: (context) => BatchProgressSheet(
+        batch: batch,
+        onOpen: (item) {
+          Navigator.of(context).pop();
+          _openBatchItem(item);
+        },
+        onNewBatch: () {
+          Navigator.of(context).pop();
+          _startBatch();
+        },
+      ),
+    );
+  }
+
+  void _openBatchItem(BatchItem item) {
+    final response = item.response;
+    if (response == null) return;
+    setState(() {
+      _controller.text = item.query;
+      _errorMessage = null;
+      _response = response;
     });
-    Navigator.of(context).pop(); // Close drawer
+    SourceResolverService.resolve(response.sources);
+    _scheduleSnapshotSave();
   }
 
 Future<void> _performSearch() async {
     final String query = _controller.text.trim();
-    if (query.isEmpty) return;
+    if (query.isEmpty || _searchInFlight) return;
+    // Searches count against the quota in Firestore, which is not up yet.
+    if (!widget.online) {
+      ScaffoldMessenger.of(context).showSnackBar(
+        const SnackBar(content: Text("Still connecting, please try again in a moment.")),
+      );
+      return;
+    }
+
+    _searchInFlight = true;
+    try {
+      await _runSearch(query);
+    } finally {
+      _searchInFlight = false;
+    }
+  }
+
+  Future<void> _runSearch(String query) async {
+    // --- CACHE CHECK ---
+    // A cached answer is served from disk and does not use a daily search.
+    final cached = await _responseCache.lookup(query, _profilePromptTemplate);
+    if (cached != null) {
+      if (!mounted) return;
+      setState(() {
+        _errorMessage = null;
+        _response = cached;
+      });
+      SourceResolverService.resolve(cached.sources);
+      _saveToHistory(query, cached);
+      _scheduleSnapshotSave();
+      return;
+    }
+    if (!mounted) return;
+
+    // --- DUPLICATE CHECK ---
+    if (!await _confirmNewSearch(query) || !mounted) return;
 
     // --- LIMIT CHECK ---
-    if (!_isExempt && _searchesUsedToday >= _dailyLimit) {
+    if (!_isExempt && _searchesUsedToday + _searchesReserved >= _dailyLimit) {
       showDialog(
         context: context,
         builder: (context) => AlertDialog(
@@ -351,109 +917,75 @@ Future<void> _performSearch() async {
         debugPrint("UI Cleanup non-fatal error: $uiErr");
       }
 
-      final profilePrompt = """
-        Conduct a web search for the professional profile of: $query
-        Extract the following details and present them in a clean, readable format:
-        - Full Name
-        - Current Designation/Job Title
-        - Department
-        - University or Affiliation
-        - Contact Emails (list all found)
-        - Research Interests or Key Achievements
-        - Education History
-        - Location
-
-        RULES:
-        1. Each field's heading MUST be bold using double asterisks and followed by a colon, e.g., "**Full Name**: John Doe". 
-        2. After each field, have a new line for better formatting.
-        3. DO NOT include introductory lines like "Here is the professional profile..." or "Based on my research".
-        4. Provide ONLY the required details and nothing else.
-        5. Finally, provide a short professional summary with the specific heading "**Summary**".
-      """;
+      final profilePrompt = _profilePromptTemplate.replaceAll('{query}', query);
 
-      final result = await _geminiService.performGroundedSearch(profilePrompt).timeout(const Duration(seconds: 45)); 
-      await _saveToHistory(query, result);
-      await _updateUsageCount();
+      // Render the answer as it streams in, at most once a frame. The
+      // search as a whole has a deadline, retries and rate limiting included.
+      GeminiResponse? result;
+      await for (final partial in _geminiService.streamGroundedSearch(profilePrompt)) {
+        result = partial;
+        _showPartial(partial);
+      }
+      if (result == null) throw Exception('Empty response from Gemini');
+      SourceResolverService.resolve(result.sources);
 
+      // The answer is shown in the next frame; storing it and counting the
+      // search against the quota happen behind it. The count goes up here,
+      // before any await, so the limit check of the next search sees it.
+      final counted = !_isExempt && FirebaseAuth.instance.currentUser != null;
+      if (counted) _searchesUsedToday++;
       if (mounted) {
         setState(() {
           _response = result;
           _isLoading = false;
         });
       }
+      _responseCache.store(query, _profilePromptTemplate, result);
+      _saveToHistory(query, result, searchesToday: counted ? _searchesUsedToday : null);
+      _scheduleSnapshotSave();
     } catch (e) {
       _handleError(e);
     } finally {
+      // The whole answer, or none, is on screen now.
+      _pendingPartial = null;
       if (mounted && _isLoading) {
         setState(() => _isLoading = false);
       }
     }
   }
 
-  String _convertToHtml(String markdown) {
-    RegExp boldExp = RegExp(r'\*\*(.*?)\*\*');
-    String html = markdown.replaceAllMapped(boldExp, (match) => '<b>${match.group(1)}</b>');
-    List<String> lines = html.split('\n');
-    List<String> processedLines = [];
-    for (var line in lines) {
-      String l = line.trim();
-      if (l.isEmpty) {
-        processedLines.add('<br/>');
-      } else {
-        processedLines.add('<div>$l</div>');
-      }
-    }
-    return processedLines.join('');
+  void _showPartial(GeminiResponse partial) {
+    final scheduled = _pendingPartial != null;
+    _pendingPartial = partial;
+    if (scheduled) return;
+    SchedulerBinding.instance.scheduleFrameCallback((_) {
+      final partial = _pendingPartial;
+      _pendingPartial = null;
+      if (partial != null && mounted) setState(() => _response = partial);
+    });
   }
 
   Future<void> _generateAndDownloadPdf() async {
     if (_response == null) return;
-    try {
-      final pdf = pw.Document();
-      final htmlContent = _convertToHtml(_response!.answer);
-      final pdfWidgets = await hp.HTMLToPdf().convert(htmlContent);
-
-      pdf.addPage(
-        pw.MultiPage(
-          pageFormat: PdfPageFormat.a4,
-          margin: const pw.EdgeInsets.all(32),
-          build: (pw.Context context) {
-            return [
-              pw.Header(
-                level: 0,
-                child: pw.Row(
-                  mainAxisAlignment: pw.MainAxisAlignment.spaceBetween,
-                  children: [
-                    pw.Text("EchoLens Profile Report", 
-                      style: pw.TextStyle(fontSize: 22, fontWeight: pw.FontWeight.bold, color: PdfColors.amber800)),
-                    pw.Text(DateTime.now().toString().split(' ')[0], 
-                      style: const pw.TextStyle(fontSize: 10, color: PdfColors.grey)),
-                  ],
-                ),
-              ),
-              pw.SizedBox(height: 20),
-              ...pdfWidgets,
-              pw.SizedBox(height: 30),
-              pw.Divider(thickness: 0.5, color: PdfColors.grey300),
-              pw.Align(
-                alignment: pw.Alignment.centerRight,
-                child: pw.Text("Generated by EchoLens", 
-                  style: const pw.TextStyle(fontSize: 8, color: PdfColors.grey)),
-              ),
-            ];
-          },
-        ),
-      );
+    await FrameStats.during('pdf_export', () => PdfUtils.generateAndDownloadPdf(context, _response!, _controller.text));
+  }
 
-      await Printing.layoutPdf(
-        onLayout: (PdfPageFormat format) async => pdf.save(),
-        name: 'Profile_${_controller.text.replaceAll(' ', '_')}.pdf',
-      );
-    } catch (e) {
-      if (mounted) {
-        ScaffoldMessenger.of(context).showSnackBar(SnackBar(content: Text("PDF Error: $e")));
-      }
-    }
+  Widget _buildSourceTile(SearchResult source, Color brandColor) {
+    final resolved = SourceResolverService.lookup(source.url);
+    final icon = resolved?.icon;
+    return ListTile(
+      contentPadding: EdgeInsets.zero,
+      leading: icon != null
+          ? Image.memory(icon, width: 18, height: 18, gaplessPlayback: true,
+              errorBuilder: (context, error, stack) => Icon(Icons.link, color: brandColor, size: 18))
+          : Icon(Icons.link, color: brandColor, size: 18),
+      title: Text(source.title, style: const TextStyle(color: Colors.white70, fontSize: 14)),
+      subtitle: resolved != null && resolved.domain.isNotEmpty
+          ? Text(resolved.domain, style: const TextStyle(color: Colors.white38, fontSize: 12))
+          : null,
+      // Skips the redirect when the source was resolved.
+      onTap: () => _launchURL(resolved?.finalUrl ?? source.url),
+    );
   }
 
   Future<void> _launchURL(String url) async {
@@ -469,31 +1001,46 @@ Future<void> _performSearch() async {
     }
   }
 
+  // Occurrences of [filter] in [text] as UTF-16 start/end pairs, for
+  // platforms without the runner's matcher. Lowercasing can change the
+  // length of some text, whose offsets would then be wrong; it is not
+  // highlighted.
+  static List<int> _substringRanges(String text, String filter) {
+    final lowerText = text.toLowerCase();
+    if (filter.isEmpty || lowerText.length != text.length) return const [];
+    final ranges = <int>[];
+    int start = 0;
+    int index;
+    while ((index = lowerText.indexOf(filter, start)) != -1) {
+      ranges..add(index)..add(index + filter.length);
+      start = index + filter.length;
+    }
+    return ranges;
+  }
+
     // --- HIGHLIGHTING LOGIC ---
-  Widget _buildHighlightedText(String text, String query, Color brandColor) {
-    if (query.isEmpty) {
+  Widget _buildHighlightedText(String text, List<int>? ranges, Color brandColor) {
+    if (ranges == null || ranges.isEmpty) {
       return Text(text, style: const TextStyle(color: Colors.white, fontSize: 13));
     }
 
     final List<TextSpan> spans = [];
-    final String lowerText = text.toLowerCase();
-    final String lowerQuery = query.toLowerCase();
     int start = 0;
-    int indexOfHighlight;
-
-    while ((indexOfHighlight = lowerText.indexOf(lowerQuery, start)) != -1) {
-      if (indexOfHighlight > start) {
-        spans.add(TextSpan(text: text.substring(start, indexOfHighlight)));
+    for (int i = 0; i + 1 < ranges.length; i += 2) {
+      final rangeStart = ranges[i].clamp(start, text.length);
+      final rangeEnd = ranges[i + 1].clamp(rangeStart, text.length);
+      if (rangeStart > start) {
+        spans.add(TextSpan(text: text.substring(start, rangeStart)));
       }
       spans.add(TextSpan(
-        text: text.substring(indexOfHighlight, indexOfHighlight + query.length),
+        text: text.substring(rangeStart, rangeEnd),
         style: TextStyle(
           color: Colors.white, 
           fontWeight: FontWeight.bold, 
           backgroundColor: brandColor.withValues(alpha: 0.5) // Highlight color
         ),
       ));
-      start = indexOfHighlight + query.length;
+      start = rangeEnd;
     }
 
     if (start < text.length) {
@@ -511,10 +1058,10 @@ Future<void> _performSearch() async {
   @override
   Widget build(BuildContext context) {
     const brandColor = Color.fromARGB(255, 212, 160, 24);
-    final user = FirebaseAuth.instance.currentUser;
 
     return Scaffold(
       backgroundColor: const Color(0xFF1C1C1C),
+      onDrawerChanged: (open) => open ? FrameStats.enter('drawer') : FrameStats.leave('drawer'),
       drawer: Drawer(
         backgroundColor: const Color.fromARGB(255, 27, 27, 27),
         child: Column(
@@ -568,7 +1115,7 @@ Future<void> _performSearch() async {
                           overflow: TextOverflow.ellipsis,
                         ),
                         Text(
-                          user?.email ?? "Guest",
+                          _email ?? "Guest",
                           style: const TextStyle(color: Colors.white70, fontSize: 13),
                           overflow: TextOverflow.ellipsis,
                         ),
@@ -576,7 +1123,7 @@ Future<void> _performSearch() async {
                           Padding(
                             padding: const EdgeInsets.only(top: 4),
                             child: Text(
-                              "Searches remaining: ${_dailyLimit - _searchesUsedToday}",
+                              "Searches remaining: ${_dailyLimit - _searchesUsedToday - _searchesReserved}",
                               style: const TextStyle(color: Colors.white70, fontSize: 12, fontWeight: FontWeight.w600),
                             ),
                           ),
@@ -618,60 +1165,77 @@ Future<void> _performSearch() async {
                 mainAxisAlignment: MainAxisAlignment.spaceBetween,
                 children: [
                   const Text("Past Researches", style: TextStyle(color: brandColor, fontSize: 16, fontWeight: FontWeight.bold)),
-                  TextButton(
-                    onPressed: _clearAllHistory,
-                    child: const Text("Clear All", style: TextStyle(color: Colors.redAccent, fontSize: 12)),
+                  Row(
+                    mainAxisSize: MainAxisSize.min,
+                    children: [
+                      if (PdfUtils.supportsBatchExport)
+                        TextButton(
+                          onPressed: _exportHistory,
+                          child: const Text("Export", style: TextStyle(color: brandColor, fontSize: 12)),
+                        ),
+                      TextButton(
+                        onPressed: _clearAllHistory,
+                        child: const Text("Clear All", style: TextStyle(color: Colors.redAccent, fontSize: 12)),
+                      ),
+                    ],
                   ),
                 ],
               ),
             ),
             Expanded(
-              child: StreamBuilder<QuerySnapshot>(
-                stream: FirebaseFirestore.instance
-                    .collection('users')
-                    .doc(user?.uid)
-                    .collection('history')
-                    .orderBy('timestamp', descending: true)
-                    .limit(30)
-                    .snapshots(),
-                builder: (context, snapshot) {
-                  if (snapshot.hasError) return const Center(child: Text("Error loading history", style: TextStyle(color: Colors.white54)));
-                  if (snapshot.connectionState == ConnectionState.waiting) return const Center(child: CircularProgressIndicator(color: brandColor));
+              child: Builder(
+                builder: (context) {
+                  if (_historyFailed) return const Center(child: Text("Error loading history", style: TextStyle(color: Colors.white54)));
+                  if (_historyLoading) return const Center(child: CircularProgressIndicator(color: brandColor));
                   
-                  final docs = snapshot.data?.docs ?? [];
-                  if (docs.isEmpty) return const Center(child: Text("No search history yet", style: TextStyle(color: Colors.white54)));
-
-                  // Filter documents locally based on search text
-                  final filteredDocs = docs.where((doc) {
-                    final data = doc.data() as Map<String, dynamic>;
-                    final query = (data['query'] ?? '').toString().toLowerCase();
-                    return query.contains(_historyFilter);
-                  }).toList();
+                  if (_history.isEmpty) return const Center(child: Text("No search history yet", style: TextStyle(color: Colors.white54)));
 
-                  if (filteredDocs.isEmpty) {
+                  final filteredHistory = _visibleHistory();
+                  if (filteredHistory.isEmpty) {
                     return const Center(child: Text("No matching history found", style: TextStyle(color: Colors.white24)));
                   }
 
                   return ListView.builder(
                     padding: EdgeInsets.zero,
-                    itemCount: filteredDocs.length,
+                    itemCount: filteredHistory.length,
                     itemBuilder: (context, index) {
-                      final doc = filteredDocs[index];
-                      final data = doc.data() as Map<String, dynamic>;
+                      final entry = filteredHistory[index];
+                      // Only collapsed while the drawer is not filtered.
+                      final olderVersions = _historyMatches == null ? _olderVersions[entry.id] : null;
+                      final versions = olderVersions != null ? olderVersions.length + 1 : null;
+                      final isOlderVersion = _historyMatches == null && _duplicateOf.containsKey(entry.id);
+                      final date = entry.timestamp != null ? entry.timestamp!.toString().split(' ')[0] : '';
                       return ListTile(
-                        leading: const Icon(Icons.description_outlined, color: brandColor, size: 20),
-                        title: _buildHighlightedText(data['query'] ?? 'Unknown', _historyFilter, brandColor),
+                        contentPadding: EdgeInsets.only(left: isOlderVersion ? 40 : 16, right: 8),
+                        leading: Icon(isOlderVersion ? Icons.subdirectory_arrow_right : Icons.description_outlined, color: brandColor, size: 20),
+                        title: _buildHighlightedText(entry.query, _historyHighlights[entry.id], brandColor),
                         subtitle: Text(
-                          data['timestamp'] != null 
-                            ? (data['timestamp'] as Timestamp).toDate().toString().split(' ')[0]
-                            : '', 
+                          versions != null ? "$date · $versions versions" : date,
                           style: const TextStyle(color: Colors.white30, fontSize: 10)
                         ),
-                        trailing: IconButton(
-                          icon: const Icon(Icons.delete_outline, color: Colors.white24, size: 18),
-                          onPressed: () => _deleteHistoryItem(doc.id),
+                        trailing: Row(
+                          mainAxisSize: MainAxisSize.min,
+                          children: [
+                            if (versions != null)
+                              IconButton(
+                                icon: Icon(
+                                  _expandedDuplicates.contains(entry.id) ? Icons.expand_less : Icons.expand_more,
+                                  color: Colors.white38,
+                                  size: 18,
+                                ),
+                                tooltip: "Earlier versions",
+                                onPressed: () => setState(() {
+                                  if (!_expandedDuplicates.remove(entry.id)) _expandedDuplicates.add(entry.id);
+                                  _expandedDuplicatesVersion++;
+                                }),
+                              ),
+                            IconButton(
+                              icon: const Icon(Icons.delete_outline, color: Colors.white24, size: 18),
+                              onPressed: () => _deleteHistoryItem(entry.id),
+                            ),
+                          ],
                         ),
-                        onTap: () => _loadFromHistory(data),
+                        onTap: () => _loadFromHistory(entry),
                       );
                     },
                   );
@@ -705,6 +1269,8 @@ Future<void> _performSearch() async {
                       leading: const Icon(Icons.logout, color: Colors.white38),
                       title: const Text("Logout", style: TextStyle(color: Colors.white38)),
                       onTap: () async {
+                        if (!widget.online) return;
+                        await _forgetSession();
                         await FirebaseAuth.instance.signOut();
                       },
                     ),
@@ -723,7 +1289,28 @@ Future<void> _performSearch() async {
         title: const Text("EchoLens", style: TextStyle(fontWeight: FontWeight.w900)),
         centerTitle: true,
         actions: [
-          if (_response != null)
+          if (_batch == null)
+            IconButton(
+              color: brandColor,
+              icon: const Icon(Icons.playlist_add),
+              onPressed: _startBatch,
+              tooltip: "Batch Research",
+            )
+          else
+            ListenableBuilder(
+              listenable: _batch!,
+              builder: (context, _) => IconButton(
+                color: brandColor,
+                icon: Badge(
+                  isLabelVisible: _batch!.isRunning,
+                  label: Text("${_batch!.count(BatchItemStatus.done)}/${_batch!.items.length}"),
+                  child: const Icon(Icons.playlist_add_check),
+                ),
+                onPressed: _showBatch,
+                tooltip: "Batch Research",
+              ),
+            ),
+          if (_response != null && !_isLoading)
              IconButton(
               color: brandColor,
               icon: const Icon(Icons.picture_as_pdf),
@@ -741,6 +1328,7 @@ Future<void> _performSearch() async {
                 Expanded(
                   child: TextField(
                     controller: _controller,
+                    focusNode: _searchFocus,
                     decoration: InputDecoration(
                       hintText: "e.g. Dr. John Doe at MIT",
                       hintStyle: const TextStyle(color: Colors.white38),
@@ -791,7 +1379,7 @@ Future<void> _performSearch() async {
                 ),
               ),
             Expanded(
-              child: _isLoading 
+              child: _isLoading && _response == null
                 ? const Center(child: CircularProgressIndicator(color: brandColor))
                 : (_response == null 
                     ? Center(
@@ -821,26 +1409,23 @@ Future<void> _performSearch() async {
                             shape: RoundedRectangleBorder(borderRadius: BorderRadius.circular(12)),
                             child: Padding(
                               padding: const EdgeInsets.all(20.0),
-                              child: MarkdownBody(
-                                data: _response!.answer,
-                                selectable: true,
-                                styleSheet: MarkdownStyleSheet(
-                                  p: const TextStyle(color: Color.fromARGB(255, 205, 205, 205), fontSize: 15, height: 1.6),
-                                  strong: const TextStyle(color: Colors.white, fontWeight: FontWeight.bold),
-                                ),
-                              ),
+                              // Parsed and laid out once per response, not on
+                              // every setState of the screen.
+                              child: AnswerView(response: _response!),
                             ),
                           ),
                           const SizedBox(height: 20),
                           if (_response!.sources.isNotEmpty) ...[
                             const Text("Web Pages Scraped", style: TextStyle(fontSize: 18, fontWeight: FontWeight.bold, color: brandColor)),
                             const SizedBox(height: 8),
-                            ..._response!.sources.map((source) => ListTile(
-                              contentPadding: EdgeInsets.zero,
-                              leading: const Icon(Icons.link, color: brandColor, size: 18),
-                              title: Text(source.title, style: const TextStyle(color: Colors.white70, fontSize: 14)),
-                              onTap: () => _launchURL(source.url),
-                            )),
+                            // Domains and icons fill in as the runner
+                            // resolves the sources.
+                            ValueListenableBuilder<int>(
+                              valueListenable: SourceResolverService.changes,
+                              builder: (context, _, __) => Column(
+                                children: [for (final source in _response!.sources) _buildSourceTile(source, brandColor)],
+                              ),
+                            ),
                           ],
                         ],
                       )),
@@ -1,5 +1,6 @@
 import 'package:flutter/material.dart';
 import 'package:firebase_auth/firebase_auth.dart';
+import '../services/frame_stats.dart';
 import 'registration_screen.dart'; // Ensure this path is correct
 
 class LoginScreen extends StatefulWidget {
@@ -15,6 +16,18 @@ class _LoginScreenState extends State<LoginScreen> {
   bool _isLoading = false;
   String? _errorMessage;
 
+  @override
+  void initState() {
+    super.initState();
+    FrameStats.enter('login');
+  }
+
+  @override
+  void dispose() {
+    FrameStats.leave('login');
+    super.dispose();
+  }
+
   Future<void> _submit() async {
     setState(() {
       _isLoading = true;
@@ -0,0 +1,92 @@
+import 'package:flutter/material.dart';
+
+import '../services/frame_stats.dart';
+import '../widgets/tiled_report_preview.dart';
+
+/// Shows a report before it is printed or saved, at the zoom the user picks.
+class ReportPreviewScreen extends StatefulWidget {
+  final String title;
+  final String date;
+  final String markdown;
+  final String footer;
+
+  /// Prints or saves the report; the screen shows a spinner meanwhile.
+  final Future<void> Function(BuildContext context) onPrint;
+
+  const ReportPreviewScreen({
+    super.key,
+    required this.title,
+    required this.date,
+    required this.markdown,
+    required this.footer,
+    required this.onPrint,
+  });
+
+  @override
+  State<ReportPreviewScreen> createState() => _ReportPreviewScreenState();
+}
+
+class _ReportPreviewScreenState extends State<ReportPreviewScreen> {
+  static const List<double> _zooms = [0.5, 0.75, 1, 1.5, 2, 3, 4];
+
+  int _zoom = 2;
+  bool _printing = false;
+
+  @override
+  void initState() {
+    super.initState();
+    FrameStats.enter('pdf_preview');
+  }
+
+  @override
+  void dispose() {
+    FrameStats.leave('pdf_preview');
+    super.dispose();
+  }
+
+  Future<void> _print() async {
+    setState(() => _printing = true);
+    try {
+      await widget.onPrint(context);
+    } finally {
+      if (mounted) setState(() => _printing = false);
+    }
+  }
+
+  @override
+  Widget build(BuildContext context) {
+    const brandColor = Color.fromARGB(255, 212, 160, 24);
+    return Scaffold(
+      backgroundColor: Colors.grey[900],
+      appBar: AppBar(
+        title: const Text("Report Preview"),
+        actions: [
+          IconButton(
+            icon: const Icon(Icons.zoom_out),
+            tooltip: "Zoom out",
+            onPressed: _zoom > 0 ? () => setState(() => _zoom--) : null,
+          ),
+          Center(child: Text("${(_zooms[_zoom] * 100).round()}%")),
+          IconButton(
+            icon: const Icon(Icons.zoom_in),
+            tooltip: "Zoom in",
+            onPressed: _zoom < _zooms.length - 1 ? () => setState(() => _zoom++) : null,
+          ),
+          _printing
+              ? const Padding(
+                  padding: EdgeInsets.symmetric(horizontal: 16),
+                  child: SizedBox(width: 20, height: 20, child: CircularProgressIndicator(strokeWidth: 2, color: brandColor)),
+                )
+              : IconButton(icon: const Icon(Icons.print), tooltip: "Print or save", onPressed: _print),
+        ],
+      ),
+      body: TiledReportPreview(
+        title: widget.title,
+        date: widget.date,
+        markdown: widget.markdown,
+        footer: widget.footer,
+        zoom: _zooms[_zoom],
+      ),
+    );
+  }
+}
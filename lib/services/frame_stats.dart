@@ -0,0 +1,118 @@
+import 'dart:developer';
+import 'dart:io';
+import 'dart:typed_data';
+import 'package:flutter/foundation.dart';
+import 'package:flutter/scheduler.dart';
+import 'package:flutter/services.dart';
+
+/// Reports Flutter's frame timings to the Linux runner, which keeps
+/// histograms of them per screen beside the present times of its GTK frame
+/// clock. The runner writes them as JSON at exit, on SIGUSR1 and on [dump],
+/// to `ECHOLENS_FRAME_STATS=<path>` or frame_stats.json in its cache
+/// directory.
+///
+/// Screens are a stack: [enter] a screen when it shows, [leave] it when it
+/// goes, and frames belong to the one entered last, such as "drawer" over
+/// "search". Off Linux nothing is recorded.
+class FrameStats {
+  static const MethodChannel _channel = MethodChannel('echolens/frame_stats');
+
+  static const String _defaultScreen = 'startup';
+  // Screen changes kept to attribute frames reported late.
+  static const int _maxChanges = 64;
+
+  static final List<String> _stack = [];
+  // When each screen started, on the Timeline.now clock that FrameTiming
+  // timestamps use too.
+  static final List<(int, String)> _changes = [(0, _defaultScreen)];
+  static bool _started = false;
+
+  static bool get _hasNativeRunner => !kIsWeb && Platform.isLinux;
+
+  static String get _current => _stack.isEmpty ? _defaultScreen : _stack.last;
+
+  /// Starts reporting frame timings. Needs the binding to be initialized.
+  static void start() {
+    if (!_hasNativeRunner || _started) return;
+    _started = true;
+    SchedulerBinding.instance.addTimingsCallback(_report);
+  }
+
+  static void enter(String screen) {
+    _stack.add(screen);
+    _changed();
+  }
+
+  static void leave(String screen) {
+    final index = _stack.lastIndexOf(screen);
+    if (index < 0) return;
+    _stack.removeAt(index);
+    _changed();
+  }
+
+  /// Runs [body] with [screen] entered, e.g. around an export.
+  static Future<T> during<T>(String screen, Future<T> Function() body) async {
+    enter(screen);
+    try {
+      return await body();
+    } finally {
+      leave(screen);
+    }
+  }
+
+  /// Writes the histograms and returns them as JSON, or null off Linux.
+  static Future<String?> dump() async {
+    if (!_hasNativeRunner) return null;
+    try {
+      return await _channel.invokeMethod<String>('dump');
+    } on PlatformException catch (e) {
+      debugPrint("Frame stats dump failed: ${e.message}");
+      return null;
+    }
+  }
+
+  /// Clears the histograms, e.g. before measuring a single interaction.
+  static Future<void> reset() => _invoke('reset');
+
+  static void _changed() {
+    final screen = _current;
+    if (_changes.last.$2 == screen) return;
+    _changes.add((Timeline.now, screen));
+    if (_changes.length > _maxChanges) _changes.removeAt(0);
+    _invoke('setScreen', {'screen': screen});
+  }
+
+  static String _screenAt(int micros) {
+    for (var i = _changes.length - 1; i > 0; i--) {
+      if (_changes[i].$1 <= micros) return _changes[i].$2;
+    }
+    return _changes.first.$2;
+  }
+
+  static void _report(List<FrameTiming> timings) {
+    final screens = <String>[];
+    final frames = Int64List(timings.length * 3);
+    for (var i = 0; i < timings.length; i++) {
+      final timing = timings[i];
+      final screen = _screenAt(timing.timestampInMicroseconds(FramePhase.buildStart));
+      var index = screens.indexOf(screen);
+      if (index < 0) {
+        index = screens.length;
+        screens.add(screen);
+      }
+      frames[i * 3] = index;
+      frames[i * 3 + 1] = timing.buildDuration.inMicroseconds;
+      frames[i * 3 + 2] = timing.rasterDuration.inMicroseconds;
+    }
+    _invoke('addFrames', {'screens': screens, 'frames': frames});
+  }
+
+  static Future<void> _invoke(String method, [Object? arguments]) async {
+    if (!_hasNativeRunner) return;
+    try {
+      await _channel.invokeMethod<void>(method, arguments);
+    } on PlatformException catch (e) {
+      debugPrint("Frame stats $method failed: ${e.message}");
+    }
+  }
+}
@@ -1,72 +1,405 @@
+import 'dart:async';
+import 'dart:collection';
 import 'dart:convert';
+import 'dart:io';
+import 'package:flutter/foundation.dart';
+import 'package:flutter/services.dart';
 import 'package:http/http.dart' as http;
 import 'package:flutter_dotenv/flutter_dotenv.dart';
 
+import '../models/markdown_document.dart';
+
+/// Where the time of a native request went, as measured by the runner for its
+/// last attempt. Phases skipped on a reused connection are zero.
+class GeminiRequestMetrics {
+  final int dnsMs;
+  final int connectMs;
+  final int tlsMs;
+  final int ttfbMs;
+  final int totalMs;
+  final bool reused;
+  final int httpVersion;
+
+  GeminiRequestMetrics.fromMap(Map<dynamic, dynamic> map)
+      : dnsMs = map['dnsMs'] as int,
+        connectMs = map['connectMs'] as int,
+        tlsMs = map['tlsMs'] as int,
+        ttfbMs = map['ttfbMs'] as int,
+        totalMs = map['totalMs'] as int,
+        reused = map['reused'] as bool,
+        httpVersion = map['httpVersion'] as int;
+
+  @override
+  String toString() => 'HTTP/$httpVersion ${reused ? 'reused' : 'new'} connection: '
+      'dns ${dnsMs}ms, connect ${connectMs}ms, tls ${tlsMs}ms, '
+      'first byte ${ttfbMs}ms, total ${totalMs}ms';
+}
+
+/// A request the Gemini API turned down. [retryAfter] is how long the server
+/// asked to wait before trying again, when it said.
+class GeminiApiException implements Exception {
+  final int status;
+  final String message;
+  final Duration? retryAfter;
+
+  const GeminiApiException(this.status, this.message, {this.retryAfter});
+
+  @override
+  String toString() => 'API Error: $status - $message';
+}
+
 class GeminiService {
-  static const String _baseUrl = 'https://generativelanguage.googleapis.com/v1beta/models/gemini-2.5-flash:generateContent';
+  static const String _defaultModelUrl = 'https://generativelanguage.googleapis.com/v1beta/models/gemini-2.5-flash';
 
-  Future<GeminiResponse> performGroundedSearch(String userQuery) async {
+  // Native streaming client registered by the Linux runner.
+  static const MethodChannel _streamChannel = MethodChannel('echolens/gemini_stream');
+  static const EventChannel _streamEventChannel = EventChannel('echolens/gemini_stream/events');
+  static final Stream<dynamic> _streamEvents = _streamEventChannel.receiveBroadcastStream();
+  static int _nextStreamId = 0;
+
+  /// Timings of the last request that reached the network on Linux.
+  static GeminiRequestMetrics? lastRequestMetrics;
+
+  // Native two-stage JSON scanner; replies with the packed answer and sources.
+  static const MethodChannel _parserChannel = MethodChannel('echolens/gemini_parser');
+
+  // How long a whole search may take, retries and rate limiting included.
+  static const Duration defaultDeadline = Duration(minutes: 2);
+
+  // Queued searches waiting on the API at the same time.
+  static const int defaultParallelism = 4;
+
+  /// The answer shown when Gemini returned no text.
+  static const String noAnswer = "No response generated.";
+
+  static bool get _hasNativeRunner => !kIsWeb && Platform.isLinux;
+
+  // GEMINI_BASE_URL lets the app talk to a local stand-in server instead of Google.
+  String get _modelUrl {
+    final override = dotenv.env['GEMINI_BASE_URL'];
+    return (override == null || override.isEmpty) ? _defaultModelUrl : override;
+  }
+
+  String _requireApiKey() {
     final apiKey = dotenv.env['GEMINI_API_KEY'];
     if (apiKey == null || apiKey.isEmpty) {
       throw Exception('GEMINI_API_KEY is missing in .env');
     }
+    return apiKey;
+  }
 
-    final url = Uri.parse('$_baseUrl?key=$apiKey');
+  String _requestBody(String userQuery) {
+    return jsonEncode({
+      "contents": [
+        {
+          "parts": [
+            {"text": userQuery}
+          ]
+        }
+      ],
+      // This tool triggers the "Google Search" behavior server-side
+      "tools": [
+        {"google_search": {}}
+      ]
+    });
+  }
+
+  Future<GeminiResponse> performGroundedSearch(String userQuery) async {
+    final apiKey = _requireApiKey();
+
+    final url = Uri.parse('$_modelUrl:generateContent?key=$apiKey');
 
     final response = await http.post(
       url,
       headers: {'Content-Type': 'application/json'},
-      body: jsonEncode({
-        "contents": [
-          {
-            "parts": [
-              {"text": userQuery}
-            ]
-          }
-        ],
-        // This tool triggers the "Google Search" behavior server-side
-        "tools": [
-          {"google_search": {}}
-        ]
-      }),
+      body: _requestBody(userQuery),
     );
 
     if (response.statusCode == 200) {
-      return _parseResponse(jsonDecode(response.body));
+      if (_hasNativeRunner) {
+        final packed = await _parserChannel.invokeMethod<Uint8List>('parse', response.bodyBytes);
+        return _responseFrom((answer, sources) => _applyPacked(packed!, answer, sources));
+      }
+      return parseResponseBody(response.body);
     } else {
-      throw Exception('API Error: ${response.statusCode} - ${response.body}');
+      final retryAfter = int.tryParse(response.headers['retry-after'] ?? '');
+      throw GeminiApiException(
+        response.statusCode,
+        response.body,
+        retryAfter: retryAfter == null ? null : Duration(seconds: retryAfter),
+      );
+    }
+  }
+
+  /// Opens a connection to the API ahead of a search, e.g. when the search
+  /// field gains focus, so that the search itself skips DNS, TCP and TLS
+  /// setup. Does nothing if the runner already holds a fresh connection.
+  void preconnect() {
+    if (!_hasNativeRunner || !dotenv.isInitialized) return;
+    _streamChannel.invokeMethod<void>('preconnect', {'url': _modelUrl}).catchError((Object e) {
+      debugPrint("Pre-connect failed: $e");
+    });
+  }
+
+  /// Streams the answer as it is generated. Every event is the response
+  /// accumulated so far; the last one is the complete response.
+  ///
+  /// On Linux the runner reads `:streamGenerateContent` over SSE natively and
+  /// forwards each chunk as it arrives. Its request scheduler rate limits,
+  /// retries 429 and 5xx responses and joins identical searches already in
+  /// flight, all within [deadline]; running out of time is reported as a
+  /// [TimeoutException]. Other platforms fall back to a single blocking
+  /// [performGroundedSearch].
+  Stream<GeminiResponse> streamGroundedSearch(String userQuery, {Duration deadline = defaultDeadline}) {
+    if (!_hasNativeRunner) {
+      return Stream.fromFuture(performGroundedSearch(userQuery).timeout(deadline));
+    }
+
+    final String apiKey;
+    try {
+      apiKey = _requireApiKey();
+    } catch (e) {
+      return Stream.error(e);
     }
+
+    final id = _nextStreamId++;
+    return _nativeSearch(id, deadline, () => _streamChannel.invokeMethod<void>('start', {
+          'id': id,
+          'url': '$_modelUrl:streamGenerateContent?alt=sse&key=$apiKey',
+          'body': _requestBody(userQuery),
+          'deadlineMs': deadline.inMilliseconds,
+        }));
+  }
+
+  /// Searches behind the other queued searches, at most [parallelism] of them
+  /// waiting on the API at a time, for batches too large to start at once.
+  /// The answer arrives whole rather than streamed; [onStarted] is called
+  /// when the search leaves the queue, and [deadline] runs from then. Cancelling
+  /// the subscription takes the search off the queue.
+  ///
+  /// On Linux the runner's queue feeds its request scheduler, so queued
+  /// searches share the rate limit with interactive ones. Other platforms
+  /// bound the number of blocking [performGroundedSearch] calls instead.
+  Stream<GeminiResponse> queueGroundedSearch(
+    String userQuery, {
+    Duration deadline = defaultDeadline,
+    int parallelism = defaultParallelism,
+    void Function()? onStarted,
+  }) {
+    if (!_hasNativeRunner) return _queueLocally(userQuery, deadline, parallelism, onStarted);
+
+    final String apiKey;
+    try {
+      apiKey = _requireApiKey();
+    } catch (e) {
+      return Stream.error(e);
+    }
+
+    final id = _nextStreamId++;
+    return _nativeSearch(id, deadline, () => _streamChannel.invokeMethod<void>('enqueue', {
+          'requests': [
+            {
+              'id': id,
+              'url': '$_modelUrl:generateContent?key=$apiKey',
+              'body': _requestBody(userQuery),
+              'deadlineMs': deadline.inMilliseconds,
+            },
+          ],
+          'parallelism': parallelism,
+        }), onStarted: onStarted);
   }
 
-  GeminiResponse _parseResponse(Map<String, dynamic> json) {
+  // Queued searches off Linux, running and waiting.
+  static int _localRunning = 0;
+  static final Queue<Completer<void>> _localWaiting = Queue<Completer<void>>();
+
+  Stream<GeminiResponse> _queueLocally(String userQuery, Duration deadline, int parallelism, void Function()? onStarted) {
+    var cancelled = false;
+    Future<GeminiResponse> run() async {
+      if (_localRunning >= parallelism) {
+        final turn = Completer<void>();
+        _localWaiting.add(turn);
+        await turn.future;
+      }
+      _localRunning++;
+      try {
+        if (cancelled) throw StateError('Cancelled');
+        onStarted?.call();
+        return await performGroundedSearch(userQuery).timeout(deadline);
+      } finally {
+        _localRunning--;
+        if (_localWaiting.isNotEmpty) _localWaiting.removeFirst().complete();
+      }
+    }
+
+    late final StreamController<GeminiResponse> controller;
+    controller = StreamController<GeminiResponse>(
+      onListen: () => run().then(controller.add, onError: controller.addError).whenComplete(controller.close),
+      onCancel: () => cancelled = true,
+    );
+    return controller.stream;
+  }
+
+  // Follows the runner's events for request [id], which [start] submits.
+  Stream<GeminiResponse> _nativeSearch(
+    int id,
+    Duration deadline,
+    Future<void> Function() start, {
+    void Function()? onStarted,
+  }) {
+    final answer = StringBuffer();
+    final sources = <SearchResult>[];
+    StreamSubscription<dynamic>? subscription;
+    bool finished = false;
+    late final StreamController<GeminiResponse> controller;
+
+    GeminiResponse snapshot() => GeminiResponse(
+          answer: answer.isEmpty ? GeminiService.noAnswer : answer.toString(),
+          sources: List.unmodifiable(sources),
+        );
+
+    void finish() {
+      finished = true;
+      subscription?.cancel();
+      controller.close();
+    }
+
+    controller = StreamController<GeminiResponse>(
+      onListen: () {
+        subscription = _streamEvents.listen((dynamic event) {
+          final Map<dynamic, dynamic> e = event as Map<dynamic, dynamic>;
+          if (e['id'] != id) return;
+          final metrics = e['metrics'];
+          if (metrics is Map) {
+            lastRequestMetrics = GeminiRequestMetrics.fromMap(metrics);
+            debugPrint("Gemini request: $lastRequestMetrics");
+          }
+          switch (e['type']) {
+            case 'started':
+              onStarted?.call();
+              break;
+            case 'data':
+              _applyPacked(e['packed'] as Uint8List, answer, sources);
+              controller.add(snapshot());
+              break;
+            case 'done':
+              controller.add(snapshot());
+              finish();
+              break;
+            case 'error':
+              controller.addError(_streamError(e, deadline));
+              finish();
+              break;
+            case 'cancelled':
+              finish();
+              break;
+          }
+        }, onError: (Object error) {
+          controller.addError(error);
+          finish();
+        });
+
+        start().catchError((Object error) {
+          controller.addError(error);
+          finish();
+        });
+      },
+      onCancel: () {
+        subscription?.cancel();
+        if (!finished) {
+          _streamChannel.invokeMethod<void>('cancel', {'id': id});
+        }
+      },
+    );
+
+    return controller.stream;
+  }
+
+  static Object _streamError(Map<dynamic, dynamic> event, Duration deadline) {
+    if (event['reason'] == 'deadline') {
+      return TimeoutException('Gemini did not answer in time', deadline);
+    }
+    final retryAfterMs = event['retryAfterMs'] as int?;
+    return GeminiApiException(
+      event['status'] as int? ?? 0,
+      event['message'] as String? ?? '',
+      retryAfter: retryAfterMs == null ? null : Duration(milliseconds: retryAfterMs),
+    );
+  }
+
+  // Parses an answer natively; null off Linux or if the runner fails, in
+  // which case the answer view falls back to MarkdownBody.
+  static Future<MarkdownDocument?> _parseMarkdown(String answer) async {
+    if (!_hasNativeRunner) return null;
+    try {
+      final packed = await _parserChannel.invokeMethod<Uint8List>('markdown', answer);
+      return packed == null ? null : MarkdownDocument.fromPacked(packed);
+    } on PlatformException catch (e) {
+      debugPrint("Markdown parse failed: ${e.message}");
+      return null;
+    }
+  }
+
+  /// The runner's request scheduler counters: requests, attempts, retries,
+  /// throttleWaits, throttleWaitMs, deadlineExceeded, dedupHits and inFlight;
+  /// its connection pool's: transfers, reusedConnections, preconnects,
+  /// preconnectsSkipped and handshakeMs; and its queue's: queued,
+  /// queueRunning, queuePeakRunning, queueDone and queueFailed.
+  static Future<Map<String, int>> schedulerStats() async {
+    if (!_hasNativeRunner) return const {};
+    final stats = await _streamChannel.invokeMapMethod<String, int>('stats');
+    return stats ?? const {};
+  }
+
+  /// Parses a complete generateContent body on the Dart side. Kept public for
+  /// benchmark/gemini_parser_benchmark.dart, which compares it to the runner.
+  @visibleForTesting
+  GeminiResponse parseResponseBody(String body) {
+    return _responseFrom((answer, sources) => _applyChunk(jsonDecode(body), answer, sources));
+  }
+
+  GeminiResponse _responseFrom(void Function(StringBuffer answer, List<SearchResult> sources) fill) {
+    final answer = StringBuffer();
+    final sources = <SearchResult>[];
+    fill(answer, sources);
+    return GeminiResponse(
+      answer: answer.isEmpty ? GeminiService.noAnswer : answer.toString(),
+      sources: sources,
+    );
+  }
+
+  /// Appends the text and grounding sources of one (possibly partial)
+  /// response to [answer] and [sources].
+  void _applyChunk(Map<String, dynamic> json, StringBuffer answer, List<SearchResult> sources) {
     // 1. Extract the main text answer
     final candidate = json['candidates']?[0];
     final contentParts = candidate?['content']?['parts'] as List?;
-    String answer = "No response generated.";
-    
-    if (contentParts != null && contentParts.isNotEmpty) {
-      answer = contentParts[0]['text'] ?? "No text found.";
+
+    if (contentParts != null) {
+      for (var part in contentParts) {
+        final text = part['text'];
+        if (text is String) answer.write(text);
+      }
     }
 
     // 2. Extract the "Grounding Metadata" (The Search Results)
-    List<SearchResult> sources = [];
     final groundingMeta = candidate?['groundingMetadata'];
-    
+
     if (groundingMeta != null) {
       final chunks = groundingMeta['groundingChunks'] as List?;
       if (chunks != null) {
         for (var chunk in chunks) {
           if (chunk.containsKey('web')) {
+            final url = chunk['web']['uri'];
+            if (sources.any((s) => s.url == url)) continue;
             sources.add(SearchResult(
               title: chunk['web']['title'],
-              url: chunk['web']['uri'],
+              url: url,
             ));
           }
         }
       }
     }
-
-    return GeminiResponse(answer: answer, sources: sources);
   }
 }
 
@@ -75,7 +408,21 @@ class GeminiResponse {
   final String answer;
   final List<SearchResult> sources;
 
+  // The parsed answer, kept with the response so that it is parsed once.
+  Future<MarkdownDocument?>? _document;
+
   GeminiResponse({required this.answer, required this.sources});
+
+  /// The answer parsed into a [MarkdownDocument] by the runner, on first use.
+  Future<MarkdownDocument?> document() => _document ??= GeminiService._parseMarkdown(answer);
+
+  /// Decodes a response packed by the Linux runner, e.g. a cache hit.
+  factory GeminiResponse.fromPacked(Uint8List packed) {
+    final answer = StringBuffer();
+    final sources = <SearchResult>[];
+    _applyPacked(packed, answer, sources);
+    return GeminiResponse(answer: answer.toString(), sources: sources);
+  }
 }
 
 class SearchResult {
@@ -83,4 +430,30 @@ class SearchResult {
   final String url;
 
   SearchResult({required this.title, required this.url});
-}
\ No newline at end of file
+}
+
+/// Appends a message packed by the runner's gemini_response_pack(): a u32
+/// answer length and UTF-8 answer, a u32 source count, then per source a
+/// u32-prefixed title and uri. All integers are little-endian.
+void _applyPacked(Uint8List packed, StringBuffer answer, List<SearchResult> sources) {
+  final data = ByteData.sublistView(packed);
+  int offset = 0;
+
+  String readString() {
+    final length = data.getUint32(offset, Endian.little);
+    offset += 4;
+    final value = utf8.decode(Uint8List.sublistView(packed, offset, offset + length), allowMalformed: true);
+    offset += length;
+    return value;
+  }
+
+  answer.write(readString());
+  final count = data.getUint32(offset, Endian.little);
+  offset += 4;
+  for (var i = 0; i < count; i++) {
+    final title = readString();
+    final url = readString();
+    if (sources.any((s) => s.url == url)) continue;
+    sources.add(SearchResult(title: title, url: url));
+  }
+}
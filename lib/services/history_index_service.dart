@@ -0,0 +1,133 @@
+import 'dart:io';
+import 'package:flutter/foundation.dart';
+import 'package:flutter/services.dart';
+
+import '../models/history_entry.dart';
+import 'history_repository.dart';
+
+/// Substring search over the research history, backed by a trigram index in
+/// the Linux runner.
+///
+/// The index mirrors the history: feed it every [HistoryDelta] of the
+/// [HistoryRepository] with [applyDelta] and query it with [search]. Matches
+/// in the query rank first, then source titles, then the answer; ties are
+/// newest first. [filter] also forgives typos and accents in the queries and
+/// reports what to highlight. Other platforms report [isAvailable] as false and callers
+/// filter in Dart instead.
+///
+/// The runner also fingerprints every record, so that [similar] can tell
+/// whether a query was researched before under other wording, and
+/// [duplicates] which records repeat one another.
+class HistoryIndexService {
+  static const MethodChannel _channel = MethodChannel('echolens/history_index');
+
+  bool get isAvailable => !kIsWeb && Platform.isLinux;
+
+  Future<void> applyDelta(HistoryDelta delta) async {
+    if (!isAvailable) return;
+    try {
+      if (delta.reset) await _channel.invokeMethod<void>('clear');
+      if (delta.upserts.isEmpty && delta.removals.isEmpty) return;
+      await _channel.invokeMethod<void>('apply', {
+        'upserts': delta.upserts.map(_record).toList(),
+        'removals': delta.removals,
+      });
+    } on PlatformException catch (e) {
+      debugPrint("History index update failed: ${e.message}");
+    }
+  }
+
+  /// Returns the ids of the records containing [query], best match first.
+  Future<List<String>> search(String query, {int limit = 0}) async {
+    if (!isAvailable) return const [];
+    final ids = await _channel.invokeListMethod<String>('search', {
+      'query': query,
+      'limit': limit,
+    });
+    return ids ?? const [];
+  }
+
+  /// Returns the records for the history drawer's filter box: those whose
+  /// query matches [query] despite typos, accents or case, best first, with
+  /// the parts to highlight; then those with [query] in their answer or
+  /// sources only, without ranges.
+  Future<List<HistoryMatch>> filter(String query, {int limit = 0}) async {
+    if (!isAvailable) return const [];
+    final matches = await _channel.invokeListMethod<Map<Object?, Object?>>('filter', {
+      'query': query,
+      'limit': limit,
+    });
+    return [
+      for (final match in matches ?? const <Map<Object?, Object?>>[])
+        HistoryMatch(match['id'] as String, (match['ranges'] as List<int>?) ?? const []),
+    ];
+  }
+
+  /// Returns the records whose query names the same person as [query], best
+  /// match first. Lookups take microseconds in the runner, so this can run
+  /// before every search.
+  Future<List<SimilarRecord>> similar(String query, {int limit = 3}) async {
+    if (!isAvailable) return const [];
+    final matches = await _channel.invokeListMethod<Map<Object?, Object?>>('similar', {
+      'query': query,
+      'limit': limit,
+    });
+    return [
+      for (final match in matches ?? const <Map<Object?, Object?>>[])
+        SimilarRecord(match['id'] as String, (match['score'] as num).toDouble()),
+    ];
+  }
+
+  /// Returns the groups of records that repeat one another, each newest
+  /// first.
+  Future<List<List<String>>> duplicates() async {
+    if (!isAvailable) return const [];
+    final groups = await _channel.invokeListMethod<List<Object?>>('duplicates');
+    return [
+      for (final group in groups ?? const <List<Object?>>[]) group.cast<String>(),
+    ];
+  }
+
+  Future<void> clear() async {
+    if (!isAvailable) return;
+    await _channel.invokeMethod<void>('clear');
+  }
+
+  /// Record and posting list sizes, as reported by the runner.
+  Future<Map<String, int>> stats() async {
+    if (!isAvailable) return const {};
+    final stats = await _channel.invokeMapMethod<String, int>('stats');
+    return stats ?? const {};
+  }
+
+  Map<String, Object?> _record(HistoryEntry entry) {
+    return {
+      'id': entry.id,
+      // Pending server timestamps are null locally; they are the newest record.
+      'timestamp': (entry.timestamp ?? DateTime.now()).millisecondsSinceEpoch,
+      'query': entry.query,
+      'answer': entry.response.answer,
+      'sources': entry.response.sources.map((s) => s.title).toList(),
+    };
+  }
+}
+
+/// A history record found by [HistoryIndexService.filter].
+class HistoryMatch {
+  final String id;
+  // Start and end offsets of the matched parts of the query, in pairs, as
+  // UTF-16 code units like String indices. Empty when only the answer or
+  // sources matched.
+  final List<int> ranges;
+
+  const HistoryMatch(this.id, this.ranges);
+}
+
+/// A history record found by [HistoryIndexService.similar].
+class SimilarRecord {
+  final String id;
+  // The share of the shorter query's words found in the other, from 0 to 1.
+  final double score;
+
+  const SimilarRecord(this.id, this.score);
+}
@@ -0,0 +1,475 @@
+import 'dart:async';
+import 'dart:collection';
+import 'dart:io';
+import 'dart:math';
+import 'package:cloud_firestore/cloud_firestore.dart';
+import 'package:flutter/foundation.dart';
+import 'package:flutter/services.dart';
+import 'package:history_arena/history_arena.dart';
+
+import '../models/history_entry.dart';
+import 'gemini_service.dart';
+
+/// A change to the history, as seen by the UI.
+class HistoryDelta {
+  final List<HistoryEntry> upserts;
+  final List<String> removals;
+  // True when the delta replaces everything delivered before it.
+  final bool reset;
+
+  const HistoryDelta({this.upserts = const [], this.removals = const [], this.reset = false});
+}
+
+/// A user's research history, offline first.
+///
+/// On Linux the runner keeps a SQLite replica that is the source of truth for
+/// the UI: reads never leave the machine and writes land in a durable journal
+/// before they are synced. A write-behind loop drains the journal to Firestore
+/// in coalesced batches, and a single long-lived listener merges changes made
+/// on other devices back into the replica. Until a local change is
+/// acknowledged upstream it wins over what Firestore reports.
+///
+/// The replica reaches Dart packed, in one message, and is kept in a native
+/// [HistoryArena] that entries read from in place, so a long history costs
+/// the Dart heap a handle per record instead of its text.
+///
+/// Searches counted against the daily quota go through the same journal, in
+/// the same transaction as the record they produced, and reach the user's
+/// document in the batch that uploads the record.
+///
+/// Other platforms read and write Firestore directly, as before, and rely on
+/// its own offline queue.
+class HistoryRepository {
+  static const MethodChannel _channel = MethodChannel('echolens/history_store');
+
+  // Firestore commits at most 500 writes per batch.
+  static const int _maxBatchOps = 500;
+  static const Duration _writeBehindDelay = Duration(milliseconds: 500);
+  static const Duration _commitTimeout = Duration(seconds: 30);
+  static const Duration _minBackoff = Duration(seconds: 2);
+  static const Duration _maxBackoff = Duration(minutes: 5);
+
+  static bool get isAvailable => !kIsWeb && Platform.isLinux;
+
+  final String uid;
+  final FirebaseFirestore _firestore;
+  final StreamController<HistoryDelta> _changes = StreamController<HistoryDelta>.broadcast();
+  // Other platforms keep the entries on the Dart heap.
+  final Map<String, HistoryEntry> _entries = {};
+  // Linux only. Replaced on a reset; the old arena is freed once the entries
+  // read from it are unreachable.
+  late HistoryArena _arena = HistoryArena();
+
+  StreamSubscription<QuerySnapshot<Map<String, dynamic>>>? _remote;
+  // Whether a server snapshot has been reconciled with the replica yet.
+  bool _reconciled = false;
+  Timer? _syncTimer;
+  bool _syncing = false;
+  bool _syncAgain = false;
+  Duration _backoff = _minBackoff;
+  bool _disposed = false;
+
+  HistoryRepository(this.uid, {FirebaseFirestore? firestore})
+      : _firestore = firestore ?? FirebaseFirestore.instance;
+
+  /// Every delta applied to [entries]. Errors are Firestore listener failures.
+  Stream<HistoryDelta> get changes => _changes.stream;
+
+  /// The history, newest first.
+  List<HistoryEntry> get entries {
+    if (isAvailable) return _ArenaEntries(_arena.snapshot());
+    final list = _entries.values.toList();
+    // Records waiting for a server timestamp are the newest.
+    list.sort((a, b) {
+      final at = a.timestamp, bt = b.timestamp;
+      if (at == null || bt == null) return (at == null ? 0 : 1) - (bt == null ? 0 : 1);
+      return bt.compareTo(at);
+    });
+    return list;
+  }
+
+  /// The entry with [id], without reading any other.
+  HistoryEntry? find(String id) {
+    if (!isAvailable) return _entries[id];
+    final record = _arena.find(id);
+    return record == null ? null : HistoryEntry.fromArena(record);
+  }
+
+  /// Whether the history already holds [answer] for [query], compared as
+  /// typed apart from case and surrounding spaces. On Linux only the records
+  /// with the same answer are read, found through the arena's index.
+  bool contains(String query, String answer) {
+    final key = query.trim().toLowerCase();
+    if (isAvailable) {
+      return _arena.withAnswer(answer).any((record) => record.query.trim().toLowerCase() == key);
+    }
+    return _entries.values.any((entry) => entry.response.answer == answer && entry.query.trim().toLowerCase() == key);
+  }
+
+  // The ids of every entry, wherever this platform keeps them.
+  Iterable<String> get _ids => isAvailable ? _arena.snapshot().map((record) => record.id) : _entries.keys;
+
+  DocumentReference<Map<String, dynamic>> get _userDoc => _firestore.collection('users').doc(uid);
+
+  CollectionReference<Map<String, dynamic>> get _collection => _userDoc.collection('history');
+
+  /// Emits the local replica, then starts listening to Firestore and syncing
+  /// whatever the journal still holds from earlier sessions.
+  Future<void> start() async {
+    if (isAvailable) {
+      try {
+        final packed = await _channel.invokeMethod<Uint8List>('list', {'uid': uid, 'packed': true});
+        final arena = HistoryArena();
+        if (packed != null) arena.load(packed);
+        _arena = arena;
+        _apply(HistoryDelta(upserts: entries, reset: true));
+      } on PlatformException catch (e) {
+        debugPrint("History replica unavailable: ${e.message}");
+      }
+    }
+    if (_disposed) return;
+    _remote = _collection
+        .orderBy('timestamp', descending: true)
+        .snapshots(includeMetadataChanges: isAvailable)
+        .listen(_onRemote, onError: (Object e) {
+      debugPrint("Failed to load history: $e");
+      if (!_changes.isClosed) _changes.addError(e);
+    });
+    _scheduleSync(Duration.zero);
+  }
+
+  Future<void> add(String query, GeminiResponse response) async {
+    if (!isAvailable) {
+      await _collection.add({
+        'query': query,
+        'answer': response.answer,
+        'sources': response.sources.map((s) => {'title': s.title, 'url': s.url}).toList(),
+        'timestamp': FieldValue.serverTimestamp(),
+      });
+      return;
+    }
+    final entry = HistoryEntry(id: '', query: query, response: response, timestamp: DateTime.now());
+    final id = await _channel.invokeMethod<String>('put', {'uid': uid, 'record': _record(entry)});
+    _apply(HistoryDelta(upserts: [
+      HistoryEntry(id: id!, query: query, response: response, timestamp: entry.timestamp),
+    ]));
+    _scheduleSync();
+  }
+
+  /// Adds a search that was just answered and, when [searchesToday] is given,
+  /// counts it against today's quota, as one durable change. Callers need not
+  /// wait for it: the count they show is already [searchesToday].
+  Future<void> addSearch(String query, GeminiResponse response, {int? searchesToday}) async {
+    if (searchesToday == null) return add(query, response);
+    final now = DateTime.now();
+    if (!isAvailable) {
+      final batch = _firestore.batch();
+      batch.set(_collection.doc(), {
+        'query': query,
+        'answer': response.answer,
+        'sources': response.sources.map((s) => {'title': s.title, 'url': s.url}).toList(),
+        'timestamp': FieldValue.serverTimestamp(),
+      });
+      batch.set(_userDoc, {
+        'searchesUsedToday': searchesToday,
+        'lastSearchDate': FieldValue.serverTimestamp(),
+      }, SetOptions(merge: true));
+      await batch.commit();
+      return;
+    }
+    final entry = HistoryEntry(id: '', query: query, response: response, timestamp: now);
+    final stored = await _channel.invokeMapMethod<String, Object?>('putSearch', {
+      'uid': uid,
+      'record': _record(entry),
+      'day': _day(now),
+    });
+    _apply(HistoryDelta(upserts: [
+      HistoryEntry(id: stored!['id'] as String, query: query, response: response, timestamp: now),
+    ]));
+    _scheduleSync();
+  }
+
+  /// The searches counted on [day]: [remote], as last read from the user's
+  /// document, or more if searches made here have not been uploaded yet.
+  Future<int> searchesOn(DateTime day, int remote) async {
+    if (!isAvailable) return remote;
+    try {
+      final searches = await _channel.invokeMethod<int>('usage', {
+        'uid': uid,
+        'day': _day(day),
+        'searches': remote,
+      });
+      return searches ?? remote;
+    } on PlatformException catch (e) {
+      debugPrint("Failed to read the search count: ${e.message}");
+      return remote;
+    }
+  }
+
+  Future<void> delete(String id) async {
+    if (!isAvailable) {
+      await _collection.doc(id).delete();
+      return;
+    }
+    await _channel.invokeMethod<void>('remove', {'uid': uid, 'id': id});
+    _apply(HistoryDelta(removals: [id]));
+    _scheduleSync();
+  }
+
+  Future<void> clearAll() async {
+    if (!isAvailable) {
+      await _deleteAllRemote();
+      return;
+    }
+    await _channel.invokeMethod<void>('clear', {'uid': uid});
+    _apply(const HistoryDelta(reset: true));
+    _scheduleSync();
+  }
+
+  /// Drops the local replica without syncing, once the account and its
+  /// history have been deleted upstream.
+  Future<void> forget() async {
+    await dispose();
+    if (!isAvailable) return;
+    try {
+      await _channel.invokeMethod<void>('forget', {'uid': uid});
+    } on PlatformException catch (e) {
+      debugPrint("Failed to drop the history replica: ${e.message}");
+    }
+  }
+
+  /// Replica and journal counters, as reported by the runner.
+  Future<Map<String, int>> stats() async {
+    if (!isAvailable) return const {};
+    final stats = await _channel.invokeMapMethod<String, int>('stats');
+    return stats ?? const {};
+  }
+
+  /// Stops listening and syncing. Journaled changes are kept for next time.
+  Future<void> dispose() async {
+    if (_disposed) return;
+    _disposed = true;
+    _syncTimer?.cancel();
+    await _remote?.cancel();
+    await _changes.close();
+  }
+
+  // Applies a change to the entries and publishes it. On Linux, upserts not
+  // read from the arena are copied into it and published as arena entries.
+  void _apply(HistoryDelta delta) {
+    if (isAvailable) {
+      if (delta.reset && delta.upserts.isEmpty) _arena = HistoryArena();
+      for (final id in delta.removals) {
+        _arena.remove(id);
+      }
+      final copies = [for (final entry in delta.upserts) if (!entry.isArenaBacked) entry];
+      if (copies.isNotEmpty) {
+        final packer = HistoryArenaPacker();
+        for (final entry in copies) {
+          packer.add(
+            id: entry.id,
+            timestampMs: (entry.timestamp ?? DateTime.now()).millisecondsSinceEpoch,
+            query: entry.query,
+            answer: entry.response.answer,
+            sources: [for (final s in entry.response.sources) (s.title, s.url)],
+          );
+        }
+        final loaded = _arena.add(packer.takeBytes()).map(HistoryEntry.fromArena);
+        delta = HistoryDelta(
+          upserts: [...delta.upserts.where((entry) => entry.isArenaBacked), ...loaded],
+          removals: delta.removals,
+          reset: delta.reset,
+        );
+      }
+    } else {
+      if (delta.reset) _entries.clear();
+      for (final id in delta.removals) {
+        _entries.remove(id);
+      }
+      for (final entry in delta.upserts) {
+        _entries[entry.id] = entry;
+      }
+    }
+    if (!_changes.isClosed) _changes.add(delta);
+  }
+
+  Future<void> _onRemote(QuerySnapshot<Map<String, dynamic>> snapshot) async {
+    final upserts = <HistoryEntry>[];
+    final removals = <String>[];
+    for (final change in snapshot.docChanges) {
+      if (change.type == DocumentChangeType.removed) {
+        removals.add(change.doc.id);
+      } else if (!isAvailable || !change.doc.metadata.hasPendingWrites) {
+        // Pending documents are this client's own uploads echoing back.
+        upserts.add(HistoryEntry.fromDocument(change.doc));
+      }
+    }
+
+    if (!isAvailable) {
+      _apply(HistoryDelta(upserts: upserts, removals: removals));
+      return;
+    }
+
+    // Records deleted elsewhere while this client was away never show up as
+    // removals, only as absent from the first snapshot the server sends.
+    if (!_reconciled && !snapshot.metadata.isFromCache) {
+      _reconciled = true;
+      final remoteIds = {for (final doc in snapshot.docs) doc.id};
+      removals.addAll(_ids.where((id) => !remoteIds.contains(id)));
+    }
+    if (upserts.isEmpty && removals.isEmpty) return;
+
+    try {
+      final applied = await _channel.invokeMapMethod<String, Object?>('applyRemote', {
+        'uid': uid,
+        'upserts': upserts.map(_record).toList(),
+        'removals': removals,
+        'packed': true,
+      });
+      if (applied == null || _disposed) return;
+      final appliedUpserts = _arena.add(applied['upserts'] as Uint8List).map(HistoryEntry.fromArena).toList();
+      final appliedRemovals = (applied['removals'] as List).cast<String>();
+      if (appliedUpserts.isEmpty && appliedRemovals.isEmpty) return;
+      _apply(HistoryDelta(upserts: appliedUpserts, removals: appliedRemovals));
+    } on PlatformException catch (e) {
+      debugPrint("Failed to merge remote history: ${e.message}");
+    }
+  }
+
+  void _scheduleSync([Duration delay = _writeBehindDelay]) {
+    if (!isAvailable || _disposed) return;
+    _syncTimer?.cancel();
+    _syncTimer = Timer(delay, _drain);
+  }
+
+  // Writes the journal upstream one coalesced batch at a time, acknowledging
+  // each batch once Firestore has committed it. Failures back off
+  // exponentially; the journal keeps every change until then.
+  Future<void> _drain() async {
+    if (_syncing) {
+      _syncAgain = true;
+      return;
+    }
+    _syncing = true;
+    _syncAgain = false;
+    try {
+      while (!_disposed) {
+        final batch = await _channel.invokeMapMethod<String, Object?>('nextBatch', {
+          'uid': uid,
+          'max': _maxBatchOps,
+        });
+        if (batch == null) break;
+        await _push((batch['ops'] as List).cast<Map>());
+        await _channel.invokeMethod<void>('ack', {'uid': uid, 'seq': batch['seq']});
+      }
+      _backoff = _minBackoff;
+    } catch (e) {
+      debugPrint("History sync failed, retrying in ${_backoff.inSeconds}s: $e");
+      _syncAgain = false;
+      _scheduleSync(_backoff);
+      _backoff = Duration(seconds: min(_backoff.inSeconds * 2, _maxBackoff.inSeconds));
+    } finally {
+      _syncing = false;
+    }
+    if (_syncAgain) _scheduleSync(Duration.zero);
+  }
+
+  // A clear always comes first in a batch; it is committed on its own because
+  // it has to read what to delete.
+  Future<void> _push(List<Map> ops) async {
+    final batch = _firestore.batch();
+    var writes = 0;
+    for (final op in ops) {
+      switch (op['kind']) {
+        case 'clear':
+          await _deleteAllRemote().timeout(_commitTimeout);
+          break;
+        case 'remove':
+          batch.delete(_collection.doc(op['id'] as String));
+          writes++;
+          break;
+        case 'put':
+          final entry = _fromRecord(op['record'] as Map);
+          batch.set(_collection.doc(entry.id), {
+            'query': entry.query,
+            'answer': entry.response.answer,
+            'sources': entry.response.sources.map((s) => {'title': s.title, 'url': s.url}).toList(),
+            'timestamp': Timestamp.fromDate(entry.timestamp ?? DateTime.now()),
+          });
+          writes++;
+          break;
+        case 'usage':
+          // A count only limits the day it was made on.
+          if (op['id'] != _day(DateTime.now())) break;
+          batch.set(_userDoc, {
+            'searchesUsedToday': op['searches'] as int,
+            'lastSearchDate': Timestamp.fromMillisecondsSinceEpoch(op['timestamp'] as int),
+          }, SetOptions(merge: true));
+          writes++;
+          break;
+      }
+    }
+    if (writes > 0) await batch.commit().timeout(_commitTimeout);
+  }
+
+  Future<void> _deleteAllRemote() async {
+    final snapshot = await _collection.get();
+    for (var i = 0; i < snapshot.docs.length; i += _maxBatchOps) {
+      final batch = _firestore.batch();
+      for (final doc in snapshot.docs.skip(i).take(_maxBatchOps)) {
+        batch.delete(doc.reference);
+      }
+      await batch.commit();
+    }
+  }
+
+  // The local day, as the runner keys search counts.
+  static String _day(DateTime time) {
+    String two(int n) => n.toString().padLeft(2, '0');
+    return '${time.year}-${two(time.month)}-${two(time.day)}';
+  }
+
+  static Map<String, Object?> _record(HistoryEntry entry) {
+    return {
+      'id': entry.id,
+      'timestamp': (entry.timestamp ?? DateTime.now()).millisecondsSinceEpoch,
+      'query': entry.query,
+      'answer': entry.response.answer,
+      'sources': entry.response.sources.map((s) => {'title': s.title, 'url': s.url}).toList(),
+    };
+  }
+
+  static HistoryEntry _fromRecord(Map record) {
+    final List<dynamic> sources = record['sources'] ?? const [];
+    return HistoryEntry(
+      id: record['id'] as String,
+      query: record['query'] as String,
+      response: GeminiResponse(
+        answer: record['answer'] as String,
+        sources: sources.map((s) => SearchResult(title: s['title'] ?? '', url: s['url'] ?? '')).toList(),
+      ),
+      timestamp: DateTime.fromMillisecondsSinceEpoch(record['timestamp'] as int),
+    );
+  }
+}
+
+// The entries of an arena snapshot, made the first time each is read and
+// kept, with whatever they have decoded, for the next read of the slot.
+class _ArenaEntries extends ListBase<HistoryEntry> {
+  final List<HistoryArenaRecord> _records;
+  final List<HistoryEntry?> _entries;
+
+  _ArenaEntries(this._records) : _entries = List<HistoryEntry?>.filled(_records.length, null);
+
+  @override
+  int get length => _records.length;
+
+  @override
+  set length(int value) => throw UnsupportedError('The history is read-only');
+
+  @override
+  HistoryEntry operator [](int index) => _entries[index] ??= HistoryEntry.fromArena(_records[index]);
+
+  @override
+  void operator []=(int index, HistoryEntry value) => throw UnsupportedError('The history is read-only');
+}
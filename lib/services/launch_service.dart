@@ -0,0 +1,44 @@
+import 'dart:io';
+import 'package:flutter/foundation.dart';
+import 'package:flutter/services.dart';
+
+/// Queries given to the app on the command line, e.g. `echolens "Jane Roe"`.
+///
+/// Only read in single-instance mode (`--single-instance` or
+/// `ECHOLENS_SINGLE_INSTANCE=1`), where the query is the one argument that is
+/// not an option. The Linux runner keeps the query of its own launch until a
+/// screen [listen]s; later launches forward theirs to the running app and
+/// exit, and each arrives here while it runs. Off Linux nothing arrives.
+class LaunchService {
+  static const MethodChannel _channel = MethodChannel('echolens/launch');
+
+  static bool get _hasNativeRunner => !kIsWeb && Platform.isLinux;
+
+  /// Calls [onQuery] with the query waiting to be searched, if any, and with
+  /// every later one until [cancel].
+  static Future<void> listen(void Function(String query) onQuery) async {
+    if (!_hasNativeRunner) return;
+    _channel.setMethodCallHandler((call) async {
+      if (call.method != 'search') throw MissingPluginException();
+      final query = (call.arguments as Map)['query'] as String?;
+      if (query != null && query.isNotEmpty) onQuery(query);
+    });
+    try {
+      final pending = await _channel.invokeMethod<String>('listen');
+      if (pending != null && pending.isNotEmpty) onQuery(pending);
+    } on PlatformException catch (e) {
+      debugPrint("Launch listen failed: ${e.message}");
+    }
+  }
+
+  /// Holds queries back in the runner until the next [listen].
+  static Future<void> cancel() async {
+    if (!_hasNativeRunner) return;
+    _channel.setMethodCallHandler(null);
+    try {
+      await _channel.invokeMethod<void>('cancel');
+    } on PlatformException catch (e) {
+      debugPrint("Launch cancel failed: ${e.message}");
+    }
+  }
+}
@@ -0,0 +1,230 @@
+import 'dart:async';
+import 'dart:convert';
+
+import 'package:flutter/foundation.dart';
+
+import 'gemini_service.dart';
+import 'response_cache_service.dart';
+
+/// What a batch draws its searches from: the user's daily quota.
+abstract class SearchQuota {
+  /// Takes one search, or returns false when the day's are used up.
+  bool reserve();
+
+  /// Gives back a search [reserve] took that did not produce an answer.
+  void release();
+
+  /// Counts a search [reserve] took now that it produced an answer. Returns
+  /// the day's count for the history journal, or null if searches are not
+  /// counted for this user.
+  int? commit();
+}
+
+enum BatchItemStatus {
+  /// Not looked at yet.
+  pending,
+
+  /// Waiting in the runner's queue.
+  queued,
+  running,
+  done,
+  failed,
+  cancelled,
+
+  /// Left out because the day's searches are used up.
+  overQuota,
+}
+
+class BatchItem {
+  final String query;
+  BatchItemStatus status = BatchItemStatus.pending;
+  GeminiResponse? response;
+  String? error;
+  // Searches made for this item, retries included.
+  int attempts = 0;
+  // Whether the answer came from the response cache, without a search.
+  bool cached = false;
+
+  StreamSubscription<GeminiResponse>? _subscription;
+
+  BatchItem(this.query);
+
+  bool get isActive => status == BatchItemStatus.queued || status == BatchItemStatus.running;
+
+  bool get canRetry =>
+      status == BatchItemStatus.failed || status == BatchItemStatus.cancelled || status == BatchItemStatus.overQuota;
+}
+
+/// Researches a list of queries, a few at a time.
+///
+/// Every query is first looked up in the response cache, in list order, and
+/// the misses are queued with the runner, which runs at most [parallelism]
+/// of them at once through the same rate limiter as interactive searches.
+/// A queued search holds one search of the quota until it answers, when it
+/// is counted, or fails, when it is given back. Answers reach [onAnswer] as
+/// they arrive, so that they stream into the history.
+class ResearchBatch extends ChangeNotifier {
+  /// Longest list a batch takes.
+  static const int maxItems = 200;
+
+  final List<BatchItem> items;
+  final int parallelism;
+  final GeminiService _gemini;
+  final ResponseCacheService _cache;
+  final SearchQuota _quota;
+  // The prompt, with {query} standing for each item's query.
+  final String _template;
+  // [searchesToday] as returned by [SearchQuota.commit], null for answers
+  // that were cached or not counted.
+  final void Function(String query, GeminiResponse response, int? searchesToday) onAnswer;
+
+  bool _disposed = false;
+
+  ResearchBatch({
+    required List<String> queries,
+    required GeminiService gemini,
+    required ResponseCacheService cache,
+    required SearchQuota quota,
+    required String template,
+    required this.onAnswer,
+    this.parallelism = GeminiService.defaultParallelism,
+  })  : items = [for (final query in queries) BatchItem(query)],
+        _gemini = gemini,
+        _cache = cache,
+        _quota = quota,
+        _template = template;
+
+  /// Splits pasted or imported text into queries, one per line. Rows copied
+  /// from a spreadsheet, tab-separated or quoted CSV, give their first
+  /// column. Blank lines and repeats are dropped.
+  static List<String> parseQueries(String text) {
+    final seen = <String>{};
+    final queries = <String>[];
+    for (var line in const LineSplitter().convert(text)) {
+      line = line.trim();
+      if (line.startsWith('"')) {
+        final end = line.indexOf('"', 1);
+        line = end > 0 ? line.substring(1, end) : line.substring(1);
+      } else if (line.contains('\t')) {
+        line = line.substring(0, line.indexOf('\t'));
+      }
+      line = line.trim();
+      if (line.isEmpty || !seen.add(line.toLowerCase())) continue;
+      queries.add(line);
+      if (queries.length == maxItems) break;
+    }
+    return queries;
+  }
+
+  int count(BatchItemStatus status) => items.where((item) => item.status == status).length;
+
+  bool get isRunning => items.any((item) => item.isActive || item.status == BatchItemStatus.pending);
+
+  /// Checks the cache for every item in order, then queues the misses.
+  Future<void> start() async {
+    for (final item in items) {
+      if (_disposed) return;
+      await _run(item);
+    }
+  }
+
+  /// Queues an item again after it failed, was cancelled or was left out.
+  Future<void> retry(BatchItem item) async {
+    if (!item.canRetry) return;
+    item.status = BatchItemStatus.pending;
+    item.error = null;
+    _notify();
+    await _run(item);
+  }
+
+  /// Takes every item still waiting or running off the queue.
+  void cancel() {
+    for (final item in items) {
+      if (item.isActive) {
+        item._subscription?.cancel();
+        _finish(item, BatchItemStatus.cancelled, reserved: true);
+      } else if (item.status == BatchItemStatus.pending) {
+        item.status = BatchItemStatus.cancelled;
+      }
+    }
+    _notify();
+  }
+
+  // Answers [item] from the cache, or queues its search. Returns once the
+  // search is queued, not answered.
+  Future<void> _run(BatchItem item) async {
+    final cached = await _cache.lookup(item.query, _template);
+    if (_disposed || item.status != BatchItemStatus.pending) return;
+    if (cached != null) {
+      item
+        ..response = cached
+        ..cached = true
+        ..status = BatchItemStatus.done;
+      onAnswer(item.query, cached, null);
+      _notify();
+      return;
+    }
+
+    if (!_quota.reserve()) {
+      item.status = BatchItemStatus.overQuota;
+      _notify();
+      return;
+    }
+    item
+      ..status = BatchItemStatus.queued
+      ..attempts += 1;
+    _notify();
+
+    GeminiResponse? result;
+    item._subscription = _gemini
+        .queueGroundedSearch(
+          _template.replaceAll('{query}', item.query),
+          parallelism: parallelism,
+          onStarted: () {
+            if (item.status != BatchItemStatus.queued) return;
+            item.status = BatchItemStatus.running;
+            _notify();
+          },
+        )
+        .listen(
+          (response) => result = response,
+          onError: (Object e) {
+            item.error = e is GeminiApiException ? 'HTTP ${e.status}' : e.toString();
+            _finish(item, BatchItemStatus.failed, reserved: true);
+          },
+          onDone: () {
+            if (!item.isActive) return;
+            final response = result;
+            if (response == null) {
+              _finish(item, BatchItemStatus.cancelled, reserved: true);
+              return;
+            }
+            item.response = response;
+            _cache.store(item.query, _template, response);
+            onAnswer(item.query, response, _quota.commit());
+            _finish(item, BatchItemStatus.done, reserved: false);
+          },
+          cancelOnError: true,
+        );
+  }
+
+  void _finish(BatchItem item, BatchItemStatus status, {required bool reserved}) {
+    if (!item.isActive) return;
+    item
+      ..status = status
+      .._subscription = null;
+    if (reserved) _quota.release();
+    _notify();
+  }
+
+  void _notify() {
+    if (!_disposed) notifyListeners();
+  }
+
+  @override
+  void dispose() {
+    _disposed = true;
+    cancel();
+    super.dispose();
+  }
+}
@@ -0,0 +1,58 @@
+import 'dart:io';
+import 'package:flutter/foundation.dart';
+import 'package:flutter/services.dart';
+
+import 'gemini_service.dart';
+
+/// Persistent cache of grounded search results, kept by the Linux runner.
+///
+/// Entries are keyed by the prompt template and the normalized query, so
+/// researching the same person again is answered from disk without a network
+/// round-trip or a daily search. Other platforms always miss.
+class ResponseCacheService {
+  static const MethodChannel _channel = MethodChannel('echolens/response_cache');
+
+  bool get isAvailable => !kIsWeb && Platform.isLinux;
+
+  Future<GeminiResponse?> lookup(String query, String template) async {
+    if (!isAvailable) return null;
+    try {
+      final packed = await _channel.invokeMethod<Uint8List>('lookup', {
+        'query': query,
+        'template': template,
+      });
+      return packed == null ? null : GeminiResponse.fromPacked(packed);
+    } on PlatformException catch (e) {
+      debugPrint("Response cache lookup failed: ${e.message}");
+      return null;
+    }
+  }
+
+  /// Keeps [response] for later lookups, unless it has no answer to serve.
+  Future<void> store(String query, String template, GeminiResponse response) async {
+    if (!isAvailable) return;
+    if (response.answer.trim().isEmpty || response.answer == GeminiService.noAnswer) return;
+    try {
+      await _channel.invokeMethod<bool>('store', {
+        'query': query,
+        'template': template,
+        'answer': response.answer,
+        'sources': response.sources.map((s) => {'title': s.title, 'url': s.url}).toList(),
+      });
+    } on PlatformException catch (e) {
+      debugPrint("Response cache store failed: ${e.message}");
+    }
+  }
+
+  /// Hit/miss/eviction counters and sizes, as reported by the runner.
+  Future<Map<String, int>> stats() async {
+    if (!isAvailable) return const {};
+    final stats = await _channel.invokeMapMethod<String, int>('stats');
+    return stats ?? const {};
+  }
+
+  Future<void> clear() async {
+    if (!isAvailable) return;
+    await _channel.invokeMethod<void>('clear');
+  }
+}
@@ -0,0 +1,177 @@
+import 'dart:convert';
+import 'dart:io';
+import 'package:flutter/foundation.dart';
+import 'package:flutter/services.dart';
+
+import '../models/history_entry.dart';
+import 'gemini_service.dart';
+
+/// What the home screen showed when the last session ended.
+class SessionSnapshot {
+  final String uid;
+  final String email;
+  final String displayName;
+  final DateTime savedAt;
+  final int searchesUsedToday;
+  final bool exempt;
+  // The result on screen and the query that produced it, if any.
+  final String? query;
+  final GeminiResponse? result;
+  // The first page of history, newest first.
+  final List<HistoryEntry> history;
+
+  const SessionSnapshot({
+    required this.uid,
+    required this.email,
+    required this.displayName,
+    required this.savedAt,
+    required this.searchesUsedToday,
+    required this.exempt,
+    this.query,
+    this.result,
+    required this.history,
+  });
+
+  /// Searches used on the day of [now]; the quota resets at midnight.
+  int searchesUsedOn(DateTime now) {
+    final sameDay = savedAt.year == now.year && savedAt.month == now.month && savedAt.day == now.day;
+    return sameDay ? searchesUsedToday : 0;
+  }
+}
+
+/// Warm-start snapshot of the session, kept by the Linux runner.
+///
+/// The runner maps the snapshot file while the application starts up, so
+/// [load] returns the last session before Firebase is initialized and the
+/// home screen can paint real content on its first frame. The home screen
+/// [save]s whenever what it shows settles. Other platforms have no snapshot.
+class SessionSnapshotService {
+  static const MethodChannel _channel = MethodChannel('echolens/session_snapshot');
+
+  /// How many history records are kept for the drawer's first page.
+  static const int historyPageSize = 20;
+
+  static bool get isAvailable => !kIsWeb && Platform.isLinux;
+
+  /// Returns the snapshot taken at the end of the last session. Only the
+  /// first call per launch gets it.
+  static Future<SessionSnapshot?> load() async {
+    if (!isAvailable) return null;
+    try {
+      final payload = await _channel.invokeMethod<Uint8List>('load');
+      return payload == null ? null : _decode(payload);
+    } on PlatformException catch (e) {
+      debugPrint("Session snapshot load failed: ${e.message}");
+      return null;
+    } on RangeError catch (e) {
+      debugPrint("Session snapshot is malformed: $e");
+      return null;
+    }
+  }
+
+  static Future<void> save(SessionSnapshot snapshot) async {
+    if (!isAvailable) return;
+    try {
+      await _channel.invokeMethod<void>('save', {
+        'uid': snapshot.uid,
+        'email': snapshot.email,
+        'displayName': snapshot.displayName,
+        'savedAt': snapshot.savedAt.millisecondsSinceEpoch,
+        'searchesUsedToday': snapshot.searchesUsedToday,
+        'exempt': snapshot.exempt,
+        'result': snapshot.result == null
+            ? null
+            : _record('', snapshot.query ?? '', snapshot.result!, snapshot.savedAt),
+        'history': [
+          for (final entry in snapshot.history.take(historyPageSize))
+            _record(entry.id, entry.query, entry.response, entry.timestamp),
+        ],
+      });
+    } on PlatformException catch (e) {
+      debugPrint("Session snapshot save failed: ${e.message}");
+    }
+  }
+
+  /// Forgets the session, e.g. on logout.
+  static Future<void> clear() async {
+    if (!isAvailable) return;
+    try {
+      await _channel.invokeMethod<void>('clear');
+    } on PlatformException catch (e) {
+      debugPrint("Session snapshot clear failed: ${e.message}");
+    }
+  }
+
+  static Map<String, Object?> _record(String id, String query, GeminiResponse response, DateTime? timestamp) {
+    return {
+      'id': id,
+      'timestamp': timestamp?.millisecondsSinceEpoch ?? 0,
+      'query': query,
+      'answer': response.answer,
+      'sources': response.sources.map((s) => {'title': s.title, 'url': s.url}).toList(),
+    };
+  }
+
+  /// Decodes the payload written by the runner's session_snapshot_encode().
+  /// All integers are little-endian and strings are u32-prefixed UTF-8.
+  static SessionSnapshot _decode(Uint8List payload) {
+    final data = ByteData.sublistView(payload);
+    int offset = 0;
+
+    int readU32() {
+      final value = data.getUint32(offset, Endian.little);
+      offset += 4;
+      return value;
+    }
+
+    int readI64() {
+      final value = data.getInt64(offset, Endian.little);
+      offset += 8;
+      return value;
+    }
+
+    String readString() {
+      final length = readU32();
+      final value = utf8.decode(Uint8List.sublistView(payload, offset, offset + length), allowMalformed: true);
+      offset += length;
+      return value;
+    }
+
+    HistoryEntry readRecord() {
+      final id = readString();
+      final timestamp = readI64();
+      final query = readString();
+      final answer = readString();
+      final sources = [
+        for (var i = readU32(); i > 0; i--) SearchResult(title: readString(), url: readString()),
+      ];
+      return HistoryEntry(
+        id: id,
+        query: query,
+        response: GeminiResponse(answer: answer, sources: sources),
+        timestamp: timestamp == 0 ? null : DateTime.fromMillisecondsSinceEpoch(timestamp),
+      );
+    }
+
+    final uid = readString();
+    final email = readString();
+    final displayName = readString();
+    final savedAt = DateTime.fromMillisecondsSinceEpoch(readI64());
+    final searchesUsedToday = readU32();
+    final flags = readU32();
+    final result = (flags & 2) != 0 ? readRecord() : null;
+    final history = [for (var i = readU32(); i > 0; i--) readRecord()];
+
+    return SessionSnapshot(
+      uid: uid,
+      email: email,
+      displayName: displayName,
+      savedAt: savedAt,
+      searchesUsedToday: searchesUsedToday,
+      exempt: (flags & 1) != 0,
+      query: result?.query,
+      result: result?.response,
+      history: history,
+    );
+  }
+}
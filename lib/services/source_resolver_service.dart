@@ -0,0 +1,71 @@
+import 'dart:async';
+import 'dart:io';
+import 'package:flutter/foundation.dart';
+import 'package:flutter/services.dart';
+
+import 'gemini_service.dart';
+
+/// Where a grounding source leads, as resolved by the Linux runner.
+class ResolvedSource {
+  /// The page the source's redirect URI ends at.
+  final String finalUrl;
+  final String domain;
+  /// The site's favicon, or null if it has none.
+  final Uint8List? icon;
+
+  const ResolvedSource({required this.finalUrl, required this.domain, this.icon});
+}
+
+/// Resolves the redirect URIs Gemini cites as sources, and fetches each
+/// site's favicon, in the background on the Linux runner.
+///
+/// The runner resolves several sources at once over pooled connections and
+/// keeps the results on disk, so sources seen before, in this session or an
+/// earlier one, show their domain and icon at once and open without a
+/// redirect round-trip. [changes] ticks whenever a resolution arrives. Off
+/// Linux, [lookup] always misses and sources open through their redirect.
+class SourceResolverService {
+  static const MethodChannel _channel = MethodChannel('echolens/source_resolver');
+  static const EventChannel _eventChannel = EventChannel('echolens/source_resolver/events');
+
+  static final Map<String, ResolvedSource> _resolved = {};
+  // URLs asked for, so that every answer shown again is not sent again.
+  static final Set<String> _requested = {};
+  static StreamSubscription<dynamic>? _events;
+
+  static final ValueNotifier<int> changes = ValueNotifier<int>(0);
+
+  static bool get _hasNativeRunner => !kIsWeb && Platform.isLinux;
+
+  static ResolvedSource? lookup(String url) => _resolved[url];
+
+  /// Starts resolving the [sources] not asked for before.
+  static Future<void> resolve(Iterable<SearchResult> sources) async {
+    if (!_hasNativeRunner) return;
+    final urls = [for (final source in sources) if (_requested.add(source.url)) source.url];
+    if (urls.isEmpty) return;
+    _events ??= _eventChannel.receiveBroadcastStream().listen(_add);
+
+    try {
+      final cached = await _channel.invokeListMethod<dynamic>('resolve', {'urls': urls});
+      cached?.forEach(_add);
+    } on PlatformException catch (e) {
+      debugPrint("Source resolution failed: ${e.message}");
+      _requested.removeAll(urls);
+    }
+  }
+
+  static void _add(dynamic event) {
+    if (event is! Map) return;
+    final url = event['url'] as String?;
+    final finalUrl = event['finalUrl'] as String?;
+    // Unresolved sources keep opening through their redirect.
+    if (url == null || finalUrl == null) return;
+    _resolved[url] = ResolvedSource(
+      finalUrl: finalUrl,
+      domain: event['domain'] as String? ?? '',
+      icon: event['icon'] as Uint8List?,
+    );
+    changes.value++;
+  }
+}
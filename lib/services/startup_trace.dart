@@ -0,0 +1,65 @@
+import 'dart:async';
+import 'dart:io';
+import 'package:flutter/foundation.dart';
+import 'package:flutter/services.dart';
+
+/// Dart-side phases of cold start, recorded into the runner's startup trace.
+///
+/// The Linux runner writes a Chrome trace of its own startup phases when it
+/// is launched with `ECHOLENS_STARTUP_TRACE=<path>` or
+/// `--startup-trace=<path>`. Spans recorded here are timed with
+/// [DateTime.now] and buffered until [flush] sends them to the runner, which
+/// places them on a "dart" track beside the native phases. Without tracing,
+/// or off Linux, they are dropped.
+class StartupTrace {
+  static const MethodChannel _channel = MethodChannel('echolens/startup_trace');
+
+  static final List<Map<String, Object>> _pending = [];
+  static bool? _enabled;
+
+  static bool get _hasNativeRunner => !kIsWeb && Platform.isLinux;
+
+  /// Records a span that has already finished.
+  static void record(String name, DateTime start, DateTime end) {
+    if (!_hasNativeRunner || _enabled == false) return;
+    _pending.add({
+      'name': name,
+      'start': start.microsecondsSinceEpoch,
+      'end': end.microsecondsSinceEpoch,
+    });
+  }
+
+  /// Runs [body] and records how long it took, including when it throws.
+  static Future<T> span<T>(String name, FutureOr<T> Function() body) async {
+    final start = DateTime.now();
+    try {
+      return await body();
+    } finally {
+      record(name, start, DateTime.now());
+    }
+  }
+
+  /// Sends the recorded spans. Needs the binding to be initialized.
+  ///
+  /// Spans recorded while a flush is under way go out with the next one;
+  /// flushes are sent one at a time, in order.
+  static Future<void> flush() {
+    if (!_hasNativeRunner || _pending.isEmpty) return _flushing.catchError((_) {});
+    final spans = List.of(_pending);
+    _pending.clear();
+    return _flushing = _flushing.catchError((_) {}).then((_) => _send(spans));
+  }
+
+  static Future<void> _flushing = Future<void>.value();
+
+  static Future<void> _send(List<Map<String, Object>> spans) async {
+    try {
+      _enabled ??= await _channel.invokeMethod<bool>('isEnabled') ?? false;
+      if (_enabled!) {
+        await _channel.invokeMethod<void>('addSpans', {'spans': spans});
+      }
+    } on PlatformException catch (e) {
+      debugPrint("Startup trace failed: ${e.message}");
+    }
+  }
+}
@@ -1,11 +1,50 @@
+import 'dart:async';
+import 'dart:io';
+import 'package:flutter/foundation.dart';
 import 'package:flutter/material.dart';
+import 'package:flutter/services.dart';
 import 'package:pdf/pdf.dart';
 import 'package:pdf/widgets.dart' as pw;
 import 'package:printing/printing.dart';
 import 'package:htmltopdfwidgets/htmltopdfwidgets.dart' as hp;
+import '../screens/report_preview_screen.dart';
 import '../services/gemini_service.dart'; // Ensure this matches your path
 
+/// One history record to export with [PdfUtils.exportBatch].
+class PdfBatchEntry {
+  final String query;
+  final String answer;
+
+  const PdfBatchEntry({required this.query, required this.answer});
+}
+
+/// A snapshot of a running batch export. [paths] is set once it is finished.
+class PdfBatchProgress {
+  final int done;
+  final int total;
+  final List<String>? paths;
+  final Duration? elapsed;
+
+  const PdfBatchProgress({required this.done, required this.total, this.paths, this.elapsed});
+
+  bool get isFinished => paths != null;
+}
+
 class PdfUtils {
+  // Native report generator registered by the Linux runner (cairo + Pango).
+  static const MethodChannel _reportChannel = MethodChannel('echolens/pdf_report');
+  static const EventChannel _reportEventChannel = EventChannel('echolens/pdf_report/events');
+  static final Stream<dynamic> _reportEvents = _reportEventChannel.receiveBroadcastStream();
+  static int _nextBatchId = 0;
+
+  static const String _reportTitle = "EchoLens Profile Report";
+  static const String _reportFooter = "Generated by EchoLens AI";
+
+  static bool get _hasNativeRunner => !kIsWeb && Platform.isLinux;
+
+  /// Batch export renders on the runner's thread pool, so it is Linux only.
+  static bool get supportsBatchExport => _hasNativeRunner;
+
   static String _convertToHtml(String markdown) {
     RegExp boldExp = RegExp(r'\*\*(.*?)\*\*');
     String html = markdown.replaceAllMapped(boldExp, (match) => '<b>${match.group(1)}</b>');
@@ -22,50 +61,99 @@ class PdfUtils {
     return processedLines.join('');
   }
 
+  /// Lays out the report in Dart with htmltopdfwidgets and the pdf package.
+  /// This runs on the UI isolate; it is the fallback off Linux and the
+  /// baseline timed by benchmark/pdf_report_benchmark.dart.
+  @visibleForTesting
+  static Future<Uint8List> buildDartReport(String markdown, String date) async {
+    final pdf = pw.Document();
+    final htmlContent = _convertToHtml(markdown);
+    final pdfWidgets = await hp.HTMLToPdf().convert(htmlContent);
+
+    pdf.addPage(
+      pw.MultiPage(
+        pageFormat: PdfPageFormat.a4,
+        margin: const pw.EdgeInsets.all(32),
+        build: (pw.Context context) {
+          return [
+            pw.Header(
+              level: 0,
+              child: pw.Row(
+                mainAxisAlignment: pw.MainAxisAlignment.spaceBetween,
+                children: [
+                  pw.Text(_reportTitle, 
+                    style: pw.TextStyle(fontSize: 22, fontWeight: pw.FontWeight.bold, color: PdfColors.amber800)),
+                  pw.Text(date, 
+                    style: const pw.TextStyle(fontSize: 10, color: PdfColors.grey)),
+                ],
+              ),
+            ),
+            pw.SizedBox(height: 20),
+            ...pdfWidgets,
+            pw.SizedBox(height: 30),
+            pw.Divider(thickness: 0.5, color: PdfColors.grey300),
+            pw.Align(
+              alignment: pw.Alignment.centerRight,
+              child: pw.Text(_reportFooter, style: const pw.TextStyle(fontSize: 8, color: PdfColors.grey)),
+            ),
+          ];
+        },
+      ),
+    );
+
+    return pdf.save();
+  }
+
+  /// Renders the report in the Linux runner on a worker thread and reads the
+  /// finished file back.
+  static Future<Uint8List> _buildNativeReport(String markdown, String date) async {
+    final dir = await Directory.systemTemp.createTemp('echolens_report');
+    try {
+      final path = '${dir.path}/report.pdf';
+      await _reportChannel.invokeMethod<int>('render', {
+        'path': path,
+        'title': _reportTitle,
+        'date': date,
+        'markdown': markdown,
+        'footer': _reportFooter,
+      });
+      return await File(path).readAsBytes();
+    } finally {
+      await dir.delete(recursive: true);
+    }
+  }
+
+  /// On Linux, opens the report in [ReportPreviewScreen], whose pages the
+  /// runner rasterizes as tiles, and prints it from there. Elsewhere it goes
+  /// straight to the print dialog.
   static Future<void> generateAndDownloadPdf(
     BuildContext context, 
     GeminiResponse response, 
     String queryTitle
   ) async {
-    try {
-      final pdf = pw.Document();
-      final htmlContent = _convertToHtml(response.answer);
-      final pdfWidgets = await hp.HTMLToPdf().convert(htmlContent);
-
-      pdf.addPage(
-        pw.MultiPage(
-          pageFormat: PdfPageFormat.a4,
-          margin: const pw.EdgeInsets.all(32),
-          build: (pw.Context context) {
-            return [
-              pw.Header(
-                level: 0,
-                child: pw.Row(
-                  mainAxisAlignment: pw.MainAxisAlignment.spaceBetween,
-                  children: [
-                    pw.Text("EchoLens Profile Report", 
-                      style: pw.TextStyle(fontSize: 22, fontWeight: pw.FontWeight.bold, color: PdfColors.amber800)),
-                    pw.Text(DateTime.now().toString().split(' ')[0], 
-                      style: const pw.TextStyle(fontSize: 10, color: PdfColors.grey)),
-                  ],
-                ),
-              ),
-              pw.SizedBox(height: 20),
-              ...pdfWidgets,
-              pw.SizedBox(height: 30),
-              pw.Divider(thickness: 0.5, color: PdfColors.grey300),
-              pw.Align(
-                alignment: pw.Alignment.centerRight,
-                child: pw.Text("Generated by EchoLens AI", style: const pw.TextStyle(fontSize: 8, color: PdfColors.grey)),
-              ),
-            ];
-          },
+    final date = DateTime.now().toString().split(' ')[0];
+    final name = 'Profile_${queryTitle.replaceAll(' ', '_')}.pdf';
+    if (_hasNativeRunner) {
+      await Navigator.of(context).push(MaterialPageRoute<void>(
+        builder: (context) => ReportPreviewScreen(
+          title: _reportTitle,
+          date: date,
+          markdown: response.answer,
+          footer: _reportFooter,
+          onPrint: (context) => _printReport(context, () => _buildNativeReport(response.answer, date), name),
         ),
-      );
+      ));
+      return;
+    }
+    await _printReport(context, () => buildDartReport(response.answer, date), name);
+  }
 
+  static Future<void> _printReport(BuildContext context, Future<Uint8List> Function() build, String name) async {
+    try {
+      final bytes = await build();
       await Printing.layoutPdf(
-        onLayout: (PdfPageFormat format) async => pdf.save(),
-        name: 'Profile_${queryTitle.replaceAll(' ', '_')}.pdf',
+        onLayout: (PdfPageFormat format) async => bytes,
+        name: name,
       );
     } catch (e) {
       if (context.mounted) {
@@ -75,4 +163,92 @@ class PdfUtils {
       }
     }
   }
-}
\ No newline at end of file
+
+  /// Exports every entry as a report, in parallel on one runner thread per
+  /// core. With [merged] the reports go into a single PDF behind a linked
+  /// table of contents; otherwise each becomes its own Profile_<query>.pdf
+  /// in a new folder. Both land in the Downloads directory unless [path] is
+  /// given.
+  ///
+  /// The stream reports progress after every finished report and closes
+  /// after the final event, whose [PdfBatchProgress.paths] lists the files
+  /// written. Cancelling the subscription cancels the export; reports that
+  /// were already written are kept.
+  static Stream<PdfBatchProgress> exportBatch(
+    List<PdfBatchEntry> entries, {
+    bool merged = false,
+    String? path,
+  }) {
+    if (!_hasNativeRunner) {
+      return Stream.error(UnsupportedError('Batch export needs the Linux runner'));
+    }
+
+    final id = _nextBatchId++;
+    final total = entries.length;
+    StreamSubscription<dynamic>? subscription;
+    bool finished = false;
+    late final StreamController<PdfBatchProgress> controller;
+
+    void finish() {
+      finished = true;
+      subscription?.cancel();
+      controller.close();
+    }
+
+    controller = StreamController<PdfBatchProgress>(
+      onListen: () {
+        subscription = _reportEvents.listen((dynamic event) {
+          final Map<dynamic, dynamic> e = event as Map<dynamic, dynamic>;
+          if (e['id'] != id) return;
+          switch (e['type']) {
+            case 'progress':
+              controller.add(PdfBatchProgress(done: e['done'] as int, total: e['total'] as int));
+              break;
+            case 'done':
+              controller.add(PdfBatchProgress(
+                done: total,
+                total: total,
+                paths: (e['paths'] as List<dynamic>).cast<String>(),
+                elapsed: Duration(microseconds: ((e['seconds'] as double) * 1e6).round()),
+              ));
+              finish();
+              break;
+            case 'error':
+              controller.addError(Exception('PDF Error: ${e['message']}'));
+              finish();
+              break;
+            case 'cancelled':
+              finish();
+              break;
+          }
+        }, onError: (Object error) {
+          controller.addError(error);
+          finish();
+        });
+
+        _reportChannel.invokeMethod<void>('exportBatch', {
+          'id': id,
+          'merged': merged,
+          'title': _reportTitle,
+          'date': DateTime.now().toString().split(' ')[0],
+          'footer': _reportFooter,
+          'reports': [
+            for (final entry in entries) {'name': entry.query, 'markdown': entry.answer},
+          ],
+          if (path != null) 'path': path,
+        }).catchError((Object error) {
+          controller.addError(error);
+          finish();
+        });
+      },
+      onCancel: () {
+        subscription?.cancel();
+        if (!finished) {
+          _reportChannel.invokeMethod<void>('cancelBatch', {'id': id});
+        }
+      },
+    );
+
+    return controller.stream;
+  }
+}
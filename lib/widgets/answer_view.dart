@@ -0,0 +1,193 @@
+import 'package:flutter/material.dart';
+import 'package:flutter/scheduler.dart';
+import 'package:flutter_markdown_plus/flutter_markdown_plus.dart';
+
+import '../models/markdown_document.dart';
+import '../services/gemini_service.dart';
+
+/// Renders the answer of a [GeminiResponse].
+///
+/// The answer is parsed once, by the runner, into the [MarkdownDocument] kept
+/// with the response. The widgets built from it are kept too and returned
+/// as the same instance on every later build, so rebuilding the screen around
+/// the view neither parses nor lays out the answer again: the paragraphs only
+/// relayout when the width they are given changes. While a streamed answer
+/// grows, the last document parsed stays on screen until the next one is
+/// ready. Only one parse runs at a time: responses that arrive meanwhile are
+/// skipped but the latest, which is parsed at the next frame.
+///
+/// Where the runner is not available the answer is shown with MarkdownBody,
+/// built once per response for the same reason.
+class AnswerView extends StatefulWidget {
+  final GeminiResponse response;
+
+  /// Renders [document] instead of asking [response] for one; for benchmarks.
+  final MarkdownDocument? document;
+
+  const AnswerView({super.key, required this.response, this.document});
+
+  static const TextStyle paragraphStyle = TextStyle(color: Color.fromARGB(255, 205, 205, 205), fontSize: 15, height: 1.6);
+  static const TextStyle _strongStyle = TextStyle(color: Colors.white, fontWeight: FontWeight.bold);
+  static const TextStyle _codeStyle = TextStyle(fontFamily: 'monospace', backgroundColor: Color(0xFF1C1C1C));
+  static const TextStyle _linkStyle = TextStyle(color: Colors.lightBlueAccent, decoration: TextDecoration.underline);
+  static const double _blockSpacing = 8;
+
+  @override
+  State<AnswerView> createState() => _AnswerViewState();
+}
+
+class _AnswerViewState extends State<AnswerView> {
+  Widget? _content;
+  // Which request for a document is on screen; later ones replace it.
+  int _requested = 0;
+  int _shown = 0;
+  // Whether a parse is running, and whether the response changed since it
+  // started. Parsing every partial of a long streamed answer would cost
+  // time quadratic in its length.
+  bool _parsing = false;
+  bool _stale = false;
+
+  @override
+  void initState() {
+    super.initState();
+    _load();
+  }
+
+  @override
+  void didUpdateWidget(AnswerView oldWidget) {
+    super.didUpdateWidget(oldWidget);
+    if (!identical(oldWidget.response, widget.response) || !identical(oldWidget.document, widget.document)) {
+      _load();
+    }
+  }
+
+  void _load() {
+    final generation = ++_requested;
+    final document = widget.document;
+    if (document != null) {
+      _show(generation, _buildDocument(document));
+      return;
+    }
+    if (_parsing) {
+      _stale = true;
+      return;
+    }
+    _parsing = true;
+    final response = widget.response;
+    response.document().then((document) {
+      _parsing = false;
+      if (!mounted) return;
+      if (_stale) {
+        _stale = false;
+        SchedulerBinding.instance.scheduleFrameCallback((_) {
+          if (mounted) _load();
+        });
+      }
+      if (document == null) {
+        // Only the response on screen gets a fallback; parsing it is the
+        // cost this view exists to avoid.
+        if (identical(response, widget.response)) {
+          setState(() => _show(generation, _buildFallback(response)));
+        }
+        return;
+      }
+      setState(() => _show(generation, _buildDocument(document)));
+    });
+  }
+
+  void _show(int generation, Widget content) {
+    if (generation < _shown) return;
+    _shown = generation;
+    _content = content;
+  }
+
+  @override
+  Widget build(BuildContext context) => _content ?? const SizedBox.shrink();
+
+  Widget _buildFallback(GeminiResponse response) {
+    return MarkdownBody(
+      data: response.answer,
+      selectable: true,
+      styleSheet: MarkdownStyleSheet(
+        p: AnswerView.paragraphStyle,
+        strong: AnswerView._strongStyle,
+      ),
+    );
+  }
+
+  Widget _buildDocument(MarkdownDocument document) {
+    final children = <Widget>[];
+    for (var block = 0; block < document.blockCount; block++) {
+      if (children.isNotEmpty) children.add(const SizedBox(height: AnswerView._blockSpacing));
+      children.add(_buildBlock(document, block));
+    }
+    return RepaintBoundary(
+      child: SelectionArea(
+        child: Column(crossAxisAlignment: CrossAxisAlignment.start, children: children),
+      ),
+    );
+  }
+
+  Widget _buildBlock(MarkdownDocument document, int block) {
+    final level = document.blockLevel(block);
+    switch (document.blockKind(block)) {
+      case MarkdownBlockKind.rule:
+        return const Divider(color: Colors.white24, height: 1);
+      case MarkdownBlockKind.heading:
+        final size = switch (level) { 1 => 22.0, 2 => 20.0, 3 => 18.0, _ => 16.0 };
+        return _text(document, block,
+            AnswerView.paragraphStyle.merge(TextStyle(color: Colors.white, fontSize: size, fontWeight: FontWeight.bold)));
+      case MarkdownBlockKind.bullet:
+        return _listItem('•', level, _text(document, block, AnswerView.paragraphStyle));
+      case MarkdownBlockKind.ordered:
+        return _listItem('${document.blockNumber(block)}.', level, _text(document, block, AnswerView.paragraphStyle));
+      case MarkdownBlockKind.quote:
+        return Container(
+          padding: const EdgeInsets.only(left: 12),
+          decoration: const BoxDecoration(border: Border(left: BorderSide(color: Colors.white24, width: 3))),
+          child: _text(document, block, AnswerView.paragraphStyle.copyWith(fontStyle: FontStyle.italic)),
+        );
+      case MarkdownBlockKind.code:
+        return Container(
+          width: double.infinity,
+          padding: const EdgeInsets.all(8),
+          decoration: BoxDecoration(color: const Color(0xFF1C1C1C), borderRadius: BorderRadius.circular(4)),
+          child: _text(document, block, AnswerView.paragraphStyle.copyWith(fontFamily: 'monospace', height: 1.4)),
+        );
+      case MarkdownBlockKind.paragraph:
+        return _text(document, block, AnswerView.paragraphStyle);
+    }
+  }
+
+  Widget _listItem(String marker, int level, Widget content) {
+    return Padding(
+      padding: EdgeInsets.only(left: 16.0 * level),
+      child: Row(
+        crossAxisAlignment: CrossAxisAlignment.start,
+        children: [
+          SizedBox(width: 24, child: Text(marker, style: AnswerView.paragraphStyle)),
+          Expanded(child: content),
+        ],
+      ),
+    );
+  }
+
+  Widget _text(MarkdownDocument document, int block, TextStyle style) {
+    final first = document.blockFirstSpan(block);
+    final spans = <InlineSpan>[];
+    for (var span = first; span < first + document.blockSpanCount(block); span++) {
+      spans.add(TextSpan(text: document.spanText(span), style: _spanStyle(document.spanStyle(span))));
+    }
+    return Text.rich(TextSpan(children: spans), style: style);
+  }
+
+  static TextStyle? _spanStyle(int bits) {
+    if (bits == 0) return null;
+    var style = const TextStyle();
+    if (bits & MarkdownSpanStyle.bold != 0) style = style.merge(AnswerView._strongStyle);
+    if (bits & MarkdownSpanStyle.italic != 0) style = style.copyWith(fontStyle: FontStyle.italic);
+    if (bits & MarkdownSpanStyle.code != 0) style = style.merge(AnswerView._codeStyle);
+    if (bits & MarkdownSpanStyle.link != 0) style = style.merge(AnswerView._linkStyle);
+    return style;
+  }
+}
@@ -0,0 +1,228 @@
+import 'package:flutter/material.dart';
+import 'package:flutter/services.dart';
+
+import '../services/research_batch.dart';
+
+const Color _brandColor = Color.fromARGB(255, 212, 160, 24);
+
+/// Asks for the queries of a batch, typed, pasted or taken from the
+/// clipboard. [remaining] is how many searches the quota has left, or null
+/// when it does not apply. Returns null if the user backs out.
+Future<List<String>?> showBatchInputDialog(BuildContext context, {int? remaining}) {
+  return showDialog<List<String>>(
+    context: context,
+    builder: (context) => _BatchInputDialog(remaining: remaining),
+  );
+}
+
+class _BatchInputDialog extends StatefulWidget {
+  final int? remaining;
+
+  const _BatchInputDialog({this.remaining});
+
+  @override
+  State<_BatchInputDialog> createState() => _BatchInputDialogState();
+}
+
+class _BatchInputDialogState extends State<_BatchInputDialog> {
+  final TextEditingController _text = TextEditingController();
+  List<String> _queries = const [];
+
+  @override
+  void initState() {
+    super.initState();
+    _text.addListener(() => setState(() => _queries = ResearchBatch.parseQueries(_text.text)));
+  }
+
+  @override
+  void dispose() {
+    _text.dispose();
+    super.dispose();
+  }
+
+  Future<void> _paste() async {
+    final data = await Clipboard.getData(Clipboard.kTextPlain);
+    final text = data?.text;
+    if (text == null || text.isEmpty) return;
+    _text.text = _text.text.isEmpty ? text : '${_text.text}\n$text';
+  }
+
+  @override
+  Widget build(BuildContext context) {
+    final remaining = widget.remaining;
+    final String summary;
+    if (_queries.isEmpty) {
+      summary = "One name or query per line.";
+    } else if (remaining != null && _queries.length > remaining) {
+      summary = "${_queries.length} queries; ${remaining < 0 ? 0 : remaining} searches left today. "
+          "Cached answers are free, the rest wait for tomorrow.";
+    } else {
+      summary = "${_queries.length} queries.";
+    }
+
+    return AlertDialog(
+      backgroundColor: const Color(0xFF2C2C2C),
+      title: const Text("Batch Research", style: TextStyle(color: Colors.white)),
+      content: SizedBox(
+        width: 480,
+        child: Column(
+          mainAxisSize: MainAxisSize.min,
+          crossAxisAlignment: CrossAxisAlignment.start,
+          children: [
+            TextField(
+              controller: _text,
+              autofocus: true,
+              minLines: 8,
+              maxLines: 14,
+              style: const TextStyle(color: Colors.white, fontSize: 13),
+              cursorColor: _brandColor,
+              decoration: InputDecoration(
+                hintText: "Dr. Jane Roe at ETH Zurich\nProf. John Doe at MIT",
+                hintStyle: const TextStyle(color: Colors.white24),
+                filled: true,
+                fillColor: const Color(0xFF1C1C1C),
+                border: OutlineInputBorder(borderRadius: BorderRadius.circular(8), borderSide: BorderSide.none),
+              ),
+            ),
+            const SizedBox(height: 8),
+            Text(summary, style: const TextStyle(color: Colors.white54, fontSize: 12)),
+          ],
+        ),
+      ),
+      actions: [
+        TextButton(
+          onPressed: _paste,
+          child: const Text("Paste", style: TextStyle(color: _brandColor)),
+        ),
+        TextButton(
+          onPressed: () => Navigator.pop(context),
+          child: const Text("Cancel", style: TextStyle(color: Colors.white54)),
+        ),
+        TextButton(
+          onPressed: _queries.isEmpty ? null : () => Navigator.pop(context, _queries),
+          child: const Text("Research All", style: TextStyle(color: _brandColor)),
+        ),
+      ],
+    );
+  }
+}
+
+/// The items of a running or finished [ResearchBatch], updated as they
+/// progress. Failed, cancelled and left out items can be retried one by one;
+/// [onOpen] shows an answered item, and [onNewBatch] replaces a finished
+/// batch.
+class BatchProgressSheet extends StatelessWidget {
+  final ResearchBatch batch;
+  final void Function(BatchItem item) onOpen;
+  final VoidCallback onNewBatch;
+
+  const BatchProgressSheet({super.key, required this.batch, required this.onOpen, required this.onNewBatch});
+
+  static Widget _statusIcon(BatchItem item) {
+    switch (item.status) {
+      case BatchItemStatus.pending:
+      case BatchItemStatus.queued:
+        return const Icon(Icons.schedule, color: Colors.white24, size: 20);
+      case BatchItemStatus.running:
+        return const SizedBox(width: 20, height: 20, child: CircularProgressIndicator(color: _brandColor, strokeWidth: 2));
+      case BatchItemStatus.done:
+        return Icon(item.cached ? Icons.bolt : Icons.check_circle_outline, color: _brandColor, size: 20);
+      case BatchItemStatus.failed:
+        return const Icon(Icons.error_outline, color: Colors.redAccent, size: 20);
+      case BatchItemStatus.cancelled:
+        return const Icon(Icons.block, color: Colors.white38, size: 20);
+      case BatchItemStatus.overQuota:
+        return const Icon(Icons.hourglass_disabled, color: Colors.white38, size: 20);
+    }
+  }
+
+  static String _statusText(BatchItem item) {
+    switch (item.status) {
+      case BatchItemStatus.pending:
+        return "Waiting";
+      case BatchItemStatus.queued:
+        return "Queued";
+      case BatchItemStatus.running:
+        return "Researching…";
+      case BatchItemStatus.done:
+        return item.cached ? "From cache" : "Done";
+      case BatchItemStatus.failed:
+        return "Failed: ${item.error ?? 'unknown error'}";
+      case BatchItemStatus.cancelled:
+        return "Cancelled";
+      case BatchItemStatus.overQuota:
+        return "Daily limit reached";
+    }
+  }
+
+  @override
+  Widget build(BuildContext context) {
+    return ListenableBuilder(
+      listenable: batch,
+      builder: (context, _) {
+        final done = batch.count(BatchItemStatus.done);
+        return SizedBox(
+          height: MediaQuery.of(context).size.height * 0.7,
+          child: Column(
+            children: [
+              Padding(
+                padding: const EdgeInsets.fromLTRB(16, 16, 8, 8),
+                child: Row(
+                  children: [
+                    Expanded(
+                      child: Text(
+                        "Batch Research · $done of ${batch.items.length} done",
+                        style: const TextStyle(color: _brandColor, fontSize: 16, fontWeight: FontWeight.bold),
+                      ),
+                    ),
+                    if (batch.isRunning)
+                      TextButton(
+                        onPressed: batch.cancel,
+                        child: const Text("Cancel All", style: TextStyle(color: Colors.redAccent, fontSize: 12)),
+                      )
+                    else
+                      TextButton(
+                        onPressed: onNewBatch,
+                        child: const Text("New Batch", style: TextStyle(color: _brandColor, fontSize: 12)),
+                      ),
+                  ],
+                ),
+              ),
+              LinearProgressIndicator(
+                value: batch.items.isEmpty ? null : done / batch.items.length,
+                color: _brandColor,
+                backgroundColor: Colors.white10,
+              ),
+              Expanded(
+                child: ListView.builder(
+                  itemCount: batch.items.length,
+                  itemBuilder: (context, index) {
+                    final item = batch.items[index];
+                    return ListTile(
+                      leading: _statusIcon(item),
+                      title: Text(item.query, style: const TextStyle(color: Colors.white, fontSize: 13)),
+                      subtitle: Text(
+                        _statusText(item),
+                        style: const TextStyle(color: Colors.white38, fontSize: 11),
+                        maxLines: 1,
+                        overflow: TextOverflow.ellipsis,
+                      ),
+                      trailing: item.canRetry
+                          ? IconButton(
+                              icon: const Icon(Icons.refresh, color: Colors.white54, size: 18),
+                              tooltip: "Retry",
+                              onPressed: () => batch.retry(item),
+                            )
+                          : null,
+                      onTap: item.status == BatchItemStatus.done ? () => onOpen(item) : null,
+                    );
+                  },
+                ),
+              ),
+            ],
+          ),
+        );
+      },
+    );
+  }
+}
@@ -0,0 +1,294 @@
+import 'dart:math';
+import 'dart:typed_data';
+
+import 'package:flutter/material.dart';
+import 'package:flutter/scheduler.dart';
+import 'package:flutter/services.dart';
+
+/// Previews a profile report as the Linux runner lays it out for export.
+///
+/// The runner rasterizes the pages into 256 pixel tiles on a pool of worker
+/// threads, ahead of the scroll direction, and hands each tile over as an
+/// external texture, so scrolling only composites textures and never waits
+/// for a page to render. Tiles are cached by page, zoom level and position,
+/// up to a fixed number of bytes. Zoom levels are quarter octaves; between
+/// two levels the tiles of the nearer one are scaled.
+///
+/// [zoom] scales the pages from the width that fits the view. Linux only.
+class TiledReportPreview extends StatefulWidget {
+  static const MethodChannel _channel = MethodChannel('echolens/pdf_preview');
+
+  final String title;
+  final String date;
+  final String markdown;
+  final String footer;
+  final double zoom;
+
+  /// Scrolls the pages; for benchmarks.
+  final ScrollController? controller;
+
+  /// Told the runner's id of the preview once it is laid out, for [stats].
+  final ValueChanged<int>? onOpened;
+
+  const TiledReportPreview({
+    super.key,
+    required this.title,
+    required this.date,
+    required this.markdown,
+    required this.footer,
+    this.zoom = 1,
+    this.controller,
+    this.onOpened,
+  });
+
+  static const double _pageGap = 16;
+  static const double _maxPageWidth = 820;
+  static const int _tileSize = 256;
+  static const int _minLevel = -8;
+  static const int _maxLevel = 16;
+
+  /// Tile cache statistics of an open preview, as reported by the runner.
+  static Future<Map<String, int>> stats(int id) async {
+    final stats = await _channel.invokeMapMethod<String, int>('stats', {'id': id});
+    return stats ?? const {};
+  }
+
+  @override
+  State<TiledReportPreview> createState() => _TiledReportPreviewState();
+}
+
+class _TiledReportPreviewState extends State<TiledReportPreview> {
+  final ScrollController _horizontal = ScrollController();
+  ScrollController? _ownVertical;
+
+  int? _id;
+  int _pages = 0;
+  double _pageWidth = 595.28;
+  double _pageHeight = 841.89;
+  Object? _error;
+
+  // The geometry of the last layout, in logical pixels.
+  Size _viewport = Size.zero;
+  double _width = 0;
+  double _devicePixelRatio = 1;
+
+  // The textures on screen, at [_level].
+  int _level = 0;
+  Map<(int, int, int), int> _textures = const {};
+
+  double _lastOffset = 0;
+  bool _updating = false;
+  bool _dirty = false;
+
+  ScrollController get _vertical => widget.controller ?? (_ownVertical ??= ScrollController());
+
+  double get _pageExtent => _width * _pageHeight / _pageWidth + TiledReportPreview._pageGap;
+
+  @override
+  void initState() {
+    super.initState();
+    _vertical.addListener(_scheduleUpdate);
+    _horizontal.addListener(_scheduleUpdate);
+    _open();
+  }
+
+  @override
+  void dispose() {
+    _vertical.removeListener(_scheduleUpdate);
+    _horizontal.removeListener(_scheduleUpdate);
+    _ownVertical?.dispose();
+    _horizontal.dispose();
+    final id = _id;
+    if (id != null) TiledReportPreview._channel.invokeMethod<void>('close', {'id': id});
+    super.dispose();
+  }
+
+  Future<void> _open() async {
+    try {
+      final result = await TiledReportPreview._channel.invokeMapMethod<String, Object?>('open', {
+        'title': widget.title,
+        'date': widget.date,
+        'markdown': widget.markdown,
+        'footer': widget.footer,
+      });
+      final id = result!['id'] as int;
+      if (!mounted) {
+        TiledReportPreview._channel.invokeMethod<void>('close', {'id': id});
+        return;
+      }
+      setState(() {
+        _id = id;
+        _pages = result['pages'] as int;
+        _pageWidth = (result['pageWidth'] as num).toDouble();
+        _pageHeight = (result['pageHeight'] as num).toDouble();
+      });
+      widget.onOpened?.call(id);
+      _scheduleUpdate();
+    } on PlatformException catch (e) {
+      if (mounted) setState(() => _error = e.message);
+    }
+  }
+
+  // Asks for the tiles on screen after this frame; one request is in flight
+  // at a time and the latest position wins.
+  void _scheduleUpdate() {
+    if (_updating) {
+      _dirty = true;
+      return;
+    }
+    _updating = true;
+    SchedulerBinding.instance.addPostFrameCallback((_) => _update());
+    SchedulerBinding.instance.ensureVisualUpdate();
+  }
+
+  Future<void> _update() async {
+    final id = _id;
+    if (!mounted || id == null || _width <= 0 || !_vertical.hasClients) {
+      _updating = false;
+      return;
+    }
+    _dirty = false;
+
+    final level = (log(_width * _devicePixelRatio / _pageWidth) / ln2 * 4)
+        .round()
+        .clamp(TiledReportPreview._minLevel, TiledReportPreview._maxLevel);
+    final scale = pow(2, level / 4).toDouble();
+    final pagePixelsWide = (_pageWidth * scale).ceil();
+    final pagePixelsHigh = (_pageHeight * scale).ceil();
+    // Logical pixels per tile pixel.
+    final factor = _width / (_pageWidth * scale);
+    final tileExtent = TiledReportPreview._tileSize * factor;
+    final columns = (pagePixelsWide / TiledReportPreview._tileSize).ceil();
+    final rows = (pagePixelsHigh / TiledReportPreview._tileSize).ceil();
+
+    final top = _vertical.offset;
+    final bottom = top + _viewport.height;
+    final left = (_horizontal.hasClients ? _horizontal.offset : 0) - TiledReportPreview._pageGap;
+    final right = left + _viewport.width;
+    final firstColumn = max(0, (left / tileExtent).floor());
+    final lastColumn = min(columns - 1, (right / tileExtent).floor());
+
+    final keys = <(int, int, int)>[];
+    final extent = _pageExtent;
+    final firstPage = max(0, (top / extent).floor());
+    final lastPage = min(_pages - 1, (bottom / extent).floor());
+    for (var page = firstPage; page <= lastPage; page++) {
+      final pageTop = page * extent + TiledReportPreview._pageGap / 2;
+      final firstRow = max(0, ((top - pageTop) / tileExtent).floor());
+      final lastRow = min(rows - 1, ((bottom - pageTop) / tileExtent).floor());
+      for (var row = firstRow; row <= lastRow; row++) {
+        for (var column = firstColumn; column <= lastColumn; column++) {
+          keys.add((page, column, row));
+        }
+      }
+    }
+
+    final direction = (top - _lastOffset).sign.toInt();
+    _lastOffset = top;
+    final tiles = Int32List(keys.length * 3);
+    for (var i = 0; i < keys.length; i++) {
+      tiles[i * 3] = keys[i].$1;
+      tiles[i * 3 + 1] = keys[i].$2;
+      tiles[i * 3 + 2] = keys[i].$3;
+    }
+
+    try {
+      final ids = await TiledReportPreview._channel.invokeListMethod<int>('show', {
+        'id': id,
+        'zoom': level,
+        'tiles': tiles,
+        'direction': direction,
+      });
+      if (mounted && ids != null) {
+        setState(() {
+          _level = level;
+          _textures = {
+            for (var i = 0; i < keys.length; i++)
+              if (ids[i] >= 0) keys[i]: ids[i],
+          };
+        });
+      }
+    } on PlatformException catch (e) {
+      debugPrint("Preview update failed: ${e.message}");
+    }
+    _updating = false;
+    if (_dirty) _scheduleUpdate();
+  }
+
+  Widget _buildPage(int page, double height) {
+    final scale = pow(2, _level / 4).toDouble();
+    final pagePixelsWide = (_pageWidth * scale).ceil();
+    final pagePixelsHigh = (_pageHeight * scale).ceil();
+    final factor = _width / (_pageWidth * scale);
+    const size = TiledReportPreview._tileSize;
+    return Container(
+      width: _width,
+      height: height,
+      color: Colors.white,
+      child: Stack(
+        children: [
+          for (final entry in _textures.entries)
+            if (entry.key.$1 == page)
+              Positioned(
+                left: entry.key.$2 * size * factor,
+                top: entry.key.$3 * size * factor,
+                width: min(size, pagePixelsWide - entry.key.$2 * size) * factor,
+                height: min(size, pagePixelsHigh - entry.key.$3 * size) * factor,
+                child: Texture(textureId: entry.value, filterQuality: FilterQuality.medium),
+              ),
+        ],
+      ),
+    );
+  }
+
+  @override
+  Widget build(BuildContext context) {
+    if (_error != null) {
+      return Center(child: Text("Preview failed: $_error", style: const TextStyle(color: Colors.white70)));
+    }
+    if (_id == null) {
+      return const Center(child: CircularProgressIndicator(color: Color.fromARGB(255, 212, 160, 24)));
+    }
+    return LayoutBuilder(
+      builder: (context, constraints) {
+        const gap = TiledReportPreview._pageGap;
+        final fitted = min(constraints.maxWidth - 2 * gap, TiledReportPreview._maxPageWidth);
+        final width = max(fitted, 64.0) * widget.zoom;
+        final devicePixelRatio = MediaQuery.devicePixelRatioOf(context);
+        if (width != _width || constraints.biggest != _viewport || devicePixelRatio != _devicePixelRatio) {
+          _width = width;
+          _viewport = constraints.biggest;
+          _devicePixelRatio = devicePixelRatio;
+          _scheduleUpdate();
+        }
+        final pageHeight = width * _pageHeight / _pageWidth;
+        return Scrollbar(
+          controller: _horizontal,
+          child: SingleChildScrollView(
+            controller: _horizontal,
+            scrollDirection: Axis.horizontal,
+            child: SizedBox(
+              width: max(width + 2 * gap, constraints.maxWidth),
+              height: constraints.maxHeight,
+              child: ListView.builder(
+                controller: _vertical,
+                itemCount: _pages,
+                itemExtent: pageHeight + gap,
+                itemBuilder: (context, page) => Padding(
+                  padding: const EdgeInsets.symmetric(vertical: gap / 2),
+                  child: Align(
+                    alignment: Alignment.topLeft,
+                    child: Padding(
+                      padding: const EdgeInsets.only(left: gap),
+                      child: _buildPage(page, pageHeight),
+                    ),
+                  ),
+                ),
+              ),
+            ),
+          ),
+        );
+      },
+    );
+  }
+}
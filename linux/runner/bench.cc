@@ -0,0 +1,126 @@
+#include "bench.h"
+
+#include <errno.h>
+#include <gio/gio.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "startup_trace.h"
+
+namespace {
+
+typedef struct {
+  gchar* output;
+  // Monotonic microseconds.
+  gint64 launched_at;
+  gint64 first_frame;
+  int exit_status;
+} Bench;
+
+// Never freed; it lives as long as the process.
+Bench* bench = nullptr;
+
+// Reads a "Name:   123 kB" line of /proc/self/status.
+gint64 read_status_kb(const gchar* status, const gchar* name) {
+  const gchar* line = strstr(status, name);
+  if (line == nullptr) {
+    return -1;
+  }
+  return g_ascii_strtoll(line + strlen(name), nullptr, 10);
+}
+
+gboolean quit_cb(gpointer user_data) {
+  GApplication* application = g_application_get_default();
+  if (application != nullptr) {
+    g_application_quit(application);
+  }
+  return G_SOURCE_REMOVE;
+}
+
+}  // namespace
+
+void bench_init(int argc, char** argv) {
+  const gchar* scenario = nullptr;
+  const gchar* output = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (g_str_has_prefix(argv[i], kBenchArgument)) {
+      scenario = argv[i] + strlen(kBenchArgument);
+    } else if (g_str_has_prefix(argv[i], kBenchOutputArgument)) {
+      output = argv[i] + strlen(kBenchOutputArgument);
+    }
+  }
+  if (scenario == nullptr || scenario[0] == '\0') {
+    return;
+  }
+
+  gint64 now = g_get_monotonic_time();
+  bench = new Bench();
+  bench->output = output != nullptr && output[0] != '\0' ? g_strdup(output)
+                                                          : nullptr;
+  bench->launched_at = now;
+  bench->first_frame = -1;
+
+  const gchar* launched_at = g_getenv(kStartupTraceLaunchedAtEnv);
+  if (launched_at != nullptr) {
+    gint64 spawned = g_ascii_strtoll(launched_at, nullptr, 10);
+    if (spawned > 0 && spawned <= now) {
+      bench->launched_at = spawned;
+    }
+  }
+}
+
+gboolean bench_is_enabled() {
+  return bench != nullptr;
+}
+
+void bench_mark_first_frame() {
+  if (bench == nullptr || bench->first_frame >= 0) {
+    return;
+  }
+  bench->first_frame = g_get_monotonic_time() - bench->launched_at;
+}
+
+void bench_get_process_stats(BenchProcessStats* stats) {
+  stats->elapsed_us = 0;
+  stats->first_frame_us = -1;
+  stats->rss_kb = -1;
+  stats->peak_rss_kb = -1;
+  if (bench != nullptr) {
+    stats->elapsed_us = g_get_monotonic_time() - bench->launched_at;
+    stats->first_frame_us = bench->first_frame;
+  }
+
+  g_autofree gchar* status = nullptr;
+  if (g_file_get_contents("/proc/self/status", &status, nullptr, nullptr)) {
+    stats->rss_kb = read_status_kb(status, "VmRSS:");
+    stats->peak_rss_kb = read_status_kb(status, "VmHWM:");
+  }
+}
+
+gboolean bench_write_result(const gchar* line) {
+  if (bench == nullptr || bench->output == nullptr) {
+    printf("%s\n", line);
+    fflush(stdout);
+    return TRUE;
+  }
+
+  FILE* file = fopen(bench->output, "a");
+  if (file == nullptr) {
+    g_warning("Failed to open %s: %s", bench->output, g_strerror(errno));
+    return FALSE;
+  }
+  gboolean written = fprintf(file, "%s\n", line) >= 0;
+  written = fclose(file) == 0 && written;
+  return written;
+}
+
+void bench_finish(int exit_status) {
+  if (bench != nullptr) {
+    bench->exit_status = exit_status;
+  }
+  g_idle_add(quit_cb, nullptr);
+}
+
+int bench_get_exit_status() {
+  return bench != nullptr ? bench->exit_status : 0;
+}
@@ -0,0 +1,67 @@
+#ifndef RUNNER_BENCH_H_
+#define RUNNER_BENCH_H_
+
+#include <glib.h>
+
+// Entry point argument selecting the scenario to run, e.g. `--bench=search`.
+// The arguments reach Dart as its entrypoint arguments too, where the
+// scenario itself is driven; see lib/bench/bench_harness.dart.
+constexpr char kBenchArgument[] = "--bench=";
+// Optional file the results are appended to, one JSON object per line.
+// Without it they are printed on stdout.
+constexpr char kBenchOutputArgument[] = "--bench-output=";
+
+// The process-wide figures every result carries, in microseconds and KiB.
+typedef struct {
+  // Since the process was launched.
+  gint64 elapsed_us;
+  // From launch to the first Flutter frame, or -1 before it.
+  gint64 first_frame_us;
+  gint64 rss_kb;
+  gint64 peak_rss_kb;
+} BenchProcessStats;
+
+/**
+ * bench_init:
+ * @argc: the argument count passed to main().
+ * @argv: the arguments passed to main().
+ *
+ * Enables the harness if `--bench=<scenario>` is among the arguments. The
+ * launch time is taken from `ECHOLENS_STARTUP_TRACE_LAUNCHED_AT` when a
+ * launcher sets it, so that a cold start scenario includes exec and dynamic
+ * linking, and is the time of this call otherwise.
+ */
+void bench_init(int argc, char** argv);
+
+gboolean bench_is_enabled();
+
+/**
+ * bench_mark_first_frame:
+ *
+ * Records that Flutter rendered its first frame.
+ */
+void bench_mark_first_frame();
+
+void bench_get_process_stats(BenchProcessStats* stats);
+
+/**
+ * bench_write_result:
+ * @line: a result encoded as JSON, without a trailing newline.
+ *
+ * Appends @line to the output.
+ *
+ * Returns: %FALSE if the output could not be written.
+ */
+gboolean bench_write_result(const gchar* line);
+
+/**
+ * bench_finish:
+ * @exit_status: the status the process should exit with.
+ *
+ * Quits the application once the event loop is idle.
+ */
+void bench_finish(int exit_status);
+
+int bench_get_exit_status();
+
+#endif  // RUNNER_BENCH_H_
@@ -0,0 +1,18 @@
+// Entry point of the ${BINARY_NAME}_bench target: the application with the
+// benchmark harness of bench.h, run as `currency_converter_bench
+// --bench=<scenario>`.
+
+#include "bench.h"
+#include "frame_stats.h"
+#include "my_application.h"
+#include "startup_trace.h"
+
+int main(int argc, char** argv) {
+  startup_trace_init(argc, argv);
+  frame_stats_init(argc, argv);
+  bench_init(argc, argv);
+
+  g_autoptr(MyApplication) app = my_application_new();
+  int status = g_application_run(G_APPLICATION(app), argc, argv);
+  return status != 0 ? status : bench_get_exit_status();
+}
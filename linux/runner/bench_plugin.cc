@@ -0,0 +1,106 @@
+#include "bench_plugin.h"
+
+#include <cstring>
+
+#include "bench.h"
+
+static constexpr char kChannelName[] = "echolens/bench";
+
+static constexpr char kProcessStatsMethod[] = "processStats";
+static constexpr char kReportMethod[] = "report";
+
+static constexpr char kBadArgumentsError[] = "Bad Arguments";
+static constexpr char kWriteFailedError[] = "Write Failed";
+
+struct _BenchPlugin {
+  GObject parent_instance;
+};
+
+G_DEFINE_TYPE(BenchPlugin, bench_plugin, G_TYPE_OBJECT)
+
+static FlMethodResponse* process_stats() {
+  BenchProcessStats stats;
+  bench_get_process_stats(&stats);
+  g_autoptr(FlValue) result = fl_value_new_map();
+  fl_value_set_string_take(result, "elapsedUs",
+                           fl_value_new_int(stats.elapsed_us));
+  fl_value_set_string_take(result, "firstFrameUs",
+                           fl_value_new_int(stats.first_frame_us));
+  fl_value_set_string_take(result, "rssKb", fl_value_new_int(stats.rss_kb));
+  fl_value_set_string_take(result, "peakRssKb",
+                           fl_value_new_int(stats.peak_rss_kb));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+static FlMethodResponse* report(FlValue* args) {
+  FlValue* result = nullptr;
+  FlValue* failed = nullptr;
+  if (fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    result = fl_value_lookup_string(args, "result");
+    failed = fl_value_lookup_string(args, "failed");
+  }
+  if (result == nullptr || fl_value_get_type(result) != FL_VALUE_TYPE_STRING ||
+      failed == nullptr || fl_value_get_type(failed) != FL_VALUE_TYPE_BOOL) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        kBadArgumentsError, "Expected result and failed", nullptr));
+  }
+
+  if (!bench_write_result(fl_value_get_string(result))) {
+    bench_finish(1);
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        kWriteFailedError, "Failed to write the result", nullptr));
+  }
+  bench_finish(fl_value_get_bool(failed) ? 1 : 0);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+}
+
+// Called when a method call is received from Flutter.
+static void method_call_cb(FlMethodChannel* channel,
+                           FlMethodCall* method_call,
+                           gpointer user_data) {
+  const gchar* method = fl_method_call_get_name(method_call);
+
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (strcmp(method, kProcessStatsMethod) == 0) {
+    response = process_stats();
+  } else if (strcmp(method, kReportMethod) == 0) {
+    response = report(fl_method_call_get_args(method_call));
+  } else {
+    response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+  }
+
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(method_call, response, &error)) {
+    g_warning("Failed to send method call response: %s", error->message);
+  }
+}
+
+// Called when the first Flutter frame is received.
+static void first_frame_cb(FlView* view, gpointer user_data) {
+  bench_mark_first_frame();
+}
+
+static void bench_plugin_class_init(BenchPluginClass* klass) {}
+
+static void bench_plugin_init(BenchPlugin* self) {}
+
+void bench_plugin_register_with_registrar(FlPluginRegistrar* registrar) {
+  BenchPlugin* plugin =
+      BENCH_PLUGIN(g_object_new(bench_plugin_get_type(), nullptr));
+
+  FlView* view = fl_plugin_registrar_get_view(registrar);
+  if (view != nullptr) {
+    g_signal_connect(view, "first-frame", G_CALLBACK(first_frame_cb),
+                     nullptr);
+  }
+
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  g_autoptr(FlMethodChannel) channel =
+      fl_method_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                            kChannelName, FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(channel, method_call_cb,
+                                            g_object_ref(plugin),
+                                            g_object_unref);
+
+  g_object_unref(plugin);
+}
@@ -0,0 +1,20 @@
+#ifndef RUNNER_BENCH_PLUGIN_H_
+#define RUNNER_BENCH_PLUGIN_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+G_DECLARE_FINAL_TYPE(BenchPlugin, bench_plugin, BENCH, PLUGIN, GObject)
+
+/**
+ * bench_plugin_register_with_registrar:
+ * @registrar: an #FlPluginRegistrar.
+ *
+ * Registers the "echolens/bench" method channel of the benchmark harness,
+ * which only the ${BINARY_NAME}_bench target includes. `processStats`
+ * replies with `{elapsedUs, firstFrameUs, rssKb, peakRssKb}`; `report` takes
+ * `{result, failed}`, writes the JSON @result and quits, exiting with status
+ * 1 when @failed is true.
+ */
+void bench_plugin_register_with_registrar(FlPluginRegistrar* registrar);
+
+#endif  // RUNNER_BENCH_PLUGIN_H_
@@ -0,0 +1,109 @@
+// Microbenchmark for fuzzy_matcher_match().
+//
+// Usage: fuzzy_matcher_benchmark [--titles N] [needle ...]
+//
+// Puts N (10000) synthetic research queries, names with and without
+// diacritics at a handful of affiliations, and times matching each needle
+// against all of them, highlights included. Without needles, a set of exact,
+// misspelt and multi-word ones is used.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../fuzzy_matcher.h"
+
+namespace {
+
+constexpr const char* kFirstNames[] = {
+    "Jane",    "John",          "Ada",    "Luis",      "Mei",
+    "Sam",     "Zo\xc3\xab",     "Priya",  "Olu",       "Anders",
+    "Fatima",  "Kenji",         "Noah",   "Emma",      "Wei",
+    "Dmitri",  "Chlo\xc3\xa9",   "Rahul",  "J\xc3\xbcrgen", "Mar\xc3\xad" "a",
+};
+
+constexpr const char* kLastNames[] = {
+    "Roe",     "Doe",           "Park",   "Ortega",    "Chen",
+    "Okafor",  "M\xc3\xbcller",  "Singh",  "Nakamura",  "Adeyemi",
+    "Larsen",  "Haddad",        "Rossi",  "Kowalski",  "Nguyen",
+    "Smith",   "Ivanova",       "Dubois", "Patel",     "Garc\xc3\xad" "a",
+};
+
+constexpr const char* kAffiliations[] = {
+    "MIT",        "Stanford University",  "ETH Z\xc3\xbcrich",
+    "IIT Bombay", "University of Toronto", "University of Oxford",
+    "CMU",        "EPFL",                  "Tsinghua",
+    "UCL",
+};
+
+// Exact, misspelt, folded and multi-word needles, and one matching nothing.
+constexpr const char* kNeedles[] = {
+    "j",       "jane",     "jnae",   "stanfrd", "muller eth",
+    "roe mit", "kowalsky", "garcia", "zzzz",
+};
+
+double median(std::vector<double> samples) {
+  std::sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t count = 10000;
+  std::vector<std::string> needles;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--titles") == 0 && i + 1 < argc) {
+      count = strtoul(argv[++i], nullptr, 10);
+      continue;
+    }
+    needles.push_back(argv[i]);
+  }
+  if (needles.empty()) {
+    needles.assign(std::begin(kNeedles), std::end(kNeedles));
+  }
+
+  std::mt19937 random(1);
+  auto pick = [&random](const auto& names) {
+    return std::string(names[random() % (sizeof(names) / sizeof(names[0]))]);
+  };
+  FuzzyMatcher* matcher = fuzzy_matcher_new();
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < count; i++) {
+    std::string title = random() % 3 == 0 ? "Dr. " : "";
+    title += pick(kFirstNames) + " " + pick(kLastNames) + ", " +
+             pick(kAffiliations);
+    fuzzy_matcher_put(matcher, std::to_string(i), i, title);
+  }
+  auto end = std::chrono::steady_clock::now();
+  FuzzyMatcherStats stats = fuzzy_matcher_get_stats(matcher);
+  printf("%zu titles, %llu folded characters, put in %.1f ms\n", count,
+         static_cast<unsigned long long>(stats.folded_chars),
+         std::chrono::duration<double, std::milli>(end - start).count());
+
+  std::vector<FuzzyMatch> matches;
+  for (const std::string& needle : needles) {
+    std::vector<double> samples;
+    auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(300);
+    while (samples.size() < 5 || std::chrono::steady_clock::now() < deadline) {
+      start = std::chrono::steady_clock::now();
+      fuzzy_matcher_match(matcher, needle, 0, &matches);
+      end = std::chrono::steady_clock::now();
+      samples.push_back(
+          std::chrono::duration<double, std::micro>(end - start).count());
+    }
+    printf("%-16s %6zu matches %8.1f us\n", needle.c_str(), matches.size(),
+           median(samples));
+  }
+
+  fuzzy_matcher_free(matcher);
+  return 0;
+}
@@ -0,0 +1,149 @@
+// Microbenchmark for gemini_response_parse().
+//
+// Usage: gemini_parser_benchmark [--dump DIR] [payload.json ...]
+//
+// Without payload files, synthetic grounded responses of 10 KB to 2 MB are
+// generated. --dump writes the payloads that were measured so that
+// benchmark/gemini_parser_benchmark.dart can time the Dart path
+// (jsonDecode + _applyChunk) on exactly the same bytes.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../gemini_response_parser.h"
+
+namespace {
+
+constexpr size_t kSyntheticSizes[] = {10 * 1024, 100 * 1024, 500 * 1024,
+                                      2 * 1024 * 1024};
+
+std::string make_answer() {
+  std::string answer;
+  const char* fields[] = {"Full Name", "Current Designation/Job Title",
+                          "Department", "University or Affiliation",
+                          "Contact Emails", "Research Interests",
+                          "Education History", "Location"};
+  for (const char* field : fields) {
+    answer += "**";
+    answer += field;
+    answer +=
+        "**: Lorem ipsum dolor sit amet, \\\"consectetur\\\" adipiscing "
+        "elit, sed do eiusmod tempor \\u00e9l\\u00e8ve.\\n\\n";
+  }
+  return answer;
+}
+
+// Builds a response shaped like a real grounded answer, padded with
+// groundingSupports entries until it reaches @target_size bytes.
+std::string make_payload(size_t target_size) {
+  std::string json = "{\"candidates\":[{\"content\":{\"parts\":[{\"text\":\"";
+  json += make_answer();
+  json += "\"}],\"role\":\"model\"},\"finishReason\":\"STOP\","
+          "\"groundingMetadata\":{\"searchEntryPoint\":{\"renderedContent\":"
+          "\"<style>.container{align-items:center;border-radius:8px;}"
+          "</style><div class=\\\"container\\\"></div>\"},"
+          "\"groundingChunks\":[";
+  for (int i = 0; i < 40; i++) {
+    if (i > 0) {
+      json += ",";
+    }
+    json += "{\"web\":{\"uri\":\"https://vertexaisearch.cloud.google.com/"
+            "grounding-api-redirect/AbF9wXE" +
+            std::to_string(i) +
+            "\",\"title\":\"source-" + std::to_string(i) + ".example.com\"}}";
+  }
+  json += "],\"groundingSupports\":[";
+  const std::string tail = "],\"webSearchQueries\":[\"jane roe mit\"]}}],"
+                           "\"usageMetadata\":{\"promptTokenCount\":120,"
+                           "\"candidatesTokenCount\":512}}";
+  for (int i = 0; json.size() + tail.size() < target_size; i++) {
+    if (i > 0) {
+      json += ",";
+    }
+    json += "{\"segment\":{\"startIndex\":" + std::to_string(i * 31) +
+            ",\"endIndex\":" + std::to_string(i * 31 + 30) +
+            ",\"text\":\"**Research Interests**: distributed systems, "
+            "stream processing\"},\"groundingChunkIndices\":[0,3,7],"
+            "\"confidenceScores\":[0.91,0.72,0.66]}";
+  }
+  json += tail;
+  return json;
+}
+
+double median(std::vector<double> samples) {
+  std::sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+
+void run(const std::string& name, const std::string& payload) {
+  GeminiParseResult result;
+  std::vector<double> samples;
+  auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(300);
+  while (samples.size() < 5 || std::chrono::steady_clock::now() < deadline) {
+    auto start = std::chrono::steady_clock::now();
+    bool ok = gemini_response_parse(payload.data(), payload.size(), &result);
+    std::vector<uint8_t> packed = gemini_response_pack(result);
+    auto end = std::chrono::steady_clock::now();
+    if (!ok || packed.empty()) {
+      fprintf(stderr, "%s: parse failed\n", name.c_str());
+      return;
+    }
+    samples.push_back(
+        std::chrono::duration<double, std::micro>(end - start).count());
+  }
+
+  double micros = median(samples);
+  printf("%-28s %10zu bytes %10.1f us %8.1f MB/s %4zu sources\n",
+         name.c_str(), payload.size(), micros, payload.size() / micros,
+         result.sources.size());
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const char* dump_dir = nullptr;
+  std::vector<std::pair<std::string, std::string>> payloads;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc) {
+      dump_dir = argv[++i];
+      continue;
+    }
+    std::ifstream file(argv[i], std::ios::binary);
+    if (!file) {
+      fprintf(stderr, "Cannot read %s\n", argv[i]);
+      return 1;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    payloads.emplace_back(argv[i], contents.str());
+  }
+
+  if (payloads.empty()) {
+    for (size_t size : kSyntheticSizes) {
+      payloads.emplace_back("synthetic_" + std::to_string(size / 1024) + "k",
+                            make_payload(size));
+    }
+  }
+
+  for (const auto& payload : payloads) {
+    if (dump_dir != nullptr) {
+      std::string name = payload.first;
+      std::replace(name.begin(), name.end(), '/', '_');
+      std::ofstream out(std::string(dump_dir) + "/" + name + ".json",
+                        std::ios::binary);
+      out << payload.second;
+    }
+    run(payload.first, payload.second);
+  }
+  return 0;
+}
@@ -0,0 +1,119 @@
+// Microbenchmark for markdown_document_parse() and markdown_document_pack().
+//
+// Usage: markdown_document_benchmark [--dump DIR] [answer.md ...]
+//
+// Without answer files, synthetic profiles of 2 KB to 200 KB are generated.
+// --dump writes each answer as NAME.md and its packed document as NAME.bin
+// so that benchmark/answer_view_benchmark.dart can time rebuilding the
+// screen with exactly the same answer, parsed and unparsed.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../markdown_document.h"
+
+namespace {
+
+constexpr size_t kSyntheticSizes[] = {2 * 1024, 20 * 1024, 200 * 1024};
+
+// Builds an answer shaped like the profile prompt's output, at least @size
+// bytes long.
+std::string make_answer(size_t size) {
+  std::string answer =
+      "**Full Name**: Jane Roe\n\n"
+      "**Current Designation/Job Title**: Associate Professor\n\n"
+      "**Department**: Electrical Engineering and Computer Science\n\n"
+      "**Contact Emails**:\n- jroe@mit.edu\n- jane.roe@csail.mit.edu\n\n";
+  while (answer.size() < size) {
+    answer +=
+        "**Research Interests or Key Achievements**:\n"
+        "- Distributed systems, *stream processing* and fault-tolerant "
+        "consensus protocols deployed at planetary scale.\n"
+        "- Best Paper Award at SOSP for work on `deterministic replay` of "
+        "datacenter workloads, see [the paper](https://example.org/replay).\n"
+        "  - Follow-up work on \xc3\xa9nergie-proportional storage.\n\n"
+        "**Education History**:\n"
+        "1. Ph.D. in Computer Science, Stanford University\n"
+        "2. B.S. in Mathematics, University of Toronto\n\n";
+  }
+  answer +=
+      "**Summary**\n"
+      "Jane Roe is a systems researcher whose work bridges theory and "
+      "practice in large-scale distributed computing.\n";
+  return answer;
+}
+
+double median(std::vector<double> samples) {
+  std::sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+
+std::vector<uint8_t> run(const std::string& name, const std::string& answer) {
+  std::vector<double> samples;
+  std::vector<uint8_t> packed;
+  MarkdownDocument document;
+  auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(300);
+  while (samples.size() < 5 || std::chrono::steady_clock::now() < deadline) {
+    auto start = std::chrono::steady_clock::now();
+    markdown_document_parse(answer.data(), answer.size(), &document);
+    packed = markdown_document_pack(document);
+    auto end = std::chrono::steady_clock::now();
+    samples.push_back(
+        std::chrono::duration<double, std::micro>(end - start).count());
+  }
+  printf("%-24s %8zu bytes %6zu blocks %6zu spans %8zu packed %8.1f us\n",
+         name.c_str(), answer.size(), document.blocks.size(),
+         document.spans.size(), packed.size(), median(samples));
+  return packed;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const char* dump_dir = nullptr;
+  std::vector<std::pair<std::string, std::string>> answers;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc) {
+      dump_dir = argv[++i];
+      continue;
+    }
+    std::ifstream file(argv[i], std::ios::binary);
+    if (!file) {
+      fprintf(stderr, "Cannot read %s\n", argv[i]);
+      return 1;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    answers.emplace_back(argv[i], contents.str());
+  }
+
+  if (answers.empty()) {
+    for (size_t size : kSyntheticSizes) {
+      answers.emplace_back("answer_" + std::to_string(size / 1024) + "kb",
+                           make_answer(size));
+    }
+  }
+
+  for (const auto& answer : answers) {
+    std::vector<uint8_t> packed = run(answer.first, answer.second);
+    if (dump_dir != nullptr) {
+      std::string name = answer.first;
+      std::replace(name.begin(), name.end(), '/', '_');
+      std::string base = std::string(dump_dir) + "/" + name;
+      std::ofstream(base + ".md", std::ios::binary) << answer.second;
+      std::ofstream(base + ".bin", std::ios::binary)
+          .write(reinterpret_cast<const char*>(packed.data()), packed.size());
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,163 @@
+// Scrolling benchmark for the PDF preview's tile rasterizer.
+//
+// Usage: pdf_preview_benchmark [--pages N] [--threads N] [--cache-mb N]
+//                              [--speed PX] [zoom ...]
+//
+// Lays out a synthetic report of at least N pages (15) and scrolls a
+// 1280x720 viewport through it from top to bottom at each zoom level
+// (default 0, 4 and 8, i.e. 72, 144 and 288 dpi), PX pixels per 60 Hz frame
+// (48). Each frame requests the tiles on screen like the preview does, then
+// checks at the next vsync which of them are ready. Prints the frames that
+// were drawn completely, the tiles that were still blank, the rasterizing
+// time per tile and the cache size, which stays within --cache-mb (64) plus
+// the tiles on screen.
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "../pdf_preview.h"
+#include "../pdf_report.h"
+
+namespace {
+
+constexpr int kViewportWidth = 1280;
+constexpr int kViewportHeight = 720;
+constexpr gint64 kFrameUs = G_USEC_PER_SEC / 60;
+
+// An answer shaped like the profile prompt's output; @repeats copies of the
+// research section make it longer.
+std::string make_answer(int repeats) {
+  std::string answer =
+      "**Full Name**: Jane Roe\n\n"
+      "**Current Designation/Job Title**: Associate Professor\n\n"
+      "**University or Affiliation**: Massachusetts Institute of "
+      "Technology\n\n";
+  for (int i = 0; i < repeats; i++) {
+    answer +=
+        "**Research Interests or Key Achievements**:\n"
+        "- Distributed systems, *stream processing* and fault-tolerant "
+        "consensus protocols deployed at planetary scale.\n"
+        "- Best Paper Award at SOSP for work on `deterministic replay` of "
+        "datacenter workloads, cited over 1,200 times.\n\n"
+        "**Education History**:\n"
+        "1. Ph.D. in Computer Science, Stanford University\n"
+        "2. B.S. in Mathematics, University of Toronto\n\n";
+  }
+  return answer;
+}
+
+void tile_ready(const PdfTileKey& key, gpointer user_data) {}
+
+void scroll(PdfPreview* preview, int zoom, int speed) {
+  int columns, rows, width, height;
+  pdf_preview_get_grid(zoom, &columns, &rows, &width, &height);
+  int pages = pdf_preview_get_page_count(preview);
+  int document_height = pages * height;
+  int visible_columns =
+      std::min(columns, (kViewportWidth + kPdfTileSize - 1) / kPdfTileSize);
+
+  int frames = 0;
+  int complete = 0;
+  int blank = 0;
+  uint64_t peak_bytes = 0;
+  PdfPreviewStats before = pdf_preview_get_stats(preview);
+  gint64 start = g_get_monotonic_time();
+  for (int top = 0; top < document_height; top += speed) {
+    std::vector<PdfTileKey> visible;
+    int bottom = std::min(top + kViewportHeight, document_height);
+    for (int y = top; y < bottom;) {
+      int page = y / height;
+      int row = (y % height) / kPdfTileSize;
+      for (int x = 0; x < visible_columns; x++) {
+        visible.push_back({page, zoom, x, row});
+      }
+      y = std::min(page * height + (row + 1) * kPdfTileSize,
+                   (page + 1) * height);
+    }
+    pdf_preview_request(preview, visible, 1);
+
+    // What the next frame would show.
+    gint64 vsync = start + (frames + 1) * kFrameUs;
+    gint64 now = g_get_monotonic_time();
+    if (vsync > now) {
+      g_usleep(vsync - now);
+    }
+    int missing = 0;
+    for (const PdfTileKey& key : visible) {
+      if (pdf_preview_lookup(preview, key) == nullptr) {
+        missing++;
+      }
+    }
+    frames++;
+    complete += missing == 0;
+    blank += missing;
+    peak_bytes =
+        std::max(peak_bytes, pdf_preview_get_stats(preview).cache_bytes);
+  }
+
+  PdfPreviewStats after = pdf_preview_get_stats(preview);
+  uint64_t rasterized = after.rasterized - before.rasterized;
+  printf("zoom %3d (%4dx%4d px/page): %5d frames, %5.1f%% complete, "
+         "%5d blank tiles, %5llu tiles at %6.2f ms avg, peak cache %.1f MB\n",
+         zoom, width, height, frames, 100.0 * complete / MAX(frames, 1),
+         blank, static_cast<unsigned long long>(rasterized),
+         rasterized > 0
+             ? (after.raster_us - before.raster_us) / 1000.0 / rasterized
+             : 0.0,
+         peak_bytes / 1048576.0);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int min_pages = 15;
+  int speed = 48;
+  PdfPreviewOptions options = kPdfPreviewOptions;
+  std::vector<int> zooms;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--pages") == 0 && i + 1 < argc) {
+      min_pages = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      options.threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--cache-mb") == 0 && i + 1 < argc) {
+      options.cache_bytes = static_cast<size_t>(atoi(argv[++i])) << 20;
+    } else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+      speed = MAX(atoi(argv[++i]), 1);
+    } else {
+      zooms.push_back(CLAMP(atoi(argv[i]), kPdfPreviewMinZoom,
+                            kPdfPreviewMaxZoom));
+    }
+  }
+  if (zooms.empty()) {
+    zooms = {0, 4, 8};
+  }
+
+  PdfReport report;
+  report.title = "EchoLens Profile Report";
+  report.date = "2024-05-01";
+  report.footer = "Generated by EchoLens AI";
+  PdfReportPages* pages = nullptr;
+  for (int repeats = 8;; repeats *= 2) {
+    report.markdown = make_answer(repeats);
+    pages = pdf_report_layout(report);
+    if (pdf_report_pages_get_count(pages) >= min_pages) {
+      break;
+    }
+    pdf_report_pages_free(pages);
+  }
+  printf("%d pages, cache %zu MB\n", pdf_report_pages_get_count(pages),
+         options.cache_bytes >> 20);
+
+  PdfPreview* preview = pdf_preview_new(pages, options, tile_ready, nullptr);
+  for (int zoom : zooms) {
+    scroll(preview, zoom, speed);
+  }
+  pdf_preview_free(preview);
+  return 0;
+}
@@ -0,0 +1,242 @@
+// Benchmark for pdf_report_write() and pdf_batch_export().
+//
+// Usage: pdf_report_benchmark [--dump DIR] [answer.md ...]
+//        pdf_report_benchmark --batch N
+//
+// Without answer files, synthetic profiles from a typical single page up to
+// a long multi-page report are generated. Each is written with cairo
+// embedding the fonts itself and then through the font subset cache, first
+// emptied, so that the file size and time of both can be compared. --dump
+// writes the Markdown that was measured so that
+// benchmark/pdf_report_benchmark.dart can time the Dart path
+// (_convertToHtml + htmltopdfwidgets + pdf) on exactly the same input.
+//
+// --batch exports N synthetic reports as separate files and as one merged
+// file with 1, 2, 4, ... threads up to the processor count, and prints the
+// throughput of each so that the scaling with cores can be read off.
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../pdf_batch.h"
+#include "../pdf_font_subset.h"
+#include "../pdf_report.h"
+
+namespace {
+
+constexpr int kSyntheticRepeats[] = {1, 8, 40};
+
+// Builds an answer shaped like the profile prompt's output; @repeats copies
+// of the research section make it longer.
+std::string make_answer(int repeats) {
+  std::string answer =
+      "**Full Name**: Jane Roe\n\n"
+      "**Current Designation/Job Title**: Associate Professor\n\n"
+      "**Department**: Electrical Engineering and Computer Science\n\n"
+      "**University or Affiliation**: Massachusetts Institute of Technology\n\n"
+      "**Contact Emails**:\n- jroe@mit.edu\n- jane.roe@csail.mit.edu\n\n";
+  for (int i = 0; i < repeats; i++) {
+    answer +=
+        "**Research Interests or Key Achievements**:\n"
+        "- Distributed systems, *stream processing* and fault-tolerant "
+        "consensus protocols deployed at planetary scale.\n"
+        "- Best Paper Award at SOSP for work on `deterministic replay` of "
+        "datacenter workloads, cited over 1,200 times.\n"
+        "- Principal investigator on a five-year NSF CAREER grant studying "
+        "energy-proportional storage for machine learning clusters.\n\n"
+        "**Education History**:\n"
+        "1. Ph.D. in Computer Science, Stanford University\n"
+        "2. B.S. in Mathematics, University of Toronto\n\n";
+  }
+  answer +=
+      "**Location**: Cambridge, Massachusetts, USA\n\n"
+      "**Summary**\n"
+      "Jane Roe is a systems researcher whose work bridges theory and "
+      "practice in large-scale distributed computing, with a record of "
+      "influential publications and open-source infrastructure.\n";
+  return answer;
+}
+
+double median(std::vector<double> samples) {
+  std::sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+
+void run(const std::string& name, const std::string& markdown, bool subset) {
+  pdf_font_subset_set_enabled(subset);
+  pdf_font_subset_clear_cache();
+  PdfReport report;
+  report.title = "EchoLens Profile Report";
+  report.date = "2024-05-01";
+  report.markdown = markdown;
+  report.footer = "Generated by EchoLens AI";
+
+  g_autofree gchar* path =
+      g_build_filename(g_get_tmp_dir(), "pdf_report_benchmark.pdf", nullptr);
+  std::vector<double> samples;
+  int pages = 0;
+  auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(1000);
+  while (samples.size() < 5 || std::chrono::steady_clock::now() < deadline) {
+    std::string error;
+    auto start = std::chrono::steady_clock::now();
+    bool ok = pdf_report_write(report, path, &pages, &error);
+    auto end = std::chrono::steady_clock::now();
+    if (!ok) {
+      fprintf(stderr, "%s: %s\n", name.c_str(), error.c_str());
+      return;
+    }
+    samples.push_back(
+        std::chrono::duration<double, std::milli>(end - start).count());
+  }
+  GStatBuf info;
+  long long size = g_stat(path, &info) == 0 ? info.st_size : 0;
+  g_remove(path);
+
+  // The first sample pays for fontconfig and font loading, and for making
+  // the subsets; report it apart.
+  double first = samples.front();
+  printf("%-28s %-7s %8zu bytes %3d pages %9lld bytes out %8.2f ms "
+         "(first %.2f ms)\n",
+         name.c_str(), subset ? "subset" : "cairo", markdown.size(), pages,
+         size, median(samples), first);
+}
+
+// Returns reports per second, or 0 on failure.
+double run_batch(const std::vector<PdfReport>& reports,
+                 const std::string& directory,
+                 bool merged,
+                 guint threads) {
+  PdfBatchOptions options;
+  if (merged) {
+    g_autofree gchar* path =
+        g_build_filename(directory.c_str(), "merged.pdf", nullptr);
+    options.merged_path = path;
+    options.merged_title = "EchoLens Profile Reports";
+  } else {
+    options.directory = directory;
+  }
+  options.threads = threads;
+
+  PdfBatchResult result;
+  auto start = std::chrono::steady_clock::now();
+  bool ok = pdf_batch_export(reports, options, nullptr, nullptr, nullptr,
+                             &result);
+  auto end = std::chrono::steady_clock::now();
+  for (const std::string& path : result.paths) {
+    g_remove(path.c_str());
+  }
+  if (!ok) {
+    fprintf(stderr, "batch: %s\n", result.error.c_str());
+    return 0;
+  }
+  return reports.size() / std::chrono::duration<double>(end - start).count();
+}
+
+int batch(int count) {
+  std::vector<PdfReport> reports(count);
+  for (int i = 0; i < count; i++) {
+    reports[i].name = "Researcher " + std::to_string(i + 1);
+    reports[i].title = "EchoLens Profile Report";
+    reports[i].date = "2024-05-01";
+    reports[i].markdown = make_answer(1 + i % 8);
+    reports[i].footer = "Generated by EchoLens AI";
+  }
+
+  g_autoptr(GError) error = nullptr;
+  g_autofree gchar* directory =
+      g_dir_make_tmp("pdf_report_benchmark-XXXXXX", &error);
+  if (directory == nullptr) {
+    fprintf(stderr, "%s\n", error->message);
+    return 1;
+  }
+
+  // Loads fonts once so the first measurement is not penalised.
+  pdf_report_pages_free(pdf_report_layout(reports[0]));
+
+  guint cores = g_get_num_processors();
+  printf("%d reports, %u processors\n", count, cores);
+  printf("%8s %16s %16s\n", "threads", "files/s", "merged/s");
+  double base = 0;
+  for (guint threads = 1;; threads = MIN(threads * 2, cores)) {
+    double separate = run_batch(reports, directory, false, threads);
+    double merged = run_batch(reports, directory, true, threads);
+    if (threads == 1) {
+      base = separate;
+    }
+    printf("%8u %10.1f (%3.1fx) %10.1f\n", threads, separate,
+           base > 0 ? separate / base : 0, merged);
+    if (threads == cores) {
+      break;
+    }
+  }
+
+  g_rmdir(directory);
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const char* dump_dir = nullptr;
+  std::vector<std::pair<std::string, std::string>> answers;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+      return batch(MAX(atoi(argv[++i]), 1));
+    }
+    if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc) {
+      dump_dir = argv[++i];
+      continue;
+    }
+    std::ifstream file(argv[i], std::ios::binary);
+    if (!file) {
+      fprintf(stderr, "Cannot read %s\n", argv[i]);
+      return 1;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    answers.emplace_back(argv[i], contents.str());
+  }
+
+  if (answers.empty()) {
+    for (int repeats : kSyntheticRepeats) {
+      answers.emplace_back("profile_x" + std::to_string(repeats),
+                           make_answer(repeats));
+    }
+  }
+
+  for (const auto& answer : answers) {
+    if (dump_dir != nullptr) {
+      std::string name = answer.first;
+      std::replace(name.begin(), name.end(), '/', '_');
+      std::ofstream out(std::string(dump_dir) + "/" + name + ".md",
+                        std::ios::binary);
+      out << answer.second;
+    }
+    run(answer.first, answer.second, false);
+    run(answer.first, answer.second, true);
+  }
+
+  PdfFontSubsetStats stats = pdf_font_subset_get_stats();
+  printf("subsets: %llu made in %.2f ms, %llu hits, %llu runs not subset, "
+         "%llu font bytes to %llu\n",
+         static_cast<unsigned long long>(stats.misses),
+         stats.subset_us / 1000.0,
+         static_cast<unsigned long long>(stats.hits),
+         static_cast<unsigned long long>(stats.fallbacks),
+         static_cast<unsigned long long>(stats.source_bytes),
+         static_cast<unsigned long long>(stats.subset_bytes));
+  return 0;
+}
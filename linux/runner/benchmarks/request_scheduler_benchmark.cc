@@ -0,0 +1,211 @@
+// Load test for request_scheduler_perform() against a faulty server.
+//
+// Usage: request_scheduler_benchmark [-n REQUESTS] [-c CONCURRENCY]
+//                                    [--deadline MS] [--rate PER_SECOND]
+//                                    [--burst N] [--attempts N] [--no-pool]
+//                                    URL
+//
+// Sends REQUESTS (default 40) generateContent calls to URL, CONCURRENCY
+// (default 8) at a time, through one scheduler configured like the runner's
+// except where overridden. Start the stand-in with faults first, e.g.
+//
+//   python3 tool/gemini_stand_in.py --fault-rate 0.3 --retry-after 1
+//
+// and pass it the stand-in's model URL followed by ":generateContent".
+// Prints how each request ended, p50/p95 latency and the scheduler's
+// counters, so that retries, throttling and deadlines can be checked.
+//
+// Requests share the runner's connection pool unless --no-pool is given, in
+// which case every attempt opens its own connection. Comparing the handshake
+// and first byte times of both, e.g. against the stand-in with --tls, shows
+// what the pool takes off the critical path.
+
+#include <curl/curl.h>
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../request_scheduler.h"
+
+namespace {
+
+constexpr int kDefaultRequests = 40;
+constexpr int kDefaultConcurrency = 8;
+constexpr int64_t kDefaultDeadlineMs = 120000;
+
+struct Run {
+  RequestScheduler* scheduler;
+  const char* url;
+  int64_t deadline_ms;
+
+  GMutex lock;
+  std::map<std::string, int> outcomes;
+  std::vector<double> latencies_ms;
+  std::vector<double> handshakes_ms;
+  std::vector<double> ttfbs_ms;
+  int reused;
+};
+
+const char* outcome_name(const ScheduledResult& result) {
+  switch (result.outcome) {
+    case SCHEDULED_REQUEST_OK:
+      return "ok";
+    case SCHEDULED_REQUEST_CANCELLED:
+      return "cancelled";
+    case SCHEDULED_REQUEST_DEADLINE:
+      return "deadline";
+    case SCHEDULED_REQUEST_TRANSPORT_ERROR:
+      return "transport error";
+    case SCHEDULED_REQUEST_HTTP_ERROR:
+      return "http error";
+  }
+  return "";
+}
+
+void request_cb(gpointer data, gpointer user_data) {
+  Run* run = static_cast<Run*>(user_data);
+  int index = GPOINTER_TO_INT(data) - 1;
+
+  ScheduledRequest request;
+  request.url = run->url;
+  request.body = "{\"contents\":[{\"parts\":[{\"text\":\"request " +
+                 std::to_string(index) + "\"}]}]}";
+  request.headers = {"Content-Type: application/json"};
+  int64_t start = g_get_monotonic_time();
+  request.deadline_us = start + run->deadline_ms * 1000;
+  request.cancellable = nullptr;
+  request.on_data = nullptr;
+  request.user_data = nullptr;
+
+  ScheduledResult result;
+  request_scheduler_perform(run->scheduler, request, &result);
+  double elapsed_ms = (g_get_monotonic_time() - start) / 1000.0;
+
+  std::string outcome = outcome_name(result);
+  if (result.outcome == SCHEDULED_REQUEST_HTTP_ERROR) {
+    outcome += " " + std::to_string(result.status);
+  }
+  g_mutex_lock(&run->lock);
+  run->outcomes[outcome]++;
+  run->latencies_ms.push_back(elapsed_ms);
+  if (result.attempts > 0) {
+    const ConnectionMetrics& metrics = result.metrics;
+    run->handshakes_ms.push_back(
+        (metrics.dns_us + metrics.connect_us + metrics.tls_us) / 1000.0);
+    run->ttfbs_ms.push_back(metrics.ttfb_us / 1000.0);
+    if (metrics.reused) {
+      run->reused++;
+    }
+  }
+  g_mutex_unlock(&run->lock);
+}
+
+double percentile(std::vector<double> samples, double fraction) {
+  if (samples.empty()) {
+    return 0;
+  }
+  std::sort(samples.begin(), samples.end());
+  size_t index = static_cast<size_t>(fraction * (samples.size() - 1) + 0.5);
+  return samples[index];
+}
+
+void usage() {
+  fprintf(stderr,
+          "Usage: request_scheduler_benchmark [-n REQUESTS] [-c CONCURRENCY]"
+          " [--deadline MS] [--rate PER_SECOND] [--burst N] [--attempts N]"
+          " [--no-pool] URL\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int requests = kDefaultRequests;
+  int concurrency = kDefaultConcurrency;
+  int64_t deadline_ms = kDefaultDeadlineMs;
+  RequestSchedulerOptions options = kGeminiSchedulerOptions;
+  bool pooled = true;
+  const char* url = nullptr;
+
+  for (int i = 1; i < argc; i++) {
+    bool has_value = i + 1 < argc;
+    if (strcmp(argv[i], "-n") == 0 && has_value) {
+      requests = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-c") == 0 && has_value) {
+      concurrency = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--deadline") == 0 && has_value) {
+      deadline_ms = atoll(argv[++i]);
+    } else if (strcmp(argv[i], "--rate") == 0 && has_value) {
+      options.rate = g_ascii_strtod(argv[++i], nullptr);
+    } else if (strcmp(argv[i], "--burst") == 0 && has_value) {
+      options.burst = g_ascii_strtod(argv[++i], nullptr);
+    } else if (strcmp(argv[i], "--attempts") == 0 && has_value) {
+      options.max_attempts = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--no-pool") == 0) {
+      pooled = false;
+    } else if (argv[i][0] != '-' && url == nullptr) {
+      url = argv[i];
+    } else {
+      usage();
+      return 1;
+    }
+  }
+  if (url == nullptr || requests <= 0 || concurrency <= 0) {
+    usage();
+    return 1;
+  }
+
+  curl_global_init(CURL_GLOBAL_DEFAULT);
+  ConnectionPool* connections =
+      pooled ? connection_pool_new(kGeminiPoolOptions) : nullptr;
+  Run run;
+  run.scheduler = request_scheduler_new(options, connections);
+  run.reused = 0;
+  run.url = url;
+  run.deadline_ms = deadline_ms;
+  g_mutex_init(&run.lock);
+
+  int64_t start = g_get_monotonic_time();
+  GThreadPool* pool =
+      g_thread_pool_new(request_cb, &run, concurrency, TRUE, nullptr);
+  for (int i = 0; i < requests; i++) {
+    g_thread_pool_push(pool, GINT_TO_POINTER(i + 1), nullptr);
+  }
+  g_thread_pool_free(pool, FALSE, TRUE);
+  double total_s = (g_get_monotonic_time() - start) / 1e6;
+
+  printf("%d requests, %d at a time, %.1f s\n", requests, concurrency,
+         total_s);
+  for (const auto& outcome : run.outcomes) {
+    printf("  %-16s %d\n", outcome.first.c_str(), outcome.second);
+  }
+  printf("latency p50 %.0f ms, p95 %.0f ms\n",
+         percentile(run.latencies_ms, 0.5),
+         percentile(run.latencies_ms, 0.95));
+  printf("handshake p50 %.1f ms, p95 %.1f ms; first byte p50 %.0f ms, "
+         "p95 %.0f ms; %d of %zu reused a connection\n",
+         percentile(run.handshakes_ms, 0.5),
+         percentile(run.handshakes_ms, 0.95), percentile(run.ttfbs_ms, 0.5),
+         percentile(run.ttfbs_ms, 0.95), run.reused, run.ttfbs_ms.size());
+
+  RequestSchedulerStats stats = request_scheduler_get_stats(run.scheduler);
+  printf("attempts %" G_GUINT64_FORMAT ", retries %" G_GUINT64_FORMAT
+         ", throttle waits %" G_GUINT64_FORMAT " (%" G_GUINT64_FORMAT
+         " ms), deadlines exceeded %" G_GUINT64_FORMAT "\n",
+         static_cast<guint64>(stats.attempts),
+         static_cast<guint64>(stats.retries),
+         static_cast<guint64>(stats.throttle_waits),
+         static_cast<guint64>(stats.throttle_wait_ms),
+         static_cast<guint64>(stats.deadline_exceeded));
+
+  g_mutex_clear(&run.lock);
+  request_scheduler_free(run.scheduler);
+  connection_pool_free(connections);
+  curl_global_cleanup();
+  return 0;
+}
@@ -0,0 +1,355 @@
+// Cold start regression benchmark for the Linux bundle.
+//
+// Usage: startup_benchmark [-n RUNS] [--keep DIR] [--wait-for SPAN]
+//                          BUNDLE_BINARY [ARGS ...]
+//        startup_benchmark --warm [-n RUNS] BUNDLE_BINARY [ARGS ...]
+//
+// Launches the bundle RUNS times (default 20) with ECHOLENS_STARTUP_TRACE
+// pointing at a temporary file and ECHOLENS_STARTUP_TRACE_LAUNCHED_AT set to
+// the spawn time, waits for the runner to write its trace at the first frame,
+// then terminates it. Prints p50/p95 time to first frame measured from the
+// spawn, the resident memory at that point, and the median of every traced
+// phase. --keep copies each trace into DIR for inspection in ui.perfetto.dev.
+// Comparing bundles built with ECHOLENS_LAZY_PLUGINS on and off shows what
+// loading the heavy plugins up front costs.
+//
+// --wait-for keeps each run going until the trace has the named span, which
+// Dart may send after the first frame, and prints p50/p95 time to its end.
+// `--wait-for "runApp to stable text"` measures until text stops reflowing
+// for want of a font; compare runs with and without a network, e.g. under
+// `unshare -rn`, to check that it does not depend on one.
+//
+// --warm launches the bundle once, waits for its first frame and leaves it
+// running, then times RUNS more launches of the same command from spawn to
+// exit. Pass --single-instance so that they hand their command line to the
+// first and exit at once; without it each would start an engine of its own.
+//
+// Needs a display; run it under the same session as the app would be.
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../startup_trace.h"
+
+namespace {
+
+constexpr int kDefaultRuns = 20;
+constexpr gint64 kTimeoutUs = 60 * G_USEC_PER_SEC;
+constexpr gulong kPollIntervalUs = 2000;
+
+// The spans and instants of one trace, in microseconds.
+struct Trace {
+  gint64 first_frame = -1;
+  // VmRSS once the first frame was traced, in kilobytes.
+  gint64 resident_kb = -1;
+  // End of the span named by --wait-for.
+  gint64 awaited_end = -1;
+  std::vector<std::pair<std::string, gint64>> durations;
+};
+
+// Reads back the file written by startup_trace_flush(), which puts one event
+// on each line.
+bool parse_trace(const gchar* contents,
+                 gint64 launched_at,
+                 const char* wait_for,
+                 Trace* trace) {
+  trace->durations.clear();
+  g_auto(GStrv) lines = g_strsplit(contents, "\n", -1);
+  for (gchar** line = lines; *line != nullptr; line++) {
+    const char* name = strstr(*line, "{\"name\":\"");
+    const char* ts = strstr(*line, "\"ts\":");
+    if (name == nullptr || ts == nullptr) {
+      continue;
+    }
+    name += strlen("{\"name\":\"");
+    const char* name_end = strchr(name, '"');
+    if (name_end == nullptr) {
+      continue;
+    }
+    std::string event(name, name_end - name);
+    const char* dur = strstr(*line, "\"dur\":");
+    if (event == "first_frame") {
+      trace->first_frame = g_ascii_strtoll(ts + 5, nullptr, 10) - launched_at;
+    } else if (dur != nullptr) {
+      gint64 duration = g_ascii_strtoll(dur + 6, nullptr, 10);
+      trace->durations.emplace_back(event, duration);
+      if (wait_for != nullptr && event == wait_for) {
+        trace->awaited_end =
+            g_ascii_strtoll(ts + 5, nullptr, 10) + duration - launched_at;
+      }
+    }
+  }
+  return trace->first_frame >= 0 &&
+         (wait_for == nullptr || trace->awaited_end >= 0);
+}
+
+gint64 read_resident_kb(GPid pid) {
+  g_autofree gchar* path = g_strdup_printf("/proc/%d/status", pid);
+  g_autofree gchar* contents = nullptr;
+  if (!g_file_get_contents(path, &contents, nullptr, nullptr)) {
+    return -1;
+  }
+  const char* rss = strstr(contents, "VmRSS:");
+  if (rss == nullptr) {
+    return -1;
+  }
+  return g_ascii_strtoll(rss + strlen("VmRSS:"), nullptr, 10);
+}
+
+bool run_once(char** argv,
+              const gchar* trace_path,
+              const gchar* keep_path,
+              const char* wait_for,
+              Trace* trace) {
+  g_remove(trace_path);
+
+  gint64 launched_at = g_get_monotonic_time();
+  g_autofree gchar* launched_at_text =
+      g_strdup_printf("%" G_GINT64_FORMAT, launched_at);
+  g_auto(GStrv) envp = g_get_environ();
+  envp = g_environ_setenv(envp, kStartupTraceEnv, trace_path, TRUE);
+  envp = g_environ_setenv(envp, kStartupTraceLaunchedAtEnv, launched_at_text,
+                          TRUE);
+
+  GPid pid = 0;
+  g_autoptr(GError) error = nullptr;
+  if (!g_spawn_async(nullptr, argv, envp, G_SPAWN_DO_NOT_REAP_CHILD, nullptr,
+                     nullptr, &pid, &error)) {
+    fprintf(stderr, "Cannot launch %s: %s\n", argv[0], error->message);
+    return false;
+  }
+
+  // The trace is replaced atomically, so once it exists it is complete.
+  bool written = false;
+  while (g_get_monotonic_time() - launched_at < kTimeoutUs) {
+    if (g_file_test(trace_path, G_FILE_TEST_EXISTS)) {
+      written = true;
+      break;
+    }
+    int status = 0;
+    if (waitpid(pid, &status, WNOHANG) == pid) {
+      fprintf(stderr, "%s exited before its first frame\n", argv[0]);
+      g_spawn_close_pid(pid);
+      return false;
+    }
+    g_usleep(kPollIntervalUs);
+  }
+
+  trace->resident_kb = written ? read_resident_kb(pid) : -1;
+  // Spans that arrive later rewrite the trace.
+  while (written && wait_for != nullptr &&
+         g_get_monotonic_time() - launched_at < kTimeoutUs) {
+    g_autofree gchar* contents = nullptr;
+    Trace partial;
+    if (g_file_get_contents(trace_path, &contents, nullptr, nullptr) &&
+        parse_trace(contents, launched_at, wait_for, &partial)) {
+      break;
+    }
+    g_usleep(kPollIntervalUs);
+  }
+  kill(pid, SIGTERM);
+  waitpid(pid, nullptr, 0);
+  g_spawn_close_pid(pid);
+  if (!written) {
+    fprintf(stderr, "No first frame within %" G_GINT64_FORMAT " s\n",
+            kTimeoutUs / G_USEC_PER_SEC);
+    return false;
+  }
+
+  g_autofree gchar* contents = nullptr;
+  if (!g_file_get_contents(trace_path, &contents, nullptr, &error)) {
+    fprintf(stderr, "%s\n", error->message);
+    return false;
+  }
+  if (keep_path != nullptr) {
+    g_file_set_contents(keep_path, contents, -1, nullptr);
+  }
+  if (!parse_trace(contents, launched_at, wait_for, trace)) {
+    fprintf(stderr, "No \"%s\" within %" G_GINT64_FORMAT " s\n",
+            wait_for != nullptr ? wait_for : "first_frame",
+            kTimeoutUs / G_USEC_PER_SEC);
+    return false;
+  }
+  return true;
+}
+
+double percentile(std::vector<gint64> samples, double p) {
+  std::sort(samples.begin(), samples.end());
+  size_t index = static_cast<size_t>(p * (samples.size() - 1) + 0.5);
+  return samples[index] / 1000.0;
+}
+
+// Times launches of @argv that forward to the instance already running.
+int run_warm(char** argv, int runs, const gchar* trace_path) {
+  g_remove(trace_path);
+  g_auto(GStrv) envp = g_get_environ();
+  envp = g_environ_setenv(envp, kStartupTraceEnv, trace_path, TRUE);
+
+  GPid primary = 0;
+  g_autoptr(GError) error = nullptr;
+  if (!g_spawn_async(nullptr, argv, envp, G_SPAWN_DO_NOT_REAP_CHILD, nullptr,
+                     nullptr, &primary, &error)) {
+    fprintf(stderr, "Cannot launch %s: %s\n", argv[0], error->message);
+    return 1;
+  }
+  gint64 launched_at = g_get_monotonic_time();
+  while (!g_file_test(trace_path, G_FILE_TEST_EXISTS) &&
+         g_get_monotonic_time() - launched_at < kTimeoutUs) {
+    g_usleep(kPollIntervalUs);
+  }
+  if (g_remove(trace_path) != 0) {
+    fprintf(stderr, "No first frame within %" G_GINT64_FORMAT " s\n",
+            kTimeoutUs / G_USEC_PER_SEC);
+    kill(primary, SIGTERM);
+    waitpid(primary, nullptr, 0);
+    g_spawn_close_pid(primary);
+    return 1;
+  }
+
+  std::vector<gint64> exits;
+  for (int run = 0; run < runs; run++) {
+    GPid pid = 0;
+    gint64 start = g_get_monotonic_time();
+    if (!g_spawn_async(nullptr, argv, nullptr, G_SPAWN_DO_NOT_REAP_CHILD,
+                       nullptr, nullptr, &pid, &error)) {
+      fprintf(stderr, "Cannot launch %s: %s\n", argv[0], error->message);
+      break;
+    }
+    bool exited = false;
+    while (g_get_monotonic_time() - start < kTimeoutUs) {
+      if (waitpid(pid, nullptr, WNOHANG) == pid) {
+        exited = true;
+        break;
+      }
+      g_usleep(kPollIntervalUs / 4);
+    }
+    gint64 elapsed = g_get_monotonic_time() - start;
+    g_spawn_close_pid(pid);
+    if (!exited) {
+      kill(pid, SIGTERM);
+      waitpid(pid, nullptr, 0);
+      fprintf(stderr,
+              "Launch %d did not exit within %" G_GINT64_FORMAT
+              " s; was it given --single-instance?\n",
+              run + 1, kTimeoutUs / G_USEC_PER_SEC);
+      break;
+    }
+    exits.push_back(elapsed);
+    printf("run %3d: forwarded in %8.1f ms\n", run + 1, elapsed / 1000.0);
+  }
+
+  kill(primary, SIGTERM);
+  waitpid(primary, nullptr, 0);
+  g_spawn_close_pid(primary);
+  if (exits.size() < static_cast<size_t>(runs)) {
+    return 1;
+  }
+  printf("\ntime to exit of a repeat launch over %d runs: p50 %.1f ms, "
+         "p95 %.1f ms\n",
+         runs, percentile(exits, 0.5), percentile(exits, 0.95));
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int runs = kDefaultRuns;
+  const char* keep_dir = nullptr;
+  const char* wait_for = nullptr;
+  bool warm = false;
+  int i = 1;
+  for (; i < argc; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      runs = MAX(atoi(argv[++i]), 1);
+    } else if (strcmp(argv[i], "--keep") == 0 && i + 1 < argc) {
+      keep_dir = argv[++i];
+    } else if (strcmp(argv[i], "--wait-for") == 0 && i + 1 < argc) {
+      wait_for = argv[++i];
+    } else if (strcmp(argv[i], "--warm") == 0) {
+      warm = true;
+    } else {
+      break;
+    }
+  }
+  if (i >= argc) {
+    fprintf(stderr,
+            "Usage: %s [-n RUNS] [--keep DIR] [--wait-for SPAN] [--warm] "
+            "BUNDLE_BINARY [ARGS ...]\n",
+            argv[0]);
+    return 1;
+  }
+  char** command = argv + i;
+
+  g_autofree gchar* trace_path = g_build_filename(
+      g_get_tmp_dir(), "echolens_startup_benchmark.json", nullptr);
+  if (warm) {
+    return run_warm(command, runs, trace_path);
+  }
+
+  std::vector<gint64> first_frames;
+  std::vector<gint64> resident;
+  std::vector<gint64> awaited;
+  // Phase durations in the order they first appear.
+  std::vector<std::string> phases;
+  std::map<std::string, std::vector<gint64>> durations;
+  for (int run = 0; run < runs; run++) {
+    g_autofree gchar* keep_name = g_strdup_printf("startup_%03d.json", run);
+    g_autofree gchar* keep_path =
+        keep_dir != nullptr
+            ? g_build_filename(keep_dir, keep_name, nullptr)
+            : nullptr;
+    Trace trace;
+    if (!run_once(command, trace_path, keep_path, wait_for, &trace)) {
+      return 1;
+    }
+    first_frames.push_back(trace.first_frame);
+    if (trace.resident_kb >= 0) {
+      resident.push_back(trace.resident_kb);
+    }
+    for (const auto& phase : trace.durations) {
+      if (durations.count(phase.first) == 0) {
+        phases.push_back(phase.first);
+      }
+      durations[phase.first].push_back(phase.second);
+    }
+    if (wait_for != nullptr) {
+      awaited.push_back(trace.awaited_end);
+      printf("run %3d: first frame %8.1f ms, %s %8.1f ms\n", run + 1,
+             trace.first_frame / 1000.0, wait_for,
+             trace.awaited_end / 1000.0);
+    } else {
+      printf("run %3d: first frame %8.1f ms\n", run + 1,
+             trace.first_frame / 1000.0);
+    }
+  }
+  g_remove(trace_path);
+
+  printf("\ntime to first frame over %d runs: p50 %.1f ms, p95 %.1f ms\n",
+         runs, percentile(first_frames, 0.5), percentile(first_frames, 0.95));
+  if (wait_for != nullptr) {
+    printf("time to end of %s: p50 %.1f ms, p95 %.1f ms\n", wait_for,
+           percentile(awaited, 0.5), percentile(awaited, 0.95));
+  }
+  if (!resident.empty()) {
+    // percentile() scales by 1000, which turns kilobytes into megabytes.
+    printf("resident at first frame: p50 %.1f MB, p95 %.1f MB\n",
+           percentile(resident, 0.5), percentile(resident, 0.95));
+  }
+  printf("\n%-28s %10s %10s\n", "phase", "p50 ms", "p95 ms");
+  for (const std::string& phase : phases) {
+    printf("%-28s %10.2f %10.2f\n", phase.c_str(),
+           percentile(durations[phase], 0.5),
+           percentile(durations[phase], 0.95));
+  }
+  return 0;
+}
@@ -0,0 +1,108 @@
+#include "bundled_fonts.h"
+
+#include <fontconfig/fontconfig.h>
+#include <gio/gio.h>
+#include <pango/pangocairo.h>
+
+#include <string>
+
+#include "startup_trace.h"
+
+namespace {
+
+// The weights the app's text theme and answers use.
+constexpr struct {
+  PangoWeight weight;
+  PangoStyle style;
+} kFaces[] = {
+    {PANGO_WEIGHT_NORMAL, PANGO_STYLE_NORMAL},
+    {PANGO_WEIGHT_NORMAL, PANGO_STYLE_ITALIC},
+    {PANGO_WEIGHT_MEDIUM, PANGO_STYLE_NORMAL},
+    {PANGO_WEIGHT_SEMIBOLD, PANGO_STYLE_NORMAL},
+    {PANGO_WEIGHT_BOLD, PANGO_STYLE_NORMAL},
+    {PANGO_WEIGHT_HEAVY, PANGO_STYLE_NORMAL},
+};
+
+constexpr int kPrewarmSize = 14;
+
+}  // namespace
+
+// Fonts are bundled next to the executable, which may be started from
+// anywhere.
+static gchar* fonts_directory() {
+  g_autofree gchar* executable = g_file_read_link("/proc/self/exe", nullptr);
+  if (executable == nullptr) {
+    return nullptr;
+  }
+  g_autofree gchar* directory = g_path_get_dirname(executable);
+  return g_build_filename(directory, "data", "fonts", nullptr);
+}
+
+gboolean bundled_fonts_register() {
+  g_autofree gchar* directory = fonts_directory();
+  if (directory == nullptr ||
+      !g_file_test(directory, G_FILE_TEST_IS_DIR)) {
+    return FALSE;
+  }
+  // Application fonts are scanned once and stay private to the process.
+  if (!FcConfigAppFontAddDir(nullptr,
+                             reinterpret_cast<const FcChar8*>(directory))) {
+    g_warning("Failed to add fonts from %s", directory);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static std::string prewarm_text() {
+  std::string text;
+  for (gunichar c = 0x20; c <= 0xff; c++) {
+    if (c >= 0x7f && c < 0xa0) {
+      continue;
+    }
+    char utf8[6];
+    text.append(utf8, g_unichar_to_utf8(c, utf8));
+  }
+  return text;
+}
+
+static void prewarm_thread_cb(GTask* task,
+                              gpointer source_object,
+                              gpointer task_data,
+                              GCancellable* cancellable) {
+  gint64 start = startup_trace_begin();
+  std::string text = prewarm_text();
+
+  // A font map of its own keeps this thread off GTK's.
+  PangoFontMap* font_map = pango_cairo_font_map_new();
+  PangoContext* context = pango_font_map_create_context(font_map);
+  PangoLayout* layout = pango_layout_new(context);
+  pango_layout_set_text(layout, text.c_str(), text.size());
+
+  // Drawing, not just measuring, makes the faces load their glyph outlines.
+  cairo_surface_t* surface =
+      cairo_image_surface_create(CAIRO_FORMAT_A8, 1, 1);
+  cairo_t* cr = cairo_create(surface);
+  PangoFontDescription* description = pango_font_description_new();
+  pango_font_description_set_family_static(description, kBundledFontFamily);
+  pango_font_description_set_size(description, kPrewarmSize * PANGO_SCALE);
+  for (const auto& face : kFaces) {
+    pango_font_description_set_weight(description, face.weight);
+    pango_font_description_set_style(description, face.style);
+    pango_layout_set_font_description(layout, description);
+    pango_cairo_show_layout(cr, layout);
+  }
+  pango_font_description_free(description);
+  cairo_destroy(cr);
+  cairo_surface_destroy(surface);
+
+  g_object_unref(layout);
+  g_object_unref(context);
+  g_object_unref(font_map);
+  startup_trace_end("bundled_fonts_prewarm", start);
+  g_task_return_boolean(task, TRUE);
+}
+
+void bundled_fonts_prewarm() {
+  g_autoptr(GTask) task = g_task_new(nullptr, nullptr, nullptr, nullptr);
+  g_task_run_in_thread(task, prewarm_thread_cb);
+}
@@ -0,0 +1,36 @@
+#ifndef RUNNER_BUNDLED_FONTS_H_
+#define RUNNER_BUNDLED_FONTS_H_
+
+#include <glib.h>
+
+// Family of the fonts installed into the bundle's data/fonts directory.
+constexpr char kBundledFontFamily[] = "Montserrat";
+// Dart entrypoint argument telling Dart that bundled_fonts_register()
+// succeeded, so kBundledFontFamily need not be fetched.
+constexpr char kBundledFontsArgument[] = "--bundled-fonts";
+
+/**
+ * bundled_fonts_register:
+ *
+ * Adds the fonts in the bundle's data/fonts directory to fontconfig's
+ * current configuration as application fonts. The engine's font manager and
+ * Pango both resolve families through that configuration, so Dart finds
+ * kBundledFontFamily by name like a system font, without fetching it. Call
+ * before the first #FlView is created.
+ *
+ * Returns: %TRUE if any font was added; otherwise text falls back to the
+ * system's fonts.
+ */
+gboolean bundled_fonts_register();
+
+/**
+ * bundled_fonts_prewarm:
+ *
+ * On a worker thread, loads every weight of kBundledFontFamily and draws the
+ * printable ASCII and Latin-1 characters with it, so that fontconfig has
+ * matched each face and the font files are read in before the first frame
+ * lays out text. Returns at once.
+ */
+void bundled_fonts_prewarm();
+
+#endif  // RUNNER_BUNDLED_FONTS_H_
@@ -0,0 +1,327 @@
+#include "connection_pool.h"
+
+#include <string.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Trusted CA certificates for the pool's TLS connections, to talk to a stand-in
+// server with a self-signed certificate.
+constexpr char kCaBundleVariable[] = "ECHOLENS_CA_BUNDLE";
+
+constexpr long kMaxConnections = 8;
+constexpr int kPollTimeoutMs = 1000;
+constexpr long kPreconnectTimeoutMs = 15000;
+
+// A transfer handed to the pool's thread.
+struct Transfer {
+  CURL* curl;
+  std::string origin;
+  // Pre-connects belong to the pool; nobody waits for them.
+  bool preconnect;
+  bool done;
+  CURLcode result;
+};
+
+// Returns the scheme, host and port of @url, or "" if it has none.
+std::string origin_of(const char* url) {
+  const char* host = strstr(url, "://");
+  if (host == nullptr) {
+    return std::string();
+  }
+  size_t end = strcspn(host + 3, "/?#");
+  return std::string(url, host + 3 + end - url);
+}
+
+}  // namespace
+
+struct _ConnectionPool {
+  ConnectionPoolOptions options;
+  gchar* ca_bundle;
+
+  // Only used on the pool's thread.
+  CURLM* multi;
+  CURLSH* share;
+
+  GMutex lock;
+  GCond done_cond;
+  GThread* thread;
+  bool stopping;
+  std::vector<Transfer*> incoming;
+  // Origin -> the monotonic time until which its idle connection is reused.
+  std::map<std::string, int64_t> warm_until_us;
+  std::set<std::string> preconnecting;
+  ConnectionPoolStats stats;
+};
+
+ConnectionPool* connection_pool_new(const ConnectionPoolOptions& options) {
+  ConnectionPool* pool = new ConnectionPool();
+  pool->options = options;
+  pool->ca_bundle = g_strdup(g_getenv(kCaBundleVariable));
+
+  pool->multi = curl_multi_init();
+  curl_multi_setopt(pool->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+  curl_multi_setopt(pool->multi, CURLMOPT_MAX_HOST_CONNECTIONS,
+                    options.max_host_connections);
+  curl_multi_setopt(pool->multi, CURLMOPT_MAXCONNECTS, kMaxConnections);
+
+  // A multi handle shares connections between its transfers but not TLS
+  // sessions, which new connections need to resume instead of doing a full
+  // handshake. The share needs no locks: only the pool's thread uses it.
+  pool->share = curl_share_init();
+  curl_share_setopt(pool->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+  curl_share_setopt(pool->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+
+  g_mutex_init(&pool->lock);
+  g_cond_init(&pool->done_cond);
+  pool->thread = nullptr;
+  pool->stopping = false;
+  pool->stats = ConnectionPoolStats();
+  return pool;
+}
+
+// Sets the options every transfer of @pool gets, on the pool's thread.
+static void adopt(ConnectionPool* pool, Transfer* transfer) {
+  CURL* curl = transfer->curl;
+  curl_easy_setopt(curl, CURLOPT_PRIVATE, transfer);
+  curl_easy_setopt(curl, CURLOPT_SHARE, pool->share);
+  curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+  // Wait for a connection that is still being set up to offer multiplexing,
+  // rather than opening a second one next to it.
+  curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+  curl_easy_setopt(curl, CURLOPT_MAXAGE_CONN, pool->options.idle_timeout_s);
+  curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+  curl_easy_setopt(curl, CURLOPT_TCP_KEEPIDLE, pool->options.keepalive_idle_s);
+  curl_easy_setopt(curl, CURLOPT_TCP_KEEPINTVL,
+                   pool->options.keepalive_interval_s);
+  curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+  if (pool->ca_bundle != nullptr) {
+    curl_easy_setopt(curl, CURLOPT_CAINFO, pool->ca_bundle);
+  }
+}
+
+// Hands a finished transfer back to its owner.
+static void finish(ConnectionPool* pool, Transfer* transfer, CURLcode result) {
+  // Detached so that the share can be freed before the easy handle.
+  curl_easy_setopt(transfer->curl, CURLOPT_SHARE, nullptr);
+
+  ConnectionMetrics metrics;
+  connection_metrics_get(transfer->curl, &metrics);
+  if (transfer->origin.empty()) {
+    char* url = nullptr;
+    curl_easy_getinfo(transfer->curl, CURLINFO_EFFECTIVE_URL, &url);
+    if (url != nullptr) {
+      transfer->origin = origin_of(url);
+    }
+  }
+
+  g_mutex_lock(&pool->lock);
+  if (result == CURLE_OK) {
+    pool->warm_until_us[transfer->origin] =
+        g_get_monotonic_time() +
+        pool->options.idle_timeout_s * G_USEC_PER_SEC;
+  } else {
+    pool->warm_until_us.erase(transfer->origin);
+  }
+  if (!metrics.reused) {
+    pool->stats.handshake_ms +=
+        (metrics.dns_us + metrics.connect_us + metrics.tls_us) / 1000;
+  }
+  if (transfer->preconnect) {
+    pool->preconnecting.erase(transfer->origin);
+    g_mutex_unlock(&pool->lock);
+    curl_easy_cleanup(transfer->curl);
+    delete transfer;
+    return;
+  }
+  pool->stats.transfers++;
+  if (metrics.reused) {
+    pool->stats.reused++;
+  }
+  transfer->result = result;
+  transfer->done = true;
+  g_cond_broadcast(&pool->done_cond);
+  g_mutex_unlock(&pool->lock);
+}
+
+static gpointer pool_thread_cb(gpointer data) {
+  ConnectionPool* pool = static_cast<ConnectionPool*>(data);
+  std::set<Transfer*> running;
+
+  while (true) {
+    std::vector<Transfer*> incoming;
+    g_mutex_lock(&pool->lock);
+    bool stopping = pool->stopping;
+    incoming.swap(pool->incoming);
+    g_mutex_unlock(&pool->lock);
+
+    if (stopping) {
+      for (Transfer* transfer : running) {
+        curl_multi_remove_handle(pool->multi, transfer->curl);
+        finish(pool, transfer, CURLE_ABORTED_BY_CALLBACK);
+      }
+      for (Transfer* transfer : incoming) {
+        finish(pool, transfer, CURLE_ABORTED_BY_CALLBACK);
+      }
+      break;
+    }
+
+    for (Transfer* transfer : incoming) {
+      adopt(pool, transfer);
+      curl_multi_add_handle(pool->multi, transfer->curl);
+      running.insert(transfer);
+    }
+
+    int still_running = 0;
+    curl_multi_perform(pool->multi, &still_running);
+
+    CURLMsg* message;
+    int queued;
+    while ((message = curl_multi_info_read(pool->multi, &queued)) != nullptr) {
+      if (message->msg != CURLMSG_DONE) {
+        continue;
+      }
+      // The message is only valid until its handle is removed.
+      CURL* curl = message->easy_handle;
+      CURLcode result = message->data.result;
+      char* private_data = nullptr;
+      curl_easy_getinfo(curl, CURLINFO_PRIVATE, &private_data);
+      Transfer* transfer = reinterpret_cast<Transfer*>(private_data);
+      curl_multi_remove_handle(pool->multi, curl);
+      running.erase(transfer);
+      finish(pool, transfer, result);
+    }
+
+    curl_multi_poll(pool->multi, nullptr, 0, kPollTimeoutMs, nullptr);
+  }
+  return nullptr;
+}
+
+// Queues @transfer for the pool's thread, starting it if need be. Called
+// with the lock held.
+static void submit_locked(ConnectionPool* pool, Transfer* transfer) {
+  if (pool->thread == nullptr) {
+    pool->thread = g_thread_new("connection-pool", pool_thread_cb, pool);
+  }
+  pool->incoming.push_back(transfer);
+}
+
+void connection_pool_free(ConnectionPool* pool) {
+  if (pool == nullptr) {
+    return;
+  }
+  g_mutex_lock(&pool->lock);
+  pool->stopping = true;
+  GThread* thread = pool->thread;
+  g_mutex_unlock(&pool->lock);
+  if (thread != nullptr) {
+    curl_multi_wakeup(pool->multi);
+    g_thread_join(thread);
+  }
+
+  curl_multi_cleanup(pool->multi);
+  curl_share_cleanup(pool->share);
+  g_cond_clear(&pool->done_cond);
+  g_mutex_clear(&pool->lock);
+  g_free(pool->ca_bundle);
+  delete pool;
+}
+
+CURLcode connection_pool_perform(ConnectionPool* pool, CURL* curl) {
+  Transfer transfer;
+  transfer.curl = curl;
+  transfer.preconnect = false;
+  transfer.done = false;
+  transfer.result = CURLE_OK;
+
+  g_mutex_lock(&pool->lock);
+  if (pool->stopping) {
+    g_mutex_unlock(&pool->lock);
+    return CURLE_ABORTED_BY_CALLBACK;
+  }
+  submit_locked(pool, &transfer);
+  g_mutex_unlock(&pool->lock);
+  curl_multi_wakeup(pool->multi);
+
+  g_mutex_lock(&pool->lock);
+  while (!transfer.done) {
+    g_cond_wait(&pool->done_cond, &pool->lock);
+  }
+  g_mutex_unlock(&pool->lock);
+  return transfer.result;
+}
+
+void connection_pool_preconnect(ConnectionPool* pool, const char* url) {
+  std::string origin = origin_of(url);
+  if (origin.empty()) {
+    return;
+  }
+
+  g_mutex_lock(&pool->lock);
+  auto warm = pool->warm_until_us.find(origin);
+  if (pool->stopping ||
+      (warm != pool->warm_until_us.end() &&
+       warm->second > g_get_monotonic_time()) ||
+      pool->preconnecting.count(origin) > 0) {
+    pool->stats.preconnects_skipped++;
+    g_mutex_unlock(&pool->lock);
+    return;
+  }
+
+  // A HEAD request leaves behind a connection that is ready for the next
+  // request; whatever the server answers does not matter.
+  Transfer* transfer = new Transfer();
+  transfer->curl = curl_easy_init();
+  transfer->origin = origin;
+  transfer->preconnect = true;
+  transfer->done = false;
+  transfer->result = CURLE_OK;
+  std::string root = origin + "/";
+  curl_easy_setopt(transfer->curl, CURLOPT_URL, root.c_str());
+  curl_easy_setopt(transfer->curl, CURLOPT_NOBODY, 1L);
+  curl_easy_setopt(transfer->curl, CURLOPT_TIMEOUT_MS, kPreconnectTimeoutMs);
+
+  pool->preconnecting.insert(origin);
+  pool->stats.preconnects++;
+  submit_locked(pool, transfer);
+  g_mutex_unlock(&pool->lock);
+  curl_multi_wakeup(pool->multi);
+}
+
+void connection_metrics_get(CURL* curl, ConnectionMetrics* metrics) {
+  curl_off_t dns = 0, connect = 0, tls = 0, ttfb = 0, total = 0;
+  long connects = 0, version = 0;
+  curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &dns);
+  curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect);
+  curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &tls);
+  curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &ttfb);
+  curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+  curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+  curl_easy_getinfo(curl, CURLINFO_HTTP_VERSION, &version);
+
+  // curl reports the times as offsets from the start of the transfer.
+  metrics->reused = connects == 0;
+  if (metrics->reused) {
+    metrics->dns_us = 0;
+    metrics->connect_us = 0;
+    metrics->tls_us = 0;
+  } else {
+    metrics->dns_us = dns;
+    metrics->connect_us = connect > dns ? connect - dns : 0;
+    metrics->tls_us = tls > connect ? tls - connect : 0;
+  }
+  metrics->ttfb_us = ttfb;
+  metrics->total_us = total;
+  metrics->http_version = version == CURL_HTTP_VERSION_2_0 ? 2 : 1;
+}
+
+ConnectionPoolStats connection_pool_get_stats(ConnectionPool* pool) {
+  g_mutex_lock(&pool->lock);
+  ConnectionPoolStats stats = pool->stats;
+  g_mutex_unlock(&pool->lock);
+  return stats;
+}
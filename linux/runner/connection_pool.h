@@ -0,0 +1,99 @@
+#ifndef RUNNER_CONNECTION_POOL_H_
+#define RUNNER_CONNECTION_POOL_H_
+
+#include <curl/curl.h>
+#include <glib.h>
+#include <stdint.h>
+
+struct ConnectionPoolOptions {
+  // Connections kept open to one host. HTTP/2 multiplexes every request to
+  // a host over the first of them, so more only help HTTP/1.1 servers.
+  long max_host_connections;
+  // An idle connection older than this is closed rather than reused.
+  long idle_timeout_s;
+  // TCP keep-alive probes, so that idle connections survive NAT and
+  // firewalls that drop silent flows.
+  long keepalive_idle_s;
+  long keepalive_interval_s;
+};
+
+// Long enough to cover a research session between searches, well below the
+// few minutes after which Google's front ends drop idle HTTP/2 connections.
+constexpr ConnectionPoolOptions kGeminiPoolOptions = {
+    2,    // max_host_connections
+    118,  // idle_timeout_s
+    30,   // keepalive_idle_s
+    15,   // keepalive_interval_s
+};
+
+// Where the time of one transfer went, in microseconds. Phases that did not
+// happen, such as connecting over a reused connection, are 0.
+struct ConnectionMetrics {
+  int64_t dns_us;
+  int64_t connect_us;
+  int64_t tls_us;
+  // From the start of the transfer to its first response byte.
+  int64_t ttfb_us;
+  int64_t total_us;
+  bool reused;
+  // 1 for HTTP/1.x, 2 for HTTP/2.
+  int http_version;
+};
+
+struct ConnectionPoolStats {
+  uint64_t transfers;
+  // Transfers that did not have to open a connection.
+  uint64_t reused;
+  uint64_t preconnects;
+  // Pre-connects skipped because the host was already warm.
+  uint64_t preconnects_skipped;
+  // Time transfers spent opening connections, DNS, TCP and TLS together.
+  uint64_t handshake_ms;
+};
+
+// Runs HTTP transfers over persistent connections. One thread drives a curl
+// multi handle, so that requests to a host share a single HTTP/2 connection
+// as concurrent streams, and DNS lookups and TLS sessions are cached across
+// connections. The thread starts with the first transfer. Thread-safe.
+typedef struct _ConnectionPool ConnectionPool;
+
+ConnectionPool* connection_pool_new(const ConnectionPoolOptions& options);
+
+// Aborts the transfers still running.
+void connection_pool_free(ConnectionPool* pool);
+
+/**
+ * connection_pool_perform:
+ * @pool: a #ConnectionPool.
+ * @curl: a configured easy handle, not in use elsewhere.
+ *
+ * Runs @curl on the pool's thread and blocks until it is done, like
+ * curl_easy_perform(). Callbacks are made on the pool's thread and must not
+ * block. The pool sets the HTTP version, keep-alive, share and private data
+ * options of @curl.
+ *
+ * Returns: the result of the transfer.
+ */
+CURLcode connection_pool_perform(ConnectionPool* pool, CURL* curl);
+
+/**
+ * connection_pool_preconnect:
+ * @pool: a #ConnectionPool.
+ * @url: any URL on the host to connect to.
+ *
+ * Opens a connection to the host of @url in the background, unless the pool
+ * already has one that is still fresh, so that the next request skips DNS,
+ * TCP and TLS setup. Does not block.
+ */
+void connection_pool_preconnect(ConnectionPool* pool, const char* url);
+
+/**
+ * connection_metrics_get:
+ * @curl: an easy handle whose transfer is done.
+ * @metrics: (out): receives the phases of the transfer.
+ */
+void connection_metrics_get(CURL* curl, ConnectionMetrics* metrics);
+
+ConnectionPoolStats connection_pool_get_stats(ConnectionPool* pool);
+
+#endif  // RUNNER_CONNECTION_POOL_H_
@@ -0,0 +1,472 @@
+#include "fingerprint_index.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+namespace {
+
+// MinHash signature length, split into kBands bands of kRows hashes. Two
+// answers meet in some bucket with probability 1 - (1 - J^kRows)^kBands for
+// a Jaccard similarity J: about 0.95 at 0.3 and 0.25 at 0.1.
+constexpr int kMinHashes = 64;
+constexpr int kRows = 2;
+constexpr int kBands = kMinHashes / kRows;
+
+// Answers are compared by their runs of this many words.
+constexpr size_t kShingleWords = 3;
+
+// SimHashes further apart than this are not compared word by word. Adding
+// words to a query moves its SimHash: five more to a query of three land it
+// about 19 bits away, while unrelated queries sit around 32 apart.
+constexpr int kMaxQueryDistance = 24;
+
+constexpr size_t kMinSharedWords = 2;
+constexpr double kMinQueryScore = 0.75;
+
+// Answers to similar queries are duplicates above the first share of their
+// shingles; answers are duplicates above the second whatever was asked.
+constexpr double kRelatedAnswers = 0.3;
+constexpr double kSameAnswer = 0.6;
+
+// Answers share the headings of the prompt's format, so a few buckets hold
+// most records. Each record is only compared with this many before it in a
+// bucket; true duplicates also meet in the buckets of their other bands.
+constexpr size_t kMaxBucketComparisons = 32;
+
+// Dead records keep their slot until this many have died and they outnumber
+// the live ones, as in the history index.
+constexpr size_t kMinDeadForCompaction = 256;
+
+// Words that say nothing about who is being looked for.
+constexpr const char* kQueryStopWords[] = {
+    "a",  "an",  "and",  "at",   "dr",  "for", "from",      "in",
+    "mr", "mrs", "ms",   "of",   "phd", "prof", "professor", "the",
+};
+
+struct Record {
+  std::string id;
+  int64_t timestamp_ms;
+  // Hashes of the query's words, sorted and unique.
+  std::vector<uint32_t> words;
+  uint32_t signature[kMinHashes];
+  // False for an empty answer, which has no signature.
+  bool has_answer;
+  bool live;
+};
+
+// The finalizer of SplitMix64; spreads the bits of a hash.
+uint64_t mix(uint64_t value) {
+  value ^= value >> 30;
+  value *= 0xbf58476d1ce4e5b9ull;
+  value ^= value >> 27;
+  value *= 0x94d049bb133111ebull;
+  value ^= value >> 31;
+  return value;
+}
+
+uint64_t hash_bytes(const char* data, size_t length) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= static_cast<uint8_t>(data[i]);
+    hash *= 0x100000001b3ull;
+  }
+  return mix(hash);
+}
+
+// Word characters are ASCII letters and digits and every byte of a non-ASCII
+// character, so punctuation and markup split words and names in any script
+// do not.
+bool is_word_byte(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+         (c >= 'A' && c <= 'Z') || static_cast<uint8_t>(c) >= 0x80;
+}
+
+// Calls @visit(start, length) for every word of @text, in order.
+template <typename Visit>
+void for_each_word(const std::string& text, Visit visit) {
+  size_t i = 0;
+  while (i < text.size()) {
+    while (i < text.size() && !is_word_byte(text[i])) {
+      i++;
+    }
+    size_t start = i;
+    while (i < text.size() && is_word_byte(text[i])) {
+      i++;
+    }
+    if (i > start) {
+      visit(start, i - start);
+    }
+  }
+}
+
+bool is_stop_word(const std::string& text, size_t start, size_t length) {
+  for (const char* word : kQueryStopWords) {
+    if (strlen(word) == length && text.compare(start, length, word) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Reduces @query to its word hashes and their SimHash. Longer words weigh
+// more, so that an initial moves the SimHash less than a surname.
+uint64_t fingerprint_query(const std::string& query,
+                           std::vector<uint32_t>* words) {
+  int weights[64] = {};
+  words->clear();
+  for_each_word(query, [&](size_t start, size_t length) {
+    if (is_stop_word(query, start, length)) {
+      return;
+    }
+    uint64_t hash = hash_bytes(query.data() + start, length);
+    uint32_t word = static_cast<uint32_t>(hash);
+    if (std::find(words->begin(), words->end(), word) != words->end()) {
+      return;
+    }
+    words->push_back(word);
+    int weight = static_cast<int>(std::min<size_t>(length, 8));
+    for (int bit = 0; bit < 64; bit++) {
+      weights[bit] += (hash >> bit) & 1 ? weight : -weight;
+    }
+  });
+  std::sort(words->begin(), words->end());
+
+  uint64_t simhash = 0;
+  for (int bit = 0; bit < 64; bit++) {
+    if (weights[bit] > 0) {
+      simhash |= 1ull << bit;
+    }
+  }
+  return simhash;
+}
+
+// Fills @signature with the MinHash of the word shingles of @answer. Returns
+// false if @answer has no words.
+bool sign_answer(const std::string& answer, uint32_t* signature) {
+  std::vector<uint64_t> words;
+  for_each_word(answer, [&](size_t start, size_t length) {
+    words.push_back(hash_bytes(answer.data() + start, length));
+  });
+  if (words.empty()) {
+    return false;
+  }
+
+  std::fill(signature, signature + kMinHashes, UINT32_MAX);
+  size_t shingles = words.size() >= kShingleWords
+                        ? words.size() - kShingleWords + 1
+                        : 1;
+  for (size_t i = 0; i < shingles; i++) {
+    uint64_t shingle = 0;
+    for (size_t j = i; j < std::min(i + kShingleWords, words.size()); j++) {
+      shingle = mix(shingle ^ words[j]);
+    }
+    // Each slot hashes the shingle with its own seed, standing in for one
+    // random permutation.
+    for (int k = 0; k < kMinHashes; k++) {
+      uint32_t value = static_cast<uint32_t>(
+          mix(shingle + (k + 1) * 0x9e3779b97f4a7c15ull));
+      signature[k] = std::min(signature[k], value);
+    }
+  }
+  return true;
+}
+
+uint64_t bucket_key(const uint32_t* signature, int band) {
+  uint64_t key = static_cast<uint64_t>(band);
+  for (int row = 0; row < kRows; row++) {
+    key = mix(key ^ signature[band * kRows + row]);
+  }
+  return key;
+}
+
+// The estimated Jaccard similarity of two answers' shingles.
+double answer_similarity(const Record& a, const Record& b) {
+  int equal = 0;
+  for (int k = 0; k < kMinHashes; k++) {
+    equal += a.signature[k] == b.signature[k];
+  }
+  return static_cast<double>(equal) / kMinHashes;
+}
+
+// The share of the shorter word set found in the other, or 0 when they share
+// too few words to name the same person.
+double query_similarity(const std::vector<uint32_t>& a,
+                        const std::vector<uint32_t>& b) {
+  size_t shared = 0;
+  auto i = a.begin();
+  auto j = b.begin();
+  while (i != a.end() && j != b.end()) {
+    if (*i < *j) {
+      ++i;
+    } else if (*j < *i) {
+      ++j;
+    } else {
+      shared++;
+      ++i;
+      ++j;
+    }
+  }
+  if (shared < kMinSharedWords) {
+    return 0;
+  }
+  return static_cast<double>(shared) / std::min(a.size(), b.size());
+}
+
+uint32_t find_root(std::vector<uint32_t>* parents, uint32_t slot) {
+  while ((*parents)[slot] != slot) {
+    (*parents)[slot] = (*parents)[(*parents)[slot]];
+    slot = (*parents)[slot];
+  }
+  return slot;
+}
+
+}  // namespace
+
+struct _FingerprintIndex {
+  // Indexed by slot; dead records keep theirs until compaction.
+  std::vector<Record> records;
+  // The query SimHash of each slot, apart from the records so that a lookup
+  // scans one dense array.
+  std::vector<uint64_t> simhashes;
+  std::unordered_map<std::string, uint32_t> by_id;
+  // Slots by the hash of one band of their answer's signature.
+  std::unordered_map<uint64_t, std::vector<uint32_t>> buckets;
+  size_t dead;
+};
+
+static void add_to_buckets(FingerprintIndex* index, uint32_t slot) {
+  const Record& record = index->records[slot];
+  if (!record.has_answer) {
+    return;
+  }
+  for (int band = 0; band < kBands; band++) {
+    index->buckets[bucket_key(record.signature, band)].push_back(slot);
+  }
+}
+
+// Renumbers the live records densely and refills the buckets.
+static void compact(FingerprintIndex* index) {
+  std::vector<Record> live;
+  std::vector<uint64_t> simhashes;
+  live.reserve(index->records.size() - index->dead);
+  simhashes.reserve(live.capacity());
+  for (size_t i = 0; i < index->records.size(); i++) {
+    if (index->records[i].live) {
+      index->by_id[index->records[i].id] = static_cast<uint32_t>(live.size());
+      live.push_back(std::move(index->records[i]));
+      simhashes.push_back(index->simhashes[i]);
+    }
+  }
+  index->records = std::move(live);
+  index->simhashes = std::move(simhashes);
+  index->dead = 0;
+
+  index->buckets.clear();
+  for (uint32_t slot = 0; slot < index->records.size(); slot++) {
+    add_to_buckets(index, slot);
+  }
+}
+
+FingerprintIndex* fingerprint_index_new() {
+  FingerprintIndex* index = new FingerprintIndex();
+  index->dead = 0;
+  return index;
+}
+
+void fingerprint_index_free(FingerprintIndex* index) {
+  delete index;
+}
+
+void fingerprint_index_put(FingerprintIndex* index,
+                           const std::string& id,
+                           int64_t timestamp_ms,
+                           const std::string& query,
+                           const std::string& answer) {
+  fingerprint_index_remove(index, id);
+
+  uint32_t slot = static_cast<uint32_t>(index->records.size());
+  Record record;
+  record.id = id;
+  record.timestamp_ms = timestamp_ms;
+  uint64_t simhash = fingerprint_query(query, &record.words);
+  record.words.shrink_to_fit();
+  record.has_answer = sign_answer(answer, record.signature);
+  record.live = true;
+
+  index->records.push_back(std::move(record));
+  index->simhashes.push_back(simhash);
+  index->by_id[id] = slot;
+  add_to_buckets(index, slot);
+}
+
+bool fingerprint_index_remove(FingerprintIndex* index, const std::string& id) {
+  auto it = index->by_id.find(id);
+  if (it == index->by_id.end()) {
+    return false;
+  }
+  Record& record = index->records[it->second];
+  record.live = false;
+  std::vector<uint32_t>().swap(record.words);
+  index->by_id.erase(it);
+  index->dead++;
+
+  if (index->dead >= kMinDeadForCompaction &&
+      index->dead > index->records.size() - index->dead) {
+    compact(index);
+  }
+  return true;
+}
+
+void fingerprint_index_clear(FingerprintIndex* index) {
+  index->records.clear();
+  index->simhashes.clear();
+  index->by_id.clear();
+  index->buckets.clear();
+  index->dead = 0;
+}
+
+void fingerprint_index_similar(FingerprintIndex* index,
+                               const std::string& query,
+                               size_t limit,
+                               std::vector<FingerprintMatch>* matches) {
+  matches->clear();
+  std::vector<uint32_t> words;
+  uint64_t simhash = fingerprint_query(query, &words);
+  if (words.size() < kMinSharedWords) {
+    return;
+  }
+
+  std::vector<std::pair<double, uint32_t>> found;
+  for (uint32_t slot = 0; slot < index->simhashes.size(); slot++) {
+    if (__builtin_popcountll(index->simhashes[slot] ^ simhash) >
+        kMaxQueryDistance) {
+      continue;
+    }
+    const Record& record = index->records[slot];
+    if (!record.live) {
+      continue;
+    }
+    double score = query_similarity(words, record.words);
+    if (score >= kMinQueryScore) {
+      found.push_back({score, slot});
+    }
+  }
+
+  auto better = [index](const std::pair<double, uint32_t>& a,
+                        const std::pair<double, uint32_t>& b) {
+    if (a.first != b.first) {
+      return a.first > b.first;
+    }
+    const Record& ra = index->records[a.second];
+    const Record& rb = index->records[b.second];
+    if (ra.timestamp_ms != rb.timestamp_ms) {
+      return ra.timestamp_ms > rb.timestamp_ms;
+    }
+    return a.second > b.second;
+  };
+  size_t count = limit == 0 ? found.size() : std::min(limit, found.size());
+  std::partial_sort(found.begin(), found.begin() + count, found.end(), better);
+
+  matches->reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    const Record& record = index->records[found[i].second];
+    matches->push_back({record.id, record.timestamp_ms, found[i].first});
+  }
+}
+
+void fingerprint_index_duplicates(
+    FingerprintIndex* index,
+    std::vector<std::vector<std::string>>* groups) {
+  groups->clear();
+  std::vector<uint32_t> parents(index->records.size());
+  std::iota(parents.begin(), parents.end(), 0);
+
+  // Any two duplicates share at least kRelatedAnswers of their shingles, so
+  // they most likely meet in a bucket; only those pairs are compared.
+  for (const auto& bucket : index->buckets) {
+    const std::vector<uint32_t>& slots = bucket.second;
+    for (size_t j = 1; j < slots.size(); j++) {
+      const Record& b = index->records[slots[j]];
+      if (!b.live) {
+        continue;
+      }
+      size_t first = j > kMaxBucketComparisons ? j - kMaxBucketComparisons : 0;
+      for (size_t i = first; i < j; i++) {
+        const Record& a = index->records[slots[i]];
+        if (!a.live) {
+          continue;
+        }
+        uint32_t root_a = find_root(&parents, slots[i]);
+        uint32_t root_b = find_root(&parents, slots[j]);
+        if (root_a == root_b) {
+          continue;
+        }
+        double similarity = answer_similarity(a, b);
+        if (similarity >= kSameAnswer ||
+            (similarity >= kRelatedAnswers &&
+             query_similarity(a.words, b.words) >= kMinQueryScore)) {
+          parents[root_b] = root_a;
+        }
+      }
+    }
+  }
+
+  std::unordered_map<uint32_t, std::vector<uint32_t>> members;
+  for (uint32_t slot = 0; slot < index->records.size(); slot++) {
+    if (index->records[slot].live) {
+      members[find_root(&parents, slot)].push_back(slot);
+    }
+  }
+
+  auto newer = [index](uint32_t a, uint32_t b) {
+    const Record& ra = index->records[a];
+    const Record& rb = index->records[b];
+    if (ra.timestamp_ms != rb.timestamp_ms) {
+      return ra.timestamp_ms > rb.timestamp_ms;
+    }
+    return a > b;
+  };
+  std::vector<std::vector<uint32_t>> found;
+  for (auto& entry : members) {
+    if (entry.second.size() > 1) {
+      std::sort(entry.second.begin(), entry.second.end(), newer);
+      found.push_back(std::move(entry.second));
+    }
+  }
+  std::sort(found.begin(), found.end(),
+            [&newer](const std::vector<uint32_t>& a,
+                     const std::vector<uint32_t>& b) {
+              return newer(a[0], b[0]);
+            });
+
+  groups->reserve(found.size());
+  for (const std::vector<uint32_t>& group : found) {
+    std::vector<std::string> ids;
+    ids.reserve(group.size());
+    for (uint32_t slot : group) {
+      ids.push_back(index->records[slot].id);
+    }
+    groups->push_back(std::move(ids));
+  }
+}
+
+FingerprintIndexStats fingerprint_index_get_stats(FingerprintIndex* index) {
+  FingerprintIndexStats stats = {};
+  stats.records = index->records.size() - index->dead;
+  stats.dead_records = index->dead;
+  stats.buckets = index->buckets.size();
+  stats.index_bytes = index->simhashes.size() * sizeof(uint64_t);
+  for (const Record& record : index->records) {
+    stats.query_words += record.words.size();
+    stats.index_bytes += record.words.size() * sizeof(uint32_t);
+    if (record.has_answer) {
+      stats.index_bytes += sizeof(record.signature);
+    }
+  }
+  for (const auto& bucket : index->buckets) {
+    stats.index_bytes += bucket.second.size() * sizeof(uint32_t);
+  }
+  return stats;
+}
@@ -0,0 +1,106 @@
+#ifndef RUNNER_FINGERPRINT_INDEX_H_
+#define RUNNER_FINGERPRINT_INDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// Near-duplicate detection over the research history.
+//
+// A record's query is reduced to the set of its words, less titles and
+// connectives, so "Dr. Jane Roe, MIT" and "jane roe mit csail" share the
+// words jane, roe and mit. Each record keeps a 64-bit SimHash of those words
+// and the sorted 32-bit hashes of the words themselves. A lookup scans the
+// SimHashes, which sit in one contiguous array, for those within a small
+// Hamming distance and confirms each with the word sets.
+//
+// A record's answer gets a MinHash signature over its word shingles, banded
+// into locality-sensitive hash buckets, so that answers sharing enough of
+// their text meet in a bucket without comparing every pair.
+//
+// All text must already be folded (see text_fold()).
+typedef struct _FingerprintIndex FingerprintIndex;
+
+typedef struct {
+  std::string id;
+  int64_t timestamp_ms;
+  // The share of the shorter query's words found in the other, from 0 to 1.
+  double score;
+} FingerprintMatch;
+
+typedef struct {
+  uint64_t records;
+  uint64_t dead_records;
+  uint64_t query_words;
+  uint64_t buckets;
+  // Bytes held by SimHashes, word hashes, signatures and bucket lists.
+  uint64_t index_bytes;
+} FingerprintIndexStats;
+
+FingerprintIndex* fingerprint_index_new();
+
+void fingerprint_index_free(FingerprintIndex* index);
+
+/**
+ * fingerprint_index_put:
+ * @index: a #FingerprintIndex.
+ * @id: the record's document id.
+ * @timestamp_ms: when the record was created.
+ * @query: the folded research query.
+ * @answer: the folded answer.
+ *
+ * Fingerprints a record, replacing any previous record with the same @id.
+ */
+void fingerprint_index_put(FingerprintIndex* index,
+                           const std::string& id,
+                           int64_t timestamp_ms,
+                           const std::string& query,
+                           const std::string& answer);
+
+/**
+ * fingerprint_index_remove:
+ * @index: a #FingerprintIndex.
+ * @id: the record's document id.
+ *
+ * Returns: %TRUE if a record was removed.
+ */
+bool fingerprint_index_remove(FingerprintIndex* index, const std::string& id);
+
+void fingerprint_index_clear(FingerprintIndex* index);
+
+/**
+ * fingerprint_index_similar:
+ * @index: a #FingerprintIndex.
+ * @query: a folded research query.
+ * @limit: the maximum number of matches, or 0 for no limit.
+ * @matches: (out): receives the records asking for the same thing, best
+ *   first.
+ *
+ * Finds the records whose query names the same person as @query, however
+ * reworded: at least two of the words of the shorter query, and three in
+ * four of them, must appear in the other. Equal scores are ordered newest
+ * first.
+ */
+void fingerprint_index_similar(FingerprintIndex* index,
+                               const std::string& query,
+                               size_t limit,
+                               std::vector<FingerprintMatch>* matches);
+
+/**
+ * fingerprint_index_duplicates:
+ * @index: a #FingerprintIndex.
+ * @groups: (out): receives the groups of duplicate record ids, each newest
+ *   first.
+ *
+ * Groups the records that repeat one another: similar queries whose answers
+ * overlap, or answers that are nearly the same whatever was asked. Records
+ * without a duplicate are left out.
+ */
+void fingerprint_index_duplicates(FingerprintIndex* index,
+                                  std::vector<std::vector<std::string>>* groups);
+
+FingerprintIndexStats fingerprint_index_get_stats(FingerprintIndex* index);
+
+#endif  // RUNNER_FINGERPRINT_INDEX_H_
@@ -0,0 +1,385 @@
+#include "frame_stats.h"
+
+#include <glib-unix.h>
+#include <glib/gstdio.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+// Upper bounds of the histogram buckets, in microseconds, dense around the
+// 60 Hz frame budget; one more bucket holds everything slower.
+constexpr gint64 kBucketBounds[] = {
+    1000,  2000,  4000,  6000,   8000,   10000,  12000,  14000,  16667,
+    20000, 25000, 33333, 50000, 66667, 100000, 250000, 500000, 1000000};
+constexpr size_t kBucketCount = G_N_ELEMENTS(kBucketBounds) + 1;
+
+// The recent histograms cover kWindowCount windows of kWindowUs each, so a
+// regression shows up within minutes instead of being averaged into the
+// whole session.
+constexpr gint64 kWindowUs = 60 * G_USEC_PER_SEC;
+constexpr size_t kWindowCount = 5;
+
+// Assumed until GDK reports the refresh interval of the monitor.
+constexpr gint64 kDefaultBudgetUs = 16667;
+
+// A longer gap between two frames is the frame clock idling, not a stall.
+constexpr gint64 kIdleUs = G_USEC_PER_SEC;
+
+constexpr const char* kMetricNames[FRAME_STATS_METRIC_COUNT] = {
+    "build", "raster", "present", "interval"};
+
+constexpr char kDefaultScreen[] = "startup";
+
+typedef struct {
+  guint64 buckets[kBucketCount];
+  guint64 count;
+  // Samples above the metric's threshold when they were recorded.
+  guint64 slow;
+  gint64 sum;
+  gint64 max;
+} Histogram;
+
+typedef struct {
+  Histogram total;
+  Histogram windows[kWindowCount];
+  // g_get_monotonic_time() / kWindowUs of the samples in each window.
+  gint64 window_epochs[kWindowCount];
+} Series;
+
+typedef struct {
+  std::string name;
+  Series series[FRAME_STATS_METRIC_COUNT];
+} Screen;
+
+typedef struct {
+  gchar* path;
+  // In the order they were first seen.
+  std::vector<Screen> screens;
+  // The screen GTK frames are tagged with.
+  std::string current;
+  // Reported by GDK, or 0 until it is known.
+  gint64 refresh_interval;
+  // The last frame clock counter whose timings were read.
+  gint64 last_counter;
+  // When that frame was presented, or 0 after a gap.
+  gint64 last_presented;
+  gint64 started;
+} FrameStats;
+
+// Never freed; it lives as long as the process.
+FrameStats* stats = nullptr;
+
+gint64 budget() {
+  return stats->refresh_interval > 0 ? stats->refresh_interval
+                                     : kDefaultBudgetUs;
+}
+
+// Build and raster each get the whole frame budget; presenting a frame takes
+// up to two refreshes on a compositor; an interval of one and a half
+// refreshes means a frame was dropped.
+gint64 slow_threshold(FrameStatsMetric metric) {
+  switch (metric) {
+    case FRAME_STATS_PRESENT:
+      return 2 * budget();
+    case FRAME_STATS_INTERVAL:
+      return budget() * 3 / 2;
+    default:
+      return budget();
+  }
+}
+
+Screen* find_screen(const char* name) {
+  for (Screen& screen : stats->screens) {
+    if (screen.name == name) {
+      return &screen;
+    }
+  }
+  stats->screens.push_back(Screen());
+  stats->screens.back().name = name;
+  return &stats->screens.back();
+}
+
+void add(Histogram* histogram, gint64 value, gboolean slow) {
+  size_t bucket = 0;
+  while (bucket < G_N_ELEMENTS(kBucketBounds) &&
+         value > kBucketBounds[bucket]) {
+    bucket++;
+  }
+  histogram->buckets[bucket]++;
+  histogram->count++;
+  histogram->slow += slow ? 1 : 0;
+  histogram->sum += value;
+  histogram->max = MAX(histogram->max, value);
+}
+
+void merge(Histogram* into, const Histogram& from) {
+  for (size_t i = 0; i < kBucketCount; i++) {
+    into->buckets[i] += from.buckets[i];
+  }
+  into->count += from.count;
+  into->slow += from.slow;
+  into->sum += from.sum;
+  into->max = MAX(into->max, from.max);
+}
+
+// The upper bound of the bucket holding the @quantile sample, which is at
+// most the largest sample.
+gint64 percentile(const Histogram& histogram, double quantile) {
+  guint64 rank = static_cast<guint64>(quantile * histogram.count + 0.5);
+  guint64 seen = 0;
+  for (size_t i = 0; i < G_N_ELEMENTS(kBucketBounds); i++) {
+    seen += histogram.buckets[i];
+    if (seen >= MAX(rank, 1)) {
+      return MIN(kBucketBounds[i], histogram.max);
+    }
+  }
+  return histogram.max;
+}
+
+void record(const char* screen, FrameStatsMetric metric, gint64 value) {
+  if (value < 0 || metric >= FRAME_STATS_METRIC_COUNT) {
+    return;
+  }
+  Series* series = &find_screen(screen)->series[metric];
+  gint64 epoch = g_get_monotonic_time() / kWindowUs;
+  size_t slot = epoch % kWindowCount;
+  if (series->window_epochs[slot] != epoch) {
+    series->windows[slot] = Histogram();
+    series->window_epochs[slot] = epoch;
+  }
+  gboolean slow = value > slow_threshold(metric);
+  add(&series->total, value, slow);
+  add(&series->windows[slot], value, slow);
+}
+
+void record_frame(GdkFrameTimings* timings) {
+  gint64 refresh_interval = gdk_frame_timings_get_refresh_interval(timings);
+  if (refresh_interval > 0) {
+    stats->refresh_interval = refresh_interval;
+  }
+
+  const char* screen = stats->current.c_str();
+  gint64 frame_time = gdk_frame_timings_get_frame_time(timings);
+  // Zero where the compositor does not report presentation times, as on
+  // X11 without _NET_WM_FRAME_TIMINGS; the interval then falls back to frame
+  // start times.
+  gint64 presented = gdk_frame_timings_get_presentation_time(timings);
+  if (presented > 0) {
+    record(screen, FRAME_STATS_PRESENT, presented - frame_time);
+  }
+
+  gint64 at = presented > 0 ? presented : frame_time;
+  if (stats->last_presented > 0 && at - stats->last_presented < kIdleUs) {
+    record(screen, FRAME_STATS_INTERVAL, at - stats->last_presented);
+  }
+  stats->last_presented = at;
+}
+
+// Called after GTK paints a frame. Presentation times arrive a frame or two
+// later, so every earlier frame whose timings are complete is read here.
+void after_paint_cb(GdkFrameClock* clock, gpointer user_data) {
+  gint64 counter = gdk_frame_clock_get_frame_counter(clock);
+  gint64 first = stats->last_counter + 1;
+  gint64 history_start = gdk_frame_clock_get_history_start(clock);
+  if (first < history_start) {
+    first = history_start;
+    stats->last_presented = 0;
+  }
+  for (gint64 frame = first; frame < counter; frame++) {
+    GdkFrameTimings* timings = gdk_frame_clock_get_timings(clock, frame);
+    if (timings == nullptr || !gdk_frame_timings_get_complete(timings)) {
+      break;
+    }
+    stats->last_counter = frame;
+    record_frame(timings);
+  }
+}
+
+gboolean flush_signal_cb(gpointer user_data) {
+  frame_stats_flush();
+  return G_SOURCE_CONTINUE;
+}
+
+void append_escaped(std::string* json, const std::string& text) {
+  json->push_back('"');
+  for (unsigned char c : text) {
+    if (c == '"' || c == '\\') {
+      json->push_back('\\');
+      json->push_back(c);
+    } else if (c < 0x20) {
+      char escape[8];
+      snprintf(escape, sizeof(escape), "\\u%04x", c);
+      json->append(escape);
+    } else {
+      json->push_back(c);
+    }
+  }
+  json->push_back('"');
+}
+
+void append_histogram(std::string* json,
+                      FrameStatsMetric metric,
+                      const Histogram& histogram) {
+  g_autofree gchar* fields = g_strdup_printf(
+      "\"%s\":{\"count\":%" G_GUINT64_FORMAT ",\"slow\":%" G_GUINT64_FORMAT
+      ",\"slowAboveUs\":%" G_GINT64_FORMAT ",\"meanUs\":%" G_GINT64_FORMAT
+      ",\"p50Us\":%" G_GINT64_FORMAT ",\"p90Us\":%" G_GINT64_FORMAT
+      ",\"p99Us\":%" G_GINT64_FORMAT ",\"maxUs\":%" G_GINT64_FORMAT
+      ",\"buckets\":[",
+      kMetricNames[metric], histogram.count, histogram.slow,
+      slow_threshold(metric),
+      histogram.sum / static_cast<gint64>(histogram.count),
+      percentile(histogram, 0.5), percentile(histogram, 0.9),
+      percentile(histogram, 0.99), histogram.max);
+  json->append(fields);
+
+  // Only buckets with samples, as [upper bound, count]; the last bucket is
+  // bounded by the largest sample.
+  bool first = true;
+  for (size_t i = 0; i < kBucketCount; i++) {
+    if (histogram.buckets[i] == 0) {
+      continue;
+    }
+    gint64 bound = i < G_N_ELEMENTS(kBucketBounds) ? kBucketBounds[i]
+                                                   : histogram.max;
+    g_autofree gchar* bucket =
+        g_strdup_printf("%s[%" G_GINT64_FORMAT ",%" G_GUINT64_FORMAT "]",
+                        first ? "" : ",", bound, histogram.buckets[i]);
+    json->append(bucket);
+    first = false;
+  }
+  json->append("]}");
+}
+
+// Appends an object with a histogram per metric that has samples.
+void append_histograms(std::string* json, const Histogram* histograms) {
+  json->push_back('{');
+  bool first = true;
+  for (int metric = 0; metric < FRAME_STATS_METRIC_COUNT; metric++) {
+    if (histograms[metric].count == 0) {
+      continue;
+    }
+    if (!first) {
+      json->push_back(',');
+    }
+    append_histogram(json, static_cast<FrameStatsMetric>(metric),
+                     histograms[metric]);
+    first = false;
+  }
+  json->push_back('}');
+}
+
+}  // namespace
+
+void frame_stats_init(int argc, char** argv) {
+  const gchar* path = g_getenv(kFrameStatsEnv);
+  for (int i = 1; i < argc; i++) {
+    if (g_str_has_prefix(argv[i], kFrameStatsArgument)) {
+      path = argv[i] + strlen(kFrameStatsArgument);
+    }
+  }
+
+  stats = new FrameStats();
+  stats->path = path != nullptr && path[0] != '\0'
+                    ? g_strdup(path)
+                    : g_build_filename(g_get_user_cache_dir(), APPLICATION_ID,
+                                       "frame_stats.json", nullptr);
+  stats->current = kDefaultScreen;
+  stats->started = g_get_monotonic_time();
+
+  g_unix_signal_add(SIGUSR1, flush_signal_cb, nullptr);
+}
+
+void frame_stats_watch(GtkWidget* widget) {
+  GdkFrameClock* clock = gtk_widget_get_frame_clock(widget);
+  if (stats == nullptr || clock == nullptr) {
+    return;
+  }
+  stats->last_counter = gdk_frame_clock_get_frame_counter(clock);
+  g_signal_connect(clock, "after-paint", G_CALLBACK(after_paint_cb), nullptr);
+}
+
+void frame_stats_set_screen(const char* screen) {
+  if (stats == nullptr) {
+    return;
+  }
+  stats->current = screen;
+}
+
+void frame_stats_record(const char* screen,
+                        FrameStatsMetric metric,
+                        gint64 value_us) {
+  if (stats == nullptr) {
+    return;
+  }
+  record(screen, metric, value_us);
+}
+
+gchar* frame_stats_to_json() {
+  if (stats == nullptr) {
+    return g_strdup("{}");
+  }
+
+  gint64 now = g_get_monotonic_time();
+  gint64 epoch = now / kWindowUs;
+  g_autofree gchar* header = g_strdup_printf(
+      "{\"budgetUs\":%" G_GINT64_FORMAT ",\"recentSeconds\":%" G_GINT64_FORMAT
+      ",\"elapsedSeconds\":%" G_GINT64_FORMAT ",\"screens\":{",
+      budget(), static_cast<gint64>(kWindowCount) * kWindowUs / G_USEC_PER_SEC,
+      (now - stats->started) / G_USEC_PER_SEC);
+  std::string json = header;
+
+  bool first = true;
+  for (const Screen& screen : stats->screens) {
+    Histogram recent[FRAME_STATS_METRIC_COUNT] = {};
+    Histogram total[FRAME_STATS_METRIC_COUNT] = {};
+    for (int metric = 0; metric < FRAME_STATS_METRIC_COUNT; metric++) {
+      const Series& series = screen.series[metric];
+      total[metric] = series.total;
+      for (size_t slot = 0; slot < kWindowCount; slot++) {
+        if (series.window_epochs[slot] >
+            epoch - static_cast<gint64>(kWindowCount)) {
+          merge(&recent[metric], series.windows[slot]);
+        }
+      }
+    }
+
+    json += first ? "\n" : ",\n";
+    append_escaped(&json, screen.name);
+    json += ":{\"recent\":";
+    append_histograms(&json, recent);
+    json += ",\"total\":";
+    append_histograms(&json, total);
+    json += "}";
+    first = false;
+  }
+  json += "}}\n";
+  return g_strdup(json.c_str());
+}
+
+void frame_stats_flush() {
+  if (stats == nullptr) {
+    return;
+  }
+
+  g_autofree gchar* json = frame_stats_to_json();
+  g_autofree gchar* directory = g_path_get_dirname(stats->path);
+  g_mkdir_with_parents(directory, 0700);
+  g_autoptr(GError) error = nullptr;
+  if (!g_file_set_contents(stats->path, json, -1, &error)) {
+    g_warning("Failed to write frame stats: %s", error->message);
+  }
+}
+
+void frame_stats_reset() {
+  if (stats == nullptr) {
+    return;
+  }
+  stats->screens.clear();
+  stats->started = g_get_monotonic_time();
+}
@@ -0,0 +1,88 @@
+#ifndef RUNNER_FRAME_STATS_H_
+#define RUNNER_FRAME_STATS_H_
+
+#include <gtk/gtk.h>
+
+// Environment variable naming the file the histograms are written to.
+constexpr char kFrameStatsEnv[] = "ECHOLENS_FRAME_STATS";
+// Entry point argument with the same meaning as kFrameStatsEnv.
+constexpr char kFrameStatsArgument[] = "--frame-stats=";
+
+// What a histogram measures, in microseconds.
+typedef enum {
+  // FrameTiming.buildDuration reported by Flutter.
+  FRAME_STATS_BUILD,
+  // FrameTiming.rasterDuration reported by Flutter.
+  FRAME_STATS_RASTER,
+  // From the start of a GTK frame until the compositor presented it.
+  FRAME_STATS_PRESENT,
+  // Between two consecutive frames presented by GTK.
+  FRAME_STATS_INTERVAL,
+  FRAME_STATS_METRIC_COUNT,
+} FrameStatsMetric;
+
+/**
+ * frame_stats_init:
+ * @argc: the argument count passed to main().
+ * @argv: the arguments passed to main().
+ *
+ * Starts collecting frame histograms. They are written as JSON at exit and
+ * whenever the process receives SIGUSR1, to the path given by
+ * `ECHOLENS_FRAME_STATS=<path>` or `--frame-stats=<path>`, or else to
+ * frame_stats.json in the user cache directory. Collecting is always on;
+ * every function here must be called on the main thread.
+ */
+void frame_stats_init(int argc, char** argv);
+
+/**
+ * frame_stats_watch:
+ * @widget: a realized widget, the FlView.
+ *
+ * Records the present time and interval of every frame painted by the frame
+ * clock of @widget's window.
+ */
+void frame_stats_watch(GtkWidget* widget);
+
+/**
+ * frame_stats_set_screen:
+ * @screen: the screen on display, e.g. "search" or "drawer".
+ *
+ * Tags the frames that GTK paints from now on.
+ */
+void frame_stats_set_screen(const char* screen);
+
+/**
+ * frame_stats_record:
+ * @screen: the screen the sample belongs to.
+ * @metric: what @value_us measures.
+ * @value_us: the sample, in microseconds.
+ *
+ * Adds a sample measured elsewhere, such as a Flutter frame timing.
+ */
+void frame_stats_record(const char* screen,
+                        FrameStatsMetric metric,
+                        gint64 value_us);
+
+/**
+ * frame_stats_to_json:
+ *
+ * Returns: (transfer full): the histograms of every screen, both over the
+ * last few minutes and since the start or the last frame_stats_reset().
+ */
+gchar* frame_stats_to_json();
+
+/**
+ * frame_stats_flush:
+ *
+ * Writes frame_stats_to_json() to the stats file, replacing it atomically.
+ */
+void frame_stats_flush();
+
+/**
+ * frame_stats_reset:
+ *
+ * Clears every histogram, e.g. before measuring a single interaction.
+ */
+void frame_stats_reset();
+
+#endif  // RUNNER_FRAME_STATS_H_
@@ -0,0 +1,128 @@
+#include "frame_stats_plugin.h"
+
+#include <cstring>
+
+#include "frame_stats.h"
+
+static constexpr char kChannelName[] = "echolens/frame_stats";
+
+static constexpr char kSetScreenMethod[] = "setScreen";
+static constexpr char kAddFramesMethod[] = "addFrames";
+static constexpr char kDumpMethod[] = "dump";
+static constexpr char kResetMethod[] = "reset";
+
+static constexpr char kBadArgumentsError[] = "Bad Arguments";
+
+// Values per frame in the frames list of addFrames.
+static constexpr size_t kFrameFields = 3;
+
+struct _FrameStatsPlugin {
+  GObject parent_instance;
+};
+
+G_DEFINE_TYPE(FrameStatsPlugin, frame_stats_plugin, G_TYPE_OBJECT)
+
+static FlMethodResponse* set_screen(FlValue* args) {
+  FlValue* screen = nullptr;
+  if (fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    screen = fl_value_lookup_string(args, "screen");
+  }
+  if (screen == nullptr || fl_value_get_type(screen) != FL_VALUE_TYPE_STRING) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        kBadArgumentsError, "Expected screen", nullptr));
+  }
+  frame_stats_set_screen(fl_value_get_string(screen));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+}
+
+static FlMethodResponse* add_frames(FlValue* args) {
+  FlValue* screens = nullptr;
+  FlValue* frames = nullptr;
+  if (fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    screens = fl_value_lookup_string(args, "screens");
+    frames = fl_value_lookup_string(args, "frames");
+  }
+  if (screens == nullptr || fl_value_get_type(screens) != FL_VALUE_TYPE_LIST ||
+      frames == nullptr ||
+      fl_value_get_type(frames) != FL_VALUE_TYPE_INT64_LIST ||
+      fl_value_get_length(frames) % kFrameFields != 0) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        kBadArgumentsError, "Expected screens and frames", nullptr));
+  }
+
+  size_t screen_count = fl_value_get_length(screens);
+  for (size_t i = 0; i < screen_count; i++) {
+    if (fl_value_get_type(fl_value_get_list_value(screens, i)) !=
+        FL_VALUE_TYPE_STRING) {
+      return FL_METHOD_RESPONSE(fl_method_error_response_new(
+          kBadArgumentsError, "Expected every screen to be a string",
+          nullptr));
+    }
+  }
+
+  const int64_t* values = fl_value_get_int64_list(frames);
+  for (size_t i = 0; i < fl_value_get_length(frames); i += kFrameFields) {
+    int64_t screen = values[i];
+    if (screen < 0 || static_cast<size_t>(screen) >= screen_count) {
+      continue;
+    }
+    const gchar* name =
+        fl_value_get_string(fl_value_get_list_value(screens, screen));
+    frame_stats_record(name, FRAME_STATS_BUILD, values[i + 1]);
+    frame_stats_record(name, FRAME_STATS_RASTER, values[i + 2]);
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+}
+
+static FlMethodResponse* dump() {
+  frame_stats_flush();
+  g_autofree gchar* json = frame_stats_to_json();
+  g_autoptr(FlValue) result = fl_value_new_string(json);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Called when a method call is received from Flutter.
+static void method_call_cb(FlMethodChannel* channel,
+                           FlMethodCall* method_call,
+                           gpointer user_data) {
+  const gchar* method = fl_method_call_get_name(method_call);
+  FlValue* args = fl_method_call_get_args(method_call);
+
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (strcmp(method, kSetScreenMethod) == 0) {
+    response = set_screen(args);
+  } else if (strcmp(method, kAddFramesMethod) == 0) {
+    response = add_frames(args);
+  } else if (strcmp(method, kDumpMethod) == 0) {
+    response = dump();
+  } else if (strcmp(method, kResetMethod) == 0) {
+    frame_stats_reset();
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+  } else {
+    response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+  }
+
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(method_call, response, &error)) {
+    g_warning("Failed to send method call response: %s", error->message);
+  }
+}
+
+static void frame_stats_plugin_class_init(FrameStatsPluginClass* klass) {}
+
+static void frame_stats_plugin_init(FrameStatsPlugin* self) {}
+
+void frame_stats_plugin_register_with_registrar(FlPluginRegistrar* registrar) {
+  FrameStatsPlugin* plugin = FRAME_STATS_PLUGIN(
+      g_object_new(frame_stats_plugin_get_type(), nullptr));
+
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  g_autoptr(FlMethodChannel) channel =
+      fl_method_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                            kChannelName, FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(channel, method_call_cb,
+                                            g_object_ref(plugin),
+                                            g_object_unref);
+
+  g_object_unref(plugin);
+}
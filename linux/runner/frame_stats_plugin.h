@@ -0,0 +1,25 @@
+#ifndef RUNNER_FRAME_STATS_PLUGIN_H_
+#define RUNNER_FRAME_STATS_PLUGIN_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+G_DECLARE_FINAL_TYPE(FrameStatsPlugin,
+                     frame_stats_plugin,
+                     FRAME,
+                     STATS_PLUGIN,
+                     GObject)
+
+/**
+ * frame_stats_plugin_register_with_registrar:
+ * @registrar: an #FlPluginRegistrar.
+ *
+ * Registers the "echolens/frame_stats" method channel, through which Dart
+ * reports its frame timings and the screen on display. `setScreen` takes
+ * `{screen}`; `addFrames` takes `{screens: [name], frames: Int64List}` with
+ * three values per frame: the index of its screen, its build and its raster
+ * time in microseconds; `dump` writes the stats file and replies with its
+ * JSON; `reset` clears the histograms.
+ */
+void frame_stats_plugin_register_with_registrar(FlPluginRegistrar* registrar);
+
+#endif  // RUNNER_FRAME_STATS_PLUGIN_H_
@@ -0,0 +1,618 @@
+#include "fuzzy_matcher.h"
+
+#include <glib.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Myers' algorithm keeps a pattern column in one machine word.
+constexpr size_t kMaxWordLength = 64;
+constexpr size_t kMaxWords = 8;
+
+// Dead titles keep their characters until this many have died and they
+// outnumber the live ones, as in the history index.
+constexpr size_t kMinDeadForCompaction = 256;
+
+struct Title {
+  std::string id;
+  int64_t timestamp_ms;
+  // Range of the title's folded characters in _FuzzyMatcher::chars.
+  uint32_t begin;
+  uint32_t length;
+  // The char_bit() of every folded character of the title.
+  uint64_t chars_seen;
+  bool live;
+};
+
+// One word of a needle, compiled for Myers' algorithm.
+struct Pattern {
+  std::vector<uint32_t> chars;
+  // Bit i of the mask of a character is set if the word has it at i.
+  uint64_t ascii[128];
+  std::vector<std::pair<uint32_t, uint64_t>> others;
+  uint64_t last;
+  uint32_t max_distance;
+  // How many characters of the word have each char_bit().
+  std::vector<std::pair<uint64_t, uint32_t>> char_counts;
+
+  uint64_t mask(uint32_t c) const {
+    if (c < 128) {
+      return ascii[c];
+    }
+    auto it = std::lower_bound(
+        others.begin(), others.end(), std::make_pair(c, uint64_t{0}));
+    return it != others.end() && it->first == c ? it->second : 0;
+  }
+};
+
+// One bit each for folded letters and digits, and a few shared by the rest.
+uint64_t char_bit(uint32_t c) {
+  if (c >= 'a' && c <= 'z') {
+    return uint64_t{1} << (c - 'a');
+  }
+  if (c >= '0' && c <= '9') {
+    return uint64_t{1} << (26 + c - '0');
+  }
+  return uint64_t{1} << (36 + c % 28);
+}
+
+// Where the best occurrence of a pattern in a title ends, and its edits.
+struct Occurrence {
+  uint32_t distance;
+  uint32_t end;
+};
+
+// Folds @text character by character: compatibility decomposition, with
+// combining marks dropped, then case folding. Runs of whitespace become one
+// space and leading and trailing ones are dropped. Each folded character is
+// appended to @chars, and the UTF-16 offsets of the character it came from
+// to @starts and @ends when they are given.
+void fold(const std::string& text,
+          std::vector<uint32_t>* chars,
+          std::vector<uint32_t>* starts,
+          std::vector<uint32_t>* ends) {
+  size_t first = chars->size();
+  bool pending_space = false;
+  uint32_t offset = 0;
+  const gchar* p = text.c_str();
+  const gchar* end = p + text.size();
+  while (p < end) {
+    gunichar c = g_utf8_get_char_validated(p, end - p);
+    const gchar* next;
+    if (c == static_cast<gunichar>(-1) || c == static_cast<gunichar>(-2)) {
+      // A stray byte; stands for itself, as U+FFFD would on screen.
+      c = 0xfffd;
+      next = p + 1;
+    } else {
+      next = g_utf8_next_char(p);
+    }
+    uint32_t width = c > 0xffff ? 2 : 1;
+    p = next;
+
+    if (g_unichar_isspace(c)) {
+      pending_space = chars->size() > first;
+      offset += width;
+      continue;
+    }
+
+    gunichar folded[G_UNICHAR_MAX_DECOMPOSITION_LENGTH * 3];
+    size_t count = 0;
+    if (c < 128) {
+      folded[count++] = c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+    } else {
+      gunichar decomposed[G_UNICHAR_MAX_DECOMPOSITION_LENGTH];
+      gsize length = g_unichar_fully_decompose(
+          c, TRUE, decomposed, G_UNICHAR_MAX_DECOMPOSITION_LENGTH);
+      for (gsize i = 0; i < length; i++) {
+        if (g_unichar_ismark(decomposed[i])) {
+          continue;
+        }
+        // Full case folding may expand a character, as ß to ss.
+        gchar utf8[6];
+        gint bytes = g_unichar_to_utf8(decomposed[i], utf8);
+        g_autofree gchar* lower = g_utf8_casefold(utf8, bytes);
+        for (const gchar* q = lower; *q != '\0'; q = g_utf8_next_char(q)) {
+          if (count < G_N_ELEMENTS(folded)) {
+            folded[count++] = g_utf8_get_char(q);
+          }
+        }
+      }
+    }
+
+    if (count > 0 && pending_space) {
+      chars->push_back(' ');
+      if (starts != nullptr) {
+        starts->push_back(offset - 1);
+        ends->push_back(offset);
+      }
+      pending_space = false;
+    }
+    for (size_t i = 0; i < count; i++) {
+      chars->push_back(folded[i]);
+      if (starts != nullptr) {
+        starts->push_back(offset);
+        ends->push_back(offset + width);
+      }
+    }
+    offset += width;
+  }
+}
+
+Pattern compile(const uint32_t* chars, size_t length) {
+  Pattern pattern;
+  pattern.chars.assign(chars, chars + length);
+  std::fill(pattern.ascii, pattern.ascii + 128, 0);
+  for (size_t i = 0; i < length; i++) {
+    uint64_t bit = uint64_t{1} << i;
+    uint64_t seen = char_bit(chars[i]);
+    auto counted = std::find_if(
+        pattern.char_counts.begin(), pattern.char_counts.end(),
+        [&](const std::pair<uint64_t, uint32_t>& e) {
+          return e.first == seen;
+        });
+    if (counted != pattern.char_counts.end()) {
+      counted->second++;
+    } else {
+      pattern.char_counts.push_back({seen, 1});
+    }
+
+    if (chars[i] < 128) {
+      pattern.ascii[chars[i]] |= bit;
+      continue;
+    }
+    auto it = std::find_if(
+        pattern.others.begin(), pattern.others.end(),
+        [&](const std::pair<uint32_t, uint64_t>& e) {
+          return e.first == chars[i];
+        });
+    if (it != pattern.others.end()) {
+      it->second |= bit;
+    } else {
+      pattern.others.push_back({chars[i], bit});
+    }
+  }
+  std::sort(pattern.others.begin(), pattern.others.end());
+  pattern.last = uint64_t{1} << (length - 1);
+  pattern.max_distance = length <= 2 ? 0 : length <= 5 ? 1 : 2;
+  return pattern;
+}
+
+// Every character of a word that a title lacks costs an edit, and so does
+// every character the title is too short to hold. A title needing more edits
+// either way cannot match and is not searched.
+bool may_match(const Pattern& pattern, const Title& title) {
+  if (title.length + pattern.max_distance < pattern.chars.size()) {
+    return false;
+  }
+  uint32_t lacking = 0;
+  for (const auto& counted : pattern.char_counts) {
+    if ((title.chars_seen & counted.first) == 0) {
+      lacking += counted.second;
+    }
+  }
+  return lacking <= pattern.max_distance;
+}
+
+// Myers' algorithm, with Hyyro's extension that counts swapping two adjacent
+// characters as one edit, searching for @pattern anywhere in @text: the
+// fewest edits of any occurrence, and where the first such occurrence ends.
+Occurrence search(const Pattern& pattern,
+                  const uint32_t* text,
+                  uint32_t length) {
+  uint64_t vp = ~uint64_t{0};
+  uint64_t vn = 0;
+  uint64_t d0 = 0;
+  uint64_t previous_eq = 0;
+  uint32_t score = static_cast<uint32_t>(pattern.chars.size());
+  Occurrence best = {score, 0};
+  for (uint32_t j = 0; j < length; j++) {
+    uint64_t eq = pattern.mask(text[j]);
+    uint64_t tr = ((~d0 & eq) << 1) & previous_eq;
+    d0 = (((eq & vp) + vp) ^ vp) | eq | vn | tr;
+    uint64_t hp = vn | ~(d0 | vp);
+    uint64_t hn = vp & d0;
+    score += (hp & pattern.last) != 0;
+    score -= (hn & pattern.last) != 0;
+    // No carry into the first row: an occurrence may start anywhere.
+    uint64_t x = hp << 1;
+    vn = x & d0;
+    vp = (hn << 1) | ~(d0 | x);
+    previous_eq = eq;
+    if (score < best.distance) {
+      best = {score, j + 1};
+    }
+  }
+  return best;
+}
+
+#if defined(__SSE2__)
+// Titles searched at once: two per SSE2 register, in two registers whose
+// steps are independent and so overlap in the pipeline.
+constexpr int kLanes = 4;
+constexpr int kVectors = kLanes / 2;
+
+// search() on kLanes texts at once, one per 64-bit lane. A lane past the end
+// of its text keeps running on empty masks but no longer records occurrences.
+void search_lanes(const Pattern& pattern,
+                  const uint32_t* const texts[kLanes],
+                  const uint32_t lengths[kLanes],
+                  Occurrence best[kLanes]) {
+  const __m128i ones = _mm_set1_epi32(-1);
+  const __m128i last = _mm_set1_epi64x(static_cast<int64_t>(pattern.last));
+  const __m128i shift =
+      _mm_cvtsi32_si128(static_cast<int>(pattern.chars.size() - 1));
+  __m128i vp[kVectors];
+  __m128i vn[kVectors];
+  __m128i d0[kVectors];
+  __m128i previous_eq[kVectors];
+  __m128i score[kVectors];
+  __m128i best_score[kVectors];
+  __m128i best_end[kVectors];
+  for (int v = 0; v < kVectors; v++) {
+    vp[v] = ones;
+    vn[v] = _mm_setzero_si128();
+    d0[v] = _mm_setzero_si128();
+    previous_eq[v] = _mm_setzero_si128();
+    score[v] = _mm_set1_epi64x(static_cast<int64_t>(pattern.chars.size()));
+    best_score[v] = score[v];
+    best_end[v] = _mm_setzero_si128();
+  }
+
+  uint32_t steps = *std::max_element(lengths, lengths + kLanes);
+  for (uint32_t j = 0; j < steps; j++) {
+    __m128i end = _mm_set1_epi64x(j + 1);
+    for (int v = 0; v < kVectors; v++) {
+      bool active0 = j < lengths[2 * v];
+      bool active1 = j < lengths[2 * v + 1];
+      __m128i eq = _mm_set_epi64x(
+          active1 ? static_cast<int64_t>(pattern.mask(texts[2 * v + 1][j]))
+                  : 0,
+          active0 ? static_cast<int64_t>(pattern.mask(texts[2 * v][j])) : 0);
+      __m128i tr = _mm_and_si128(
+          _mm_slli_epi64(_mm_andnot_si128(d0[v], eq), 1), previous_eq[v]);
+      d0[v] = _mm_or_si128(
+          _mm_xor_si128(_mm_add_epi64(_mm_and_si128(eq, vp[v]), vp[v]),
+                        vp[v]),
+          _mm_or_si128(_mm_or_si128(eq, vn[v]), tr));
+      __m128i hp = _mm_or_si128(
+          vn[v], _mm_xor_si128(_mm_or_si128(d0[v], vp[v]), ones));
+      __m128i hn = _mm_and_si128(vp[v], d0[v]);
+      // The bits at the last row are never both set.
+      score[v] = _mm_add_epi64(
+          score[v], _mm_srl_epi64(_mm_and_si128(hp, last), shift));
+      score[v] = _mm_sub_epi64(
+          score[v], _mm_srl_epi64(_mm_and_si128(hn, last), shift));
+      __m128i x = _mm_slli_epi64(hp, 1);
+      vn[v] = _mm_and_si128(x, d0[v]);
+      vp[v] = _mm_or_si128(_mm_slli_epi64(hn, 1),
+                           _mm_xor_si128(_mm_or_si128(d0[v], x), ones));
+      previous_eq[v] = eq;
+
+      // Scores are small and non-negative, so comparing the low halves and
+      // copying the result over each lane compares the whole lanes.
+      __m128i lower = _mm_cmplt_epi32(score[v], best_score[v]);
+      lower = _mm_shuffle_epi32(lower, _MM_SHUFFLE(2, 2, 0, 0));
+      lower = _mm_and_si128(
+          lower, _mm_set_epi64x(active1 ? -1 : 0, active0 ? -1 : 0));
+      best_score[v] = _mm_or_si128(_mm_and_si128(lower, score[v]),
+                                   _mm_andnot_si128(lower, best_score[v]));
+      best_end[v] = _mm_or_si128(_mm_and_si128(lower, end),
+                                 _mm_andnot_si128(lower, best_end[v]));
+    }
+  }
+
+  for (int v = 0; v < kVectors; v++) {
+    alignas(16) uint64_t scores[2];
+    alignas(16) uint64_t ends[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(scores), best_score[v]);
+    _mm_store_si128(reinterpret_cast<__m128i*>(ends), best_end[v]);
+    for (int lane = 0; lane < 2; lane++) {
+      best[2 * v + lane] = {static_cast<uint32_t>(scores[lane]),
+                            static_cast<uint32_t>(ends[lane])};
+    }
+  }
+}
+#endif
+
+// Where the occurrence ending at @end with @distance edits starts: Myers'
+// algorithm run from @end towards the start of @text with @backwards, the
+// pattern reversed, anchored at @end, until the edit distance first comes
+// down to @distance.
+uint32_t find_start(const Pattern& backwards,
+                    const uint32_t* text,
+                    uint32_t end,
+                    uint32_t distance) {
+  size_t m = backwards.chars.size();
+  uint64_t vp = ~uint64_t{0};
+  uint64_t vn = 0;
+  uint64_t d0 = 0;
+  uint64_t previous_eq = 0;
+  uint32_t score = static_cast<uint32_t>(m);
+  uint32_t start = end;
+  for (uint32_t j = 1; j <= end; j++) {
+    uint64_t eq = backwards.mask(text[end - j]);
+    uint64_t tr = ((~d0 & eq) << 1) & previous_eq;
+    d0 = (((eq & vp) + vp) ^ vp) | eq | vn | tr;
+    uint64_t hp = vn | ~(d0 | vp);
+    uint64_t hn = vp & d0;
+    score += (hp & backwards.last) != 0;
+    score -= (hn & backwards.last) != 0;
+    // Carrying into the first row anchors the occurrence at @end.
+    uint64_t x = (hp << 1) | 1;
+    vn = x & d0;
+    vp = (hn << 1) | ~(d0 | x);
+    previous_eq = eq;
+    if (score <= distance) {
+      start = end - j;
+      break;
+    }
+    if (j >= m + distance) {
+      break;
+    }
+  }
+  return start;
+}
+
+struct Candidate {
+  uint32_t title;
+  uint32_t distance;
+  // Whether the needle's first word matched at the start of a word.
+  bool at_word_start;
+  Occurrence occurrences[kMaxWords];
+};
+
+}  // namespace
+
+struct _FuzzyMatcher {
+  std::vector<Title> titles;
+  std::unordered_map<std::string, uint32_t> by_id;
+  // Folded characters of every title, back to back, and the UTF-16 range of
+  // the original character each came from.
+  std::vector<uint32_t> chars;
+  std::vector<uint32_t> starts;
+  std::vector<uint32_t> ends;
+  size_t dead;
+};
+
+// Drops the characters of dead titles and renumbers the live ones densely.
+static void compact(FuzzyMatcher* matcher) {
+  std::vector<Title> live;
+  std::vector<uint32_t> chars;
+  std::vector<uint32_t> starts;
+  std::vector<uint32_t> ends;
+  live.reserve(matcher->titles.size() - matcher->dead);
+  for (Title& title : matcher->titles) {
+    if (!title.live) {
+      continue;
+    }
+    uint32_t begin = static_cast<uint32_t>(chars.size());
+    auto from = matcher->chars.begin() + title.begin;
+    chars.insert(chars.end(), from, from + title.length);
+    starts.insert(starts.end(), matcher->starts.begin() + title.begin,
+                  matcher->starts.begin() + title.begin + title.length);
+    ends.insert(ends.end(), matcher->ends.begin() + title.begin,
+                matcher->ends.begin() + title.begin + title.length);
+    title.begin = begin;
+    matcher->by_id[title.id] = static_cast<uint32_t>(live.size());
+    live.push_back(std::move(title));
+  }
+  matcher->titles = std::move(live);
+  matcher->chars = std::move(chars);
+  matcher->starts = std::move(starts);
+  matcher->ends = std::move(ends);
+  matcher->dead = 0;
+}
+
+FuzzyMatcher* fuzzy_matcher_new() {
+  FuzzyMatcher* matcher = new FuzzyMatcher();
+  matcher->dead = 0;
+  return matcher;
+}
+
+void fuzzy_matcher_free(FuzzyMatcher* matcher) {
+  delete matcher;
+}
+
+void fuzzy_matcher_put(FuzzyMatcher* matcher,
+                       const std::string& id,
+                       int64_t timestamp_ms,
+                       const std::string& title) {
+  fuzzy_matcher_remove(matcher, id);
+
+  Title entry;
+  entry.id = id;
+  entry.timestamp_ms = timestamp_ms;
+  entry.begin = static_cast<uint32_t>(matcher->chars.size());
+  fold(title, &matcher->chars, &matcher->starts, &matcher->ends);
+  entry.length = static_cast<uint32_t>(matcher->chars.size()) - entry.begin;
+  entry.chars_seen = 0;
+  for (uint32_t i = entry.begin; i < matcher->chars.size(); i++) {
+    entry.chars_seen |= char_bit(matcher->chars[i]);
+  }
+  entry.live = true;
+
+  matcher->by_id[id] = static_cast<uint32_t>(matcher->titles.size());
+  matcher->titles.push_back(std::move(entry));
+}
+
+bool fuzzy_matcher_remove(FuzzyMatcher* matcher, const std::string& id) {
+  auto it = matcher->by_id.find(id);
+  if (it == matcher->by_id.end()) {
+    return false;
+  }
+  matcher->titles[it->second].live = false;
+  matcher->by_id.erase(it);
+  matcher->dead++;
+
+  if (matcher->dead >= kMinDeadForCompaction &&
+      matcher->dead > matcher->titles.size() - matcher->dead) {
+    compact(matcher);
+  }
+  return true;
+}
+
+void fuzzy_matcher_clear(FuzzyMatcher* matcher) {
+  matcher->titles.clear();
+  matcher->by_id.clear();
+  matcher->chars.clear();
+  matcher->starts.clear();
+  matcher->ends.clear();
+  matcher->dead = 0;
+}
+
+void fuzzy_matcher_match(FuzzyMatcher* matcher,
+                         const std::string& needle,
+                         size_t limit,
+                         std::vector<FuzzyMatch>* matches) {
+  matches->clear();
+  std::vector<uint32_t> folded;
+  fold(needle, &folded, nullptr, nullptr);
+  std::vector<Pattern> patterns;
+  for (size_t i = 0; i < folded.size() && patterns.size() < kMaxWords;) {
+    size_t end = std::find(folded.begin() + i, folded.end(), ' ') -
+                 folded.begin();
+    patterns.push_back(
+        compile(folded.data() + i, std::min(end - i, kMaxWordLength)));
+    i = end + 1;
+  }
+  if (patterns.empty()) {
+    return;
+  }
+  std::vector<Pattern> backwards;
+  for (const Pattern& pattern : patterns) {
+    std::vector<uint32_t> reversed(pattern.chars.rbegin(),
+                                   pattern.chars.rend());
+    backwards.push_back(compile(reversed.data(), reversed.size()));
+  }
+
+  std::vector<Candidate> candidates;
+  candidates.reserve(matcher->titles.size() - matcher->dead);
+  for (uint32_t i = 0; i < matcher->titles.size(); i++) {
+    if (matcher->titles[i].live) {
+      candidates.push_back({i, 0, false, {}});
+    }
+  }
+
+  // Each word narrows the candidates down for the next.
+  std::vector<Candidate*> searched;
+  searched.reserve(candidates.size());
+  for (size_t w = 0; w < patterns.size() && !candidates.empty(); w++) {
+    const Pattern& pattern = patterns[w];
+    searched.clear();
+    for (Candidate& candidate : candidates) {
+      if (may_match(pattern, matcher->titles[candidate.title])) {
+        searched.push_back(&candidate);
+      } else {
+        candidate.occurrences[w] = {pattern.max_distance + 1, 0};
+      }
+    }
+
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + kLanes <= searched.size(); i += kLanes) {
+      const uint32_t* texts[kLanes];
+      uint32_t lengths[kLanes];
+      for (int lane = 0; lane < kLanes; lane++) {
+        const Title& title = matcher->titles[searched[i + lane]->title];
+        texts[lane] = matcher->chars.data() + title.begin;
+        lengths[lane] = title.length;
+      }
+      Occurrence best[kLanes];
+      search_lanes(pattern, texts, lengths, best);
+      for (int lane = 0; lane < kLanes; lane++) {
+        searched[i + lane]->occurrences[w] = best[lane];
+      }
+    }
+#endif
+    for (; i < searched.size(); i++) {
+      const Title& title = matcher->titles[searched[i]->title];
+      searched[i]->occurrences[w] =
+          search(pattern, matcher->chars.data() + title.begin, title.length);
+    }
+
+    size_t out = 0;
+    for (Candidate& candidate : candidates) {
+      const Occurrence& occurrence = candidate.occurrences[w];
+      if (occurrence.distance <= pattern.max_distance) {
+        candidate.distance += occurrence.distance;
+        candidates[out++] = candidate;
+      }
+    }
+    candidates.resize(out);
+  }
+
+  for (Candidate& candidate : candidates) {
+    const Title& title = matcher->titles[candidate.title];
+    const uint32_t* text = matcher->chars.data() + title.begin;
+    const Occurrence& occurrence = candidate.occurrences[0];
+    uint32_t start =
+        find_start(backwards[0], text, occurrence.end, occurrence.distance);
+    candidate.at_word_start = start == 0 || text[start - 1] == ' ';
+  }
+
+  auto better = [matcher](const Candidate& a, const Candidate& b) {
+    if (a.distance != b.distance) {
+      return a.distance < b.distance;
+    }
+    if (a.at_word_start != b.at_word_start) {
+      return a.at_word_start;
+    }
+    const Title& ta = matcher->titles[a.title];
+    const Title& tb = matcher->titles[b.title];
+    if (ta.timestamp_ms != tb.timestamp_ms) {
+      return ta.timestamp_ms > tb.timestamp_ms;
+    }
+    return a.title > b.title;
+  };
+  size_t count =
+      limit == 0 ? candidates.size() : std::min(limit, candidates.size());
+  std::partial_sort(candidates.begin(), candidates.begin() + count,
+                    candidates.end(), better);
+
+  // Highlights are only worked out for the titles returned.
+  matches->resize(count);
+  std::vector<std::pair<uint32_t, uint32_t>> spans;
+  for (size_t i = 0; i < count; i++) {
+    const Candidate& candidate = candidates[i];
+    const Title& title = matcher->titles[candidate.title];
+    const uint32_t* text = matcher->chars.data() + title.begin;
+    spans.clear();
+    for (size_t w = 0; w < patterns.size(); w++) {
+      const Occurrence& occurrence = candidate.occurrences[w];
+      uint32_t start =
+          find_start(backwards[w], text, occurrence.end, occurrence.distance);
+      if (start < occurrence.end) {
+        spans.push_back({matcher->starts[title.begin + start],
+                         matcher->ends[title.begin + occurrence.end - 1]});
+      }
+    }
+    std::sort(spans.begin(), spans.end());
+
+    FuzzyMatch& match = (*matches)[i];
+    match.id = title.id;
+    match.distance = candidate.distance;
+    match.ranges.clear();
+    for (const auto& span : spans) {
+      if (!match.ranges.empty() && span.first <= match.ranges.back()) {
+        match.ranges.back() = std::max(match.ranges.back(), span.second);
+      } else {
+        match.ranges.push_back(span.first);
+        match.ranges.push_back(span.second);
+      }
+    }
+  }
+}
+
+FuzzyMatcherStats fuzzy_matcher_get_stats(FuzzyMatcher* matcher) {
+  FuzzyMatcherStats stats = {};
+  stats.titles = matcher->titles.size() - matcher->dead;
+  stats.dead_titles = matcher->dead;
+  stats.folded_chars = matcher->chars.size();
+  return stats;
+}
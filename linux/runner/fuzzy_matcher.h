@@ -0,0 +1,87 @@
+#ifndef RUNNER_FUZZY_MATCHER_H_
+#define RUNNER_FUZZY_MATCHER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// Typo-tolerant matching of short titles, such as research queries.
+//
+// Titles are folded once, when they are put: decomposed, stripped of
+// diacritics and case-folded, so "Zoë Müller" is stored as "zoe muller".
+// Every folded character remembers the UTF-16 range of the character it came
+// from, which lets matches be highlighted in the original text exactly, even
+// where folding changed its length.
+//
+// A needle matches a title when each of its words occurs in the title with
+// at most one edit for words of three to five characters, or two for longer
+// ones; words of one or two characters must occur as they are. Occurrences
+// are found with Myers' bit-parallel edit distance algorithm, run on four
+// titles at once with SSE2.
+typedef struct _FuzzyMatcher FuzzyMatcher;
+
+typedef struct {
+  std::string id;
+  // Edits between the needle's words and the title, summed.
+  uint32_t distance;
+  // Start and end offsets of the matched parts of the title, in UTF-16 code
+  // units of the text given to fuzzy_matcher_put(), sorted and disjoint.
+  std::vector<uint32_t> ranges;
+} FuzzyMatch;
+
+typedef struct {
+  uint64_t titles;
+  uint64_t dead_titles;
+  uint64_t folded_chars;
+} FuzzyMatcherStats;
+
+FuzzyMatcher* fuzzy_matcher_new();
+
+void fuzzy_matcher_free(FuzzyMatcher* matcher);
+
+/**
+ * fuzzy_matcher_put:
+ * @matcher: a #FuzzyMatcher.
+ * @id: the title's record id.
+ * @timestamp_ms: when the record was created, used to order equal matches.
+ * @title: the title as shown, in UTF-8.
+ *
+ * Adds a title, replacing any previous title with the same @id.
+ */
+void fuzzy_matcher_put(FuzzyMatcher* matcher,
+                       const std::string& id,
+                       int64_t timestamp_ms,
+                       const std::string& title);
+
+/**
+ * fuzzy_matcher_remove:
+ * @matcher: a #FuzzyMatcher.
+ * @id: the title's record id.
+ *
+ * Returns: %TRUE if a title was removed.
+ */
+bool fuzzy_matcher_remove(FuzzyMatcher* matcher, const std::string& id);
+
+void fuzzy_matcher_clear(FuzzyMatcher* matcher);
+
+/**
+ * fuzzy_matcher_match:
+ * @matcher: a #FuzzyMatcher.
+ * @needle: the text typed, in UTF-8; folded like the titles.
+ * @limit: the maximum number of matches, or 0 for no limit.
+ * @matches: (out): receives the matching titles, best first.
+ *
+ * Finds the titles matching every word of @needle. Fewer edits rank first,
+ * then titles where the first word matched at the start of a word, then
+ * newer titles. A needle without words matches nothing.
+ */
+void fuzzy_matcher_match(FuzzyMatcher* matcher,
+                         const std::string& needle,
+                         size_t limit,
+                         std::vector<FuzzyMatch>* matches);
+
+FuzzyMatcherStats fuzzy_matcher_get_stats(FuzzyMatcher* matcher);
+
+#endif  // RUNNER_FUZZY_MATCHER_H_
@@ -0,0 +1,101 @@
+#include "gemini_parser_plugin.h"
+
+#include <cstring>
+
+#include "gemini_response_parser.h"
+#include "markdown_document.h"
+
+static constexpr char kChannelName[] = "echolens/gemini_parser";
+
+static constexpr char kParseMethod[] = "parse";
+static constexpr char kMarkdownMethod[] = "markdown";
+
+static constexpr char kBadArgumentsError[] = "Bad Arguments";
+static constexpr char kParseError[] = "Parse Error";
+
+struct _GeminiParserPlugin {
+  GObject parent_instance;
+};
+
+G_DEFINE_TYPE(GeminiParserPlugin, gemini_parser_plugin, G_TYPE_OBJECT)
+
+static FlMethodResponse* parse(FlValue* args) {
+  if (fl_value_get_type(args) != FL_VALUE_TYPE_UINT8_LIST) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        kBadArgumentsError, "Expected the response body as a Uint8List",
+        nullptr));
+  }
+
+  GeminiParseResult result;
+  if (!gemini_response_parse(
+          reinterpret_cast<const char*>(fl_value_get_uint8_list(args)),
+          fl_value_get_length(args), &result)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        kParseError, "Malformed Gemini response", nullptr));
+  }
+
+  std::vector<uint8_t> packed = gemini_response_pack(result);
+  g_autoptr(FlValue) value =
+      fl_value_new_uint8_list(packed.data(), packed.size());
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(value));
+}
+
+// Parses an answer into the flat block and span arrays the answer view
+// builds its widgets from.
+static FlMethodResponse* parse_markdown(FlValue* args) {
+  if (fl_value_get_type(args) != FL_VALUE_TYPE_STRING) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        kBadArgumentsError, "Expected the answer as a String", nullptr));
+  }
+
+  const gchar* markdown = fl_value_get_string(args);
+  MarkdownDocument document;
+  markdown_document_parse(markdown, strlen(markdown), &document);
+
+  std::vector<uint8_t> packed = markdown_document_pack(document);
+  g_autoptr(FlValue) value =
+      fl_value_new_uint8_list(packed.data(), packed.size());
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(value));
+}
+
+// Called when a method call is received from Flutter.
+static void method_call_cb(FlMethodChannel* channel,
+                           FlMethodCall* method_call,
+                           gpointer user_data) {
+  const gchar* method = fl_method_call_get_name(method_call);
+  FlValue* args = fl_method_call_get_args(method_call);
+
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (strcmp(method, kParseMethod) == 0) {
+    response = parse(args);
+  } else if (strcmp(method, kMarkdownMethod) == 0) {
+    response = parse_markdown(args);
+  } else {
+    response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+  }
+
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(method_call, response, &error)) {
+    g_warning("Failed to send method call response: %s", error->message);
+  }
+}
+
+static void gemini_parser_plugin_class_init(GeminiParserPluginClass* klass) {}
+
+static void gemini_parser_plugin_init(GeminiParserPlugin* self) {}
+
+void gemini_parser_plugin_register_with_registrar(
+    FlPluginRegistrar* registrar) {
+  GeminiParserPlugin* plugin = GEMINI_PARSER_PLUGIN(
+      g_object_new(gemini_parser_plugin_get_type(), nullptr));
+
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  g_autoptr(FlMethodChannel) channel =
+      fl_method_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                            kChannelName, FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(channel, method_call_cb,
+                                            g_object_ref(plugin),
+                                            g_object_unref);
+
+  g_object_unref(plugin);
+}
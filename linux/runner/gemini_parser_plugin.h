@@ -0,0 +1,24 @@
+#ifndef RUNNER_GEMINI_PARSER_PLUGIN_H_
+#define RUNNER_GEMINI_PARSER_PLUGIN_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+G_DECLARE_FINAL_TYPE(GeminiParserPlugin,
+                     gemini_parser_plugin,
+                     GEMINI,
+                     PARSER_PLUGIN,
+                     GObject)
+
+/**
+ * gemini_parser_plugin_register_with_registrar:
+ * @registrar: an #FlPluginRegistrar.
+ *
+ * Registers the "echolens/gemini_parser" method channel. Its `parse` method
+ * takes a raw generateContent body as a Uint8List and replies with the packed
+ * answer and sources produced by gemini_response_parse(). `markdown` takes an
+ * answer as a String and replies with the flat document produced by
+ * markdown_document_parse(), which the answer view renders without parsing.
+ */
+void gemini_parser_plugin_register_with_registrar(FlPluginRegistrar* registrar);
+
+#endif  // RUNNER_GEMINI_PARSER_PLUGIN_H_
@@ -0,0 +1,406 @@
+#include "gemini_response_parser.h"
+
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+constexpr size_t kBlockSize = 64;
+
+// Deepest key path stage two cares about: candidates[0].groundingMetadata.
+// groundingChunks[i].web.title.
+constexpr size_t kMaxTrackedDepth = 7;
+
+// Per-block bitmasks produced by the classifier, one bit per input byte.
+struct BlockMasks {
+  uint64_t quote;
+  uint64_t backslash;
+  uint64_t structural;
+};
+
+#if defined(__SSE2__)
+inline uint64_t match_mask(__m128i chunk, char c) {
+  return static_cast<uint32_t>(
+      _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(c))));
+}
+
+BlockMasks classify_block(const uint8_t* block) {
+  BlockMasks masks = {0, 0, 0};
+  for (int lane = 0; lane < 4; lane++) {
+    __m128i chunk = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(block + lane * 16));
+    int shift = lane * 16;
+
+    // Setting bit 5 folds '[' onto '{' and ']' onto '}'.
+    __m128i folded = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+    uint64_t brackets = match_mask(folded, '{') | match_mask(folded, '}');
+
+    masks.quote |= match_mask(chunk, '"') << shift;
+    masks.backslash |= match_mask(chunk, '\\') << shift;
+    masks.structural |=
+        (brackets | match_mask(chunk, ':') | match_mask(chunk, ',')) << shift;
+  }
+  return masks;
+}
+#else
+BlockMasks classify_block(const uint8_t* block) {
+  BlockMasks masks = {0, 0, 0};
+  for (size_t i = 0; i < kBlockSize; i++) {
+    uint64_t bit = uint64_t{1} << i;
+    switch (block[i]) {
+      case '"':
+        masks.quote |= bit;
+        break;
+      case '\\':
+        masks.backslash |= bit;
+        break;
+      case '{':
+      case '}':
+      case '[':
+      case ']':
+      case ':':
+      case ',':
+        masks.structural |= bit;
+        break;
+    }
+  }
+  return masks;
+}
+#endif
+
+// Turns quote positions into a mask that is set from each opening quote up
+// to (not including) its closing quote.
+inline uint64_t prefix_xor(uint64_t bits) {
+  bits ^= bits << 1;
+  bits ^= bits << 2;
+  bits ^= bits << 4;
+  bits ^= bits << 8;
+  bits ^= bits << 16;
+  bits ^= bits << 32;
+  return bits;
+}
+
+// Returns the characters escaped by a backslash, carrying an escape that
+// straddles the block boundary in @next_is_escaped.
+inline uint64_t find_escaped(uint64_t backslash, uint64_t* next_is_escaped) {
+  constexpr uint64_t kEvenBits = 0x5555555555555555ULL;
+
+  backslash &= ~*next_is_escaped;
+  uint64_t follows_escape = (backslash << 1) | *next_is_escaped;
+  uint64_t odd_sequence_starts = backslash & ~kEvenBits & ~follows_escape;
+
+  unsigned long long sequences_starting_on_even_bits;
+  *next_is_escaped = __builtin_uaddll_overflow(
+                         odd_sequence_starts, backslash,
+                         &sequences_starting_on_even_bits)
+                         ? 1
+                         : 0;
+  uint64_t invert_mask = sequences_starting_on_even_bits << 1;
+  return (kEvenBits ^ invert_mask) & follows_escape;
+}
+
+// Stage one: indexes every structural character outside of strings plus both
+// quotes of every string, so the closing quote always follows the opening one.
+bool index_structurals(const uint8_t* data,
+                       size_t length,
+                       std::vector<uint32_t>* indices) {
+  uint64_t next_is_escaped = 0;
+  uint64_t prev_in_string = 0;
+  uint8_t tail[kBlockSize];
+
+  for (size_t offset = 0; offset < length; offset += kBlockSize) {
+    const uint8_t* block = data + offset;
+    if (length - offset < kBlockSize) {
+      memset(tail, ' ', kBlockSize);
+      memcpy(tail, block, length - offset);
+      block = tail;
+    }
+
+    BlockMasks masks = classify_block(block);
+    uint64_t escaped = find_escaped(masks.backslash, &next_is_escaped);
+    uint64_t quotes = masks.quote & ~escaped;
+    uint64_t in_string = prefix_xor(quotes) ^ prev_in_string;
+    prev_in_string =
+        static_cast<uint64_t>(static_cast<int64_t>(in_string) >> 63);
+
+    uint64_t structurals = (masks.structural & ~in_string) | quotes;
+    while (structurals != 0) {
+      indices->push_back(
+          static_cast<uint32_t>(offset + __builtin_ctzll(structurals)));
+      structurals &= structurals - 1;
+    }
+  }
+
+  return prev_in_string == 0;
+}
+
+int hex_value(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+bool read_hex4(const char* p, const char* end, uint32_t* value) {
+  if (end - p < 4) {
+    return false;
+  }
+  uint32_t v = 0;
+  for (int i = 0; i < 4; i++) {
+    int digit = hex_value(p[i]);
+    if (digit < 0) {
+      return false;
+    }
+    v = (v << 4) | static_cast<uint32_t>(digit);
+  }
+  *value = v;
+  return true;
+}
+
+void append_utf8(uint32_t code_point, std::string* out) {
+  if (code_point < 0x80) {
+    *out += static_cast<char>(code_point);
+  } else if (code_point < 0x800) {
+    *out += static_cast<char>(0xC0 | (code_point >> 6));
+    *out += static_cast<char>(0x80 | (code_point & 0x3F));
+  } else if (code_point < 0x10000) {
+    *out += static_cast<char>(0xE0 | (code_point >> 12));
+    *out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+    *out += static_cast<char>(0x80 | (code_point & 0x3F));
+  } else {
+    *out += static_cast<char>(0xF0 | (code_point >> 18));
+    *out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+    *out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+    *out += static_cast<char>(0x80 | (code_point & 0x3F));
+  }
+}
+
+// Appends the unescaped contents of a JSON string (without its quotes).
+bool append_unescaped(const char* p, const char* end, std::string* out) {
+  while (p < end) {
+    const char* backslash =
+        static_cast<const char*>(memchr(p, '\\', end - p));
+    if (backslash == nullptr) {
+      out->append(p, end - p);
+      return true;
+    }
+    out->append(p, backslash - p);
+    p = backslash + 1;
+    if (p >= end) {
+      return false;
+    }
+
+    char c = *p++;
+    switch (c) {
+      case '"':
+      case '\\':
+      case '/':
+        *out += c;
+        break;
+      case 'b':
+        *out += '\b';
+        break;
+      case 'f':
+        *out += '\f';
+        break;
+      case 'n':
+        *out += '\n';
+        break;
+      case 'r':
+        *out += '\r';
+        break;
+      case 't':
+        *out += '\t';
+        break;
+      case 'u': {
+        uint32_t code_point;
+        if (!read_hex4(p, end, &code_point)) {
+          return false;
+        }
+        p += 4;
+        if (code_point >= 0xD800 && code_point < 0xDC00) {
+          uint32_t low;
+          if (end - p >= 6 && p[0] == '\\' && p[1] == 'u' &&
+              read_hex4(p + 2, end, &low) && low >= 0xDC00 && low < 0xE000) {
+            code_point = 0x10000 + ((code_point - 0xD800) << 10) +
+                         (low - 0xDC00);
+            p += 6;
+          } else {
+            code_point = 0xFFFD;
+          }
+        } else if (code_point >= 0xDC00 && code_point < 0xE000) {
+          code_point = 0xFFFD;
+        }
+        append_utf8(code_point, out);
+        break;
+      }
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+struct Frame {
+  bool is_object;
+  bool expect_key;
+  const char* key;
+  size_t key_length;
+  uint32_t index;
+};
+
+bool key_is(const Frame& frame, const char* name) {
+  return frame.is_object && frame.key_length == strlen(name) &&
+         memcmp(frame.key, name, frame.key_length) == 0;
+}
+
+// Stage two: walks the structural indices, following only the key paths that
+// hold the answer text and the grounding sources.
+bool walk_structurals(const char* json,
+                      const std::vector<uint32_t>& indices,
+                      GeminiParseResult* result) {
+  std::vector<Frame> stack;
+  stack.reserve(16);
+  int64_t source_chunk = -1;
+
+  for (size_t i = 0; i < indices.size(); i++) {
+    const char* p = json + indices[i];
+    switch (*p) {
+      case '{':
+      case '[': {
+        Frame frame = {*p == '{', *p == '{', nullptr, 0, 0};
+        stack.push_back(frame);
+        break;
+      }
+      case '}':
+      case ']':
+        if (stack.empty() || stack.back().is_object != (*p == '}')) {
+          return false;
+        }
+        stack.pop_back();
+        break;
+      case ':':
+        if (stack.empty() || !stack.back().is_object) {
+          return false;
+        }
+        stack.back().expect_key = false;
+        break;
+      case ',':
+        if (stack.empty()) {
+          return false;
+        }
+        if (stack.back().is_object) {
+          stack.back().expect_key = true;
+        } else {
+          stack.back().index++;
+        }
+        break;
+      case '"': {
+        if (++i >= indices.size() || json[indices[i]] != '"') {
+          return false;
+        }
+        const char* start = p + 1;
+        const char* end = json + indices[i];
+        if (stack.empty()) {
+          break;
+        }
+        Frame& top = stack.back();
+        if (top.is_object && top.expect_key) {
+          top.key = start;
+          top.key_length = end - start;
+          break;
+        }
+
+        size_t depth = stack.size();
+        if (depth < 6 || depth > kMaxTrackedDepth ||
+            !key_is(stack[0], "candidates") || stack[1].is_object ||
+            stack[1].index != 0) {
+          break;
+        }
+        if (depth == 6 && key_is(stack[2], "content") &&
+            key_is(stack[3], "parts") && !stack[4].is_object &&
+            key_is(stack[5], "text")) {
+          if (!append_unescaped(start, end, &result->answer)) {
+            return false;
+          }
+        } else if (depth == 7 && key_is(stack[2], "groundingMetadata") &&
+                   key_is(stack[3], "groundingChunks") &&
+                   !stack[4].is_object && key_is(stack[5], "web") &&
+                   (key_is(stack[6], "title") || key_is(stack[6], "uri"))) {
+          if (source_chunk != stack[4].index) {
+            source_chunk = stack[4].index;
+            result->sources.push_back(GeminiSource());
+          }
+          GeminiSource& source = result->sources.back();
+          std::string* field =
+              key_is(stack[6], "title") ? &source.title : &source.uri;
+          field->clear();
+          if (!append_unescaped(start, end, field)) {
+            return false;
+          }
+        }
+        break;
+      }
+    }
+  }
+
+  return stack.empty();
+}
+
+void append_u32(uint32_t value, std::vector<uint8_t>* out) {
+  out->push_back(static_cast<uint8_t>(value));
+  out->push_back(static_cast<uint8_t>(value >> 8));
+  out->push_back(static_cast<uint8_t>(value >> 16));
+  out->push_back(static_cast<uint8_t>(value >> 24));
+}
+
+void append_string(const std::string& value, std::vector<uint8_t>* out) {
+  append_u32(static_cast<uint32_t>(value.size()), out);
+  out->insert(out->end(), value.begin(), value.end());
+}
+
+}  // namespace
+
+bool gemini_response_parse(const char* json,
+                           size_t length,
+                           GeminiParseResult* result) {
+  result->answer.clear();
+  result->sources.clear();
+  if (length > UINT32_MAX) {
+    return false;
+  }
+
+  std::vector<uint32_t> indices;
+  indices.reserve(length / 8 + 16);
+  if (!index_structurals(reinterpret_cast<const uint8_t*>(json), length,
+                         &indices)) {
+    return false;
+  }
+  return walk_structurals(json, indices, result);
+}
+
+std::vector<uint8_t> gemini_response_pack(const GeminiParseResult& result) {
+  size_t size = 8 + result.answer.size();
+  for (const GeminiSource& source : result.sources) {
+    size += 8 + source.title.size() + source.uri.size();
+  }
+
+  std::vector<uint8_t> packed;
+  packed.reserve(size);
+  append_string(result.answer, &packed);
+  append_u32(static_cast<uint32_t>(result.sources.size()), &packed);
+  for (const GeminiSource& source : result.sources) {
+    append_string(source.title, &packed);
+    append_string(source.uri, &packed);
+  }
+  return packed;
+}
@@ -0,0 +1,53 @@
+#ifndef RUNNER_GEMINI_RESPONSE_PARSER_H_
+#define RUNNER_GEMINI_RESPONSE_PARSER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// A web source cited in the grounding metadata of a response.
+struct GeminiSource {
+  std::string title;
+  std::string uri;
+};
+
+// The parts of a generateContent response the app actually displays.
+struct GeminiParseResult {
+  std::string answer;
+  std::vector<GeminiSource> sources;
+};
+
+/**
+ * gemini_response_parse:
+ * @json: a generateContent (or streamGenerateContent chunk) response body.
+ * @length: length of @json in bytes.
+ * @result: (out): receives the extracted answer and sources.
+ *
+ * Extracts the text of `candidates[0].content.parts[*]` and the
+ * `web.title`/`web.uri` pairs of
+ * `candidates[0].groundingMetadata.groundingChunks[*]` without building a
+ * document tree. Stage one classifies 64-byte blocks with SIMD to index the
+ * structural characters outside of strings; stage two walks only those
+ * indices while tracking the key path.
+ *
+ * Returns: %FALSE if @json is not well-formed enough to be walked.
+ */
+bool gemini_response_parse(const char* json,
+                           size_t length,
+                           GeminiParseResult* result);
+
+/**
+ * gemini_response_pack:
+ * @result: a parse result.
+ *
+ * Packs @result into the little-endian message decoded on the Dart side by
+ * GeminiService: a u32 answer length and the UTF-8 answer, a u32 source
+ * count, then per source a u32-prefixed title and a u32-prefixed uri.
+ *
+ * Returns: the packed bytes.
+ */
+std::vector<uint8_t> gemini_response_pack(const GeminiParseResult& result);
+
+#endif  // RUNNER_GEMINI_RESPONSE_PARSER_H_
@@ -0,0 +1,774 @@
+#include "gemini_stream_plugin.h"
+
+#include <curl/curl.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "connection_pool.h"
+#include "gemini_response_parser.h"
+#include "request_scheduler.h"
+#include "research_queue.h"
+#include "stream_flights.h"
+
+static constexpr char kChannelName[] = "echolens/gemini_stream";
+static constexpr char kEventChannelName[] = "echolens/gemini_stream/events";
+
+static constexpr char kStartMethod[] = "start";
+static constexpr char kCancelMethod[] = "cancel";
+static constexpr char kEnqueueMethod[] = "enqueue";
+static constexpr char kStatsMethod[] = "stats";
+static constexpr char kPreconnectMethod[] = "preconnect";
+
+static constexpr char kBadArgumentsError[] = "Bad Arguments";
+
+// Requests without a deadline of their own get this one.
+static constexpr int64_t kDefaultDeadlineMs = 120000;
+
+// Queued searches waiting on the API at the same time, unless Dart asks for
+// another limit.
+static constexpr int kDefaultQueueParallelism = 4;
+
+struct _GeminiStreamPlugin {
+  GObject parent_instance;
+
+  FlMethodChannel* channel;
+  FlEventChannel* event_channel;
+  gboolean listening;
+
+  ConnectionPool* pool;
+  RequestScheduler* scheduler;
+  // Streaming requests in flight and the Dart requests on each. A flight's
+  // data is its GCancellable, and it is freed once its terminal event has
+  // been delivered.
+  StreamFlights* flights;
+  // Fires at the earliest deadline of a request that joined a flight due
+  // after it.
+  guint deadline_source;
+  guint64 dedup_hits;
+  // Batch searches, which share the scheduler with interactive ones.
+  ResearchQueue* queue;
+};
+
+G_DEFINE_TYPE(GeminiStreamPlugin, gemini_stream_plugin, G_TYPE_OBJECT)
+
+// A single streaming request, owned by its worker thread.
+typedef struct {
+  GeminiStreamPlugin* self;
+  StreamFlight* flight;
+  std::string url;
+  std::string body;
+  int64_t deadline_us;
+  GCancellable* cancellable;
+} StreamRequest;
+
+// State shared between the data callbacks of one request.
+typedef struct {
+  StreamRequest* request;
+  std::string pending;
+} StreamState;
+
+typedef enum {
+  STREAM_EVENT_STARTED,
+  STREAM_EVENT_DATA,
+  STREAM_EVENT_DONE,
+  STREAM_EVENT_ERROR,
+  STREAM_EVENT_CANCELLED,
+} StreamEventType;
+
+// An event produced on a worker thread, waiting to be sent from the main loop
+// to every subscriber of its flight, or to the queued request @id when there
+// is no flight.
+typedef struct {
+  GeminiStreamPlugin* self;
+  StreamFlight* flight;
+  int64_t id;
+  StreamEventType type;
+  std::vector<uint8_t> packed;
+  long status;
+  // Why an error event failed: "deadline", "transport" or "http".
+  const gchar* reason;
+  std::string message;
+  int64_t retry_after_ms;
+  // Set on terminal events of requests that reached the network.
+  bool has_metrics;
+  ConnectionMetrics metrics;
+} PendingEvent;
+
+static void stream_request_free(StreamRequest* request) {
+  g_object_unref(request->self);
+  g_object_unref(request->cancellable);
+  delete request;
+}
+
+static GCancellable* flight_cancellable(StreamFlight* flight) {
+  return G_CANCELLABLE(flight->data);
+}
+
+// FNV-1a over the url and body, which identify a request completely.
+static std::string request_key(const gchar* url, const gchar* body) {
+  uint64_t hash = 14695981039346656037ull;
+  for (const gchar* text : {url, "\n", body}) {
+    for (const gchar* c = text; *c != '\0'; c++) {
+      hash = (hash ^ static_cast<guchar>(*c)) * 1099511628211ull;
+    }
+  }
+  g_autofree gchar* key =
+      g_strdup_printf("%016" G_GINT64_MODIFIER "x", hash);
+  return key;
+}
+
+static FlValue* new_event(int64_t id, const gchar* type) {
+  FlValue* event = fl_value_new_map();
+  fl_value_set_string_take(event, "id", fl_value_new_int(id));
+  fl_value_set_string_take(event, "type", fl_value_new_string(type));
+  return event;
+}
+
+static FlValue* data_event(int64_t id, const std::vector<uint8_t>& packed) {
+  FlValue* event = new_event(id, "data");
+  fl_value_set_string_take(event, "packed",
+                           fl_value_new_uint8_list(packed.data(),
+                                                   packed.size()));
+  return event;
+}
+
+// Where the time of the last attempt went, in milliseconds.
+static FlValue* metrics_value(const ConnectionMetrics& metrics) {
+  FlValue* value = fl_value_new_map();
+  fl_value_set_string_take(value, "dnsMs",
+                           fl_value_new_int(metrics.dns_us / 1000));
+  fl_value_set_string_take(value, "connectMs",
+                           fl_value_new_int(metrics.connect_us / 1000));
+  fl_value_set_string_take(value, "tlsMs",
+                           fl_value_new_int(metrics.tls_us / 1000));
+  fl_value_set_string_take(value, "ttfbMs",
+                           fl_value_new_int(metrics.ttfb_us / 1000));
+  fl_value_set_string_take(value, "totalMs",
+                           fl_value_new_int(metrics.total_us / 1000));
+  fl_value_set_string_take(value, "reused", fl_value_new_bool(metrics.reused));
+  fl_value_set_string_take(value, "httpVersion",
+                           fl_value_new_int(metrics.http_version));
+  return value;
+}
+
+static FlValue* build_event(PendingEvent* pending, int64_t id) {
+  FlValue* event = nullptr;
+  switch (pending->type) {
+    case STREAM_EVENT_STARTED:
+      return new_event(id, "started");
+    case STREAM_EVENT_DATA:
+      return data_event(id, pending->packed);
+    case STREAM_EVENT_DONE:
+      event = new_event(id, "done");
+      break;
+    case STREAM_EVENT_CANCELLED:
+      return new_event(id, "cancelled");
+    case STREAM_EVENT_ERROR:
+      event = new_event(id, "error");
+      fl_value_set_string_take(event, "status",
+                               fl_value_new_int(pending->status));
+      fl_value_set_string_take(event, "reason",
+                               fl_value_new_string(pending->reason));
+      fl_value_set_string_take(event, "message",
+                               fl_value_new_string(pending->message.c_str()));
+      if (pending->retry_after_ms >= 0) {
+        fl_value_set_string_take(event, "retryAfterMs",
+                                 fl_value_new_int(pending->retry_after_ms));
+      }
+      break;
+  }
+  if (pending->has_metrics) {
+    fl_value_set_string_take(event, "metrics",
+                             metrics_value(pending->metrics));
+  }
+  return event;
+}
+
+static void send_event(GeminiStreamPlugin* self, FlValue* event) {
+  if (self->listening && self->event_channel != nullptr) {
+    g_autoptr(GError) error = nullptr;
+    if (!fl_event_channel_send(self->event_channel, event, nullptr, &error)) {
+      g_warning("Failed to send stream event: %s", error->message);
+    }
+  }
+  fl_value_unref(event);
+}
+
+static PendingEvent* new_pending(StreamEventType type) {
+  PendingEvent* pending = new PendingEvent();
+  pending->type = type;
+  pending->id = 0;
+  pending->status = 0;
+  pending->reason = "";
+  pending->retry_after_ms = -1;
+  pending->has_metrics = false;
+  return pending;
+}
+
+static gboolean deadline_cb(gpointer user_data);
+
+// Schedules deadline_cb() for the earliest deadline of a request that joined
+// a flight due after it, if there is one.
+static void arm_deadline(GeminiStreamPlugin* self) {
+  g_clear_handle_id(&self->deadline_source, g_source_remove);
+  int64_t deadline_us = stream_flights_next_deadline(self->flights);
+  if (deadline_us == INT64_MAX) {
+    return;
+  }
+  int64_t delay_ms = (deadline_us - g_get_monotonic_time() + 999) / 1000;
+  self->deadline_source =
+      g_timeout_add(std::max<int64_t>(delay_ms, 0), deadline_cb, self);
+}
+
+// Fails the requests whose own deadline has passed while the flight they
+// joined goes on, and cancels the flights nobody waits for any more.
+static gboolean deadline_cb(gpointer user_data) {
+  GeminiStreamPlugin* self = GEMINI_STREAM_PLUGIN(user_data);
+  self->deadline_source = 0;
+
+  std::vector<int64_t> expired;
+  std::vector<StreamFlight*> abandoned;
+  stream_flights_expire(self->flights, g_get_monotonic_time(), &expired,
+                        &abandoned);
+  for (int64_t id : expired) {
+    PendingEvent* pending = new_pending(STREAM_EVENT_ERROR);
+    pending->reason = "deadline";
+    pending->message = "Deadline exceeded";
+    send_event(self, build_event(pending, id));
+    delete pending;
+  }
+  for (StreamFlight* flight : abandoned) {
+    g_cancellable_cancel(flight_cancellable(flight));
+  }
+
+  arm_deadline(self);
+  return G_SOURCE_REMOVE;
+}
+
+// Sends an event to every subscriber on the main thread.
+static gboolean deliver_event_cb(gpointer user_data) {
+  PendingEvent* pending = static_cast<PendingEvent*>(user_data);
+  GeminiStreamPlugin* self = pending->self;
+  StreamFlight* flight = pending->flight;
+
+  if (flight == nullptr) {
+    send_event(self, build_event(pending, pending->id));
+    g_object_unref(pending->self);
+    delete pending;
+    return G_SOURCE_REMOVE;
+  }
+  for (int64_t id : flight->subscribers) {
+    send_event(self, build_event(pending, id));
+  }
+  if (pending->type == STREAM_EVENT_DATA) {
+    flight->chunks.push_back(std::move(pending->packed));
+  } else {
+    g_object_unref(flight_cancellable(flight));
+    stream_flights_finish(self->flights, flight);
+    arm_deadline(self);
+  }
+
+  g_object_unref(pending->self);
+  delete pending;
+  return G_SOURCE_REMOVE;
+}
+
+// Queues an event for delivery on the main thread. Events of one request
+// keep their order because they share the default main context.
+static void post_event(StreamRequest* request, PendingEvent* pending) {
+  pending->self = GEMINI_STREAM_PLUGIN(g_object_ref(request->self));
+  pending->flight = request->flight;
+  g_main_context_invoke(nullptr, deliver_event_cb, pending);
+}
+
+static void post_queue_event(GeminiStreamPlugin* self,
+                             int64_t id,
+                             PendingEvent* pending) {
+  pending->self = GEMINI_STREAM_PLUGIN(g_object_ref(self));
+  pending->flight = nullptr;
+  pending->id = id;
+  g_main_context_invoke(nullptr, deliver_event_cb, pending);
+}
+
+// The terminal event for a request that ended with @result.
+static PendingEvent* result_event(const ScheduledResult& result) {
+  PendingEvent* pending = nullptr;
+  switch (result.outcome) {
+    case SCHEDULED_REQUEST_OK:
+      pending = new_pending(STREAM_EVENT_DONE);
+      break;
+    case SCHEDULED_REQUEST_CANCELLED:
+      pending = new_pending(STREAM_EVENT_CANCELLED);
+      break;
+    case SCHEDULED_REQUEST_DEADLINE:
+      pending = new_pending(STREAM_EVENT_ERROR);
+      pending->reason = "deadline";
+      break;
+    case SCHEDULED_REQUEST_TRANSPORT_ERROR:
+      pending = new_pending(STREAM_EVENT_ERROR);
+      pending->reason = "transport";
+      break;
+    case SCHEDULED_REQUEST_HTTP_ERROR:
+      pending = new_pending(STREAM_EVENT_ERROR);
+      pending->reason = "http";
+      pending->status = result.status;
+      break;
+  }
+  if (pending->type == STREAM_EVENT_ERROR) {
+    pending->message = result.message;
+    if (result.retry_after_us >= 0) {
+      pending->retry_after_ms = result.retry_after_us / 1000;
+    }
+  }
+  if (pending->type != STREAM_EVENT_CANCELLED && result.attempts > 0) {
+    pending->has_metrics = true;
+    pending->metrics = result.metrics;
+  }
+  return pending;
+}
+
+// Dispatches one complete server-sent event block. Only `data:` fields are
+// relevant; comments, `event:` and `id:` lines are ignored.
+static void dispatch_sse_block(StreamState* state, const std::string& block) {
+  std::string data;
+  size_t start = 0;
+  while (start < block.size()) {
+    size_t end = block.find('\n', start);
+    if (end == std::string::npos) {
+      end = block.size();
+    }
+    if (block.compare(start, 5, "data:") == 0) {
+      size_t value = start + 5;
+      if (value < end && block[value] == ' ') {
+        value++;
+      }
+      if (!data.empty()) {
+        data += '\n';
+      }
+      data.append(block, value, end - value);
+    }
+    start = end + 1;
+  }
+  if (data.empty() || data == "[DONE]") {
+    return;
+  }
+
+  // Each chunk is parsed here so Dart only decodes the packed answer delta
+  // and sources instead of a JSON tree.
+  GeminiParseResult result;
+  if (!gemini_response_parse(data.data(), data.size(), &result)) {
+    g_warning("Skipping malformed stream chunk");
+    return;
+  }
+  PendingEvent* pending = new_pending(STREAM_EVENT_DATA);
+  pending->packed = gemini_response_pack(result);
+  post_event(state->request, pending);
+}
+
+// Receives the body of a successful response as it arrives.
+static size_t data_cb(const char* data, size_t length, void* user_data) {
+  StreamState* state = static_cast<StreamState*>(user_data);
+
+  // Carriage returns are dropped so that blocks always end in "\n\n".
+  for (size_t i = 0; i < length; i++) {
+    if (data[i] != '\r') {
+      state->pending += data[i];
+    }
+  }
+
+  size_t boundary;
+  while ((boundary = state->pending.find("\n\n")) != std::string::npos) {
+    dispatch_sse_block(state, state->pending.substr(0, boundary));
+    state->pending.erase(0, boundary + 2);
+  }
+
+  return length;
+}
+
+// Runs one request to completion on a worker thread. The scheduler waits for
+// the rate limiter and retries rate limits and server errors.
+static void stream_thread_cb(GTask* task,
+                             gpointer source_object,
+                             gpointer task_data,
+                             GCancellable* cancellable) {
+  StreamRequest* request = static_cast<StreamRequest*>(task_data);
+
+  StreamState state;
+  state.request = request;
+
+  ScheduledRequest scheduled;
+  scheduled.url = request->url;
+  scheduled.body = request->body;
+  scheduled.headers = {"Content-Type: application/json",
+                       "Accept: text/event-stream"};
+  scheduled.deadline_us = request->deadline_us;
+  scheduled.cancellable = request->cancellable;
+  scheduled.on_data = data_cb;
+  scheduled.user_data = &state;
+
+  ScheduledResult result;
+  request_scheduler_perform(request->self->scheduler, scheduled, &result);
+
+  // A final block without a trailing blank line is still an event.
+  if (result.outcome == SCHEDULED_REQUEST_OK && !state.pending.empty()) {
+    dispatch_sse_block(&state, state.pending);
+  }
+  post_event(request, result_event(result));
+
+  g_task_return_boolean(task, TRUE);
+}
+
+// Reports the progress of a queued request, on a queue worker thread. A
+// queued request reads the whole answer at once and delivers it as a single
+// data event, so that Dart consumes it like a stream.
+static void queue_item_cb(const ResearchItemUpdate& update,
+                          gpointer user_data) {
+  GeminiStreamPlugin* self = GEMINI_STREAM_PLUGIN(user_data);
+
+  switch (update.state) {
+    case RESEARCH_ITEM_STARTED:
+      post_queue_event(self, update.id, new_pending(STREAM_EVENT_STARTED));
+      return;
+    case RESEARCH_ITEM_DONE: {
+      GeminiParseResult result;
+      if (!gemini_response_parse(update.body.data(), update.body.size(),
+                                 &result)) {
+        PendingEvent* pending = new_pending(STREAM_EVENT_ERROR);
+        pending->reason = "transport";
+        pending->message = "Malformed response";
+        post_queue_event(self, update.id, pending);
+        return;
+      }
+      PendingEvent* pending = new_pending(STREAM_EVENT_DATA);
+      pending->packed = gemini_response_pack(result);
+      post_queue_event(self, update.id, pending);
+      break;
+    }
+    case RESEARCH_ITEM_CANCELLED:
+      // Possibly before it started, without a result.
+      post_queue_event(self, update.id, new_pending(STREAM_EVENT_CANCELLED));
+      return;
+    case RESEARCH_ITEM_FAILED:
+      break;
+  }
+  post_queue_event(self, update.id, result_event(update.result));
+}
+
+static FlMethodResponse* start_stream(GeminiStreamPlugin* self, FlValue* args) {
+  FlValue* id_value = nullptr;
+  FlValue* url_value = nullptr;
+  FlValue* body_value = nullptr;
+  FlValue* deadline_value = nullptr;
+  if (fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    id_value = fl_value_lookup_string(args, "id");
+    url_value = fl_value_lookup_string(args, "url");
+    body_value = fl_value_lookup_string(args, "body");
+    deadline_value = fl_value_lookup_string(args, "deadlineMs");
+  }
+  if (id_value == nullptr || fl_value_get_type(id_value) != FL_VALUE_TYPE_INT ||
+      url_value == nullptr ||
+      fl_value_get_type(url_value) != FL_VALUE_TYPE_STRING ||
+      body_value == nullptr ||
+      fl_value_get_type(body_value) != FL_VALUE_TYPE_STRING) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        kBadArgumentsError, "Expected id, url and body", nullptr));
+  }
+
+  int64_t id = fl_value_get_int(id_value);
+  const gchar* url = fl_value_get_string(url_value);
+  const gchar* body = fl_value_get_string(body_value);
+  int64_t deadline_ms =
+      deadline_value != nullptr &&
+              fl_value_get_type(deadline_value) == FL_VALUE_TYPE_INT &&
+              fl_value_get_int(deadline_value) > 0
+          ? fl_value_get_int(deadline_value)
+          : kDefaultDeadlineMs;
+  int64_t deadline_us = g_get_monotonic_time() + deadline_ms * 1000;
+
+  // A request joining a flight is owed the chunks so far, and keeps its own
+  // deadline while the flight goes on.
+  bool joined = false;
+  StreamFlight* flight = stream_flights_subscribe(
+      self->flights, request_key(url, body), id, deadline_us, &joined);
+  if (joined) {
+    self->dedup_hits++;
+    for (const std::vector<uint8_t>& chunk : flight->chunks) {
+      send_event(self, data_event(id, chunk));
+    }
+    arm_deadline(self);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+  }
+  flight->data = g_cancellable_new();
+
+  StreamRequest* request = new StreamRequest();
+  request->self = GEMINI_STREAM_PLUGIN(g_object_ref(self));
+  request->flight = flight;
+  request->url = url;
+  request->body = body;
+  request->deadline_us = flight->deadline_us;
+  request->cancellable =
+      G_CANCELLABLE(g_object_ref(flight_cancellable(flight)));
+
+  g_autoptr(GTask) task = g_task_new(self, request->cancellable, nullptr,
+                                     nullptr);
+  g_task_set_task_data(task, request,
+                       reinterpret_cast<GDestroyNotify>(stream_request_free));
+  g_task_run_in_thread(task, stream_thread_cb);
+
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+}
+
+// Queues requests behind each other, at most "parallelism" of them waiting on
+// the API at a time. Each is answered like a stream under its own id, with a
+// "started" event once it leaves the queue; its deadline runs from then.
+static FlMethodResponse* enqueue(GeminiStreamPlugin* self, FlValue* args) {
+  FlValue* requests = nullptr;
+  if (fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    requests = fl_value_lookup_string(args, "requests");
+  }
+  if (requests == nullptr ||
+      fl_value_get_type(requests) != FL_VALUE_TYPE_LIST) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        kBadArgumentsError, "Expected requests", nullptr));
+  }
+
+  std::vector<ResearchItem> items;
+  for (size_t i = 0; i < fl_value_get_length(requests); i++) {
+    FlValue* request = fl_value_get_list_value(requests, i);
+    FlValue* id_value = nullptr;
+    FlValue* url_value = nullptr;
+    FlValue* body_value = nullptr;
+    FlValue* deadline_value = nullptr;
+    if (fl_value_get_type(request) == FL_VALUE_TYPE_MAP) {
+      id_value = fl_value_lookup_string(request, "id");
+      url_value = fl_value_lookup_string(request, "url");
+      body_value = fl_value_lookup_string(request, "body");
+      deadline_value = fl_value_lookup_string(request, "deadlineMs");
+    }
+    if (id_value == nullptr ||
+        fl_value_get_type(id_value) != FL_VALUE_TYPE_INT ||
+        url_value == nullptr ||
+        fl_value_get_type(url_value) != FL_VALUE_TYPE_STRING ||
+        body_value == nullptr ||
+        fl_value_get_type(body_value) != FL_VALUE_TYPE_STRING) {
+      return FL_METHOD_RESPONSE(fl_method_error_response_new(
+          kBadArgumentsError, "Expected id, url and body for every request",
+          nullptr));
+    }
+    int64_t deadline_ms =
+        deadline_value != nullptr &&
+                fl_value_get_type(deadline_value) == FL_VALUE_TYPE_INT &&
+                fl_value_get_int(deadline_value) > 0
+            ? fl_value_get_int(deadline_value)
+            : kDefaultDeadlineMs;
+
+    ResearchItem item;
+    item.id = fl_value_get_int(id_value);
+    item.url = fl_value_get_string(url_value);
+    item.body = fl_value_get_string(body_value);
+    item.timeout_us = deadline_ms * 1000;
+    items.push_back(item);
+  }
+
+  FlValue* parallelism = fl_value_lookup_string(args, "parallelism");
+  if (parallelism != nullptr &&
+      fl_value_get_type(parallelism) == FL_VALUE_TYPE_INT &&
+      fl_value_get_int(parallelism) > 0) {
+    research_queue_set_max_parallel(self->queue,
+                                    fl_value_get_int(parallelism));
+  }
+  for (const ResearchItem& item : items) {
+    research_queue_push(self->queue, item);
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+}
+
+// Drops one request from its flight. The upstream request is only cancelled
+// once nobody is waiting for it.
+static FlMethodResponse* cancel_stream(GeminiStreamPlugin* self,
+                                       FlValue* args) {
+  FlValue* id_value = nullptr;
+  if (fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    id_value = fl_value_lookup_string(args, "id");
+  }
+  if (id_value == nullptr || fl_value_get_type(id_value) != FL_VALUE_TYPE_INT) {
+    return FL_METHOD_RESPONSE(
+        fl_method_error_response_new(kBadArgumentsError, "Expected id",
+                                     nullptr));
+  }
+
+  int64_t id = fl_value_get_int(id_value);
+  StreamFlight* flight = stream_flights_unsubscribe(self->flights, id);
+  if (flight != nullptr) {
+    send_event(self, new_event(id, "cancelled"));
+    if (flight->subscribers.empty()) {
+      g_cancellable_cancel(flight_cancellable(flight));
+    }
+    arm_deadline(self);
+  } else {
+    // Queued requests report their own cancellation.
+    research_queue_cancel(self->queue, id);
+  }
+
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+}
+
+// Warms a connection to the API host before the user submits a search.
+static FlMethodResponse* preconnect(GeminiStreamPlugin* self, FlValue* args) {
+  FlValue* url_value = nullptr;
+  if (fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    url_value = fl_value_lookup_string(args, "url");
+  }
+  if (url_value == nullptr ||
+      fl_value_get_type(url_value) != FL_VALUE_TYPE_STRING) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        kBadArgumentsError, "Expected url", nullptr));
+  }
+
+  connection_pool_preconnect(self->pool, fl_value_get_string(url_value));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+}
+
+static FlMethodResponse* get_stats(GeminiStreamPlugin* self) {
+  RequestSchedulerStats stats = request_scheduler_get_stats(self->scheduler);
+  ConnectionPoolStats pool_stats = connection_pool_get_stats(self->pool);
+  g_autoptr(FlValue) result = fl_value_new_map();
+  fl_value_set_string_take(result, "requests",
+                           fl_value_new_int(stats.requests));
+  fl_value_set_string_take(result, "attempts",
+                           fl_value_new_int(stats.attempts));
+  fl_value_set_string_take(result, "retries", fl_value_new_int(stats.retries));
+  fl_value_set_string_take(result, "throttleWaits",
+                           fl_value_new_int(stats.throttle_waits));
+  fl_value_set_string_take(result, "throttleWaitMs",
+                           fl_value_new_int(stats.throttle_wait_ms));
+  fl_value_set_string_take(result, "deadlineExceeded",
+                           fl_value_new_int(stats.deadline_exceeded));
+  fl_value_set_string_take(result, "dedupHits",
+                           fl_value_new_int(self->dedup_hits));
+  fl_value_set_string_take(result, "inFlight",
+                           fl_value_new_int(stream_flights_in_flight(self->flights)));
+  fl_value_set_string_take(result, "transfers",
+                           fl_value_new_int(pool_stats.transfers));
+  fl_value_set_string_take(result, "reusedConnections",
+                           fl_value_new_int(pool_stats.reused));
+  fl_value_set_string_take(result, "preconnects",
+                           fl_value_new_int(pool_stats.preconnects));
+  fl_value_set_string_take(result, "preconnectsSkipped",
+                           fl_value_new_int(pool_stats.preconnects_skipped));
+  fl_value_set_string_take(result, "handshakeMs",
+                           fl_value_new_int(pool_stats.handshake_ms));
+  ResearchQueueStats queue_stats = research_queue_get_stats(self->queue);
+  fl_value_set_string_take(result, "queued",
+                           fl_value_new_int(queue_stats.queued));
+  fl_value_set_string_take(result, "queueRunning",
+                           fl_value_new_int(queue_stats.running));
+  fl_value_set_string_take(result, "queuePeakRunning",
+                           fl_value_new_int(queue_stats.peak_running));
+  fl_value_set_string_take(result, "queueDone",
+                           fl_value_new_int(queue_stats.done));
+  fl_value_set_string_take(result, "queueFailed",
+                           fl_value_new_int(queue_stats.failed));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Called when a method call is received from Flutter.
+static void method_call_cb(FlMethodChannel* channel,
+                           FlMethodCall* method_call,
+                           gpointer user_data) {
+  GeminiStreamPlugin* self = GEMINI_STREAM_PLUGIN(user_data);
+  const gchar* method = fl_method_call_get_name(method_call);
+  FlValue* args = fl_method_call_get_args(method_call);
+
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (strcmp(method, kStartMethod) == 0) {
+    response = start_stream(self, args);
+  } else if (strcmp(method, kEnqueueMethod) == 0) {
+    response = enqueue(self, args);
+  } else if (strcmp(method, kCancelMethod) == 0) {
+    response = cancel_stream(self, args);
+  } else if (strcmp(method, kPreconnectMethod) == 0) {
+    response = preconnect(self, args);
+  } else if (strcmp(method, kStatsMethod) == 0) {
+    response = get_stats(self);
+  } else {
+    response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+  }
+
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(method_call, response, &error)) {
+    g_warning("Failed to send method call response: %s", error->message);
+  }
+}
+
+static FlMethodErrorResponse* listen_cb(FlEventChannel* channel,
+                                        FlValue* args,
+                                        gpointer user_data) {
+  GEMINI_STREAM_PLUGIN(user_data)->listening = TRUE;
+  return nullptr;
+}
+
+static FlMethodErrorResponse* cancel_cb(FlEventChannel* channel,
+                                        FlValue* args,
+                                        gpointer user_data) {
+  GEMINI_STREAM_PLUGIN(user_data)->listening = FALSE;
+  return nullptr;
+}
+
+static void gemini_stream_plugin_dispose(GObject* object) {
+  GeminiStreamPlugin* self = GEMINI_STREAM_PLUGIN(object);
+
+  g_clear_object(&self->channel);
+  g_clear_object(&self->event_channel);
+  g_clear_handle_id(&self->deadline_source, g_source_remove);
+  g_clear_pointer(&self->flights, stream_flights_free);
+  g_clear_pointer(&self->queue, research_queue_free);
+  g_clear_pointer(&self->scheduler, request_scheduler_free);
+  g_clear_pointer(&self->pool, connection_pool_free);
+
+  G_OBJECT_CLASS(gemini_stream_plugin_parent_class)->dispose(object);
+}
+
+static void gemini_stream_plugin_class_init(GeminiStreamPluginClass* klass) {
+  G_OBJECT_CLASS(klass)->dispose = gemini_stream_plugin_dispose;
+}
+
+static void gemini_stream_plugin_init(GeminiStreamPlugin* self) {
+  self->pool = connection_pool_new(kGeminiPoolOptions);
+  self->scheduler = request_scheduler_new(kGeminiSchedulerOptions, self->pool);
+  self->queue = research_queue_new(self->scheduler, kDefaultQueueParallelism,
+                                   queue_item_cb, self);
+  self->flights = stream_flights_new();
+}
+
+static GeminiStreamPlugin* gemini_stream_plugin_new(FlBinaryMessenger* messenger) {
+  GeminiStreamPlugin* self = GEMINI_STREAM_PLUGIN(
+      g_object_new(gemini_stream_plugin_get_type(), nullptr));
+
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  self->channel =
+      fl_method_channel_new(messenger, kChannelName, FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(self->channel, method_call_cb,
+                                            g_object_ref(self),
+                                            g_object_unref);
+
+  self->event_channel = fl_event_channel_new(messenger, kEventChannelName,
+                                             FL_METHOD_CODEC(codec));
+  fl_event_channel_set_stream_handlers(self->event_channel, listen_cb,
+                                       cancel_cb, g_object_ref(self),
+                                       g_object_unref);
+
+  return self;
+}
+
+void gemini_stream_plugin_register_with_registrar(
+    FlPluginRegistrar* registrar) {
+  curl_global_init(CURL_GLOBAL_DEFAULT);
+
+  GeminiStreamPlugin* plugin =
+      gemini_stream_plugin_new(fl_plugin_registrar_get_messenger(registrar));
+  g_object_unref(plugin);
+}
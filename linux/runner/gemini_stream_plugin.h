@@ -0,0 +1,32 @@
+#ifndef RUNNER_GEMINI_STREAM_PLUGIN_H_
+#define RUNNER_GEMINI_STREAM_PLUGIN_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+G_DECLARE_FINAL_TYPE(GeminiStreamPlugin,
+                     gemini_stream_plugin,
+                     GEMINI,
+                     STREAM_PLUGIN,
+                     GObject)
+
+/**
+ * gemini_stream_plugin_register_with_registrar:
+ * @registrar: an #FlPluginRegistrar.
+ *
+ * Registers the native streaming Gemini client. Dart starts a request on the
+ * "echolens/gemini_stream" method channel and receives every server-sent
+ * event of the `:streamGenerateContent` response, already reduced to a packed
+ * answer delta and sources, on the "echolens/gemini_stream/events" event
+ * channel as soon as it arrives.
+ *
+ * Requests go through a #RequestScheduler that rate limits them, honours
+ * Retry-After and retries 429 and 5xx responses within each request's
+ * "deadlineMs". A request identical to one still in flight joins it rather
+ * than calling the API again. They share pooled HTTP/2 connections, and
+ * "preconnect" opens one ahead of the first request. Terminal events carry
+ * the DNS, connect, TLS, first byte and total times of the last attempt;
+ * "stats" reports the scheduler's and the pool's counters.
+ */
+void gemini_stream_plugin_register_with_registrar(FlPluginRegistrar* registrar);
+
+#endif  // RUNNER_GEMINI_STREAM_PLUGIN_H_
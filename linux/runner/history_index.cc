@@ -0,0 +1,377 @@
+#include "history_index.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+
+constexpr int kFieldCount = 3;
+constexpr int kFieldBits = 3;
+constexpr uint32_t kFieldMask = (1 << kFieldBits) - 1;
+
+// Posting lists are only rewritten once this many records have died, so a
+// handful of deletes in a small history never triggers a rebuild.
+constexpr size_t kMinDeadForCompaction = 256;
+
+struct Record {
+  std::string id;
+  int64_t timestamp_ms;
+  // Indexed by field bit position: query, answer, sources.
+  std::string text[kFieldCount];
+  bool live;
+};
+
+struct PostingList {
+  std::vector<uint8_t> bytes;
+  uint32_t last;
+  uint32_t count;
+};
+
+struct Posting {
+  uint32_t record;
+  uint32_t fields;
+};
+
+struct Occurrence {
+  uint32_t trigram;
+  uint32_t fields;
+};
+
+uint32_t trigram_at(const std::string& text, size_t i) {
+  return static_cast<uint32_t>(static_cast<uint8_t>(text[i])) << 16 |
+         static_cast<uint32_t>(static_cast<uint8_t>(text[i + 1])) << 8 |
+         static_cast<uint32_t>(static_cast<uint8_t>(text[i + 2]));
+}
+
+void append_varint(std::vector<uint8_t>* out, uint64_t value) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<uint8_t>(value) | 0x80);
+    value >>= 7;
+  }
+  out->push_back(static_cast<uint8_t>(value));
+}
+
+uint64_t read_varint(const uint8_t** p) {
+  uint64_t value = 0;
+  int shift = 0;
+  uint8_t byte;
+  do {
+    byte = *(*p)++;
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  return value;
+}
+
+void append_posting(PostingList* list, uint32_t record, uint32_t fields) {
+  uint32_t delta = list->count == 0 ? record : record - list->last;
+  append_varint(&list->bytes, static_cast<uint64_t>(delta) << kFieldBits |
+                                  fields);
+  list->last = record;
+  list->count++;
+}
+
+// Calls @visit(record, fields) for every posting of @list, in record order.
+template <typename Visit>
+void for_each_posting(const PostingList& list, Visit visit) {
+  const uint8_t* p = list.bytes.data();
+  uint32_t record = 0;
+  for (uint32_t i = 0; i < list.count; i++) {
+    uint64_t value = read_varint(&p);
+    record += static_cast<uint32_t>(value >> kFieldBits);
+    visit(record, static_cast<uint32_t>(value) & kFieldMask);
+  }
+}
+
+// Appends every trigram of @text, tagged with @field.
+void collect_trigrams(const std::string& text,
+                      uint32_t field,
+                      std::vector<Occurrence>* trigrams) {
+  for (size_t i = 0; i + 3 <= text.size(); i++) {
+    trigrams->push_back({trigram_at(text, i), field});
+  }
+}
+
+// Sorts @trigrams and merges duplicates, OR-ing their fields.
+void sort_and_merge(std::vector<Occurrence>* trigrams) {
+  std::sort(trigrams->begin(), trigrams->end(),
+            [](const Occurrence& a, const Occurrence& b) {
+              return a.trigram < b.trigram;
+            });
+  size_t out = 0;
+  for (size_t i = 0; i < trigrams->size(); i++) {
+    if (out > 0 && (*trigrams)[out - 1].trigram == (*trigrams)[i].trigram) {
+      (*trigrams)[out - 1].fields |= (*trigrams)[i].fields;
+    } else {
+      (*trigrams)[out++] = (*trigrams)[i];
+    }
+  }
+  trigrams->resize(out);
+}
+
+uint32_t rank(const Record& record,
+              const std::string& needle,
+              uint32_t fields) {
+  uint32_t score = 0;
+  if (fields & HISTORY_INDEX_FIELD_QUERY) {
+    score |= 4;
+    if (record.text[0].compare(0, needle.size(), needle) == 0) {
+      score |= 8;
+    }
+  }
+  if (fields & HISTORY_INDEX_FIELD_SOURCES) {
+    score |= 2;
+  }
+  if (fields & HISTORY_INDEX_FIELD_ANSWER) {
+    score |= 1;
+  }
+  return score;
+}
+
+}  // namespace
+
+struct _HistoryIndex {
+  // Indexed by record number; dead records keep their slot until compaction.
+  std::vector<Record> records;
+  std::unordered_map<std::string, uint32_t> by_id;
+  // Keyed by the three bytes of the trigram.
+  std::unordered_map<uint32_t, PostingList> postings;
+  size_t dead;
+};
+
+// Renumbers the live records densely and rewrites every posting list without
+// the dead ones.
+static void compact(HistoryIndex* index) {
+  std::vector<uint32_t> renumbered(index->records.size(), UINT32_MAX);
+  std::vector<Record> live;
+  live.reserve(index->records.size() - index->dead);
+  for (size_t i = 0; i < index->records.size(); i++) {
+    if (index->records[i].live) {
+      renumbered[i] = static_cast<uint32_t>(live.size());
+      index->by_id[index->records[i].id] = renumbered[i];
+      live.push_back(std::move(index->records[i]));
+    }
+  }
+  index->records = std::move(live);
+  index->dead = 0;
+
+  for (auto it = index->postings.begin(); it != index->postings.end();) {
+    PostingList rewritten = {};
+    for_each_posting(it->second, [&](uint32_t record, uint32_t fields) {
+      if (renumbered[record] != UINT32_MAX) {
+        append_posting(&rewritten, renumbered[record], fields);
+      }
+    });
+    if (rewritten.count == 0) {
+      it = index->postings.erase(it);
+    } else {
+      rewritten.bytes.shrink_to_fit();
+      it->second = std::move(rewritten);
+      ++it;
+    }
+  }
+}
+
+// Returns the live records whose fields contain every trigram of @needle,
+// with the fields that might contain @needle itself.
+static std::vector<Posting> candidates(HistoryIndex* index,
+                                       const std::string& needle) {
+  std::vector<Occurrence> trigrams;
+  collect_trigrams(needle, 0, &trigrams);
+  sort_and_merge(&trigrams);
+
+  std::vector<const PostingList*> lists;
+  for (const Occurrence& trigram : trigrams) {
+    auto it = index->postings.find(trigram.trigram);
+    if (it == index->postings.end()) {
+      return {};
+    }
+    lists.push_back(&it->second);
+  }
+  // Intersect starting from the rarest trigram to keep the candidate set small.
+  std::sort(lists.begin(), lists.end(),
+            [](const PostingList* a, const PostingList* b) {
+              return a->count < b->count;
+            });
+
+  std::vector<Posting> result;
+  result.reserve(lists[0]->count);
+  for_each_posting(*lists[0], [&](uint32_t record, uint32_t fields) {
+    if (index->records[record].live) {
+      result.push_back({record, fields});
+    }
+  });
+  for (size_t i = 1; i < lists.size() && !result.empty(); i++) {
+    size_t in = 0;
+    size_t out = 0;
+    for_each_posting(*lists[i], [&](uint32_t record, uint32_t fields) {
+      while (in < result.size() && result[in].record < record) {
+        in++;
+      }
+      if (in < result.size() && result[in].record == record) {
+        uint32_t common = result[in].fields & fields;
+        if (common != 0) {
+          result[out++] = {record, common};
+        }
+        in++;
+      }
+    });
+    result.resize(out);
+  }
+  return result;
+}
+
+HistoryIndex* history_index_new() {
+  HistoryIndex* index = new HistoryIndex();
+  index->dead = 0;
+  return index;
+}
+
+void history_index_free(HistoryIndex* index) {
+  delete index;
+}
+
+void history_index_put(HistoryIndex* index,
+                       const std::string& id,
+                       int64_t timestamp_ms,
+                       const std::string& query,
+                       const std::string& answer,
+                       const std::string& sources) {
+  history_index_remove(index, id);
+
+  uint32_t number = static_cast<uint32_t>(index->records.size());
+  Record record;
+  record.id = id;
+  record.timestamp_ms = timestamp_ms;
+  record.text[0] = query;
+  record.text[1] = answer;
+  record.text[2] = sources;
+  record.live = true;
+
+  std::vector<Occurrence> trigrams;
+  trigrams.reserve(query.size() + answer.size() + sources.size());
+  collect_trigrams(query, HISTORY_INDEX_FIELD_QUERY, &trigrams);
+  collect_trigrams(answer, HISTORY_INDEX_FIELD_ANSWER, &trigrams);
+  collect_trigrams(sources, HISTORY_INDEX_FIELD_SOURCES, &trigrams);
+  sort_and_merge(&trigrams);
+  for (const Occurrence& trigram : trigrams) {
+    append_posting(&index->postings[trigram.trigram], number, trigram.fields);
+  }
+
+  index->records.push_back(std::move(record));
+  index->by_id[id] = number;
+}
+
+bool history_index_remove(HistoryIndex* index, const std::string& id) {
+  auto it = index->by_id.find(id);
+  if (it == index->by_id.end()) {
+    return false;
+  }
+  Record& record = index->records[it->second];
+  record.live = false;
+  for (std::string& text : record.text) {
+    std::string().swap(text);
+  }
+  index->by_id.erase(it);
+  index->dead++;
+
+  if (index->dead >= kMinDeadForCompaction &&
+      index->dead > index->records.size() - index->dead) {
+    compact(index);
+  }
+  return true;
+}
+
+void history_index_clear(HistoryIndex* index) {
+  index->records.clear();
+  index->by_id.clear();
+  index->postings.clear();
+  index->dead = 0;
+}
+
+void history_index_search(HistoryIndex* index,
+                          const std::string& needle,
+                          size_t limit,
+                          std::vector<HistoryIndexHit>* hits) {
+  std::vector<Posting> matches;
+  if (needle.size() >= 3) {
+    // Trigrams only say the bytes occur somewhere in the field; confirm the
+    // needle really is a substring.
+    for (const Posting& candidate : candidates(index, needle)) {
+      const Record& record = index->records[candidate.record];
+      uint32_t fields = 0;
+      for (int f = 0; f < kFieldCount; f++) {
+        if ((candidate.fields & (1u << f)) &&
+            record.text[f].find(needle) != std::string::npos) {
+          fields |= 1u << f;
+        }
+      }
+      if (fields != 0) {
+        matches.push_back({candidate.record, fields});
+      }
+    }
+  } else {
+    // Too short for a trigram; scan the records directly. An empty needle
+    // matches everything and leaves the order to the timestamps.
+    for (uint32_t i = 0; i < index->records.size(); i++) {
+      const Record& record = index->records[i];
+      if (!record.live) {
+        continue;
+      }
+      uint32_t fields = 0;
+      for (int f = 0; f < kFieldCount && !needle.empty(); f++) {
+        if (record.text[f].find(needle) != std::string::npos) {
+          fields |= 1u << f;
+        }
+      }
+      if (fields != 0 || needle.empty()) {
+        matches.push_back({i, fields});
+      }
+    }
+  }
+
+  std::vector<std::pair<uint32_t, const Posting*>> ranked;
+  ranked.reserve(matches.size());
+  for (const Posting& match : matches) {
+    ranked.push_back(
+        {rank(index->records[match.record], needle, match.fields), &match});
+  }
+  auto better = [index](const std::pair<uint32_t, const Posting*>& a,
+                        const std::pair<uint32_t, const Posting*>& b) {
+    if (a.first != b.first) {
+      return a.first > b.first;
+    }
+    const Record& ra = index->records[a.second->record];
+    const Record& rb = index->records[b.second->record];
+    if (ra.timestamp_ms != rb.timestamp_ms) {
+      return ra.timestamp_ms > rb.timestamp_ms;
+    }
+    return a.second->record > b.second->record;
+  };
+  size_t count = limit == 0 ? ranked.size() : std::min(limit, ranked.size());
+  std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end(),
+                    better);
+
+  hits->clear();
+  hits->reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    hits->push_back({index->records[ranked[i].second->record].id,
+                     ranked[i].second->fields});
+  }
+}
+
+HistoryIndexStats history_index_get_stats(HistoryIndex* index) {
+  HistoryIndexStats stats = {};
+  stats.records = index->records.size() - index->dead;
+  stats.dead_records = index->dead;
+  stats.trigrams = index->postings.size();
+  for (const auto& posting : index->postings) {
+    stats.posting_bytes += posting.second.bytes.size();
+  }
+  for (const Record& record : index->records) {
+    for (const std::string& text : record.text) {
+      stats.text_bytes += text.size();
+    }
+  }
+  return stats;
+}
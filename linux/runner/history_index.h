@@ -0,0 +1,95 @@
+#ifndef RUNNER_HISTORY_INDEX_H_
+#define RUNNER_HISTORY_INDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// Fields of a history record, as a bitmask in HistoryIndexHit::fields.
+enum HistoryIndexField : uint32_t {
+  HISTORY_INDEX_FIELD_QUERY = 1 << 0,
+  HISTORY_INDEX_FIELD_ANSWER = 1 << 1,
+  HISTORY_INDEX_FIELD_SOURCES = 1 << 2,
+};
+
+// An in-memory substring index over the research history.
+//
+// Every byte trigram of a record's folded query, answer and source titles
+// has a posting list of the records containing it. Posting lists are
+// varint-encoded deltas of record numbers with the matching fields packed
+// into the low bits. Records are numbered in insertion order, so adding one
+// only appends to the tails of its lists; removing one marks it dead and the
+// lists are rewritten once dead records outnumber live ones.
+//
+// All text must already be folded (see text_fold()); matching is bytewise.
+typedef struct _HistoryIndex HistoryIndex;
+
+typedef struct {
+  std::string id;
+  // Bitmask of #HistoryIndexField values that contain the needle.
+  uint32_t fields;
+} HistoryIndexHit;
+
+typedef struct {
+  uint64_t records;
+  uint64_t dead_records;
+  uint64_t trigrams;
+  uint64_t posting_bytes;
+  uint64_t text_bytes;
+} HistoryIndexStats;
+
+HistoryIndex* history_index_new();
+
+void history_index_free(HistoryIndex* index);
+
+/**
+ * history_index_put:
+ * @index: a #HistoryIndex.
+ * @id: the record's document id.
+ * @timestamp_ms: when the record was created, used to order equal ranks.
+ * @query: the folded research query.
+ * @answer: the folded answer.
+ * @sources: the folded source titles, joined by a separator.
+ *
+ * Adds a record, replacing any previous record with the same @id.
+ */
+void history_index_put(HistoryIndex* index,
+                       const std::string& id,
+                       int64_t timestamp_ms,
+                       const std::string& query,
+                       const std::string& answer,
+                       const std::string& sources);
+
+/**
+ * history_index_remove:
+ * @index: a #HistoryIndex.
+ * @id: the record's document id.
+ *
+ * Returns: %TRUE if a record was removed.
+ */
+bool history_index_remove(HistoryIndex* index, const std::string& id);
+
+void history_index_clear(HistoryIndex* index);
+
+/**
+ * history_index_search:
+ * @index: a #HistoryIndex.
+ * @needle: the folded text to look for.
+ * @limit: the maximum number of hits, or 0 for no limit.
+ * @hits: (out): receives the matching records, best first.
+ *
+ * Finds the records containing @needle in any field. Matches in the query
+ * rank above source titles, which rank above the answer; a query that starts
+ * with @needle ranks highest. Equal ranks are ordered newest first. An empty
+ * @needle matches every record.
+ */
+void history_index_search(HistoryIndex* index,
+                          const std::string& needle,
+                          size_t limit,
+                          std::vector<HistoryIndexHit>* hits);
+
+HistoryIndexStats history_index_get_stats(HistoryIndex* index);
+
+#endif  // RUNNER_HISTORY_INDEX_H_
@@ -0,0 +1,441 @@
+#include "history_index_plugin.h"
+
+#include <cstring>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "fingerprint_index.h"
+#include "fuzzy_matcher.h"
+#include "history_index.h"
+#include "text_fold.h"
+
+static constexpr char kChannelName[] = "echolens/history_index";
+
+static constexpr char kApplyMethod[] = "apply";
+static constexpr char kSearchMethod[] = "search";
+static constexpr char kFilterMethod[] = "filter";
+static constexpr char kSimilarMethod[] = "similar";
+static constexpr char kDuplicatesMethod[] = "duplicates";
+static constexpr char kClearMethod[] = "clear";
+static constexpr char kStatsMethod[] = "stats";
+
+static constexpr char kBadArgumentsError[] = "Bad Arguments";
+
+static constexpr char kTitleSeparator = '\x1f';
+
+struct _HistoryIndexPlugin {
+  GObject parent_instance;
+
+  // Only touched from the single thread of @worker.
+  HistoryIndex* index;
+  FingerprintIndex* fingerprints;
+  FuzzyMatcher* titles;
+  GThreadPool* worker;
+};
+
+G_DEFINE_TYPE(HistoryIndexPlugin, history_index_plugin, G_TYPE_OBJECT)
+
+typedef enum {
+  INDEX_JOB_APPLY,
+  INDEX_JOB_SEARCH,
+  INDEX_JOB_FILTER,
+  INDEX_JOB_SIMILAR,
+  INDEX_JOB_DUPLICATES,
+  INDEX_JOB_CLEAR,
+  INDEX_JOB_STATS,
+} IndexJobKind;
+
+// A history record as sent by Dart, before folding.
+typedef struct {
+  std::string id;
+  int64_t timestamp_ms;
+  std::string query;
+  std::string answer;
+  std::string sources;
+} IndexRecord;
+
+// One method call, copied out of its FlValue arguments on the main thread,
+// run on the worker and answered back on the main thread.
+typedef struct {
+  HistoryIndexPlugin* self;
+  FlMethodCall* method_call;
+  IndexJobKind kind;
+
+  std::vector<IndexRecord> upserts;
+  std::vector<std::string> removals;
+  std::string needle;
+  size_t limit;
+
+  std::vector<HistoryIndexHit> hits;
+  std::vector<FuzzyMatch> title_matches;
+  std::vector<FingerprintMatch> matches;
+  std::vector<std::vector<std::string>> groups;
+  HistoryIndexStats stats;
+  FingerprintIndexStats fingerprint_stats;
+  FuzzyMatcherStats title_stats;
+} IndexJob;
+
+static std::string fold(const std::string& text) {
+  g_autofree gchar* folded = text_fold(text.c_str());
+  return folded;
+}
+
+static const gchar* lookup_string(FlValue* map, const gchar* key) {
+  FlValue* value = fl_value_lookup_string(map, key);
+  if (value == nullptr || fl_value_get_type(value) != FL_VALUE_TYPE_STRING) {
+    return nullptr;
+  }
+  return fl_value_get_string(value);
+}
+
+// Copies one record map. Source titles are joined by a unit separator, which
+// survives folding and cannot be typed, so no needle matches across titles.
+static gboolean read_record(FlValue* value, IndexRecord* record) {
+  if (fl_value_get_type(value) != FL_VALUE_TYPE_MAP) {
+    return FALSE;
+  }
+  const gchar* id = lookup_string(value, "id");
+  if (id == nullptr) {
+    return FALSE;
+  }
+  record->id = id;
+
+  FlValue* timestamp = fl_value_lookup_string(value, "timestamp");
+  record->timestamp_ms =
+      timestamp != nullptr && fl_value_get_type(timestamp) == FL_VALUE_TYPE_INT
+          ? fl_value_get_int(timestamp)
+          : 0;
+
+  const gchar* query = lookup_string(value, "query");
+  const gchar* answer = lookup_string(value, "answer");
+  record->query = query != nullptr ? query : "";
+  record->answer = answer != nullptr ? answer : "";
+
+  FlValue* sources = fl_value_lookup_string(value, "sources");
+  if (sources != nullptr && fl_value_get_type(sources) == FL_VALUE_TYPE_LIST) {
+    for (size_t i = 0; i < fl_value_get_length(sources); i++) {
+      FlValue* title = fl_value_get_list_value(sources, i);
+      if (fl_value_get_type(title) != FL_VALUE_TYPE_STRING) {
+        continue;
+      }
+      if (!record->sources.empty()) {
+        record->sources += kTitleSeparator;
+      }
+      record->sources += fl_value_get_string(title);
+    }
+  }
+  return TRUE;
+}
+
+static gboolean read_apply_args(FlValue* args, IndexJob* job) {
+  if (fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return FALSE;
+  }
+  FlValue* upserts = fl_value_lookup_string(args, "upserts");
+  if (upserts != nullptr && fl_value_get_type(upserts) == FL_VALUE_TYPE_LIST) {
+    job->upserts.resize(fl_value_get_length(upserts));
+    for (size_t i = 0; i < job->upserts.size(); i++) {
+      if (!read_record(fl_value_get_list_value(upserts, i),
+                       &job->upserts[i])) {
+        return FALSE;
+      }
+    }
+  }
+  FlValue* removals = fl_value_lookup_string(args, "removals");
+  if (removals != nullptr && fl_value_get_type(removals) == FL_VALUE_TYPE_LIST) {
+    for (size_t i = 0; i < fl_value_get_length(removals); i++) {
+      FlValue* id = fl_value_get_list_value(removals, i);
+      if (fl_value_get_type(id) != FL_VALUE_TYPE_STRING) {
+        return FALSE;
+      }
+      job->removals.push_back(fl_value_get_string(id));
+    }
+  }
+  return TRUE;
+}
+
+static gboolean read_search_args(FlValue* args, IndexJob* job) {
+  if (fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return FALSE;
+  }
+  const gchar* query = lookup_string(args, "query");
+  if (query == nullptr) {
+    return FALSE;
+  }
+  job->needle = query;
+  FlValue* limit = fl_value_lookup_string(args, "limit");
+  job->limit = limit != nullptr && fl_value_get_type(limit) == FL_VALUE_TYPE_INT
+                   ? MAX(fl_value_get_int(limit), 0)
+                   : 0;
+  return TRUE;
+}
+
+// Sends the job's result on the main thread and frees it.
+static gboolean respond_cb(gpointer user_data) {
+  IndexJob* job = static_cast<IndexJob*>(user_data);
+
+  g_autoptr(FlValue) result = nullptr;
+  switch (job->kind) {
+    case INDEX_JOB_SEARCH:
+      result = fl_value_new_list();
+      for (const HistoryIndexHit& hit : job->hits) {
+        fl_value_append_take(result, fl_value_new_string(hit.id.c_str()));
+      }
+      break;
+    case INDEX_JOB_FILTER:
+      result = fl_value_new_list();
+      for (const FuzzyMatch& match : job->title_matches) {
+        std::vector<int32_t> ranges(match.ranges.begin(), match.ranges.end());
+        FlValue* value = fl_value_new_map();
+        fl_value_set_string_take(value, "id",
+                                 fl_value_new_string(match.id.c_str()));
+        fl_value_set_string_take(
+            value, "ranges",
+            fl_value_new_int32_list(ranges.data(), ranges.size()));
+        fl_value_append_take(result, value);
+      }
+      for (const HistoryIndexHit& hit : job->hits) {
+        FlValue* value = fl_value_new_map();
+        fl_value_set_string_take(value, "id",
+                                 fl_value_new_string(hit.id.c_str()));
+        fl_value_append_take(result, value);
+      }
+      break;
+    case INDEX_JOB_SIMILAR:
+      result = fl_value_new_list();
+      for (const FingerprintMatch& match : job->matches) {
+        FlValue* value = fl_value_new_map();
+        fl_value_set_string_take(value, "id",
+                                 fl_value_new_string(match.id.c_str()));
+        fl_value_set_string_take(value, "score",
+                                 fl_value_new_float(match.score));
+        fl_value_append_take(result, value);
+      }
+      break;
+    case INDEX_JOB_DUPLICATES:
+      result = fl_value_new_list();
+      for (const std::vector<std::string>& group : job->groups) {
+        FlValue* value = fl_value_new_list();
+        for (const std::string& id : group) {
+          fl_value_append_take(value, fl_value_new_string(id.c_str()));
+        }
+        fl_value_append_take(result, value);
+      }
+      break;
+    case INDEX_JOB_STATS:
+      result = fl_value_new_map();
+      fl_value_set_string_take(result, "records",
+                               fl_value_new_int(job->stats.records));
+      fl_value_set_string_take(result, "deadRecords",
+                               fl_value_new_int(job->stats.dead_records));
+      fl_value_set_string_take(result, "trigrams",
+                               fl_value_new_int(job->stats.trigrams));
+      fl_value_set_string_take(result, "postingBytes",
+                               fl_value_new_int(job->stats.posting_bytes));
+      fl_value_set_string_take(result, "textBytes",
+                               fl_value_new_int(job->stats.text_bytes));
+      fl_value_set_string_take(
+          result, "queryWords",
+          fl_value_new_int(job->fingerprint_stats.query_words));
+      fl_value_set_string_take(
+          result, "answerBuckets",
+          fl_value_new_int(job->fingerprint_stats.buckets));
+      fl_value_set_string_take(
+          result, "fingerprintBytes",
+          fl_value_new_int(job->fingerprint_stats.index_bytes));
+      fl_value_set_string_take(
+          result, "titleChars",
+          fl_value_new_int(job->title_stats.folded_chars));
+      break;
+    case INDEX_JOB_APPLY:
+    case INDEX_JOB_CLEAR:
+      break;
+  }
+
+  g_autoptr(FlMethodResponse) response =
+      FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(job->method_call, response, &error)) {
+    g_warning("Failed to send method call response: %s", error->message);
+  }
+
+  g_object_unref(job->method_call);
+  g_object_unref(job->self);
+  delete job;
+  return G_SOURCE_REMOVE;
+}
+
+// Runs a job on the worker thread. Folding happens here too, so indexing a
+// long history on startup never blocks the UI.
+static void run_job_cb(gpointer data, gpointer user_data) {
+  IndexJob* job = static_cast<IndexJob*>(data);
+  HistoryIndex* index = job->self->index;
+  FingerprintIndex* fingerprints = job->self->fingerprints;
+  FuzzyMatcher* titles = job->self->titles;
+
+  switch (job->kind) {
+    case INDEX_JOB_APPLY:
+      for (const std::string& id : job->removals) {
+        history_index_remove(index, id);
+        fingerprint_index_remove(fingerprints, id);
+        fuzzy_matcher_remove(titles, id);
+      }
+      for (const IndexRecord& record : job->upserts) {
+        std::string query = fold(record.query);
+        std::string answer = fold(record.answer);
+        history_index_put(index, record.id, record.timestamp_ms, query, answer,
+                          fold(record.sources));
+        fingerprint_index_put(fingerprints, record.id, record.timestamp_ms,
+                              query, answer);
+        // Folded by the matcher itself, which keeps the offsets to highlight.
+        fuzzy_matcher_put(titles, record.id, record.timestamp_ms,
+                          record.query);
+      }
+      break;
+    case INDEX_JOB_SEARCH:
+      history_index_search(index, fold(job->needle), job->limit, &job->hits);
+      break;
+    case INDEX_JOB_FILTER: {
+      fuzzy_matcher_match(titles, job->needle, job->limit,
+                          &job->title_matches);
+      // Then the records with the needle in their answer or sources only.
+      std::unordered_set<std::string> matched;
+      for (const FuzzyMatch& match : job->title_matches) {
+        matched.insert(match.id);
+      }
+      std::vector<HistoryIndexHit> hits;
+      history_index_search(index, fold(job->needle), 0, &hits);
+      for (const HistoryIndexHit& hit : hits) {
+        if (job->limit != 0 &&
+            job->title_matches.size() + job->hits.size() >= job->limit) {
+          break;
+        }
+        if (matched.count(hit.id) == 0) {
+          job->hits.push_back(hit);
+        }
+      }
+      break;
+    }
+    case INDEX_JOB_SIMILAR:
+      fingerprint_index_similar(fingerprints, fold(job->needle), job->limit,
+                                &job->matches);
+      break;
+    case INDEX_JOB_DUPLICATES:
+      fingerprint_index_duplicates(fingerprints, &job->groups);
+      break;
+    case INDEX_JOB_CLEAR:
+      history_index_clear(index);
+      fingerprint_index_clear(fingerprints);
+      fuzzy_matcher_clear(titles);
+      break;
+    case INDEX_JOB_STATS:
+      job->stats = history_index_get_stats(index);
+      job->fingerprint_stats = fingerprint_index_get_stats(fingerprints);
+      job->title_stats = fuzzy_matcher_get_stats(titles);
+      break;
+  }
+
+  g_main_context_invoke(nullptr, respond_cb, job);
+}
+
+// Called when a method call is received from Flutter.
+static void method_call_cb(FlMethodChannel* channel,
+                           FlMethodCall* method_call,
+                           gpointer user_data) {
+  HistoryIndexPlugin* self = HISTORY_INDEX_PLUGIN(user_data);
+  const gchar* method = fl_method_call_get_name(method_call);
+  FlValue* args = fl_method_call_get_args(method_call);
+
+  IndexJob* job = new IndexJob();
+  job->limit = 0;
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (strcmp(method, kApplyMethod) == 0) {
+    job->kind = INDEX_JOB_APPLY;
+    if (!read_apply_args(args, job)) {
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          kBadArgumentsError, "Expected upserts and removals", nullptr));
+    }
+  } else if (strcmp(method, kSearchMethod) == 0) {
+    job->kind = INDEX_JOB_SEARCH;
+    if (!read_search_args(args, job)) {
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          kBadArgumentsError, "Expected query", nullptr));
+    }
+  } else if (strcmp(method, kFilterMethod) == 0) {
+    job->kind = INDEX_JOB_FILTER;
+    if (!read_search_args(args, job)) {
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          kBadArgumentsError, "Expected query", nullptr));
+    }
+  } else if (strcmp(method, kSimilarMethod) == 0) {
+    job->kind = INDEX_JOB_SIMILAR;
+    if (!read_search_args(args, job)) {
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          kBadArgumentsError, "Expected query", nullptr));
+    }
+  } else if (strcmp(method, kDuplicatesMethod) == 0) {
+    job->kind = INDEX_JOB_DUPLICATES;
+  } else if (strcmp(method, kClearMethod) == 0) {
+    job->kind = INDEX_JOB_CLEAR;
+  } else if (strcmp(method, kStatsMethod) == 0) {
+    job->kind = INDEX_JOB_STATS;
+  } else {
+    response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+  }
+
+  if (response == nullptr) {
+    job->self = HISTORY_INDEX_PLUGIN(g_object_ref(self));
+    job->method_call = FL_METHOD_CALL(g_object_ref(method_call));
+    g_thread_pool_push(self->worker, job, nullptr);
+    return;
+  }
+
+  delete job;
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(method_call, response, &error)) {
+    g_warning("Failed to send method call response: %s", error->message);
+  }
+}
+
+static void history_index_plugin_dispose(GObject* object) {
+  HistoryIndexPlugin* self = HISTORY_INDEX_PLUGIN(object);
+
+  if (self->worker != nullptr) {
+    g_thread_pool_free(self->worker, FALSE, TRUE);
+    self->worker = nullptr;
+  }
+  g_clear_pointer(&self->index, history_index_free);
+  g_clear_pointer(&self->fingerprints, fingerprint_index_free);
+  g_clear_pointer(&self->titles, fuzzy_matcher_free);
+
+  G_OBJECT_CLASS(history_index_plugin_parent_class)->dispose(object);
+}
+
+static void history_index_plugin_class_init(HistoryIndexPluginClass* klass) {
+  G_OBJECT_CLASS(klass)->dispose = history_index_plugin_dispose;
+}
+
+static void history_index_plugin_init(HistoryIndexPlugin* self) {
+  self->index = history_index_new();
+  self->fingerprints = fingerprint_index_new();
+  self->titles = fuzzy_matcher_new();
+  // A single exclusive thread keeps jobs in the order they were called.
+  self->worker = g_thread_pool_new(run_job_cb, nullptr, 1, TRUE, nullptr);
+}
+
+void history_index_plugin_register_with_registrar(
+    FlPluginRegistrar* registrar) {
+  HistoryIndexPlugin* plugin = HISTORY_INDEX_PLUGIN(
+      g_object_new(history_index_plugin_get_type(), nullptr));
+
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  g_autoptr(FlMethodChannel) channel =
+      fl_method_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                            kChannelName, FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(channel, method_call_cb,
+                                            g_object_ref(plugin),
+                                            g_object_unref);
+
+  g_object_unref(plugin);
+}
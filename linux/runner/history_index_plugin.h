@@ -0,0 +1,29 @@
+#ifndef RUNNER_HISTORY_INDEX_PLUGIN_H_
+#define RUNNER_HISTORY_INDEX_PLUGIN_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+G_DECLARE_FINAL_TYPE(HistoryIndexPlugin,
+                     history_index_plugin,
+                     HISTORY,
+                     INDEX_PLUGIN,
+                     GObject)
+
+/**
+ * history_index_plugin_register_with_registrar:
+ * @registrar: an #FlPluginRegistrar.
+ *
+ * Registers the "echolens/history_index" method channel. Dart mirrors the
+ * research history into a #HistoryIndex with "apply" as Firestore snapshots
+ * change. The history drawer filters it with "filter": typo-tolerant
+ * matches of the queries from a #FuzzyMatcher, with the ranges to highlight,
+ * then records with the text in their answer or sources. The same records
+ * are fingerprinted into a #FingerprintIndex: "similar" finds earlier
+ * searches for a query before it is spent, and "duplicates" groups records
+ * that repeat one another. All index work runs in order on a single worker
+ * thread.
+ */
+void history_index_plugin_register_with_registrar(
+    FlPluginRegistrar* registrar);
+
+#endif  // RUNNER_HISTORY_INDEX_PLUGIN_H_
@@ -0,0 +1,672 @@
+#include "history_store.h"
+
+#include <sqlite3.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <random>
+#include <unordered_map>
+
+namespace {
+
+constexpr int kSchemaVersion = 2;
+
+constexpr char kSchema[] =
+    "CREATE TABLE IF NOT EXISTS records ("
+    "  uid TEXT NOT NULL,"
+    "  id TEXT NOT NULL,"
+    "  timestamp_ms INTEGER NOT NULL,"
+    "  query TEXT NOT NULL,"
+    "  answer TEXT NOT NULL,"
+    "  sources BLOB,"
+    "  PRIMARY KEY (uid, id)"
+    ") WITHOUT ROWID;"
+    "CREATE INDEX IF NOT EXISTS records_by_time"
+    "  ON records (uid, timestamp_ms DESC);"
+    "CREATE TABLE IF NOT EXISTS journal ("
+    "  seq INTEGER PRIMARY KEY AUTOINCREMENT,"
+    "  uid TEXT NOT NULL,"
+    "  kind INTEGER NOT NULL,"
+    "  id TEXT NOT NULL,"
+    "  created_ms INTEGER NOT NULL"
+    ");"
+    "CREATE INDEX IF NOT EXISTS journal_by_record ON journal (uid, id);"
+    "CREATE TABLE IF NOT EXISTS usage ("
+    "  uid TEXT NOT NULL,"
+    "  day TEXT NOT NULL,"
+    "  searches INTEGER NOT NULL,"
+    "  last_ms INTEGER NOT NULL,"
+    "  PRIMARY KEY (uid, day)"
+    ") WITHOUT ROWID;";
+
+// Firestore's auto-id alphabet and length.
+constexpr char kIdAlphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+constexpr int kIdLength = 20;
+
+enum Statement {
+  kListRecords,
+  kGetRecord,
+  kPutRecord,
+  kRemoveRecord,
+  kRemoveAllRecords,
+  kAppendJournal,
+  kDropJournal,
+  kDropRecordJournal,
+  kPendingRecord,
+  kPendingClear,
+  kScanJournal,
+  kAckJournal,
+  kCountRecords,
+  kCountJournal,
+  kGetUsage,
+  kCountSearch,
+  kMergeUsage,
+  kPruneUsage,
+  kRemoveUsage,
+  kStatementCount,
+};
+
+constexpr const char* kStatements[kStatementCount] = {
+    "SELECT id, timestamp_ms, query, answer, sources FROM records"
+    " WHERE uid = ?1 ORDER BY timestamp_ms DESC",
+    "SELECT id, timestamp_ms, query, answer, sources FROM records"
+    " WHERE uid = ?1 AND id = ?2",
+    "INSERT OR REPLACE INTO records VALUES (?1, ?2, ?3, ?4, ?5, ?6)",
+    "DELETE FROM records WHERE uid = ?1 AND id = ?2",
+    "DELETE FROM records WHERE uid = ?1",
+    "INSERT INTO journal (uid, kind, id, created_ms) VALUES (?1, ?2, ?3, ?4)",
+    "DELETE FROM journal WHERE uid = ?1",
+    "DELETE FROM journal WHERE uid = ?1 AND kind != 4",
+    "SELECT 1 FROM journal WHERE uid = ?1 AND id = ?2 LIMIT 1",
+    "SELECT MAX(created_ms) FROM journal WHERE uid = ?1 AND kind = 3",
+    "SELECT seq, kind, id FROM journal WHERE uid = ?1 ORDER BY seq",
+    "DELETE FROM journal WHERE uid = ?1 AND seq <= ?2",
+    "SELECT COUNT(*) FROM records",
+    "SELECT COUNT(*) FROM journal",
+    "SELECT searches, last_ms FROM usage WHERE uid = ?1 AND day = ?2",
+    "INSERT INTO usage VALUES (?1, ?2, 1, ?3) ON CONFLICT (uid, day)"
+    " DO UPDATE SET searches = searches + 1, last_ms = ?3",
+    "INSERT INTO usage VALUES (?1, ?2, ?3, 0) ON CONFLICT (uid, day)"
+    " DO UPDATE SET searches = MAX(searches, ?3)",
+    // Days that are over only matter until their count is uploaded.
+    "DELETE FROM usage WHERE uid = ?1 AND day < ?2 AND day NOT IN"
+    " (SELECT id FROM journal WHERE uid = ?1 AND kind = 4)",
+    "DELETE FROM usage WHERE uid = ?1",
+};
+
+int64_t now_ms() {
+  struct timeval now;
+  gettimeofday(&now, nullptr);
+  return static_cast<int64_t>(now.tv_sec) * 1000 + now.tv_usec / 1000;
+}
+
+void append_u32(std::string* out, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    out->push_back(static_cast<char>(value >> (8 * i)));
+  }
+}
+
+// Sources are stored as a u32 count and u32-prefixed titles and urls.
+std::string pack_sources(const std::vector<HistorySource>& sources) {
+  std::string packed;
+  append_u32(&packed, sources.size());
+  for (const HistorySource& source : sources) {
+    append_u32(&packed, source.title.size());
+    packed += source.title;
+    append_u32(&packed, source.url.size());
+    packed += source.url;
+  }
+  return packed;
+}
+
+bool read_u32(const uint8_t** p, const uint8_t* end, uint32_t* value) {
+  if (end - *p < 4) {
+    return false;
+  }
+  *value = static_cast<uint32_t>((*p)[0]) |
+           static_cast<uint32_t>((*p)[1]) << 8 |
+           static_cast<uint32_t>((*p)[2]) << 16 |
+           static_cast<uint32_t>((*p)[3]) << 24;
+  *p += 4;
+  return true;
+}
+
+bool read_string(const uint8_t** p, const uint8_t* end, std::string* value) {
+  uint32_t length;
+  if (!read_u32(p, end, &length) || static_cast<size_t>(end - *p) < length) {
+    return false;
+  }
+  value->assign(reinterpret_cast<const char*>(*p), length);
+  *p += length;
+  return true;
+}
+
+std::vector<HistorySource> unpack_sources(const void* blob, int length) {
+  std::vector<HistorySource> sources;
+  const uint8_t* p = static_cast<const uint8_t*>(blob);
+  const uint8_t* end = p + length;
+  uint32_t count;
+  if (blob == nullptr || !read_u32(&p, end, &count)) {
+    return sources;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    HistorySource source;
+    if (!read_string(&p, end, &source.title) ||
+        !read_string(&p, end, &source.url)) {
+      break;
+    }
+    sources.push_back(source);
+  }
+  return sources;
+}
+
+std::string column_text(sqlite3_stmt* statement, int column) {
+  const unsigned char* text = sqlite3_column_text(statement, column);
+  return text != nullptr
+             ? std::string(reinterpret_cast<const char*>(text),
+                           sqlite3_column_bytes(statement, column))
+             : std::string();
+}
+
+void bind_text(sqlite3_stmt* statement, int index, const std::string& text) {
+  sqlite3_bind_text(statement, index, text.data(), text.size(),
+                    SQLITE_TRANSIENT);
+}
+
+HistoryRecord read_record(sqlite3_stmt* statement) {
+  HistoryRecord record;
+  record.id = column_text(statement, 0);
+  record.timestamp_ms = sqlite3_column_int64(statement, 1);
+  record.query = column_text(statement, 2);
+  record.answer = column_text(statement, 3);
+  record.sources = unpack_sources(sqlite3_column_blob(statement, 4),
+                                  sqlite3_column_bytes(statement, 4));
+  return record;
+}
+
+bool same_record(const HistoryRecord& a, const HistoryRecord& b) {
+  if (a.timestamp_ms != b.timestamp_ms || a.query != b.query ||
+      a.answer != b.answer || a.sources.size() != b.sources.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.sources.size(); i++) {
+    if (a.sources[i].title != b.sources[i].title ||
+        a.sources[i].url != b.sources[i].url) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string new_id() {
+  static std::mt19937_64 generator{std::random_device{}()};
+  std::uniform_int_distribution<int> pick(0, sizeof(kIdAlphabet) - 2);
+  std::string id;
+  for (int i = 0; i < kIdLength; i++) {
+    id += kIdAlphabet[pick(generator)];
+  }
+  return id;
+}
+
+}  // namespace
+
+struct _HistoryStore {
+  sqlite3* db;
+  sqlite3_stmt* statements[kStatementCount];
+  uint64_t synced_entries;
+  uint64_t coalesced_entries;
+  // Journal entries coalesced by the batch awaiting acknowledgement.
+  uint64_t pending_coalesced;
+};
+
+// Returns the cached statement @which, reset and bound to @uid.
+static sqlite3_stmt* prepare(HistoryStore* store,
+                             Statement which,
+                             const std::string& uid) {
+  sqlite3_stmt* statement = store->statements[which];
+  sqlite3_reset(statement);
+  sqlite3_clear_bindings(statement);
+  if (sqlite3_bind_parameter_count(statement) > 0) {
+    bind_text(statement, 1, uid);
+  }
+  return statement;
+}
+
+// Runs a statement that returns no rows.
+static bool run(sqlite3_stmt* statement) {
+  int result = sqlite3_step(statement);
+  sqlite3_reset(statement);
+  return result == SQLITE_DONE;
+}
+
+static bool exec(HistoryStore* store, const char* sql) {
+  return sqlite3_exec(store->db, sql, nullptr, nullptr, nullptr) == SQLITE_OK;
+}
+
+// Commits if @ok, rolls back otherwise; returns @ok.
+static bool finish_transaction(HistoryStore* store, bool ok) {
+  if (ok) {
+    ok = exec(store, "COMMIT");
+  }
+  if (!ok) {
+    exec(store, "ROLLBACK");
+  }
+  return ok;
+}
+
+static bool append_journal(HistoryStore* store,
+                           const std::string& uid,
+                           HistoryOpKind kind,
+                           const std::string& id) {
+  sqlite3_stmt* statement = prepare(store, kAppendJournal, uid);
+  sqlite3_bind_int(statement, 2, kind);
+  bind_text(statement, 3, id);
+  sqlite3_bind_int64(statement, 4, now_ms());
+  return run(statement);
+}
+
+static bool write_record(HistoryStore* store,
+                         const std::string& uid,
+                         const HistoryRecord& record) {
+  sqlite3_stmt* statement = prepare(store, kPutRecord, uid);
+  bind_text(statement, 2, record.id);
+  sqlite3_bind_int64(statement, 3, record.timestamp_ms);
+  bind_text(statement, 4, record.query);
+  bind_text(statement, 5, record.answer);
+  std::string sources = pack_sources(record.sources);
+  sqlite3_bind_blob(statement, 6, sources.data(), sources.size(),
+                    SQLITE_TRANSIENT);
+  return run(statement);
+}
+
+static bool delete_record(HistoryStore* store,
+                          const std::string& uid,
+                          const std::string& id) {
+  sqlite3_stmt* statement = prepare(store, kRemoveRecord, uid);
+  bind_text(statement, 2, id);
+  return run(statement);
+}
+
+static bool get_record(HistoryStore* store,
+                       const std::string& uid,
+                       const std::string& id,
+                       HistoryRecord* record) {
+  sqlite3_stmt* statement = prepare(store, kGetRecord, uid);
+  bind_text(statement, 2, id);
+  bool found = sqlite3_step(statement) == SQLITE_ROW;
+  if (found) {
+    *record = read_record(statement);
+  }
+  sqlite3_reset(statement);
+  return found;
+}
+
+static bool get_usage(HistoryStore* store,
+                      const std::string& uid,
+                      const std::string& day,
+                      int64_t* searches,
+                      int64_t* last_ms) {
+  sqlite3_stmt* statement = prepare(store, kGetUsage, uid);
+  bind_text(statement, 2, day);
+  bool found = sqlite3_step(statement) == SQLITE_ROW;
+  *searches = found ? sqlite3_column_int64(statement, 0) : 0;
+  *last_ms = found ? sqlite3_column_int64(statement, 1) : 0;
+  sqlite3_reset(statement);
+  return found;
+}
+
+static bool count_search(HistoryStore* store,
+                         const std::string& uid,
+                         const std::string& day,
+                         int64_t timestamp_ms) {
+  sqlite3_stmt* statement = prepare(store, kPruneUsage, uid);
+  bind_text(statement, 2, day);
+  if (!run(statement)) {
+    return false;
+  }
+  statement = prepare(store, kCountSearch, uid);
+  bind_text(statement, 2, day);
+  sqlite3_bind_int64(statement, 3, timestamp_ms);
+  return run(statement);
+}
+
+static int64_t query_int(HistoryStore* store,
+                         Statement which,
+                         const std::string& uid) {
+  sqlite3_stmt* statement = prepare(store, which, uid);
+  int64_t value = sqlite3_step(statement) == SQLITE_ROW
+                      ? sqlite3_column_int64(statement, 0)
+                      : 0;
+  sqlite3_reset(statement);
+  return value;
+}
+
+HistoryStore* history_store_open(const char* path, std::string* error) {
+  sqlite3* db = nullptr;
+  if (sqlite3_open_v2(path, &db,
+                      SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE |
+                          SQLITE_OPEN_NOMUTEX,
+                      nullptr) != SQLITE_OK) {
+    if (error != nullptr) {
+      *error = db != nullptr ? sqlite3_errmsg(db) : "out of memory";
+    }
+    sqlite3_close(db);
+    return nullptr;
+  }
+
+  HistoryStore* store = new HistoryStore();
+  store->db = db;
+  // WAL keeps reads from waiting on the journal's fsyncs; FULL makes every
+  // committed change survive a power loss, which the journal promises.
+  bool ok = exec(store, "PRAGMA journal_mode = WAL") &&
+            exec(store, "PRAGMA synchronous = FULL") &&
+            exec(store, kSchema) &&
+            exec(store, ("PRAGMA user_version = " +
+                         std::to_string(kSchemaVersion))
+                            .c_str());
+  for (int i = 0; ok && i < kStatementCount; i++) {
+    ok = sqlite3_prepare_v3(db, kStatements[i], -1, SQLITE_PREPARE_PERSISTENT,
+                            &store->statements[i], nullptr) == SQLITE_OK;
+  }
+  if (!ok) {
+    if (error != nullptr) {
+      *error = sqlite3_errmsg(db);
+    }
+    history_store_free(store);
+    return nullptr;
+  }
+  return store;
+}
+
+void history_store_free(HistoryStore* store) {
+  if (store == nullptr) {
+    return;
+  }
+  for (sqlite3_stmt* statement : store->statements) {
+    sqlite3_finalize(statement);
+  }
+  sqlite3_close(store->db);
+  delete store;
+}
+
+bool history_store_list(HistoryStore* store,
+                        const std::string& uid,
+                        std::vector<HistoryRecord>* records) {
+  records->clear();
+  sqlite3_stmt* statement = prepare(store, kListRecords, uid);
+  int result;
+  while ((result = sqlite3_step(statement)) == SQLITE_ROW) {
+    records->push_back(read_record(statement));
+  }
+  sqlite3_reset(statement);
+  return result == SQLITE_DONE;
+}
+
+bool history_store_put(HistoryStore* store,
+                       const std::string& uid,
+                       HistoryRecord* record) {
+  if (record->id.empty()) {
+    record->id = new_id();
+  }
+  if (!exec(store, "BEGIN IMMEDIATE")) {
+    return false;
+  }
+  return finish_transaction(
+      store, write_record(store, uid, *record) &&
+                 append_journal(store, uid, HISTORY_OP_PUT, record->id));
+}
+
+bool history_store_put_search(HistoryStore* store,
+                              const std::string& uid,
+                              HistoryRecord* record,
+                              const std::string& day,
+                              int64_t* searches) {
+  if (record->id.empty()) {
+    record->id = new_id();
+  }
+  if (!exec(store, "BEGIN IMMEDIATE")) {
+    return false;
+  }
+  int64_t last_ms;
+  return finish_transaction(
+      store,
+      write_record(store, uid, *record) &&
+          append_journal(store, uid, HISTORY_OP_PUT, record->id) &&
+          count_search(store, uid, day, record->timestamp_ms) &&
+          append_journal(store, uid, HISTORY_OP_USAGE, day) &&
+          get_usage(store, uid, day, searches, &last_ms));
+}
+
+bool history_store_merge_usage(HistoryStore* store,
+                               const std::string& uid,
+                               const std::string& day,
+                               int64_t remote_searches,
+                               int64_t* searches) {
+  sqlite3_stmt* statement = prepare(store, kMergeUsage, uid);
+  bind_text(statement, 2, day);
+  sqlite3_bind_int64(statement, 3, remote_searches);
+  int64_t last_ms;
+  return run(statement) && get_usage(store, uid, day, searches, &last_ms);
+}
+
+bool history_store_remove(HistoryStore* store,
+                          const std::string& uid,
+                          const std::string& id) {
+  if (!exec(store, "BEGIN IMMEDIATE")) {
+    return false;
+  }
+  return finish_transaction(
+      store, delete_record(store, uid, id) &&
+                 append_journal(store, uid, HISTORY_OP_REMOVE, id));
+}
+
+bool history_store_clear(HistoryStore* store, const std::string& uid) {
+  if (!exec(store, "BEGIN IMMEDIATE")) {
+    return false;
+  }
+  return finish_transaction(
+      store, run(prepare(store, kRemoveAllRecords, uid)) &&
+                 run(prepare(store, kDropRecordJournal, uid)) &&
+                 append_journal(store, uid, HISTORY_OP_CLEAR, ""));
+}
+
+bool history_store_forget(HistoryStore* store, const std::string& uid) {
+  if (!exec(store, "BEGIN IMMEDIATE")) {
+    return false;
+  }
+  return finish_transaction(store,
+                            run(prepare(store, kRemoveAllRecords, uid)) &&
+                                run(prepare(store, kDropJournal, uid)) &&
+                                run(prepare(store, kRemoveUsage, uid)));
+}
+
+bool history_store_apply_remote(HistoryStore* store,
+                                const std::string& uid,
+                                const std::vector<HistoryRecord>& upserts,
+                                const std::vector<std::string>& removals,
+                                std::vector<HistoryRecord>* applied_upserts,
+                                std::vector<std::string>* applied_removals) {
+  applied_upserts->clear();
+  applied_removals->clear();
+  if (!exec(store, "BEGIN IMMEDIATE")) {
+    return false;
+  }
+
+  auto pending = [store, &uid](const std::string& id) {
+    sqlite3_stmt* statement = prepare(store, kPendingRecord, uid);
+    bind_text(statement, 2, id);
+    bool found = sqlite3_step(statement) == SQLITE_ROW;
+    sqlite3_reset(statement);
+    return found;
+  };
+  // Upstream still holds what a pending clear is about to delete.
+  int64_t cleared_at = query_int(store, kPendingClear, uid);
+
+  bool ok = true;
+  for (const HistoryRecord& record : upserts) {
+    if (record.timestamp_ms <= cleared_at || pending(record.id)) {
+      continue;
+    }
+    HistoryRecord current;
+    if (get_record(store, uid, record.id, &current) &&
+        same_record(current, record)) {
+      // Usually the echo of a change this replica uploaded.
+      continue;
+    }
+    ok = ok && write_record(store, uid, record);
+    applied_upserts->push_back(record);
+  }
+  for (const std::string& id : removals) {
+    HistoryRecord current;
+    if (pending(id) || !get_record(store, uid, id, &current)) {
+      continue;
+    }
+    ok = ok && delete_record(store, uid, id);
+    applied_removals->push_back(id);
+  }
+
+  if (!finish_transaction(store, ok)) {
+    applied_upserts->clear();
+    applied_removals->clear();
+    return false;
+  }
+  return true;
+}
+
+bool history_store_next_batch(HistoryStore* store,
+                              const std::string& uid,
+                              size_t max_ops,
+                              std::vector<HistoryOp>* ops,
+                              int64_t* last_seq) {
+  ops->clear();
+  *last_seq = 0;
+  if (max_ops == 0) {
+    return true;
+  }
+
+  // The last kind journaled for each record or day, in order of first
+  // appearance.
+  bool clear = false;
+  std::vector<std::pair<std::string, HistoryOpKind>> changes;
+  std::unordered_map<std::string, size_t> slots;
+  uint64_t entries = 0;
+
+  sqlite3_stmt* statement = prepare(store, kScanJournal, uid);
+  int result;
+  while ((result = sqlite3_step(statement)) == SQLITE_ROW) {
+    int64_t seq = sqlite3_column_int64(statement, 0);
+    HistoryOpKind kind =
+        static_cast<HistoryOpKind>(sqlite3_column_int(statement, 1));
+    std::string id = column_text(statement, 2);
+
+    if (kind == HISTORY_OP_CLEAR) {
+      // Searches counted before the clear still count.
+      clear = true;
+      std::vector<std::pair<std::string, HistoryOpKind>> usages;
+      slots.clear();
+      for (const auto& change : changes) {
+        if (change.second == HISTORY_OP_USAGE) {
+          slots[change.first] = usages.size();
+          usages.push_back(change);
+        }
+      }
+      changes.swap(usages);
+    } else {
+      auto slot = slots.find(id);
+      if (slot != slots.end()) {
+        changes[slot->second].second = kind;
+      } else {
+        // Stop before the entry that would overflow the batch.
+        if (changes.size() + (clear ? 1 : 0) >= max_ops) {
+          break;
+        }
+        slots[id] = changes.size();
+        changes.emplace_back(id, kind);
+      }
+    }
+    *last_seq = seq;
+    entries++;
+  }
+  bool ok = result == SQLITE_ROW || result == SQLITE_DONE;
+  sqlite3_reset(statement);
+  if (!ok) {
+    return false;
+  }
+
+  if (clear) {
+    HistoryOp op;
+    op.kind = HISTORY_OP_CLEAR;
+    op.searches = 0;
+    ops->push_back(op);
+  }
+  for (const auto& change : changes) {
+    HistoryOp op;
+    op.kind = change.second;
+    op.record.id = change.first;
+    op.searches = 0;
+    if (op.kind == HISTORY_OP_USAGE) {
+      get_usage(store, uid, change.first, &op.searches,
+                &op.record.timestamp_ms);
+    } else if (op.kind == HISTORY_OP_PUT &&
+        !get_record(store, uid, change.first, &op.record)) {
+      op.kind = HISTORY_OP_REMOVE;
+    }
+    ops->push_back(op);
+  }
+  store->pending_coalesced = entries - ops->size();
+  return true;
+}
+
+bool history_store_ack(HistoryStore* store,
+                       const std::string& uid,
+                       int64_t last_seq) {
+  sqlite3_stmt* statement = prepare(store, kAckJournal, uid);
+  sqlite3_bind_int64(statement, 2, last_seq);
+  if (!run(statement)) {
+    return false;
+  }
+  uint64_t acked = sqlite3_changes(store->db);
+  store->synced_entries += acked;
+  store->coalesced_entries += std::min(store->pending_coalesced, acked);
+  store->pending_coalesced = 0;
+  return true;
+}
+
+HistoryStoreStats history_store_get_stats(HistoryStore* store) {
+  HistoryStoreStats stats;
+  stats.records = query_int(store, kCountRecords, "");
+  stats.journal_entries = query_int(store, kCountJournal, "");
+  stats.synced_entries = store->synced_entries;
+  stats.coalesced_entries = store->coalesced_entries;
+  return stats;
+}
+
+std::string history_store_pack_records(
+    const std::vector<HistoryRecord>& records) {
+  size_t size = 4;
+  for (const HistoryRecord& record : records) {
+    size += 24 + record.id.size() + record.query.size() + record.answer.size();
+    for (const HistorySource& source : record.sources) {
+      size += 8 + source.title.size() + source.url.size();
+    }
+  }
+
+  std::string packed;
+  packed.reserve(size);
+  append_u32(&packed, records.size());
+  for (const HistoryRecord& record : records) {
+    append_u32(&packed, record.id.size());
+    packed += record.id;
+    uint64_t timestamp = static_cast<uint64_t>(record.timestamp_ms);
+    append_u32(&packed, static_cast<uint32_t>(timestamp));
+    append_u32(&packed, static_cast<uint32_t>(timestamp >> 32));
+    append_u32(&packed, record.query.size());
+    packed += record.query;
+    append_u32(&packed, record.answer.size());
+    packed += record.answer;
+    packed += pack_sources(record.sources);
+  }
+  return packed;
+}
@@ -0,0 +1,227 @@
+#ifndef RUNNER_HISTORY_STORE_H_
+#define RUNNER_HISTORY_STORE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+typedef struct {
+  std::string title;
+  std::string url;
+} HistorySource;
+
+// One research in a user's history.
+typedef struct {
+  std::string id;
+  int64_t timestamp_ms;
+  std::string query;
+  std::string answer;
+  std::vector<HistorySource> sources;
+} HistoryRecord;
+
+typedef enum {
+  HISTORY_OP_PUT = 1,
+  HISTORY_OP_REMOVE = 2,
+  HISTORY_OP_CLEAR = 3,
+  // A search counted against the user's daily quota.
+  HISTORY_OP_USAGE = 4,
+} HistoryOpKind;
+
+// A change still to be written upstream.
+typedef struct {
+  HistoryOpKind kind;
+  // The record for #HISTORY_OP_PUT; only its id for #HISTORY_OP_REMOVE. For
+  // #HISTORY_OP_USAGE, the day as its id and the last search of the day as
+  // its timestamp.
+  HistoryRecord record;
+  // The day's search count for #HISTORY_OP_USAGE.
+  int64_t searches;
+} HistoryOp;
+
+typedef struct {
+  uint64_t records;
+  uint64_t journal_entries;
+  // Journal entries acknowledged as written upstream since opening.
+  uint64_t synced_entries;
+  // Journal entries that were folded into a later one instead of being sent.
+  uint64_t coalesced_entries;
+} HistoryStoreStats;
+
+// The local replica of every user's research history, in SQLite.
+//
+// The replica is the source of truth for the UI. Local changes update it and
+// append to a journal in the same transaction, so a change is durable once
+// the call returns even if the app exits before it is synced. A sync engine
+// drains the journal with history_store_next_batch(), writes the batch
+// upstream and calls history_store_ack(); changes made upstream arrive
+// through history_store_apply_remote().
+typedef struct _HistoryStore HistoryStore;
+
+/**
+ * history_store_open:
+ * @path: the database file; created if needed.
+ * @error: (out) (optional): receives a message on failure.
+ *
+ * Returns: the store, or %NULL if the database cannot be opened.
+ */
+HistoryStore* history_store_open(const char* path, std::string* error);
+
+void history_store_free(HistoryStore* store);
+
+/**
+ * history_store_list:
+ * @store: a #HistoryStore.
+ * @uid: the user.
+ * @records: (out): receives the user's records, newest first.
+ */
+bool history_store_list(HistoryStore* store,
+                        const std::string& uid,
+                        std::vector<HistoryRecord>* records);
+
+/**
+ * history_store_put:
+ * @store: a #HistoryStore.
+ * @uid: the user.
+ * @record: (inout): the record to add or replace. A record without an id
+ *   gets a new random one, in the form Firestore uses for document ids.
+ *
+ * Stores @record and journals it for upload.
+ */
+bool history_store_put(HistoryStore* store,
+                       const std::string& uid,
+                       HistoryRecord* record);
+
+/**
+ * history_store_put_search:
+ * @store: a #HistoryStore.
+ * @uid: the user.
+ * @record: (inout): a research just made, as for history_store_put().
+ * @day: the local day of @record, as YYYY-MM-DD.
+ * @searches: (out): receives the number of searches counted on @day.
+ *
+ * Stores @record and counts one search on @day, and journals both for
+ * upload in the same transaction, so that neither is lost without the other.
+ */
+bool history_store_put_search(HistoryStore* store,
+                              const std::string& uid,
+                              HistoryRecord* record,
+                              const std::string& day,
+                              int64_t* searches);
+
+/**
+ * history_store_merge_usage:
+ * @store: a #HistoryStore.
+ * @uid: the user.
+ * @day: a day, as YYYY-MM-DD.
+ * @remote_searches: the count for @day last read upstream.
+ * @searches: (out): receives the count for @day.
+ *
+ * Raises the count for @day to @remote_searches, which searches made on
+ * other devices may have put ahead. Searches still in the journal keep the
+ * local count ahead of upstream, so it never goes down.
+ */
+bool history_store_merge_usage(HistoryStore* store,
+                               const std::string& uid,
+                               const std::string& day,
+                               int64_t remote_searches,
+                               int64_t* searches);
+
+bool history_store_remove(HistoryStore* store,
+                          const std::string& uid,
+                          const std::string& id);
+
+/**
+ * history_store_clear:
+ * @store: a #HistoryStore.
+ * @uid: the user.
+ *
+ * Removes every record of @uid and journals a single clear in place of any
+ * change to a record not yet uploaded. Searches counted are kept.
+ */
+bool history_store_clear(HistoryStore* store, const std::string& uid);
+
+/**
+ * history_store_forget:
+ * @store: a #HistoryStore.
+ * @uid: the user.
+ *
+ * Drops every record and journal entry of @uid without journaling anything,
+ * for accounts that were deleted upstream.
+ */
+bool history_store_forget(HistoryStore* store, const std::string& uid);
+
+/**
+ * history_store_apply_remote:
+ * @store: a #HistoryStore.
+ * @uid: the user.
+ * @upserts: records added or changed upstream.
+ * @removals: ids of records removed upstream.
+ * @applied_upserts: (out): receives the upserts that changed the replica.
+ * @applied_removals: (out): receives the removals that changed the replica.
+ *
+ * Merges changes pulled from upstream. Local changes win until they are
+ * acknowledged: records with journal entries are left alone, and so are
+ * upserts older than a pending clear.
+ */
+bool history_store_apply_remote(HistoryStore* store,
+                                const std::string& uid,
+                                const std::vector<HistoryRecord>& upserts,
+                                const std::vector<std::string>& removals,
+                                std::vector<HistoryRecord>* applied_upserts,
+                                std::vector<std::string>* applied_removals);
+
+/**
+ * history_store_next_batch:
+ * @store: a #HistoryStore.
+ * @uid: the user.
+ * @max_ops: the largest batch to return.
+ * @ops: (out): receives the changes to write upstream, in order.
+ * @last_seq: (out): receives the journal position to acknowledge.
+ *
+ * Coalesces the oldest journal entries of @uid into at most @max_ops
+ * changes: only the last change of each record or day is kept, a clear
+ * drops every change to a record before it, and puts and usages carry the
+ * record or count as it is now. A clear always comes first in @ops.
+ *
+ * Returns: %FALSE on a database error. @ops is empty when nothing is
+ * pending.
+ */
+bool history_store_next_batch(HistoryStore* store,
+                              const std::string& uid,
+                              size_t max_ops,
+                              std::vector<HistoryOp>* ops,
+                              int64_t* last_seq);
+
+/**
+ * history_store_ack:
+ * @store: a #HistoryStore.
+ * @uid: the user.
+ * @last_seq: the position returned by history_store_next_batch().
+ *
+ * Drops the journal entries of @uid up to @last_seq once their batch has
+ * been written upstream.
+ */
+bool history_store_ack(HistoryStore* store,
+                       const std::string& uid,
+                       int64_t last_seq);
+
+HistoryStoreStats history_store_get_stats(HistoryStore* store);
+
+/**
+ * history_store_pack_records:
+ * @records: records, e.g. from history_store_list().
+ *
+ * Packs @records for history_arena_load() in the history_arena FFI plugin,
+ * which Dart reads them from in place: a u32 count, then per record a
+ * u32-prefixed id, an i64 timestamp in milliseconds, a u32-prefixed query
+ * and answer, and the sources as they are stored in the database. All
+ * integers are little-endian.
+ *
+ * Returns: the packed bytes.
+ */
+std::string history_store_pack_records(
+    const std::vector<HistoryRecord>& records);
+
+#endif  // RUNNER_HISTORY_STORE_H_
@@ -0,0 +1,556 @@
+#include "history_store_plugin.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "history_store.h"
+
+static constexpr char kChannelName[] = "echolens/history_store";
+
+static constexpr char kListMethod[] = "list";
+static constexpr char kPutMethod[] = "put";
+static constexpr char kPutSearchMethod[] = "putSearch";
+static constexpr char kUsageMethod[] = "usage";
+static constexpr char kRemoveMethod[] = "remove";
+static constexpr char kClearMethod[] = "clear";
+static constexpr char kForgetMethod[] = "forget";
+static constexpr char kApplyRemoteMethod[] = "applyRemote";
+static constexpr char kNextBatchMethod[] = "nextBatch";
+static constexpr char kAckMethod[] = "ack";
+static constexpr char kStatsMethod[] = "stats";
+
+static constexpr char kBadArgumentsError[] = "Bad Arguments";
+static constexpr char kStoreError[] = "Store Error";
+
+// Firestore commits at most 500 writes per batch.
+static constexpr size_t kMaxBatchOps = 500;
+
+struct _HistoryStorePlugin {
+  GObject parent_instance;
+
+  gchar* path;
+  // Only touched from the single thread of @worker.
+  HistoryStore* store;
+  gchar* open_error;
+  GThreadPool* worker;
+};
+
+G_DEFINE_TYPE(HistoryStorePlugin, history_store_plugin, G_TYPE_OBJECT)
+
+typedef enum {
+  STORE_JOB_LIST,
+  STORE_JOB_PUT,
+  STORE_JOB_PUT_SEARCH,
+  STORE_JOB_USAGE,
+  STORE_JOB_REMOVE,
+  STORE_JOB_CLEAR,
+  STORE_JOB_FORGET,
+  STORE_JOB_APPLY_REMOTE,
+  STORE_JOB_NEXT_BATCH,
+  STORE_JOB_ACK,
+  STORE_JOB_STATS,
+} StoreJobKind;
+
+// One method call, copied out of its FlValue arguments on the main thread,
+// run on the worker and answered back on the main thread.
+typedef struct {
+  HistoryStorePlugin* self;
+  FlMethodCall* method_call;
+  StoreJobKind kind;
+  std::string uid;
+
+  // The put record, or the remote upserts.
+  std::vector<HistoryRecord> records;
+  // The removed id, or the remote removals.
+  std::vector<std::string> ids;
+  size_t max_ops;
+  int64_t seq;
+  // The day searches are counted on, and its count: as read upstream on the
+  // way in, as stored on the way out.
+  std::string day;
+  int64_t searches;
+  // Records are returned packed with history_store_pack_records().
+  bool packed;
+
+  bool ok;
+  std::string error;
+  std::vector<HistoryOp> ops;
+  HistoryStoreStats stats;
+} StoreJob;
+
+static const gchar* lookup_string(FlValue* map, const gchar* key) {
+  FlValue* value = fl_value_lookup_string(map, key);
+  if (value == nullptr || fl_value_get_type(value) != FL_VALUE_TYPE_STRING) {
+    return nullptr;
+  }
+  return fl_value_get_string(value);
+}
+
+static int64_t lookup_int(FlValue* map, const gchar* key) {
+  FlValue* value = fl_value_lookup_string(map, key);
+  if (value == nullptr || fl_value_get_type(value) != FL_VALUE_TYPE_INT) {
+    return 0;
+  }
+  return fl_value_get_int(value);
+}
+
+static gboolean read_record(FlValue* value, HistoryRecord* record) {
+  if (fl_value_get_type(value) != FL_VALUE_TYPE_MAP) {
+    return FALSE;
+  }
+  const gchar* id = lookup_string(value, "id");
+  const gchar* query = lookup_string(value, "query");
+  const gchar* answer = lookup_string(value, "answer");
+  if (query == nullptr || answer == nullptr) {
+    return FALSE;
+  }
+  record->id = id != nullptr ? id : "";
+  record->timestamp_ms = lookup_int(value, "timestamp");
+  record->query = query;
+  record->answer = answer;
+
+  FlValue* sources = fl_value_lookup_string(value, "sources");
+  if (sources != nullptr && fl_value_get_type(sources) == FL_VALUE_TYPE_LIST) {
+    for (size_t i = 0; i < fl_value_get_length(sources); i++) {
+      FlValue* source = fl_value_get_list_value(sources, i);
+      if (fl_value_get_type(source) != FL_VALUE_TYPE_MAP) {
+        continue;
+      }
+      const gchar* title = lookup_string(source, "title");
+      const gchar* url = lookup_string(source, "url");
+      HistorySource entry;
+      entry.title = title != nullptr ? title : "";
+      entry.url = url != nullptr ? url : "";
+      record->sources.push_back(entry);
+    }
+  }
+  return TRUE;
+}
+
+static FlValue* record_value(const HistoryRecord& record) {
+  FlValue* value = fl_value_new_map();
+  fl_value_set_string_take(value, "id", fl_value_new_string(record.id.c_str()));
+  fl_value_set_string_take(value, "timestamp",
+                           fl_value_new_int(record.timestamp_ms));
+  fl_value_set_string_take(value, "query",
+                           fl_value_new_string(record.query.c_str()));
+  fl_value_set_string_take(value, "answer",
+                           fl_value_new_string(record.answer.c_str()));
+  FlValue* sources = fl_value_new_list();
+  for (const HistorySource& source : record.sources) {
+    FlValue* entry = fl_value_new_map();
+    fl_value_set_string_take(entry, "title",
+                             fl_value_new_string(source.title.c_str()));
+    fl_value_set_string_take(entry, "url",
+                             fl_value_new_string(source.url.c_str()));
+    fl_value_append_take(sources, entry);
+  }
+  fl_value_set_string_take(value, "sources", sources);
+  return value;
+}
+
+static FlValue* records_value(const std::vector<HistoryRecord>& records) {
+  FlValue* value = fl_value_new_list();
+  for (const HistoryRecord& record : records) {
+    fl_value_append_take(value, record_value(record));
+  }
+  return value;
+}
+
+// The records for Dart, packed into its history arena if it asked for that.
+static FlValue* records_result(StoreJob* job) {
+  if (!job->packed) {
+    return records_value(job->records);
+  }
+  std::string packed = history_store_pack_records(job->records);
+  return fl_value_new_uint8_list(
+      reinterpret_cast<const uint8_t*>(packed.data()), packed.size());
+}
+
+static FlValue* ids_value(const std::vector<std::string>& ids) {
+  FlValue* value = fl_value_new_list();
+  for (const std::string& id : ids) {
+    fl_value_append_take(value, fl_value_new_string(id.c_str()));
+  }
+  return value;
+}
+
+static const gchar* op_kind_name(HistoryOpKind kind) {
+  switch (kind) {
+    case HISTORY_OP_PUT:
+      return "put";
+    case HISTORY_OP_REMOVE:
+      return "remove";
+    case HISTORY_OP_CLEAR:
+      return "clear";
+    case HISTORY_OP_USAGE:
+      return "usage";
+  }
+  return "";
+}
+
+// Copies the arguments of @kind into @job; the uid is always required.
+static gboolean read_args(FlValue* args, StoreJob* job) {
+  if (job->kind == STORE_JOB_STATS) {
+    return TRUE;
+  }
+  if (fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return FALSE;
+  }
+  const gchar* uid = lookup_string(args, "uid");
+  if (uid == nullptr || uid[0] == '\0') {
+    return FALSE;
+  }
+  job->uid = uid;
+  FlValue* packed = fl_value_lookup_string(args, "packed");
+  job->packed = packed != nullptr &&
+                fl_value_get_type(packed) == FL_VALUE_TYPE_BOOL &&
+                fl_value_get_bool(packed);
+
+  switch (job->kind) {
+    case STORE_JOB_PUT: {
+      FlValue* record = fl_value_lookup_string(args, "record");
+      job->records.resize(1);
+      return record != nullptr && read_record(record, &job->records[0]);
+    }
+    case STORE_JOB_PUT_SEARCH: {
+      FlValue* record = fl_value_lookup_string(args, "record");
+      const gchar* day = lookup_string(args, "day");
+      job->records.resize(1);
+      if (record == nullptr || day == nullptr ||
+          !read_record(record, &job->records[0])) {
+        return FALSE;
+      }
+      job->day = day;
+      return TRUE;
+    }
+    case STORE_JOB_USAGE: {
+      const gchar* day = lookup_string(args, "day");
+      if (day == nullptr) {
+        return FALSE;
+      }
+      job->day = day;
+      job->searches = lookup_int(args, "searches");
+      return TRUE;
+    }
+    case STORE_JOB_REMOVE: {
+      const gchar* id = lookup_string(args, "id");
+      if (id == nullptr) {
+        return FALSE;
+      }
+      job->ids.push_back(id);
+      return TRUE;
+    }
+    case STORE_JOB_APPLY_REMOTE: {
+      FlValue* upserts = fl_value_lookup_string(args, "upserts");
+      if (upserts != nullptr &&
+          fl_value_get_type(upserts) == FL_VALUE_TYPE_LIST) {
+        job->records.resize(fl_value_get_length(upserts));
+        for (size_t i = 0; i < job->records.size(); i++) {
+          if (!read_record(fl_value_get_list_value(upserts, i),
+                           &job->records[i]) ||
+              job->records[i].id.empty()) {
+            return FALSE;
+          }
+        }
+      }
+      FlValue* removals = fl_value_lookup_string(args, "removals");
+      if (removals != nullptr &&
+          fl_value_get_type(removals) == FL_VALUE_TYPE_LIST) {
+        for (size_t i = 0; i < fl_value_get_length(removals); i++) {
+          FlValue* id = fl_value_get_list_value(removals, i);
+          if (fl_value_get_type(id) != FL_VALUE_TYPE_STRING) {
+            return FALSE;
+          }
+          job->ids.push_back(fl_value_get_string(id));
+        }
+      }
+      return TRUE;
+    }
+    case STORE_JOB_NEXT_BATCH: {
+      int64_t max_ops = lookup_int(args, "max");
+      job->max_ops = max_ops > 0 ? MIN(static_cast<size_t>(max_ops),
+                                       kMaxBatchOps)
+                                 : kMaxBatchOps;
+      return TRUE;
+    }
+    case STORE_JOB_ACK:
+      job->seq = lookup_int(args, "seq");
+      return job->seq > 0;
+    case STORE_JOB_LIST:
+    case STORE_JOB_CLEAR:
+    case STORE_JOB_FORGET:
+    case STORE_JOB_STATS:
+      return TRUE;
+  }
+  return FALSE;
+}
+
+static FlValue* job_result(StoreJob* job) {
+  switch (job->kind) {
+    case STORE_JOB_LIST:
+      return records_result(job);
+    case STORE_JOB_PUT:
+      return fl_value_new_string(job->records[0].id.c_str());
+    case STORE_JOB_PUT_SEARCH: {
+      FlValue* result = fl_value_new_map();
+      fl_value_set_string_take(
+          result, "id", fl_value_new_string(job->records[0].id.c_str()));
+      fl_value_set_string_take(result, "searches",
+                               fl_value_new_int(job->searches));
+      return result;
+    }
+    case STORE_JOB_USAGE:
+      return fl_value_new_int(job->searches);
+    case STORE_JOB_APPLY_REMOTE: {
+      FlValue* result = fl_value_new_map();
+      fl_value_set_string_take(result, "upserts", records_result(job));
+      fl_value_set_string_take(result, "removals", ids_value(job->ids));
+      return result;
+    }
+    case STORE_JOB_NEXT_BATCH: {
+      if (job->ops.empty()) {
+        return nullptr;
+      }
+      FlValue* ops = fl_value_new_list();
+      for (const HistoryOp& op : job->ops) {
+        FlValue* entry = fl_value_new_map();
+        fl_value_set_string_take(entry, "kind",
+                                 fl_value_new_string(op_kind_name(op.kind)));
+        fl_value_set_string_take(entry, "id",
+                                 fl_value_new_string(op.record.id.c_str()));
+        if (op.kind == HISTORY_OP_PUT) {
+          fl_value_set_string_take(entry, "record", record_value(op.record));
+        } else if (op.kind == HISTORY_OP_USAGE) {
+          fl_value_set_string_take(entry, "searches",
+                                   fl_value_new_int(op.searches));
+          fl_value_set_string_take(entry, "timestamp",
+                                   fl_value_new_int(op.record.timestamp_ms));
+        }
+        fl_value_append_take(ops, entry);
+      }
+      FlValue* result = fl_value_new_map();
+      fl_value_set_string_take(result, "seq", fl_value_new_int(job->seq));
+      fl_value_set_string_take(result, "ops", ops);
+      return result;
+    }
+    case STORE_JOB_STATS: {
+      FlValue* result = fl_value_new_map();
+      fl_value_set_string_take(result, "records",
+                               fl_value_new_int(job->stats.records));
+      fl_value_set_string_take(result, "journalEntries",
+                               fl_value_new_int(job->stats.journal_entries));
+      fl_value_set_string_take(result, "syncedEntries",
+                               fl_value_new_int(job->stats.synced_entries));
+      fl_value_set_string_take(result, "coalescedEntries",
+                               fl_value_new_int(job->stats.coalesced_entries));
+      return result;
+    }
+    case STORE_JOB_REMOVE:
+    case STORE_JOB_CLEAR:
+    case STORE_JOB_FORGET:
+    case STORE_JOB_ACK:
+      return nullptr;
+  }
+  return nullptr;
+}
+
+// Sends the job's result on the main thread and frees it.
+static gboolean respond_cb(gpointer user_data) {
+  StoreJob* job = static_cast<StoreJob*>(user_data);
+
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (job->ok) {
+    g_autoptr(FlValue) result = job_result(job);
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  } else {
+    response = FL_METHOD_RESPONSE(
+        fl_method_error_response_new(kStoreError, job->error.c_str(), nullptr));
+  }
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(job->method_call, response, &error)) {
+    g_warning("Failed to send method call response: %s", error->message);
+  }
+
+  g_object_unref(job->method_call);
+  g_object_unref(job->self);
+  delete job;
+  return G_SOURCE_REMOVE;
+}
+
+// Opens the replica on first use, so startup never waits on the database.
+static HistoryStore* ensure_store(HistoryStorePlugin* self) {
+  if (self->store == nullptr && self->open_error == nullptr) {
+    g_autofree gchar* directory = g_path_get_dirname(self->path);
+    g_mkdir_with_parents(directory, 0700);
+    std::string error;
+    self->store = history_store_open(self->path, &error);
+    if (self->store == nullptr) {
+      g_warning("Cannot open the history store %s: %s", self->path,
+                error.c_str());
+      self->open_error = g_strdup(error.c_str());
+    }
+  }
+  return self->store;
+}
+
+static void run_job_cb(gpointer data, gpointer user_data) {
+  StoreJob* job = static_cast<StoreJob*>(data);
+  HistoryStore* store = ensure_store(job->self);
+  if (store == nullptr) {
+    job->ok = false;
+    job->error = job->self->open_error;
+    g_main_context_invoke(nullptr, respond_cb, job);
+    return;
+  }
+
+  switch (job->kind) {
+    case STORE_JOB_LIST:
+      job->ok = history_store_list(store, job->uid, &job->records);
+      break;
+    case STORE_JOB_PUT:
+      job->ok = history_store_put(store, job->uid, &job->records[0]);
+      break;
+    case STORE_JOB_PUT_SEARCH:
+      job->ok = history_store_put_search(store, job->uid, &job->records[0],
+                                         job->day, &job->searches);
+      break;
+    case STORE_JOB_USAGE:
+      job->ok = history_store_merge_usage(store, job->uid, job->day,
+                                          job->searches, &job->searches);
+      break;
+    case STORE_JOB_REMOVE:
+      job->ok = history_store_remove(store, job->uid, job->ids[0]);
+      break;
+    case STORE_JOB_CLEAR:
+      job->ok = history_store_clear(store, job->uid);
+      break;
+    case STORE_JOB_FORGET:
+      job->ok = history_store_forget(store, job->uid);
+      break;
+    case STORE_JOB_APPLY_REMOTE: {
+      std::vector<HistoryRecord> upserts;
+      std::vector<std::string> removals;
+      upserts.swap(job->records);
+      removals.swap(job->ids);
+      job->ok = history_store_apply_remote(store, job->uid, upserts, removals,
+                                           &job->records, &job->ids);
+      break;
+    }
+    case STORE_JOB_NEXT_BATCH:
+      job->ok = history_store_next_batch(store, job->uid, job->max_ops,
+                                         &job->ops, &job->seq);
+      break;
+    case STORE_JOB_ACK:
+      job->ok = history_store_ack(store, job->uid, job->seq);
+      break;
+    case STORE_JOB_STATS:
+      job->stats = history_store_get_stats(store);
+      job->ok = true;
+      break;
+  }
+  if (!job->ok) {
+    job->error = "The history store could not be updated";
+  }
+
+  g_main_context_invoke(nullptr, respond_cb, job);
+}
+
+// Called when a method call is received from Flutter.
+static void method_call_cb(FlMethodChannel* channel,
+                           FlMethodCall* method_call,
+                           gpointer user_data) {
+  HistoryStorePlugin* self = HISTORY_STORE_PLUGIN(user_data);
+  const gchar* method = fl_method_call_get_name(method_call);
+
+  static const struct {
+    const char* name;
+    StoreJobKind kind;
+  } kMethods[] = {
+      {kListMethod, STORE_JOB_LIST},
+      {kPutMethod, STORE_JOB_PUT},
+      {kPutSearchMethod, STORE_JOB_PUT_SEARCH},
+      {kUsageMethod, STORE_JOB_USAGE},
+      {kRemoveMethod, STORE_JOB_REMOVE},
+      {kClearMethod, STORE_JOB_CLEAR},
+      {kForgetMethod, STORE_JOB_FORGET},
+      {kApplyRemoteMethod, STORE_JOB_APPLY_REMOTE},
+      {kNextBatchMethod, STORE_JOB_NEXT_BATCH},
+      {kAckMethod, STORE_JOB_ACK},
+      {kStatsMethod, STORE_JOB_STATS},
+  };
+
+  g_autoptr(FlMethodResponse) response = nullptr;
+  for (const auto& entry : kMethods) {
+    if (strcmp(method, entry.name) != 0) {
+      continue;
+    }
+    StoreJob* job = new StoreJob();
+    job->kind = entry.kind;
+    job->max_ops = 0;
+    job->seq = 0;
+    job->searches = 0;
+    job->ok = false;
+    if (!read_args(fl_method_call_get_args(method_call), job)) {
+      delete job;
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          kBadArgumentsError, "Expected a uid and the method's arguments",
+          nullptr));
+      break;
+    }
+    job->self = HISTORY_STORE_PLUGIN(g_object_ref(self));
+    job->method_call = FL_METHOD_CALL(g_object_ref(method_call));
+    g_thread_pool_push(self->worker, job, nullptr);
+    return;
+  }
+  if (response == nullptr) {
+    response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+  }
+
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(method_call, response, &error)) {
+    g_warning("Failed to send method call response: %s", error->message);
+  }
+}
+
+static void history_store_plugin_dispose(GObject* object) {
+  HistoryStorePlugin* self = HISTORY_STORE_PLUGIN(object);
+
+  if (self->worker != nullptr) {
+    g_thread_pool_free(self->worker, FALSE, TRUE);
+    self->worker = nullptr;
+  }
+  g_clear_pointer(&self->store, history_store_free);
+  g_clear_pointer(&self->open_error, g_free);
+  g_clear_pointer(&self->path, g_free);
+
+  G_OBJECT_CLASS(history_store_plugin_parent_class)->dispose(object);
+}
+
+static void history_store_plugin_class_init(HistoryStorePluginClass* klass) {
+  G_OBJECT_CLASS(klass)->dispose = history_store_plugin_dispose;
+}
+
+static void history_store_plugin_init(HistoryStorePlugin* self) {
+  self->path = g_build_filename(g_get_user_data_dir(), APPLICATION_ID,
+                                "history.db", nullptr);
+  // A single exclusive thread keeps calls in order and owns the connection.
+  self->worker = g_thread_pool_new(run_job_cb, nullptr, 1, TRUE, nullptr);
+}
+
+void history_store_plugin_register_with_registrar(
+    FlPluginRegistrar* registrar) {
+  HistoryStorePlugin* plugin = HISTORY_STORE_PLUGIN(
+      g_object_new(history_store_plugin_get_type(), nullptr));
+
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  g_autoptr(FlMethodChannel) channel =
+      fl_method_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                            kChannelName, FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(channel, method_call_cb,
+                                            g_object_ref(plugin),
+                                            g_object_unref);
+
+  g_object_unref(plugin);
+}
@@ -0,0 +1,27 @@
+#ifndef RUNNER_HISTORY_STORE_PLUGIN_H_
+#define RUNNER_HISTORY_STORE_PLUGIN_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+G_DECLARE_FINAL_TYPE(HistoryStorePlugin,
+                     history_store_plugin,
+                     HISTORY,
+                     STORE_PLUGIN,
+                     GObject)
+
+/**
+ * history_store_plugin_register_with_registrar:
+ * @registrar: an #FlPluginRegistrar.
+ *
+ * Registers the "echolens/history_store" method channel over the local
+ * #HistoryStore replica. The UI reads and writes the replica with "list",
+ * "put", "remove" and "clear"; "forget" drops a deleted account's replica
+ * without syncing anything. The Dart sync engine drains the journal with
+ * "nextBatch" and "ack" and merges Firestore changes with "applyRemote". All
+ * calls run in order on a single worker thread, which opens the database on
+ * first use.
+ */
+void history_store_plugin_register_with_registrar(
+    FlPluginRegistrar* registrar);
+
+#endif  // RUNNER_HISTORY_STORE_PLUGIN_H_
@@ -0,0 +1,99 @@
+#include "launch_plugin.h"
+
+#include <cstring>
+
+static constexpr char kChannelName[] = "echolens/launch";
+
+static constexpr char kListenMethod[] = "listen";
+static constexpr char kCancelMethod[] = "cancel";
+static constexpr char kSearchMethod[] = "search";
+
+struct _LaunchPlugin {
+  GObject parent_instance;
+
+  FlMethodChannel* channel;
+  // Whether Dart takes queries as they come.
+  gboolean listening;
+};
+
+G_DEFINE_TYPE(LaunchPlugin, launch_plugin, G_TYPE_OBJECT)
+
+// The plugin of the current view; launches may come before it exists.
+static LaunchPlugin* current = nullptr;
+static gchar* pending_query = nullptr;
+
+static void send_search(LaunchPlugin* self, const gchar* query) {
+  g_autoptr(FlValue) args = fl_value_new_map();
+  fl_value_set_string_take(args, "query", fl_value_new_string(query));
+  fl_method_channel_invoke_method(self->channel, kSearchMethod, args, nullptr,
+                                  nullptr, nullptr);
+}
+
+// Called when a method call is received from Flutter.
+static void method_call_cb(FlMethodChannel* channel,
+                           FlMethodCall* method_call,
+                           gpointer user_data) {
+  LaunchPlugin* self = LAUNCH_PLUGIN(user_data);
+  const gchar* method = fl_method_call_get_name(method_call);
+
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (strcmp(method, kListenMethod) == 0) {
+    self->listening = TRUE;
+    g_autoptr(FlValue) result = pending_query != nullptr
+                                    ? fl_value_new_string(pending_query)
+                                    : fl_value_new_null();
+    g_clear_pointer(&pending_query, g_free);
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  } else if (strcmp(method, kCancelMethod) == 0) {
+    self->listening = FALSE;
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+  } else {
+    response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+  }
+
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(method_call, response, &error)) {
+    g_warning("Failed to send method call response: %s", error->message);
+  }
+}
+
+static void launch_plugin_dispose(GObject* object) {
+  LaunchPlugin* self = LAUNCH_PLUGIN(object);
+
+  if (current == self) {
+    current = nullptr;
+  }
+  g_clear_object(&self->channel);
+
+  G_OBJECT_CLASS(launch_plugin_parent_class)->dispose(object);
+}
+
+static void launch_plugin_class_init(LaunchPluginClass* klass) {
+  G_OBJECT_CLASS(klass)->dispose = launch_plugin_dispose;
+}
+
+static void launch_plugin_init(LaunchPlugin* self) {}
+
+void launch_plugin_search(const gchar* query) {
+  if (current != nullptr && current->listening) {
+    send_search(current, query);
+    return;
+  }
+  g_free(pending_query);
+  pending_query = g_strdup(query);
+}
+
+void launch_plugin_register_with_registrar(FlPluginRegistrar* registrar) {
+  LaunchPlugin* plugin =
+      LAUNCH_PLUGIN(g_object_new(launch_plugin_get_type(), nullptr));
+
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  plugin->channel =
+      fl_method_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                            kChannelName, FL_METHOD_CODEC(codec));
+  // The handler owns the plugin, which keeps the channel to send searches
+  // on.
+  fl_method_channel_set_method_call_handler(plugin->channel, method_call_cb,
+                                            plugin, g_object_unref);
+  current = plugin;
+}
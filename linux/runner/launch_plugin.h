@@ -0,0 +1,28 @@
+#ifndef RUNNER_LAUNCH_PLUGIN_H_
+#define RUNNER_LAUNCH_PLUGIN_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+G_DECLARE_FINAL_TYPE(LaunchPlugin, launch_plugin, LAUNCH, PLUGIN, GObject)
+
+/**
+ * launch_plugin_search:
+ * @query: what to search for, e.g. the name given on the command line.
+ *
+ * Hands @query to the search screen: at once if it is listening, or else
+ * when it starts to. A query not yet taken is replaced by a later one.
+ */
+void launch_plugin_search(const gchar* query);
+
+/**
+ * launch_plugin_register_with_registrar:
+ * @registrar: an #FlPluginRegistrar.
+ *
+ * Registers the "echolens/launch" method channel, through which the
+ * queries of launches reach Dart. "listen" replies with the query waiting
+ * to be searched, or null, and has every later one sent to Dart as a
+ * "search" call taking `{query}`; "cancel" holds them back again.
+ */
+void launch_plugin_register_with_registrar(FlPluginRegistrar* registrar);
+
+#endif  // RUNNER_LAUNCH_PLUGIN_H_
@@ -0,0 +1,340 @@
+#include "lazy_plugin.h"
+
+#include <dlfcn.h>
+
+#include <cstring>
+
+typedef void (*RegisterFunc)(FlPluginRegistrar* registrar);
+
+// A message that arrived before the plugin was loaded.
+typedef struct {
+  GBytes* message;
+  FlBinaryMessengerResponseHandle* response_handle;
+} PendingMessage;
+
+typedef struct {
+  FlPluginRegistrar* registrar;
+  FlBinaryMessenger* messenger;
+  gchar* channel;
+  gchar* library;
+  gchar* symbol;
+
+  gboolean loading;
+  GPtrArray* pending;
+
+  // Loaded on the worker thread.
+  void* handle;
+  RegisterFunc register_func;
+
+  // The plugin's own handler for the channel, seen while it registers.
+  FlBinaryMessengerMessageHandler handler;
+  gpointer handler_data;
+} LazyPlugin;
+
+// The messenger a lazy plugin is given. Forwards everything to the engine's
+// messenger, and notes the handler the plugin sets for its channel while it
+// registers.
+G_DECLARE_FINAL_TYPE(LazyMessenger, lazy_messenger, LAZY, MESSENGER, GObject)
+
+struct _LazyMessenger {
+  GObject parent_instance;
+
+  FlBinaryMessenger* messenger;
+  // Set only while the plugin registers.
+  LazyPlugin* plugin;
+};
+
+static void lazy_messenger_iface_init(FlBinaryMessengerInterface* iface);
+
+G_DEFINE_TYPE_WITH_CODE(LazyMessenger,
+                        lazy_messenger,
+                        G_TYPE_OBJECT,
+                        G_IMPLEMENT_INTERFACE(fl_binary_messenger_get_type(),
+                                              lazy_messenger_iface_init))
+
+static void lazy_messenger_set_message_handler_on_channel(
+    FlBinaryMessenger* messenger,
+    const gchar* channel,
+    FlBinaryMessengerMessageHandler handler,
+    gpointer user_data,
+    GDestroyNotify destroy_notify) {
+  LazyMessenger* self = LAZY_MESSENGER(messenger);
+  if (self->plugin != nullptr && strcmp(channel, self->plugin->channel) == 0) {
+    self->plugin->handler = handler;
+    self->plugin->handler_data = user_data;
+  }
+  fl_binary_messenger_set_message_handler_on_channel(
+      self->messenger, channel, handler, user_data, destroy_notify);
+}
+
+static gboolean lazy_messenger_send_response(
+    FlBinaryMessenger* messenger,
+    FlBinaryMessengerResponseHandle* response_handle,
+    GBytes* response,
+    GError** error) {
+  return fl_binary_messenger_send_response(LAZY_MESSENGER(messenger)->messenger,
+                                           response_handle, response, error);
+}
+
+static void lazy_messenger_send_on_channel(FlBinaryMessenger* messenger,
+                                           const gchar* channel,
+                                           GBytes* message,
+                                           GCancellable* cancellable,
+                                           GAsyncReadyCallback callback,
+                                           gpointer user_data) {
+  fl_binary_messenger_send_on_channel(LAZY_MESSENGER(messenger)->messenger,
+                                      channel, message, cancellable, callback,
+                                      user_data);
+}
+
+// The result comes from the engine's messenger, which finishes it.
+static GBytes* lazy_messenger_send_on_channel_finish(
+    FlBinaryMessenger* messenger,
+    GAsyncResult* result,
+    GError** error) {
+  return fl_binary_messenger_send_on_channel_finish(
+      LAZY_MESSENGER(messenger)->messenger, result, error);
+}
+
+static void lazy_messenger_resize_channel(FlBinaryMessenger* messenger,
+                                          const gchar* channel,
+                                          int64_t new_size) {
+  fl_binary_messenger_resize_channel(LAZY_MESSENGER(messenger)->messenger,
+                                     channel, new_size);
+}
+
+static void lazy_messenger_set_warns_on_channel_overflow(
+    FlBinaryMessenger* messenger,
+    const gchar* channel,
+    bool warns) {
+  fl_binary_messenger_set_warns_on_channel_overflow(
+      LAZY_MESSENGER(messenger)->messenger, channel, warns);
+}
+
+// The engine shuts its own messenger down.
+static void lazy_messenger_shutdown(FlBinaryMessenger* messenger) {}
+
+static void lazy_messenger_iface_init(FlBinaryMessengerInterface* iface) {
+  iface->set_message_handler_on_channel =
+      lazy_messenger_set_message_handler_on_channel;
+  iface->send_response = lazy_messenger_send_response;
+  iface->send_on_channel = lazy_messenger_send_on_channel;
+  iface->send_on_channel_finish = lazy_messenger_send_on_channel_finish;
+  iface->resize_channel = lazy_messenger_resize_channel;
+  iface->set_warns_on_channel_overflow =
+      lazy_messenger_set_warns_on_channel_overflow;
+  iface->shutdown = lazy_messenger_shutdown;
+}
+
+static void lazy_messenger_dispose(GObject* object) {
+  g_clear_object(&LAZY_MESSENGER(object)->messenger);
+  G_OBJECT_CLASS(lazy_messenger_parent_class)->dispose(object);
+}
+
+static void lazy_messenger_class_init(LazyMessengerClass* klass) {
+  G_OBJECT_CLASS(klass)->dispose = lazy_messenger_dispose;
+}
+
+static void lazy_messenger_init(LazyMessenger* self) {}
+
+// The registrar a lazy plugin registers with: the engine's, but with a
+// #LazyMessenger.
+G_DECLARE_FINAL_TYPE(LazyRegistrar, lazy_registrar, LAZY, REGISTRAR, GObject)
+
+struct _LazyRegistrar {
+  GObject parent_instance;
+
+  FlPluginRegistrar* registrar;
+  LazyMessenger* messenger;
+};
+
+static void lazy_registrar_iface_init(FlPluginRegistrarInterface* iface);
+
+G_DEFINE_TYPE_WITH_CODE(LazyRegistrar,
+                        lazy_registrar,
+                        G_TYPE_OBJECT,
+                        G_IMPLEMENT_INTERFACE(fl_plugin_registrar_get_type(),
+                                              lazy_registrar_iface_init))
+
+static FlBinaryMessenger* lazy_registrar_get_messenger(
+    FlPluginRegistrar* registrar) {
+  return FL_BINARY_MESSENGER(LAZY_REGISTRAR(registrar)->messenger);
+}
+
+static FlTextureRegistrar* lazy_registrar_get_texture_registrar(
+    FlPluginRegistrar* registrar) {
+  return fl_plugin_registrar_get_texture_registrar(
+      LAZY_REGISTRAR(registrar)->registrar);
+}
+
+static FlView* lazy_registrar_get_view(FlPluginRegistrar* registrar) {
+  return fl_plugin_registrar_get_view(LAZY_REGISTRAR(registrar)->registrar);
+}
+
+static void lazy_registrar_iface_init(FlPluginRegistrarInterface* iface) {
+  iface->get_messenger = lazy_registrar_get_messenger;
+  iface->get_texture_registrar = lazy_registrar_get_texture_registrar;
+  iface->get_view = lazy_registrar_get_view;
+}
+
+static void lazy_registrar_dispose(GObject* object) {
+  LazyRegistrar* self = LAZY_REGISTRAR(object);
+  g_clear_object(&self->registrar);
+  g_clear_object(&self->messenger);
+  G_OBJECT_CLASS(lazy_registrar_parent_class)->dispose(object);
+}
+
+static void lazy_registrar_class_init(LazyRegistrarClass* klass) {
+  G_OBJECT_CLASS(klass)->dispose = lazy_registrar_dispose;
+}
+
+static void lazy_registrar_init(LazyRegistrar* self) {}
+
+static void pending_message_free(gpointer data) {
+  PendingMessage* pending = static_cast<PendingMessage*>(data);
+  g_bytes_unref(pending->message);
+  g_object_unref(pending->response_handle);
+  g_free(pending);
+}
+
+static void lazy_plugin_free(LazyPlugin* plugin) {
+  g_object_unref(plugin->registrar);
+  g_object_unref(plugin->messenger);
+  g_free(plugin->channel);
+  g_free(plugin->library);
+  g_free(plugin->symbol);
+  g_ptr_array_unref(plugin->pending);
+  g_free(plugin);
+}
+
+// Plugins are bundled next to the executable, which may be started from
+// anywhere.
+static gchar* library_path(const gchar* library) {
+  g_autofree gchar* executable = g_file_read_link("/proc/self/exe", nullptr);
+  if (executable == nullptr) {
+    return g_strdup(library);
+  }
+  g_autofree gchar* directory = g_path_get_dirname(executable);
+  return g_build_filename(directory, "lib", library, nullptr);
+}
+
+// Loading a plugin maps its dependencies too, which may take a while.
+static void load_thread_cb(GTask* task,
+                           gpointer source_object,
+                           gpointer task_data,
+                           GCancellable* cancellable) {
+  LazyPlugin* plugin = static_cast<LazyPlugin*>(task_data);
+  g_autofree gchar* path = library_path(plugin->library);
+  plugin->handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+  if (plugin->handle == nullptr) {
+    g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_FAILED, "%s",
+                            dlerror());
+    return;
+  }
+  plugin->register_func =
+      reinterpret_cast<RegisterFunc>(dlsym(plugin->handle, plugin->symbol));
+  if (plugin->register_func == nullptr) {
+    g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                            "%s has no %s", plugin->library, plugin->symbol);
+    return;
+  }
+  g_task_return_boolean(task, TRUE);
+}
+
+// Registers the loaded plugin. Its handler replaces ours on the channel, so
+// messages from now on never pass through here.
+static void register_plugin(LazyPlugin* plugin) {
+  LazyRegistrar* registrar =
+      LAZY_REGISTRAR(g_object_new(lazy_registrar_get_type(), nullptr));
+  registrar->registrar = FL_PLUGIN_REGISTRAR(g_object_ref(plugin->registrar));
+  registrar->messenger =
+      LAZY_MESSENGER(g_object_new(lazy_messenger_get_type(), nullptr));
+  registrar->messenger->messenger =
+      FL_BINARY_MESSENGER(g_object_ref(plugin->messenger));
+
+  registrar->messenger->plugin = plugin;
+  plugin->register_func(FL_PLUGIN_REGISTRAR(registrar));
+  registrar->messenger->plugin = nullptr;
+  // The plugin keeps what it needs of the registrar, such as the messenger.
+  g_object_unref(registrar);
+}
+
+static void load_done_cb(GObject* object,
+                         GAsyncResult* result,
+                         gpointer user_data) {
+  LazyPlugin* plugin = static_cast<LazyPlugin*>(
+      g_task_get_task_data(G_TASK(result)));
+  g_autoptr(GError) error = nullptr;
+  if (g_task_propagate_boolean(G_TASK(result), &error)) {
+    register_plugin(plugin);
+    if (plugin->handler == nullptr) {
+      g_warning("%s did not handle %s", plugin->library, plugin->channel);
+    }
+  } else {
+    g_warning("Failed to load %s: %s", plugin->library, error->message);
+  }
+  if (plugin->handler == nullptr) {
+    // Without a handler the engine answers that nothing is implemented.
+    fl_binary_messenger_set_message_handler_on_channel(
+        plugin->messenger, plugin->channel, nullptr, nullptr, nullptr);
+  }
+
+  // Replay what arrived while loading, in order.
+  for (guint i = 0; i < plugin->pending->len; i++) {
+    PendingMessage* pending =
+        static_cast<PendingMessage*>(g_ptr_array_index(plugin->pending, i));
+    if (plugin->handler != nullptr) {
+      plugin->handler(plugin->messenger, plugin->channel, pending->message,
+                      pending->response_handle, plugin->handler_data);
+      continue;
+    }
+    g_autoptr(GError) response_error = nullptr;
+    if (!fl_binary_messenger_send_response(plugin->messenger,
+                                           pending->response_handle, nullptr,
+                                           &response_error)) {
+      g_warning("Failed to send response: %s", response_error->message);
+    }
+  }
+  lazy_plugin_free(plugin);
+}
+
+static void message_cb(FlBinaryMessenger* messenger,
+                       const gchar* channel,
+                       GBytes* message,
+                       FlBinaryMessengerResponseHandle* response_handle,
+                       gpointer user_data) {
+  LazyPlugin* plugin = static_cast<LazyPlugin*>(user_data);
+  PendingMessage* pending = g_new0(PendingMessage, 1);
+  pending->message = g_bytes_ref(message);
+  pending->response_handle =
+      FL_BINARY_MESSENGER_RESPONSE_HANDLE(g_object_ref(response_handle));
+  g_ptr_array_add(plugin->pending, pending);
+  if (plugin->loading) {
+    return;
+  }
+
+  plugin->loading = TRUE;
+  g_autoptr(GTask) task = g_task_new(nullptr, nullptr, load_done_cb, nullptr);
+  g_task_set_task_data(task, plugin, nullptr);
+  g_task_run_in_thread(task, load_thread_cb);
+}
+
+void lazy_plugin_register(FlPluginRegistry* registry,
+                          const char* plugin_name,
+                          const char* channel,
+                          const char* library,
+                          const char* symbol) {
+  LazyPlugin* plugin = g_new0(LazyPlugin, 1);
+  plugin->registrar =
+      fl_plugin_registry_get_registrar_for_plugin(registry, plugin_name);
+  plugin->messenger = FL_BINARY_MESSENGER(
+      g_object_ref(fl_plugin_registrar_get_messenger(plugin->registrar)));
+  plugin->channel = g_strdup(channel);
+  plugin->library = g_strdup(library);
+  plugin->symbol = g_strdup(symbol);
+  plugin->pending = g_ptr_array_new_with_free_func(pending_message_free);
+
+  // The plugin frees itself once loaded; replacing this handler must not.
+  fl_binary_messenger_set_message_handler_on_channel(
+      plugin->messenger, channel, message_cb, plugin, nullptr);
+}
@@ -0,0 +1,30 @@
+#ifndef RUNNER_LAZY_PLUGIN_H_
+#define RUNNER_LAZY_PLUGIN_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+/**
+ * lazy_plugin_register:
+ * @registry: an #FlPluginRegistry.
+ * @plugin_name: the plugin's name, as given to
+ * fl_plugin_registry_get_registrar_for_plugin().
+ * @channel: the method channel the plugin serves.
+ * @library: the file name of the plugin's shared library, found in the
+ * bundle's lib directory.
+ * @symbol: the plugin's register_with_registrar function.
+ *
+ * Registers a plugin without loading it. The first message on @channel loads
+ * @library on a worker thread, registers the plugin on the main thread and
+ * hands it that message and any sent meanwhile, in order; later messages go
+ * straight to the plugin. The plugin registers with a registrar whose
+ * messenger forwards to the engine's and notes the handler set for
+ * @channel. A plugin that cannot be loaded answers every message as not
+ * implemented.
+ */
+void lazy_plugin_register(FlPluginRegistry* registry,
+                          const char* plugin_name,
+                          const char* channel,
+                          const char* library,
+                          const char* symbol);
+
+#endif  // RUNNER_LAZY_PLUGIN_H_
@@ -1,6 +1,13 @@
+#include "frame_stats.h"
 #include "my_application.h"
+#include "startup_trace.h"
 
 int main(int argc, char** argv) {
+  startup_trace_init(argc, argv);
+  frame_stats_init(argc, argv);
+
+  gint64 start = startup_trace_begin();
   g_autoptr(MyApplication) app = my_application_new();
+  startup_trace_end("my_application_new", start);
   return g_application_run(G_APPLICATION(app), argc, argv);
 }
@@ -0,0 +1,463 @@
+#include "markdown_document.h"
+
+#include <glib.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace {
+
+constexpr uint8_t kMaxListDepth = 7;
+constexpr size_t kMaxOrderedDigits = 9;
+
+// Length of @text in UTF-16 code units. @text must be valid UTF-8.
+uint32_t utf16_length(const char* text, size_t length) {
+  uint32_t units = 0;
+  for (size_t i = 0; i < length; i++) {
+    unsigned char c = static_cast<unsigned char>(text[i]);
+    if ((c & 0xC0) != 0x80) {
+      // Code points outside the BMP take a surrogate pair.
+      units += c >= 0xF0 ? 2 : 1;
+    }
+  }
+  return units;
+}
+
+// Builds the spans of one block at a time.
+class Builder {
+ public:
+  explicit Builder(MarkdownDocument* document) : document_(document) {}
+
+  void begin_block(MarkdownBlockKind kind, uint8_t level, uint32_t number) {
+    MarkdownBlock block;
+    block.kind = kind;
+    block.level = level;
+    block.number = number;
+    block.first_span = static_cast<uint32_t>(document_->spans.size());
+    block.span_count = 0;
+    document_->blocks.push_back(block);
+  }
+
+  // Appends @length bytes of @text to the current block in @style.
+  void append(const char* text, size_t length, uint32_t style, int32_t link) {
+    if (length == 0) {
+      return;
+    }
+    uint32_t offset = document_->text_units;
+    uint32_t units = append_text(text, length);
+    MarkdownBlock& block = document_->blocks.back();
+    if (block.span_count > 0 && link < 0) {
+      MarkdownSpan& last = document_->spans.back();
+      if (last.style == style && last.link < 0 &&
+          last.offset + last.length == offset) {
+        last.length += units;
+        return;
+      }
+    }
+    document_->spans.push_back({offset, units, style, link});
+    block.span_count++;
+  }
+
+  int32_t add_link(const char* target, size_t length) {
+    uint32_t offset = document_->text_units;
+    uint32_t units = append_text(target, length);
+    document_->links.push_back({offset, units});
+    return static_cast<int32_t>(document_->links.size() - 1);
+  }
+
+ private:
+  uint32_t append_text(const char* text, size_t length) {
+    uint32_t units = utf16_length(text, length);
+    document_->text.append(text, length);
+    document_->text_units += units;
+    return units;
+  }
+
+  MarkdownDocument* document_;
+};
+
+bool is_word_char(char c) {
+  return g_ascii_isalnum(c) || (static_cast<unsigned char>(c) & 0x80) != 0;
+}
+
+// Whether a run of @delimiter (one or two characters) at @i can open
+// emphasis: it must be followed by a non-space and closed later on.
+bool can_open(const std::string& text, size_t i, const char* delimiter) {
+  size_t width = strlen(delimiter);
+  size_t after = i + width;
+  if (after >= text.size() || text[after] == ' ' || text[after] == '\n') {
+    return false;
+  }
+  // Intraword underscores, as in snake_case, are literal.
+  if (delimiter[0] == '_' && i > 0 && is_word_char(text[i - 1])) {
+    return false;
+  }
+  for (size_t close = text.find(delimiter, after + 1);
+       close != std::string::npos; close = text.find(delimiter, close + 1)) {
+    if (text[close - 1] == ' ') {
+      continue;
+    }
+    // A single delimiter does not close on half of a double one.
+    if (width == 1 && close + 1 < text.size() &&
+        text[close + 1] == delimiter[0]) {
+      close++;
+      continue;
+    }
+    return true;
+  }
+  return false;
+}
+
+// Parses the inline content of one block into spans.
+void parse_inline(Builder* builder, const std::string& text) {
+  uint32_t style = 0;
+  std::string run;
+  auto flush = [&]() {
+    builder->append(run.data(), run.size(), style, -1);
+    run.clear();
+  };
+  auto toggle = [&](uint32_t bit) {
+    flush();
+    style ^= bit;
+  };
+
+  size_t i = 0;
+  while (i < text.size()) {
+    char c = text[i];
+    if (c == '\\' && i + 1 < text.size() &&
+        strchr("\\`*_[]()#+-.!>", text[i + 1]) != nullptr) {
+      run += text[i + 1];
+      i += 2;
+    } else if (c == '`') {
+      size_t width =
+          std::min(text.find_first_not_of('`', i), text.size()) - i;
+      std::string fence(width, '`');
+      size_t close = text.find(fence, i + width);
+      while (close != std::string::npos && close + width < text.size() &&
+             text[close + width] == '`') {
+        close = text.find(fence, text.find_first_not_of('`', close));
+      }
+      if (close == std::string::npos) {
+        run += fence;
+        i += width;
+        continue;
+      }
+      size_t start = i + width;
+      size_t end = close;
+      if (end - start >= 2 && text[start] == ' ' && text[end - 1] == ' ') {
+        start++;
+        end--;
+      }
+      flush();
+      builder->append(text.data() + start, end - start,
+                      style | MARKDOWN_STYLE_CODE, -1);
+      i = close + width;
+    } else if ((c == '*' || c == '_') && i + 1 < text.size() &&
+               text[i + 1] == c) {
+      const char delimiter[] = {c, c, '\0'};
+      if ((style & MARKDOWN_STYLE_BOLD) != 0 ||
+          can_open(text, i, delimiter)) {
+        toggle(MARKDOWN_STYLE_BOLD);
+      } else {
+        run.append(delimiter);
+      }
+      i += 2;
+    } else if (c == '*' || c == '_') {
+      const char delimiter[] = {c, '\0'};
+      if ((style & MARKDOWN_STYLE_ITALIC) != 0 ||
+          can_open(text, i, delimiter)) {
+        toggle(MARKDOWN_STYLE_ITALIC);
+      } else {
+        run += c;
+      }
+      i++;
+    } else if (c == '[') {
+      size_t close = text.find(']', i + 1);
+      size_t end = std::string::npos;
+      if (close != std::string::npos && text.compare(close, 2, "](") == 0) {
+        end = text.find(')', close);
+      }
+      if (end == std::string::npos) {
+        run += c;
+        i++;
+        continue;
+      }
+      flush();
+      int32_t link =
+          builder->add_link(text.data() + close + 2, end - close - 2);
+      builder->append(text.data() + i + 1, close - i - 1,
+                      style | MARKDOWN_STYLE_LINK, link);
+      i = end + 1;
+    } else if (c == '<' && (text.compare(i + 1, 7, "http://") == 0 ||
+                            text.compare(i + 1, 8, "https://") == 0)) {
+      size_t end = text.find('>', i);
+      if (end == std::string::npos || text.find(' ', i) < end) {
+        run += c;
+        i++;
+        continue;
+      }
+      flush();
+      const char* target = text.data() + i + 1;
+      size_t length = end - i - 1;
+      int32_t link = builder->add_link(target, length);
+      builder->append(target, length, style | MARKDOWN_STYLE_LINK, link);
+      i = end + 1;
+    } else {
+      run += c;
+      i++;
+    }
+  }
+  // Emphasis still open here was checked to close, so only a malformed
+  // nesting leaves it open; the text is kept either way.
+  flush();
+}
+
+// A block whose lines are still being collected.
+struct Pending {
+  bool open = false;
+  MarkdownBlockKind kind = MARKDOWN_BLOCK_PARAGRAPH;
+  uint8_t level = 0;
+  uint32_t number = 0;
+  std::string text;
+};
+
+// Counts leading spaces, with tabs to the next multiple of four.
+size_t indent_width(const std::string& line, size_t* first) {
+  size_t width = 0;
+  size_t i = 0;
+  for (; i < line.size() && (line[i] == ' ' || line[i] == '\t'); i++) {
+    width = line[i] == '\t' ? (width / 4 + 1) * 4 : width + 1;
+  }
+  *first = i;
+  return width;
+}
+
+bool is_rule(const std::string& line, size_t first) {
+  char marker = line[first];
+  if (marker != '-' && marker != '*' && marker != '_') {
+    return false;
+  }
+  int count = 0;
+  for (size_t i = first; i < line.size(); i++) {
+    if (line[i] == marker) {
+      count++;
+    } else if (line[i] != ' ' && line[i] != '\t') {
+      return false;
+    }
+  }
+  return count >= 3;
+}
+
+}  // namespace
+
+void markdown_document_parse(const char* markdown,
+                             size_t length,
+                             MarkdownDocument* document) {
+  document->blocks.clear();
+  document->spans.clear();
+  document->links.clear();
+  document->text.clear();
+  document->text_units = 0;
+
+  // Offsets are counted in UTF-16 units, which needs well-formed UTF-8.
+  g_autofree gchar* valid = nullptr;
+  if (!g_utf8_validate(markdown, length, nullptr)) {
+    valid = g_utf8_make_valid(markdown, length);
+    markdown = valid;
+    length = strlen(valid);
+  }
+  document->text.reserve(length);
+
+  Builder builder(document);
+  Pending pending;
+  auto flush = [&]() {
+    if (!pending.open) {
+      return;
+    }
+    builder.begin_block(pending.kind, pending.level, pending.number);
+    parse_inline(&builder, pending.text);
+    pending = Pending();
+  };
+  auto start = [&](MarkdownBlockKind kind, uint8_t level, uint32_t number,
+                   const std::string& text) {
+    flush();
+    pending.open = true;
+    pending.kind = kind;
+    pending.level = level;
+    pending.number = number;
+    pending.text = text;
+  };
+
+  bool in_code = false;
+  std::string code_fence;
+  std::string code;
+
+  size_t line_start = 0;
+  while (line_start <= length) {
+    const char* newline = static_cast<const char*>(
+        memchr(markdown + line_start, '\n', length - line_start));
+    size_t line_end =
+        newline != nullptr ? static_cast<size_t>(newline - markdown) : length;
+    std::string line(markdown + line_start, line_end - line_start);
+    line_start = line_end + 1;
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+
+    size_t first;
+    size_t indent = indent_width(line, &first);
+    bool blank = first == line.size();
+
+    if (in_code) {
+      if (!blank && line.compare(first, code_fence.size(), code_fence) == 0 &&
+          line.find_first_not_of(code_fence[0], first) == std::string::npos) {
+        builder.begin_block(MARKDOWN_BLOCK_CODE, 0, 0);
+        if (!code.empty()) {
+          code.pop_back();  // The last newline.
+        }
+        builder.append(code.data(), code.size(), MARKDOWN_STYLE_CODE, -1);
+        code.clear();
+        in_code = false;
+      } else {
+        code += line;
+        code += '\n';
+      }
+      continue;
+    }
+
+    if (blank) {
+      flush();
+      continue;
+    }
+
+    if (line.compare(first, 3, "```") == 0 ||
+        line.compare(first, 3, "~~~") == 0) {
+      flush();
+      size_t end = line.find_first_not_of(line[first], first);
+      code_fence = line.substr(first, std::min(end, line.size()) - first);
+      in_code = true;
+      continue;
+    }
+
+    size_t hashes =
+        std::min(line.find_first_not_of('#', first), line.size()) - first;
+    if (line[first] == '#' && hashes <= 6 &&
+        (first + hashes == line.size() || line[first + hashes] == ' ')) {
+      std::string text = line.substr(std::min(first + hashes + 1, line.size()));
+      // Closing hashes are not part of the heading.
+      size_t last = text.find_last_not_of("# ");
+      text.erase(last == std::string::npos ? 0 : last + 1);
+      start(MARKDOWN_BLOCK_HEADING, static_cast<uint8_t>(hashes), 0, text);
+      flush();
+      continue;
+    }
+
+    if (is_rule(line, first)) {
+      flush();
+      builder.begin_block(MARKDOWN_BLOCK_RULE, 0, 0);
+      continue;
+    }
+
+    uint8_t depth =
+        static_cast<uint8_t>(std::min<size_t>(indent / 2, kMaxListDepth));
+    if (strchr("-*+", line[first]) != nullptr && first + 1 < line.size() &&
+        line[first + 1] == ' ') {
+      start(MARKDOWN_BLOCK_BULLET, depth, 0, line.substr(first + 2));
+      continue;
+    }
+
+    size_t digits =
+        std::min(line.find_first_not_of("0123456789", first), line.size()) -
+        first;
+    size_t marker = first + digits;
+    if (digits > 0 && digits <= kMaxOrderedDigits && marker + 1 < line.size() &&
+        (line[marker] == '.' || line[marker] == ')') &&
+        line[marker + 1] == ' ') {
+      uint32_t number = static_cast<uint32_t>(
+          g_ascii_strtoull(line.c_str() + first, nullptr, 10));
+      start(MARKDOWN_BLOCK_ORDERED, depth, number, line.substr(marker + 2));
+      continue;
+    }
+
+    if (line[first] == '>') {
+      size_t content = first + 1;
+      if (content < line.size() && line[content] == ' ') {
+        content++;
+      }
+      std::string text = line.substr(content);
+      if (pending.open && pending.kind == MARKDOWN_BLOCK_QUOTE) {
+        pending.text += ' ';
+        pending.text += text;
+      } else {
+        start(MARKDOWN_BLOCK_QUOTE, 0, 0, text);
+      }
+      continue;
+    }
+
+    std::string text = line.substr(first);
+    if (!pending.open) {
+      start(MARKDOWN_BLOCK_PARAGRAPH, 0, 0, text);
+      continue;
+    }
+    // A continuation line. Two trailing spaces or a backslash make a hard
+    // break; anything else is a soft break, shown as a space.
+    std::string& joined = pending.text;
+    size_t kept = joined.find_last_not_of(' ');
+    bool hard = joined.size() - (kept + 1) >= 2;
+    joined.erase(kept + 1);
+    if (!joined.empty() && joined.back() == '\\') {
+      joined.pop_back();
+      hard = true;
+    }
+    joined += hard ? '\n' : ' ';
+    joined += text;
+  }
+
+  flush();
+  if (in_code) {
+    // An unclosed fence runs to the end of the document.
+    builder.begin_block(MARKDOWN_BLOCK_CODE, 0, 0);
+    if (!code.empty()) {
+      code.pop_back();
+    }
+    builder.append(code.data(), code.size(), MARKDOWN_STYLE_CODE, -1);
+  }
+}
+
+static void append_u32(uint32_t value, std::vector<uint8_t>* out) {
+  for (int shift = 0; shift < 32; shift += 8) {
+    out->push_back(static_cast<uint8_t>(value >> shift));
+  }
+}
+
+std::vector<uint8_t> markdown_document_pack(const MarkdownDocument& document) {
+  std::vector<uint8_t> packed;
+  packed.reserve(16 + document.blocks.size() * 16 +
+                 document.spans.size() * 16 + document.links.size() * 8 +
+                 document.text.size());
+  append_u32(static_cast<uint32_t>(document.blocks.size()), &packed);
+  append_u32(static_cast<uint32_t>(document.spans.size()), &packed);
+  append_u32(static_cast<uint32_t>(document.links.size()), &packed);
+  append_u32(static_cast<uint32_t>(document.text.size()), &packed);
+  for (const MarkdownBlock& block : document.blocks) {
+    packed.push_back(block.kind);
+    packed.push_back(block.level);
+    packed.push_back(0);
+    packed.push_back(0);
+    append_u32(block.number, &packed);
+    append_u32(block.first_span, &packed);
+    append_u32(block.span_count, &packed);
+  }
+  for (const MarkdownSpan& span : document.spans) {
+    append_u32(span.offset, &packed);
+    append_u32(span.length, &packed);
+    append_u32(span.style, &packed);
+    append_u32(static_cast<uint32_t>(span.link), &packed);
+  }
+  for (const MarkdownLink& link : document.links) {
+    append_u32(link.offset, &packed);
+    append_u32(link.length, &packed);
+  }
+  packed.insert(packed.end(), document.text.begin(), document.text.end());
+  return packed;
+}
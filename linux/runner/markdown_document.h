@@ -0,0 +1,96 @@
+#ifndef RUNNER_MARKDOWN_DOCUMENT_H_
+#define RUNNER_MARKDOWN_DOCUMENT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+typedef enum {
+  MARKDOWN_BLOCK_PARAGRAPH,
+  MARKDOWN_BLOCK_HEADING,
+  MARKDOWN_BLOCK_BULLET,
+  MARKDOWN_BLOCK_ORDERED,
+  MARKDOWN_BLOCK_QUOTE,
+  MARKDOWN_BLOCK_CODE,
+  MARKDOWN_BLOCK_RULE,
+} MarkdownBlockKind;
+
+typedef enum {
+  MARKDOWN_STYLE_BOLD = 1 << 0,
+  MARKDOWN_STYLE_ITALIC = 1 << 1,
+  MARKDOWN_STYLE_CODE = 1 << 2,
+  MARKDOWN_STYLE_LINK = 1 << 3,
+} MarkdownStyle;
+
+struct MarkdownBlock {
+  uint8_t kind;
+  // Heading level from 1, or list nesting depth from 0.
+  uint8_t level;
+  // The number of an ordered list item.
+  uint32_t number;
+  // The block's spans are spans[first_span, first_span + span_count).
+  uint32_t first_span;
+  uint32_t span_count;
+};
+
+// A run of text with one style. Offsets and lengths count UTF-16 code units
+// of MarkdownDocument.text, so that Dart can take substrings directly.
+struct MarkdownSpan {
+  uint32_t offset;
+  uint32_t length;
+  uint32_t style;
+  // Index into MarkdownDocument.links for MARKDOWN_STYLE_LINK, else -1.
+  int32_t link;
+};
+
+// A link target, as a range of MarkdownDocument.text in UTF-16 code units.
+struct MarkdownLink {
+  uint32_t offset;
+  uint32_t length;
+};
+
+// A parsed answer as flat arrays: blocks in reading order, the spans of all
+// blocks back to back, and every character of the document, link targets
+// included, in one string.
+struct MarkdownDocument {
+  std::vector<MarkdownBlock> blocks;
+  std::vector<MarkdownSpan> spans;
+  std::vector<MarkdownLink> links;
+  std::string text;
+  // Length of text in UTF-16 code units.
+  uint32_t text_units;
+};
+
+/**
+ * markdown_document_parse:
+ * @markdown: UTF-8 Markdown, in the subset Gemini produces.
+ * @length: length of @markdown in bytes.
+ * @document: (out): receives the parsed document.
+ *
+ * Parses ATX headings, paragraphs with soft and hard line breaks, nested
+ * bullet and ordered lists, block quotes, fenced code and thematic breaks,
+ * with bold, italic, code spans, links and backslash escapes inline.
+ * Emphasis that is not closed within its block is kept as literal text.
+ */
+void markdown_document_parse(const char* markdown,
+                             size_t length,
+                             MarkdownDocument* document);
+
+/**
+ * markdown_document_pack:
+ * @document: a parsed document.
+ *
+ * Packs @document into the little-endian message decoded by MarkdownDocument
+ * on the Dart side: u32 block, span and link counts and the UTF-8 length of
+ * the text; 16 bytes per block (u8 kind, u8 level, u16 padding, u32 number,
+ * u32 first span, u32 span count); 16 bytes per span (u32 offset, u32
+ * length, u32 style, i32 link); 8 bytes per link (u32 offset, u32 length);
+ * then the UTF-8 text.
+ *
+ * Returns: the packed bytes.
+ */
+std::vector<uint8_t> markdown_document_pack(const MarkdownDocument& document);
+
+#endif  // RUNNER_MARKDOWN_DOCUMENT_H_
@@ -5,7 +5,13 @@
 #include <gdk/gdkx.h>
 #endif
 
+#include "bundled_fonts.h"
 #include "flutter/generated_plugin_registrant.h"
+#include "frame_stats.h"
+#include "launch_plugin.h"
+#include "runner_plugins.h"
+#include "session_snapshot_plugin.h"
+#include "startup_trace.h"
 
 struct _MyApplication {
   GtkApplication parent_instance;
@@ -14,14 +20,70 @@ struct _MyApplication {
 
 G_DEFINE_TYPE(MyApplication, my_application, GTK_TYPE_APPLICATION)
 
+// Action through which later launches in single-instance mode hand their
+// query to the running instance.
+static constexpr char kLaunchAction[] = "launch";
+
+#if GLIB_CHECK_VERSION(2, 74, 0)
+static constexpr GApplicationFlags kSingleInstanceFlags =
+    G_APPLICATION_DEFAULT_FLAGS;
+#else
+static constexpr GApplicationFlags kSingleInstanceFlags =
+    G_APPLICATION_FLAGS_NONE;
+#endif
+
+static gboolean single_instance_requested(gchar** arguments) {
+  const gchar* variable = g_getenv(kSingleInstanceEnv);
+  if (variable != nullptr && variable[0] != '\0' &&
+      g_strcmp0(variable, "0") != 0) {
+    return TRUE;
+  }
+  return g_strv_contains(arguments, kSingleInstanceArgument);
+}
+
+// Returns the query of a launch in the form `echolens "Jane Roe"`: the one
+// argument that is not an option. With none, or with more than one, there is
+// nothing to search, since the rest may be meant for the engine.
+static gchar* query_from_arguments(gchar** arguments) {
+  const gchar* query = nullptr;
+  for (gchar** argument = arguments; *argument != nullptr; argument++) {
+    if ((*argument)[0] == '-') {
+      continue;
+    }
+    if (query != nullptr) {
+      return g_strdup("");
+    }
+    query = *argument;
+  }
+  return g_strdup(query != nullptr ? query : "");
+}
+
+// Appends @argument to those main() receives in Dart.
+static void add_dart_entrypoint_argument(MyApplication* self,
+                                         const gchar* argument) {
+  guint length = self->dart_entrypoint_arguments != nullptr
+                     ? g_strv_length(self->dart_entrypoint_arguments)
+                     : 0;
+  self->dart_entrypoint_arguments =
+      g_renew(char*, self->dart_entrypoint_arguments, length + 2);
+  self->dart_entrypoint_arguments[length] = g_strdup(argument);
+  self->dart_entrypoint_arguments[length + 1] = nullptr;
+}
+
 // Called when first Flutter frame received.
 static void first_frame_cb(MyApplication* self, FlView* view) {
+  startup_trace_mark("first_frame");
+  gint64 start = startup_trace_begin();
   gtk_widget_show(gtk_widget_get_toplevel(GTK_WIDGET(view)));
+  startup_trace_end("show_window", start);
+  startup_trace_flush();
 }
 
 // Implements GApplication::activate.
 static void my_application_activate(GApplication* application) {
   MyApplication* self = MY_APPLICATION(application);
+  gint64 activate_start = startup_trace_begin();
+  gint64 start = startup_trace_begin();
   GtkWindow* window =
       GTK_WINDOW(gtk_application_window_new(GTK_APPLICATION(application)));
 
@@ -53,12 +115,15 @@ static void my_application_activate(GApplication* application) {
   }
 
   gtk_window_set_default_size(window, 1280, 720);
+  startup_trace_end("create_window", start);
 
   g_autoptr(FlDartProject) project = fl_dart_project_new();
   fl_dart_project_set_dart_entrypoint_arguments(
       project, self->dart_entrypoint_arguments);
 
+  start = startup_trace_begin();
   FlView* view = fl_view_new(project);
+  startup_trace_end("fl_view_new", start);
   GdkRGBA background_color;
   // Background defaults to black, override it here if necessary, e.g. #00000000
   // for transparent.
@@ -71,11 +136,44 @@ static void my_application_activate(GApplication* application) {
   // Requires the view to be realized so we can start rendering.
   g_signal_connect_swapped(view, "first-frame", G_CALLBACK(first_frame_cb),
                            self);
+  start = startup_trace_begin();
   gtk_widget_realize(GTK_WIDGET(view));
+  startup_trace_end("gtk_widget_realize", start);
+  frame_stats_watch(GTK_WIDGET(view));
 
+  start = startup_trace_begin();
+#ifdef ECHOLENS_LAZY_PLUGINS
+  runner_register_pub_plugins(FL_PLUGIN_REGISTRY(view));
+#else
   fl_register_plugins(FL_PLUGIN_REGISTRY(view));
+#endif
+  startup_trace_end("fl_register_plugins", start);
+  start = startup_trace_begin();
+  runner_register_plugins(FL_PLUGIN_REGISTRY(view));
+  startup_trace_end("runner_register_plugins", start);
 
   gtk_widget_grab_focus(GTK_WIDGET(view));
+  startup_trace_end("my_application_activate", activate_start);
+}
+
+// Called in the running instance when a later launch forwards its query.
+static void launch_cb(GSimpleAction* action,
+                      GVariant* parameter,
+                      gpointer user_data) {
+  GApplication* application = G_APPLICATION(user_data);
+  GtkWindow* window =
+      gtk_application_get_active_window(GTK_APPLICATION(application));
+  if (window == nullptr) {
+    g_application_activate(application);
+  } else if (gtk_widget_get_visible(GTK_WIDGET(window))) {
+    // Before its first frame, first_frame_cb() shows the window instead.
+    gtk_window_present(window);
+  }
+
+  const gchar* query = g_variant_get_string(parameter, nullptr);
+  if (query[0] != '\0') {
+    launch_plugin_search(query);
+  }
 }
 
 // Implements GApplication::local_command_line.
@@ -86,13 +184,39 @@ static gboolean my_application_local_command_line(GApplication* application,
   // Strip out the first argument as it is the binary name.
   self->dart_entrypoint_arguments = g_strdupv(*arguments + 1);
 
+  // Uniqueness is settled by registering: the first instance owns the
+  // application ID on the session bus, and later ones become its proxies.
+  // Only then is the command line read for a query.
+  gboolean single_instance = single_instance_requested(*arguments + 1);
+  g_autofree gchar* query = single_instance
+                                ? query_from_arguments(*arguments + 1)
+                                : g_strdup("");
+  if (single_instance) {
+    g_application_set_flags(application, kSingleInstanceFlags);
+  }
+
   g_autoptr(GError) error = nullptr;
-  if (!g_application_register(application, nullptr, &error)) {
+  gint64 start = startup_trace_begin();
+  gboolean registered = g_application_register(application, nullptr, &error);
+  startup_trace_end("g_application_register", start);
+  if (!registered) {
     g_warning("Failed to register: %s", error->message);
     *exit_status = 1;
     return TRUE;
   }
 
+  if (g_application_get_is_remote(application)) {
+    // Hand the launch to the running instance, which already has a warm
+    // engine, and exit; g_application_run() flushes the call.
+    g_action_group_activate_action(G_ACTION_GROUP(application), kLaunchAction,
+                                   g_variant_new_string(query));
+    *exit_status = 0;
+    return TRUE;
+  }
+
+  if (query[0] != '\0') {
+    launch_plugin_search(query);
+  }
   g_application_activate(application);
   *exit_status = 0;
 
@@ -101,11 +225,26 @@ static gboolean my_application_local_command_line(GApplication* application,
 
 // Implements GApplication::startup.
 static void my_application_startup(GApplication* application) {
-  // MyApplication* self = MY_APPLICATION(object);
+  MyApplication* self = MY_APPLICATION(application);
 
   // Perform any actions required at application startup.
+  gint64 start = startup_trace_begin();
+  session_snapshot_plugin_preload();
+  startup_trace_end("session_snapshot_preload", start);
+
+  // Before activate creates the view, so that the engine's font manager sees
+  // the bundled fonts; the first frame then never waits on a font. Without
+  // them Dart fetches the family instead.
+  start = startup_trace_begin();
+  if (bundled_fonts_register()) {
+    bundled_fonts_prewarm();
+    add_dart_entrypoint_argument(self, kBundledFontsArgument);
+  }
+  startup_trace_end("bundled_fonts_register", start);
 
+  start = startup_trace_begin();
   G_APPLICATION_CLASS(my_application_parent_class)->startup(application);
+  startup_trace_end("gtk_application_startup", start);
 }
 
 // Implements GApplication::shutdown.
@@ -113,6 +252,8 @@ static void my_application_shutdown(GApplication* application) {
   // MyApplication* self = MY_APPLICATION(object);
 
   // Perform any actions required at application shutdown.
+  startup_trace_flush();
+  frame_stats_flush();
 
   G_APPLICATION_CLASS(my_application_parent_class)->shutdown(application);
 }
@@ -133,7 +274,12 @@ static void my_application_class_init(MyApplicationClass* klass) {
   G_OBJECT_CLASS(klass)->dispose = my_application_dispose;
 }
 
-static void my_application_init(MyApplication* self) {}
+static void my_application_init(MyApplication* self) {
+  g_autoptr(GSimpleAction) launch =
+      g_simple_action_new(kLaunchAction, G_VARIANT_TYPE_STRING);
+  g_signal_connect(launch, "activate", G_CALLBACK(launch_cb), self);
+  g_action_map_add_action(G_ACTION_MAP(self), G_ACTION(launch));
+}
 
 MyApplication* my_application_new() {
   // Set the program name to the application ID, which helps various systems
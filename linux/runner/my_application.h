@@ -3,6 +3,12 @@
 
 #include <gtk/gtk.h>
 
+// Environment variable that turns single-instance mode on unless empty or
+// "0".
+constexpr char kSingleInstanceEnv[] = "ECHOLENS_SINGLE_INSTANCE";
+// Entry point argument with the same meaning as kSingleInstanceEnv.
+constexpr char kSingleInstanceArgument[] = "--single-instance";
+
 G_DECLARE_FINAL_TYPE(MyApplication,
                      my_application,
                      MY,
@@ -12,7 +18,14 @@ G_DECLARE_FINAL_TYPE(MyApplication,
 /**
  * my_application_new:
  *
- * Creates a new Flutter-based application.
+ * Creates a new Flutter-based application. Every launch starts its own
+ * engine unless it is in single-instance mode, set by kSingleInstanceEnv or
+ * kSingleInstanceArgument. The first launch in that mode then owns the
+ * application ID on the session bus and searches for the query of its
+ * command line, such as the name in `echolens "Jane Roe"`: the one argument
+ * that is not an option. Later ones register as its proxies, forward their
+ * query and exit at once; the running instance raises its window and
+ * searches for it.
  *
  * Returns: a new #MyApplication.
  */
@@ -0,0 +1,170 @@
+#include "pdf_batch.h"
+
+#include <set>
+
+namespace {
+
+// Shared by the workers of one export.
+struct BatchState {
+  const std::vector<PdfReport>* reports;
+  const PdfBatchOptions* options;
+  GCancellable* cancellable;
+  PdfBatchProgressFunc progress;
+  void* user_data;
+
+  // Planned output file of each report, for separate files.
+  std::vector<std::string> paths;
+  // Recorded pages of each report, for a merged file.
+  std::vector<PdfReportPages*> laid_out;
+  // Whether each report was written or laid out.
+  std::vector<char> finished;
+  gint done;
+
+  GMutex lock;
+  std::string error;
+};
+
+// "Profile_Jane_Roe.pdf", like the single-report export.
+std::string file_name(const std::string& name) {
+  std::string file = "Profile_";
+  for (char c : name) {
+    if (c == ' ') {
+      file += '_';
+    } else if (c == '/' || static_cast<unsigned char>(c) < 0x20) {
+      continue;
+    } else {
+      file += c;
+    }
+  }
+  return file;
+}
+
+// Picks a distinct path in @directory for every report, appending "_2",
+// "_3", ... when names collide with each other or with existing files.
+std::vector<std::string> plan_paths(const std::vector<PdfReport>& reports,
+                                    const std::string& directory) {
+  std::vector<std::string> paths;
+  std::set<std::string> taken;
+  for (const PdfReport& report : reports) {
+    std::string base = file_name(report.name);
+    std::string path;
+    for (int suffix = 1;; suffix++) {
+      std::string candidate =
+          suffix == 1 ? base : base + "_" + std::to_string(suffix);
+      g_autofree gchar* full = g_build_filename(
+          directory.c_str(), (candidate + ".pdf").c_str(), nullptr);
+      if (taken.count(full) == 0 && !g_file_test(full, G_FILE_TEST_EXISTS)) {
+        path = full;
+        break;
+      }
+    }
+    taken.insert(path);
+    paths.push_back(path);
+  }
+  return paths;
+}
+
+void export_one(gpointer data, gpointer user_data) {
+  BatchState* state = static_cast<BatchState*>(user_data);
+  size_t index = GPOINTER_TO_UINT(data) - 1;
+  if (g_cancellable_is_cancelled(state->cancellable)) {
+    return;
+  }
+
+  const PdfReport& report = (*state->reports)[index];
+  if (!state->options->merged_path.empty()) {
+    state->laid_out[index] = pdf_report_layout(report);
+    state->finished[index] = true;
+  } else {
+    std::string error;
+    if (pdf_report_write(report, state->paths[index].c_str(), nullptr,
+                         &error)) {
+      state->finished[index] = true;
+    } else {
+      g_mutex_lock(&state->lock);
+      if (state->error.empty()) {
+        state->error = state->paths[index] + ": " + error;
+      }
+      g_mutex_unlock(&state->lock);
+    }
+  }
+
+  gint done = g_atomic_int_add(&state->done, 1) + 1;
+  if (state->progress != nullptr) {
+    state->progress(done, state->reports->size(), state->user_data);
+  }
+}
+
+}  // namespace
+
+bool pdf_batch_export(const std::vector<PdfReport>& reports,
+                      const PdfBatchOptions& options,
+                      GCancellable* cancellable,
+                      PdfBatchProgressFunc progress,
+                      void* user_data,
+                      PdfBatchResult* result) {
+  *result = PdfBatchResult();
+  result->cancelled = false;
+  bool merged = !options.merged_path.empty();
+
+  BatchState state;
+  state.reports = &reports;
+  state.options = &options;
+  state.cancellable = cancellable;
+  state.progress = progress;
+  state.user_data = user_data;
+  if (!merged) {
+    state.paths = plan_paths(reports, options.directory);
+  }
+  state.laid_out.assign(reports.size(), nullptr);
+  state.finished.assign(reports.size(), false);
+  state.done = 0;
+  g_mutex_init(&state.lock);
+
+  guint threads = options.threads > 0 ? options.threads
+                                      : g_get_num_processors();
+  threads = MAX(MIN(threads, static_cast<guint>(reports.size())), 1u);
+
+  g_autoptr(GError) error = nullptr;
+  GThreadPool* pool =
+      g_thread_pool_new(export_one, &state, threads, TRUE, &error);
+  if (pool == nullptr) {
+    result->error = error->message;
+    g_mutex_clear(&state.lock);
+    return false;
+  }
+  for (size_t i = 0; i < reports.size(); i++) {
+    g_thread_pool_push(pool, GUINT_TO_POINTER(i + 1), nullptr);
+  }
+  // Waits for every queued report; cancelled ones return immediately.
+  g_thread_pool_free(pool, FALSE, TRUE);
+
+  result->cancelled = g_cancellable_is_cancelled(cancellable);
+  result->error = state.error;
+  if (merged) {
+    if (!result->cancelled) {
+      std::string write_error;
+      if (pdf_report_write_merged(state.laid_out, options.merged_title.c_str(),
+                                  options.merged_path.c_str(), nullptr,
+                                  &write_error)) {
+        result->paths.push_back(options.merged_path);
+      } else {
+        result->error = options.merged_path + ": " + write_error;
+      }
+    }
+    for (PdfReportPages* pages : state.laid_out) {
+      if (pages != nullptr) {
+        pdf_report_pages_free(pages);
+      }
+    }
+  } else {
+    for (size_t i = 0; i < reports.size(); i++) {
+      if (state.finished[i]) {
+        result->paths.push_back(state.paths[i]);
+      }
+    }
+  }
+
+  g_mutex_clear(&state.lock);
+  return !result->cancelled && result->error.empty();
+}
@@ -0,0 +1,61 @@
+#ifndef RUNNER_PDF_BATCH_H_
+#define RUNNER_PDF_BATCH_H_
+
+#include <gio/gio.h>
+
+#include <string>
+#include <vector>
+
+#include "pdf_report.h"
+
+struct PdfBatchOptions {
+  // Receives one file per report; unused when @merged_path is set.
+  std::string directory;
+  // When not empty, every report goes into this one file after a contents
+  // page instead.
+  std::string merged_path;
+  // Title of the merged document.
+  std::string merged_title;
+  // Worker threads; 0 uses one per processor.
+  int threads;
+};
+
+struct PdfBatchResult {
+  // The files written, in report order.
+  std::vector<std::string> paths;
+  bool cancelled;
+  // The first failure, if any report could not be written.
+  std::string error;
+};
+
+// Called on a worker thread each time a report is finished.
+typedef void (*PdfBatchProgressFunc)(size_t done,
+                                     size_t total,
+                                     void* user_data);
+
+/**
+ * pdf_batch_export:
+ * @reports: the reports to export.
+ * @options: where to write them and how many threads to use.
+ * @cancellable: (nullable): stops the export between reports.
+ * @progress: (nullable): called as reports finish.
+ * @user_data: passed to @progress.
+ * @result: (out): receives the written files and any failure.
+ *
+ * Renders @reports in parallel on a pool of worker threads and blocks until
+ * all of them are done. Separate files are named after the reports, made
+ * unique within @options.directory. For a merged file the reports are only
+ * laid out in parallel; their recorded pages are then written in order
+ * after a contents page.
+ *
+ * Returns: %TRUE if every report was written and the export was not
+ * cancelled.
+ */
+bool pdf_batch_export(const std::vector<PdfReport>& reports,
+                      const PdfBatchOptions& options,
+                      GCancellable* cancellable,
+                      PdfBatchProgressFunc progress,
+                      void* user_data,
+                      PdfBatchResult* result);
+
+#endif  // RUNNER_PDF_BATCH_H_
@@ -0,0 +1,482 @@
+#include "pdf_font_subset.h"
+
+#include <cairo-ft.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include <hb-subset.h>
+#include <pango/pangocairo.h>
+#include <pango/pangofc-font.h>
+
+#include <algorithm>
+#include <iterator>
+#include <list>
+#include <utility>
+
+namespace {
+
+// Subsets kept for later documents. Each is one font, and a report uses a
+// handful of them.
+constexpr size_t kMaxCachedSubsets = 16;
+
+// Ranges every repertoire includes.
+constexpr std::pair<gunichar, gunichar> kBaseRanges[] = {
+    {0x20, 0x7e},      // ASCII
+    {0xa0, 0xff},      // Latin-1
+    {0x2010, 0x2027},  // Dashes, quotes, bullets and the ellipsis
+    {0x2030, 0x203a},  // Per mille, primes and angle quotes
+    {0x20ac, 0x20ac},  // Euro
+    {0x2122, 0x2122},  // Trade mark
+    {0x2212, 0x2212},  // Minus
+};
+
+struct CachedSubset {
+  std::string key;
+  // The characters the subset has glyphs for.
+  PdfFontRepertoire repertoire;
+  cairo_font_face_t* face;
+};
+
+// Keeps the memory a subset's FT_Face reads from alive with the face.
+struct SubsetData {
+  FT_Face face;
+  hb_blob_t* blob;
+};
+
+const cairo_user_data_key_t kSubsetDataKey = {};
+
+}  // namespace
+
+// Most recently used first.
+static std::list<CachedSubset> cache;
+static GMutex cache_lock;
+static PdfFontSubsetStats stats;
+static gint subsetting_enabled = TRUE;
+
+// FreeType libraries must not create or free faces from two threads at once.
+static FT_Library library;
+static GMutex library_lock;
+
+typedef struct {
+  PangoRenderer parent_instance;
+
+  cairo_t* cr;
+  PdfFontRepertoire* repertoire;
+} PdfGlyphRenderer;
+
+typedef struct {
+  PangoRendererClass parent_class;
+} PdfGlyphRendererClass;
+
+G_DEFINE_TYPE(PdfGlyphRenderer, pdf_glyph_renderer, PANGO_TYPE_RENDERER)
+
+#define PDF_GLYPH_RENDERER(obj)                                  \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), pdf_glyph_renderer_get_type(), \
+                              PdfGlyphRenderer))
+
+static void free_subset_data(void* data) {
+  SubsetData* subset = static_cast<SubsetData*>(data);
+  g_mutex_lock(&library_lock);
+  FT_Done_Face(subset->face);
+  g_mutex_unlock(&library_lock);
+  hb_blob_destroy(subset->blob);
+  delete subset;
+}
+
+// Subsets face @index of @file to the glyphs @repertoire needs, keeping
+// their ids, and emboldens or slants it like Pango's face if that does.
+// Returns null if the font cannot be subset.
+static cairo_font_face_t* make_subset(const char* file,
+                                      int index,
+                                      unsigned int synthesize,
+                                      const PdfFontRepertoire& repertoire) {
+  gint64 start = g_get_monotonic_time();
+  hb_blob_t* source = hb_blob_create_from_file(file);
+  unsigned int source_length = hb_blob_get_length(source);
+  hb_face_t* face = hb_face_create(source, index);
+  hb_blob_destroy(source);
+
+  hb_face_t* subset = nullptr;
+  hb_subset_input_t* input = hb_subset_input_create_or_fail();
+  if (source_length > 0 && input != nullptr) {
+    hb_set_t* unicodes = hb_subset_input_unicode_set(input);
+    for (gunichar c : repertoire) {
+      hb_set_add(unicodes, c);
+    }
+#if HB_VERSION_ATLEAST(2, 9, 0)
+    hb_subset_input_set_flags(
+        input, HB_SUBSET_FLAGS_RETAIN_GIDS | HB_SUBSET_FLAGS_NO_HINTING);
+    subset = hb_subset_or_fail(face, input);
+#else
+    hb_subset_input_set_retain_gids(input, TRUE);
+    hb_subset_input_set_drop_hints(input, TRUE);
+    subset = hb_subset(face, input);
+    if (hb_face_get_glyph_count(subset) == 0) {
+      hb_face_destroy(subset);
+      subset = nullptr;
+    }
+#endif
+  }
+  hb_subset_input_destroy(input);
+  hb_face_destroy(face);
+  if (subset == nullptr) {
+    return nullptr;
+  }
+  hb_blob_t* blob = hb_face_reference_blob(subset);
+  hb_face_destroy(subset);
+
+  unsigned int length = 0;
+  const char* data = hb_blob_get_data(blob, &length);
+  FT_Face ft_face = nullptr;
+  g_mutex_lock(&library_lock);
+  FT_Error error = library == nullptr ? FT_Init_FreeType(&library) : 0;
+  if (error == 0) {
+    error = FT_New_Memory_Face(library, reinterpret_cast<const FT_Byte*>(data),
+                               length, 0, &ft_face);
+  }
+  g_mutex_unlock(&library_lock);
+  if (error != 0) {
+    hb_blob_destroy(blob);
+    return nullptr;
+  }
+
+  cairo_font_face_t* font_face =
+      cairo_ft_font_face_create_for_ft_face(ft_face, 0);
+  cairo_ft_font_face_set_synthesize(font_face, synthesize);
+  SubsetData* subset_data = new SubsetData{ft_face, blob};
+  if (cairo_font_face_set_user_data(font_face, &kSubsetDataKey, subset_data,
+                                    free_subset_data) !=
+      CAIRO_STATUS_SUCCESS) {
+    cairo_font_face_destroy(font_face);
+    free_subset_data(subset_data);
+    return nullptr;
+  }
+
+  g_mutex_lock(&cache_lock);
+  stats.subset_us += g_get_monotonic_time() - start;
+  stats.source_bytes += source_length;
+  stats.subset_bytes += length;
+  g_mutex_unlock(&cache_lock);
+  return font_face;
+}
+
+// Returns the subset to draw @glyphs of @font, whose cairo font is @scaled,
+// with, or null to draw them with @font itself.
+static cairo_font_face_t* lookup_subset(PangoFont* font,
+                                        cairo_scaled_font_t* scaled,
+                                        PangoGlyphString* glyphs,
+                                        const PdfFontRepertoire& repertoire) {
+  if (!g_atomic_int_get(&subsetting_enabled) || !PANGO_IS_FC_FONT(font)) {
+    return nullptr;
+  }
+  // Boxes for missing characters are drawn by Pango, not from the font.
+  for (int i = 0; i < glyphs->num_glyphs; i++) {
+    if (glyphs->glyphs[i].glyph & PANGO_GLYPH_UNKNOWN_FLAG) {
+      return nullptr;
+    }
+  }
+#if PANGO_VERSION_CHECK(1, 48, 0)
+  FcPattern* pattern = pango_fc_font_get_pattern(PANGO_FC_FONT(font));
+#else
+  FcPattern* pattern = PANGO_FC_FONT(font)->font_pattern;
+#endif
+  FcChar8* file = nullptr;
+  int index = 0;
+  FcBool variable = FcFalse;
+  FcPatternGetBool(pattern, FC_VARIABLE, 0, &variable);
+  FcPatternGetInteger(pattern, FC_INDEX, 0, &index);
+  // Instances of variable fonts are drawn with Pango's variations applied.
+  if (FcPatternGetString(pattern, FC_FILE, 0, &file) != FcResultMatch ||
+      variable || (index >> 16) != 0) {
+    return nullptr;
+  }
+  // Fontconfig's synthetic bold, and oblique where cairo applies it, live
+  // on Pango's face rather than in the font file. A slant fontconfig asks
+  // for through FC_MATRIX is in the font matrix the run is drawn with.
+  cairo_font_face_t* pango_face = cairo_scaled_font_get_font_face(scaled);
+  unsigned int synthesize =
+      cairo_font_face_get_type(pango_face) == CAIRO_FONT_TYPE_FT
+          ? cairo_ft_font_face_get_synthesize(pango_face)
+          : 0;
+
+  std::string key = reinterpret_cast<const char*>(file);
+  key += '\0';
+  key += std::to_string(index);
+  key += '\0';
+  key += std::to_string(synthesize);
+
+  // One subset per face: when a document needs characters the cached one
+  // lacks, it is replaced by a subset of both repertoires, so a face is
+  // subset again only for characters no document has drawn with it yet.
+  PdfFontRepertoire wanted;
+  g_mutex_lock(&cache_lock);
+  for (auto it = cache.begin(); it != cache.end(); ++it) {
+    if (it->key != key) {
+      continue;
+    }
+    cache.splice(cache.begin(), cache, it);
+    if (std::includes(it->repertoire.begin(), it->repertoire.end(),
+                      repertoire.begin(), repertoire.end())) {
+      stats.hits++;
+      cairo_font_face_t* face = cairo_font_face_reference(it->face);
+      g_mutex_unlock(&cache_lock);
+      return face;
+    }
+    std::set_union(it->repertoire.begin(), it->repertoire.end(),
+                   repertoire.begin(), repertoire.end(),
+                   std::back_inserter(wanted));
+    break;
+  }
+  stats.misses++;
+  g_mutex_unlock(&cache_lock);
+  if (wanted.empty()) {
+    wanted = repertoire;
+  }
+
+  // Made unlocked: two threads may both make one, and the first to cover
+  // this document is kept so that documents laid out in parallel still
+  // share it.
+  cairo_font_face_t* face = make_subset(reinterpret_cast<const char*>(file),
+                                        index, synthesize, wanted);
+  if (face == nullptr) {
+    return nullptr;
+  }
+  cairo_font_face_t* dropped = nullptr;
+  g_mutex_lock(&cache_lock);
+  auto it = std::find_if(cache.begin(), cache.end(),
+                         [&](const CachedSubset& c) { return c.key == key; });
+  if (it != cache.end() &&
+      std::includes(it->repertoire.begin(), it->repertoire.end(),
+                    repertoire.begin(), repertoire.end())) {
+    dropped = face;
+    face = cairo_font_face_reference(it->face);
+  } else if (it != cache.end()) {
+    // Documents that drew with the old subset hold their own references.
+    dropped = it->face;
+    it->repertoire = std::move(wanted);
+    it->face = cairo_font_face_reference(face);
+    cache.splice(cache.begin(), cache, it);
+  } else {
+    cache.push_front({key, std::move(wanted), cairo_font_face_reference(face)});
+    if (cache.size() > kMaxCachedSubsets) {
+      dropped = cache.back().face;
+      cache.pop_back();
+    }
+  }
+  g_mutex_unlock(&cache_lock);
+  // Destroying a face may take the library lock.
+  if (dropped != nullptr) {
+    cairo_font_face_destroy(dropped);
+  }
+  return face;
+}
+
+// Sets the colour Pango chose for @part, if any, falling back to the
+// foreground's for decorations.
+static void set_part_color(PangoRenderer* renderer,
+                           PangoRenderPart part,
+                           cairo_t* cr) {
+  PangoColor* color = pango_renderer_get_color(renderer, part);
+  if (color == nullptr && part != PANGO_RENDER_PART_BACKGROUND) {
+    color = pango_renderer_get_color(renderer, PANGO_RENDER_PART_FOREGROUND);
+  }
+  if (color != nullptr) {
+    cairo_set_source_rgb(cr, color->red / 65535.0, color->green / 65535.0,
+                         color->blue / 65535.0);
+  }
+}
+
+static void pdf_glyph_renderer_draw_glyphs(PangoRenderer* renderer,
+                                           PangoFont* font,
+                                           PangoGlyphString* glyphs,
+                                           int x,
+                                           int y) {
+  PdfGlyphRenderer* self = PDF_GLYPH_RENDERER(renderer);
+  cairo_t* cr = self->cr;
+  cairo_save(cr);
+  set_part_color(renderer, PANGO_RENDER_PART_FOREGROUND, cr);
+
+  cairo_scaled_font_t* scaled =
+      pango_cairo_font_get_scaled_font(PANGO_CAIRO_FONT(font));
+  cairo_font_face_t* face =
+      scaled != nullptr
+          ? lookup_subset(font, scaled, glyphs, *self->repertoire)
+          : nullptr;
+  if (face == nullptr) {
+    g_mutex_lock(&cache_lock);
+    stats.fallbacks++;
+    g_mutex_unlock(&cache_lock);
+    cairo_move_to(cr, static_cast<double>(x) / PANGO_SCALE,
+                  static_cast<double>(y) / PANGO_SCALE);
+    pango_cairo_show_glyph_string(cr, font, glyphs);
+    cairo_restore(cr);
+    return;
+  }
+
+  // The same size and options as Pango's font, so only the data differs.
+  cairo_matrix_t font_matrix;
+  cairo_scaled_font_get_font_matrix(scaled, &font_matrix);
+  cairo_font_options_t* options = cairo_font_options_create();
+  cairo_scaled_font_get_font_options(scaled, options);
+  cairo_set_font_face(cr, face);
+  cairo_set_font_matrix(cr, &font_matrix);
+  cairo_set_font_options(cr, options);
+  cairo_font_options_destroy(options);
+  cairo_font_face_destroy(face);
+
+  std::vector<cairo_glyph_t> positioned;
+  positioned.reserve(glyphs->num_glyphs);
+  int advance = x;
+  for (int i = 0; i < glyphs->num_glyphs; i++) {
+    const PangoGlyphInfo& info = glyphs->glyphs[i];
+    if (info.glyph != PANGO_GLYPH_EMPTY) {
+      positioned.push_back(
+          {info.glyph,
+           static_cast<double>(advance + info.geometry.x_offset) / PANGO_SCALE,
+           static_cast<double>(y + info.geometry.y_offset) / PANGO_SCALE});
+    }
+    advance += info.geometry.width;
+  }
+  cairo_show_glyphs(cr, positioned.data(),
+                    static_cast<int>(positioned.size()));
+  cairo_restore(cr);
+}
+
+// Underlines, strikethroughs and backgrounds.
+static void pdf_glyph_renderer_draw_rectangle(PangoRenderer* renderer,
+                                              PangoRenderPart part,
+                                              int x,
+                                              int y,
+                                              int width,
+                                              int height) {
+  cairo_t* cr = PDF_GLYPH_RENDERER(renderer)->cr;
+  cairo_save(cr);
+  set_part_color(renderer, part, cr);
+  cairo_rectangle(cr, static_cast<double>(x) / PANGO_SCALE,
+                  static_cast<double>(y) / PANGO_SCALE,
+                  static_cast<double>(width) / PANGO_SCALE,
+                  static_cast<double>(height) / PANGO_SCALE);
+  cairo_fill(cr);
+  cairo_restore(cr);
+}
+
+// Error underlines, which Pango builds from trapezoids.
+static void pdf_glyph_renderer_draw_trapezoid(PangoRenderer* renderer,
+                                              PangoRenderPart part,
+                                              double y1,
+                                              double x11,
+                                              double x21,
+                                              double y2,
+                                              double x12,
+                                              double x22) {
+  cairo_t* cr = PDF_GLYPH_RENDERER(renderer)->cr;
+  cairo_save(cr);
+  set_part_color(renderer, part, cr);
+  cairo_move_to(cr, x11, y1);
+  cairo_line_to(cr, x21, y1);
+  cairo_line_to(cr, x22, y2);
+  cairo_line_to(cr, x12, y2);
+  cairo_close_path(cr);
+  cairo_fill(cr);
+  cairo_restore(cr);
+}
+
+static void pdf_glyph_renderer_finalize(GObject* object) {
+  PdfGlyphRenderer* self = PDF_GLYPH_RENDERER(object);
+  delete self->repertoire;
+  G_OBJECT_CLASS(pdf_glyph_renderer_parent_class)->finalize(object);
+}
+
+static void pdf_glyph_renderer_class_init(PdfGlyphRendererClass* klass) {
+  G_OBJECT_CLASS(klass)->finalize = pdf_glyph_renderer_finalize;
+  PangoRendererClass* renderer_class = PANGO_RENDERER_CLASS(klass);
+  renderer_class->draw_glyphs = pdf_glyph_renderer_draw_glyphs;
+  renderer_class->draw_rectangle = pdf_glyph_renderer_draw_rectangle;
+  renderer_class->draw_trapezoid = pdf_glyph_renderer_draw_trapezoid;
+}
+
+static void pdf_glyph_renderer_init(PdfGlyphRenderer* self) {}
+
+PdfFontRepertoire pdf_font_repertoire_new(
+    const std::vector<std::string>& text) {
+  PdfFontRepertoire repertoire;
+  for (const auto& range : kBaseRanges) {
+    for (gunichar c = range.first; c <= range.second; c++) {
+      repertoire.push_back(c);
+    }
+  }
+  for (const std::string& part : text) {
+    const gchar* end = part.data() + part.size();
+    for (const gchar* p = part.data(); p < end; p = g_utf8_next_char(p)) {
+      gunichar c = g_utf8_get_char_validated(p, end - p);
+      if (c < 0x20 || c == static_cast<gunichar>(-1) ||
+          c == static_cast<gunichar>(-2)) {
+        continue;
+      }
+      repertoire.push_back(c);
+    }
+  }
+  std::sort(repertoire.begin(), repertoire.end());
+  repertoire.erase(std::unique(repertoire.begin(), repertoire.end()),
+                   repertoire.end());
+  return repertoire;
+}
+
+PangoRenderer* pdf_font_subset_renderer_new(
+    const PdfFontRepertoire& repertoire) {
+  PdfGlyphRenderer* self = PDF_GLYPH_RENDERER(
+      g_object_new(pdf_glyph_renderer_get_type(), nullptr));
+  self->repertoire = new PdfFontRepertoire(repertoire);
+  return PANGO_RENDERER(self);
+}
+
+void pdf_font_subset_show_layout(PangoRenderer* renderer,
+                                 cairo_t* cr,
+                                 PangoLayout* layout) {
+  if (!g_atomic_int_get(&subsetting_enabled)) {
+    pango_cairo_show_layout(cr, layout);
+    return;
+  }
+  double x, y;
+  cairo_get_current_point(cr, &x, &y);
+  PDF_GLYPH_RENDERER(renderer)->cr = cr;
+  pango_renderer_draw_layout(renderer, layout, pango_units_from_double(x),
+                             pango_units_from_double(y));
+  PDF_GLYPH_RENDERER(renderer)->cr = nullptr;
+}
+
+void pdf_font_subset_show_layout_line(PangoRenderer* renderer,
+                                      cairo_t* cr,
+                                      PangoLayoutLine* line) {
+  if (!g_atomic_int_get(&subsetting_enabled)) {
+    pango_cairo_show_layout_line(cr, line);
+    return;
+  }
+  double x, y;
+  cairo_get_current_point(cr, &x, &y);
+  PDF_GLYPH_RENDERER(renderer)->cr = cr;
+  pango_renderer_draw_layout_line(renderer, line,
+                                  pango_units_from_double(x),
+                                  pango_units_from_double(y));
+  PDF_GLYPH_RENDERER(renderer)->cr = nullptr;
+}
+
+void pdf_font_subset_set_enabled(gboolean enabled) {
+  g_atomic_int_set(&subsetting_enabled, enabled);
+}
+
+void pdf_font_subset_clear_cache() {
+  g_mutex_lock(&cache_lock);
+  std::list<CachedSubset> dropped;
+  dropped.swap(cache);
+  g_mutex_unlock(&cache_lock);
+  for (const CachedSubset& subset : dropped) {
+    cairo_font_face_destroy(subset.face);
+  }
+}
+
+PdfFontSubsetStats pdf_font_subset_get_stats() {
+  g_mutex_lock(&cache_lock);
+  PdfFontSubsetStats result = stats;
+  g_mutex_unlock(&cache_lock);
+  return result;
+}
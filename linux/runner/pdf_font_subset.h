@@ -0,0 +1,94 @@
+#ifndef RUNNER_PDF_FONT_SUBSET_H_
+#define RUNNER_PDF_FONT_SUBSET_H_
+
+#include <cairo.h>
+#include <glib.h>
+#include <pango/pango.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// The characters a document may draw, sorted and without duplicates.
+typedef std::vector<gunichar> PdfFontRepertoire;
+
+typedef struct {
+  // Subsets found in the cache, and those that were made.
+  uint64_t hits;
+  uint64_t misses;
+  // Runs drawn with Pango's own font because it could not be subset.
+  uint64_t fallbacks;
+  // Time spent making subsets.
+  uint64_t subset_us;
+  // Size of the font files that were subset, and of the subsets made.
+  uint64_t source_bytes;
+  uint64_t subset_bytes;
+} PdfFontSubsetStats;
+
+/**
+ * pdf_font_repertoire_new:
+ * @text: UTF-8 text a document draws, e.g. every string of a report.
+ *
+ * Returns: the characters of @text with printable ASCII, Latin-1 and the
+ * common punctuation that Pango may insert itself, such as hyphens at line
+ * breaks and ellipses. Most reports need nothing beyond those, so they share
+ * one repertoire and therefore one cached subset per font.
+ */
+PdfFontRepertoire pdf_font_repertoire_new(
+    const std::vector<std::string>& text);
+
+/**
+ * pdf_font_subset_renderer_new:
+ * @repertoire: every character the layouts drawn with the renderer contain.
+ *
+ * Creates a renderer for pdf_font_subset_show_layout() that draws each run
+ * with a subset of its font instead of the font itself. The subset keeps
+ * the glyphs that @repertoire needs, under their original ids so that
+ * Pango's shaping still applies, and drops hinting, which PDF viewers do
+ * not use. cairo then embeds only the glyphs a document uses, as before,
+ * but from the much smaller subset. Synthetic bold and oblique carry over
+ * from Pango's font. Subsets are cached per font face across documents,
+ * each grown to every repertoire it has served. Safe to use from any
+ * thread, one renderer per thread.
+ *
+ * Returns: (transfer full): a #PangoRenderer.
+ */
+PangoRenderer* pdf_font_subset_renderer_new(
+    const PdfFontRepertoire& repertoire);
+
+/**
+ * pdf_font_subset_show_layout:
+ * @renderer: a renderer from pdf_font_subset_renderer_new().
+ * @cr: the context to draw on.
+ * @layout: the layout to draw.
+ *
+ * Draws @layout with its top left corner at the current point of @cr, like
+ * pango_cairo_show_layout().
+ */
+void pdf_font_subset_show_layout(PangoRenderer* renderer,
+                                 cairo_t* cr,
+                                 PangoLayout* layout);
+
+/**
+ * pdf_font_subset_show_layout_line:
+ * @renderer: a renderer from pdf_font_subset_renderer_new().
+ * @cr: the context to draw on.
+ * @line: the line to draw.
+ *
+ * Draws @line with its baseline starting at the current point of @cr, like
+ * pango_cairo_show_layout_line().
+ */
+void pdf_font_subset_show_layout_line(PangoRenderer* renderer,
+                                      cairo_t* cr,
+                                      PangoLayoutLine* line);
+
+// Turns subsetting off to compare against cairo's own embedding, in which
+// case renderers draw with Pango's fonts. On by default.
+void pdf_font_subset_set_enabled(gboolean enabled);
+
+// Drops the cached subsets, e.g. to time a first export.
+void pdf_font_subset_clear_cache();
+
+PdfFontSubsetStats pdf_font_subset_get_stats();
+
+#endif  // RUNNER_PDF_FONT_SUBSET_H_
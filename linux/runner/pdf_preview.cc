@@ -0,0 +1,333 @@
+#include "pdf_preview.h"
+
+#include <cairo.h>
+#include <math.h>
+
+#include <algorithm>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+struct CacheEntry {
+  std::shared_ptr<const PdfTile> tile;
+  // Position in the recency list.
+  std::list<uint64_t>::iterator used;
+};
+
+// One tile to rasterize. Jobs of the latest request run first, each request
+// in the order it listed its tiles.
+struct TileJob {
+  PdfTileKey key;
+  guint generation;
+  guint order;
+};
+
+uint64_t pack_key(const PdfTileKey& key) {
+  return (static_cast<uint64_t>(key.page) << 40) |
+         (static_cast<uint64_t>(key.zoom - kPdfPreviewMinZoom) << 32) |
+         (static_cast<uint64_t>(key.x) << 16) | static_cast<uint64_t>(key.y);
+}
+
+double zoom_scale(int zoom) {
+  return exp2(zoom / 4.0);
+}
+
+gint compare_jobs(gconstpointer a, gconstpointer b, gpointer user_data) {
+  const TileJob* first = static_cast<const TileJob*>(a);
+  const TileJob* second = static_cast<const TileJob*>(b);
+  if (first->generation != second->generation) {
+    return first->generation > second->generation ? -1 : 1;
+  }
+  return first->order < second->order ? -1 : first->order > second->order;
+}
+
+}  // namespace
+
+struct _PdfPreview {
+  PdfReportPages* pages;
+  PdfPreviewOptions options;
+  PdfTileReadyCallback callback;
+  gpointer user_data;
+
+  // Recorded pages are replayed by one thread at a time each.
+  GMutex* page_locks;
+  int page_count;
+
+  GMutex lock;
+  std::unordered_map<uint64_t, CacheEntry> cache;
+  // Most recently used first.
+  std::list<uint64_t> used;
+  size_t cache_bytes;
+  // Tiles being rasterized, which must not be started twice.
+  std::unordered_set<uint64_t> rasterizing;
+  // The tiles of the latest request; older jobs for anything else are
+  // dropped.
+  std::unordered_set<uint64_t> wanted;
+  guint generation;
+  guint next_order;
+  gboolean closing;
+  PdfPreviewStats stats;
+
+  GThreadPool* workers;
+};
+
+static std::shared_ptr<const PdfTile> rasterize(PdfPreview* preview,
+                                                const PdfTileKey& key) {
+  int width = 0;
+  int height = 0;
+  int columns, rows;
+  pdf_preview_get_grid(key.zoom, &columns, &rows, &width, &height);
+  auto tile = std::make_shared<PdfTile>();
+  tile->width = std::min(kPdfTileSize, width - key.x * kPdfTileSize);
+  tile->height = std::min(kPdfTileSize, height - key.y * kPdfTileSize);
+
+  cairo_surface_t* surface = cairo_image_surface_create(
+      CAIRO_FORMAT_RGB24, tile->width, tile->height);
+  cairo_t* cr = cairo_create(surface);
+  cairo_set_source_rgb(cr, 1, 1, 1);
+  cairo_paint(cr);
+  cairo_translate(cr, -key.x * kPdfTileSize, -key.y * kPdfTileSize);
+  double scale = zoom_scale(key.zoom);
+  cairo_scale(cr, scale, scale);
+  g_mutex_lock(&preview->page_locks[key.page]);
+  pdf_report_pages_paint(preview->pages, key.page, cr);
+  g_mutex_unlock(&preview->page_locks[key.page]);
+  cairo_destroy(cr);
+  cairo_surface_flush(surface);
+
+  // Cairo keeps pixels as native-endian words; Flutter wants RGBA bytes.
+  const uint8_t* data = cairo_image_surface_get_data(surface);
+  int stride = cairo_image_surface_get_stride(surface);
+  tile->pixels.resize(static_cast<size_t>(tile->width) * tile->height * 4);
+  uint8_t* out = tile->pixels.data();
+  for (int y = 0; y < tile->height; y++) {
+    const uint32_t* row = reinterpret_cast<const uint32_t*>(data + y * stride);
+    for (int x = 0; x < tile->width; x++) {
+      uint32_t pixel = row[x];
+      *out++ = (pixel >> 16) & 0xff;
+      *out++ = (pixel >> 8) & 0xff;
+      *out++ = pixel & 0xff;
+      *out++ = 0xff;
+    }
+  }
+  cairo_surface_destroy(surface);
+  return tile;
+}
+
+// Drops the least recently used tiles until the cache fits its budget.
+static void evict_locked(PdfPreview* preview) {
+  while (preview->cache_bytes > preview->options.cache_bytes &&
+         preview->used.size() > 1) {
+    auto it = preview->cache.find(preview->used.back());
+    preview->cache_bytes -= it->second.tile->pixels.size();
+    preview->cache.erase(it);
+    preview->used.pop_back();
+    preview->stats.evicted++;
+  }
+}
+
+static void rasterize_one(gpointer data, gpointer user_data) {
+  TileJob* job = static_cast<TileJob*>(data);
+  PdfPreview* preview = static_cast<PdfPreview*>(user_data);
+  uint64_t packed = pack_key(job->key);
+
+  g_mutex_lock(&preview->lock);
+  bool stale = job->generation != preview->generation &&
+               preview->wanted.count(packed) == 0;
+  if (preview->closing || stale || preview->cache.count(packed) != 0 ||
+      preview->rasterizing.count(packed) != 0) {
+    if (stale) {
+      preview->stats.skipped++;
+    }
+    g_mutex_unlock(&preview->lock);
+    delete job;
+    return;
+  }
+  preview->rasterizing.insert(packed);
+  g_mutex_unlock(&preview->lock);
+
+  gint64 start = g_get_monotonic_time();
+  std::shared_ptr<const PdfTile> tile = rasterize(preview, job->key);
+  uint64_t elapsed = g_get_monotonic_time() - start;
+
+  g_mutex_lock(&preview->lock);
+  preview->rasterizing.erase(packed);
+  preview->used.push_front(packed);
+  preview->cache[packed] = {tile, preview->used.begin()};
+  preview->cache_bytes += tile->pixels.size();
+  preview->stats.rasterized++;
+  preview->stats.raster_us += elapsed;
+  preview->stats.max_raster_us =
+      std::max(preview->stats.max_raster_us, elapsed);
+  evict_locked(preview);
+  g_mutex_unlock(&preview->lock);
+
+  preview->callback(job->key, preview->user_data);
+  delete job;
+}
+
+PdfPreview* pdf_preview_new(PdfReportPages* pages,
+                            const PdfPreviewOptions& options,
+                            PdfTileReadyCallback callback,
+                            gpointer user_data) {
+  PdfPreview* preview = new PdfPreview();
+  preview->pages = pages;
+  preview->options = options;
+  preview->callback = callback;
+  preview->user_data = user_data;
+  preview->page_count = pdf_report_pages_get_count(pages);
+  preview->page_locks = g_new0(GMutex, MAX(preview->page_count, 1));
+  for (int i = 0; i < preview->page_count; i++) {
+    g_mutex_init(&preview->page_locks[i]);
+  }
+  g_mutex_init(&preview->lock);
+  preview->cache_bytes = 0;
+  preview->generation = 0;
+  preview->next_order = 0;
+  preview->closing = FALSE;
+  preview->stats = {};
+
+  int threads = options.threads > 0
+                    ? options.threads
+                    : MIN(static_cast<int>(g_get_num_processors()), 4);
+  preview->workers =
+      g_thread_pool_new(rasterize_one, preview, threads, FALSE, nullptr);
+  g_thread_pool_set_sort_function(preview->workers, compare_jobs, nullptr);
+  return preview;
+}
+
+void pdf_preview_free(PdfPreview* preview) {
+  g_mutex_lock(&preview->lock);
+  preview->closing = TRUE;
+  g_mutex_unlock(&preview->lock);
+  // Queued jobs see the flag and only free themselves.
+  g_thread_pool_free(preview->workers, FALSE, TRUE);
+
+  for (int i = 0; i < preview->page_count; i++) {
+    g_mutex_clear(&preview->page_locks[i]);
+  }
+  g_free(preview->page_locks);
+  g_mutex_clear(&preview->lock);
+  pdf_report_pages_free(preview->pages);
+  delete preview;
+}
+
+int pdf_preview_get_page_count(PdfPreview* preview) {
+  return preview->page_count;
+}
+
+void pdf_preview_get_grid(int zoom,
+                          int* columns,
+                          int* rows,
+                          int* width,
+                          int* height) {
+  double scale = zoom_scale(zoom);
+  int page_width = static_cast<int>(ceil(kPdfReportPageWidth * scale));
+  int page_height = static_cast<int>(ceil(kPdfReportPageHeight * scale));
+  *columns = (page_width + kPdfTileSize - 1) / kPdfTileSize;
+  *rows = (page_height + kPdfTileSize - 1) / kPdfTileSize;
+  if (width != nullptr) {
+    *width = page_width;
+  }
+  if (height != nullptr) {
+    *height = page_height;
+  }
+}
+
+std::shared_ptr<const PdfTile> pdf_preview_lookup(PdfPreview* preview,
+                                                  const PdfTileKey& key) {
+  uint64_t packed = pack_key(key);
+  g_mutex_lock(&preview->lock);
+  std::shared_ptr<const PdfTile> tile;
+  auto it = preview->cache.find(packed);
+  if (it != preview->cache.end()) {
+    preview->used.splice(preview->used.begin(), preview->used,
+                         it->second.used);
+    tile = it->second.tile;
+    preview->stats.hits++;
+  } else {
+    preview->stats.misses++;
+  }
+  g_mutex_unlock(&preview->lock);
+  return tile;
+}
+
+// The tiles to rasterize ahead of @visible: the next rows in @direction,
+// continuing onto the following pages, over the visible columns.
+static std::vector<PdfTileKey> prefetch_tiles(
+    PdfPreview* preview,
+    const std::vector<PdfTileKey>& visible,
+    int direction) {
+  std::vector<PdfTileKey> tiles;
+  if (direction == 0 || visible.empty()) {
+    return tiles;
+  }
+  int zoom = visible[0].zoom;
+  int columns, rows;
+  pdf_preview_get_grid(zoom, &columns, &rows, nullptr, nullptr);
+  // Rows as one sequence over every page.
+  int edge = direction > 0 ? 0 : G_MAXINT;
+  int first_column = columns;
+  int last_column = -1;
+  for (const PdfTileKey& key : visible) {
+    int row = key.page * rows + key.y;
+    edge = direction > 0 ? MAX(edge, row) : MIN(edge, row);
+    first_column = MIN(first_column, key.x);
+    last_column = MAX(last_column, key.x);
+  }
+  for (int step = 1; step <= preview->options.prefetch_rows; step++) {
+    int row = edge + step * direction;
+    if (row < 0 || row >= preview->page_count * rows) {
+      break;
+    }
+    for (int x = first_column; x <= last_column; x++) {
+      tiles.push_back({row / rows, zoom, x, row % rows});
+    }
+  }
+  return tiles;
+}
+
+void pdf_preview_request(PdfPreview* preview,
+                         const std::vector<PdfTileKey>& visible,
+                         int direction) {
+  std::vector<PdfTileKey> tiles;
+  for (const PdfTileKey& key : visible) {
+    if (key.page >= 0 && key.page < preview->page_count) {
+      tiles.push_back(key);
+    }
+  }
+  std::vector<PdfTileKey> ahead = prefetch_tiles(preview, tiles, direction);
+  tiles.insert(tiles.end(), ahead.begin(), ahead.end());
+
+  g_mutex_lock(&preview->lock);
+  preview->generation++;
+  preview->next_order = 0;
+  preview->wanted.clear();
+  std::vector<TileJob*> jobs;
+  for (const PdfTileKey& key : tiles) {
+    uint64_t packed = pack_key(key);
+    if (preview->cache.count(packed) != 0 ||
+        preview->rasterizing.count(packed) != 0 ||
+        !preview->wanted.insert(packed).second) {
+      continue;
+    }
+    jobs.push_back(
+        new TileJob{key, preview->generation, preview->next_order++});
+  }
+  g_mutex_unlock(&preview->lock);
+
+  for (TileJob* job : jobs) {
+    g_thread_pool_push(preview->workers, job, nullptr);
+  }
+}
+
+PdfPreviewStats pdf_preview_get_stats(PdfPreview* preview) {
+  g_mutex_lock(&preview->lock);
+  PdfPreviewStats stats = preview->stats;
+  stats.tiles = preview->cache.size();
+  stats.cache_bytes = preview->cache_bytes;
+  g_mutex_unlock(&preview->lock);
+  return stats;
+}
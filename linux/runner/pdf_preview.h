@@ -0,0 +1,136 @@
+#ifndef RUNNER_PDF_PREVIEW_H_
+#define RUNNER_PDF_PREVIEW_H_
+
+#include <glib.h>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "pdf_report.h"
+
+// Edge of a tile in pixels; tiles on the right and bottom edges of a page
+// are cut to the page.
+constexpr int kPdfTileSize = 256;
+
+// Zoom levels are quarter octaves: level z draws 2^(z/4) pixels per point,
+// so level 0 is 72 dpi and level 4 is 144 dpi. Nearby zooms share tiles.
+constexpr int kPdfPreviewMinZoom = -8;
+constexpr int kPdfPreviewMaxZoom = 16;
+
+typedef struct {
+  int page;
+  int zoom;
+  // Column and row of the tile in the page.
+  int x;
+  int y;
+} PdfTileKey;
+
+// The pixels of a tile: RGBA, 8 bits per channel, opaque, rows packed.
+typedef struct {
+  int width;
+  int height;
+  std::vector<uint8_t> pixels;
+} PdfTile;
+
+typedef struct {
+  // Cache budget for tiles that are not held elsewhere, in bytes.
+  size_t cache_bytes;
+  // Worker threads; 0 uses one per processor, up to four.
+  int threads;
+  // Rows of tiles rasterized past the visible ones in the scroll direction.
+  int prefetch_rows;
+} PdfPreviewOptions;
+
+constexpr PdfPreviewOptions kPdfPreviewOptions = {
+    64 << 20,  // cache_bytes
+    0,         // threads
+    4,         // prefetch_rows
+};
+
+typedef struct {
+  uint64_t tiles;
+  uint64_t cache_bytes;
+  // Lookups answered from the cache, and those that were not.
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t rasterized;
+  // Prefetched tiles that were dropped before being drawn.
+  uint64_t skipped;
+  uint64_t evicted;
+  // Total and slowest time spent rasterizing one tile.
+  uint64_t raster_us;
+  uint64_t max_raster_us;
+} PdfPreviewStats;
+
+// Called on a worker thread when a tile has been rasterized into the cache.
+typedef void (*PdfTileReadyCallback)(const PdfTileKey& key,
+                                     gpointer user_data);
+
+// Rasterizes the pages of a report into tiles on a pool of worker threads
+// and keeps them in a cache bounded by bytes, evicting the least recently
+// used. Tiles are shared: one that is evicted while still held by a caller
+// stays valid for it. Thread-safe.
+typedef struct _PdfPreview PdfPreview;
+
+/**
+ * pdf_preview_new:
+ * @pages: (transfer full): pages recorded by pdf_report_layout().
+ * @options: cache size, threads and prefetch distance.
+ * @callback: told about every rasterized tile.
+ * @user_data: passed to @callback.
+ */
+PdfPreview* pdf_preview_new(PdfReportPages* pages,
+                            const PdfPreviewOptions& options,
+                            PdfTileReadyCallback callback,
+                            gpointer user_data);
+
+// Drops the queued tiles and waits for those being rasterized.
+void pdf_preview_free(PdfPreview* preview);
+
+int pdf_preview_get_page_count(PdfPreview* preview);
+
+/**
+ * pdf_preview_get_grid:
+ * @zoom: a zoom level.
+ * @columns: (out): receives the tile columns of a page.
+ * @rows: (out): receives the tile rows of a page.
+ * @width: (out) (optional): receives the page width in pixels.
+ * @height: (out) (optional): receives the page height in pixels.
+ */
+void pdf_preview_get_grid(int zoom,
+                          int* columns,
+                          int* rows,
+                          int* width,
+                          int* height);
+
+/**
+ * pdf_preview_lookup:
+ * @preview: a #PdfPreview.
+ * @key: the tile.
+ *
+ * Returns: the tile if it is cached, marked as recently used; otherwise
+ * null.
+ */
+std::shared_ptr<const PdfTile> pdf_preview_lookup(PdfPreview* preview,
+                                                  const PdfTileKey& key);
+
+/**
+ * pdf_preview_request:
+ * @preview: a #PdfPreview.
+ * @visible: the tiles on screen, all at one zoom level.
+ * @direction: 1 when scrolling down, -1 when scrolling up, 0 when still.
+ *
+ * Queues the visible tiles that are not cached, then the rows after them in
+ * @direction, across pages, and tells the callback as each is done. This
+ * replaces the previous request: its tiles that are still queued are
+ * dropped unless requested again, so a fast scroll only rasterizes where it
+ * stops.
+ */
+void pdf_preview_request(PdfPreview* preview,
+                         const std::vector<PdfTileKey>& visible,
+                         int direction);
+
+PdfPreviewStats pdf_preview_get_stats(PdfPreview* preview);
+
+#endif  // RUNNER_PDF_PREVIEW_H_
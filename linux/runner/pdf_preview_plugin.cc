@@ -0,0 +1,474 @@
+#include "pdf_preview_plugin.h"
+
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "pdf_preview.h"
+#include "pdf_report.h"
+
+static constexpr char kChannelName[] = "echolens/pdf_preview";
+
+static constexpr char kOpenMethod[] = "open";
+static constexpr char kShowMethod[] = "show";
+static constexpr char kCloseMethod[] = "close";
+static constexpr char kStatsMethod[] = "stats";
+
+static constexpr char kBadArgumentsError[] = "Bad Arguments";
+static constexpr char kNoPreviewError[] = "No Preview";
+
+// Shown by a texture whose tile is not rasterized yet, stretched to the
+// tile.
+static const uint8_t kBlankPixel[] = {0xff, 0xff, 0xff, 0xff};
+
+// A texture showing one tile. Its pixels are handed over on the main thread
+// and read on the raster thread.
+G_DECLARE_FINAL_TYPE(PdfTileTexture,
+                     pdf_tile_texture,
+                     PDF,
+                     TILE_TEXTURE,
+                     FlPixelBufferTexture)
+
+struct _PdfTileTexture {
+  FlPixelBufferTexture parent_instance;
+
+  GMutex lock;
+  std::shared_ptr<const PdfTile>* tile;
+};
+
+G_DEFINE_TYPE(PdfTileTexture,
+              pdf_tile_texture,
+              fl_pixel_buffer_texture_get_type())
+
+static gboolean pdf_tile_texture_copy_pixels(FlPixelBufferTexture* texture,
+                                             const uint8_t** buffer,
+                                             uint32_t* width,
+                                             uint32_t* height,
+                                             GError** error) {
+  PdfTileTexture* self = PDF_TILE_TEXTURE(texture);
+  g_mutex_lock(&self->lock);
+  const PdfTile* tile = self->tile->get();
+  g_mutex_unlock(&self->lock);
+  // A tile is never replaced once set, so it outlives this frame.
+  if (tile == nullptr) {
+    *buffer = kBlankPixel;
+    *width = 1;
+    *height = 1;
+  } else {
+    *buffer = tile->pixels.data();
+    *width = tile->width;
+    *height = tile->height;
+  }
+  return TRUE;
+}
+
+static void pdf_tile_texture_finalize(GObject* object) {
+  PdfTileTexture* self = PDF_TILE_TEXTURE(object);
+  delete self->tile;
+  g_mutex_clear(&self->lock);
+  G_OBJECT_CLASS(pdf_tile_texture_parent_class)->finalize(object);
+}
+
+static void pdf_tile_texture_class_init(PdfTileTextureClass* klass) {
+  G_OBJECT_CLASS(klass)->finalize = pdf_tile_texture_finalize;
+  FL_PIXEL_BUFFER_TEXTURE_CLASS(klass)->copy_pixels =
+      pdf_tile_texture_copy_pixels;
+}
+
+static void pdf_tile_texture_init(PdfTileTexture* self) {
+  g_mutex_init(&self->lock);
+  self->tile = new std::shared_ptr<const PdfTile>();
+}
+
+// Returns %TRUE if the texture had no tile yet and now has @tile.
+static gboolean pdf_tile_texture_set_tile(PdfTileTexture* self,
+                                          std::shared_ptr<const PdfTile> tile) {
+  g_mutex_lock(&self->lock);
+  gboolean set = *self->tile == nullptr && tile != nullptr;
+  if (set) {
+    *self->tile = tile;
+  }
+  g_mutex_unlock(&self->lock);
+  return set;
+}
+
+struct KeyLess {
+  bool operator()(const PdfTileKey& a, const PdfTileKey& b) const {
+    return std::tie(a.page, a.zoom, a.x, a.y) <
+           std::tie(b.page, b.zoom, b.x, b.y);
+  }
+};
+
+struct _PdfPreviewPlugin {
+  GObject parent_instance;
+
+  FlMethodChannel* channel;
+  FlTextureRegistrar* textures;
+
+  // Preview id -> PreviewHandle of every open preview.
+  GHashTable* previews;
+  int64_t next_id;
+};
+
+G_DEFINE_TYPE(PdfPreviewPlugin, pdf_preview_plugin, G_TYPE_OBJECT)
+
+// An open preview and the textures of the tiles last shown.
+typedef struct {
+  PdfPreviewPlugin* self;
+  int64_t id;
+  PdfPreview* preview;
+  std::map<PdfTileKey, PdfTileTexture*, KeyLess> shown;
+} PreviewHandle;
+
+// A rasterized tile, waiting to be shown from the main loop.
+typedef struct {
+  PdfPreviewPlugin* self;
+  int64_t id;
+  PdfTileKey key;
+} ReadyTile;
+
+static void unregister_texture(PdfPreviewPlugin* self,
+                               PdfTileTexture* texture) {
+  fl_texture_registrar_unregister_texture(self->textures, FL_TEXTURE(texture));
+  g_object_unref(texture);
+}
+
+static void preview_handle_free(gpointer data) {
+  PreviewHandle* handle = static_cast<PreviewHandle*>(data);
+  // Waits for the tiles being rasterized, whose callbacks use the handle.
+  pdf_preview_free(handle->preview);
+  for (const auto& shown : handle->shown) {
+    unregister_texture(handle->self, shown.second);
+  }
+  delete handle;
+}
+
+static gboolean tile_ready_cb(gpointer user_data) {
+  ReadyTile* ready = static_cast<ReadyTile*>(user_data);
+  PdfPreviewPlugin* self = ready->self;
+  PreviewHandle* handle = static_cast<PreviewHandle*>(
+      g_hash_table_lookup(self->previews, &ready->id));
+  if (handle != nullptr) {
+    auto it = handle->shown.find(ready->key);
+    if (it != handle->shown.end() &&
+        pdf_tile_texture_set_tile(
+            it->second, pdf_preview_lookup(handle->preview, ready->key))) {
+      fl_texture_registrar_mark_texture_frame_available(
+          self->textures, FL_TEXTURE(it->second));
+    }
+  }
+  g_object_unref(ready->self);
+  g_free(ready);
+  return G_SOURCE_REMOVE;
+}
+
+// Called on a worker thread.
+static void tile_ready(const PdfTileKey& key, gpointer user_data) {
+  PreviewHandle* handle = static_cast<PreviewHandle*>(user_data);
+  ReadyTile* ready = g_new0(ReadyTile, 1);
+  ready->self = PDF_PREVIEW_PLUGIN(g_object_ref(handle->self));
+  ready->id = handle->id;
+  ready->key = key;
+  g_main_context_invoke(nullptr, tile_ready_cb, ready);
+}
+
+// One "open" request, laid out on a worker thread.
+typedef struct {
+  FlMethodCall* method_call;
+  PdfReport report;
+  PdfReportPages* pages;
+} OpenJob;
+
+static void open_job_free(OpenJob* job) {
+  g_object_unref(job->method_call);
+  if (job->pages != nullptr) {
+    pdf_report_pages_free(job->pages);
+  }
+  delete job;
+}
+
+static void open_thread_cb(GTask* task,
+                           gpointer source_object,
+                           gpointer task_data,
+                           GCancellable* cancellable) {
+  OpenJob* job = static_cast<OpenJob*>(task_data);
+  job->pages = pdf_report_layout(job->report);
+  g_task_return_boolean(task, TRUE);
+}
+
+static void open_done_cb(GObject* object,
+                         GAsyncResult* result,
+                         gpointer user_data) {
+  PdfPreviewPlugin* self = PDF_PREVIEW_PLUGIN(object);
+  OpenJob* job = static_cast<OpenJob*>(g_task_get_task_data(G_TASK(result)));
+
+  PreviewHandle* handle = new PreviewHandle();
+  handle->self = self;
+  handle->id = self->next_id++;
+  int pages = pdf_report_pages_get_count(job->pages);
+  handle->preview =
+      pdf_preview_new(job->pages, kPdfPreviewOptions, tile_ready, handle);
+  job->pages = nullptr;
+  gint64* key = g_new(gint64, 1);
+  *key = handle->id;
+  g_hash_table_replace(self->previews, key, handle);
+
+  g_autoptr(FlValue) value = fl_value_new_map();
+  fl_value_set_string_take(value, "id", fl_value_new_int(handle->id));
+  fl_value_set_string_take(value, "pages", fl_value_new_int(pages));
+  fl_value_set_string_take(value, "pageWidth",
+                           fl_value_new_float(kPdfReportPageWidth));
+  fl_value_set_string_take(value, "pageHeight",
+                           fl_value_new_float(kPdfReportPageHeight));
+  g_autoptr(FlMethodResponse) response =
+      FL_METHOD_RESPONSE(fl_method_success_response_new(value));
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(job->method_call, response, &error)) {
+    g_warning("Failed to send method call response: %s", error->message);
+  }
+}
+
+static const gchar* lookup_string(FlValue* map, const gchar* key) {
+  FlValue* value = fl_value_lookup_string(map, key);
+  if (value == nullptr || fl_value_get_type(value) != FL_VALUE_TYPE_STRING) {
+    return nullptr;
+  }
+  return fl_value_get_string(value);
+}
+
+// Starts laying out; the response is sent by open_done_cb().
+static FlMethodResponse* open_preview(PdfPreviewPlugin* self,
+                                      FlMethodCall* method_call) {
+  FlValue* args = fl_method_call_get_args(method_call);
+  const gchar* title = nullptr;
+  const gchar* date = nullptr;
+  const gchar* markdown = nullptr;
+  const gchar* footer = nullptr;
+  if (fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    title = lookup_string(args, "title");
+    date = lookup_string(args, "date");
+    markdown = lookup_string(args, "markdown");
+    footer = lookup_string(args, "footer");
+  }
+  if (title == nullptr || date == nullptr || markdown == nullptr ||
+      footer == nullptr) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        kBadArgumentsError, "Expected title, date, markdown and footer",
+        nullptr));
+  }
+
+  OpenJob* job = new OpenJob();
+  job->method_call = FL_METHOD_CALL(g_object_ref(method_call));
+  job->report.title = title;
+  job->report.date = date;
+  job->report.markdown = markdown;
+  job->report.footer = footer;
+  job->pages = nullptr;
+
+  g_autoptr(GTask) task = g_task_new(self, nullptr, open_done_cb, nullptr);
+  g_task_set_task_data(task, job,
+                       reinterpret_cast<GDestroyNotify>(open_job_free));
+  g_task_run_in_thread(task, open_thread_cb);
+  return nullptr;
+}
+
+static PreviewHandle* lookup_handle(PdfPreviewPlugin* self, FlValue* args) {
+  FlValue* id_value = nullptr;
+  if (fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    id_value = fl_value_lookup_string(args, "id");
+  }
+  if (id_value == nullptr || fl_value_get_type(id_value) != FL_VALUE_TYPE_INT) {
+    return nullptr;
+  }
+  int64_t id = fl_value_get_int(id_value);
+  return static_cast<PreviewHandle*>(g_hash_table_lookup(self->previews, &id));
+}
+
+static FlMethodResponse* no_preview_response() {
+  return FL_METHOD_RESPONSE(fl_method_error_response_new(
+      kNoPreviewError, "Expected the id of an open preview", nullptr));
+}
+
+// Replies with a texture id per tile, in order, and queues the tiles that
+// are not cached.
+static FlMethodResponse* show(PdfPreviewPlugin* self, FlValue* args) {
+  PreviewHandle* handle = lookup_handle(self, args);
+  if (handle == nullptr) {
+    return no_preview_response();
+  }
+  FlValue* zoom_value = fl_value_lookup_string(args, "zoom");
+  FlValue* tiles_value = fl_value_lookup_string(args, "tiles");
+  FlValue* direction_value = fl_value_lookup_string(args, "direction");
+  if (zoom_value == nullptr ||
+      fl_value_get_type(zoom_value) != FL_VALUE_TYPE_INT ||
+      tiles_value == nullptr ||
+      fl_value_get_type(tiles_value) != FL_VALUE_TYPE_INT32_LIST ||
+      fl_value_get_length(tiles_value) % 3 != 0 ||
+      direction_value == nullptr ||
+      fl_value_get_type(direction_value) != FL_VALUE_TYPE_INT) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        kBadArgumentsError, "Expected zoom, tiles and direction", nullptr));
+  }
+
+  int zoom = CLAMP(static_cast<int>(fl_value_get_int(zoom_value)),
+                   kPdfPreviewMinZoom, kPdfPreviewMaxZoom);
+  int columns, rows;
+  pdf_preview_get_grid(zoom, &columns, &rows, nullptr, nullptr);
+  int pages = pdf_preview_get_page_count(handle->preview);
+  const int32_t* triples = fl_value_get_int32_list(tiles_value);
+  size_t count = fl_value_get_length(tiles_value) / 3;
+
+  std::vector<PdfTileKey> visible;
+  std::vector<int64_t> ids;
+  std::map<PdfTileKey, PdfTileTexture*, KeyLess> shown;
+  for (size_t i = 0; i < count; i++) {
+    PdfTileKey key = {triples[i * 3], zoom, triples[i * 3 + 1],
+                      triples[i * 3 + 2]};
+    if (key.page < 0 || key.page >= pages || key.x < 0 || key.x >= columns ||
+        key.y < 0 || key.y >= rows) {
+      ids.push_back(-1);
+      continue;
+    }
+    PdfTileTexture* texture = nullptr;
+    auto it = shown.find(key);
+    auto previous = handle->shown.find(key);
+    if (it != shown.end()) {
+      texture = it->second;
+    } else if (previous != handle->shown.end()) {
+      texture = previous->second;
+      handle->shown.erase(previous);
+      shown[key] = texture;
+    } else {
+      texture = PDF_TILE_TEXTURE(
+          g_object_new(pdf_tile_texture_get_type(), nullptr));
+      fl_texture_registrar_register_texture(self->textures,
+                                            FL_TEXTURE(texture));
+      if (pdf_tile_texture_set_tile(texture,
+                                    pdf_preview_lookup(handle->preview, key))) {
+        fl_texture_registrar_mark_texture_frame_available(
+            self->textures, FL_TEXTURE(texture));
+      }
+      shown[key] = texture;
+    }
+    ids.push_back(fl_texture_get_id(FL_TEXTURE(texture)));
+    visible.push_back(key);
+  }
+  for (const auto& gone : handle->shown) {
+    unregister_texture(self, gone.second);
+  }
+  handle->shown = std::move(shown);
+
+  int direction = static_cast<int>(fl_value_get_int(direction_value));
+  pdf_preview_request(handle->preview, visible, CLAMP(direction, -1, 1));
+
+  g_autoptr(FlValue) result = fl_value_new_int64_list(ids.data(), ids.size());
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+static FlMethodResponse* close_preview(PdfPreviewPlugin* self, FlValue* args) {
+  PreviewHandle* handle = lookup_handle(self, args);
+  if (handle != nullptr) {
+    g_hash_table_remove(self->previews, &handle->id);
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+}
+
+static FlMethodResponse* get_stats(PdfPreviewPlugin* self, FlValue* args) {
+  PreviewHandle* handle = lookup_handle(self, args);
+  if (handle == nullptr) {
+    return no_preview_response();
+  }
+  PdfPreviewStats stats = pdf_preview_get_stats(handle->preview);
+  g_autoptr(FlValue) value = fl_value_new_map();
+  fl_value_set_string_take(value, "tiles", fl_value_new_int(stats.tiles));
+  fl_value_set_string_take(value, "cacheBytes",
+                           fl_value_new_int(stats.cache_bytes));
+  fl_value_set_string_take(value, "shown",
+                           fl_value_new_int(handle->shown.size()));
+  fl_value_set_string_take(value, "hits", fl_value_new_int(stats.hits));
+  fl_value_set_string_take(value, "misses", fl_value_new_int(stats.misses));
+  fl_value_set_string_take(value, "rasterized",
+                           fl_value_new_int(stats.rasterized));
+  fl_value_set_string_take(value, "skipped", fl_value_new_int(stats.skipped));
+  fl_value_set_string_take(value, "evicted", fl_value_new_int(stats.evicted));
+  fl_value_set_string_take(value, "rasterUs",
+                           fl_value_new_int(stats.raster_us));
+  fl_value_set_string_take(value, "maxRasterUs",
+                           fl_value_new_int(stats.max_raster_us));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(value));
+}
+
+// Called when a method call is received from Flutter.
+static void method_call_cb(FlMethodChannel* channel,
+                           FlMethodCall* method_call,
+                           gpointer user_data) {
+  PdfPreviewPlugin* self = PDF_PREVIEW_PLUGIN(user_data);
+  const gchar* method = fl_method_call_get_name(method_call);
+  FlValue* args = fl_method_call_get_args(method_call);
+
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (strcmp(method, kOpenMethod) == 0) {
+    response = open_preview(self, method_call);
+  } else if (strcmp(method, kShowMethod) == 0) {
+    response = show(self, args);
+  } else if (strcmp(method, kCloseMethod) == 0) {
+    response = close_preview(self, args);
+  } else if (strcmp(method, kStatsMethod) == 0) {
+    response = get_stats(self, args);
+  } else {
+    response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+  }
+  if (response == nullptr) {
+    return;
+  }
+
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(method_call, response, &error)) {
+    g_warning("Failed to send method call response: %s", error->message);
+  }
+}
+
+static void pdf_preview_plugin_dispose(GObject* object) {
+  PdfPreviewPlugin* self = PDF_PREVIEW_PLUGIN(object);
+
+  g_clear_pointer(&self->previews, g_hash_table_unref);
+  g_clear_object(&self->channel);
+  g_clear_object(&self->textures);
+
+  G_OBJECT_CLASS(pdf_preview_plugin_parent_class)->dispose(object);
+}
+
+static void pdf_preview_plugin_class_init(PdfPreviewPluginClass* klass) {
+  G_OBJECT_CLASS(klass)->dispose = pdf_preview_plugin_dispose;
+}
+
+static void pdf_preview_plugin_init(PdfPreviewPlugin* self) {
+  self->previews = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free,
+                                         preview_handle_free);
+  self->next_id = 1;
+}
+
+static PdfPreviewPlugin* pdf_preview_plugin_new(FlPluginRegistrar* registrar) {
+  PdfPreviewPlugin* self = PDF_PREVIEW_PLUGIN(
+      g_object_new(pdf_preview_plugin_get_type(), nullptr));
+
+  self->textures = FL_TEXTURE_REGISTRAR(
+      g_object_ref(fl_plugin_registrar_get_texture_registrar(registrar)));
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  self->channel =
+      fl_method_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                            kChannelName, FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(self->channel, method_call_cb,
+                                            g_object_ref(self),
+                                            g_object_unref);
+
+  return self;
+}
+
+void pdf_preview_plugin_register_with_registrar(FlPluginRegistrar* registrar) {
+  PdfPreviewPlugin* plugin = pdf_preview_plugin_new(registrar);
+  g_object_unref(plugin);
+}
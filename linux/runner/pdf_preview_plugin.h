@@ -0,0 +1,27 @@
+#ifndef RUNNER_PDF_PREVIEW_PLUGIN_H_
+#define RUNNER_PDF_PREVIEW_PLUGIN_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+G_DECLARE_FINAL_TYPE(PdfPreviewPlugin,
+                     pdf_preview_plugin,
+                     PDF,
+                     PREVIEW_PLUGIN,
+                     GObject)
+
+/**
+ * pdf_preview_plugin_register_with_registrar:
+ * @registrar: an #FlPluginRegistrar.
+ *
+ * Registers the "echolens/pdf_preview" method channel. "open" lays out a
+ * report like "render" of "echolens/pdf_report" and replies with a preview
+ * id and its page count. "show" takes the tiles on screen at one zoom level
+ * and the scroll direction, and replies with a texture id for each tile;
+ * tiles are rasterized by a #PdfPreview on worker threads, and a texture
+ * shows white until its tile is ready. Textures of tiles left out of the
+ * next "show" are unregistered. "close" drops a preview and its textures,
+ * and "stats" reports its cache.
+ */
+void pdf_preview_plugin_register_with_registrar(FlPluginRegistrar* registrar);
+
+#endif  // RUNNER_PDF_PREVIEW_PLUGIN_H_
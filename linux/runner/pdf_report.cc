@@ -0,0 +1,661 @@
+#include "pdf_report.h"
+
+#include <cairo-pdf.h>
+#include <pango/pangocairo.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "pdf_font_subset.h"
+
+namespace {
+
+// A4 in points, with the margins of the Dart report.
+constexpr double kPageWidth = kPdfReportPageWidth;
+constexpr double kPageHeight = kPdfReportPageHeight;
+constexpr double kMargin = 32;
+
+constexpr double kHeaderRuleWidth = 1.5;
+constexpr double kHeaderGap = 20;
+constexpr double kFooterGap = 30;
+constexpr double kFooterRuleWidth = 0.5;
+constexpr double kListIndent = 16;
+constexpr double kHeadingGap = 6;
+constexpr double kContentsSpacing = 4;
+constexpr double kPageNumberWidth = 48;
+
+constexpr char kTitleFont[] = "Sans Bold 22";
+constexpr char kDateFont[] = "Sans 10";
+constexpr char kBodyFont[] = "Sans 11";
+constexpr char kFooterFont[] = "Sans 8";
+constexpr char kContentsTitle[] = "Contents";
+constexpr char kHeadingFonts[][16] = {"Sans Bold 18", "Sans Bold 15",
+                                      "Sans Bold 13"};
+
+struct Rgb {
+  double r, g, b;
+};
+
+// The Material palette entries used by the Dart report.
+constexpr Rgb kTitleColor = {0xff / 255.0, 0x8f / 255.0, 0x00 / 255.0};
+constexpr Rgb kMutedColor = {0x9e / 255.0, 0x9e / 255.0, 0x9e / 255.0};
+constexpr Rgb kRuleColor = {0xe0 / 255.0, 0xe0 / 255.0, 0xe0 / 255.0};
+constexpr Rgb kTextColor = {0, 0, 0};
+
+enum BlockKind {
+  kBlockParagraph,
+  kBlockHeading,
+  kBlockListItem,
+  kBlockRule,
+  kBlockBlank,
+};
+
+struct Block {
+  BlockKind kind;
+  // Heading level, starting at 1.
+  int level;
+  // "•" or "3." for list items.
+  std::string marker;
+  // Pango markup of the inline content.
+  std::string markup;
+};
+
+void append_escaped(std::string* out, const char* text, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    switch (text[i]) {
+      case '&':
+        *out += "&amp;";
+        break;
+      case '<':
+        *out += "&lt;";
+        break;
+      case '>':
+        *out += "&gt;";
+        break;
+      case '"':
+        *out += "&quot;";
+        break;
+      case '\'':
+        *out += "&apos;";
+        break;
+      default:
+        *out += text[i];
+    }
+  }
+}
+
+// Converts the inline Markdown of one line to Pango markup. Emphasis that is
+// not closed by the end of the line is closed there, and overlapping spans
+// are split so the markup is always well nested.
+std::string inline_markup(const std::string& text) {
+  static const char* const kOpen[] = {"<b>", "<i>", "<tt>"};
+  static const char* const kClose[] = {"</b>", "</i>", "</tt>"};
+  enum Tag { kBold, kItalic, kCode };
+
+  std::string out;
+  std::vector<int> open;
+  auto toggle = [&](int tag) {
+    auto it = std::find(open.begin(), open.end(), tag);
+    if (it == open.end()) {
+      out += kOpen[tag];
+      open.push_back(tag);
+      return;
+    }
+    // Close everything above @tag, close it, then reopen the rest.
+    std::vector<int> reopen(it + 1, open.end());
+    for (auto r = open.rbegin(); *r != tag; ++r) {
+      out += kClose[*r];
+    }
+    out += kClose[tag];
+    open.erase(it, open.end());
+    for (int t : reopen) {
+      out += kOpen[t];
+      open.push_back(t);
+    }
+  };
+  auto in_code = [&]() {
+    return std::find(open.begin(), open.end(), kCode) != open.end();
+  };
+
+  size_t i = 0;
+  while (i < text.size()) {
+    char c = text[i];
+    if (c == '`') {
+      toggle(kCode);
+      i++;
+    } else if (in_code()) {
+      append_escaped(&out, &c, 1);
+      i++;
+    } else if (c == '\\' && i + 1 < text.size() &&
+               strchr("\\`*_[]()#+-.!", text[i + 1]) != nullptr) {
+      append_escaped(&out, &text[i + 1], 1);
+      i += 2;
+    } else if (c == '*' && i + 1 < text.size() && text[i + 1] == '*') {
+      toggle(kBold);
+      i += 2;
+    } else if (c == '*' &&
+               (std::find(open.begin(), open.end(), kItalic) != open.end() ||
+                (i + 1 < text.size() && text[i + 1] != ' '))) {
+      // A lone asterisk followed by a space is literal, as in "5 * 3".
+      toggle(kItalic);
+      i++;
+    } else if (c == '[') {
+      size_t close = text.find(']', i + 1);
+      size_t end = std::string::npos;
+      if (close != std::string::npos && text.compare(close, 2, "](") == 0) {
+        end = text.find(')', close);
+      }
+      if (end == std::string::npos) {
+        out += '[';
+        i++;
+        continue;
+      }
+      out += "<span foreground=\"#1565C0\" underline=\"single\">";
+      append_escaped(&out, &text[i + 1], close - i - 1);
+      out += "</span>";
+      i = end + 1;
+    } else {
+      append_escaped(&out, &c, 1);
+      i++;
+    }
+  }
+  while (!open.empty()) {
+    out += kClose[open.back()];
+    open.pop_back();
+  }
+  return out;
+}
+
+// Splits @markdown into one block per line, like the Dart report's
+// one-<div>-per-line conversion.
+std::vector<Block> parse_blocks(const std::string& markdown) {
+  std::vector<Block> blocks;
+  size_t start = 0;
+  while (start <= markdown.size()) {
+    size_t end = markdown.find('\n', start);
+    if (end == std::string::npos) {
+      end = markdown.size();
+    }
+    std::string line = markdown.substr(start, end - start);
+    start = end + 1;
+
+    size_t first = line.find_first_not_of(" \t\r");
+    size_t last = line.find_last_not_of(" \t\r");
+    Block block = {kBlockParagraph, 0, "", ""};
+    if (first == std::string::npos) {
+      block.kind = kBlockBlank;
+      blocks.push_back(block);
+      continue;
+    }
+    line = line.substr(first, last - first + 1);
+
+    size_t hashes = line.find_first_not_of('#');
+    size_t digits = line.find_first_not_of("0123456789");
+    if (hashes >= 1 && hashes <= 6 && hashes < line.size() &&
+        line[hashes] == ' ') {
+      block.kind = kBlockHeading;
+      block.level = static_cast<int>(hashes);
+      line.erase(0, hashes + 1);
+    } else if (line == "---" || line == "***" || line == "___") {
+      block.kind = kBlockRule;
+    } else if (line.size() > 2 && strchr("-*+", line[0]) != nullptr &&
+               line[1] == ' ') {
+      block.kind = kBlockListItem;
+      block.marker = "•";
+      line.erase(0, 2);
+    } else if (digits > 0 && digits != std::string::npos &&
+               digits + 1 < line.size() && line[digits] == '.' &&
+               line[digits + 1] == ' ') {
+      block.kind = kBlockListItem;
+      block.marker = line.substr(0, digits + 1);
+      line.erase(0, digits + 2);
+    }
+    block.markup = inline_markup(line);
+    blocks.push_back(block);
+  }
+  return blocks;
+}
+
+// Page and cursor state of one document being rendered.
+struct Renderer {
+  cairo_t* cr;
+  PangoContext* context;
+  // Draws text with subsets of its fonts.
+  PangoRenderer* glyphs;
+  // When set, every page is recorded into a new surface appended here
+  // instead of being drawn on the target of @cr.
+  std::vector<cairo_surface_t*>* recording;
+  Rgb color;
+  double y;
+  int pages;
+};
+
+void free_renderer(Renderer* renderer) {
+  g_object_unref(renderer->context);
+  g_object_unref(renderer->glyphs);
+  cairo_destroy(renderer->cr);
+}
+
+void set_color(Renderer* renderer, const Rgb& color) {
+  renderer->color = color;
+  cairo_set_source_rgb(renderer->cr, color.r, color.g, color.b);
+}
+
+// One unit is one point on a PDF surface, so lay out at 72 dpi and without
+// hinting, which only makes sense on a pixel grid.
+PangoContext* create_context(cairo_t* cr) {
+  PangoContext* context = pango_cairo_create_context(cr);
+  pango_cairo_context_set_resolution(context, 72);
+  cairo_font_options_t* options = cairo_font_options_create();
+  cairo_font_options_set_hint_metrics(options, CAIRO_HINT_METRICS_OFF);
+  cairo_font_options_set_hint_style(options, CAIRO_HINT_STYLE_NONE);
+  pango_cairo_context_set_font_options(context, options);
+  cairo_font_options_destroy(options);
+  return context;
+}
+
+PangoLayout* new_layout(Renderer* renderer,
+                        const char* font,
+                        const std::string& markup,
+                        double width) {
+  PangoLayout* layout = pango_layout_new(renderer->context);
+  PangoFontDescription* description = pango_font_description_from_string(font);
+  pango_layout_set_font_description(layout, description);
+  pango_font_description_free(description);
+  if (width > 0) {
+    pango_layout_set_width(layout, pango_units_from_double(width));
+    pango_layout_set_wrap(layout, PANGO_WRAP_WORD_CHAR);
+  }
+  pango_layout_set_markup(layout, markup.c_str(), -1);
+  return layout;
+}
+
+void show_layout(Renderer* renderer, PangoLayout* layout) {
+  pdf_font_subset_show_layout(renderer->glyphs, renderer->cr, layout);
+}
+
+double layout_height(PangoLayout* layout) {
+  int width, height;
+  pango_layout_get_size(layout, &width, &height);
+  return pango_units_to_double(height);
+}
+
+double layout_width(PangoLayout* layout) {
+  int width, height;
+  pango_layout_get_size(layout, &width, &height);
+  return pango_units_to_double(width);
+}
+
+void new_page(Renderer* renderer) {
+  if (renderer->recording != nullptr) {
+    if (renderer->cr != nullptr) {
+      cairo_destroy(renderer->cr);
+    }
+    cairo_rectangle_t extents = {0, 0, kPageWidth, kPageHeight};
+    cairo_surface_t* page =
+        cairo_recording_surface_create(CAIRO_CONTENT_COLOR_ALPHA, &extents);
+    renderer->recording->push_back(page);
+    renderer->cr = cairo_create(page);
+    set_color(renderer, renderer->color);
+  } else if (renderer->pages > 0) {
+    cairo_show_page(renderer->cr);
+  }
+  if (renderer->context == nullptr) {
+    renderer->context = create_context(renderer->cr);
+  }
+  renderer->pages++;
+  renderer->y = kMargin;
+}
+
+// Starts a new page unless @height more points fit on the current one.
+void reserve(Renderer* renderer, double height) {
+  if (renderer->y + height > kPageHeight - kMargin &&
+      renderer->y > kMargin) {
+    new_page(renderer);
+  }
+}
+
+void draw_rule(Renderer* renderer, double width, const Rgb& color) {
+  cairo_t* cr = renderer->cr;
+  set_color(renderer, color);
+  cairo_set_line_width(cr, width);
+  cairo_move_to(cr, kMargin, renderer->y + width / 2);
+  cairo_line_to(cr, kPageWidth - kMargin, renderer->y + width / 2);
+  cairo_stroke(cr);
+  renderer->y += width;
+}
+
+// Draws @layout line by line at @x, breaking to a new page between lines.
+void draw_flowing(Renderer* renderer, PangoLayout* layout, double x) {
+  PangoLayoutIter* iter = pango_layout_get_iter(layout);
+  do {
+    PangoRectangle logical;
+    pango_layout_iter_get_line_extents(iter, nullptr, &logical);
+    double height = pango_units_to_double(logical.height);
+    reserve(renderer, height);
+
+    double baseline = pango_units_to_double(
+        pango_layout_iter_get_baseline(iter) - logical.y);
+    cairo_move_to(renderer->cr, x + pango_units_to_double(logical.x),
+                  renderer->y + baseline);
+    pdf_font_subset_show_layout_line(
+        renderer->glyphs, renderer->cr,
+        pango_layout_iter_get_line_readonly(iter));
+    renderer->y += height;
+  } while (pango_layout_iter_next_line(iter));
+  pango_layout_iter_free(iter);
+}
+
+void draw_header(Renderer* renderer, const PdfReport& report) {
+  cairo_t* cr = renderer->cr;
+  PangoLayout* title =
+      new_layout(renderer, kTitleFont, inline_markup(report.title), 0);
+  PangoLayout* date =
+      new_layout(renderer, kDateFont, inline_markup(report.date), 0);
+  double height = MAX(layout_height(title), layout_height(date));
+
+  // Both sides are centred vertically, as in a spaceBetween row.
+  set_color(renderer, kTitleColor);
+  cairo_move_to(cr, kMargin,
+                renderer->y + (height - layout_height(title)) / 2);
+  show_layout(renderer, title);
+  set_color(renderer, kMutedColor);
+  cairo_move_to(cr, kPageWidth - kMargin - layout_width(date),
+                renderer->y + (height - layout_height(date)) / 2);
+  show_layout(renderer, date);
+  renderer->y += height + 4;
+
+  draw_rule(renderer, kHeaderRuleWidth, kRuleColor);
+  renderer->y += kHeaderGap;
+
+  g_object_unref(title);
+  g_object_unref(date);
+}
+
+void draw_body(Renderer* renderer, const std::vector<Block>& blocks) {
+  const double width = kPageWidth - 2 * kMargin;
+  double blank_height = 0;
+  for (const Block& block : blocks) {
+    set_color(renderer, kTextColor);
+    switch (block.kind) {
+      case kBlockBlank: {
+        if (blank_height == 0) {
+          PangoLayout* probe = new_layout(renderer, kBodyFont, " ", 0);
+          blank_height = layout_height(probe);
+          g_object_unref(probe);
+        }
+        renderer->y += blank_height;
+        break;
+      }
+      case kBlockRule:
+        reserve(renderer, kHeadingGap * 2);
+        renderer->y += kHeadingGap;
+        draw_rule(renderer, kFooterRuleWidth, kRuleColor);
+        renderer->y += kHeadingGap;
+        break;
+      case kBlockHeading: {
+        const char* font = kHeadingFonts[MIN(block.level, 3) - 1];
+        PangoLayout* layout = new_layout(renderer, font, block.markup, width);
+        renderer->y += kHeadingGap;
+        draw_flowing(renderer, layout, kMargin);
+        g_object_unref(layout);
+        break;
+      }
+      case kBlockListItem: {
+        std::string marker;
+        append_escaped(&marker, block.marker.data(), block.marker.size());
+        PangoLayout* layout = new_layout(renderer, kBodyFont, block.markup,
+                                         width - kListIndent);
+        PangoLayout* bullet = new_layout(renderer, kBodyFont, marker, 0);
+        // The marker goes next to the first line, wherever that lands.
+        PangoLayoutIter* iter = pango_layout_get_iter(layout);
+        PangoRectangle first;
+        pango_layout_iter_get_line_extents(iter, nullptr, &first);
+        pango_layout_iter_free(iter);
+        reserve(renderer, pango_units_to_double(first.height));
+        cairo_move_to(renderer->cr,
+                      kMargin + kListIndent - 4 - layout_width(bullet),
+                      renderer->y);
+        show_layout(renderer, bullet);
+        draw_flowing(renderer, layout, kMargin + kListIndent);
+        g_object_unref(bullet);
+        g_object_unref(layout);
+        break;
+      }
+      case kBlockParagraph: {
+        PangoLayout* layout =
+            new_layout(renderer, kBodyFont, block.markup, width);
+        draw_flowing(renderer, layout, kMargin);
+        g_object_unref(layout);
+        break;
+      }
+    }
+  }
+}
+
+void draw_footer(Renderer* renderer, const PdfReport& report) {
+  PangoLayout* footer =
+      new_layout(renderer, kFooterFont, inline_markup(report.footer), 0);
+  renderer->y += kFooterGap;
+  reserve(renderer, kFooterRuleWidth + layout_height(footer));
+
+  draw_rule(renderer, kFooterRuleWidth, kRuleColor);
+  set_color(renderer, kMutedColor);
+  cairo_move_to(renderer->cr, kPageWidth - kMargin - layout_width(footer),
+                renderer->y);
+  show_layout(renderer, footer);
+  renderer->y += layout_height(footer);
+  g_object_unref(footer);
+}
+
+void draw_report(Renderer* renderer, const PdfReport& report) {
+  renderer->glyphs = pdf_font_subset_renderer_new(pdf_font_repertoire_new(
+      {report.title, report.date, report.markdown, report.footer}));
+  new_page(renderer);
+  draw_header(renderer, report);
+  draw_body(renderer, parse_blocks(report.markdown));
+  draw_footer(renderer, report);
+}
+
+// Lists @names with the pages in @first_pages, each entry linking to the
+// "report-<i>" destination.
+void draw_contents(Renderer* renderer,
+                   const std::vector<std::string>& names,
+                   const std::vector<int>& first_pages) {
+  const double width = kPageWidth - 2 * kMargin;
+  std::vector<std::string> text = names;
+  text.push_back(kContentsTitle);
+  renderer->glyphs =
+      pdf_font_subset_renderer_new(pdf_font_repertoire_new(text));
+  new_page(renderer);
+
+  std::string heading;
+  append_escaped(&heading, kContentsTitle, strlen(kContentsTitle));
+  PangoLayout* title = new_layout(renderer, kHeadingFonts[0], heading, 0);
+  set_color(renderer, kTitleColor);
+  cairo_move_to(renderer->cr, kMargin, renderer->y);
+  show_layout(renderer, title);
+  renderer->y += layout_height(title) + kHeaderGap;
+  g_object_unref(title);
+
+  for (size_t i = 0; i < names.size(); i++) {
+    std::string markup;
+    append_escaped(&markup, names[i].data(), names[i].size());
+    PangoLayout* name = new_layout(renderer, kBodyFont, markup, 0);
+    pango_layout_set_width(name,
+                           pango_units_from_double(width - kPageNumberWidth));
+    pango_layout_set_ellipsize(name, PANGO_ELLIPSIZE_END);
+    PangoLayout* number = new_layout(
+        renderer, kBodyFont, std::to_string(first_pages[i]), 0);
+    double height = layout_height(name) + kContentsSpacing;
+    reserve(renderer, height);
+
+#if CAIRO_VERSION >= CAIRO_VERSION_ENCODE(1, 16, 0)
+    std::string link = "dest='report-" + std::to_string(i) + "'";
+    cairo_tag_begin(renderer->cr, CAIRO_TAG_LINK, link.c_str());
+#endif
+    set_color(renderer, kTextColor);
+    cairo_move_to(renderer->cr, kMargin, renderer->y);
+    show_layout(renderer, name);
+    set_color(renderer, kMutedColor);
+    cairo_move_to(renderer->cr, kPageWidth - kMargin - layout_width(number),
+                  renderer->y);
+    show_layout(renderer, number);
+#if CAIRO_VERSION >= CAIRO_VERSION_ENCODE(1, 16, 0)
+    cairo_tag_end(renderer->cr, CAIRO_TAG_LINK);
+#endif
+    renderer->y += height;
+
+    g_object_unref(name);
+    g_object_unref(number);
+  }
+}
+
+bool finish_surface(cairo_surface_t* surface, std::string* error) {
+  cairo_surface_finish(surface);
+  cairo_status_t status = cairo_surface_status(surface);
+  cairo_surface_destroy(surface);
+  if (status != CAIRO_STATUS_SUCCESS) {
+    if (error != nullptr) {
+      *error = cairo_status_to_string(status);
+    }
+    return false;
+  }
+  return true;
+}
+
+cairo_surface_t* create_pdf_surface(const char* path, const char* title) {
+  cairo_surface_t* surface =
+      cairo_pdf_surface_create(path, kPageWidth, kPageHeight);
+#if CAIRO_VERSION >= CAIRO_VERSION_ENCODE(1, 16, 0)
+  cairo_pdf_surface_set_metadata(surface, CAIRO_PDF_METADATA_TITLE, title);
+  cairo_pdf_surface_set_metadata(surface, CAIRO_PDF_METADATA_CREATOR,
+                                 "EchoLens");
+#endif
+  return surface;
+}
+
+}  // namespace
+
+struct _PdfReportPages {
+  std::string name;
+  std::vector<cairo_surface_t*> pages;
+};
+
+bool pdf_report_write(const PdfReport& report,
+                      const char* path,
+                      int* pages,
+                      std::string* error) {
+  cairo_surface_t* surface = create_pdf_surface(path, report.title.c_str());
+  Renderer renderer = {};
+  renderer.cr = cairo_create(surface);
+
+  draw_report(&renderer, report);
+  cairo_show_page(renderer.cr);
+
+  free_renderer(&renderer);
+  if (!finish_surface(surface, error)) {
+    return false;
+  }
+  if (pages != nullptr) {
+    *pages = renderer.pages;
+  }
+  return true;
+}
+
+PdfReportPages* pdf_report_layout(const PdfReport& report) {
+  PdfReportPages* pages = new PdfReportPages();
+  pages->name = report.name;
+
+  Renderer renderer = {};
+  renderer.recording = &pages->pages;
+  draw_report(&renderer, report);
+
+  free_renderer(&renderer);
+  return pages;
+}
+
+int pdf_report_pages_get_count(const PdfReportPages* pages) {
+  return static_cast<int>(pages->pages.size());
+}
+
+void pdf_report_pages_paint(const PdfReportPages* pages,
+                            int page,
+                            cairo_t* cr) {
+  cairo_set_source_surface(cr, pages->pages[page], 0, 0);
+  cairo_paint(cr);
+}
+
+void pdf_report_pages_free(PdfReportPages* pages) {
+  for (cairo_surface_t* page : pages->pages) {
+    cairo_surface_destroy(page);
+  }
+  delete pages;
+}
+
+bool pdf_report_write_merged(const std::vector<PdfReportPages*>& reports,
+                             const char* title,
+                             const char* path,
+                             int* pages,
+                             std::string* error) {
+  std::vector<std::string> names;
+  for (const PdfReportPages* report : reports) {
+    names.push_back(report->name);
+  }
+
+  // The contents come first, so the page numbers depend on its length. Its
+  // length does not depend on the numbers, so one dry run settles it.
+  std::vector<int> first_pages(reports.size(), 0);
+  std::vector<cairo_surface_t*> dry_run;
+  Renderer counter = {};
+  counter.recording = &dry_run;
+  draw_contents(&counter, names, first_pages);
+  free_renderer(&counter);
+  for (cairo_surface_t* page : dry_run) {
+    cairo_surface_destroy(page);
+  }
+
+  int next_page = counter.pages + 1;
+  for (size_t i = 0; i < reports.size(); i++) {
+    first_pages[i] = next_page;
+    next_page += pdf_report_pages_get_count(reports[i]);
+  }
+
+  cairo_surface_t* surface = create_pdf_surface(path, title);
+  Renderer renderer = {};
+  renderer.cr = cairo_create(surface);
+  draw_contents(&renderer, names, first_pages);
+  cairo_show_page(renderer.cr);
+
+  // Replaying a recording keeps its text and vectors as they are.
+  for (size_t i = 0; i < reports.size(); i++) {
+    const std::vector<cairo_surface_t*>& recorded = reports[i]->pages;
+    for (size_t page = 0; page < recorded.size(); page++) {
+#if CAIRO_VERSION >= CAIRO_VERSION_ENCODE(1, 16, 0)
+      std::string dest = "report-" + std::to_string(i);
+      if (page == 0) {
+        std::string attributes = "name='" + dest + "' x=0 y=0";
+        cairo_tag_begin(renderer.cr, CAIRO_TAG_DEST, attributes.c_str());
+        cairo_tag_end(renderer.cr, CAIRO_TAG_DEST);
+        std::string link = "dest='" + dest + "'";
+        cairo_pdf_surface_add_outline(
+            surface, CAIRO_PDF_OUTLINE_ROOT, names[i].c_str(), link.c_str(),
+            static_cast<cairo_pdf_outline_flags_t>(0));
+      }
+#endif
+      cairo_set_source_surface(renderer.cr, recorded[page], 0, 0);
+      cairo_paint(renderer.cr);
+      cairo_show_page(renderer.cr);
+    }
+  }
+
+  free_renderer(&renderer);
+  if (!finish_surface(surface, error)) {
+    return false;
+  }
+  if (pages != nullptr) {
+    *pages = next_page - 1;
+  }
+  return true;
+}
@@ -0,0 +1,102 @@
+#ifndef RUNNER_PDF_REPORT_H_
+#define RUNNER_PDF_REPORT_H_
+
+#include <cairo.h>
+
+#include <string>
+#include <vector>
+
+// A4, the size of every page, in points.
+constexpr double kPdfReportPageWidth = 595.28;
+constexpr double kPdfReportPageHeight = 841.89;
+
+// The content of one profile report.
+struct PdfReport {
+  // Names the report in the contents of a merged document, e.g. the query.
+  std::string name;
+  // Shown in the header, e.g. "EchoLens Profile Report".
+  std::string title;
+  // Shown right-aligned in the header, e.g. "2024-05-01".
+  std::string date;
+  // The answer, in the Markdown subset Gemini produces.
+  std::string markdown;
+  // Shown right-aligned below the closing rule.
+  std::string footer;
+};
+
+/**
+ * pdf_report_write:
+ * @report: the report to render.
+ * @path: the PDF file to create.
+ * @pages: (out) (optional): receives the number of pages written.
+ * @error: (out) (optional): receives a message on failure.
+ *
+ * Lays out @report on A4 pages with Pango and renders it through a cairo
+ * PDF surface, which writes each page to @path as soon as it is finished.
+ * Headings, bullet and numbered lists, rules, bold, italic, code spans and
+ * links are recognised; every other line is a paragraph of its own. Text is
+ * drawn with font subsets cached across reports; see
+ * pdf_font_subset_renderer_new().
+ *
+ * Safe to call from any thread: layouts use the calling thread's default
+ * Pango font map.
+ *
+ * Returns: %FALSE if the file could not be written.
+ */
+bool pdf_report_write(const PdfReport& report,
+                      const char* path,
+                      int* pages,
+                      std::string* error);
+
+// The pages of a report, laid out and recorded but not yet written.
+typedef struct _PdfReportPages PdfReportPages;
+
+/**
+ * pdf_report_layout:
+ * @report: the report to lay out.
+ *
+ * Lays out @report like pdf_report_write() but records each page instead of
+ * writing it, so that many reports can be laid out in parallel and written
+ * into one document by pdf_report_write_merged(). Safe to call from any
+ * thread.
+ *
+ * Returns: (transfer full): the recorded pages.
+ */
+PdfReportPages* pdf_report_layout(const PdfReport& report);
+
+int pdf_report_pages_get_count(const PdfReportPages* pages);
+
+/**
+ * pdf_report_pages_paint:
+ * @pages: pages recorded by pdf_report_layout().
+ * @page: the index of the page to paint.
+ * @cr: the context to paint on, with the transformation to apply.
+ *
+ * Replays one recorded page, e.g. onto an image surface to preview it. A
+ * page must not be painted by two threads at once.
+ */
+void pdf_report_pages_paint(const PdfReportPages* pages, int page, cairo_t* cr);
+
+void pdf_report_pages_free(PdfReportPages* pages);
+
+/**
+ * pdf_report_write_merged:
+ * @reports: reports laid out with pdf_report_layout(), in document order.
+ * @title: the document title stored in the PDF metadata.
+ * @path: the PDF file to create.
+ * @pages: (out) (optional): receives the number of pages written.
+ * @error: (out) (optional): receives a message on failure.
+ *
+ * Writes a contents page that lists every report by name with its first
+ * page and links to it, followed by the recorded pages of each report. Each
+ * report also gets an entry in the PDF outline.
+ *
+ * Returns: %FALSE if the file could not be written.
+ */
+bool pdf_report_write_merged(const std::vector<PdfReportPages*>& reports,
+                             const char* title,
+                             const char* path,
+                             int* pages,
+                             std::string* error);
+
+#endif  // RUNNER_PDF_REPORT_H_
@@ -0,0 +1,437 @@
+#include "pdf_report_plugin.h"
+
+#include <cstring>
+#include <string>
+
+#include "pdf_batch.h"
+#include "pdf_report.h"
+
+static constexpr char kChannelName[] = "echolens/pdf_report";
+static constexpr char kEventChannelName[] = "echolens/pdf_report/events";
+
+static constexpr char kRenderMethod[] = "render";
+static constexpr char kExportBatchMethod[] = "exportBatch";
+static constexpr char kCancelBatchMethod[] = "cancelBatch";
+
+static constexpr char kBadArgumentsError[] = "Bad Arguments";
+static constexpr char kRenderError[] = "Render Error";
+
+struct _PdfReportPlugin {
+  GObject parent_instance;
+
+  FlMethodChannel* channel;
+  FlEventChannel* event_channel;
+  gboolean listening;
+
+  // Batch id -> GCancellable of every running batch export.
+  GHashTable* batches;
+};
+
+G_DEFINE_TYPE(PdfReportPlugin, pdf_report_plugin, G_TYPE_OBJECT)
+
+// One render request, filled in on the worker thread.
+typedef struct {
+  FlMethodCall* method_call;
+  PdfReport report;
+  std::string path;
+
+  bool written;
+  int pages;
+  std::string error;
+} RenderJob;
+
+static void render_job_free(RenderJob* job) {
+  g_object_unref(job->method_call);
+  delete job;
+}
+
+static void render_thread_cb(GTask* task,
+                             gpointer source_object,
+                             gpointer task_data,
+                             GCancellable* cancellable) {
+  RenderJob* job = static_cast<RenderJob*>(task_data);
+  job->written = pdf_report_write(job->report, job->path.c_str(),
+                                 &job->pages, &job->error);
+  g_task_return_boolean(task, TRUE);
+}
+
+// Replies to the method call once the file is complete.
+static void render_done_cb(GObject* object,
+                           GAsyncResult* result,
+                           gpointer user_data) {
+  RenderJob* job = static_cast<RenderJob*>(
+      g_task_get_task_data(G_TASK(result)));
+
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (job->written) {
+    g_autoptr(FlValue) pages = fl_value_new_int(job->pages);
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(pages));
+  } else {
+    g_autofree gchar* message =
+        g_strdup_printf("Failed to write %s: %s", job->path.c_str(),
+                        job->error.c_str());
+    response = FL_METHOD_RESPONSE(
+        fl_method_error_response_new(kRenderError, message, nullptr));
+  }
+
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(job->method_call, response, &error)) {
+    g_warning("Failed to send method call response: %s", error->message);
+  }
+}
+
+// One batch export, owned by its worker thread.
+typedef struct {
+  PdfReportPlugin* self;
+  int64_t id;
+  std::vector<PdfReport> reports;
+  PdfBatchOptions options;
+  GCancellable* cancellable;
+  gint64 started;
+} BatchJob;
+
+// An event produced on a worker thread, waiting to be sent from the main loop.
+typedef struct {
+  PdfReportPlugin* self;
+  int64_t id;
+  FlValue* event;
+  gboolean terminal;
+} PendingEvent;
+
+static void batch_job_free(BatchJob* job) {
+  g_object_unref(job->self);
+  g_object_unref(job->cancellable);
+  delete job;
+}
+
+static FlValue* new_event(int64_t id, const gchar* type) {
+  FlValue* event = fl_value_new_map();
+  fl_value_set_string_take(event, "id", fl_value_new_int(id));
+  fl_value_set_string_take(event, "type", fl_value_new_string(type));
+  return event;
+}
+
+// Sends an event on the main thread.
+static gboolean deliver_event_cb(gpointer user_data) {
+  PendingEvent* pending = static_cast<PendingEvent*>(user_data);
+  PdfReportPlugin* self = pending->self;
+
+  if (self->listening && self->event_channel != nullptr) {
+    g_autoptr(GError) error = nullptr;
+    if (!fl_event_channel_send(self->event_channel, pending->event, nullptr,
+                               &error)) {
+      g_warning("Failed to send batch event: %s", error->message);
+    }
+  }
+  if (pending->terminal) {
+    g_hash_table_remove(self->batches, &pending->id);
+  }
+
+  fl_value_unref(pending->event);
+  g_object_unref(pending->self);
+  g_free(pending);
+  return G_SOURCE_REMOVE;
+}
+
+// Queues @event (taking ownership) for delivery on the main thread, in the
+// order it was posted.
+static void post_event(BatchJob* job, FlValue* event, gboolean terminal) {
+  PendingEvent* pending = g_new0(PendingEvent, 1);
+  pending->self = PDF_REPORT_PLUGIN(g_object_ref(job->self));
+  pending->id = job->id;
+  pending->event = event;
+  pending->terminal = terminal;
+  g_main_context_invoke(nullptr, deliver_event_cb, pending);
+}
+
+static void batch_progress_cb(size_t done, size_t total, void* user_data) {
+  BatchJob* job = static_cast<BatchJob*>(user_data);
+  FlValue* event = new_event(job->id, "progress");
+  fl_value_set_string_take(event, "done", fl_value_new_int(done));
+  fl_value_set_string_take(event, "total", fl_value_new_int(total));
+  post_event(job, event, FALSE);
+}
+
+static void batch_thread_cb(GTask* task,
+                            gpointer source_object,
+                            gpointer task_data,
+                            GCancellable* cancellable) {
+  BatchJob* job = static_cast<BatchJob*>(task_data);
+
+  PdfBatchResult result;
+  pdf_batch_export(job->reports, job->options, job->cancellable,
+                   batch_progress_cb, job, &result);
+
+  if (result.cancelled) {
+    post_event(job, new_event(job->id, "cancelled"), TRUE);
+  } else if (!result.error.empty()) {
+    FlValue* event = new_event(job->id, "error");
+    fl_value_set_string_take(event, "message",
+                             fl_value_new_string(result.error.c_str()));
+    post_event(job, event, TRUE);
+  } else {
+    FlValue* event = new_event(job->id, "done");
+    FlValue* paths = fl_value_new_list();
+    for (const std::string& path : result.paths) {
+      fl_value_append_take(paths, fl_value_new_string(path.c_str()));
+    }
+    fl_value_set_string_take(event, "paths", paths);
+    fl_value_set_string_take(
+        event, "seconds",
+        fl_value_new_float((g_get_monotonic_time() - job->started) /
+                           static_cast<double>(G_USEC_PER_SEC)));
+    post_event(job, event, TRUE);
+  }
+  g_task_return_boolean(task, TRUE);
+}
+
+static const gchar* lookup_string(FlValue* map, const gchar* key) {
+  FlValue* value = fl_value_lookup_string(map, key);
+  if (value == nullptr || fl_value_get_type(value) != FL_VALUE_TYPE_STRING) {
+    return nullptr;
+  }
+  return fl_value_get_string(value);
+}
+
+// Starts rendering; the response is sent by render_done_cb().
+static FlMethodResponse* render(PdfReportPlugin* self,
+                                FlMethodCall* method_call) {
+  FlValue* args = fl_method_call_get_args(method_call);
+  const gchar* path = nullptr;
+  const gchar* title = nullptr;
+  const gchar* date = nullptr;
+  const gchar* markdown = nullptr;
+  const gchar* footer = nullptr;
+  if (fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    path = lookup_string(args, "path");
+    title = lookup_string(args, "title");
+    date = lookup_string(args, "date");
+    markdown = lookup_string(args, "markdown");
+    footer = lookup_string(args, "footer");
+  }
+  if (path == nullptr || title == nullptr || date == nullptr ||
+      markdown == nullptr || footer == nullptr) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        kBadArgumentsError, "Expected path, title, date, markdown and footer",
+        nullptr));
+  }
+
+  RenderJob* job = new RenderJob();
+  job->method_call = FL_METHOD_CALL(g_object_ref(method_call));
+  job->path = path;
+  job->report.title = title;
+  job->report.date = date;
+  job->report.markdown = markdown;
+  job->report.footer = footer;
+  job->written = false;
+  job->pages = 0;
+
+  g_autoptr(GTask) task = g_task_new(self, nullptr, render_done_cb, nullptr);
+  g_task_set_task_data(task, job,
+                       reinterpret_cast<GDestroyNotify>(render_job_free));
+  g_task_run_in_thread(task, render_thread_cb);
+  return nullptr;
+}
+
+// Where a batch goes when Dart does not say: a new "EchoLens Reports <time>"
+// folder, or PDF for a merged export, in the user's download directory.
+static gchar* default_batch_path(gboolean merged) {
+  const gchar* downloads = g_get_user_special_dir(G_USER_DIRECTORY_DOWNLOAD);
+  g_autoptr(GDateTime) now = g_date_time_new_now_local();
+  g_autofree gchar* stamp = g_date_time_format(now, "%Y-%m-%d %H.%M.%S");
+  g_autofree gchar* name = g_strdup_printf(
+      merged ? "EchoLens Reports %s.pdf" : "EchoLens Reports %s", stamp);
+  return g_build_filename(downloads != nullptr ? downloads : g_get_home_dir(),
+                          name, nullptr);
+}
+
+// Starts a batch export; progress and the outcome arrive as events.
+static FlMethodResponse* export_batch(PdfReportPlugin* self, FlValue* args) {
+  FlValue* id_value = nullptr;
+  FlValue* merged_value = nullptr;
+  FlValue* reports_value = nullptr;
+  const gchar* title = nullptr;
+  const gchar* date = nullptr;
+  const gchar* footer = nullptr;
+  const gchar* path = nullptr;
+  if (fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    id_value = fl_value_lookup_string(args, "id");
+    merged_value = fl_value_lookup_string(args, "merged");
+    reports_value = fl_value_lookup_string(args, "reports");
+    title = lookup_string(args, "title");
+    date = lookup_string(args, "date");
+    footer = lookup_string(args, "footer");
+    path = lookup_string(args, "path");
+  }
+  if (id_value == nullptr || fl_value_get_type(id_value) != FL_VALUE_TYPE_INT ||
+      merged_value == nullptr ||
+      fl_value_get_type(merged_value) != FL_VALUE_TYPE_BOOL ||
+      reports_value == nullptr ||
+      fl_value_get_type(reports_value) != FL_VALUE_TYPE_LIST ||
+      title == nullptr || date == nullptr || footer == nullptr) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        kBadArgumentsError,
+        "Expected id, merged, reports, title, date and footer", nullptr));
+  }
+
+  BatchJob* job = new BatchJob();
+  for (size_t i = 0; i < fl_value_get_length(reports_value); i++) {
+    FlValue* entry = fl_value_get_list_value(reports_value, i);
+    const gchar* name = nullptr;
+    const gchar* markdown = nullptr;
+    if (fl_value_get_type(entry) == FL_VALUE_TYPE_MAP) {
+      name = lookup_string(entry, "name");
+      markdown = lookup_string(entry, "markdown");
+    }
+    if (name == nullptr || markdown == nullptr) {
+      delete job;
+      return FL_METHOD_RESPONSE(fl_method_error_response_new(
+          kBadArgumentsError, "Expected name and markdown in every report",
+          nullptr));
+    }
+    PdfReport report;
+    report.name = name;
+    report.title = title;
+    report.date = date;
+    report.markdown = markdown;
+    report.footer = footer;
+    job->reports.push_back(report);
+  }
+
+  gboolean merged = fl_value_get_bool(merged_value);
+  g_autofree gchar* target =
+      path != nullptr ? g_strdup(path) : default_batch_path(merged);
+  if (merged) {
+    g_autofree gchar* directory = g_path_get_dirname(target);
+    g_mkdir_with_parents(directory, 0755);
+    job->options.merged_path = target;
+    job->options.merged_title = title;
+  } else {
+    g_mkdir_with_parents(target, 0755);
+    job->options.directory = target;
+  }
+  job->options.threads = 0;
+
+  job->self = PDF_REPORT_PLUGIN(g_object_ref(self));
+  job->id = fl_value_get_int(id_value);
+  job->cancellable = g_cancellable_new();
+  job->started = g_get_monotonic_time();
+
+  gint64* key = g_new(gint64, 1);
+  *key = job->id;
+  g_hash_table_replace(self->batches, key, g_object_ref(job->cancellable));
+
+  g_autoptr(GTask) task = g_task_new(self, job->cancellable, nullptr, nullptr);
+  g_task_set_task_data(task, job,
+                       reinterpret_cast<GDestroyNotify>(batch_job_free));
+  g_task_run_in_thread(task, batch_thread_cb);
+
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+}
+
+static FlMethodResponse* cancel_batch(PdfReportPlugin* self, FlValue* args) {
+  FlValue* id_value = nullptr;
+  if (fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    id_value = fl_value_lookup_string(args, "id");
+  }
+  if (id_value == nullptr || fl_value_get_type(id_value) != FL_VALUE_TYPE_INT) {
+    return FL_METHOD_RESPONSE(
+        fl_method_error_response_new(kBadArgumentsError, "Expected id",
+                                     nullptr));
+  }
+
+  int64_t id = fl_value_get_int(id_value);
+  GCancellable* cancellable =
+      static_cast<GCancellable*>(g_hash_table_lookup(self->batches, &id));
+  if (cancellable != nullptr) {
+    g_cancellable_cancel(cancellable);
+  }
+
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+}
+
+// Called when a method call is received from Flutter.
+static void method_call_cb(FlMethodChannel* channel,
+                           FlMethodCall* method_call,
+                           gpointer user_data) {
+  PdfReportPlugin* self = PDF_REPORT_PLUGIN(user_data);
+  const gchar* method = fl_method_call_get_name(method_call);
+
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (strcmp(method, kRenderMethod) == 0) {
+    response = render(self, method_call);
+  } else if (strcmp(method, kExportBatchMethod) == 0) {
+    response = export_batch(self, fl_method_call_get_args(method_call));
+  } else if (strcmp(method, kCancelBatchMethod) == 0) {
+    response = cancel_batch(self, fl_method_call_get_args(method_call));
+  } else {
+    response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+  }
+  if (response == nullptr) {
+    return;
+  }
+
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(method_call, response, &error)) {
+    g_warning("Failed to send method call response: %s", error->message);
+  }
+}
+
+static FlMethodErrorResponse* listen_cb(FlEventChannel* channel,
+                                        FlValue* args,
+                                        gpointer user_data) {
+  PDF_REPORT_PLUGIN(user_data)->listening = TRUE;
+  return nullptr;
+}
+
+static FlMethodErrorResponse* cancel_cb(FlEventChannel* channel,
+                                        FlValue* args,
+                                        gpointer user_data) {
+  PDF_REPORT_PLUGIN(user_data)->listening = FALSE;
+  return nullptr;
+}
+
+static void pdf_report_plugin_dispose(GObject* object) {
+  PdfReportPlugin* self = PDF_REPORT_PLUGIN(object);
+
+  g_clear_object(&self->channel);
+  g_clear_object(&self->event_channel);
+  g_clear_pointer(&self->batches, g_hash_table_unref);
+
+  G_OBJECT_CLASS(pdf_report_plugin_parent_class)->dispose(object);
+}
+
+static void pdf_report_plugin_class_init(PdfReportPluginClass* klass) {
+  G_OBJECT_CLASS(klass)->dispose = pdf_report_plugin_dispose;
+}
+
+static void pdf_report_plugin_init(PdfReportPlugin* self) {
+  self->batches =
+      g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, g_object_unref);
+}
+
+static PdfReportPlugin* pdf_report_plugin_new(FlBinaryMessenger* messenger) {
+  PdfReportPlugin* self = PDF_REPORT_PLUGIN(
+      g_object_new(pdf_report_plugin_get_type(), nullptr));
+
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  self->channel =
+      fl_method_channel_new(messenger, kChannelName, FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(self->channel, method_call_cb,
+                                            g_object_ref(self),
+                                            g_object_unref);
+
+  self->event_channel = fl_event_channel_new(messenger, kEventChannelName,
+                                             FL_METHOD_CODEC(codec));
+  fl_event_channel_set_stream_handlers(self->event_channel, listen_cb,
+                                       cancel_cb, g_object_ref(self),
+                                       g_object_unref);
+
+  return self;
+}
+
+void pdf_report_plugin_register_with_registrar(FlPluginRegistrar* registrar) {
+  PdfReportPlugin* plugin =
+      pdf_report_plugin_new(fl_plugin_registrar_get_messenger(registrar));
+  g_object_unref(plugin);
+}
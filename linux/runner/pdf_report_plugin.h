@@ -0,0 +1,22 @@
+#ifndef RUNNER_PDF_REPORT_PLUGIN_H_
+#define RUNNER_PDF_REPORT_PLUGIN_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+G_DECLARE_FINAL_TYPE(PdfReportPlugin,
+                     pdf_report_plugin,
+                     PDF,
+                     REPORT_PLUGIN,
+                     GObject)
+
+/**
+ * pdf_report_plugin_register_with_registrar:
+ * @registrar: an #FlPluginRegistrar.
+ *
+ * Registers the "echolens/pdf_report" method channel. "render" lays out a
+ * profile report with pdf_report_write() on a worker thread and replies with
+ * the page count once the file is complete, so exporting never blocks the UI.
+ */
+void pdf_report_plugin_register_with_registrar(FlPluginRegistrar* registrar);
+
+#endif  // RUNNER_PDF_REPORT_PLUGIN_H_
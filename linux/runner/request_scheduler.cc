@@ -0,0 +1,430 @@
+#include "request_scheduler.h"
+
+#include <curl/curl.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace {
+
+// Upper bound on how much of an error body is kept.
+constexpr size_t kMaxErrorBodyLength = 4096;
+
+constexpr int64_t kConnectTimeoutUs = 15 * G_USEC_PER_SEC;
+
+bool is_retryable(long status) {
+  return status == 429 || (status >= 500 && status <= 599);
+}
+
+// Sleeps until @when_us, waking early if @cancellable is cancelled.
+//
+// Returns: %FALSE if the wait was cancelled.
+bool wait_until(int64_t when_us, GCancellable* cancellable) {
+  GPollFD fd;
+  bool pollable =
+      cancellable != nullptr && g_cancellable_make_pollfd(cancellable, &fd);
+  bool cancelled = false;
+  while (true) {
+    if (cancellable != nullptr && g_cancellable_is_cancelled(cancellable)) {
+      cancelled = true;
+      break;
+    }
+    int64_t now = g_get_monotonic_time();
+    if (now >= when_us) {
+      break;
+    }
+    if (pollable) {
+      gint timeout_ms = static_cast<gint>(
+          std::min<int64_t>((when_us - now + 999) / 1000, G_MAXINT));
+      g_poll(&fd, 1, timeout_ms);
+    } else {
+      g_usleep(when_us - now);
+    }
+  }
+  if (pollable) {
+    g_cancellable_release_fd(cancellable);
+  }
+  return !cancelled;
+}
+
+// State of one attempt, shared with the curl callbacks.
+struct Attempt {
+  const ScheduledRequest* request;
+  CURL* curl;
+  long status;
+  // Whether on_data has seen any of the body, after which the attempt must
+  // not be repeated.
+  bool delivered;
+  int64_t retry_after_us;
+  std::string error_body;
+};
+
+size_t header_cb(char* buffer, size_t size, size_t nitems, void* user_data) {
+  Attempt* attempt = static_cast<Attempt*>(user_data);
+  size_t length = size * nitems;
+  constexpr char kRetryAfter[] = "retry-after:";
+  constexpr size_t kRetryAfterLength = sizeof(kRetryAfter) - 1;
+  if (length > kRetryAfterLength &&
+      g_ascii_strncasecmp(buffer, kRetryAfter, kRetryAfterLength) == 0) {
+    g_autofree gchar* value = g_strndup(buffer + kRetryAfterLength,
+                                        length - kRetryAfterLength);
+    attempt->retry_after_us =
+        request_retry_after_parse(g_strstrip(value), g_get_real_time());
+  }
+  return length;
+}
+
+size_t write_cb(char* ptr, size_t size, size_t nmemb, void* user_data) {
+  Attempt* attempt = static_cast<Attempt*>(user_data);
+  size_t length = size * nmemb;
+
+  if (attempt->status == 0) {
+    curl_easy_getinfo(attempt->curl, CURLINFO_RESPONSE_CODE, &attempt->status);
+  }
+  if (attempt->status != 200) {
+    size_t room = kMaxErrorBodyLength - attempt->error_body.size();
+    attempt->error_body.append(ptr, std::min(length, room));
+    return length;
+  }
+
+  if (attempt->request->on_data == nullptr) {
+    return length;
+  }
+  attempt->delivered = true;
+  return attempt->request->on_data(ptr, length, attempt->request->user_data);
+}
+
+int progress_cb(void* user_data,
+                curl_off_t dltotal,
+                curl_off_t dlnow,
+                curl_off_t ultotal,
+                curl_off_t ulnow) {
+  Attempt* attempt = static_cast<Attempt*>(user_data);
+  GCancellable* cancellable = attempt->request->cancellable;
+  return cancellable != nullptr && g_cancellable_is_cancelled(cancellable);
+}
+
+}  // namespace
+
+struct _RequestScheduler {
+  RequestSchedulerOptions options;
+  ConnectionPool* pool;
+
+  GMutex lock;
+  // May go negative: each reservation takes a token, and the deficit is
+  // how long later reservations wait.
+  double tokens;
+  int64_t refilled_at_us;
+  // Set from Retry-After; nothing starts before it.
+  int64_t blocked_until_us;
+  GRand* random;
+  RequestSchedulerStats stats;
+};
+
+RequestScheduler* request_scheduler_new(const RequestSchedulerOptions& options,
+                                        ConnectionPool* pool) {
+  RequestScheduler* scheduler = new RequestScheduler();
+  scheduler->options = options;
+  scheduler->pool = pool;
+  scheduler->options.max_attempts = std::max(options.max_attempts, 1);
+  g_mutex_init(&scheduler->lock);
+  scheduler->tokens = options.burst;
+  scheduler->refilled_at_us = g_get_monotonic_time();
+  scheduler->blocked_until_us = 0;
+  scheduler->random = g_rand_new();
+  scheduler->stats = RequestSchedulerStats();
+  return scheduler;
+}
+
+void request_scheduler_free(RequestScheduler* scheduler) {
+  if (scheduler == nullptr) {
+    return;
+  }
+  g_rand_free(scheduler->random);
+  g_mutex_clear(&scheduler->lock);
+  delete scheduler;
+}
+
+static void refill(RequestScheduler* scheduler, int64_t now_us) {
+  if (now_us > scheduler->refilled_at_us) {
+    double elapsed =
+        static_cast<double>(now_us - scheduler->refilled_at_us) / 1e6;
+    scheduler->tokens = std::min(
+        scheduler->options.burst,
+        scheduler->tokens + elapsed * scheduler->options.rate);
+    scheduler->refilled_at_us = now_us;
+  }
+}
+
+int64_t request_scheduler_reserve(RequestScheduler* scheduler,
+                                  int64_t now_us) {
+  g_mutex_lock(&scheduler->lock);
+  refill(scheduler, now_us);
+  scheduler->tokens -= 1;
+  int64_t start_us = now_us;
+  if (scheduler->tokens < 0 && scheduler->options.rate > 0) {
+    start_us += static_cast<int64_t>(-scheduler->tokens /
+                                     scheduler->options.rate * 1e6);
+  }
+  start_us = std::max(start_us, scheduler->blocked_until_us);
+  if (start_us > now_us) {
+    scheduler->stats.throttle_waits++;
+    scheduler->stats.throttle_wait_ms += (start_us - now_us) / 1000;
+  }
+  g_mutex_unlock(&scheduler->lock);
+  return start_us;
+}
+
+void request_scheduler_throttle(RequestScheduler* scheduler,
+                                int64_t now_us,
+                                int64_t retry_after_us) {
+  g_mutex_lock(&scheduler->lock);
+  refill(scheduler, now_us);
+  scheduler->tokens = std::min(scheduler->tokens, 0.0);
+  scheduler->blocked_until_us =
+      std::max(scheduler->blocked_until_us, now_us + retry_after_us);
+  g_mutex_unlock(&scheduler->lock);
+}
+
+int64_t request_scheduler_backoff(RequestScheduler* scheduler, int retry) {
+  int64_t ceiling = scheduler->options.base_backoff_us;
+  for (int i = 1; i < retry && ceiling < scheduler->options.max_backoff_us;
+       i++) {
+    ceiling *= 2;
+  }
+  ceiling = std::min(ceiling, scheduler->options.max_backoff_us);
+  if (ceiling <= 0) {
+    return 0;
+  }
+  g_mutex_lock(&scheduler->lock);
+  int64_t delay = static_cast<int64_t>(
+      g_rand_double_range(scheduler->random, 0, ceiling));
+  g_mutex_unlock(&scheduler->lock);
+  return delay;
+}
+
+static void count(RequestScheduler* scheduler, uint64_t* counter) {
+  g_mutex_lock(&scheduler->lock);
+  (*counter)++;
+  g_mutex_unlock(&scheduler->lock);
+}
+
+// Runs one attempt of @request, bounded by its deadline.
+static CURLcode run_attempt(RequestScheduler* scheduler,
+                            const ScheduledRequest& request,
+                            Attempt* attempt,
+                            ConnectionMetrics* metrics) {
+  attempt->request = &request;
+  attempt->curl = curl_easy_init();
+  attempt->status = 0;
+  attempt->delivered = false;
+  attempt->retry_after_us = -1;
+  attempt->error_body.clear();
+
+  struct curl_slist* headers = nullptr;
+  for (const std::string& header : request.headers) {
+    headers = curl_slist_append(headers, header.c_str());
+  }
+
+  CURL* curl = attempt->curl;
+  curl_easy_setopt(curl, CURLOPT_URL, request.url.c_str());
+  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+  curl_easy_setopt(curl, CURLOPT_POSTFIELDS, request.body.c_str());
+  curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE,
+                   static_cast<long>(request.body.size()));
+  curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_cb);
+  curl_easy_setopt(curl, CURLOPT_HEADERDATA, attempt);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_cb);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, attempt);
+  curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+  curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, progress_cb);
+  curl_easy_setopt(curl, CURLOPT_XFERINFODATA, attempt);
+  curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS,
+                   static_cast<long>(kConnectTimeoutUs / 1000));
+  curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+  if (request.deadline_us > 0) {
+    int64_t remaining = request.deadline_us - g_get_monotonic_time();
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS,
+                     static_cast<long>(std::max<int64_t>(remaining / 1000, 1)));
+  }
+  if (scheduler->options.stall_timeout_us > 0) {
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+    curl_easy_setopt(
+        curl, CURLOPT_LOW_SPEED_TIME,
+        static_cast<long>(std::max<int64_t>(
+            scheduler->options.stall_timeout_us / G_USEC_PER_SEC, 1)));
+  }
+
+  CURLcode code = scheduler->pool != nullptr
+                      ? connection_pool_perform(scheduler->pool, curl)
+                      : curl_easy_perform(curl);
+  connection_metrics_get(curl, metrics);
+  if (attempt->status == 0) {
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &attempt->status);
+  }
+  if (attempt->retry_after_us < 0 && attempt->status != 200) {
+    attempt->retry_after_us =
+        request_retry_delay_from_body(attempt->error_body);
+  }
+
+  curl_slist_free_all(headers);
+  curl_easy_cleanup(curl);
+  attempt->curl = nullptr;
+  return code;
+}
+
+void request_scheduler_perform(RequestScheduler* scheduler,
+                               const ScheduledRequest& request,
+                               ScheduledResult* result) {
+  result->outcome = SCHEDULED_REQUEST_OK;
+  result->status = 0;
+  result->message.clear();
+  result->attempts = 0;
+  result->retry_after_us = -1;
+  result->metrics = ConnectionMetrics();
+  count(scheduler, &scheduler->stats.requests);
+
+  auto past_deadline = [&request](int64_t when_us) {
+    return request.deadline_us > 0 && when_us >= request.deadline_us;
+  };
+  auto finish = [scheduler, result](ScheduledRequestOutcome outcome) {
+    result->outcome = outcome;
+    if (outcome == SCHEDULED_REQUEST_DEADLINE) {
+      count(scheduler, &scheduler->stats.deadline_exceeded);
+      result->message = "Deadline exceeded";
+    } else if (outcome == SCHEDULED_REQUEST_CANCELLED) {
+      result->message = "Cancelled";
+    }
+  };
+
+  Attempt attempt;
+  for (int number = 1;; number++) {
+    int64_t start_us =
+        request_scheduler_reserve(scheduler, g_get_monotonic_time());
+    if (past_deadline(start_us)) {
+      finish(SCHEDULED_REQUEST_DEADLINE);
+      return;
+    }
+    if (!wait_until(start_us, request.cancellable)) {
+      finish(SCHEDULED_REQUEST_CANCELLED);
+      return;
+    }
+
+    count(scheduler, &scheduler->stats.attempts);
+    result->attempts = number;
+    CURLcode code = run_attempt(scheduler, request, &attempt, &result->metrics);
+    result->status = attempt.status;
+    if (attempt.retry_after_us >= 0) {
+      result->retry_after_us = attempt.retry_after_us;
+    }
+
+    if (request.cancellable != nullptr &&
+        g_cancellable_is_cancelled(request.cancellable)) {
+      finish(SCHEDULED_REQUEST_CANCELLED);
+      return;
+    }
+    if (code == CURLE_OPERATION_TIMEDOUT &&
+        past_deadline(g_get_monotonic_time())) {
+      finish(SCHEDULED_REQUEST_DEADLINE);
+      return;
+    }
+    ScheduledRequestOutcome failure;
+    if (code != CURLE_OK) {
+      // Dropped connections and stalls are worth another attempt, unless
+      // the caller has already seen part of the body.
+      result->message = curl_easy_strerror(code);
+      failure = SCHEDULED_REQUEST_TRANSPORT_ERROR;
+    } else if (attempt.status == 200) {
+      finish(SCHEDULED_REQUEST_OK);
+      return;
+    } else {
+      result->message = attempt.error_body;
+      failure = SCHEDULED_REQUEST_HTTP_ERROR;
+      if (!is_retryable(attempt.status)) {
+        finish(failure);
+        return;
+      }
+    }
+    if (attempt.delivered || number >= scheduler->options.max_attempts) {
+      finish(failure);
+      return;
+    }
+
+    // A rate limit holds back every request, not just this one, and the
+    // next reservation waits out Retry-After. Without one, back off alone.
+    int64_t now = g_get_monotonic_time();
+    int64_t retry_after_us = attempt.retry_after_us;
+    if (attempt.status == 429 || retry_after_us >= 0) {
+      request_scheduler_throttle(scheduler, now,
+                                 std::max<int64_t>(retry_after_us, 0));
+    }
+    int64_t resume_us =
+        retry_after_us >= 0
+            ? now + retry_after_us
+            : now + request_scheduler_backoff(scheduler, number);
+    if (past_deadline(resume_us)) {
+      // Report the failure rather than a timeout: it is the real cause.
+      finish(failure);
+      return;
+    }
+    count(scheduler, &scheduler->stats.retries);
+    if (retry_after_us < 0 && !wait_until(resume_us, request.cancellable)) {
+      finish(SCHEDULED_REQUEST_CANCELLED);
+      return;
+    }
+  }
+}
+
+RequestSchedulerStats request_scheduler_get_stats(
+    RequestScheduler* scheduler) {
+  g_mutex_lock(&scheduler->lock);
+  RequestSchedulerStats stats = scheduler->stats;
+  g_mutex_unlock(&scheduler->lock);
+  return stats;
+}
+
+int64_t request_retry_after_parse(const char* value, int64_t now_real_us) {
+  if (value == nullptr || value[0] == '\0') {
+    return -1;
+  }
+  // In whole seconds, which cannot overflow once clamped.
+  constexpr int64_t kMaxSeconds = kMaxRetryAfterUs / G_USEC_PER_SEC;
+  if (g_ascii_isdigit(value[0])) {
+    gchar* end = nullptr;
+    guint64 seconds = g_ascii_strtoull(value, &end, 10);
+    if (*end != '\0') {
+      return -1;
+    }
+    return std::min<guint64>(seconds, kMaxSeconds) * G_USEC_PER_SEC;
+  }
+  time_t date = curl_getdate(value, nullptr);
+  if (date < 0) {
+    return -1;
+  }
+  int64_t now_s = now_real_us / G_USEC_PER_SEC;
+  if (static_cast<int64_t>(date) - now_s >= kMaxSeconds) {
+    return kMaxRetryAfterUs;
+  }
+  return std::max<int64_t>(
+      static_cast<int64_t>(date) * G_USEC_PER_SEC - now_real_us, 0);
+}
+
+int64_t request_retry_delay_from_body(const std::string& body) {
+  size_t key = body.find("\"retryDelay\"");
+  if (key == std::string::npos) {
+    return -1;
+  }
+  size_t quote = body.find('"', body.find(':', key));
+  if (quote == std::string::npos) {
+    return -1;
+  }
+  const char* start = body.c_str() + quote + 1;
+  gchar* end = nullptr;
+  double seconds = g_ascii_strtod(start, &end);
+  if (end == start || *end != 's' || !(seconds >= 0)) {
+    return -1;
+  }
+  return seconds * G_USEC_PER_SEC >= kMaxRetryAfterUs
+             ? kMaxRetryAfterUs
+             : static_cast<int64_t>(seconds * G_USEC_PER_SEC);
+}
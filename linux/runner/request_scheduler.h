@@ -0,0 +1,182 @@
+#ifndef RUNNER_REQUEST_SCHEDULER_H_
+#define RUNNER_REQUEST_SCHEDULER_H_
+
+#include <gio/gio.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "connection_pool.h"
+
+struct RequestSchedulerOptions {
+  // Requests that may start back to back before the limiter spaces them out.
+  double burst;
+  // Sustained requests per second.
+  double rate;
+  // Attempts per request, the first one included.
+  int max_attempts;
+  // Retry n waits a random time below min(max_backoff_us,
+  // base_backoff_us * 2^(n - 1)).
+  int64_t base_backoff_us;
+  int64_t max_backoff_us;
+  // A transfer that receives nothing for this long fails; 0 disables it.
+  int64_t stall_timeout_us;
+};
+
+// Shaped to the Gemini API's per-minute quota: a short burst, then one
+// request every six seconds, with up to four attempts per request.
+constexpr RequestSchedulerOptions kGeminiSchedulerOptions = {
+    3,                    // burst
+    10.0 / 60,            // rate
+    4,                    // max_attempts
+    500 * 1000,           // base_backoff_us
+    8 * G_USEC_PER_SEC,   // max_backoff_us
+    30 * G_USEC_PER_SEC,  // stall_timeout_us
+};
+
+// The longest delay a server may ask for; longer ones are cut to it.
+constexpr int64_t kMaxRetryAfterUs = int64_t{3600} * G_USEC_PER_SEC;
+
+struct RequestSchedulerStats {
+  uint64_t requests;
+  uint64_t attempts;
+  // Attempts repeated after a 429 or 5xx response or a transport error.
+  uint64_t retries;
+  // Attempts the limiter held back, and for how long in total.
+  uint64_t throttle_waits;
+  uint64_t throttle_wait_ms;
+  uint64_t deadline_exceeded;
+};
+
+// Called on the performing thread with each piece of a 200 response body.
+// Returns the number of bytes handled; anything else aborts the transfer.
+typedef size_t (*ScheduledRequestDataFunc)(const char* data,
+                                           size_t length,
+                                           void* user_data);
+
+struct ScheduledRequest {
+  std::string url;
+  std::string body;
+  std::vector<std::string> headers;
+  // g_get_monotonic_time() by which the request must be done; 0 for none.
+  int64_t deadline_us;
+  GCancellable* cancellable;
+  ScheduledRequestDataFunc on_data;
+  void* user_data;
+};
+
+typedef enum {
+  SCHEDULED_REQUEST_OK,
+  SCHEDULED_REQUEST_CANCELLED,
+  SCHEDULED_REQUEST_DEADLINE,
+  SCHEDULED_REQUEST_TRANSPORT_ERROR,
+  SCHEDULED_REQUEST_HTTP_ERROR,
+} ScheduledRequestOutcome;
+
+struct ScheduledResult {
+  ScheduledRequestOutcome outcome;
+  // The HTTP status of the last attempt, 0 if there was no response.
+  long status;
+  // The transport error, or the start of the last error body.
+  std::string message;
+  int attempts;
+  // How long the server last asked to wait, or -1 if it did not say.
+  int64_t retry_after_us;
+  // The phases of the last attempt.
+  ConnectionMetrics metrics;
+};
+
+// Shapes every request to one API: a token bucket limits the request rate
+// and honours Retry-After, and 429 and 5xx responses and transport errors
+// are retried with jittered exponential backoff within each request's
+// deadline. Thread-safe.
+typedef struct _RequestScheduler RequestScheduler;
+
+/**
+ * request_scheduler_new:
+ * @options: the limits to apply.
+ * @pool: (nullable): the #ConnectionPool to make requests over, which must
+ * outlive the scheduler, or %NULL for a new connection per attempt.
+ *
+ * Returns: a new #RequestScheduler.
+ */
+RequestScheduler* request_scheduler_new(const RequestSchedulerOptions& options,
+                                        ConnectionPool* pool);
+
+void request_scheduler_free(RequestScheduler* scheduler);
+
+/**
+ * request_scheduler_reserve:
+ * @scheduler: a #RequestScheduler.
+ * @now_us: the current g_get_monotonic_time().
+ *
+ * Takes a token for one attempt.
+ *
+ * Returns: the monotonic time at which the attempt may start, which is
+ * @now_us unless the bucket is empty or the server asked to back off.
+ */
+int64_t request_scheduler_reserve(RequestScheduler* scheduler, int64_t now_us);
+
+/**
+ * request_scheduler_throttle:
+ * @scheduler: a #RequestScheduler.
+ * @now_us: the current g_get_monotonic_time().
+ * @retry_after_us: how long the server asked to wait, or 0.
+ *
+ * Empties the bucket after a rate limit response and holds every attempt
+ * back until @retry_after_us has passed.
+ */
+void request_scheduler_throttle(RequestScheduler* scheduler,
+                                int64_t now_us,
+                                int64_t retry_after_us);
+
+/**
+ * request_scheduler_backoff:
+ * @scheduler: a #RequestScheduler.
+ * @retry: the retry about to be made, from 1.
+ *
+ * Returns: a random delay for @retry, with full jitter.
+ */
+int64_t request_scheduler_backoff(RequestScheduler* scheduler, int retry);
+
+/**
+ * request_scheduler_perform:
+ * @scheduler: a #RequestScheduler.
+ * @request: the POST to make.
+ * @result: (out): receives the outcome.
+ *
+ * Makes @request, waiting for the limiter before every attempt, and blocks
+ * until it is done. A request is only retried while @request.on_data has not
+ * been called, so callers never see a body twice: a connection that fails
+ * midway through the body ends it with %SCHEDULED_REQUEST_TRANSPORT_ERROR.
+ */
+void request_scheduler_perform(RequestScheduler* scheduler,
+                               const ScheduledRequest& request,
+                               ScheduledResult* result);
+
+RequestSchedulerStats request_scheduler_get_stats(RequestScheduler* scheduler);
+
+/**
+ * request_retry_after_parse:
+ * @value: a Retry-After header value, in seconds or as an HTTP date.
+ * @now_real_us: the current g_get_real_time(), for dates.
+ *
+ * Returns: the delay in microseconds, at most kMaxRetryAfterUs, or -1 if
+ * @value is not valid.
+ */
+int64_t request_retry_after_parse(const char* value, int64_t now_real_us);
+
+/**
+ * request_retry_delay_from_body:
+ * @body: an error body.
+ *
+ * Google APIs put the delay in a RetryInfo detail, as "retryDelay": "12s",
+ * rather than in a header.
+ *
+ * Returns: the delay in microseconds, at most kMaxRetryAfterUs, or -1 if
+ * @body has none.
+ */
+int64_t request_retry_delay_from_body(const std::string& body);
+
+#endif  // RUNNER_REQUEST_SCHEDULER_H_
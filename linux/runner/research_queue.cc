@@ -0,0 +1,211 @@
+#include "research_queue.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+
+// A grounded answer is far smaller; anything larger aborts the request.
+constexpr size_t kMaxBodyLength = 8 * 1024 * 1024;
+
+struct QueuedItem {
+  ResearchItem item;
+  GCancellable* cancellable;
+};
+
+size_t collect_cb(const char* data, size_t length, void* user_data) {
+  std::string* body = static_cast<std::string*>(user_data);
+  if (body->size() + length > kMaxBodyLength) {
+    return 0;
+  }
+  body->append(data, length);
+  return length;
+}
+
+}  // namespace
+
+struct _ResearchQueue {
+  RequestScheduler* scheduler;
+  ResearchItemCallback callback;
+  gpointer user_data;
+  GThreadPool* workers;
+
+  GMutex lock;
+  // Items queued or running, by id.
+  std::unordered_map<int64_t, GCancellable*> items;
+  // Set while freeing; items still draining no longer report.
+  bool closing;
+  ResearchQueueStats stats;
+};
+
+// Reports @update unless the queue is being freed.
+static void report(ResearchQueue* queue, const ResearchItemUpdate& update) {
+  g_mutex_lock(&queue->lock);
+  bool closing = queue->closing;
+  g_mutex_unlock(&queue->lock);
+  if (!closing) {
+    queue->callback(update, queue->user_data);
+  }
+}
+
+static void run_item_cb(gpointer data, gpointer user_data) {
+  QueuedItem* queued = static_cast<QueuedItem*>(data);
+  ResearchQueue* queue = static_cast<ResearchQueue*>(user_data);
+
+  ResearchItemUpdate update;
+  update.id = queued->item.id;
+  update.result = ScheduledResult();
+
+  bool cancelled = g_cancellable_is_cancelled(queued->cancellable);
+  g_mutex_lock(&queue->lock);
+  queue->stats.queued--;
+  if (!cancelled) {
+    queue->stats.running++;
+    queue->stats.peak_running =
+        std::max(queue->stats.peak_running, queue->stats.running);
+  }
+  g_mutex_unlock(&queue->lock);
+
+  if (cancelled) {
+    update.state = RESEARCH_ITEM_CANCELLED;
+  } else {
+    update.state = RESEARCH_ITEM_STARTED;
+    report(queue, update);
+
+    ScheduledRequest request;
+    request.url = queued->item.url;
+    request.body = queued->item.body;
+    request.headers = {"Content-Type: application/json"};
+    request.deadline_us =
+        queued->item.timeout_us > 0
+            ? g_get_monotonic_time() + queued->item.timeout_us
+            : 0;
+    request.cancellable = queued->cancellable;
+    request.on_data = collect_cb;
+    request.user_data = &update.body;
+    request_scheduler_perform(queue->scheduler, request, &update.result);
+
+    switch (update.result.outcome) {
+      case SCHEDULED_REQUEST_OK:
+        update.state = RESEARCH_ITEM_DONE;
+        break;
+      case SCHEDULED_REQUEST_CANCELLED:
+        update.state = RESEARCH_ITEM_CANCELLED;
+        break;
+      case SCHEDULED_REQUEST_DEADLINE:
+      case SCHEDULED_REQUEST_TRANSPORT_ERROR:
+      case SCHEDULED_REQUEST_HTTP_ERROR:
+        update.state = RESEARCH_ITEM_FAILED;
+        update.body.clear();
+        break;
+    }
+  }
+
+  g_mutex_lock(&queue->lock);
+  auto entry = queue->items.find(update.id);
+  // Not when a retry of the same id has replaced this item.
+  bool current =
+      entry != queue->items.end() && entry->second == queued->cancellable;
+  if (current) {
+    queue->items.erase(entry);
+  }
+  if (!cancelled) {
+    queue->stats.running--;
+  }
+  switch (update.state) {
+    case RESEARCH_ITEM_DONE:
+      queue->stats.done++;
+      break;
+    case RESEARCH_ITEM_FAILED:
+      queue->stats.failed++;
+      break;
+    case RESEARCH_ITEM_CANCELLED:
+      queue->stats.cancelled++;
+      break;
+    case RESEARCH_ITEM_STARTED:
+      break;
+  }
+  g_mutex_unlock(&queue->lock);
+
+  if (current) {
+    report(queue, update);
+  }
+  g_object_unref(queued->cancellable);
+  delete queued;
+}
+
+ResearchQueue* research_queue_new(RequestScheduler* scheduler,
+                                  int max_parallel,
+                                  ResearchItemCallback callback,
+                                  gpointer user_data) {
+  ResearchQueue* queue = new ResearchQueue();
+  queue->scheduler = scheduler;
+  queue->callback = callback;
+  queue->user_data = user_data;
+  g_mutex_init(&queue->lock);
+  queue->closing = false;
+  queue->stats = ResearchQueueStats();
+  // Threads shared with GLib's pool: an idle queue holds none of its own.
+  queue->workers = g_thread_pool_new(run_item_cb, queue,
+                                     std::max(max_parallel, 1), FALSE,
+                                     nullptr);
+  return queue;
+}
+
+void research_queue_free(ResearchQueue* queue) {
+  if (queue == nullptr) {
+    return;
+  }
+  g_mutex_lock(&queue->lock);
+  queue->closing = true;
+  for (const auto& entry : queue->items) {
+    g_cancellable_cancel(entry.second);
+  }
+  g_mutex_unlock(&queue->lock);
+
+  // Cancelled items drain quickly and free themselves.
+  g_thread_pool_free(queue->workers, FALSE, TRUE);
+  g_mutex_clear(&queue->lock);
+  delete queue;
+}
+
+void research_queue_set_max_parallel(ResearchQueue* queue, int max_parallel) {
+  g_thread_pool_set_max_threads(queue->workers, std::max(max_parallel, 1),
+                                nullptr);
+}
+
+void research_queue_push(ResearchQueue* queue, const ResearchItem& item) {
+  QueuedItem* queued = new QueuedItem();
+  queued->item = item;
+  queued->cancellable = g_cancellable_new();
+
+  g_mutex_lock(&queue->lock);
+  auto entry = queue->items.find(item.id);
+  if (entry != queue->items.end()) {
+    // A retry replaces the attempt still queued or running.
+    g_cancellable_cancel(entry->second);
+  }
+  queue->items[item.id] = queued->cancellable;
+  queue->stats.queued++;
+  g_mutex_unlock(&queue->lock);
+
+  g_thread_pool_push(queue->workers, queued, nullptr);
+}
+
+bool research_queue_cancel(ResearchQueue* queue, int64_t id) {
+  g_mutex_lock(&queue->lock);
+  auto entry = queue->items.find(id);
+  bool found = entry != queue->items.end();
+  if (found) {
+    g_cancellable_cancel(entry->second);
+  }
+  g_mutex_unlock(&queue->lock);
+  return found;
+}
+
+ResearchQueueStats research_queue_get_stats(ResearchQueue* queue) {
+  g_mutex_lock(&queue->lock);
+  ResearchQueueStats stats = queue->stats;
+  g_mutex_unlock(&queue->lock);
+  return stats;
+}
@@ -0,0 +1,97 @@
+#ifndef RUNNER_RESEARCH_QUEUE_H_
+#define RUNNER_RESEARCH_QUEUE_H_
+
+#include <glib.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "request_scheduler.h"
+
+// One search of a batch: a generateContent call whose whole body is wanted.
+typedef struct {
+  // Chosen by the caller; unique among the items queued.
+  int64_t id;
+  std::string url;
+  std::string body;
+  // Relative to when the item starts, not to when it was queued; 0 for none.
+  int64_t timeout_us;
+} ResearchItem;
+
+typedef enum {
+  RESEARCH_ITEM_STARTED,
+  RESEARCH_ITEM_DONE,
+  RESEARCH_ITEM_FAILED,
+  RESEARCH_ITEM_CANCELLED,
+} ResearchItemState;
+
+typedef struct {
+  int64_t id;
+  ResearchItemState state;
+  // The response body for #RESEARCH_ITEM_DONE.
+  std::string body;
+  // How the request ended, for #RESEARCH_ITEM_DONE and #RESEARCH_ITEM_FAILED.
+  ScheduledResult result;
+} ResearchItemUpdate;
+
+typedef struct {
+  uint64_t queued;
+  uint64_t running;
+  uint64_t done;
+  uint64_t failed;
+  uint64_t cancelled;
+  // The most items that ran at the same time.
+  uint64_t peak_running;
+} ResearchQueueStats;
+
+// Called on a worker thread when an item starts and when it ends.
+typedef void (*ResearchItemCallback)(const ResearchItemUpdate& update,
+                                     gpointer user_data);
+
+// Runs batches of searches a bounded number at a time, first in first out.
+// Every request goes through a shared #RequestScheduler, so a batch obeys the
+// same rate limit, Retry-After and retries as interactive searches do, and
+// the parallelism only bounds how many wait on the API at once.
+// Thread-safe.
+typedef struct _ResearchQueue ResearchQueue;
+
+/**
+ * research_queue_new:
+ * @scheduler: the #RequestScheduler to make requests through, which must
+ *   outlive the queue.
+ * @max_parallel: how many items may run at the same time.
+ * @callback: receives the progress of every item.
+ * @user_data: passed to @callback.
+ *
+ * Returns: a new #ResearchQueue.
+ */
+ResearchQueue* research_queue_new(RequestScheduler* scheduler,
+                                  int max_parallel,
+                                  ResearchItemCallback callback,
+                                  gpointer user_data);
+
+// Cancels every item and waits for the running ones to end.
+void research_queue_free(ResearchQueue* queue);
+
+// Changes how many items may run at the same time; running items finish.
+void research_queue_set_max_parallel(ResearchQueue* queue, int max_parallel);
+
+// Queues @item behind the items already queued. An item with the same id
+// still queued or running is cancelled and no longer reports. Does not block.
+void research_queue_push(ResearchQueue* queue, const ResearchItem& item);
+
+/**
+ * research_queue_cancel:
+ * @queue: a #ResearchQueue.
+ * @id: an item id.
+ *
+ * Cancels a queued or running item, which then reports
+ * #RESEARCH_ITEM_CANCELLED.
+ *
+ * Returns: %FALSE if @id is not queued or running.
+ */
+bool research_queue_cancel(ResearchQueue* queue, int64_t id);
+
+ResearchQueueStats research_queue_get_stats(ResearchQueue* queue);
+
+#endif  // RUNNER_RESEARCH_QUEUE_H_
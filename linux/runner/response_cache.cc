@@ -0,0 +1,423 @@
+#include "response_cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t kIndexMagic = 0x49434c45;  // "ELCI"
+constexpr uint32_t kRecordMagic = 0x52434c45;  // "ELCR"
+constexpr uint32_t kIndexVersion = 1;
+
+// Compaction kicks in once dead records outweigh live ones by this much.
+constexpr uint64_t kCompactionSlack = 1024 * 1024;
+
+enum EntryState : uint32_t {
+  kEntryEmpty = 0,
+  kEntryLive = 1,
+  kEntryDeleted = 2,
+};
+
+struct IndexHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t capacity;
+  uint32_t count;
+  uint32_t deleted;
+  uint32_t reserved;
+  uint64_t live_bytes;
+  uint64_t data_size;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+};
+
+struct IndexEntry {
+  uint8_t key[kResponseCacheKeySize];
+  uint64_t offset;
+  uint32_t length;
+  uint32_t state;
+  int64_t created_us;
+  int64_t accessed_us;
+};
+
+struct RecordHeader {
+  uint32_t magic;
+  uint32_t length;
+  uint8_t key[kResponseCacheKeySize];
+};
+
+size_t index_file_size(uint32_t capacity) {
+  return sizeof(IndexHeader) + sizeof(IndexEntry) * capacity;
+}
+
+uint64_t key_hash(const uint8_t* key) {
+  uint64_t hash;
+  memcpy(&hash, key, sizeof(hash));
+  return hash;
+}
+
+bool write_all(int fd, const void* data, size_t length, uint64_t offset) {
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  while (length > 0) {
+    ssize_t written = pwrite(fd, p, length, offset);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    p += written;
+    offset += written;
+    length -= written;
+  }
+  return true;
+}
+
+bool read_all(int fd, void* data, size_t length, uint64_t offset) {
+  uint8_t* p = static_cast<uint8_t*>(data);
+  while (length > 0) {
+    ssize_t n = pread(fd, p, length, offset);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    p += n;
+    offset += n;
+    length -= n;
+  }
+  return true;
+}
+
+}  // namespace
+
+struct _ResponseCache {
+  ResponseCacheOptions options;
+  std::string data_path;
+  int index_fd;
+  int data_fd;
+  IndexHeader* header;
+  IndexEntry* entries;
+  size_t mapped_size;
+};
+
+static IndexEntry* find_entry(ResponseCache* cache, const uint8_t* key) {
+  uint32_t capacity = cache->header->capacity;
+  uint32_t slot = key_hash(key) % capacity;
+  for (uint32_t probe = 0; probe < capacity; probe++) {
+    IndexEntry* entry = &cache->entries[(slot + probe) % capacity];
+    if (entry->state == kEntryEmpty) {
+      return nullptr;
+    }
+    if (entry->state == kEntryLive &&
+        memcmp(entry->key, key, kResponseCacheKeySize) == 0) {
+      return entry;
+    }
+  }
+  return nullptr;
+}
+
+static IndexEntry* free_slot(ResponseCache* cache, const uint8_t* key) {
+  uint32_t capacity = cache->header->capacity;
+  uint32_t slot = key_hash(key) % capacity;
+  for (uint32_t probe = 0; probe < capacity; probe++) {
+    IndexEntry* entry = &cache->entries[(slot + probe) % capacity];
+    if (entry->state != kEntryLive) {
+      return entry;
+    }
+  }
+  return nullptr;
+}
+
+static void remove_entry(ResponseCache* cache, IndexEntry* entry) {
+  cache->header->live_bytes -= entry->length;
+  cache->header->count--;
+  cache->header->deleted++;
+  entry->state = kEntryDeleted;
+}
+
+// Reinserts all live entries so deleted slots stop lengthening probe chains.
+static void rehash(ResponseCache* cache) {
+  std::vector<IndexEntry> live;
+  live.reserve(cache->header->count);
+  for (uint32_t i = 0; i < cache->header->capacity; i++) {
+    if (cache->entries[i].state == kEntryLive) {
+      live.push_back(cache->entries[i]);
+    }
+  }
+  memset(cache->entries, 0, sizeof(IndexEntry) * cache->header->capacity);
+  cache->header->deleted = 0;
+  for (const IndexEntry& entry : live) {
+    *free_slot(cache, entry.key) = entry;
+  }
+}
+
+// Drops expired entries, then least recently used ones, until @incoming more
+// bytes and one more entry fit.
+static void make_room(ResponseCache* cache, uint64_t incoming, int64_t now_us) {
+  uint32_t max_entries = cache->header->capacity / 4 * 3;
+  std::vector<IndexEntry*> live;
+  for (uint32_t i = 0; i < cache->header->capacity; i++) {
+    IndexEntry* entry = &cache->entries[i];
+    if (entry->state != kEntryLive) {
+      continue;
+    }
+    if (now_us - entry->created_us > cache->options.ttl_us) {
+      remove_entry(cache, entry);
+    } else {
+      live.push_back(entry);
+    }
+  }
+
+  std::sort(live.begin(), live.end(), [](IndexEntry* a, IndexEntry* b) {
+    return a->accessed_us < b->accessed_us;
+  });
+  for (IndexEntry* entry : live) {
+    if (cache->header->live_bytes + incoming <= cache->options.max_bytes &&
+        cache->header->count < max_entries) {
+      break;
+    }
+    remove_entry(cache, entry);
+    cache->header->evictions++;
+  }
+
+  if (cache->header->count + cache->header->deleted >= max_entries) {
+    rehash(cache);
+  }
+}
+
+// Rewrites the data file with only the live records.
+static void compact(ResponseCache* cache) {
+  std::string temp_path = cache->data_path + ".tmp";
+  int fd = open(temp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+                0600);
+  if (fd < 0) {
+    return;
+  }
+
+  std::vector<uint64_t> offsets(cache->header->capacity);
+  std::vector<uint8_t> buffer;
+  uint64_t size = 0;
+  for (uint32_t i = 0; i < cache->header->capacity; i++) {
+    IndexEntry* entry = &cache->entries[i];
+    if (entry->state != kEntryLive) {
+      continue;
+    }
+    size_t record_size = sizeof(RecordHeader) + entry->length;
+    buffer.resize(record_size);
+    if (!read_all(cache->data_fd, buffer.data(), record_size, entry->offset) ||
+        !write_all(fd, buffer.data(), record_size, size)) {
+      close(fd);
+      unlink(temp_path.c_str());
+      return;
+    }
+    offsets[i] = size;
+    size += record_size;
+  }
+
+  if (fdatasync(fd) != 0 ||
+      rename(temp_path.c_str(), cache->data_path.c_str()) != 0) {
+    close(fd);
+    unlink(temp_path.c_str());
+    return;
+  }
+
+  close(cache->data_fd);
+  cache->data_fd = fd;
+  for (uint32_t i = 0; i < cache->header->capacity; i++) {
+    if (cache->entries[i].state == kEntryLive) {
+      cache->entries[i].offset = offsets[i];
+    }
+  }
+  cache->header->data_size = size;
+}
+
+static void reset(ResponseCache* cache) {
+  memset(cache->entries, 0, sizeof(IndexEntry) * cache->header->capacity);
+  cache->header->count = 0;
+  cache->header->deleted = 0;
+  cache->header->live_bytes = 0;
+  cache->header->data_size = 0;
+  if (ftruncate(cache->data_fd, 0) != 0) {
+    // The stale tail is unreachable from the index; it is overwritten later.
+  }
+}
+
+ResponseCache* response_cache_open(const char* directory,
+                                   const ResponseCacheOptions* options) {
+  mkdir(directory, 0700);
+  std::string index_path = std::string(directory) + "/index.bin";
+  std::string data_path = std::string(directory) + "/data.bin";
+
+  int index_fd = open(index_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (index_fd < 0) {
+    return nullptr;
+  }
+  int data_fd = open(data_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (data_fd < 0) {
+    close(index_fd);
+    return nullptr;
+  }
+
+  size_t mapped_size = index_file_size(options->capacity);
+  struct stat index_stat;
+  struct stat data_stat;
+  if (fstat(index_fd, &index_stat) != 0 || fstat(data_fd, &data_stat) != 0 ||
+      (static_cast<size_t>(index_stat.st_size) != mapped_size &&
+       ftruncate(index_fd, mapped_size) != 0)) {
+    close(index_fd);
+    close(data_fd);
+    return nullptr;
+  }
+  bool fresh = static_cast<size_t>(index_stat.st_size) != mapped_size;
+
+  void* mapped = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, index_fd, 0);
+  if (mapped == MAP_FAILED) {
+    close(index_fd);
+    close(data_fd);
+    return nullptr;
+  }
+
+  ResponseCache* cache = new ResponseCache();
+  cache->options = *options;
+  cache->data_path = data_path;
+  cache->index_fd = index_fd;
+  cache->data_fd = data_fd;
+  cache->header = static_cast<IndexHeader*>(mapped);
+  cache->entries = reinterpret_cast<IndexEntry*>(cache->header + 1);
+  cache->mapped_size = mapped_size;
+
+  IndexHeader* header = cache->header;
+  if (fresh || header->magic != kIndexMagic ||
+      header->version != kIndexVersion ||
+      header->capacity != options->capacity ||
+      header->data_size > static_cast<uint64_t>(data_stat.st_size)) {
+    memset(header, 0, sizeof(IndexHeader));
+    header->magic = kIndexMagic;
+    header->version = kIndexVersion;
+    header->capacity = options->capacity;
+    reset(cache);
+  } else if (static_cast<uint64_t>(data_stat.st_size) > header->data_size) {
+    // Drop a record whose append was interrupted before the index update.
+    if (ftruncate(data_fd, header->data_size) != 0) {
+      reset(cache);
+    }
+  }
+
+  return cache;
+}
+
+void response_cache_free(ResponseCache* cache) {
+  if (cache == nullptr) {
+    return;
+  }
+  munmap(cache->header, cache->mapped_size);
+  close(cache->index_fd);
+  close(cache->data_fd);
+  delete cache;
+}
+
+bool response_cache_lookup(ResponseCache* cache,
+                           const uint8_t* key,
+                           int64_t now_us,
+                           std::string* value) {
+  IndexEntry* entry = find_entry(cache, key);
+  if (entry == nullptr) {
+    cache->header->misses++;
+    return false;
+  }
+  if (now_us - entry->created_us > cache->options.ttl_us) {
+    remove_entry(cache, entry);
+    cache->header->misses++;
+    return false;
+  }
+
+  RecordHeader record;
+  value->resize(entry->length);
+  if (!read_all(cache->data_fd, &record, sizeof(record), entry->offset) ||
+      record.magic != kRecordMagic || record.length != entry->length ||
+      memcmp(record.key, key, kResponseCacheKeySize) != 0 ||
+      !read_all(cache->data_fd, &(*value)[0], entry->length,
+                entry->offset + sizeof(record))) {
+    remove_entry(cache, entry);
+    cache->header->misses++;
+    value->clear();
+    return false;
+  }
+
+  entry->accessed_us = now_us;
+  cache->header->hits++;
+  return true;
+}
+
+bool response_cache_store(ResponseCache* cache,
+                          const uint8_t* key,
+                          int64_t now_us,
+                          const std::string& value) {
+  if (value.size() > cache->options.max_bytes || value.size() > UINT32_MAX) {
+    return false;
+  }
+
+  IndexEntry* existing = find_entry(cache, key);
+  if (existing != nullptr) {
+    remove_entry(cache, existing);
+  }
+  make_room(cache, value.size(), now_us);
+
+  RecordHeader record;
+  record.magic = kRecordMagic;
+  record.length = static_cast<uint32_t>(value.size());
+  memcpy(record.key, key, kResponseCacheKeySize);
+  uint64_t offset = cache->header->data_size;
+  if (!write_all(cache->data_fd, &record, sizeof(record), offset) ||
+      !write_all(cache->data_fd, value.data(), value.size(),
+                 offset + sizeof(record))) {
+    return false;
+  }
+
+  IndexEntry* entry = free_slot(cache, key);
+  if (entry->state == kEntryDeleted) {
+    cache->header->deleted--;
+  }
+  memcpy(entry->key, key, kResponseCacheKeySize);
+  entry->offset = offset;
+  entry->length = record.length;
+  entry->state = kEntryLive;
+  entry->created_us = now_us;
+  entry->accessed_us = now_us;
+  cache->header->count++;
+  cache->header->live_bytes += value.size();
+  cache->header->data_size = offset + sizeof(record) + value.size();
+
+  uint64_t live_with_headers =
+      cache->header->live_bytes + cache->header->count * sizeof(RecordHeader);
+  if (cache->header->data_size > 2 * live_with_headers + kCompactionSlack) {
+    compact(cache);
+  }
+  return true;
+}
+
+void response_cache_clear(ResponseCache* cache) {
+  reset(cache);
+}
+
+ResponseCacheStats response_cache_get_stats(ResponseCache* cache) {
+  ResponseCacheStats stats;
+  stats.hits = cache->header->hits;
+  stats.misses = cache->header->misses;
+  stats.evictions = cache->header->evictions;
+  stats.entries = cache->header->count;
+  stats.live_bytes = cache->header->live_bytes;
+  stats.file_bytes = cache->header->data_size;
+  return stats;
+}
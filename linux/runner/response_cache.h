@@ -0,0 +1,91 @@
+#ifndef RUNNER_RESPONSE_CACHE_H_
+#define RUNNER_RESPONSE_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+// Length of a cache key; callers pass the leading bytes of a SHA-256 digest.
+constexpr size_t kResponseCacheKeySize = 16;
+
+// A persistent, content-addressed cache of packed Gemini responses.
+//
+// The cache directory holds `index.bin`, an mmap-ed open-addressing table of
+// fixed-size entries, and `data.bin`, an append-only log of records. Entries
+// expire after a TTL and the least recently used ones are evicted to keep the
+// live payload under a size cap. The log is compacted once most of it is dead.
+typedef struct _ResponseCache ResponseCache;
+
+typedef struct {
+  // Upper bound on the bytes of live payloads.
+  uint64_t max_bytes;
+  // Entries older than this are treated as misses and dropped.
+  int64_t ttl_us;
+  // Number of index slots; at most three quarters are used.
+  uint32_t capacity;
+} ResponseCacheOptions;
+
+typedef struct {
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+  uint64_t entries;
+  uint64_t live_bytes;
+  uint64_t file_bytes;
+} ResponseCacheStats;
+
+/**
+ * response_cache_open:
+ * @directory: directory holding the index and data files; created if needed.
+ * @options: size, TTL and capacity limits.
+ *
+ * Opens the cache, discarding the files if they are missing, truncated or
+ * were written with a different capacity.
+ *
+ * Returns: the cache, or %NULL if the files cannot be created.
+ */
+ResponseCache* response_cache_open(const char* directory,
+                                   const ResponseCacheOptions* options);
+
+void response_cache_free(ResponseCache* cache);
+
+/**
+ * response_cache_lookup:
+ * @cache: a #ResponseCache.
+ * @key: a key of #kResponseCacheKeySize bytes.
+ * @now_us: the current wall-clock time in microseconds.
+ * @value: (out): receives the stored payload on a hit.
+ *
+ * Returns: %TRUE on a hit. Hits refresh the entry's LRU position.
+ */
+bool response_cache_lookup(ResponseCache* cache,
+                           const uint8_t* key,
+                           int64_t now_us,
+                           std::string* value);
+
+/**
+ * response_cache_store:
+ * @cache: a #ResponseCache.
+ * @key: a key of #kResponseCacheKeySize bytes.
+ * @now_us: the current wall-clock time in microseconds.
+ * @value: the payload to store, replacing any previous one for @key.
+ *
+ * Returns: %FALSE if @value is larger than the cache or cannot be written.
+ */
+bool response_cache_store(ResponseCache* cache,
+                          const uint8_t* key,
+                          int64_t now_us,
+                          const std::string& value);
+
+/**
+ * response_cache_clear:
+ * @cache: a #ResponseCache.
+ *
+ * Drops every entry and truncates the data file. Counters are kept.
+ */
+void response_cache_clear(ResponseCache* cache);
+
+ResponseCacheStats response_cache_get_stats(ResponseCache* cache);
+
+#endif  // RUNNER_RESPONSE_CACHE_H_
@@ -0,0 +1,324 @@
+#include "response_cache_plugin.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "gemini_response_parser.h"
+#include "response_cache.h"
+#include "text_fold.h"
+
+static constexpr char kChannelName[] = "echolens/response_cache";
+
+static constexpr char kLookupMethod[] = "lookup";
+static constexpr char kStoreMethod[] = "store";
+static constexpr char kStatsMethod[] = "stats";
+static constexpr char kClearMethod[] = "clear";
+
+static constexpr char kBadArgumentsError[] = "Bad Arguments";
+static constexpr char kUnavailableError[] = "Unavailable";
+
+// Profiles change slowly, but a week-old answer is worth a fresh search.
+static constexpr int64_t kTtlUs = int64_t{7} * 24 * 3600 * G_USEC_PER_SEC;
+static constexpr uint64_t kMaxBytes = 64 * 1024 * 1024;
+static constexpr uint32_t kCapacity = 4096;
+
+struct _ResponseCachePlugin {
+  GObject parent_instance;
+
+  gchar* directory;
+  // Only touched from the single thread of @worker.
+  ResponseCache* cache;
+  gboolean open_failed;
+  GThreadPool* worker;
+};
+
+G_DEFINE_TYPE(ResponseCachePlugin, response_cache_plugin, G_TYPE_OBJECT)
+
+typedef enum {
+  CACHE_JOB_LOOKUP,
+  CACHE_JOB_STORE,
+  CACHE_JOB_STATS,
+  CACHE_JOB_CLEAR,
+} CacheJobKind;
+
+// One method call, copied out of its FlValue arguments on the main thread,
+// run on the worker and answered back on the main thread. Lookups and stores
+// touch the mmap-ed index and may compact the whole data file, so none of it
+// happens on the main thread.
+typedef struct {
+  ResponseCachePlugin* self;
+  FlMethodCall* method_call;
+  CacheJobKind kind;
+  uint8_t key[kResponseCacheKeySize];
+  // The packed response: stored on the way in, found on the way out.
+  std::string packed;
+
+  bool ok;
+  bool found;
+  ResponseCacheStats stats;
+} CacheJob;
+
+// Derives the cache key from the "query" and "template" arguments.
+static gboolean compute_key(FlValue* args, uint8_t* key) {
+  FlValue* query_value = nullptr;
+  FlValue* template_value = nullptr;
+  if (fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    query_value = fl_value_lookup_string(args, "query");
+    template_value = fl_value_lookup_string(args, "template");
+  }
+  if (query_value == nullptr ||
+      fl_value_get_type(query_value) != FL_VALUE_TYPE_STRING ||
+      template_value == nullptr ||
+      fl_value_get_type(template_value) != FL_VALUE_TYPE_STRING) {
+    return FALSE;
+  }
+
+  g_autofree gchar* query = text_fold(fl_value_get_string(query_value));
+  const gchar* prompt_template = fl_value_get_string(template_value);
+
+  GChecksum* checksum = g_checksum_new(G_CHECKSUM_SHA256);
+  g_checksum_update(checksum, reinterpret_cast<const guchar*>(prompt_template),
+                    strlen(prompt_template) + 1);
+  g_checksum_update(checksum, reinterpret_cast<const guchar*>(query),
+                    strlen(query));
+  guint8 digest[32];
+  gsize digest_length = sizeof(digest);
+  g_checksum_get_digest(checksum, digest, &digest_length);
+  g_checksum_free(checksum);
+
+  memcpy(key, digest, kResponseCacheKeySize);
+  return TRUE;
+}
+
+// Packs the "answer" and "sources" arguments of a store the way the parser
+// packs a response, so a hit is decoded exactly like a fresh response.
+static gboolean pack_response(FlValue* args, std::string* packed) {
+  FlValue* answer_value = fl_value_lookup_string(args, "answer");
+  FlValue* sources_value = fl_value_lookup_string(args, "sources");
+  if (answer_value == nullptr ||
+      fl_value_get_type(answer_value) != FL_VALUE_TYPE_STRING ||
+      sources_value == nullptr ||
+      fl_value_get_type(sources_value) != FL_VALUE_TYPE_LIST) {
+    return FALSE;
+  }
+
+  GeminiParseResult result;
+  result.answer = fl_value_get_string(answer_value);
+  for (size_t i = 0; i < fl_value_get_length(sources_value); i++) {
+    FlValue* source = fl_value_get_list_value(sources_value, i);
+    if (fl_value_get_type(source) != FL_VALUE_TYPE_MAP) {
+      continue;
+    }
+    FlValue* title = fl_value_lookup_string(source, "title");
+    FlValue* url = fl_value_lookup_string(source, "url");
+    GeminiSource entry;
+    if (title != nullptr && fl_value_get_type(title) == FL_VALUE_TYPE_STRING) {
+      entry.title = fl_value_get_string(title);
+    }
+    if (url != nullptr && fl_value_get_type(url) == FL_VALUE_TYPE_STRING) {
+      entry.uri = fl_value_get_string(url);
+    }
+    result.sources.push_back(entry);
+  }
+
+  std::vector<uint8_t> bytes = gemini_response_pack(result);
+  packed->assign(bytes.begin(), bytes.end());
+  return TRUE;
+}
+
+static FlValue* stats_value(const ResponseCacheStats& stats) {
+  FlValue* result = fl_value_new_map();
+  fl_value_set_string_take(result, "hits", fl_value_new_int(stats.hits));
+  fl_value_set_string_take(result, "misses", fl_value_new_int(stats.misses));
+  fl_value_set_string_take(result, "evictions",
+                           fl_value_new_int(stats.evictions));
+  fl_value_set_string_take(result, "entries", fl_value_new_int(stats.entries));
+  fl_value_set_string_take(result, "liveBytes",
+                           fl_value_new_int(stats.live_bytes));
+  fl_value_set_string_take(result, "fileBytes",
+                           fl_value_new_int(stats.file_bytes));
+  return result;
+}
+
+// Sends the job's result on the main thread and frees it.
+static gboolean respond_cb(gpointer user_data) {
+  CacheJob* job = static_cast<CacheJob*>(user_data);
+
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (!job->ok) {
+    response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+        kUnavailableError, "Response cache could not be opened", nullptr));
+  } else {
+    g_autoptr(FlValue) result = nullptr;
+    switch (job->kind) {
+      case CACHE_JOB_LOOKUP:
+        if (job->found) {
+          result = fl_value_new_uint8_list(
+              reinterpret_cast<const uint8_t*>(job->packed.data()),
+              job->packed.size());
+        }
+        break;
+      case CACHE_JOB_STORE:
+        result = fl_value_new_bool(job->found);
+        break;
+      case CACHE_JOB_STATS:
+        result = stats_value(job->stats);
+        break;
+      case CACHE_JOB_CLEAR:
+        break;
+    }
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(job->method_call, response, &error)) {
+    g_warning("Failed to send method call response: %s", error->message);
+  }
+
+  g_object_unref(job->method_call);
+  g_object_unref(job->self);
+  delete job;
+  return G_SOURCE_REMOVE;
+}
+
+// Opens the cache on first use, so startup never waits on its files.
+static ResponseCache* ensure_cache(ResponseCachePlugin* self) {
+  if (self->cache == nullptr && !self->open_failed) {
+    g_mkdir_with_parents(self->directory, 0700);
+
+    ResponseCacheOptions options;
+    options.max_bytes = kMaxBytes;
+    options.ttl_us = kTtlUs;
+    options.capacity = kCapacity;
+    self->cache = response_cache_open(self->directory, &options);
+    if (self->cache == nullptr) {
+      g_warning("Failed to open response cache in %s", self->directory);
+      self->open_failed = TRUE;
+    }
+  }
+  return self->cache;
+}
+
+static void run_job_cb(gpointer data, gpointer user_data) {
+  CacheJob* job = static_cast<CacheJob*>(data);
+  ResponseCache* cache = ensure_cache(job->self);
+  job->ok = cache != nullptr;
+  if (cache != nullptr) {
+    switch (job->kind) {
+      case CACHE_JOB_LOOKUP:
+        job->found = response_cache_lookup(cache, job->key, g_get_real_time(),
+                                           &job->packed);
+        break;
+      case CACHE_JOB_STORE:
+        job->found = response_cache_store(cache, job->key, g_get_real_time(),
+                                          job->packed);
+        job->packed.clear();
+        break;
+      case CACHE_JOB_STATS:
+        job->stats = response_cache_get_stats(cache);
+        break;
+      case CACHE_JOB_CLEAR:
+        response_cache_clear(cache);
+        break;
+    }
+  }
+
+  g_main_context_invoke(nullptr, respond_cb, job);
+}
+
+// Called when a method call is received from Flutter.
+static void method_call_cb(FlMethodChannel* channel,
+                           FlMethodCall* method_call,
+                           gpointer user_data) {
+  ResponseCachePlugin* self = RESPONSE_CACHE_PLUGIN(user_data);
+  const gchar* method = fl_method_call_get_name(method_call);
+  FlValue* args = fl_method_call_get_args(method_call);
+
+  static const struct {
+    const char* name;
+    CacheJobKind kind;
+  } kMethods[] = {
+      {kLookupMethod, CACHE_JOB_LOOKUP},
+      {kStoreMethod, CACHE_JOB_STORE},
+      {kStatsMethod, CACHE_JOB_STATS},
+      {kClearMethod, CACHE_JOB_CLEAR},
+  };
+
+  g_autoptr(FlMethodResponse) response = nullptr;
+  for (const auto& entry : kMethods) {
+    if (strcmp(method, entry.name) != 0) {
+      continue;
+    }
+    CacheJob* job = new CacheJob();
+    job->kind = entry.kind;
+    job->ok = false;
+    job->found = false;
+    job->stats = ResponseCacheStats();
+    if (entry.kind == CACHE_JOB_LOOKUP && !compute_key(args, job->key)) {
+      delete job;
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          kBadArgumentsError, "Expected query and template", nullptr));
+      break;
+    }
+    if (entry.kind == CACHE_JOB_STORE &&
+        (!compute_key(args, job->key) || !pack_response(args, &job->packed))) {
+      delete job;
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          kBadArgumentsError, "Expected query, template, answer and sources",
+          nullptr));
+      break;
+    }
+    job->self = RESPONSE_CACHE_PLUGIN(g_object_ref(self));
+    job->method_call = FL_METHOD_CALL(g_object_ref(method_call));
+    g_thread_pool_push(self->worker, job, nullptr);
+    return;
+  }
+  if (response == nullptr) {
+    response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+  }
+
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(method_call, response, &error)) {
+    g_warning("Failed to send method call response: %s", error->message);
+  }
+}
+
+static void response_cache_plugin_dispose(GObject* object) {
+  ResponseCachePlugin* self = RESPONSE_CACHE_PLUGIN(object);
+
+  if (self->worker != nullptr) {
+    g_thread_pool_free(self->worker, FALSE, TRUE);
+    self->worker = nullptr;
+  }
+  g_clear_pointer(&self->cache, response_cache_free);
+  g_clear_pointer(&self->directory, g_free);
+
+  G_OBJECT_CLASS(response_cache_plugin_parent_class)->dispose(object);
+}
+
+static void response_cache_plugin_class_init(ResponseCachePluginClass* klass) {
+  G_OBJECT_CLASS(klass)->dispose = response_cache_plugin_dispose;
+}
+
+static void response_cache_plugin_init(ResponseCachePlugin* self) {
+  self->directory = g_build_filename(g_get_user_cache_dir(), APPLICATION_ID,
+                                     "response_cache", nullptr);
+  // A single exclusive thread keeps calls in order and owns the cache.
+  self->worker = g_thread_pool_new(run_job_cb, nullptr, 1, TRUE, nullptr);
+}
+
+void response_cache_plugin_register_with_registrar(
+    FlPluginRegistrar* registrar) {
+  ResponseCachePlugin* plugin = RESPONSE_CACHE_PLUGIN(
+      g_object_new(response_cache_plugin_get_type(), nullptr));
+
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  g_autoptr(FlMethodChannel) channel =
+      fl_method_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                            kChannelName, FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(channel, method_call_cb,
+                                            g_object_ref(plugin),
+                                            g_object_unref);
+
+  g_object_unref(plugin);
+}
@@ -0,0 +1,25 @@
+#ifndef RUNNER_RESPONSE_CACHE_PLUGIN_H_
+#define RUNNER_RESPONSE_CACHE_PLUGIN_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+G_DECLARE_FINAL_TYPE(ResponseCachePlugin,
+                     response_cache_plugin,
+                     RESPONSE,
+                     CACHE_PLUGIN,
+                     GObject)
+
+/**
+ * response_cache_plugin_register_with_registrar:
+ * @registrar: an #FlPluginRegistrar.
+ *
+ * Registers the "echolens/response_cache" method channel, which serves
+ * grounded search results from the on-disk #ResponseCache under the user
+ * cache directory. Entries are keyed by a SHA-256 of the prompt template and
+ * the normalized query. All calls run in order on a single worker thread,
+ * which opens the cache on first use.
+ */
+void response_cache_plugin_register_with_registrar(
+    FlPluginRegistrar* registrar);
+
+#endif  // RUNNER_RESPONSE_CACHE_PLUGIN_H_
@@ -0,0 +1,84 @@
+#include "runner_plugins.h"
+
+#include <url_launcher_linux/url_launcher_plugin.h>
+
+#ifdef ECHOLENS_BENCH
+#include "bench_plugin.h"
+#endif
+#include "frame_stats_plugin.h"
+#include "gemini_parser_plugin.h"
+#include "gemini_stream_plugin.h"
+#include "history_index_plugin.h"
+#include "history_store_plugin.h"
+#include "launch_plugin.h"
+#include "lazy_plugin.h"
+#include "pdf_preview_plugin.h"
+#include "pdf_report_plugin.h"
+#include "response_cache_plugin.h"
+#include "session_snapshot_plugin.h"
+#include "source_resolver_plugin.h"
+#include "startup_trace_plugin.h"
+
+void runner_register_plugins(FlPluginRegistry* registry) {
+#ifdef ECHOLENS_BENCH
+  g_autoptr(FlPluginRegistrar) bench_registrar =
+      fl_plugin_registry_get_registrar_for_plugin(registry, "BenchPlugin");
+  bench_plugin_register_with_registrar(bench_registrar);
+#endif
+  g_autoptr(FlPluginRegistrar) frame_stats_registrar =
+      fl_plugin_registry_get_registrar_for_plugin(registry, "FrameStatsPlugin");
+  frame_stats_plugin_register_with_registrar(frame_stats_registrar);
+  g_autoptr(FlPluginRegistrar) gemini_parser_registrar =
+      fl_plugin_registry_get_registrar_for_plugin(registry,
+                                                  "GeminiParserPlugin");
+  gemini_parser_plugin_register_with_registrar(gemini_parser_registrar);
+  g_autoptr(FlPluginRegistrar) gemini_stream_registrar =
+      fl_plugin_registry_get_registrar_for_plugin(registry,
+                                                  "GeminiStreamPlugin");
+  gemini_stream_plugin_register_with_registrar(gemini_stream_registrar);
+  g_autoptr(FlPluginRegistrar) history_index_registrar =
+      fl_plugin_registry_get_registrar_for_plugin(registry,
+                                                  "HistoryIndexPlugin");
+  history_index_plugin_register_with_registrar(history_index_registrar);
+  g_autoptr(FlPluginRegistrar) history_store_registrar =
+      fl_plugin_registry_get_registrar_for_plugin(registry,
+                                                  "HistoryStorePlugin");
+  history_store_plugin_register_with_registrar(history_store_registrar);
+  g_autoptr(FlPluginRegistrar) launch_registrar =
+      fl_plugin_registry_get_registrar_for_plugin(registry, "LaunchPlugin");
+  launch_plugin_register_with_registrar(launch_registrar);
+  g_autoptr(FlPluginRegistrar) pdf_preview_registrar =
+      fl_plugin_registry_get_registrar_for_plugin(registry,
+                                                  "PdfPreviewPlugin");
+  pdf_preview_plugin_register_with_registrar(pdf_preview_registrar);
+  g_autoptr(FlPluginRegistrar) pdf_report_registrar =
+      fl_plugin_registry_get_registrar_for_plugin(registry, "PdfReportPlugin");
+  pdf_report_plugin_register_with_registrar(pdf_report_registrar);
+  g_autoptr(FlPluginRegistrar) response_cache_registrar =
+      fl_plugin_registry_get_registrar_for_plugin(registry,
+                                                  "ResponseCachePlugin");
+  response_cache_plugin_register_with_registrar(response_cache_registrar);
+  g_autoptr(FlPluginRegistrar) session_snapshot_registrar =
+      fl_plugin_registry_get_registrar_for_plugin(registry,
+                                                  "SessionSnapshotPlugin");
+  session_snapshot_plugin_register_with_registrar(session_snapshot_registrar);
+  g_autoptr(FlPluginRegistrar) source_resolver_registrar =
+      fl_plugin_registry_get_registrar_for_plugin(registry,
+                                                  "SourceResolverPlugin");
+  source_resolver_plugin_register_with_registrar(source_resolver_registrar);
+  g_autoptr(FlPluginRegistrar) startup_trace_registrar =
+      fl_plugin_registry_get_registrar_for_plugin(registry,
+                                                  "StartupTracePlugin");
+  startup_trace_plugin_register_with_registrar(startup_trace_registrar);
+}
+
+void runner_register_pub_plugins(FlPluginRegistry* registry) {
+  // printing maps a PDF rasterizer, needed only to print or preview.
+  lazy_plugin_register(registry, "PrintingPlugin", "net.nfet.printing",
+                       "libprinting_plugin.so",
+                       "printing_plugin_register_with_registrar");
+  g_autoptr(FlPluginRegistrar) url_launcher_linux_registrar =
+      fl_plugin_registry_get_registrar_for_plugin(registry,
+                                                  "UrlLauncherPlugin");
+  url_launcher_plugin_register_with_registrar(url_launcher_linux_registrar);
+}
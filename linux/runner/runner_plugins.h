@@ -0,0 +1,28 @@
+#ifndef RUNNER_RUNNER_PLUGINS_H_
+#define RUNNER_RUNNER_PLUGINS_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+/**
+ * runner_register_plugins:
+ * @registry: an #FlPluginRegistry.
+ *
+ * Registers the native services implemented by the runner itself. These sit
+ * beside the pub plugins registered by fl_register_plugins().
+ */
+void runner_register_plugins(FlPluginRegistry* registry);
+
+/**
+ * runner_register_pub_plugins:
+ * @registry: an #FlPluginRegistry.
+ *
+ * Registers the pub plugins in place of fl_register_plugins() when the
+ * application is built with ECHOLENS_LAZY_PLUGINS. Light plugins are
+ * registered as usual; heavy ones, which most sessions never call, with
+ * lazy_plugin_register(), so their libraries are only loaded on first use.
+ * Every plugin in FLUTTER_PLUGIN_LIST must be listed here and in
+ * EAGER_PLUGIN_LIST or LAZY_PLUGIN_LIST in linux/CMakeLists.txt.
+ */
+void runner_register_pub_plugins(FlPluginRegistry* registry);
+
+#endif  // RUNNER_RUNNER_PLUGINS_H_
@@ -0,0 +1,166 @@
+#include "session_snapshot.h"
+
+#include <fcntl.h>
+#include <glib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint32_t kSnapshotMagic = 0x53534c45;  // "ELSS"
+constexpr uint32_t kSnapshotVersion = 1;
+
+constexpr uint32_t kFlagExempt = 1 << 0;
+constexpr uint32_t kFlagHasResult = 1 << 1;
+
+struct SnapshotHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t payload_length;
+  uint32_t checksum;
+};
+
+uint32_t fnv1a(const uint8_t* data, size_t length) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ data[i]) * 16777619u;
+  }
+  return hash;
+}
+
+void put_u32(std::vector<uint8_t>* out, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    out->push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+void put_i64(std::vector<uint8_t>* out, int64_t value) {
+  uint64_t bits = static_cast<uint64_t>(value);
+  for (int i = 0; i < 8; i++) {
+    out->push_back(static_cast<uint8_t>(bits >> (8 * i)));
+  }
+}
+
+void put_string(std::vector<uint8_t>* out, const std::string& value) {
+  put_u32(out, value.size());
+  out->insert(out->end(), value.begin(), value.end());
+}
+
+void put_record(std::vector<uint8_t>* out,
+                const SessionSnapshotRecord& record) {
+  put_string(out, record.id);
+  put_i64(out, record.timestamp_ms);
+  put_string(out, record.query);
+  put_string(out, record.answer);
+  put_u32(out, record.sources.size() / 2);
+  for (size_t i = 0; i + 1 < record.sources.size(); i += 2) {
+    put_string(out, record.sources[i]);
+    put_string(out, record.sources[i + 1]);
+  }
+}
+
+}  // namespace
+
+struct _SessionSnapshotFile {
+  void* mapped;
+  size_t mapped_size;
+};
+
+std::vector<uint8_t> session_snapshot_encode(const SessionSnapshot& snapshot) {
+  std::vector<uint8_t> out(sizeof(SnapshotHeader));
+  put_string(&out, snapshot.uid);
+  put_string(&out, snapshot.email);
+  put_string(&out, snapshot.display_name);
+  put_i64(&out, snapshot.saved_at_ms);
+  put_u32(&out, snapshot.searches_used_today);
+  put_u32(&out, (snapshot.exempt ? kFlagExempt : 0) |
+                    (snapshot.has_result ? kFlagHasResult : 0));
+  if (snapshot.has_result) {
+    put_record(&out, snapshot.result);
+  }
+  put_u32(&out, snapshot.history.size());
+  for (const SessionSnapshotRecord& record : snapshot.history) {
+    put_record(&out, record);
+  }
+
+  // The header is stored in host order, like the response cache index; the
+  // runner only ever reads back files written on the same machine.
+  SnapshotHeader header;
+  header.magic = kSnapshotMagic;
+  header.version = kSnapshotVersion;
+  header.payload_length = out.size() - sizeof(SnapshotHeader);
+  header.checksum =
+      fnv1a(out.data() + sizeof(SnapshotHeader), header.payload_length);
+  memcpy(out.data(), &header, sizeof(header));
+  return out;
+}
+
+bool session_snapshot_write(const char* path,
+                            const SessionSnapshot& snapshot,
+                            std::string* error) {
+  std::vector<uint8_t> contents = session_snapshot_encode(snapshot);
+  g_autoptr(GError) write_error = nullptr;
+  if (!g_file_set_contents(path,
+                           reinterpret_cast<const gchar*>(contents.data()),
+                           contents.size(), &write_error)) {
+    if (error != nullptr) {
+      *error = write_error->message;
+    }
+    return false;
+  }
+  return true;
+}
+
+SessionSnapshotFile* session_snapshot_file_open(const char* path) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 ||
+      static_cast<size_t>(file_stat.st_size) < sizeof(SnapshotHeader)) {
+    close(fd);
+    return nullptr;
+  }
+
+  size_t mapped_size = file_stat.st_size;
+  void* mapped = mmap(nullptr, mapped_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps the file alive on its own.
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    return nullptr;
+  }
+  madvise(mapped, mapped_size, MADV_WILLNEED);
+
+  const SnapshotHeader* header = static_cast<const SnapshotHeader*>(mapped);
+  const uint8_t* payload =
+      static_cast<const uint8_t*>(mapped) + sizeof(SnapshotHeader);
+  if (header->magic != kSnapshotMagic || header->version != kSnapshotVersion ||
+      header->payload_length != mapped_size - sizeof(SnapshotHeader) ||
+      header->checksum != fnv1a(payload, header->payload_length)) {
+    munmap(mapped, mapped_size);
+    return nullptr;
+  }
+
+  SessionSnapshotFile* file = new SessionSnapshotFile();
+  file->mapped = mapped;
+  file->mapped_size = mapped_size;
+  return file;
+}
+
+const uint8_t* session_snapshot_file_get_payload(
+    const SessionSnapshotFile* file,
+    size_t* length) {
+  *length = file->mapped_size - sizeof(SnapshotHeader);
+  return static_cast<const uint8_t*>(file->mapped) + sizeof(SnapshotHeader);
+}
+
+void session_snapshot_file_free(SessionSnapshotFile* file) {
+  if (file == nullptr) {
+    return;
+  }
+  munmap(file->mapped, file->mapped_size);
+  delete file;
+}
@@ -0,0 +1,99 @@
+#ifndef RUNNER_SESSION_SNAPSHOT_H_
+#define RUNNER_SESSION_SNAPSHOT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// A research answer as shown on screen: the result or a history record.
+typedef struct {
+  std::string id;
+  int64_t timestamp_ms;
+  std::string query;
+  std::string answer;
+  // Alternating source titles and urls.
+  std::vector<std::string> sources;
+} SessionSnapshotRecord;
+
+// What the home screen showed when the last session ended, so the next
+// launch can paint it before Firebase has signed the user back in.
+typedef struct {
+  std::string uid;
+  std::string email;
+  std::string display_name;
+  int64_t saved_at_ms;
+  uint32_t searches_used_today;
+  bool exempt;
+  bool has_result;
+  SessionSnapshotRecord result;
+  // The first page of history, newest first.
+  std::vector<SessionSnapshotRecord> history;
+} SessionSnapshot;
+
+/**
+ * session_snapshot_encode:
+ * @snapshot: the session to encode.
+ *
+ * Encodes @snapshot as a snapshot file: a 16-byte header with the magic
+ * "ELSS", a version, the payload length and an FNV-1a checksum of the
+ * payload, followed by the payload. The payload is decoded on the Dart side
+ * by SessionSnapshotService; all integers are little-endian and strings are
+ * u32-length-prefixed UTF-8:
+ *
+ *   uid, email, display name, i64 saved_at_ms, u32 searches_used_today,
+ *   u32 flags (1 = exempt, 2 = has result), [record], u32 count, record*
+ *
+ * where a record is id, i64 timestamp_ms, query, answer, u32 source count,
+ * then a title and url per source.
+ *
+ * Returns: the file contents.
+ */
+std::vector<uint8_t> session_snapshot_encode(const SessionSnapshot& snapshot);
+
+/**
+ * session_snapshot_write:
+ * @path: the snapshot file.
+ * @snapshot: the session to store.
+ * @error: (out) (optional): receives a message on failure.
+ *
+ * Replaces @path atomically, so a mapping of the previous file stays valid.
+ *
+ * Returns: %FALSE if the file could not be written.
+ */
+bool session_snapshot_write(const char* path,
+                            const SessionSnapshot& snapshot,
+                            std::string* error);
+
+// A snapshot file mapped read-only into memory.
+typedef struct _SessionSnapshotFile SessionSnapshotFile;
+
+/**
+ * session_snapshot_file_open:
+ * @path: the snapshot file.
+ *
+ * Maps @path and checks its header and checksum. The pages are requested
+ * from the kernel straight away, so that they are resident by the time
+ * Dart asks for them.
+ *
+ * Returns: the mapped file, or %NULL if it is missing, truncated, corrupt
+ * or of another version.
+ */
+SessionSnapshotFile* session_snapshot_file_open(const char* path);
+
+/**
+ * session_snapshot_file_get_payload:
+ * @file: a #SessionSnapshotFile.
+ * @length: (out): receives the length of the payload.
+ *
+ * Returns: the payload described by session_snapshot_encode(), valid until
+ * @file is freed.
+ */
+const uint8_t* session_snapshot_file_get_payload(
+    const SessionSnapshotFile* file,
+    size_t* length);
+
+void session_snapshot_file_free(SessionSnapshotFile* file);
+
+#endif  // RUNNER_SESSION_SNAPSHOT_H_
@@ -0,0 +1,277 @@
+#include "session_snapshot_plugin.h"
+
+#include <glib/gstdio.h>
+
+#include <cstring>
+#include <string>
+
+#include "session_snapshot.h"
+
+static constexpr char kChannelName[] = "echolens/session_snapshot";
+
+static constexpr char kLoadMethod[] = "load";
+static constexpr char kSaveMethod[] = "save";
+static constexpr char kClearMethod[] = "clear";
+
+static constexpr char kBadArgumentsError[] = "Bad Arguments";
+static constexpr char kWriteError[] = "Write Error";
+
+struct _SessionSnapshotPlugin {
+  GObject parent_instance;
+
+  gchar* path;
+  // Released once Dart has loaded it.
+  SessionSnapshotFile* file;
+  GThreadPool* worker;
+};
+
+G_DEFINE_TYPE(SessionSnapshotPlugin, session_snapshot_plugin, G_TYPE_OBJECT)
+
+// Mapped by session_snapshot_plugin_preload() until the plugin exists.
+static SessionSnapshotFile* preloaded = nullptr;
+static gboolean preload_attempted = FALSE;
+
+// A save or clear, run on the worker and answered on the main thread.
+typedef struct {
+  SessionSnapshotPlugin* self;
+  FlMethodCall* method_call;
+  gboolean clear;
+  SessionSnapshot snapshot;
+
+  bool ok;
+  std::string error;
+} SnapshotJob;
+
+static gchar* snapshot_path() {
+  return g_build_filename(g_get_user_cache_dir(), APPLICATION_ID,
+                          "session.bin", nullptr);
+}
+
+static const gchar* lookup_string(FlValue* map, const gchar* key) {
+  FlValue* value = fl_value_lookup_string(map, key);
+  if (value == nullptr || fl_value_get_type(value) != FL_VALUE_TYPE_STRING) {
+    return nullptr;
+  }
+  return fl_value_get_string(value);
+}
+
+static int64_t lookup_int(FlValue* map, const gchar* key) {
+  FlValue* value = fl_value_lookup_string(map, key);
+  if (value == nullptr || fl_value_get_type(value) != FL_VALUE_TYPE_INT) {
+    return 0;
+  }
+  return fl_value_get_int(value);
+}
+
+static gboolean read_record(FlValue* value, SessionSnapshotRecord* record) {
+  if (fl_value_get_type(value) != FL_VALUE_TYPE_MAP) {
+    return FALSE;
+  }
+  const gchar* id = lookup_string(value, "id");
+  const gchar* query = lookup_string(value, "query");
+  const gchar* answer = lookup_string(value, "answer");
+  if (query == nullptr || answer == nullptr) {
+    return FALSE;
+  }
+  record->id = id != nullptr ? id : "";
+  record->timestamp_ms = lookup_int(value, "timestamp");
+  record->query = query;
+  record->answer = answer;
+
+  FlValue* sources = fl_value_lookup_string(value, "sources");
+  if (sources != nullptr && fl_value_get_type(sources) == FL_VALUE_TYPE_LIST) {
+    for (size_t i = 0; i < fl_value_get_length(sources); i++) {
+      FlValue* source = fl_value_get_list_value(sources, i);
+      if (fl_value_get_type(source) != FL_VALUE_TYPE_MAP) {
+        continue;
+      }
+      const gchar* title = lookup_string(source, "title");
+      const gchar* url = lookup_string(source, "url");
+      record->sources.push_back(title != nullptr ? title : "");
+      record->sources.push_back(url != nullptr ? url : "");
+    }
+  }
+  return TRUE;
+}
+
+static gboolean read_snapshot(FlValue* args, SessionSnapshot* snapshot) {
+  if (fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return FALSE;
+  }
+  const gchar* uid = lookup_string(args, "uid");
+  if (uid == nullptr) {
+    return FALSE;
+  }
+  const gchar* email = lookup_string(args, "email");
+  const gchar* display_name = lookup_string(args, "displayName");
+  snapshot->uid = uid;
+  snapshot->email = email != nullptr ? email : "";
+  snapshot->display_name = display_name != nullptr ? display_name : "";
+  snapshot->saved_at_ms = lookup_int(args, "savedAt");
+  snapshot->searches_used_today = MAX(lookup_int(args, "searchesUsedToday"), 0);
+  FlValue* exempt = fl_value_lookup_string(args, "exempt");
+  snapshot->exempt = exempt != nullptr &&
+                     fl_value_get_type(exempt) == FL_VALUE_TYPE_BOOL &&
+                     fl_value_get_bool(exempt);
+
+  FlValue* result = fl_value_lookup_string(args, "result");
+  snapshot->has_result =
+      result != nullptr && fl_value_get_type(result) != FL_VALUE_TYPE_NULL;
+  if (snapshot->has_result && !read_record(result, &snapshot->result)) {
+    return FALSE;
+  }
+
+  FlValue* history = fl_value_lookup_string(args, "history");
+  if (history != nullptr && fl_value_get_type(history) == FL_VALUE_TYPE_LIST) {
+    snapshot->history.resize(fl_value_get_length(history));
+    for (size_t i = 0; i < snapshot->history.size(); i++) {
+      if (!read_record(fl_value_get_list_value(history, i),
+                       &snapshot->history[i])) {
+        return FALSE;
+      }
+    }
+  }
+  return TRUE;
+}
+
+static gboolean respond_cb(gpointer user_data) {
+  SnapshotJob* job = static_cast<SnapshotJob*>(user_data);
+
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (job->ok) {
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+  } else {
+    response = FL_METHOD_RESPONSE(
+        fl_method_error_response_new(kWriteError, job->error.c_str(), nullptr));
+  }
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(job->method_call, response, &error)) {
+    g_warning("Failed to send method call response: %s", error->message);
+  }
+
+  g_object_unref(job->method_call);
+  g_object_unref(job->self);
+  delete job;
+  return G_SOURCE_REMOVE;
+}
+
+static void run_job_cb(gpointer data, gpointer user_data) {
+  SnapshotJob* job = static_cast<SnapshotJob*>(data);
+  const gchar* path = job->self->path;
+
+  if (job->clear) {
+    job->ok = g_remove(path) == 0 || !g_file_test(path, G_FILE_TEST_EXISTS);
+    if (!job->ok) {
+      job->error = "Cannot delete the session snapshot";
+    }
+  } else {
+    g_autofree gchar* directory = g_path_get_dirname(path);
+    g_mkdir_with_parents(directory, 0700);
+    job->ok = session_snapshot_write(path, job->snapshot, &job->error);
+  }
+
+  g_main_context_invoke(nullptr, respond_cb, job);
+}
+
+static FlMethodResponse* load(SessionSnapshotPlugin* self) {
+  if (self->file == nullptr) {
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+  }
+
+  size_t length = 0;
+  const uint8_t* payload =
+      session_snapshot_file_get_payload(self->file, &length);
+  g_autoptr(FlValue) value = fl_value_new_uint8_list(payload, length);
+  // Dart keeps its own copy; later launches see whatever it saves next.
+  g_clear_pointer(&self->file, session_snapshot_file_free);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(value));
+}
+
+// Called when a method call is received from Flutter.
+static void method_call_cb(FlMethodChannel* channel,
+                           FlMethodCall* method_call,
+                           gpointer user_data) {
+  SessionSnapshotPlugin* self = SESSION_SNAPSHOT_PLUGIN(user_data);
+  const gchar* method = fl_method_call_get_name(method_call);
+
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (strcmp(method, kLoadMethod) == 0) {
+    response = load(self);
+  } else if (strcmp(method, kSaveMethod) == 0 ||
+             strcmp(method, kClearMethod) == 0) {
+    SnapshotJob* job = new SnapshotJob();
+    job->clear = strcmp(method, kClearMethod) == 0;
+    job->ok = false;
+    if (!job->clear &&
+        !read_snapshot(fl_method_call_get_args(method_call), &job->snapshot)) {
+      delete job;
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          kBadArgumentsError, "Expected uid, history and an optional result",
+          nullptr));
+    } else {
+      job->self = SESSION_SNAPSHOT_PLUGIN(g_object_ref(self));
+      job->method_call = FL_METHOD_CALL(g_object_ref(method_call));
+      g_thread_pool_push(self->worker, job, nullptr);
+      return;
+    }
+  } else {
+    response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+  }
+
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(method_call, response, &error)) {
+    g_warning("Failed to send method call response: %s", error->message);
+  }
+}
+
+static void session_snapshot_plugin_dispose(GObject* object) {
+  SessionSnapshotPlugin* self = SESSION_SNAPSHOT_PLUGIN(object);
+
+  if (self->worker != nullptr) {
+    g_thread_pool_free(self->worker, FALSE, TRUE);
+    self->worker = nullptr;
+  }
+  g_clear_pointer(&self->file, session_snapshot_file_free);
+  g_clear_pointer(&self->path, g_free);
+
+  G_OBJECT_CLASS(session_snapshot_plugin_parent_class)->dispose(object);
+}
+
+static void session_snapshot_plugin_class_init(
+    SessionSnapshotPluginClass* klass) {
+  G_OBJECT_CLASS(klass)->dispose = session_snapshot_plugin_dispose;
+}
+
+static void session_snapshot_plugin_init(SessionSnapshotPlugin* self) {
+  self->path = snapshot_path();
+  session_snapshot_plugin_preload();
+  self->file = preloaded;
+  preloaded = nullptr;
+  // A single exclusive thread keeps saves and clears in call order.
+  self->worker = g_thread_pool_new(run_job_cb, nullptr, 1, TRUE, nullptr);
+}
+
+void session_snapshot_plugin_preload() {
+  if (preload_attempted) {
+    return;
+  }
+  preload_attempted = TRUE;
+  g_autofree gchar* path = snapshot_path();
+  preloaded = session_snapshot_file_open(path);
+}
+
+void session_snapshot_plugin_register_with_registrar(
+    FlPluginRegistrar* registrar) {
+  SessionSnapshotPlugin* plugin = SESSION_SNAPSHOT_PLUGIN(
+      g_object_new(session_snapshot_plugin_get_type(), nullptr));
+
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  g_autoptr(FlMethodChannel) channel =
+      fl_method_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                            kChannelName, FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(channel, method_call_cb,
+                                            g_object_ref(plugin),
+                                            g_object_unref);
+
+  g_object_unref(plugin);
+}
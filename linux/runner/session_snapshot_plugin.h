@@ -0,0 +1,33 @@
+#ifndef RUNNER_SESSION_SNAPSHOT_PLUGIN_H_
+#define RUNNER_SESSION_SNAPSHOT_PLUGIN_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+G_DECLARE_FINAL_TYPE(SessionSnapshotPlugin,
+                     session_snapshot_plugin,
+                     SESSION,
+                     SNAPSHOT_PLUGIN,
+                     GObject)
+
+/**
+ * session_snapshot_plugin_preload:
+ *
+ * Maps the snapshot of the last session, if there is a valid one. Called from
+ * GApplication::startup so that the file is resident before the Flutter
+ * engine starts; the plugin registered later takes the mapping over.
+ */
+void session_snapshot_plugin_preload();
+
+/**
+ * session_snapshot_plugin_register_with_registrar:
+ * @registrar: an #FlPluginRegistrar.
+ *
+ * Registers the "echolens/session_snapshot" method channel. "load" replies
+ * with the payload of the preloaded snapshot as a Uint8List, or null, once
+ * per launch. "save" stores the session described by its map argument and
+ * "clear" deletes it; both run in order on a worker thread.
+ */
+void session_snapshot_plugin_register_with_registrar(
+    FlPluginRegistrar* registrar);
+
+#endif  // RUNNER_SESSION_SNAPSHOT_PLUGIN_H_
@@ -0,0 +1,497 @@
+#include "source_resolver.h"
+
+#include <curl/curl.h>
+#include <string.h>
+
+#include <set>
+#include <vector>
+
+#include "connection_pool.h"
+#include "response_cache.h"
+
+namespace {
+
+// Enough of a page to reach the <link rel="icon"> in its head.
+constexpr size_t kMaxPageBytes = 64 * 1024;
+constexpr size_t kMaxIconBytes = 256 * 1024;
+// Longer URLs from a page's redirects or icon links are not followed.
+constexpr size_t kMaxUrlLength = 2048;
+
+// Resolutions change rarely; a month keeps a research session's sources warm
+// across sessions without holding on to dead links for long.
+constexpr int64_t kCacheTtlUs = int64_t{30} * 24 * 3600 * G_USEC_PER_SEC;
+constexpr uint64_t kCacheMaxBytes = 32 * 1024 * 1024;
+constexpr uint32_t kCacheCapacity = 8192;
+
+// Redirects mostly go through one Google host, multiplexed over one
+// connection; the sites they lead to get a short-lived connection each.
+constexpr ConnectionPoolOptions kSourcePoolOptions = {
+    4,   // max_host_connections
+    60,  // idle_timeout_s
+    30,  // keepalive_idle_s
+    15,  // keepalive_interval_s
+};
+
+// Some sites refuse requests that do not look like they come from a browser.
+constexpr char kUserAgent[] =
+    "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) "
+    "EchoLens";
+
+// Cache records; the first byte of an icon record says whether the site has
+// one, so that sites without an icon are not asked again.
+constexpr char kLinkKind[] = "link";
+constexpr char kIconKind[] = "icon";
+constexpr char kIconPresent = 'I';
+constexpr char kIconMissing = 'N';
+
+typedef struct {
+  std::string body;
+  size_t limit;
+} Download;
+
+typedef struct {
+  long status;
+  std::string location;
+  std::string content_type;
+  std::string body;
+  // The body was cut off at the limit.
+  bool truncated;
+} Response;
+
+size_t write_cb(char* data, size_t size, size_t count, void* user_data) {
+  Download* download = static_cast<Download*>(user_data);
+  size_t length = size * count;
+  size_t room = download->limit - download->body.size();
+  download->body.append(data, MIN(length, room));
+  // Stops the transfer once the limit is reached.
+  return length <= room ? length : 0;
+}
+
+void derive_key(const char* kind, const std::string& text, uint8_t* key) {
+  GChecksum* checksum = g_checksum_new(G_CHECKSUM_SHA256);
+  g_checksum_update(checksum, reinterpret_cast<const guchar*>(kind),
+                    strlen(kind) + 1);
+  g_checksum_update(checksum, reinterpret_cast<const guchar*>(text.data()),
+                    text.size());
+  guint8 digest[32];
+  gsize digest_length = sizeof(digest);
+  g_checksum_get_digest(checksum, digest, &digest_length);
+  g_checksum_free(checksum);
+  memcpy(key, digest, kResponseCacheKeySize);
+}
+
+// Returns the scheme, host and port of @url, or "" if it has none.
+std::string origin_of(const std::string& url) {
+  size_t host = url.find("://");
+  if (host == std::string::npos) {
+    return std::string();
+  }
+  size_t end = url.find_first_of("/?#", host + 3);
+  return url.substr(0, end);
+}
+
+std::string domain_of(const std::string& url) {
+  std::string origin = origin_of(url);
+  size_t host = origin.find("://");
+  if (host == std::string::npos) {
+    return std::string();
+  }
+  std::string domain = origin.substr(host + 3);
+  size_t at = domain.rfind('@');
+  if (at != std::string::npos) {
+    domain.erase(0, at + 1);
+  }
+  size_t port = domain.find(':');
+  if (port != std::string::npos) {
+    domain.erase(port);
+  }
+  g_autofree gchar* lower = g_ascii_strdown(domain.c_str(), -1);
+  domain = lower;
+  if (g_str_has_prefix(lower, "www.")) {
+    domain.erase(0, 4);
+  }
+  return domain;
+}
+
+// Whether @url may be fetched: pages choose where redirects and icon links
+// lead, and only the web is ours to visit.
+bool is_web_url(const std::string& url) {
+  return url.size() <= kMaxUrlLength &&
+         (g_ascii_strncasecmp(url.c_str(), "http://", 7) == 0 ||
+          g_ascii_strncasecmp(url.c_str(), "https://", 8) == 0);
+}
+
+// Resolves @href, as found in a page at @base, to an absolute URL.
+std::string resolve_href(const std::string& base, std::string href) {
+  for (size_t amp = href.find("&amp;"); amp != std::string::npos;
+       amp = href.find("&amp;", amp + 1)) {
+    href.erase(amp + 1, 4);
+  }
+  if (href.find("://") != std::string::npos) {
+    return href;
+  }
+  if (g_str_has_prefix(href.c_str(), "//")) {
+    return base.substr(0, base.find(':') + 1) + href;
+  }
+  std::string origin = origin_of(base);
+  if (href.empty() || href[0] == '/') {
+    return origin + href;
+  }
+  std::string path = base.substr(origin.size());
+  path = path.substr(0, path.find_first_of("?#"));
+  size_t slash = path.rfind('/');
+  path = slash == std::string::npos ? "/" : path.substr(0, slash + 1);
+  return origin + path + href;
+}
+
+// Returns the value of attribute @name in @tag, a tag lowercased as
+// @lower_tag so that names match in any case while values keep theirs.
+std::string attribute(const std::string& tag,
+                      const std::string& lower_tag,
+                      const char* name) {
+  std::string pattern = std::string(name) + "=";
+  for (size_t at = lower_tag.find(pattern); at != std::string::npos;
+       at = lower_tag.find(pattern, at + 1)) {
+    if (at == 0 || !g_ascii_isspace(lower_tag[at - 1])) {
+      continue;
+    }
+    size_t start = at + pattern.size();
+    if (start >= tag.size()) {
+      return std::string();
+    }
+    char quote = tag[start];
+    if (quote == '"' || quote == '\'') {
+      size_t end = tag.find(quote, start + 1);
+      return tag.substr(start + 1, end == std::string::npos
+                                       ? std::string::npos
+                                       : end - start - 1);
+    }
+    size_t end = tag.find_first_of(" \t\r\n/", start);
+    return tag.substr(start, end == std::string::npos ? std::string::npos
+                                                      : end - start);
+  }
+  return std::string();
+}
+
+// Returns the href of the first <link rel="icon"> in @page that is not an
+// SVG, which Flutter does not decode, or "".
+std::string find_icon_href(const std::string& page) {
+  std::string lower(page);
+  for (char& c : lower) {
+    c = g_ascii_tolower(c);
+  }
+  for (size_t at = lower.find("<link"); at != std::string::npos;
+       at = lower.find("<link", at + 1)) {
+    size_t end = lower.find('>', at);
+    if (end == std::string::npos) {
+      break;
+    }
+    std::string lower_tag = lower.substr(at, end - at);
+    std::string rel = attribute(lower_tag, lower_tag, "rel");
+    g_auto(GStrv) tokens = g_strsplit_set(rel.c_str(), " \t", -1);
+    if (!g_strv_contains(tokens, "icon") ||
+        lower_tag.find("svg") != std::string::npos) {
+      continue;
+    }
+    std::string href = attribute(page.substr(at, end - at), lower_tag, "href");
+    if (!href.empty()) {
+      return href;
+    }
+  }
+  return std::string();
+}
+
+// Checks the magic number of the formats Flutter decodes, since servers
+// often label icons wrongly.
+bool looks_like_image(const std::string& data) {
+  const char* bytes = data.data();
+  size_t size = data.size();
+  return (size > 8 && memcmp(bytes, "\x89PNG", 4) == 0) ||
+         (size > 6 && memcmp(bytes, "GIF8", 4) == 0) ||
+         (size > 3 && memcmp(bytes, "\xff\xd8\xff", 3) == 0) ||
+         (size > 4 && memcmp(bytes, "\0\0\1\0", 4) == 0) ||
+         (size > 12 && memcmp(bytes, "RIFF", 4) == 0 &&
+          memcmp(bytes + 8, "WEBP", 4) == 0) ||
+         (size > 2 && memcmp(bytes, "BM", 2) == 0);
+}
+
+}  // namespace
+
+struct _SourceResolver {
+  SourceResolverOptions options;
+  SourceResolvedCallback callback;
+  gpointer user_data;
+
+  ConnectionPool* pool;
+  GThreadPool* workers;
+
+  GMutex lock;
+  // Nullable; guarded by lock.
+  ResponseCache* cache;
+  std::set<std::string> in_flight;
+  SourceResolverStats stats;
+};
+
+// Runs one request without following redirects.
+static bool fetch(SourceResolver* resolver,
+                  const std::string& url,
+                  size_t limit,
+                  Response* response) {
+  if (!is_web_url(url)) {
+    return false;
+  }
+  CURL* curl = curl_easy_init();
+  if (curl == nullptr) {
+    return false;
+  }
+  Download download;
+  download.limit = limit;
+  curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+#if LIBCURL_VERSION_NUM >= 0x075500
+  curl_easy_setopt(curl, CURLOPT_PROTOCOLS_STR, "http,https");
+  curl_easy_setopt(curl, CURLOPT_REDIR_PROTOCOLS_STR, "http,https");
+#else
+  curl_easy_setopt(curl, CURLOPT_PROTOCOLS, CURLPROTO_HTTP | CURLPROTO_HTTPS);
+  curl_easy_setopt(curl, CURLOPT_REDIR_PROTOCOLS,
+                   CURLPROTO_HTTP | CURLPROTO_HTTPS);
+#endif
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_cb);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &download);
+  curl_easy_setopt(curl, CURLOPT_USERAGENT, kUserAgent);
+  curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+  curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, resolver->options.timeout_ms);
+  CURLcode result = connection_pool_perform(resolver->pool, curl);
+
+  response->truncated =
+      result == CURLE_WRITE_ERROR && download.body.size() >= limit;
+  bool ok = result == CURLE_OK || response->truncated;
+  if (ok) {
+    char* location = nullptr;
+    char* content_type = nullptr;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response->status);
+    curl_easy_getinfo(curl, CURLINFO_REDIRECT_URL, &location);
+    curl_easy_getinfo(curl, CURLINFO_CONTENT_TYPE, &content_type);
+    response->location = location != nullptr ? location : "";
+    response->content_type = content_type != nullptr ? content_type : "";
+    response->body = std::move(download.body);
+  }
+  curl_easy_cleanup(curl);
+  return ok;
+}
+
+// Follows the redirects from @url to the page they end at. Pages that answer
+// with an error still count: they are where the browser would go.
+static bool follow(SourceResolver* resolver,
+                   const std::string& url,
+                   std::string* final_url,
+                   std::string* page) {
+  std::string current = url;
+  for (int hop = 0; hop <= resolver->options.max_redirects; hop++) {
+    Response response;
+    if (!fetch(resolver, current, kMaxPageBytes, &response)) {
+      return false;
+    }
+    if (response.status >= 300 && response.status < 400 &&
+        !response.location.empty()) {
+      if (!is_web_url(response.location)) {
+        return false;
+      }
+      current = response.location;
+      g_mutex_lock(&resolver->lock);
+      resolver->stats.redirects++;
+      g_mutex_unlock(&resolver->lock);
+      continue;
+    }
+    if (response.status < 200) {
+      return false;
+    }
+    *final_url = current;
+    if (g_str_has_prefix(response.content_type.c_str(), "text/html")) {
+      *page = std::move(response.body);
+    }
+    return true;
+  }
+  return false;
+}
+
+static std::string fetch_icon(SourceResolver* resolver,
+                              const std::string& final_url,
+                              const std::string& page) {
+  std::vector<std::string> candidates;
+  std::string href = find_icon_href(page);
+  if (!href.empty()) {
+    std::string candidate = resolve_href(final_url, href);
+    if (is_web_url(candidate)) {
+      candidates.push_back(candidate);
+    }
+  }
+  candidates.push_back(origin_of(final_url) + "/favicon.ico");
+
+  for (const std::string& candidate : candidates) {
+    Response response;
+    if (fetch(resolver, candidate, kMaxIconBytes, &response) &&
+        response.status == 200 && !response.truncated &&
+        looks_like_image(response.body)) {
+      return std::move(response.body);
+    }
+  }
+  return std::string();
+}
+
+// Reads the icon record of @origin. Must be called with the lock held.
+static bool lookup_icon_locked(SourceResolver* resolver,
+                               const std::string& origin,
+                               std::string* icon) {
+  uint8_t key[kResponseCacheKeySize];
+  derive_key(kIconKind, origin, key);
+  std::string record;
+  if (resolver->cache == nullptr ||
+      !response_cache_lookup(resolver->cache, key, g_get_real_time(),
+                             &record) ||
+      record.empty()) {
+    return false;
+  }
+  icon->assign(record, 1, std::string::npos);
+  if (record[0] != kIconPresent) {
+    icon->clear();
+  }
+  return true;
+}
+
+static void store(SourceResolver* resolver,
+                  const ResolvedSource& source,
+                  bool store_icon) {
+  g_mutex_lock(&resolver->lock);
+  if (resolver->cache != nullptr) {
+    uint8_t key[kResponseCacheKeySize];
+    int64_t now = g_get_real_time();
+    derive_key(kLinkKind, source.url, key);
+    response_cache_store(resolver->cache, key, now,
+                         source.final_url + '\n' + source.domain);
+    if (store_icon) {
+      derive_key(kIconKind, origin_of(source.final_url), key);
+      response_cache_store(
+          resolver->cache, key, now,
+          (source.icon.empty() ? kIconMissing : kIconPresent) + source.icon);
+    }
+  }
+  g_mutex_unlock(&resolver->lock);
+}
+
+static void resolve_cb(gpointer data, gpointer user_data) {
+  SourceResolver* resolver = static_cast<SourceResolver*>(user_data);
+  g_autofree gchar* url = static_cast<gchar*>(data);
+
+  ResolvedSource source;
+  source.url = url;
+  std::string page;
+  bool resolved = follow(resolver, source.url, &source.final_url, &page);
+  if (resolved) {
+    source.domain = domain_of(source.final_url);
+    std::string origin = origin_of(source.final_url);
+    g_mutex_lock(&resolver->lock);
+    bool icon_cached = lookup_icon_locked(resolver, origin, &source.icon);
+    g_mutex_unlock(&resolver->lock);
+    if (!icon_cached) {
+      source.icon = fetch_icon(resolver, source.final_url, page);
+    }
+    store(resolver, source, !icon_cached);
+  } else {
+    source.final_url.clear();
+  }
+
+  g_mutex_lock(&resolver->lock);
+  resolver->in_flight.erase(source.url);
+  if (resolved) {
+    resolver->stats.resolved++;
+  } else {
+    resolver->stats.failed++;
+  }
+  if (!source.icon.empty()) {
+    resolver->stats.icons++;
+  }
+  g_mutex_unlock(&resolver->lock);
+
+  resolver->callback(source, resolver->user_data);
+}
+
+SourceResolver* source_resolver_new(const char* cache_directory,
+                                    const SourceResolverOptions& options,
+                                    SourceResolvedCallback callback,
+                                    gpointer user_data) {
+  SourceResolver* resolver = new SourceResolver();
+  resolver->options = options;
+  resolver->callback = callback;
+  resolver->user_data = user_data;
+  resolver->pool = connection_pool_new(kSourcePoolOptions);
+  resolver->workers = g_thread_pool_new(resolve_cb, resolver,
+                                        options.max_parallel, FALSE, nullptr);
+  g_mutex_init(&resolver->lock);
+  resolver->stats = SourceResolverStats();
+
+  ResponseCacheOptions cache_options;
+  cache_options.max_bytes = kCacheMaxBytes;
+  cache_options.ttl_us = kCacheTtlUs;
+  cache_options.capacity = kCacheCapacity;
+  resolver->cache = response_cache_open(cache_directory, &cache_options);
+  if (resolver->cache == nullptr) {
+    g_warning("Failed to open source cache in %s", cache_directory);
+  }
+  return resolver;
+}
+
+void source_resolver_free(SourceResolver* resolver) {
+  g_thread_pool_free(resolver->workers, TRUE, TRUE);
+  connection_pool_free(resolver->pool);
+  if (resolver->cache != nullptr) {
+    response_cache_free(resolver->cache);
+  }
+  g_mutex_clear(&resolver->lock);
+  delete resolver;
+}
+
+bool source_resolver_lookup(SourceResolver* resolver,
+                            const char* url,
+                            ResolvedSource* source) {
+  uint8_t key[kResponseCacheKeySize];
+  derive_key(kLinkKind, url, key);
+
+  g_mutex_lock(&resolver->lock);
+  std::string record;
+  bool found = resolver->cache != nullptr &&
+               response_cache_lookup(resolver->cache, key, g_get_real_time(),
+                                     &record);
+  size_t separator = record.find('\n');
+  found = found && separator != std::string::npos;
+  if (found) {
+    source->url = url;
+    source->final_url = record.substr(0, separator);
+    source->domain = record.substr(separator + 1);
+    source->icon.clear();
+    lookup_icon_locked(resolver, origin_of(source->final_url), &source->icon);
+    resolver->stats.hits++;
+  }
+  g_mutex_unlock(&resolver->lock);
+  return found;
+}
+
+void source_resolver_resolve(SourceResolver* resolver, const char* url) {
+  ResolvedSource cached;
+  if (source_resolver_lookup(resolver, url, &cached)) {
+    return;
+  }
+
+  g_mutex_lock(&resolver->lock);
+  bool queued = resolver->in_flight.insert(url).second;
+  g_mutex_unlock(&resolver->lock);
+  if (queued) {
+    g_thread_pool_push(resolver->workers, g_strdup(url), nullptr);
+  }
+}
+
+SourceResolverStats source_resolver_get_stats(SourceResolver* resolver) {
+  g_mutex_lock(&resolver->lock);
+  SourceResolverStats stats = resolver->stats;
+  g_mutex_unlock(&resolver->lock);
+  return stats;
+}
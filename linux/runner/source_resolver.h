@@ -0,0 +1,100 @@
+#ifndef RUNNER_SOURCE_RESOLVER_H_
+#define RUNNER_SOURCE_RESOLVER_H_
+
+#include <glib.h>
+#include <stdint.h>
+
+#include <string>
+
+// Where a grounding source leads. The sources of a Gemini answer are
+// redirect URIs; resolving one follows the redirects once and keeps the
+// result, so that opening the source later needs no round-trips.
+typedef struct {
+  // The redirect URI, as found in groundingChunks.
+  std::string url;
+  // Where the redirects end, or "" if they could not be followed.
+  std::string final_url;
+  // The host of final_url without a leading "www.".
+  std::string domain;
+  // The site's favicon in any format Flutter decodes, or "" if it has none.
+  std::string icon;
+} ResolvedSource;
+
+typedef struct {
+  // Sources resolved at the same time.
+  int max_parallel;
+  // Redirects followed before giving up on a source.
+  int max_redirects;
+  // Per request.
+  long timeout_ms;
+} SourceResolverOptions;
+
+constexpr SourceResolverOptions kSourceResolverOptions = {
+    6,     // max_parallel
+    10,    // max_redirects
+    8000,  // timeout_ms
+};
+
+typedef struct {
+  uint64_t resolved;
+  uint64_t failed;
+  // Lookups answered from the cache.
+  uint64_t hits;
+  uint64_t redirects;
+  uint64_t icons;
+} SourceResolverStats;
+
+// Called on a worker thread for every source passed to
+// source_resolver_resolve() that was not cached, once it is resolved or has
+// failed.
+typedef void (*SourceResolvedCallback)(const ResolvedSource& source,
+                                       gpointer user_data);
+
+// Resolves sources on a pool of worker threads sharing persistent
+// connections, and keeps the results in a response cache on disk: final URLs
+// by source and favicons by site, so that every answer citing a site shares
+// one icon. Thread-safe.
+typedef struct _SourceResolver SourceResolver;
+
+/**
+ * source_resolver_new:
+ * @cache_directory: directory of the cache; created if needed.
+ * @options: parallelism and limits.
+ * @callback: receives resolved sources.
+ * @user_data: passed to @callback.
+ *
+ * Returns: the resolver. Without a usable cache directory it still
+ * resolves, but forgets the results.
+ */
+SourceResolver* source_resolver_new(const char* cache_directory,
+                                    const SourceResolverOptions& options,
+                                    SourceResolvedCallback callback,
+                                    gpointer user_data);
+
+// Waits for the sources being resolved and drops the queued ones.
+void source_resolver_free(SourceResolver* resolver);
+
+/**
+ * source_resolver_lookup:
+ * @resolver: a #SourceResolver.
+ * @url: a redirect URI.
+ * @source: (out): receives the cached resolution.
+ *
+ * Returns: %TRUE if @url was resolved before, in this or an earlier session.
+ */
+bool source_resolver_lookup(SourceResolver* resolver,
+                            const char* url,
+                            ResolvedSource* source);
+
+/**
+ * source_resolver_resolve:
+ * @resolver: a #SourceResolver.
+ * @url: a redirect URI.
+ *
+ * Queues @url unless it is cached or already being resolved. Does not block.
+ */
+void source_resolver_resolve(SourceResolver* resolver, const char* url);
+
+SourceResolverStats source_resolver_get_stats(SourceResolver* resolver);
+
+#endif  // RUNNER_SOURCE_RESOLVER_H_
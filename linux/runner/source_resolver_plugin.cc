@@ -0,0 +1,216 @@
+#include "source_resolver_plugin.h"
+
+#include <cstring>
+
+#include "source_resolver.h"
+
+static constexpr char kChannelName[] = "echolens/source_resolver";
+static constexpr char kEventChannelName[] = "echolens/source_resolver/events";
+
+static constexpr char kResolveMethod[] = "resolve";
+static constexpr char kStatsMethod[] = "stats";
+
+static constexpr char kBadArgumentsError[] = "Bad Arguments";
+
+struct _SourceResolverPlugin {
+  GObject parent_instance;
+
+  FlMethodChannel* channel;
+  FlEventChannel* event_channel;
+  gboolean listening;
+
+  SourceResolver* resolver;
+};
+
+G_DEFINE_TYPE(SourceResolverPlugin, source_resolver_plugin, G_TYPE_OBJECT)
+
+// A resolution made on a worker thread, waiting to be sent from the main loop.
+typedef struct {
+  SourceResolverPlugin* self;
+  FlValue* event;
+} PendingEvent;
+
+// Encodes @source the same way for replies and events. A source that could
+// not be resolved has a null finalUrl.
+static FlValue* source_to_value(const ResolvedSource& source) {
+  FlValue* value = fl_value_new_map();
+  fl_value_set_string_take(value, "url",
+                           fl_value_new_string(source.url.c_str()));
+  if (source.final_url.empty()) {
+    fl_value_set_string_take(value, "finalUrl", fl_value_new_null());
+    fl_value_set_string_take(value, "domain", fl_value_new_null());
+  } else {
+    fl_value_set_string_take(value, "finalUrl",
+                             fl_value_new_string(source.final_url.c_str()));
+    fl_value_set_string_take(value, "domain",
+                             fl_value_new_string(source.domain.c_str()));
+  }
+  if (source.icon.empty()) {
+    fl_value_set_string_take(value, "icon", fl_value_new_null());
+  } else {
+    fl_value_set_string_take(
+        value, "icon",
+        fl_value_new_uint8_list(
+            reinterpret_cast<const uint8_t*>(source.icon.data()),
+            source.icon.size()));
+  }
+  return value;
+}
+
+// Sends an event on the main thread.
+static gboolean deliver_event_cb(gpointer user_data) {
+  PendingEvent* pending = static_cast<PendingEvent*>(user_data);
+  SourceResolverPlugin* self = pending->self;
+
+  if (self->listening && self->event_channel != nullptr) {
+    g_autoptr(GError) error = nullptr;
+    if (!fl_event_channel_send(self->event_channel, pending->event, nullptr,
+                               &error)) {
+      g_warning("Failed to send source event: %s", error->message);
+    }
+  }
+
+  fl_value_unref(pending->event);
+  g_object_unref(pending->self);
+  g_free(pending);
+  return G_SOURCE_REMOVE;
+}
+
+// Called on a worker thread of the resolver.
+static void source_resolved_cb(const ResolvedSource& source,
+                               gpointer user_data) {
+  PendingEvent* pending = g_new0(PendingEvent, 1);
+  pending->self = SOURCE_RESOLVER_PLUGIN(g_object_ref(user_data));
+  pending->event = source_to_value(source);
+  g_main_context_invoke(nullptr, deliver_event_cb, pending);
+}
+
+static FlMethodResponse* resolve(SourceResolverPlugin* self, FlValue* args) {
+  FlValue* urls = nullptr;
+  if (fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    urls = fl_value_lookup_string(args, "urls");
+  }
+  if (urls == nullptr || fl_value_get_type(urls) != FL_VALUE_TYPE_LIST) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        kBadArgumentsError, "Expected urls", nullptr));
+  }
+
+  g_autoptr(FlValue) cached = fl_value_new_list();
+  for (size_t i = 0; i < fl_value_get_length(urls); i++) {
+    FlValue* url = fl_value_get_list_value(urls, i);
+    if (fl_value_get_type(url) != FL_VALUE_TYPE_STRING) {
+      continue;
+    }
+    ResolvedSource source;
+    if (source_resolver_lookup(self->resolver, fl_value_get_string(url),
+                               &source)) {
+      fl_value_append_take(cached, source_to_value(source));
+    } else {
+      source_resolver_resolve(self->resolver, fl_value_get_string(url));
+    }
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(cached));
+}
+
+static FlMethodResponse* stats(SourceResolverPlugin* self) {
+  SourceResolverStats stats = source_resolver_get_stats(self->resolver);
+  g_autoptr(FlValue) result = fl_value_new_map();
+  fl_value_set_string_take(result, "resolved",
+                           fl_value_new_int(stats.resolved));
+  fl_value_set_string_take(result, "failed", fl_value_new_int(stats.failed));
+  fl_value_set_string_take(result, "hits", fl_value_new_int(stats.hits));
+  fl_value_set_string_take(result, "redirects",
+                           fl_value_new_int(stats.redirects));
+  fl_value_set_string_take(result, "icons", fl_value_new_int(stats.icons));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Called when a method call is received from Flutter.
+static void method_call_cb(FlMethodChannel* channel,
+                           FlMethodCall* method_call,
+                           gpointer user_data) {
+  SourceResolverPlugin* self = SOURCE_RESOLVER_PLUGIN(user_data);
+  const gchar* method = fl_method_call_get_name(method_call);
+  FlValue* args = fl_method_call_get_args(method_call);
+
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (strcmp(method, kResolveMethod) == 0) {
+    response = resolve(self, args);
+  } else if (strcmp(method, kStatsMethod) == 0) {
+    response = stats(self);
+  } else {
+    response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+  }
+
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(method_call, response, &error)) {
+    g_warning("Failed to send method call response: %s", error->message);
+  }
+}
+
+static FlMethodErrorResponse* listen_cb(FlEventChannel* channel,
+                                        FlValue* args,
+                                        gpointer user_data) {
+  SOURCE_RESOLVER_PLUGIN(user_data)->listening = TRUE;
+  return nullptr;
+}
+
+static FlMethodErrorResponse* cancel_cb(FlEventChannel* channel,
+                                        FlValue* args,
+                                        gpointer user_data) {
+  SOURCE_RESOLVER_PLUGIN(user_data)->listening = FALSE;
+  return nullptr;
+}
+
+static void source_resolver_plugin_dispose(GObject* object) {
+  SourceResolverPlugin* self = SOURCE_RESOLVER_PLUGIN(object);
+
+  // Waits for the sources being resolved; their events are dropped.
+  g_clear_pointer(&self->resolver, source_resolver_free);
+  g_clear_object(&self->channel);
+  g_clear_object(&self->event_channel);
+
+  G_OBJECT_CLASS(source_resolver_plugin_parent_class)->dispose(object);
+}
+
+static void source_resolver_plugin_class_init(
+    SourceResolverPluginClass* klass) {
+  G_OBJECT_CLASS(klass)->dispose = source_resolver_plugin_dispose;
+}
+
+static void source_resolver_plugin_init(SourceResolverPlugin* self) {
+  g_autofree gchar* directory = g_build_filename(
+      g_get_user_cache_dir(), APPLICATION_ID, "source_cache", nullptr);
+  g_mkdir_with_parents(directory, 0700);
+
+  self->resolver = source_resolver_new(directory, kSourceResolverOptions,
+                                       source_resolved_cb, self);
+}
+
+static SourceResolverPlugin* source_resolver_plugin_new(
+    FlBinaryMessenger* messenger) {
+  SourceResolverPlugin* self = SOURCE_RESOLVER_PLUGIN(
+      g_object_new(source_resolver_plugin_get_type(), nullptr));
+
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  self->channel =
+      fl_method_channel_new(messenger, kChannelName, FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(self->channel, method_call_cb,
+                                            g_object_ref(self),
+                                            g_object_unref);
+
+  self->event_channel = fl_event_channel_new(messenger, kEventChannelName,
+                                             FL_METHOD_CODEC(codec));
+  fl_event_channel_set_stream_handlers(self->event_channel, listen_cb,
+                                       cancel_cb, g_object_ref(self),
+                                       g_object_unref);
+
+  return self;
+}
+
+void source_resolver_plugin_register_with_registrar(
+    FlPluginRegistrar* registrar) {
+  SourceResolverPlugin* plugin =
+      source_resolver_plugin_new(fl_plugin_registrar_get_messenger(registrar));
+  g_object_unref(plugin);
+}
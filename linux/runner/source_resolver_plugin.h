@@ -0,0 +1,24 @@
+#ifndef RUNNER_SOURCE_RESOLVER_PLUGIN_H_
+#define RUNNER_SOURCE_RESOLVER_PLUGIN_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+G_DECLARE_FINAL_TYPE(SourceResolverPlugin,
+                     source_resolver_plugin,
+                     SOURCE,
+                     RESOLVER_PLUGIN,
+                     GObject)
+
+/**
+ * source_resolver_plugin_register_with_registrar:
+ * @registrar: an #FlPluginRegistrar.
+ *
+ * Registers the "echolens/source_resolver" method channel. "resolve" takes
+ * the source URLs of an answer, replies at once with those resolved before
+ * and resolves the others in parallel, sending each on the
+ * "echolens/source_resolver/events" event channel as it completes.
+ */
+void source_resolver_plugin_register_with_registrar(
+    FlPluginRegistrar* registrar);
+
+#endif  // RUNNER_SOURCE_RESOLVER_PLUGIN_H_
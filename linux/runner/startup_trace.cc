@@ -0,0 +1,175 @@
+#include "startup_trace.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef struct {
+  StartupTraceTrack track;
+  std::string name;
+  // Monotonic microseconds.
+  gint64 start;
+  // -1 for an instant.
+  gint64 duration;
+} TraceEvent;
+
+typedef struct {
+  gchar* path;
+  // g_get_real_time() - g_get_monotonic_time() when tracing started.
+  gint64 real_offset;
+  GMutex lock;
+  std::vector<TraceEvent> events;
+  gboolean written;
+} StartupTrace;
+
+// Never freed; it lives as long as the process.
+StartupTrace* trace = nullptr;
+
+void record(StartupTraceTrack track,
+            const char* name,
+            gint64 start,
+            gint64 duration) {
+  g_mutex_lock(&trace->lock);
+  trace->events.push_back({track, name, start, duration});
+  g_mutex_unlock(&trace->lock);
+}
+
+void append_escaped(std::string* json, const std::string& text) {
+  json->push_back('"');
+  for (unsigned char c : text) {
+    if (c == '"' || c == '\\') {
+      json->push_back('\\');
+      json->push_back(c);
+    } else if (c < 0x20) {
+      char escape[8];
+      snprintf(escape, sizeof(escape), "\\u%04x", c);
+      json->append(escape);
+    } else {
+      json->push_back(c);
+    }
+  }
+  json->push_back('"');
+}
+
+void append_thread_name(std::string* json,
+                        int pid,
+                        StartupTraceTrack track,
+                        const char* name) {
+  g_autofree gchar* event = g_strdup_printf(
+      "{\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"name\":\"thread_name\","
+      "\"args\":{\"name\":\"%s\"}},\n",
+      pid, track, name);
+  json->append(event);
+}
+
+}  // namespace
+
+void startup_trace_init(int argc, char** argv) {
+  const gchar* path = g_getenv(kStartupTraceEnv);
+  for (int i = 1; i < argc; i++) {
+    if (g_str_has_prefix(argv[i], kStartupTraceArgument)) {
+      path = argv[i] + strlen(kStartupTraceArgument);
+    }
+  }
+  if (path == nullptr || path[0] == '\0') {
+    return;
+  }
+
+  gint64 now = g_get_monotonic_time();
+  trace = new StartupTrace();
+  trace->path = g_strdup(path);
+  trace->real_offset = g_get_real_time() - now;
+  g_mutex_init(&trace->lock);
+
+  // A launcher that passes its spawn time lets the trace start before main().
+  const gchar* launched_at = g_getenv(kStartupTraceLaunchedAtEnv);
+  if (launched_at != nullptr) {
+    gint64 spawned = g_ascii_strtoll(launched_at, nullptr, 10);
+    if (spawned > 0 && spawned <= now) {
+      record(STARTUP_TRACE_TRACK_RUNNER, "exec", spawned, now - spawned);
+    }
+  }
+  record(STARTUP_TRACE_TRACK_RUNNER, "main", now, -1);
+}
+
+gboolean startup_trace_is_enabled() {
+  return trace != nullptr;
+}
+
+gint64 startup_trace_begin() {
+  return trace != nullptr ? g_get_monotonic_time() : 0;
+}
+
+void startup_trace_end(const char* name, gint64 start) {
+  if (trace == nullptr) {
+    return;
+  }
+  record(STARTUP_TRACE_TRACK_RUNNER, name, start,
+         g_get_monotonic_time() - start);
+}
+
+void startup_trace_mark(const char* name) {
+  if (trace == nullptr) {
+    return;
+  }
+  record(STARTUP_TRACE_TRACK_RUNNER, name, g_get_monotonic_time(), -1);
+}
+
+void startup_trace_add_span(StartupTraceTrack track,
+                            const char* name,
+                            gint64 start_us,
+                            gint64 end_us) {
+  if (trace == nullptr || end_us < start_us) {
+    return;
+  }
+  record(track, name, start_us - trace->real_offset, end_us - start_us);
+}
+
+void startup_trace_flush() {
+  if (trace == nullptr) {
+    return;
+  }
+
+  int pid = getpid();
+  std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  append_thread_name(&json, pid, STARTUP_TRACE_TRACK_RUNNER, "runner");
+  append_thread_name(&json, pid, STARTUP_TRACE_TRACK_DART, "dart");
+
+  g_mutex_lock(&trace->lock);
+  for (size_t i = 0; i < trace->events.size(); i++) {
+    const TraceEvent& event = trace->events[i];
+    json += "{\"name\":";
+    append_escaped(&json, event.name);
+    g_autofree gchar* fields = nullptr;
+    if (event.duration < 0) {
+      fields = g_strdup_printf(
+          ",\"ph\":\"i\",\"s\":\"p\",\"ts\":%" G_GINT64_FORMAT
+          ",\"pid\":%d,\"tid\":%d}",
+          event.start, pid, event.track);
+    } else {
+      fields = g_strdup_printf(
+          ",\"ph\":\"X\",\"ts\":%" G_GINT64_FORMAT ",\"dur\":%" G_GINT64_FORMAT
+          ",\"pid\":%d,\"tid\":%d}",
+          event.start, event.duration, pid, event.track);
+    }
+    json += fields;
+    json += i + 1 < trace->events.size() ? ",\n" : "\n";
+  }
+  g_mutex_unlock(&trace->lock);
+  json += "]}\n";
+
+  g_autoptr(GError) error = nullptr;
+  if (!g_file_set_contents(trace->path, json.data(), json.size(), &error)) {
+    g_warning("Failed to write startup trace: %s", error->message);
+  }
+  trace->written = TRUE;
+}
+
+gboolean startup_trace_is_written() {
+  return trace != nullptr && trace->written;
+}
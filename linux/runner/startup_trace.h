@@ -0,0 +1,92 @@
+#ifndef RUNNER_STARTUP_TRACE_H_
+#define RUNNER_STARTUP_TRACE_H_
+
+#include <glib.h>
+
+// Environment variable naming the trace file to write.
+constexpr char kStartupTraceEnv[] = "ECHOLENS_STARTUP_TRACE";
+// Optional g_get_monotonic_time() at which a launcher spawned the process,
+// so that the trace also covers exec and dynamic linking before main().
+constexpr char kStartupTraceLaunchedAtEnv[] =
+    "ECHOLENS_STARTUP_TRACE_LAUNCHED_AT";
+// Entry point argument with the same meaning as kStartupTraceEnv.
+constexpr char kStartupTraceArgument[] = "--startup-trace=";
+
+// Tracks in the trace; each one is shown as a thread.
+typedef enum {
+  STARTUP_TRACE_TRACK_RUNNER = 1,
+  STARTUP_TRACE_TRACK_DART = 2,
+} StartupTraceTrack;
+
+/**
+ * startup_trace_init:
+ * @argc: the argument count passed to main().
+ * @argv: the arguments passed to main().
+ *
+ * Enables tracing if `ECHOLENS_STARTUP_TRACE=<path>` is set or
+ * `--startup-trace=<path>` is among the arguments. Call first thing in
+ * main(); every other function is a cheap no-op while tracing is disabled.
+ */
+void startup_trace_init(int argc, char** argv);
+
+gboolean startup_trace_is_enabled();
+
+/**
+ * startup_trace_begin:
+ *
+ * Returns: the start of a span to pass to startup_trace_end(), or 0 while
+ * tracing is disabled.
+ */
+gint64 startup_trace_begin();
+
+/**
+ * startup_trace_end:
+ * @name: the name of the phase, e.g. "fl_view_new".
+ * @start: the value returned by startup_trace_begin().
+ *
+ * Records a span on the runner track from @start until now.
+ */
+void startup_trace_end(const char* name, gint64 start);
+
+/**
+ * startup_trace_mark:
+ * @name: the name of the event, e.g. "first_frame".
+ *
+ * Records an instant on the runner track.
+ */
+void startup_trace_mark(const char* name);
+
+/**
+ * startup_trace_add_span:
+ * @track: the track to show the span on.
+ * @name: the name of the span.
+ * @start_us: the start as wall-clock microseconds since the Unix epoch.
+ * @end_us: the end, in the same clock.
+ *
+ * Records a span measured by a clock other than the runner's, such as
+ * DateTime.now() in Dart. Wall-clock times are mapped onto the monotonic
+ * timeline with an offset taken once in startup_trace_init().
+ */
+void startup_trace_add_span(StartupTraceTrack track,
+                            const char* name,
+                            gint64 start_us,
+                            gint64 end_us);
+
+/**
+ * startup_trace_flush:
+ *
+ * Writes every event recorded so far to the trace file as Chrome trace event
+ * JSON, which chrome://tracing and ui.perfetto.dev open directly. The file is
+ * replaced atomically, so it may be written again as more events arrive.
+ */
+void startup_trace_flush();
+
+/**
+ * startup_trace_is_written:
+ *
+ * Returns: %TRUE once startup_trace_flush() has written the file, so that
+ * events arriving later know to write it again.
+ */
+gboolean startup_trace_is_written();
+
+#endif  // RUNNER_STARTUP_TRACE_H_
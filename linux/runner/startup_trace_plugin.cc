@@ -0,0 +1,115 @@
+#include "startup_trace_plugin.h"
+
+#include <cstring>
+
+#include "startup_trace.h"
+
+static constexpr char kChannelName[] = "echolens/startup_trace";
+
+static constexpr char kIsEnabledMethod[] = "isEnabled";
+static constexpr char kAddSpansMethod[] = "addSpans";
+
+static constexpr char kBadArgumentsError[] = "Bad Arguments";
+
+struct _StartupTracePlugin {
+  GObject parent_instance;
+};
+
+G_DEFINE_TYPE(StartupTracePlugin, startup_trace_plugin, G_TYPE_OBJECT)
+
+static gboolean read_span(FlValue* value,
+                          const gchar** name,
+                          gint64* start,
+                          gint64* end) {
+  if (fl_value_get_type(value) != FL_VALUE_TYPE_MAP) {
+    return FALSE;
+  }
+  FlValue* name_value = fl_value_lookup_string(value, "name");
+  FlValue* start_value = fl_value_lookup_string(value, "start");
+  FlValue* end_value = fl_value_lookup_string(value, "end");
+  if (name_value == nullptr ||
+      fl_value_get_type(name_value) != FL_VALUE_TYPE_STRING ||
+      start_value == nullptr ||
+      fl_value_get_type(start_value) != FL_VALUE_TYPE_INT ||
+      end_value == nullptr ||
+      fl_value_get_type(end_value) != FL_VALUE_TYPE_INT) {
+    return FALSE;
+  }
+  *name = fl_value_get_string(name_value);
+  *start = fl_value_get_int(start_value);
+  *end = fl_value_get_int(end_value);
+  return TRUE;
+}
+
+static FlMethodResponse* add_spans(FlValue* args) {
+  FlValue* spans = nullptr;
+  if (fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    spans = fl_value_lookup_string(args, "spans");
+  }
+  if (spans == nullptr || fl_value_get_type(spans) != FL_VALUE_TYPE_LIST) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        kBadArgumentsError, "Expected spans", nullptr));
+  }
+
+  for (size_t i = 0; i < fl_value_get_length(spans); i++) {
+    const gchar* name = nullptr;
+    gint64 start = 0;
+    gint64 end = 0;
+    if (!read_span(fl_value_get_list_value(spans, i), &name, &start, &end)) {
+      return FL_METHOD_RESPONSE(fl_method_error_response_new(
+          kBadArgumentsError, "Expected name, start and end in every span",
+          nullptr));
+    }
+    startup_trace_add_span(STARTUP_TRACE_TRACK_DART, name, start, end);
+  }
+
+  // Spans that arrive after the first frame still belong in the file.
+  if (startup_trace_is_written()) {
+    startup_trace_flush();
+  }
+
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+}
+
+// Called when a method call is received from Flutter.
+static void method_call_cb(FlMethodChannel* channel,
+                           FlMethodCall* method_call,
+                           gpointer user_data) {
+  const gchar* method = fl_method_call_get_name(method_call);
+
+  g_autoptr(FlMethodResponse) response = nullptr;
+  if (strcmp(method, kIsEnabledMethod) == 0) {
+    g_autoptr(FlValue) enabled =
+        fl_value_new_bool(startup_trace_is_enabled());
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(enabled));
+  } else if (strcmp(method, kAddSpansMethod) == 0) {
+    response = add_spans(fl_method_call_get_args(method_call));
+  } else {
+    response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+  }
+
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(method_call, response, &error)) {
+    g_warning("Failed to send method call response: %s", error->message);
+  }
+}
+
+static void startup_trace_plugin_class_init(StartupTracePluginClass* klass) {}
+
+static void startup_trace_plugin_init(StartupTracePlugin* self) {}
+
+void startup_trace_plugin_register_with_registrar(
+    FlPluginRegistrar* registrar) {
+  StartupTracePlugin* plugin = STARTUP_TRACE_PLUGIN(
+      g_object_new(startup_trace_plugin_get_type(), nullptr));
+
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  g_autoptr(FlMethodChannel) channel =
+      fl_method_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                            kChannelName, FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(channel, method_call_cb,
+                                            g_object_ref(plugin),
+                                            g_object_unref);
+
+  g_object_unref(plugin);
+}
@@ -0,0 +1,24 @@
+#ifndef RUNNER_STARTUP_TRACE_PLUGIN_H_
+#define RUNNER_STARTUP_TRACE_PLUGIN_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+G_DECLARE_FINAL_TYPE(StartupTracePlugin,
+                     startup_trace_plugin,
+                     STARTUP,
+                     TRACE_PLUGIN,
+                     GObject)
+
+/**
+ * startup_trace_plugin_register_with_registrar:
+ * @registrar: an #FlPluginRegistrar.
+ *
+ * Registers the "echolens/startup_trace" method channel, through which Dart
+ * adds its own startup phases to the trace. `isEnabled` replies whether a
+ * trace is being recorded; `addSpans` takes
+ * `{spans: [{name, start, end}]}` with wall-clock microseconds from
+ * DateTime.now().
+ */
+void startup_trace_plugin_register_with_registrar(FlPluginRegistrar* registrar);
+
+#endif  // RUNNER_STARTUP_TRACE_PLUGIN_H_
@@ -0,0 +1,132 @@
+#include "stream_flights.h"
+
+#include <algorithm>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+namespace {
+
+struct Subscription {
+  StreamFlight* flight;
+  int64_t deadline_us;
+};
+
+}  // namespace
+
+struct _StreamFlights {
+  // The flight that new requests for a key join; older flights for the same
+  // key, or abandoned ones, are only in @live.
+  std::unordered_map<std::string, StreamFlight*> joinable;
+  std::unordered_set<StreamFlight*> live;
+  std::unordered_map<int64_t, Subscription> subscriptions;
+  // (deadline, id) of the subscriptions due before their flight, soonest
+  // first.
+  std::set<std::pair<int64_t, int64_t>> deadlines;
+};
+
+// Stops routing requests for @flight's key to it.
+static void detach(StreamFlights* flights, StreamFlight* flight) {
+  auto it = flights->joinable.find(flight->key);
+  if (it != flights->joinable.end() && it->second == flight) {
+    flights->joinable.erase(it);
+  }
+}
+
+StreamFlights* stream_flights_new() {
+  return new StreamFlights();
+}
+
+void stream_flights_free(StreamFlights* flights) {
+  for (StreamFlight* flight : flights->live) {
+    delete flight;
+  }
+  delete flights;
+}
+
+StreamFlight* stream_flights_subscribe(StreamFlights* flights,
+                                       const std::string& key,
+                                       int64_t id,
+                                       int64_t deadline_us,
+                                       bool* joined) {
+  stream_flights_unsubscribe(flights, id);
+
+  auto it = flights->joinable.find(key);
+  StreamFlight* flight = nullptr;
+  if (it != flights->joinable.end() && deadline_us <= it->second->deadline_us) {
+    flight = it->second;
+    *joined = true;
+  } else {
+    flight = new StreamFlight();
+    flight->key = key;
+    flight->deadline_us = deadline_us;
+    flight->data = nullptr;
+    flights->joinable[key] = flight;
+    flights->live.insert(flight);
+    *joined = false;
+  }
+
+  flight->subscribers.push_back(id);
+  flights->subscriptions[id] = {flight, deadline_us};
+  // The rest are answered by the upstream request's own deadline.
+  if (deadline_us < flight->deadline_us) {
+    flights->deadlines.emplace(deadline_us, id);
+  }
+  return flight;
+}
+
+StreamFlight* stream_flights_unsubscribe(StreamFlights* flights, int64_t id) {
+  auto it = flights->subscriptions.find(id);
+  if (it == flights->subscriptions.end()) {
+    return nullptr;
+  }
+  StreamFlight* flight = it->second.flight;
+  flights->deadlines.erase({it->second.deadline_us, id});
+  flights->subscriptions.erase(it);
+
+  flight->subscribers.erase(std::remove(flight->subscribers.begin(),
+                                        flight->subscribers.end(), id),
+                            flight->subscribers.end());
+  if (flight->subscribers.empty()) {
+    detach(flights, flight);
+  }
+  return flight;
+}
+
+void stream_flights_expire(StreamFlights* flights,
+                           int64_t now_us,
+                           std::vector<int64_t>* expired,
+                           std::vector<StreamFlight*>* abandoned) {
+  expired->clear();
+  abandoned->clear();
+  while (!flights->deadlines.empty() &&
+         flights->deadlines.begin()->first <= now_us) {
+    int64_t id = flights->deadlines.begin()->second;
+    StreamFlight* flight = stream_flights_unsubscribe(flights, id);
+    expired->push_back(id);
+    if (flight->subscribers.empty()) {
+      abandoned->push_back(flight);
+    }
+  }
+}
+
+int64_t stream_flights_next_deadline(StreamFlights* flights) {
+  return flights->deadlines.empty() ? INT64_MAX
+                                    : flights->deadlines.begin()->first;
+}
+
+void stream_flights_finish(StreamFlights* flights, StreamFlight* flight) {
+  for (int64_t id : flight->subscribers) {
+    auto it = flights->subscriptions.find(id);
+    flights->deadlines.erase({it->second.deadline_us, id});
+    flights->subscriptions.erase(it);
+  }
+  detach(flights, flight);
+  flights->live.erase(flight);
+  delete flight;
+}
+
+size_t stream_flights_in_flight(StreamFlights* flights) {
+  return flights->live.size();
+}
@@ -0,0 +1,98 @@
+#ifndef RUNNER_STREAM_FLIGHTS_H_
+#define RUNNER_STREAM_FLIGHTS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// The streaming requests in flight and the Dart requests subscribed to each.
+//
+// A Dart request for a url and body already in flight joins that flight
+// instead of reaching the API again, as long as the flight's own deadline
+// does not cut it short. Every subscriber keeps its own deadline: one due
+// before the flight's is taken out of the flight alone when it passes, while
+// the others get the flight's own deadline error. Only touched on the main
+// thread.
+typedef struct _StreamFlights StreamFlights;
+
+// One upstream request.
+typedef struct {
+  std::string key;
+  // The deadline of the upstream request, on the monotonic clock.
+  int64_t deadline_us;
+  // Dart request ids waiting on the flight, in the order they subscribed.
+  std::vector<int64_t> subscribers;
+  // Every data event so far, replayed to requests that join late.
+  std::vector<std::vector<uint8_t>> chunks;
+  // The caller's, e.g. the request's cancellable.
+  void* data;
+} StreamFlight;
+
+StreamFlights* stream_flights_new();
+
+// Frees @flights and the flights left in it, but not their data.
+void stream_flights_free(StreamFlights* flights);
+
+/**
+ * stream_flights_subscribe:
+ * @flights: a #StreamFlights.
+ * @key: identifies the url and body of the request.
+ * @id: the Dart request id.
+ * @deadline_us: when @id gives up, on the monotonic clock.
+ * @joined: (out): whether @id joined a flight already under way, whose
+ *   chunks so far it is owed; otherwise the caller starts the request.
+ *
+ * Subscribes @id to the flight for @key. A flight that would end before
+ * @deadline_us is not joined: a new one takes its place for later requests,
+ * and the old one goes on for its own subscribers.
+ *
+ * Returns: the flight @id is subscribed to.
+ */
+StreamFlight* stream_flights_subscribe(StreamFlights* flights,
+                                       const std::string& key,
+                                       int64_t id,
+                                       int64_t deadline_us,
+                                       bool* joined);
+
+/**
+ * stream_flights_unsubscribe:
+ * @flights: a #StreamFlights.
+ * @id: a Dart request id.
+ *
+ * Takes @id out of its flight. A flight left without subscribers can no
+ * longer be joined; the caller cancels it, and it stays until
+ * stream_flights_finish().
+ *
+ * Returns: the flight @id was subscribed to, or %NULL.
+ */
+StreamFlight* stream_flights_unsubscribe(StreamFlights* flights, int64_t id);
+
+/**
+ * stream_flights_expire:
+ * @flights: a #StreamFlights.
+ * @now_us: the current monotonic time.
+ * @expired: (out): receives the ids whose deadline has passed, soonest first.
+ * @abandoned: (out): receives the flights this left without subscribers.
+ *
+ * Unsubscribes every request due before its flight whose deadline is at or
+ * before @now_us.
+ */
+void stream_flights_expire(StreamFlights* flights,
+                           int64_t now_us,
+                           std::vector<int64_t>* expired,
+                           std::vector<StreamFlight*>* abandoned);
+
+// The earliest deadline of a subscriber due before its flight, or INT64_MAX
+// without one.
+int64_t stream_flights_next_deadline(StreamFlights* flights);
+
+// Unsubscribes everyone left on @flight, once its terminal event has been
+// sent to them, and frees it.
+void stream_flights_finish(StreamFlights* flights, StreamFlight* flight);
+
+// The number of upstream requests not yet finished.
+size_t stream_flights_in_flight(StreamFlights* flights);
+
+#endif  // RUNNER_STREAM_FLIGHTS_H_
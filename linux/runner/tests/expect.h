@@ -0,0 +1,28 @@
+#ifndef RUNNER_TESTS_EXPECT_H_
+#define RUNNER_TESTS_EXPECT_H_
+
+#include <stdio.h>
+
+// The runner's tests are plain executables run by ctest. Each failed
+// EXPECT() is reported on stderr, and main() returns expect_result().
+
+static int expect_failures = 0;
+
+#define EXPECT(condition)                                         \
+  do {                                                            \
+    if (!(condition)) {                                           \
+      fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, \
+              #condition);                                        \
+      expect_failures++;                                          \
+    }                                                             \
+  } while (0)
+
+static int expect_result() {
+  if (expect_failures > 0) {
+    fprintf(stderr, "%d checks failed\n", expect_failures);
+    return 1;
+  }
+  return 0;
+}
+
+#endif  // RUNNER_TESTS_EXPECT_H_
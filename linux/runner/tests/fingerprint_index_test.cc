@@ -0,0 +1,116 @@
+// Tests for fingerprint_index_similar() and fingerprint_index_duplicates().
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "../fingerprint_index.h"
+#include "expect.h"
+
+namespace {
+
+constexpr char kRoeAnswer[] =
+    "jane roe is a professor of computer science at mit where she leads the "
+    "distributed systems group her work on consensus protocols received the "
+    "best paper award she earned her phd at stanford in 2009";
+
+constexpr char kSmithAnswer[] =
+    "john smith is a historian at the university of oxford who writes about "
+    "medieval trade routes his latest book follows the wool merchants of "
+    "flanders across three centuries";
+
+constexpr char kParkAnswer[] =
+    "ada park is a marine biologist at the scripps institution of "
+    "oceanography studying coral reef resilience and the effects of warming "
+    "waters on symbiotic algae";
+
+std::vector<std::string> ids_of(const std::vector<FingerprintMatch>& matches) {
+  std::vector<std::string> ids;
+  for (const FingerprintMatch& match : matches) {
+    ids.push_back(match.id);
+  }
+  return ids;
+}
+
+void test_similar() {
+  FingerprintIndex* index = fingerprint_index_new();
+  fingerprint_index_put(index, "roe", 1, "dr jane roe mit", kRoeAnswer);
+  fingerprint_index_put(index, "roe-csail", 2, "jane roe mit csail",
+                        kRoeAnswer);
+  fingerprint_index_put(index, "doe", 3, "jane doe harvard", "");
+  fingerprint_index_put(index, "smith", 4, "john smith oxford", kSmithAnswer);
+  std::vector<FingerprintMatch> matches;
+
+  // Titles, punctuation and extra words do not hide the person; equal scores
+  // come newest first.
+  fingerprint_index_similar(index, "prof. jane roe, mit", 0, &matches);
+  EXPECT((ids_of(matches) == std::vector<std::string>{"roe-csail", "roe"}));
+  for (const FingerprintMatch& match : matches) {
+    EXPECT(match.score == 1.0);
+  }
+
+  fingerprint_index_similar(index, "prof. jane roe, mit", 1, &matches);
+  EXPECT((ids_of(matches) == std::vector<std::string>{"roe-csail"}));
+
+  // One shared word is not enough, and neither is half of them.
+  fingerprint_index_similar(index, "jane smith", 0, &matches);
+  EXPECT(matches.empty());
+  fingerprint_index_similar(index, "jane roe stanford berkeley", 0, &matches);
+  EXPECT(matches.empty());
+
+  // A query of stop words and one name has too few words to compare.
+  fingerprint_index_similar(index, "the professor roe", 0, &matches);
+  EXPECT(matches.empty());
+
+  EXPECT(fingerprint_index_remove(index, "roe-csail"));
+  EXPECT(!fingerprint_index_remove(index, "roe-csail"));
+  fingerprint_index_similar(index, "jane roe mit", 0, &matches);
+  EXPECT((ids_of(matches) == std::vector<std::string>{"roe"}));
+  fingerprint_index_free(index);
+}
+
+void test_duplicates() {
+  FingerprintIndex* index = fingerprint_index_new();
+  // A reworded query with the same answer, and a different query whose
+  // answer is the same text.
+  fingerprint_index_put(index, "roe", 1, "jane roe mit", kRoeAnswer);
+  fingerprint_index_put(index, "roe-again", 2, "dr jane roe, mit csail",
+                        std::string(kRoeAnswer) + " she also advises startups");
+  fingerprint_index_put(index, "roe-copy", 3, "distributed systems at mit",
+                        kRoeAnswer);
+  // Unrelated, and a similar query with a different answer.
+  fingerprint_index_put(index, "smith", 4, "john smith oxford", kSmithAnswer);
+  fingerprint_index_put(index, "park", 5, "ada park scripps", kParkAnswer);
+  fingerprint_index_put(index, "park-empty", 6, "ada park scripps", "");
+
+  std::vector<std::vector<std::string>> groups;
+  fingerprint_index_duplicates(index, &groups);
+  EXPECT(groups.size() == 1);
+  if (groups.size() == 1) {
+    EXPECT((groups[0] ==
+            std::vector<std::string>{"roe-copy", "roe-again", "roe"}));
+  }
+
+  // Without its copies a record has no duplicate left.
+  fingerprint_index_remove(index, "roe-again");
+  fingerprint_index_remove(index, "roe-copy");
+  fingerprint_index_duplicates(index, &groups);
+  EXPECT(groups.empty());
+
+  // Putting an id again replaces its record.
+  fingerprint_index_put(index, "smith", 7, "jane roe mit", kRoeAnswer);
+  fingerprint_index_duplicates(index, &groups);
+  EXPECT(groups.size() == 1);
+  if (groups.size() == 1) {
+    EXPECT((groups[0] == std::vector<std::string>{"smith", "roe"}));
+  }
+  fingerprint_index_free(index);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  test_similar();
+  test_duplicates();
+  return expect_result();
+}
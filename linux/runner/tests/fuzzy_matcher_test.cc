@@ -0,0 +1,222 @@
+// Tests for fuzzy_matcher_match().
+//
+// Random titles and needles are checked against a brute-force edit distance.
+// There are enough titles for matches to run through both the SSE2 search,
+// four titles at a time, and the scalar search of the remainder.
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../fuzzy_matcher.h"
+#include "expect.h"
+
+namespace {
+
+// Not a multiple of four, so some titles take the scalar search.
+constexpr int kTitles = 103;
+constexpr int kNeedles = 400;
+
+// The fewest edits that turn @word into some substring of @text. An edit is
+// an insertion, a deletion, a substitution or a swap of two adjacent
+// characters; this is the restricted Damerau-Levenshtein distance, with the
+// substring free to start and end anywhere.
+uint32_t substring_distance(const std::string& word, const std::string& text) {
+  size_t m = word.size();
+  size_t n = text.size();
+  // d[i][j]: the edits for the first i characters of @word to end at j.
+  std::vector<std::vector<uint32_t>> d(m + 1, std::vector<uint32_t>(n + 1));
+  for (size_t i = 0; i <= m; i++) {
+    d[i][0] = static_cast<uint32_t>(i);
+  }
+  for (size_t i = 1; i <= m; i++) {
+    for (size_t j = 1; j <= n; j++) {
+      uint32_t cost = word[i - 1] == text[j - 1] ? 0 : 1;
+      uint32_t best = std::min({d[i - 1][j] + 1, d[i][j - 1] + 1,
+                                d[i - 1][j - 1] + cost});
+      if (i > 1 && j > 1 && word[i - 1] == text[j - 2] &&
+          word[i - 2] == text[j - 1]) {
+        best = std::min(best, d[i - 2][j - 2] + 1);
+      }
+      d[i][j] = best;
+    }
+  }
+  uint32_t best = d[m][0];
+  for (size_t j = 1; j <= n; j++) {
+    best = std::min(best, d[m][j]);
+  }
+  return best;
+}
+
+// The edits fuzzy_matcher.h allows for a word of @length characters.
+uint32_t max_distance(size_t length) {
+  return length <= 2 ? 0 : length <= 5 ? 1 : 2;
+}
+
+// The summed edits of @needle's words in @title, or -1 if a word needs more
+// than it is allowed.
+int64_t expected_distance(const std::vector<std::string>& needle,
+                          const std::string& title) {
+  int64_t total = 0;
+  for (const std::string& word : needle) {
+    uint32_t distance = substring_distance(word, title);
+    if (distance > max_distance(word.size())) {
+      return -1;
+    }
+    total += distance;
+  }
+  return total;
+}
+
+std::string random_word(std::mt19937* random,
+                        const char* alphabet,
+                        size_t min_length,
+                        size_t max_length) {
+  size_t length = min_length + (*random)() % (max_length - min_length + 1);
+  size_t letters = std::char_traits<char>::length(alphabet);
+  std::string word;
+  for (size_t i = 0; i < length; i++) {
+    word += alphabet[(*random)() % letters];
+  }
+  return word;
+}
+
+// A word of @title with one or two random edits, so that needles often
+// match at the limit of what they are allowed.
+std::string mutated_word(std::mt19937* random, const std::string& title) {
+  std::vector<std::string> words;
+  size_t start = 0;
+  while (start <= title.size()) {
+    size_t end = std::min(title.find(' ', start), title.size());
+    words.push_back(title.substr(start, end - start));
+    start = end + 1;
+  }
+  std::string word = words[(*random)() % words.size()];
+  int edits = 1 + (*random)() % 2;
+  for (int e = 0; e < edits && word.size() > 1; e++) {
+    size_t at = (*random)() % word.size();
+    switch ((*random)() % 4) {
+      case 0:
+        word.erase(at, 1);
+        break;
+      case 1:
+        word.insert(at, 1, "abcdef"[(*random)() % 6]);
+        break;
+      case 2:
+        word[at] = "abcdef"[(*random)() % 6];
+        break;
+      default:
+        if (at + 1 < word.size()) {
+          std::swap(word[at], word[at + 1]);
+        }
+        break;
+    }
+  }
+  return word;
+}
+
+void test_against_edit_distance() {
+  // A small alphabet makes near misses common; "f" never occurs in titles,
+  // so needles with it also exercise the character prefilter.
+  std::mt19937 random(7);
+  FuzzyMatcher* matcher = fuzzy_matcher_new();
+  std::map<std::string, std::string> titles;
+  for (int i = 0; i < kTitles; i++) {
+    std::string title;
+    int words = 1 + random() % 4;
+    for (int w = 0; w < words; w++) {
+      if (w > 0) {
+        title += ' ';
+      }
+      title += random_word(&random, "abcde", 1, 9);
+    }
+    std::string id = "t" + std::to_string(i);
+    titles[id] = title;
+    fuzzy_matcher_put(matcher, id, i, title);
+  }
+
+  for (int n = 0; n < kNeedles; n++) {
+    std::vector<std::string> needle;
+    int words = 1 + random() % 2;
+    for (int w = 0; w < words; w++) {
+      if (random() % 2 == 0) {
+        auto title = titles.begin();
+        std::advance(title, random() % titles.size());
+        needle.push_back(mutated_word(&random, title->second));
+      } else {
+        needle.push_back(random_word(&random, "abcdef", 1, 8));
+      }
+    }
+    std::string text;
+    for (const std::string& word : needle) {
+      text += text.empty() ? word : " " + word;
+    }
+
+    std::vector<FuzzyMatch> matches;
+    fuzzy_matcher_match(matcher, text, 0, &matches);
+    std::map<std::string, uint32_t> found;
+    for (const FuzzyMatch& match : matches) {
+      found[match.id] = match.distance;
+    }
+    for (const auto& title : titles) {
+      int64_t expected = expected_distance(needle, title.second);
+      auto it = found.find(title.first);
+      if (expected < 0) {
+        EXPECT(it == found.end());
+      } else {
+        EXPECT(it != found.end() && it->second == expected);
+      }
+    }
+    for (size_t i = 1; i < matches.size(); i++) {
+      EXPECT(matches[i - 1].distance <= matches[i].distance);
+    }
+  }
+  fuzzy_matcher_free(matcher);
+}
+
+void test_highlights() {
+  FuzzyMatcher* matcher = fuzzy_matcher_new();
+  fuzzy_matcher_put(matcher, "a", 1, "Jane Roe, MIT");
+  // "Zoë Müller" with precomposed characters.
+  fuzzy_matcher_put(matcher, "b", 2, "Zo\xc3\xab M\xc3\xbcller");
+  std::vector<FuzzyMatch> matches;
+
+  // A swap of adjacent characters is one edit.
+  fuzzy_matcher_match(matcher, "jnae", 0, &matches);
+  EXPECT(matches.size() == 1);
+  if (matches.size() == 1) {
+    EXPECT(matches[0].id == "a");
+    EXPECT(matches[0].distance == 1);
+    EXPECT((matches[0].ranges == std::vector<uint32_t>{0, 4}));
+  }
+
+  // Folded needles match folded titles, highlighted in the original text.
+  fuzzy_matcher_match(matcher, "MULLER zoe", 0, &matches);
+  EXPECT(matches.size() == 1);
+  if (matches.size() == 1) {
+    EXPECT(matches[0].id == "b");
+    EXPECT(matches[0].distance == 0);
+    EXPECT((matches[0].ranges == std::vector<uint32_t>{0, 3, 4, 10}));
+  }
+
+  // Words of one or two characters must occur as they are.
+  fuzzy_matcher_match(matcher, "mt", 0, &matches);
+  EXPECT(matches.empty());
+
+  EXPECT(fuzzy_matcher_remove(matcher, "a"));
+  fuzzy_matcher_match(matcher, "jane", 0, &matches);
+  EXPECT(matches.empty());
+  fuzzy_matcher_free(matcher);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  test_against_edit_distance();
+  test_highlights();
+  return expect_result();
+}
@@ -0,0 +1,80 @@
+// Tests for request_retry_after_parse() and request_retry_delay_from_body().
+
+#include <stdint.h>
+
+#include <string>
+
+#include "../request_scheduler.h"
+#include "expect.h"
+
+namespace {
+
+// Wed, 21 Oct 2015 07:28:00 GMT.
+constexpr int64_t kDateSeconds = 1445412480;
+constexpr char kDate[] = "Wed, 21 Oct 2015 07:28:00 GMT";
+
+constexpr int64_t kSecondUs = G_USEC_PER_SEC;
+
+void test_retry_after_seconds() {
+  EXPECT(request_retry_after_parse("0", 0) == 0);
+  EXPECT(request_retry_after_parse("120", 0) == 120 * kSecondUs);
+  EXPECT(request_retry_after_parse("3600", 0) == kMaxRetryAfterUs);
+  // Longer delays are cut, however long; none may overflow.
+  EXPECT(request_retry_after_parse("3601", 0) == kMaxRetryAfterUs);
+  EXPECT(request_retry_after_parse("9223372036854775807", 0) ==
+         kMaxRetryAfterUs);
+  EXPECT(request_retry_after_parse("99999999999999999999999", 0) ==
+         kMaxRetryAfterUs);
+}
+
+void test_retry_after_invalid() {
+  EXPECT(request_retry_after_parse(nullptr, 0) == -1);
+  EXPECT(request_retry_after_parse("", 0) == -1);
+  EXPECT(request_retry_after_parse("12s", 0) == -1);
+  EXPECT(request_retry_after_parse("1.5", 0) == -1);
+  EXPECT(request_retry_after_parse("soon", 0) == -1);
+}
+
+void test_retry_after_date() {
+  int64_t date_us = kDateSeconds * kSecondUs;
+  EXPECT(request_retry_after_parse(kDate, date_us - 30 * kSecondUs) ==
+         30 * kSecondUs);
+  EXPECT(request_retry_after_parse(kDate, date_us - 1500000) == 1500000);
+  // A date that has passed means now.
+  EXPECT(request_retry_after_parse(kDate, date_us) == 0);
+  EXPECT(request_retry_after_parse(kDate, date_us + 60 * kSecondUs) == 0);
+  // A distant one is cut like a long delay.
+  EXPECT(request_retry_after_parse(kDate, 0) == kMaxRetryAfterUs);
+}
+
+void test_retry_delay_from_body() {
+  constexpr char kBody[] =
+      "{\"error\": {\"code\": 429, \"details\": [{\"@type\": "
+      "\"type.googleapis.com/google.rpc.RetryInfo\", \"retryDelay\": "
+      "\"%s\"}]}}";
+  auto body = [&kBody](const char* delay) {
+    std::string text(kBody);
+    return text.replace(text.find("%s"), 2, delay);
+  };
+  EXPECT(request_retry_delay_from_body(body("12s")) == 12 * kSecondUs);
+  EXPECT(request_retry_delay_from_body(body("0.5s")) == kSecondUs / 2);
+  EXPECT(request_retry_delay_from_body(body("0s")) == 0);
+  EXPECT(request_retry_delay_from_body(body("86400s")) == kMaxRetryAfterUs);
+  EXPECT(request_retry_delay_from_body(body("1e300s")) == kMaxRetryAfterUs);
+
+  EXPECT(request_retry_delay_from_body(body("12")) == -1);
+  EXPECT(request_retry_delay_from_body(body("-1s")) == -1);
+  EXPECT(request_retry_delay_from_body(body("s")) == -1);
+  EXPECT(request_retry_delay_from_body("{\"error\": {\"code\": 500}}") == -1);
+  EXPECT(request_retry_delay_from_body("") == -1);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  test_retry_after_seconds();
+  test_retry_after_invalid();
+  test_retry_after_date();
+  test_retry_delay_from_body();
+  return expect_result();
+}
@@ -0,0 +1,317 @@
+// Tests for the ResponseCache: expiry, eviction, compaction and reopening
+// files left truncated or corrupt.
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+
+#include "../response_cache.h"
+#include "expect.h"
+
+namespace {
+
+constexpr int64_t kSecondUs = 1000000;
+constexpr int64_t kTtlUs = 60 * kSecondUs;
+
+// A scratch cache directory, removed with its files when the test ends.
+class CacheDirectory {
+ public:
+  CacheDirectory() {
+    char path[] = "/tmp/response_cache_test.XXXXXX";
+    path_ = mkdtemp(path) != nullptr ? path : "";
+  }
+
+  ~CacheDirectory() {
+    unlink(file("index.bin").c_str());
+    unlink(file("data.bin").c_str());
+    unlink(file("data.bin.tmp").c_str());
+    rmdir(path_.c_str());
+  }
+
+  const char* path() const { return path_.c_str(); }
+
+  std::string file(const char* name) const { return path_ + "/" + name; }
+
+ private:
+  std::string path_;
+};
+
+ResponseCacheOptions options(uint64_t max_bytes) {
+  ResponseCacheOptions options;
+  options.max_bytes = max_bytes;
+  options.ttl_us = kTtlUs;
+  options.capacity = 64;
+  return options;
+}
+
+// A key whose leading bytes, the ones the index hashes, differ per @n.
+std::string key(int n) {
+  std::string key(kResponseCacheKeySize, '\0');
+  key[0] = static_cast<char>(n);
+  key[kResponseCacheKeySize - 1] = static_cast<char>(n * 7);
+  return key;
+}
+
+const uint8_t* bytes(const std::string& key) {
+  return reinterpret_cast<const uint8_t*>(key.data());
+}
+
+bool has(ResponseCache* cache, int n, int64_t now_us, std::string* value) {
+  return response_cache_lookup(cache, bytes(key(n)), now_us, value);
+}
+
+bool has(ResponseCache* cache, int n, int64_t now_us) {
+  std::string value;
+  return has(cache, n, now_us, &value);
+}
+
+bool put(ResponseCache* cache, int n, int64_t now_us, const std::string& v) {
+  return response_cache_store(cache, bytes(key(n)), now_us, v);
+}
+
+off_t file_size(const std::string& path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 ? st.st_size : -1;
+}
+
+void test_ttl() {
+  CacheDirectory directory;
+  ResponseCacheOptions limits = options(1024 * 1024);
+  ResponseCache* cache = response_cache_open(directory.path(), &limits);
+  EXPECT(cache != nullptr);
+  if (cache == nullptr) {
+    return;
+  }
+
+  EXPECT(put(cache, 1, 0, "first answer"));
+  std::string value;
+  EXPECT(has(cache, 1, kTtlUs, &value));
+  EXPECT(value == "first answer");
+  // Lookups refresh the LRU position, not the age.
+  EXPECT(!has(cache, 1, kTtlUs + 1));
+  EXPECT(!has(cache, 1, 0));
+
+  // Storing again restarts the clock.
+  EXPECT(put(cache, 1, kTtlUs, "second answer"));
+  EXPECT(has(cache, 1, 2 * kTtlUs, &value));
+  EXPECT(value == "second answer");
+
+  ResponseCacheStats stats = response_cache_get_stats(cache);
+  EXPECT(stats.hits == 2);
+  EXPECT(stats.misses == 2);
+  EXPECT(stats.entries == 1);
+  response_cache_free(cache);
+}
+
+void test_lru_eviction() {
+  CacheDirectory directory;
+  // Room for three payloads of 100 bytes.
+  ResponseCacheOptions limits = options(300);
+  ResponseCache* cache = response_cache_open(directory.path(), &limits);
+  EXPECT(cache != nullptr);
+  if (cache == nullptr) {
+    return;
+  }
+
+  std::string payload(100, 'x');
+  EXPECT(put(cache, 1, 1, payload));
+  EXPECT(put(cache, 2, 2, payload));
+  EXPECT(put(cache, 3, 3, payload));
+  // 1 is used again, so 2 is the least recently used.
+  EXPECT(has(cache, 1, 4));
+  EXPECT(put(cache, 4, 5, payload));
+  EXPECT(has(cache, 1, 6));
+  EXPECT(!has(cache, 2, 6));
+  EXPECT(has(cache, 3, 6));
+  EXPECT(has(cache, 4, 6));
+
+  // An expired entry makes room before a live one is evicted, however
+  // recently it was used.
+  EXPECT(put(cache, 5, kTtlUs + 2, payload));
+  EXPECT(!has(cache, 1, kTtlUs + 2));
+  EXPECT(has(cache, 3, kTtlUs + 2));
+  EXPECT(has(cache, 4, kTtlUs + 2));
+  EXPECT(has(cache, 5, kTtlUs + 2));
+
+  // A payload larger than the whole cache is refused.
+  EXPECT(!put(cache, 6, kTtlUs + 5, std::string(301, 'x')));
+  EXPECT(has(cache, 5, kTtlUs + 5));
+
+  ResponseCacheStats stats = response_cache_get_stats(cache);
+  EXPECT(stats.evictions == 1);
+  EXPECT(stats.live_bytes <= 300);
+  response_cache_free(cache);
+}
+
+void test_compaction() {
+  CacheDirectory directory;
+  ResponseCacheOptions limits = options(1024 * 1024);
+  ResponseCache* cache = response_cache_open(directory.path(), &limits);
+  EXPECT(cache != nullptr);
+  if (cache == nullptr) {
+    return;
+  }
+
+  // Each store of a key leaves its previous record dead in the log, until
+  // the log is rewritten with only the live one.
+  std::string kept(1000, 'k');
+  EXPECT(put(cache, 1, 0, kept));
+  uint64_t largest = 0;
+  for (int i = 0; i < 64; i++) {
+    EXPECT(put(cache, 2, i, std::string(64 * 1024, 'a' + i % 26)));
+    ResponseCacheStats stats = response_cache_get_stats(cache);
+    EXPECT(stats.file_bytes < 2 * stats.live_bytes + 1024 * 1024 + 1024);
+    largest = std::max(largest, stats.file_bytes);
+  }
+  // Four megabytes were written, but the log never held more than about a
+  // megabyte of dead records.
+  ResponseCacheStats stats = response_cache_get_stats(cache);
+  EXPECT(largest > 1024 * 1024);
+  EXPECT(largest < 2 * 1024 * 1024);
+  EXPECT(file_size(directory.file("data.bin")) ==
+         static_cast<off_t>(stats.file_bytes));
+  EXPECT(file_size(directory.file("data.bin.tmp")) == -1);
+
+  // Records moved by the rewrite are still found, and survive a reopen.
+  std::string value;
+  EXPECT(has(cache, 1, 1, &value));
+  EXPECT(value == kept);
+  EXPECT(has(cache, 2, 64, &value));
+  EXPECT(value == std::string(64 * 1024, 'a' + 63 % 26));
+  response_cache_free(cache);
+
+  cache = response_cache_open(directory.path(), &limits);
+  EXPECT(cache != nullptr);
+  if (cache == nullptr) {
+    return;
+  }
+  EXPECT(has(cache, 1, 2, &value));
+  EXPECT(value == kept);
+  EXPECT(has(cache, 2, 65));
+  response_cache_free(cache);
+}
+
+// Fills a cache with entries 1 to 3, then closes it.
+void fill(const CacheDirectory& directory) {
+  ResponseCacheOptions limits = options(1024 * 1024);
+  ResponseCache* cache = response_cache_open(directory.path(), &limits);
+  EXPECT(cache != nullptr);
+  if (cache == nullptr) {
+    return;
+  }
+  for (int n = 1; n <= 3; n++) {
+    EXPECT(put(cache, n, n, "answer " + std::to_string(n)));
+  }
+  response_cache_free(cache);
+}
+
+// Overwrites @length bytes of @path at @offset with @byte.
+void scribble(const std::string& path, off_t offset, size_t length, char byte) {
+  int fd = open(path.c_str(), O_WRONLY);
+  EXPECT(fd >= 0);
+  if (fd < 0) {
+    return;
+  }
+  std::string junk(length, byte);
+  EXPECT(pwrite(fd, junk.data(), length, offset) ==
+         static_cast<ssize_t>(length));
+  close(fd);
+}
+
+// The number of entries 1 to 3 that @directory's cache finds on reopening.
+int reopened_hits(const CacheDirectory& directory) {
+  ResponseCacheOptions limits = options(1024 * 1024);
+  ResponseCache* cache = response_cache_open(directory.path(), &limits);
+  EXPECT(cache != nullptr);
+  if (cache == nullptr) {
+    return -1;
+  }
+  int hits = 0;
+  for (int n = 1; n <= 3; n++) {
+    std::string value;
+    if (has(cache, n, 10, &value)) {
+      EXPECT(value == "answer " + std::to_string(n));
+      hits++;
+    }
+  }
+  // Whatever was found, the cache takes new entries.
+  EXPECT(put(cache, 4, 10, "answer 4"));
+  EXPECT(has(cache, 4, 11));
+  response_cache_free(cache);
+  return hits;
+}
+
+void test_reopen() {
+  {
+    CacheDirectory directory;
+    fill(directory);
+    EXPECT(reopened_hits(directory) == 3);
+  }
+  {
+    // A log cut short loses the records the index points past.
+    CacheDirectory directory;
+    fill(directory);
+    EXPECT(truncate(directory.file("data.bin").c_str(), 10) == 0);
+    EXPECT(reopened_hits(directory) == 0);
+  }
+  {
+    // A record appended after the index was last written is dropped.
+    CacheDirectory directory;
+    fill(directory);
+    off_t size = file_size(directory.file("data.bin"));
+    scribble(directory.file("data.bin"), size, 100, 'z');
+    EXPECT(reopened_hits(directory) == 3);
+    EXPECT(file_size(directory.file("data.bin")) > size);
+  }
+  {
+    // A truncated index starts the cache afresh.
+    CacheDirectory directory;
+    fill(directory);
+    EXPECT(truncate(directory.file("index.bin").c_str(), 16) == 0);
+    EXPECT(reopened_hits(directory) == 0);
+  }
+  {
+    // So does an index that is not one.
+    CacheDirectory directory;
+    fill(directory);
+    scribble(directory.file("index.bin"), 0, 8, '\xff');
+    EXPECT(reopened_hits(directory) == 0);
+  }
+  {
+    // A corrupt record is a miss; the others are still served.
+    CacheDirectory directory;
+    fill(directory);
+    scribble(directory.file("data.bin"), 0, 4, '\0');
+    EXPECT(reopened_hits(directory) == 2);
+  }
+  {
+    // An index written with another capacity is not trusted.
+    CacheDirectory directory;
+    fill(directory);
+    ResponseCacheOptions limits = options(1024 * 1024);
+    limits.capacity = 128;
+    ResponseCache* cache = response_cache_open(directory.path(), &limits);
+    EXPECT(cache != nullptr);
+    if (cache != nullptr) {
+      EXPECT(!has(cache, 1, 10));
+      EXPECT(response_cache_get_stats(cache).entries == 0);
+      response_cache_free(cache);
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  test_ttl();
+  test_lru_eviction();
+  test_compaction();
+  test_reopen();
+  return expect_result();
+}
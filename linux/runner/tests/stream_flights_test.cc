@@ -0,0 +1,160 @@
+// Tests for joining streaming requests in flight, and the deadlines of the
+// requests that join them.
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "../stream_flights.h"
+#include "expect.h"
+
+namespace {
+
+constexpr int64_t kSecondUs = 1000000;
+
+void test_join() {
+  StreamFlights* flights = stream_flights_new();
+  bool joined = true;
+  StreamFlight* first =
+      stream_flights_subscribe(flights, "a", 1, 60 * kSecondUs, &joined);
+  EXPECT(!joined);
+  EXPECT(first->deadline_us == 60 * kSecondUs);
+  first->chunks.push_back({1, 2, 3});
+
+  // The same request joins, and is owed the chunks so far; another does not.
+  StreamFlight* second =
+      stream_flights_subscribe(flights, "a", 2, 60 * kSecondUs, &joined);
+  EXPECT(joined);
+  EXPECT(second == first);
+  EXPECT(second->chunks.size() == 1);
+  StreamFlight* other =
+      stream_flights_subscribe(flights, "b", 3, 60 * kSecondUs, &joined);
+  EXPECT(!joined);
+  EXPECT(other != first);
+  EXPECT((first->subscribers == std::vector<int64_t>{1, 2}));
+  EXPECT(stream_flights_in_flight(flights) == 2);
+
+  // Deadlines no earlier than the flight's are left to the flight.
+  EXPECT(stream_flights_next_deadline(flights) == INT64_MAX);
+
+  // The flight goes on while someone waits for it.
+  EXPECT(stream_flights_unsubscribe(flights, 1) == first);
+  EXPECT(stream_flights_unsubscribe(flights, 1) == nullptr);
+  EXPECT((first->subscribers == std::vector<int64_t>{2}));
+  EXPECT(stream_flights_subscribe(flights, "a", 4, kSecondUs, &joined) ==
+         first);
+  EXPECT(joined);
+
+  // Its terminal event ends every subscription.
+  stream_flights_finish(flights, first);
+  EXPECT(stream_flights_unsubscribe(flights, 2) == nullptr);
+  EXPECT(stream_flights_unsubscribe(flights, 4) == nullptr);
+  EXPECT(stream_flights_next_deadline(flights) == INT64_MAX);
+  EXPECT(stream_flights_in_flight(flights) == 1);
+  StreamFlight* again =
+      stream_flights_subscribe(flights, "a", 5, 60 * kSecondUs, &joined);
+  EXPECT(!joined);
+  EXPECT(again->chunks.empty());
+  stream_flights_free(flights);
+}
+
+void test_abandoned() {
+  StreamFlights* flights = stream_flights_new();
+  bool joined = false;
+  StreamFlight* flight =
+      stream_flights_subscribe(flights, "a", 1, 60 * kSecondUs, &joined);
+  stream_flights_subscribe(flights, "a", 2, 60 * kSecondUs, &joined);
+
+  // Once nobody waits for it, a flight is cancelled and not joined again,
+  // though it stays until its worker reports the end.
+  stream_flights_unsubscribe(flights, 1);
+  EXPECT(stream_flights_unsubscribe(flights, 2) == flight);
+  EXPECT(flight->subscribers.empty());
+  StreamFlight* next =
+      stream_flights_subscribe(flights, "a", 3, 60 * kSecondUs, &joined);
+  EXPECT(!joined);
+  EXPECT(next != flight);
+  EXPECT(stream_flights_in_flight(flights) == 2);
+  stream_flights_finish(flights, flight);
+  EXPECT(stream_flights_in_flight(flights) == 1);
+  stream_flights_free(flights);
+}
+
+void test_joiner_deadline() {
+  StreamFlights* flights = stream_flights_new();
+  bool joined = false;
+  StreamFlight* flight =
+      stream_flights_subscribe(flights, "a", 1, 60 * kSecondUs, &joined);
+  stream_flights_subscribe(flights, "a", 2, 10 * kSecondUs, &joined);
+  EXPECT(joined);
+  stream_flights_subscribe(flights, "a", 3, 5 * kSecondUs, &joined);
+  EXPECT(joined);
+  EXPECT(stream_flights_next_deadline(flights) == 5 * kSecondUs);
+
+  std::vector<int64_t> expired;
+  std::vector<StreamFlight*> abandoned;
+  stream_flights_expire(flights, 5 * kSecondUs - 1, &expired, &abandoned);
+  EXPECT(expired.empty());
+
+  // Joiners run out on their own deadlines, and the flight goes on.
+  stream_flights_expire(flights, 5 * kSecondUs, &expired, &abandoned);
+  EXPECT((expired == std::vector<int64_t>{3}));
+  EXPECT(abandoned.empty());
+  EXPECT(stream_flights_next_deadline(flights) == 10 * kSecondUs);
+  stream_flights_expire(flights, 30 * kSecondUs, &expired, &abandoned);
+  EXPECT((expired == std::vector<int64_t>{2}));
+  EXPECT(abandoned.empty());
+  EXPECT((flight->subscribers == std::vector<int64_t>{1}));
+  EXPECT(stream_flights_next_deadline(flights) == INT64_MAX);
+
+  // A cancelled joiner's deadline goes with it.
+  stream_flights_subscribe(flights, "a", 4, 40 * kSecondUs, &joined);
+  EXPECT(stream_flights_next_deadline(flights) == 40 * kSecondUs);
+  stream_flights_unsubscribe(flights, 4);
+  EXPECT(stream_flights_next_deadline(flights) == INT64_MAX);
+
+  // The last one waiting running out abandons the flight.
+  stream_flights_subscribe(flights, "a", 5, 50 * kSecondUs, &joined);
+  stream_flights_unsubscribe(flights, 1);
+  stream_flights_expire(flights, 50 * kSecondUs, &expired, &abandoned);
+  EXPECT((expired == std::vector<int64_t>{5}));
+  EXPECT((abandoned == std::vector<StreamFlight*>{flight}));
+  stream_flights_finish(flights, flight);
+  EXPECT(stream_flights_in_flight(flights) == 0);
+  stream_flights_free(flights);
+}
+
+void test_later_deadline() {
+  StreamFlights* flights = stream_flights_new();
+  bool joined = true;
+  StreamFlight* early =
+      stream_flights_subscribe(flights, "a", 1, 10 * kSecondUs, &joined);
+
+  // A flight that would end first is not joined; the new one is, from then.
+  StreamFlight* late =
+      stream_flights_subscribe(flights, "a", 2, 60 * kSecondUs, &joined);
+  EXPECT(!joined);
+  EXPECT(late != early);
+  EXPECT(stream_flights_subscribe(flights, "a", 3, 20 * kSecondUs, &joined) ==
+         late);
+  EXPECT(joined);
+  EXPECT((early->subscribers == std::vector<int64_t>{1}));
+  EXPECT((late->subscribers == std::vector<int64_t>{2, 3}));
+
+  // Finishing the early flight leaves the late one joinable.
+  stream_flights_finish(flights, early);
+  EXPECT(stream_flights_subscribe(flights, "a", 4, 60 * kSecondUs, &joined) ==
+         late);
+  EXPECT(joined);
+  stream_flights_free(flights);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  test_join();
+  test_abandoned();
+  test_joiner_deadline();
+  test_later_deadline();
+  return expect_result();
+}
@@ -0,0 +1,26 @@
+#include "text_fold.h"
+
+#include <cstring>
+
+gchar* text_fold(const gchar* text) {
+  g_autofree gchar* composed =
+      g_utf8_normalize(text, -1, G_NORMALIZE_ALL_COMPOSE);
+  g_autofree gchar* folded =
+      g_utf8_casefold(composed != nullptr ? composed : text, -1);
+
+  GString* normalized = g_string_sized_new(strlen(folded));
+  gboolean pending_space = FALSE;
+  for (const gchar* p = folded; *p != '\0'; p = g_utf8_next_char(p)) {
+    gunichar c = g_utf8_get_char(p);
+    if (g_unichar_isspace(c)) {
+      pending_space = normalized->len > 0;
+      continue;
+    }
+    if (pending_space) {
+      g_string_append_c(normalized, ' ');
+      pending_space = FALSE;
+    }
+    g_string_append_unichar(normalized, c);
+  }
+  return g_string_free(normalized, FALSE);
+}
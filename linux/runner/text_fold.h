@@ -0,0 +1,19 @@
+#ifndef RUNNER_TEXT_FOLD_H_
+#define RUNNER_TEXT_FOLD_H_
+
+#include <glib.h>
+
+/**
+ * text_fold:
+ * @text: a UTF-8 string.
+ *
+ * Folds @text for matching: NFKC-composes and case-folds it and collapses
+ * runs of whitespace into single spaces, dropping leading and trailing ones.
+ * Two strings that a user would consider the same spelling fold to the same
+ * bytes, so folded strings can be compared and searched bytewise.
+ *
+ * Returns: (transfer full): the folded string.
+ */
+gchar* text_fold(const gchar* text);
+
+#endif  // RUNNER_TEXT_FOLD_H_
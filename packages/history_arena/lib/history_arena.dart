@@ -0,0 +1,12 @@
+/// Research history records kept in native arenas and read in place.
+///
+/// A [HistoryArena] holds every record of a history in a few large native
+/// blocks, with source titles and urls interned across records. Dart keeps
+/// only small handles: fields are decoded through dart:ffi into Dart strings
+/// when asked for, and records are found by id or answer through native
+/// indexes, so a large history costs the garbage collector next to nothing to
+/// trace.
+library;
+
+export 'src/history_arena_common.dart';
+export 'src/history_arena_stub.dart' if (dart.library.ffi) 'src/history_arena_ffi.dart';
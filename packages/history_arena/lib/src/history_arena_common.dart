@@ -0,0 +1,78 @@
+import 'dart:convert';
+import 'dart:typed_data';
+
+/// Counters of a [HistoryArena], in records and bytes.
+class HistoryArenaStats {
+  final int records;
+  final int deadRecords;
+  final int arenaBytes;
+  final int usedBytes;
+  final int internedStrings;
+  final int internedBytes;
+  final int internHits;
+
+  const HistoryArenaStats({
+    required this.records,
+    required this.deadRecords,
+    required this.arenaBytes,
+    required this.usedBytes,
+    required this.internedStrings,
+    required this.internedBytes,
+    required this.internHits,
+  });
+
+  Map<String, int> toMap() => {
+        'records': records,
+        'deadRecords': deadRecords,
+        'arenaBytes': arenaBytes,
+        'usedBytes': usedBytes,
+        'internedStrings': internedStrings,
+        'internedBytes': internedBytes,
+        'internHits': internHits,
+      };
+}
+
+/// Packs records for [HistoryArena.load] in the runner's format: a u32
+/// count, then per record a u32-prefixed id, an i64 timestamp in
+/// milliseconds, a u32-prefixed query and answer, a u32 source count and per
+/// source a u32-prefixed title and url, all little-endian.
+class HistoryArenaPacker {
+  final BytesBuilder _builder = BytesBuilder(copy: false);
+  int _count = 0;
+
+  void add({
+    required String id,
+    required int timestampMs,
+    required String query,
+    required String answer,
+    required List<(String, String)> sources,
+  }) {
+    _string(id);
+    _builder.add((ByteData(8)..setInt64(0, timestampMs, Endian.little)).buffer.asUint8List());
+    _string(query);
+    _string(answer);
+    _u32(sources.length);
+    for (final (title, url) in sources) {
+      _string(title);
+      _string(url);
+    }
+    _count++;
+  }
+
+  Uint8List takeBytes() {
+    final count = (ByteData(4)..setUint32(0, _count, Endian.little)).buffer.asUint8List();
+    final body = _builder.takeBytes();
+    _count = 0;
+    return Uint8List(4 + body.length)
+      ..setAll(0, count)
+      ..setAll(4, body);
+  }
+
+  void _u32(int value) => _builder.add((ByteData(4)..setUint32(0, value, Endian.little)).buffer.asUint8List());
+
+  void _string(String value) {
+    final bytes = utf8.encode(value);
+    _u32(bytes.length);
+    _builder.add(bytes);
+  }
+}
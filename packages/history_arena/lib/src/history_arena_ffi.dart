@@ -0,0 +1,251 @@
+import 'dart:collection';
+import 'dart:convert';
+import 'dart:ffi';
+import 'dart:typed_data';
+
+import 'package:ffi/ffi.dart';
+
+import 'history_arena_common.dart';
+
+final DynamicLibrary _library = DynamicLibrary.open('libhistory_arena.so');
+
+final class _ArenaString extends Struct {
+  external Pointer<Uint8> data;
+  @Uint32()
+  external int length;
+}
+
+final class _ArenaSource extends Struct {
+  external _ArenaString title;
+  external _ArenaString url;
+}
+
+final class _ArenaRecord extends Struct {
+  @Int64()
+  external int timestampMs;
+  external _ArenaString id;
+  external _ArenaString query;
+  external _ArenaString answer;
+  external Pointer<_ArenaSource> sources;
+  @Uint32()
+  external int sourceCount;
+}
+
+final class _ArenaStats extends Struct {
+  @Uint64()
+  external int records;
+  @Uint64()
+  external int deadRecords;
+  @Uint64()
+  external int arenaBytes;
+  @Uint64()
+  external int usedBytes;
+  @Uint64()
+  external int internedStrings;
+  @Uint64()
+  external int internedBytes;
+  @Uint64()
+  external int internHits;
+}
+
+final class _Arena extends Opaque {}
+
+final _new = _library.lookupFunction<Pointer<_Arena> Function(), Pointer<_Arena> Function()>('history_arena_new');
+final _freePointer = _library.lookup<NativeFunction<Void Function(Pointer<Void>)>>('history_arena_free');
+final _load = _library.lookupFunction<
+    Int64 Function(Pointer<_Arena>, Pointer<Uint8>, Size, Pointer<Pointer<_ArenaRecord>>),
+    int Function(Pointer<_Arena>, Pointer<Uint8>, int, Pointer<Pointer<_ArenaRecord>>)>('history_arena_load');
+final _remove = _library.lookupFunction<Bool Function(Pointer<_Arena>, Pointer<Uint8>, Size),
+    bool Function(Pointer<_Arena>, Pointer<Uint8>, int)>('history_arena_remove', isLeaf: true);
+final _length = _library.lookupFunction<Size Function(Pointer<_Arena>), int Function(Pointer<_Arena>)>(
+    'history_arena_length', isLeaf: true);
+final _records = _library.lookupFunction<Pointer<Pointer<_ArenaRecord>> Function(Pointer<_Arena>),
+    Pointer<Pointer<_ArenaRecord>> Function(Pointer<_Arena>)>('history_arena_records', isLeaf: true);
+final _find = _library.lookupFunction<Pointer<_ArenaRecord> Function(Pointer<_Arena>, Pointer<Uint8>, Size),
+    Pointer<_ArenaRecord> Function(Pointer<_Arena>, Pointer<Uint8>, int)>('history_arena_find', isLeaf: true);
+final _findAnswer = _library.lookupFunction<
+    Size Function(Pointer<_Arena>, Pointer<Uint8>, Size, Pointer<Pointer<_ArenaRecord>>, Size),
+    int Function(Pointer<_Arena>, Pointer<Uint8>, int, Pointer<Pointer<_ArenaRecord>>, int)>('history_arena_find_answer',
+    isLeaf: true);
+final _getStats = _library.lookupFunction<Void Function(Pointer<_Arena>, Pointer<_ArenaStats>),
+    void Function(Pointer<_Arena>, Pointer<_ArenaStats>)>('history_arena_get_stats', isLeaf: true);
+
+final _finalizer = NativeFinalizer(_freePointer);
+
+// Only valid while the record the string belongs to is reachable; callers
+// copy it out before returning.
+Uint8List _view(_ArenaString string) =>
+    string.length == 0 ? Uint8List(0) : string.data.asTypedList(string.length);
+
+String _decode(_ArenaString string) => utf8.decode(_view(string), allowMalformed: true);
+
+/// The records of a history, newest first.
+///
+/// Records are immutable once loaded. Loading a record with an id already
+/// present replaces it in the index, and so does [remove], but the bytes of
+/// the old record stay in the arena, so [HistoryArenaRecord]s read earlier
+/// remain valid. The arena is freed once neither it nor any of its records
+/// is reachable.
+class HistoryArena implements Finalizable {
+  final Pointer<_Arena> _handle;
+
+  HistoryArena() : _handle = _new() {
+    _finalizer.attach(this, _handle.cast());
+  }
+
+  int get length => _length(_handle);
+
+  bool get isEmpty => length == 0;
+
+  /// Copies the records in [packed], as written by [HistoryArenaPacker] or
+  /// the runner's history_store_pack_records(), into the arena.
+  ///
+  /// Returns the number of records loaded. Throws a [FormatException] if
+  /// [packed] is malformed, after loading the records before the fault.
+  int load(Uint8List packed) => _loadPacked(packed, null);
+
+  /// Like [load], for a few records: returns them, in order.
+  List<HistoryArenaRecord> add(Uint8List packed) {
+    final count = packed.length < 4 ? 0 : ByteData.sublistView(packed).getUint32(0, Endian.little);
+    final records = <HistoryArenaRecord>[];
+    _loadPacked(packed, (count, records));
+    return records;
+  }
+
+  int _loadPacked(Uint8List packed, (int, List<HistoryArenaRecord>)? out) {
+    final buffer = malloc<Uint8>(packed.isEmpty ? 1 : packed.length);
+    final loaded = out == null ? nullptr : malloc<Pointer<_ArenaRecord>>(out.$1 == 0 ? 1 : out.$1);
+    try {
+      buffer.asTypedList(packed.length).setAll(0, packed);
+      final count = _load(_handle, buffer, packed.length, loaded);
+      if (out != null) {
+        for (var i = 0; i < (count < 0 ? 0 : count); i++) {
+          out.$2.add(HistoryArenaRecord._(this, loaded[i]));
+        }
+      }
+      if (count < 0) throw const FormatException('Malformed history records');
+      return count;
+    } finally {
+      malloc.free(buffer);
+      if (loaded != nullptr) malloc.free(loaded);
+    }
+  }
+
+  bool remove(String id) => _withBytes(id, (bytes, length) => _remove(_handle, bytes, length));
+
+  HistoryArenaRecord? find(String id) {
+    final record = _withBytes(id, (bytes, length) => _find(_handle, bytes, length));
+    return record == nullptr ? null : HistoryArenaRecord._(this, record);
+  }
+
+  /// The records whose answer is exactly [answer], in no particular order.
+  /// Found through a native index, without reading any other record.
+  List<HistoryArenaRecord> withAnswer(String answer) => _withBytes(answer, (bytes, length) {
+        var capacity = 4;
+        while (true) {
+          final found = malloc<Pointer<_ArenaRecord>>(capacity);
+          try {
+            final count = _findAnswer(_handle, bytes, length, found, capacity);
+            if (count <= capacity) return [for (var i = 0; i < count; i++) HistoryArenaRecord._(this, found[i])];
+            capacity = count;
+          } finally {
+            malloc.free(found);
+          }
+        }
+      });
+
+  /// The records as they are now, newest first. Later loads and removals do
+  /// not change the returned list.
+  List<HistoryArenaRecord> snapshot() => _ArenaSnapshot(this);
+
+  HistoryArenaStats get stats {
+    final stats = malloc<_ArenaStats>();
+    try {
+      _getStats(_handle, stats);
+      final s = stats.ref;
+      return HistoryArenaStats(
+        records: s.records,
+        deadRecords: s.deadRecords,
+        arenaBytes: s.arenaBytes,
+        usedBytes: s.usedBytes,
+        internedStrings: s.internedStrings,
+        internedBytes: s.internedBytes,
+        internHits: s.internHits,
+      );
+    } finally {
+      malloc.free(stats);
+    }
+  }
+
+  T _withBytes<T>(String text, T Function(Pointer<Uint8>, int) body) {
+    final encoded = utf8.encode(text);
+    final buffer = malloc<Uint8>(encoded.isEmpty ? 1 : encoded.length);
+    try {
+      buffer.asTypedList(encoded.length).setAll(0, encoded);
+      return body(buffer, encoded.length);
+    } finally {
+      malloc.free(buffer);
+    }
+  }
+}
+
+/// One record of a [HistoryArena]. Keeps the arena alive.
+///
+/// Strings are decoded into the Dart heap on every read; nothing returned
+/// here points into the arena.
+class HistoryArenaRecord implements Finalizable {
+  final HistoryArena _arena;
+  final Pointer<_ArenaRecord> _record;
+
+  HistoryArenaRecord._(this._arena, this._record);
+
+  int get timestampMs => _record.ref.timestampMs;
+
+  String get id => _decode(_record.ref.id);
+  String get query => _decode(_record.ref.query);
+  String get answer => _decode(_record.ref.answer);
+
+  int get sourceCount => _record.ref.sourceCount;
+
+  String sourceTitle(int i) => _decode(_source(i).title);
+  String sourceUrl(int i) => _decode(_source(i).url);
+
+  _ArenaSource _source(int i) {
+    RangeError.checkValidIndex(i, this, 'i', sourceCount);
+    return _record.ref.sources[i];
+  }
+
+  @override
+  bool operator ==(Object other) => other is HistoryArenaRecord && other._record == _record;
+
+  @override
+  int get hashCode => _record.address.hashCode;
+
+  HistoryArena get arena => _arena;
+}
+
+// The record addresses of an arena at one point, in one typed list rather
+// than one object per record.
+class _ArenaSnapshot extends ListBase<HistoryArenaRecord> {
+  final HistoryArena _arena;
+  final Uint64List _addresses;
+
+  _ArenaSnapshot(HistoryArena arena)
+      : _arena = arena,
+        _addresses = Uint64List.fromList(
+            _records(arena._handle).cast<Uint64>().asTypedList(_length(arena._handle)));
+
+  @override
+  int get length => _addresses.length;
+
+  @override
+  set length(int value) => throw UnsupportedError('A history snapshot cannot be resized');
+
+  @override
+  HistoryArenaRecord operator [](int index) =>
+      HistoryArenaRecord._(_arena, Pointer<_ArenaRecord>.fromAddress(_addresses[index]));
+
+  @override
+  void operator []=(int index, HistoryArenaRecord value) =>
+      throw UnsupportedError('A history snapshot is read-only');
+}
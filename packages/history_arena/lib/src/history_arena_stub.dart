@@ -0,0 +1,33 @@
+import 'dart:typed_data';
+
+import 'history_arena_common.dart';
+
+// Without dart:ffi, e.g. on the web, there is no arena to read from.
+Never _unsupported() => throw UnsupportedError('History arenas need dart:ffi');
+
+class HistoryArena {
+  HistoryArena() {
+    _unsupported();
+  }
+
+  int get length => _unsupported();
+  bool get isEmpty => _unsupported();
+  int load(Uint8List packed) => _unsupported();
+  List<HistoryArenaRecord> add(Uint8List packed) => _unsupported();
+  bool remove(String id) => _unsupported();
+  HistoryArenaRecord? find(String id) => _unsupported();
+  List<HistoryArenaRecord> withAnswer(String answer) => _unsupported();
+  List<HistoryArenaRecord> snapshot() => _unsupported();
+  HistoryArenaStats get stats => _unsupported();
+}
+
+abstract class HistoryArenaRecord {
+  HistoryArena get arena;
+  int get timestampMs;
+  String get id;
+  String get query;
+  String get answer;
+  int get sourceCount;
+  String sourceTitle(int i);
+  String sourceUrl(int i);
+}
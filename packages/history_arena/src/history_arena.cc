@@ -0,0 +1,338 @@
+#include "history_arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+// Large enough that 50k records take a few hundred blocks; records larger
+// than a quarter of it get a block of their own.
+constexpr size_t kBlockSize = 256 * 1024;
+
+struct StringHash {
+  size_t operator()(const HistoryArenaString& s) const {
+    // FNV-1a.
+    uint64_t hash = 14695981039346656037ull;
+    for (uint32_t i = 0; i < s.length; i++) {
+      hash = (hash ^ s.data[i]) * 1099511628211ull;
+    }
+    return static_cast<size_t>(hash);
+  }
+};
+
+struct StringEqual {
+  bool operator()(const HistoryArenaString& a,
+                  const HistoryArenaString& b) const {
+    return a.length == b.length &&
+           (a.length == 0 || memcmp(a.data, b.data, a.length) == 0);
+  }
+};
+
+bool read_u32(const uint8_t** p, const uint8_t* end, uint32_t* value) {
+  if (end - *p < 4) {
+    return false;
+  }
+  *value = static_cast<uint32_t>((*p)[0]) |
+           static_cast<uint32_t>((*p)[1]) << 8 |
+           static_cast<uint32_t>((*p)[2]) << 16 |
+           static_cast<uint32_t>((*p)[3]) << 24;
+  *p += 4;
+  return true;
+}
+
+bool read_i64(const uint8_t** p, const uint8_t* end, int64_t* value) {
+  uint32_t low, high;
+  if (!read_u32(p, end, &low) || !read_u32(p, end, &high)) {
+    return false;
+  }
+  *value = static_cast<int64_t>(static_cast<uint64_t>(high) << 32 | low);
+  return true;
+}
+
+// Points @value at a u32-prefixed string of the packed input, uncopied.
+bool read_string(const uint8_t** p,
+                 const uint8_t* end,
+                 HistoryArenaString* value) {
+  uint32_t length;
+  if (!read_u32(p, end, &length) || static_cast<size_t>(end - *p) < length) {
+    return false;
+  }
+  value->data = *p;
+  value->length = length;
+  *p += length;
+  return true;
+}
+
+// Newest first; ids break ties so that the order is stable across loads.
+bool newer(const HistoryArenaRecord* a, const HistoryArenaRecord* b) {
+  if (a->timestamp_ms != b->timestamp_ms) {
+    return a->timestamp_ms > b->timestamp_ms;
+  }
+  return StringHash()(a->id) < StringHash()(b->id);
+}
+
+}  // namespace
+
+struct _HistoryArena {
+  std::vector<uint8_t*> blocks;
+  uint8_t* next;
+  size_t left;
+
+  std::unordered_set<HistoryArenaString, StringHash, StringEqual> interned;
+  std::unordered_map<HistoryArenaString,
+                     const HistoryArenaRecord*,
+                     StringHash,
+                     StringEqual>
+      by_id;
+  std::unordered_multimap<HistoryArenaString,
+                          const HistoryArenaRecord*,
+                          StringHash,
+                          StringEqual>
+      by_answer;
+  // Sorted with newer(), except while a load appends to it.
+  std::vector<const HistoryArenaRecord*> order;
+
+  HistoryArenaStats stats;
+};
+
+static void* allocate(HistoryArena* arena, size_t size, size_t align) {
+  size_t padding = (align - reinterpret_cast<uintptr_t>(arena->next) % align) %
+                   align;
+  if (arena->next == nullptr || padding + size > arena->left) {
+    size_t block_size = size > kBlockSize / 4 ? size : kBlockSize;
+    uint8_t* block = static_cast<uint8_t*>(malloc(block_size));
+    if (block == nullptr) {
+      abort();
+    }
+    arena->blocks.push_back(block);
+    arena->stats.arena_bytes += block_size;
+    // A dedicated block leaves the current one in use.
+    if (block_size != kBlockSize) {
+      arena->stats.used_bytes += size;
+      return block;
+    }
+    arena->next = block;
+    arena->left = block_size;
+    padding = 0;
+  }
+  uint8_t* result = arena->next + padding;
+  arena->next += padding + size;
+  arena->left -= padding + size;
+  arena->stats.used_bytes += padding + size;
+  return result;
+}
+
+static HistoryArenaString copy_string(HistoryArena* arena,
+                                      const HistoryArenaString& value) {
+  HistoryArenaString copy = {nullptr, value.length};
+  if (value.length > 0) {
+    uint8_t* data = static_cast<uint8_t*>(allocate(arena, value.length, 1));
+    memcpy(data, value.data, value.length);
+    copy.data = data;
+  }
+  return copy;
+}
+
+static HistoryArenaString intern(HistoryArena* arena,
+                                 const HistoryArenaString& value) {
+  auto it = arena->interned.find(value);
+  if (it != arena->interned.end()) {
+    arena->stats.intern_hits++;
+    return *it;
+  }
+  HistoryArenaString copy = copy_string(arena, value);
+  arena->interned.insert(copy);
+  arena->stats.interned_strings++;
+  arena->stats.interned_bytes += copy.length;
+  return copy;
+}
+
+// Takes the record with @id out of the maps, but not out of the order.
+//
+// Returns: the record, or %NULL.
+static const HistoryArenaRecord* unlink(HistoryArena* arena,
+                                        const HistoryArenaString& id) {
+  auto it = arena->by_id.find(id);
+  if (it == arena->by_id.end()) {
+    return nullptr;
+  }
+  const HistoryArenaRecord* record = it->second;
+  arena->by_id.erase(it);
+  auto answers = arena->by_answer.equal_range(record->answer);
+  for (auto answer = answers.first; answer != answers.second; ++answer) {
+    if (answer->second == record) {
+      arena->by_answer.erase(answer);
+      break;
+    }
+  }
+  arena->stats.dead_records++;
+  return record;
+}
+
+HistoryArena* history_arena_new() {
+  HistoryArena* arena = new HistoryArena();
+  arena->next = nullptr;
+  arena->left = 0;
+  memset(&arena->stats, 0, sizeof(arena->stats));
+  return arena;
+}
+
+void history_arena_free(HistoryArena* arena) {
+  for (uint8_t* block : arena->blocks) {
+    free(block);
+  }
+  delete arena;
+}
+
+int64_t history_arena_load(HistoryArena* arena,
+                           const uint8_t* packed,
+                           size_t length,
+                           const HistoryArenaRecord** loaded_records) {
+  const uint8_t* p = packed;
+  const uint8_t* end = packed + length;
+  uint32_t count;
+  if (!read_u32(&p, end, &count)) {
+    return -1;
+  }
+
+  size_t appended_from = arena->order.size();
+  std::unordered_set<const HistoryArenaRecord*> replaced;
+  std::vector<HistoryArenaSource> sources;
+  int64_t loaded = 0;
+  for (; loaded < count; loaded++) {
+    HistoryArenaString id, query, answer;
+    int64_t timestamp_ms;
+    uint32_t source_count;
+    if (!read_string(&p, end, &id) || !read_i64(&p, end, &timestamp_ms) ||
+        !read_string(&p, end, &query) || !read_string(&p, end, &answer) ||
+        !read_u32(&p, end, &source_count)) {
+      break;
+    }
+    sources.clear();
+    for (uint32_t i = 0; i < source_count; i++) {
+      HistoryArenaSource source;
+      if (!read_string(&p, end, &source.title) ||
+          !read_string(&p, end, &source.url)) {
+        break;
+      }
+      sources.push_back(source);
+    }
+    if (sources.size() != source_count) {
+      break;
+    }
+
+    const HistoryArenaRecord* old = unlink(arena, id);
+    if (old != nullptr) {
+      replaced.insert(old);
+    }
+    HistoryArenaRecord* record = static_cast<HistoryArenaRecord*>(allocate(
+        arena, sizeof(HistoryArenaRecord), alignof(HistoryArenaRecord)));
+    HistoryArenaSource* copies = nullptr;
+    if (source_count > 0) {
+      copies = static_cast<HistoryArenaSource*>(
+          allocate(arena, sizeof(HistoryArenaSource) * source_count,
+                   alignof(HistoryArenaSource)));
+      for (uint32_t i = 0; i < source_count; i++) {
+        copies[i].title = intern(arena, sources[i].title);
+        copies[i].url = intern(arena, sources[i].url);
+      }
+    }
+    record->timestamp_ms = timestamp_ms;
+    record->id = copy_string(arena, id);
+    record->query = copy_string(arena, query);
+    record->answer = copy_string(arena, answer);
+    record->sources = copies;
+    record->source_count = source_count;
+
+    arena->by_id[record->id] = record;
+    arena->by_answer.emplace(record->answer, record);
+    arena->order.push_back(record);
+    if (loaded_records != nullptr) {
+      loaded_records[loaded] = record;
+    }
+  }
+
+  // Replaced records leave the order in one pass, however many there are;
+  // the records kept from before stay ahead of the appended ones.
+  if (!replaced.empty()) {
+    auto is_replaced = [&replaced](const HistoryArenaRecord* record) {
+      return replaced.count(record) > 0;
+    };
+    auto tail = arena->order.begin() + appended_from;
+    auto old_end = std::remove_if(arena->order.begin(), tail, is_replaced);
+    auto new_end = std::remove_if(tail, arena->order.end(), is_replaced);
+    appended_from = old_end - arena->order.begin();
+    arena->order.erase(std::move(tail, new_end, old_end), arena->order.end());
+  }
+
+  // A single new record is usually the newest and goes to the front; bulk
+  // loads arrive newest first already.
+  auto appended = arena->order.begin() + appended_from;
+  if (!std::is_sorted(appended, arena->order.end(), newer)) {
+    std::sort(appended, arena->order.end(), newer);
+  }
+  std::inplace_merge(arena->order.begin(), appended, arena->order.end(),
+                     newer);
+  arena->stats.records = arena->order.size();
+  return loaded == count ? loaded : -1;
+}
+
+bool history_arena_remove(HistoryArena* arena,
+                          const uint8_t* id,
+                          size_t id_length) {
+  HistoryArenaString key = {id, static_cast<uint32_t>(id_length)};
+  const HistoryArenaRecord* record = unlink(arena, key);
+  if (record == nullptr) {
+    return false;
+  }
+  // The order is sorted, so the record is among the few that sort equal to it.
+  auto equal = std::equal_range(arena->order.begin(), arena->order.end(),
+                                record, newer);
+  auto position = std::find(equal.first, equal.second, record);
+  if (position != equal.second) {
+    arena->order.erase(position);
+  }
+  arena->stats.records = arena->order.size();
+  return true;
+}
+
+size_t history_arena_length(HistoryArena* arena) {
+  return arena->order.size();
+}
+
+const HistoryArenaRecord* const* history_arena_records(HistoryArena* arena) {
+  return arena->order.data();
+}
+
+const HistoryArenaRecord* history_arena_find(HistoryArena* arena,
+                                             const uint8_t* id,
+                                             size_t id_length) {
+  HistoryArenaString key = {id, static_cast<uint32_t>(id_length)};
+  auto it = arena->by_id.find(key);
+  return it != arena->by_id.end() ? it->second : nullptr;
+}
+
+size_t history_arena_find_answer(HistoryArena* arena,
+                                 const uint8_t* answer,
+                                 size_t answer_length,
+                                 const HistoryArenaRecord** found,
+                                 size_t capacity) {
+  HistoryArenaString key = {answer, static_cast<uint32_t>(answer_length)};
+  auto range = arena->by_answer.equal_range(key);
+  size_t count = 0;
+  for (auto it = range.first; it != range.second; ++it, count++) {
+    if (count < capacity) {
+      found[count] = it->second;
+    }
+  }
+  return count;
+}
+
+void history_arena_get_stats(HistoryArena* arena, HistoryArenaStats* stats) {
+  *stats = arena->stats;
+}
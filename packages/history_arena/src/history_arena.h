@@ -0,0 +1,126 @@
+#ifndef HISTORY_ARENA_H_
+#define HISTORY_ARENA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HISTORY_ARENA_EXPORT \
+  extern "C" __attribute__((visibility("default"))) __attribute__((used))
+
+// UTF-8 bytes owned by an arena; not NUL-terminated.
+typedef struct {
+  const uint8_t* data;
+  uint32_t length;
+} HistoryArenaString;
+
+// Titles and urls are interned: every record citing a page shares its bytes.
+typedef struct {
+  HistoryArenaString title;
+  HistoryArenaString url;
+} HistoryArenaSource;
+
+// One research in the history. Records never move or change once loaded;
+// replacing or removing one only takes it out of the arena's index.
+typedef struct {
+  int64_t timestamp_ms;
+  HistoryArenaString id;
+  HistoryArenaString query;
+  HistoryArenaString answer;
+  const HistoryArenaSource* sources;
+  uint32_t source_count;
+} HistoryArenaRecord;
+
+typedef struct {
+  // Records in the index.
+  uint64_t records;
+  // Records replaced or removed, whose bytes stay until the arena is freed.
+  uint64_t dead_records;
+  // Allocated in blocks, and handed out of them.
+  uint64_t arena_bytes;
+  uint64_t used_bytes;
+  uint64_t interned_strings;
+  uint64_t interned_bytes;
+  // Source titles and urls that reused an interned string.
+  uint64_t intern_hits;
+} HistoryArenaStats;
+
+// An append-only store of history records in a few large blocks, read in
+// place from Dart through dart:ffi. Not thread-safe.
+typedef struct _HistoryArena HistoryArena;
+
+HISTORY_ARENA_EXPORT HistoryArena* history_arena_new();
+
+// Frees @arena and every record in it. Also the arena's NativeFinalizer.
+HISTORY_ARENA_EXPORT void history_arena_free(HistoryArena* arena);
+
+/**
+ * history_arena_load:
+ * @arena: a #HistoryArena.
+ * @packed: records as packed by history_store_pack_records() in the runner:
+ *   a u32 count, then per record a u32-prefixed id, an i64 timestamp in
+ *   milliseconds, a u32-prefixed query and answer, a u32 source count and
+ *   per source a u32-prefixed title and url. All integers are little-endian.
+ * @length: the size of @packed.
+ * @loaded: (out) (optional): receives the records loaded, in order; room for
+ *   as many as the count @packed starts with.
+ *
+ * Copies the records into the arena, replacing those with the same id.
+ *
+ * Returns: the number of records loaded, or -1 if @packed is malformed, in
+ * which case the records before the malformed one are kept.
+ */
+HISTORY_ARENA_EXPORT int64_t history_arena_load(
+    HistoryArena* arena,
+    const uint8_t* packed,
+    size_t length,
+    const HistoryArenaRecord** loaded);
+
+// Returns whether a record with @id was in the index.
+HISTORY_ARENA_EXPORT bool history_arena_remove(HistoryArena* arena,
+                                               const uint8_t* id,
+                                               size_t id_length);
+
+HISTORY_ARENA_EXPORT size_t history_arena_length(HistoryArena* arena);
+
+/**
+ * history_arena_records:
+ * @arena: a #HistoryArena.
+ *
+ * Returns: the records in the index, newest first. The array is valid until
+ * the next load or removal; the records it points to stay valid until the
+ * arena is freed.
+ */
+HISTORY_ARENA_EXPORT const HistoryArenaRecord* const* history_arena_records(
+    HistoryArena* arena);
+
+// Returns the record with @id, or %NULL.
+HISTORY_ARENA_EXPORT const HistoryArenaRecord* history_arena_find(
+    HistoryArena* arena,
+    const uint8_t* id,
+    size_t id_length);
+
+/**
+ * history_arena_find_answer:
+ * @arena: a #HistoryArena.
+ * @answer: (array length=answer_length): UTF-8 bytes of an answer.
+ * @answer_length: the size of @answer.
+ * @found: (out) (optional): receives up to @capacity records whose answer is
+ *   exactly @answer, in no particular order.
+ * @capacity: the room in @found.
+ *
+ * Looks records up by answer through a hash index, so that checking whether
+ * an answer is already in the history reads none of the other records.
+ *
+ * Returns: the number of records with @answer, which may exceed @capacity.
+ */
+HISTORY_ARENA_EXPORT size_t history_arena_find_answer(
+    HistoryArena* arena,
+    const uint8_t* answer,
+    size_t answer_length,
+    const HistoryArenaRecord** found,
+    size_t capacity);
+
+HISTORY_ARENA_EXPORT void history_arena_get_stats(HistoryArena* arena,
+                                                  HistoryArenaStats* stats);
+
+#endif  // HISTORY_ARENA_H_
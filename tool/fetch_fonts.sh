@@ -0,0 +1,24 @@
+#!/bin/sh
+# Downloads the Montserrat faces that the Linux bundle ships into linux/fonts,
+# where linux/CMakeLists.txt installs them from. Without it the build
+# downloads the same files at configure time; run it to pin them in the
+# checkout instead. The runner registers them with fontconfig at startup, so
+# the app never fetches fonts at runtime.
+#
+#     tool/fetch_fonts.sh [REF]
+#
+# REF is a tag or commit of github.com/JulietaUla/Montserrat (master). The
+# fonts are under the SIL Open Font License, which is copied next to them.
+set -eu
+
+ref=${1:-master}
+base="https://raw.githubusercontent.com/JulietaUla/Montserrat/$ref"
+dir="$(dirname "$0")/../linux/fonts"
+mkdir -p "$dir"
+
+# The weights the app's text theme and answers use.
+for face in Regular Italic Medium SemiBold Bold Black; do
+  curl -fsSL -o "$dir/Montserrat-$face.ttf" "$base/fonts/ttf/Montserrat-$face.ttf"
+done
+curl -fsSL -o "$dir/OFL.txt" "$base/OFL.txt"
+ls -l "$dir"
@@ -0,0 +1,406 @@
+#!/usr/bin/env python3
+"""Local stand-in for the Gemini generateContent API.
+
+Serves a canned grounded answer so the native clients in the Linux runner can
+be exercised without network access or quota:
+
+    python3 tool/gemini_stand_in.py --port 8089
+
+then set GEMINI_BASE_URL=http://127.0.0.1:8089/v1beta/models/gemini-2.5-flash
+in .env. `:generateContent` returns the whole response at once and
+`:streamGenerateContent?alt=sse` sends it as server-sent events, one chunk
+every --chunk-delay seconds.
+
+Faults can be injected to exercise the runner's request scheduler:
+--fail-first N fails the first N requests, --fault-rate P fails any request
+with probability P, picking a status from --fault-statuses. Rate limits carry
+Retry-After when --retry-after is given, or a RetryInfo detail in the body
+with --retry-info. --stall-rate P holds a response back for --stall seconds,
+past a short deadline.
+
+With --tls-cert and --tls-key it serves HTTPS, to measure the runner's
+connection pool with real handshakes. A self-signed certificate will do:
+
+    openssl req -x509 -newkey rsa:2048 -nodes -days 30 -subj /CN=localhost \
+        -addext subjectAltName=DNS:localhost -keyout key.pem -out cert.pem
+
+Point GEMINI_BASE_URL at https://localhost:8089/... and start the app with
+ECHOLENS_CA_BUNDLE=cert.pem so that the runner trusts it. Responses keep the
+connection open, so reuse and TLS session resumption show up in the metrics.
+The stand-in only speaks HTTP/1.1; multiplexing needs the real endpoint.
+
+With --record DIR it forwards every request to --upstream, the real API by
+default, relays the answer and saves it as DIR/NNNN.json in generateContent
+form, streamed answers merged into one. --replay DIR serves those recordings
+in turn instead of the canned answer, with the same --first-byte-delay,
+--chunk-size and --chunk-delay, which is what the runner's benchmark harness
+searches against.
+
+The canned sources are redirect URIs into the stand-in itself, the way
+Gemini's point at vertexaisearch.cloud.google.com: GET /redirect/<name> goes
+through --redirect-hops 302s, --redirect-delay seconds each, to
+/site/<name>/, a page linking a PNG favicon. That is what the runner's source
+resolver follows.
+"""
+
+import argparse
+import glob
+import itertools
+import json
+import os
+import random
+import struct
+import ssl
+import threading
+import time
+import urllib.error
+import urllib.request
+import zlib
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+DEFAULT_UPSTREAM = "https://generativelanguage.googleapis.com"
+
+ANSWER = (
+    "**Full Name**: Jane Roe\n\n"
+    "**Current Designation/Job Title**: Associate Professor\n\n"
+    "**Department**: Computer Science and Artificial Intelligence Laboratory\n\n"
+    "**University or Affiliation**: Massachusetts Institute of Technology\n\n"
+    "**Contact Emails**: jane.roe@example.edu\n\n"
+    "**Research Interests or Key Achievements**: Distributed systems, "
+    "stream processing and energy-efficient data centres.\n\n"
+    "**Education History**: PhD, Stanford University; BSc, University of "
+    "Toronto\n\n"
+    "**Location**: Cambridge, MA, USA\n\n"
+    "**Summary**: Jane Roe is a systems researcher known for her work on "
+    "low-latency stream processing.\n"
+)
+
+# Titles and the names of their pages under /site/.
+SOURCES = [
+    ("csail.mit.edu", "csail"),
+    ("scholar.google.com", "scholar"),
+    ("linkedin.com", "linkedin"),
+]
+
+SITE_PAGE = """<!doctype html>
+<html><head><title>{name}</title>
+<link rel="stylesheet" href="style.css">
+<link rel="shortcut icon" href="icon.png">
+</head><body><h1>{name}</h1></body></html>
+"""
+
+
+def grounding_metadata(base_url):
+    return {
+        "groundingChunks": [
+            {"web": {"title": title, "uri": f"{base_url}/redirect/{name}"}}
+            for title, name in SOURCES
+        ]
+    }
+
+
+def icon_png(name):
+    """A 16x16 PNG in a colour derived from name."""
+    colour = bytes((zlib.crc32(name.encode()) >> shift) & 0xFF
+                   for shift in (16, 8, 0))
+    rows = b"".join(b"\0" + colour * 16 for _ in range(16))
+
+    def chunk(kind, data):
+        return (struct.pack(">I", len(data)) + kind + data +
+                struct.pack(">I", zlib.crc32(kind + data)))
+
+    return (b"\x89PNG\r\n\x1a\n" +
+            chunk(b"IHDR", struct.pack(">IIBBBBB", 16, 16, 8, 2, 0, 0, 0)) +
+            chunk(b"IDAT", zlib.compress(rows)) + chunk(b"IEND", b""))
+
+
+def full_response(base_url):
+    return {
+        "candidates": [
+            {
+                "content": {"role": "model", "parts": [{"text": ANSWER}]},
+                "finishReason": "STOP",
+                "groundingMetadata": grounding_metadata(base_url),
+            }
+        ]
+    }
+
+
+def answer_text(response):
+    candidate = response["candidates"][0]
+    return "".join(part.get("text", "")
+                   for part in candidate.get("content", {}).get("parts", []))
+
+
+def stream_chunks(response, chunk_size):
+    """Splits a generateContent response into streamed events."""
+    answer = answer_text(response)
+    last = response["candidates"][0]
+    pieces = [answer[i:i + chunk_size]
+              for i in range(0, len(answer), chunk_size)] or [""]
+    for index, piece in enumerate(pieces):
+        candidate = {"content": {"role": "model", "parts": [{"text": piece}]}}
+        if index == len(pieces) - 1:
+            candidate["finishReason"] = last.get("finishReason", "STOP")
+            if "groundingMetadata" in last:
+                candidate["groundingMetadata"] = last["groundingMetadata"]
+        yield {"candidates": [candidate]}
+
+
+def merge_events(events):
+    """Folds streamed events into one generateContent response."""
+    text = []
+    merged = {"content": {"role": "model", "parts": []}}
+    for event in events:
+        for candidate in event.get("candidates", [])[:1]:
+            for part in candidate.get("content", {}).get("parts", []):
+                text.append(part.get("text", ""))
+            for key in ("finishReason", "groundingMetadata"):
+                if key in candidate:
+                    merged[key] = candidate[key]
+    merged["content"]["parts"].append({"text": "".join(text)})
+    return {"candidates": [merged]}
+
+
+def load_recordings(directory):
+    paths = sorted(glob.glob(os.path.join(directory, "*.json")))
+    if not paths:
+        raise SystemExit(f"No recordings in {directory}")
+    recordings = []
+    for path in paths:
+        with open(path, encoding="utf-8") as file:
+            recordings.append(json.load(file))
+    return recordings
+
+
+def error_body(status, retry_delay):
+    error = {
+        "code": status,
+        "message": "Resource has been exhausted (e.g. check quota)."
+        if status == 429 else "The service is currently unavailable.",
+        "status": "RESOURCE_EXHAUSTED" if status == 429 else "UNAVAILABLE",
+    }
+    if retry_delay is not None:
+        error["details"] = [{
+            "@type": "type.googleapis.com/google.rpc.RetryInfo",
+            "retryDelay": f"{retry_delay:g}s",
+        }]
+    return {"error": error}
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def pick_fault(self):
+        """Returns the status to fail this request with, or None."""
+        server = self.server
+        options = server.options
+        with server.lock:
+            server.requests += 1
+            number = server.requests
+        statuses = [int(s) for s in options.fault_statuses.split(",")]
+        if number <= options.fail_first:
+            status = statuses[(number - 1) % len(statuses)]
+        elif random.random() < options.fault_rate:
+            status = random.choice(statuses)
+        else:
+            return None
+        print(f"request {number}: injected {status}")
+        return status
+
+    def send_fault(self, status):
+        options = self.server.options
+        retry_delay = options.retry_after if options.retry_info else None
+        body = json.dumps(error_body(status, retry_delay)).encode()
+        self.send_response(status)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(body)))
+        if options.retry_after is not None and not options.retry_info:
+            self.send_header("Retry-After", f"{options.retry_after:g}")
+        self.end_headers()
+        self.wfile.write(body)
+
+    def next_response(self):
+        server = self.server
+        if server.recordings is None:
+            return full_response(server.base_url)
+        with server.lock:
+            return next(server.recordings)
+
+    def save_recording(self, response):
+        server = self.server
+        with server.lock:
+            server.recorded += 1
+            number = server.recorded
+        path = os.path.join(server.options.record, f"{number:04d}.json")
+        with open(path, "w", encoding="utf-8") as file:
+            json.dump(response, file, ensure_ascii=False, indent=1)
+        print(f"recorded {path}")
+
+    def proxy(self, body):
+        """Forwards the request to the real API and records its answer."""
+        request = urllib.request.Request(
+            self.server.options.upstream + self.path, data=body,
+            headers={"Content-Type": "application/json"}, method="POST")
+        try:
+            upstream = urllib.request.urlopen(request)
+        except urllib.error.HTTPError as error:
+            payload = error.read()
+            self.send_response(error.code)
+            self.send_header("Content-Type", "application/json")
+            self.send_header("Content-Length", str(len(payload)))
+            self.end_headers()
+            self.wfile.write(payload)
+            return
+
+        with upstream:
+            if ":streamGenerateContent" not in self.path:
+                payload = upstream.read()
+                self.send_response(200)
+                self.send_header("Content-Type", "application/json")
+                self.send_header("Content-Length", str(len(payload)))
+                self.end_headers()
+                self.wfile.write(payload)
+                self.save_recording(json.loads(payload))
+                return
+
+            self.send_response(200)
+            self.send_header("Content-Type", "text/event-stream")
+            self.send_header("Transfer-Encoding", "chunked")
+            self.end_headers()
+            events = []
+            for line in upstream:
+                if line.startswith(b"data: "):
+                    events.append(json.loads(line[len(b"data: "):]))
+                if line.strip():
+                    event = line.rstrip(b"\r\n") + b"\r\n\r\n"
+                    self.wfile.write(b"%x\r\n%s\r\n" % (len(event), event))
+                    self.wfile.flush()
+            self.wfile.write(b"0\r\n\r\n")
+            self.save_recording(merge_events(events))
+
+    def do_POST(self):
+        length = int(self.headers.get("Content-Length", 0))
+        body = self.rfile.read(length)
+        if self.server.options.record:
+            self.proxy(body)
+            return
+
+        status = self.pick_fault()
+        if status is not None:
+            self.send_fault(status)
+            return
+        if random.random() < self.server.options.stall_rate:
+            time.sleep(self.server.options.stall)
+
+        if ":streamGenerateContent" in self.path:
+            # Chunked, so that the connection outlives the stream.
+            self.send_response(200)
+            self.send_header("Content-Type", "text/event-stream")
+            self.send_header("Transfer-Encoding", "chunked")
+            self.end_headers()
+            time.sleep(self.server.options.first_byte_delay)
+            response = self.next_response()
+            chunk_size = self.server.options.chunk_size
+            for chunk in stream_chunks(response, chunk_size):
+                event = b"data: " + json.dumps(chunk).encode() + b"\r\n\r\n"
+                self.wfile.write(b"%x\r\n%s\r\n" % (len(event), event))
+                self.wfile.flush()
+                time.sleep(self.server.options.chunk_delay)
+            self.wfile.write(b"0\r\n\r\n")
+        elif ":generateContent" in self.path:
+            time.sleep(self.server.options.first_byte_delay)
+            body = json.dumps(self.next_response()).encode()
+            self.send_response(200)
+            self.send_header("Content-Type", "application/json")
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+        else:
+            self.send_error(404)
+
+    def send_body(self, status, content_type, body, headers=()):
+        self.send_response(status)
+        self.send_header("Content-Type", content_type)
+        self.send_header("Content-Length", str(len(body)))
+        for name, value in headers:
+            self.send_header(name, value)
+        self.end_headers()
+        self.wfile.write(body)
+
+    def do_GET(self):
+        path, _, query = self.path.partition("?")
+        parts = path.strip("/").split("/")
+        if len(parts) == 2 and parts[0] == "redirect":
+            hops = self.server.options.redirect_hops
+            for field in query.split("&"):
+                if field.startswith("left="):
+                    hops = int(field[len("left="):])
+            time.sleep(self.server.options.redirect_delay)
+            if hops > 1:
+                location = f"/redirect/{parts[1]}?left={hops - 1}"
+            else:
+                location = f"{self.server.base_url}/site/{parts[1]}/"
+            self.send_body(302, "text/plain", b"", [("Location", location)])
+        elif len(parts) == 2 and parts[0] == "site":
+            page = SITE_PAGE.format(name=parts[1]).encode()
+            self.send_body(200, "text/html; charset=utf-8", page)
+        elif len(parts) == 3 and parts[0] == "site" and parts[2] == "icon.png":
+            self.send_body(200, "image/png", icon_png(parts[1]))
+        else:
+            self.send_body(404, "text/plain", b"")
+
+    def do_HEAD(self):
+        # The runner pre-connects with a HEAD request; keep its connection.
+        self.send_response(404)
+        self.send_header("Content-Length", "0")
+        self.end_headers()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--port", type=int, default=8089)
+    parser.add_argument("--first-byte-delay", type=float, default=0.5)
+    parser.add_argument("--chunk-delay", type=float, default=0.2)
+    parser.add_argument("--chunk-size", type=int, default=64)
+    parser.add_argument("--fail-first", type=int, default=0)
+    parser.add_argument("--fault-rate", type=float, default=0.0)
+    parser.add_argument("--fault-statuses", default="429,503")
+    parser.add_argument("--retry-after", type=float, default=None)
+    parser.add_argument("--retry-info", action="store_true")
+    parser.add_argument("--stall-rate", type=float, default=0.0)
+    parser.add_argument("--stall", type=float, default=10.0)
+    parser.add_argument("--tls-cert")
+    parser.add_argument("--tls-key")
+    parser.add_argument("--record", metavar="DIR")
+    parser.add_argument("--upstream", default=DEFAULT_UPSTREAM)
+    parser.add_argument("--replay", metavar="DIR")
+    parser.add_argument("--redirect-hops", type=int, default=2)
+    parser.add_argument("--redirect-delay", type=float, default=0.1)
+    options = parser.parse_args()
+    if options.record:
+        os.makedirs(options.record, exist_ok=True)
+
+    server = ThreadingHTTPServer(("127.0.0.1", options.port), Handler)
+    server.options = options
+    server.lock = threading.Lock()
+    server.requests = 0
+    server.recorded = 0
+    server.recordings = None
+    if options.replay:
+        server.recordings = itertools.cycle(load_recordings(options.replay))
+    scheme = "http"
+    if options.tls_cert:
+        context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        context.load_cert_chain(options.tls_cert, options.tls_key)
+        context.set_alpn_protocols(["http/1.1"])
+        server.socket = context.wrap_socket(server.socket, server_side=True)
+        scheme = "https"
+    host = "localhost" if options.tls_cert else "127.0.0.1"
+    server.base_url = f"{scheme}://{host}:{options.port}"
+    print(f"Gemini stand-in listening on {scheme}://127.0.0.1:{options.port}")
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()